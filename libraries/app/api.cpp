@@ -29,12 +29,16 @@
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
+
+#include <graphene/db/trace.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/confidential_object.hpp>
 #include <graphene/chain/market_object.hpp>
 #include <graphene/chain/transaction_object.hpp>
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/worker_object.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/history_store.hpp>
 
 #include <fc/crypto/hex.hpp>
 #include <fc/thread/future.hpp>
@@ -72,6 +76,19 @@ namespace graphene { namespace app {
        return true;
     }
 
+    bool login_api::set_notification_batching( bool enabled )
+    {
+       if( !_set_notification_batching )
+          return false;
+       _set_notification_batching( enabled );
+       return true;
+    }
+
+    void login_api::set_notification_batching_handler( std::function<void(bool)> handler )
+    {
+       _set_notification_batching = std::move( handler );
+    }
+
     void login_api::enable_api( const std::string& api_name )
     {
        if( api_name == "database_api" )
@@ -129,6 +146,41 @@ namespace graphene { namespace app {
        return res;
     }
 
+    vector<vector<char>> block_api::get_raw_blocks(uint32_t first_block_num, uint32_t count)const
+    {
+       FC_ASSERT( count <= 1000, "Can not fetch more than 1000 blocks at once" );
+       return _db.fetch_raw_blocks( first_block_num, count );
+    }
+
+    transaction_merkle_proof block_api::get_transaction_merkle_proof(uint32_t block_num, uint32_t trx_in_block)const
+    {
+       block_cache& cache = _db.get_block_cache();
+       signed_block_ptr block = cache.find( block_num );
+       if( !block )
+       {
+          // fetching the block caches it, if the cache is enabled
+          optional<signed_block> fetched = _db.fetch_block_by_number( block_num );
+          FC_ASSERT( fetched.valid(), "Block ${b} not found", ("b",block_num) );
+          block = cache.find( block_num );
+          if( !block )
+             block = std::make_shared<const signed_block>( std::move( *fetched ) );
+       }
+       FC_ASSERT( trx_in_block < block->transactions.size(), "Block ${b} has only ${n} transactions",
+                  ("b",block_num)("n",block->transactions.size()) );
+
+       std::shared_ptr<const merkle_tree_levels> tree = cache.find_merkle_tree( block->id() );
+       if( !tree )
+          tree = std::make_shared<const merkle_tree_levels>( block->calculate_merkle_tree() );
+
+       transaction_merkle_proof proof;
+       proof.block_header = *block;
+       proof.transaction = block->transactions[trx_in_block];
+       proof.trx_in_block = trx_in_block;
+       proof.trx_count = block->transactions.size();
+       proof.merkle_branch = graphene::chain::merkle_branch( *tree, trx_in_block );
+       return proof;
+    }
+
     network_broadcast_api::network_broadcast_api(application& a):_app(a)
     {
        _applied_block_connection = _app.chain_database()->applied_block.connect([this](const signed_block& b){ on_applied_block(b); });
@@ -150,9 +202,9 @@ namespace graphene { namespace app {
                 auto block_num = b.block_num();
                 auto& callback = _callbacks.find(id)->second;
                 auto v = fc::variant( transaction_confirmation{ id, block_num, trx_num, trx }, GRAPHENE_MAX_NESTED_OBJECTS );
-                fc::async( [capture_this,v,callback]() {
+                graphene::utilities::monitored_async( [capture_this,v,callback]() {
                    callback(v);
-                } );
+                }, "transaction confirmation" );
              }
           }
        }
@@ -229,6 +281,60 @@ namespace graphene { namespace app {
        return _app.p2p_node()->set_advanced_node_parameters(params);
     }
 
+    std::map<std::string,api_method_metrics> network_node_api::get_api_metrics( bool reset )
+    {
+       const auto& metrics = _app.get_options().rpc_metrics;
+       FC_ASSERT( metrics, "API metrics are not enabled on this node, see enable-api-metrics" );
+       auto result = metrics->get_metrics();
+       if( reset )
+          metrics->reset();
+       return result;
+    }
+
+    notification_overflow_stats network_node_api::get_notification_overflows()const
+    {
+       const auto& overflows = _app.get_options().notification_overflows;
+       return overflows ? *overflows : notification_overflow_stats();
+    }
+
+    std::vector<block_production_record> network_node_api::get_block_production( uint32_t limit )const
+    {
+       FC_ASSERT( limit <= block_production_telemetry::max_records );
+       const auto& telemetry = _app.get_options().block_production;
+       return telemetry ? telemetry->get_recent( limit ) : std::vector<block_production_record>();
+    }
+
+    std::vector<startup_phase> network_node_api::get_startup_profile()const
+    {
+       const auto& profile = _app.get_options().startup;
+       return profile ? profile->get_phases() : std::vector<startup_phase>();
+    }
+
+    graphene::utilities::task_monitor_report network_node_api::get_task_monitor_report( bool reset )
+    {
+       auto& monitor = graphene::utilities::task_monitor::chain_thread();
+       auto result = monitor.get_report();
+       if( reset )
+          monitor.reset();
+       return result;
+    }
+
+    void network_node_api::set_tracing( bool enabled )
+    {
+       graphene::db::tracer::instance().enable( enabled );
+    }
+
+    fc::variant network_node_api::get_trace( const std::string& format, bool clear )
+    {
+       FC_ASSERT( format == "chrome" || format == "otlp", "Unknown trace format ${f}, use chrome or otlp",
+                  ("f",format) );
+       auto& the_tracer = graphene::db::tracer::instance();
+       fc::variant result = format == "chrome" ? the_tracer.to_chrome_trace() : the_tracer.to_otlp_json();
+       if( clear )
+          the_tracer.clear();
+       return result;
+    }
+
     fc::api<network_broadcast_api> login_api::network_broadcast()const
     {
        FC_ASSERT(_network_broadcast_api);
@@ -286,28 +392,149 @@ namespace graphene { namespace app {
     vector<order_history_object> history_api::get_fill_order_history( std::string asset_a, std::string asset_b, uint32_t limit  )const
     {
        FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
-       asset_id_type a = database_api.get_asset_id_from_string( asset_a );
-       asset_id_type b = database_api.get_asset_id_from_string( asset_b );
-       if( a > b ) std::swap(a,b);
-       const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-       history_key hkey;
-       hkey.base = a;
-       hkey.quote = b;
-       hkey.sequence = std::numeric_limits<int64_t>::min();
-
-       uint32_t count = 0;
-       auto itr = history_idx.lower_bound( hkey );
-       vector<order_history_object> result;
-       while( itr != history_idx.end() && count < limit)
+       return run_read_only< vector<order_history_object> >( *_app.chain_database(), &_app.get_options(), [&] () {
+          const auto& db = *_app.chain_database();
+          asset_id_type a = database_api.get_asset_id_from_string( asset_a );
+          asset_id_type b = database_api.get_asset_id_from_string( asset_b );
+          if( a > b ) std::swap(a,b);
+          const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
+          history_key hkey;
+          hkey.base = a;
+          hkey.quote = b;
+          hkey.sequence = std::numeric_limits<int64_t>::min();
+
+          uint32_t count = 0;
+          auto itr = history_idx.lower_bound( hkey );
+          vector<order_history_object> result;
+          while( itr != history_idx.end() && count < limit)
+          {
+             if( itr->key.base != a || itr->key.quote != b ) break;
+             result.push_back( *itr );
+             ++itr;
+             ++count;
+          }
+
+          return result;
+       });
+    }
+
+    namespace {
+       using graphene::account_history::history_store;
+
+       /// the store account_history_plugin moves old history to, nullptr if all history is in the object database
+       const history_store* get_history_store( const application& app )
        {
-          if( itr->key.base != a || itr->key.quote != b ) break;
-          result.push_back( *itr );
-          ++itr;
-          ++count;
+          auto plugin = app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+          return plugin ? plugin->get_history_store() : nullptr;
        }
 
-       return result;
+       optional<operation_history_object> find_operation( const database& db, const history_store* store,
+                                                          operation_history_id_type id )
+       {
+          const operation_history_object* op = db.find( id );
+          if( op != nullptr )
+             return *op;
+          return store->get_operation( id );
+       }
+
+       /**
+        * Calls visit for the history entries of account with a sequence number of at most max_sequence, newest
+        * first, until it returns false. The newer entries are in the object database, the older ones in the store.
+        */
+       void for_each_account_history_entry( const database& db, const history_store* store, account_id_type account,
+                                            uint64_t max_sequence,
+                                            const std::function<bool(uint64_t,operation_history_id_type)>& visit )
+       {
+          const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, max_sequence ) );
+          while( itr != by_seq_idx.begin() )
+          {
+             --itr;
+             if( itr->account != account )
+                break;
+             if( !visit( itr->sequence, itr->operation_id ) )
+                return;
+             max_sequence = itr->sequence - 1;
+          }
+          // an entry can be in both while the block that moved it to the store is popped, skip the copy
+          store->for_each_account_entry( account, max_sequence,
+                [&visit]( const graphene::account_history::archived_account_history_entry& entry ) {
+                   return visit( entry.sequence, operation_history_id_type( entry.operation ) );
+                } );
+       }
+
+       /**
+        * get_account_history and get_account_history_operations for nodes with a history store, operation_type is
+        * -1 for all operations
+        */
+       vector<operation_history_object> get_stored_account_history( const database& db, const history_store* store,
+                                                                     account_id_type account,
+                                                                     operation_history_id_type stop, unsigned limit,
+                                                                     operation_history_id_type start, int operation_type )
+       {
+          vector<operation_history_object> result;
+          if( limit == 0 )
+             return result;
+          const uint64_t start_instance = ( start == operation_history_id_type() ? std::numeric_limits<uint64_t>::max()
+                                                                                 : start.instance.value );
+          // seek the newest entry of at most start instead of walking down to it
+          uint64_t max_sequence = std::numeric_limits<uint64_t>::max();
+          if( start != operation_history_id_type() )
+          {
+             const auto& by_op_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_op>();
+             auto itr = by_op_idx.upper_bound( boost::make_tuple( account, start ) );
+             if( itr != by_op_idx.begin() && std::prev( itr )->account == account )
+                max_sequence = std::prev( itr )->sequence;
+             else
+                max_sequence = store->find_sequence( account, start );
+             if( max_sequence == 0 )
+                return result;
+          }
+          for_each_account_history_entry( db, store, account, max_sequence,
+                [&]( uint64_t, operation_history_id_type op_id ) -> bool {
+                   if( stop != operation_history_id_type() && op_id.instance.value <= stop.instance.value )
+                      return false;
+                   if( op_id.instance.value <= start_instance )
+                   {
+                      optional<operation_history_object> op = find_operation( db, store, op_id );
+                      if( op.valid() && ( operation_type < 0 || op->op.which() == operation_type ) )
+                         result.push_back( std::move( *op ) );
+                   }
+                   return result.size() < limit;
+                } );
+          return result;
+       }
+
+       /// the index of account_history_plugin by operation type, nullptr if it isn't kept
+       const graphene::account_history::account_history_type_index* get_operation_type_index( const application& app )
+       {
+          auto plugin = app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+          return plugin ? plugin->get_operation_type_index() : nullptr;
+       }
+
+       /// get_account_history_operations over a range of the operation type index
+       vector<operation_history_object> get_indexed_account_history(
+             const database& db, const graphene::account_history::account_history_type_index& index,
+             account_id_type account, int operation_type, operation_history_id_type start,
+             operation_history_id_type stop, unsigned limit )
+       {
+          typedef graphene::account_history::account_history_type_index::entry_key entry_key;
+          vector<operation_history_object> result;
+          const uint64_t start_instance = ( start == operation_history_id_type() ? std::numeric_limits<uint64_t>::max()
+                                                                                 : start.instance.value );
+          const auto& entries = index.entries();
+          const auto begin = entries.lower_bound( entry_key( account, operation_type, 0 ) );
+          auto itr = entries.upper_bound( entry_key( account, operation_type, start_instance ) );
+          while( itr != begin && result.size() < limit )
+          {
+             --itr;
+             const uint64_t instance = std::get<2>( *itr );
+             if( stop != operation_history_id_type() && instance <= stop.instance.value )
+                break;
+             result.push_back( operation_history_id_type( instance )( db ) );
+          }
+          return result;
+       }
     }
 
     vector<operation_history_object> history_api::get_account_history( const std::string account_id_or_name,
@@ -316,33 +543,137 @@ namespace graphene { namespace app {
                                                                        operation_history_id_type start ) const
     {
        FC_ASSERT( _app.chain_database() );
-       const auto& db = *_app.chain_database();
-       FC_ASSERT( limit <= 100 );
-       vector<operation_history_object> result;
-       account_id_type account;
-       try {
-          account = database_api.get_account_id_from_string(account_id_or_name);
-          const account_transaction_history_object& node = account(db).statistics(db).most_recent_op(db);
-          if(start == operation_history_id_type() || start.instance.value > node.operation_id.instance.value)
-             start = node.operation_id;
-       } catch(...) { return result; }
-
-       const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-       const auto& by_op_idx = hist_idx.indices().get<by_op>();
-       auto index_start = by_op_idx.begin();
-       auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
-
-       while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
+       return run_read_only< vector<operation_history_object> >( *_app.chain_database(), &_app.get_options(), [&] () {
+          const auto& db = *_app.chain_database();
+          FC_ASSERT( limit <= 100 );
+          vector<operation_history_object> result;
+          account_id_type account;
+          const history_store* store = get_history_store( _app );
+          if( store != nullptr )
+          {
+             try {
+                account = database_api.get_account_id_from_string(account_id_or_name);
+             } catch(...) { return result; }
+             return get_stored_account_history( db, store, account, stop, limit, start, -1 );
+          }
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+             const account_transaction_history_object& node = account(db).statistics(db).most_recent_op(db);
+             if(start == operation_history_id_type() || start.instance.value > node.operation_id.instance.value)
+                start = node.operation_id;
+          } catch(...) { return result; }
+
+          const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+          const auto& by_op_idx = hist_idx.indices().get<by_op>();
+          auto index_start = by_op_idx.begin();
+          auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
+
+          while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if(itr->operation_id.instance.value <= start.instance.value)
+                result.push_back(itr->operation_id(db));
+             --itr;
+          }
+          if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
+            result.push_back(itr->operation_id(db));
+          }
+
+          return result;
+       });
+    }
+
+    vector<vector<char>> history_api::get_account_history_packed( const std::string account_id_or_name,
+                                                                 operation_history_id_type stop,
+                                                                 unsigned limit,
+                                                                 operation_history_id_type start ) const
+    {
+       const auto history = get_account_history( account_id_or_name, stop, limit, start );
+       vector<vector<char>> result;
+       result.reserve( history.size() );
+       for( const auto& op : history )
+          result.push_back( fc::raw::pack( op ) );
+       return result;
+    }
+
+    const unsigned history_api::max_history_page_size;
+    const unsigned history_api::max_history_page_ids;
+
+    account_history_page history_api::get_account_history_page( const std::string account_id_or_name,
+                                                               const std::string& cursor,
+                                                               unsigned limit,
+                                                               bool only_ids ) const
+    {
+       FC_ASSERT( _app.chain_database() );
+       FC_ASSERT( limit > 0 );
+       FC_ASSERT( limit <= ( only_ids ? max_history_page_ids : max_history_page_size ),
+                  "At most ${max} operations can be retrieved at once",
+                  ("max", only_ids ? max_history_page_ids : max_history_page_size) );
+       const account_id_type account = database_api.get_account_id_from_string( account_id_or_name );
+
+       // the account and the sequence number of the next operation to return
+       std::pair<account_id_type,uint64_t> position( account, std::numeric_limits<uint64_t>::max() );
+       if( !cursor.empty() )
        {
-          if(itr->operation_id.instance.value <= start.instance.value)
-             result.push_back(itr->operation_id(db));
-          --itr;
-       }
-       if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
-         result.push_back(itr->operation_id(db));
+          std::vector<char> data( cursor.size() / 2 );
+          FC_ASSERT( fc::from_hex( cursor, data.data(), data.size() ) == data.size(), "Invalid cursor" );
+          position = fc::raw::unpack< std::pair<account_id_type,uint64_t> >( data );
+          FC_ASSERT( position.first == account, "The cursor belongs to another account" );
        }
 
-       return result;
+       return run_read_only< account_history_page >( *_app.chain_database(), &_app.get_options(), [&] () {
+          const auto& db = *_app.chain_database();
+          account_history_page page;
+          const auto add_to_page = [&page,only_ids]( const operation_history_object& op ) {
+             if( only_ids )
+             {
+                account_history_entry entry;
+                entry.id = op.id;
+                entry.block_num = op.block_num;
+                entry.is_virtual = op.op.which() == operation::tag<fill_order_operation>::value
+                                || op.op.which() == operation::tag<asset_settle_cancel_operation>::value
+                                || op.op.which() == operation::tag<fba_distribute_operation>::value
+                                || op.op.which() == operation::tag<execute_bid_operation>::value;
+                page.entries.push_back( entry );
+             }
+             else
+                page.operations.push_back( op );
+          };
+
+          const history_store* store = get_history_store( _app );
+          if( store != nullptr )
+          {
+             unsigned count = 0;
+             for_each_account_history_entry( db, store, account, position.second,
+                   [&]( uint64_t sequence, operation_history_id_type op_id ) -> bool {
+                      if( count == limit )
+                      {
+                         page.cursor = fc::to_hex( fc::raw::pack( std::make_pair( account, sequence ) ) );
+                         return false;
+                      }
+                      optional<operation_history_object> op = find_operation( db, store, op_id );
+                      if( op.valid() )
+                         add_to_page( *op );
+                      ++count;
+                      return true;
+                   } );
+             return page;
+          }
+
+          const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, position.second ) );
+          unsigned count = 0;
+          while( count < limit && itr != by_seq_idx.begin() )
+          {
+             --itr;
+             if( itr->account != account )
+                return page;
+             add_to_page( itr->operation_id(db) );
+             ++count;
+          }
+          if( itr != by_seq_idx.begin() && std::prev( itr )->account == account )
+             page.cursor = fc::to_hex( fc::raw::pack( std::make_pair( account, itr->sequence - 1 ) ) );
+          return page;
+       });
     }
 
     vector<operation_history_object> history_api::get_account_history_operations( const std::string account_id_or_name,
@@ -352,36 +683,44 @@ namespace graphene { namespace app {
                                                                        unsigned limit) const
     {
        FC_ASSERT( _app.chain_database() );
-       const auto& db = *_app.chain_database();
-       FC_ASSERT( limit <= 100 );
-       vector<operation_history_object> result;
-       account_id_type account;
-       try {
-          account = database_api.get_account_id_from_string(account_id_or_name);
-       } catch(...) { return result; }
-       const auto& stats = account(db).statistics(db);
-       if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
-       const account_transaction_history_object* node = &stats.most_recent_op(db);
-       if( start == operation_history_id_type() )
-          start = node->operation_id;
-
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
-       {
-          if( node->operation_id.instance.value <= start.instance.value ) {
+       return run_read_only< vector<operation_history_object> >( *_app.chain_database(), &_app.get_options(), [&] () {
+          const auto& db = *_app.chain_database();
+          FC_ASSERT( limit <= 100 );
+          vector<operation_history_object> result;
+          account_id_type account;
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+          } catch(...) { return result; }
+          const history_store* store = get_history_store( _app );
+          if( store != nullptr )
+             return get_stored_account_history( db, store, account, stop, limit, start, operation_type );
+          const auto* type_index = get_operation_type_index( _app );
+          if( type_index != nullptr )
+             return get_indexed_account_history( db, *type_index, account, operation_type, start, stop, limit );
+          const auto& stats = account(db).statistics(db);
+          if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
+          const account_transaction_history_object* node = &stats.most_recent_op(db);
+          if( start == operation_history_id_type() )
+             start = node->operation_id;
+
+          while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if( node->operation_id.instance.value <= start.instance.value ) {
 
-             if(node->operation_id(db).op.which() == operation_type)
-               result.push_back( node->operation_id(db) );
+                if(node->operation_id(db).op.which() == operation_type)
+                  result.push_back( node->operation_id(db) );
+             }
+             if( node->next == account_transaction_history_id_type() )
+                node = nullptr;
+             else node = &node->next(db);
           }
-          if( node->next == account_transaction_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
-       }
-       if( stop.instance.value == 0 && result.size() < limit ) {
-          auto head = db.find(account_transaction_history_id_type());
-          if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_type)
-            result.push_back(head->operation_id(db));
-       }
-       return result;
+          if( stop.instance.value == 0 && result.size() < limit ) {
+             auto head = db.find(account_transaction_history_id_type());
+             if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_type)
+               result.push_back(head->operation_id(db));
+          }
+          return result;
+       });
     }
 
 
@@ -391,35 +730,54 @@ namespace graphene { namespace app {
                                                                                 uint64_t start) const
     {
        FC_ASSERT( _app.chain_database() );
-       const auto& db = *_app.chain_database();
-       FC_ASSERT(limit <= 100);
-       vector<operation_history_object> result;
-       account_id_type account;
-       try {
-          account = database_api.get_account_id_from_string(account_id_or_name);
-       } catch(...) { return result; }
-       const auto& stats = account(db).statistics(db);
-       if( start == 0 )
-          start = stats.total_ops;
-       else
-          start = min( stats.total_ops, start );
-
-       if( start >= stop && start > stats.removed_ops && limit > 0 )
-       {
-          const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
-
-          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-          auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
+       return run_read_only< vector<operation_history_object> >( *_app.chain_database(), &_app.get_options(), [&] () {
+          const auto& db = *_app.chain_database();
+          FC_ASSERT(limit <= 100);
+          vector<operation_history_object> result;
+          account_id_type account;
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+          } catch(...) { return result; }
+          const auto& stats = account(db).statistics(db);
+          if( start == 0 )
+             start = stats.total_ops;
+          else
+             start = min( stats.total_ops, start );
+
+          const history_store* store = get_history_store( _app );
+          if( store != nullptr )
+          {
+             // nothing is removed from the history when it has a store
+             if( start >= stop && limit > 0 )
+                for_each_account_history_entry( db, store, account, start,
+                      [&]( uint64_t sequence, operation_history_id_type op_id ) -> bool {
+                         if( sequence < stop )
+                            return false;
+                         optional<operation_history_object> op = find_operation( db, store, op_id );
+                         if( op.valid() )
+                            result.push_back( std::move( *op ) );
+                         return result.size() < limit;
+                      } );
+             return result;
+          }
 
-          do
+          if( start >= stop && start > stats.removed_ops && limit > 0 )
           {
-             --itr;
-             result.push_back( itr->operation_id(db) );
+             const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+             const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+
+             auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
+             auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
+
+             do
+             {
+                --itr;
+                result.push_back( itr->operation_id(db) );
+             }
+             while ( itr != itr_stop && result.size() < limit );
           }
-          while ( itr != itr_stop && result.size() < limit );
-       }
-       return result;
+          return result;
+       });
     }
 
     flat_set<uint32_t> history_api::get_market_history_buckets()const
@@ -531,81 +889,66 @@ namespace graphene { namespace app {
     // asset_api
     asset_api::asset_api(graphene::app::application& app) :
          _db( *app.chain_database()), 
+         _app_options( &app.get_options() ),
          database_api( std::ref(*app.chain_database()), &(app.get_options()) 
          ) { }
     asset_api::~asset_api() { }
 
     vector<account_asset_balance> asset_api::get_asset_holders( std::string asset, uint32_t start, uint32_t limit ) const {
-      FC_ASSERT(limit <= 100);
-
-      asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
-
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-      auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+      return run_read_only< vector<account_asset_balance> >( _db, _app_options, [&] () {
+         FC_ASSERT(limit <= 100);
 
-      vector<account_asset_balance> result;
+         asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
 
-      uint32_t index = 0;
-      for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
-      {
-        if( result.size() >= limit )
-            break;
+         const auto& holder_idx = _db.get_index_type< primary_index< account_balance_index > >()
+                                     .get_secondary_index< asset_holder_rank_index >();
 
-        if( bal.balance.value == 0 )
-            continue;
-
-        if( index++ < start )
-            continue;
+         vector<account_asset_balance> result;
+         if( limit == 0 )
+            return result;
+         result.reserve( limit );
 
-        const auto account = _db.find(bal.owner);
+         holder_idx.for_each_holder( asset_id, start, [&]( const asset_holder_rank_index::holder& h ) -> bool {
+           const account_object& account = h.owner(_db);
 
-        account_asset_balance aab;
-        aab.name       = account->name;
-        aab.account_id = account->id;
-        aab.amount     = bal.balance.value;
+           account_asset_balance aab;
+           aab.name       = account.name;
+           aab.account_id = account.id;
+           aab.amount     = h.balance.value;
 
-        result.push_back(aab);
-      }
+           result.push_back(aab);
+           return result.size() < limit;
+         });
 
-      return result;
+         return result;
+      });
     }
     // get number of asset holders.
     int asset_api::get_asset_holders_count( std::string asset ) const {
-
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-      asset_id_type asset_id = database_api.get_asset_id_from_string( asset );      
-      auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
-
-      int count = boost::distance(range) - 1;
-
-      return count;
+      return run_read_only< int >( _db, _app_options, [&] () {
+         const auto& holder_idx = _db.get_index_type< primary_index< account_balance_index > >()
+                                     .get_secondary_index< asset_holder_rank_index >();
+         asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+         return int( holder_idx.holder_count( asset_id ) );
+      });
     }
     // function to get vector of system assets with holders count.
     vector<asset_holders> asset_api::get_all_asset_holders() const {
+      return run_read_only< vector<asset_holders> >( _db, _app_options, [&] () {
+         vector<asset_holders> result;
+         const auto& holder_idx = _db.get_index_type< primary_index< account_balance_index > >()
+                                     .get_secondary_index< asset_holder_rank_index >();
+         for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
+         {
+           asset_holders ah;
+           ah.asset_id       = asset_obj.get_id();
+           ah.count     = int( holder_idx.holder_count( ah.asset_id ) );
 
-      vector<asset_holders> result;
-
-      vector<asset_id_type> total_assets;
-      for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
-      {
-        const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
-
-        asset_id_type asset_id;
-        asset_id = dasset_obj.id;
-
-        const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-        auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
-
-        int count = boost::distance(range) - 1;
+           result.push_back(ah);
+         }
 
-        asset_holders ah;
-        ah.asset_id       = asset_id;
-        ah.count     = count;
-
-        result.push_back(ah);
-      }
-
-      return result;
+         return result;
+      });
     }
 
    // orders_api
@@ -622,29 +965,31 @@ namespace graphene { namespace app {
                                                                optional<price> start,
                                                                uint32_t limit )const
    {
-      FC_ASSERT( limit <= 101 );
-      auto plugin = _app.get_plugin<grouped_orders_plugin>( "grouped_orders" );
-      FC_ASSERT( plugin );
-      const auto& limit_groups = plugin->limit_order_groups();
-      vector< limit_order_group > result;
-
-      asset_id_type base_asset_id = database_api.get_asset_id_from_string( base_asset );
-      asset_id_type quote_asset_id = database_api.get_asset_id_from_string( quote_asset );
-
-      price max_price = price::max( base_asset_id, quote_asset_id );
-      price min_price = price::min( base_asset_id, quote_asset_id );
-      if( start.valid() && !start->is_null() )
-         max_price = std::max( std::min( max_price, *start ), min_price );
-
-      auto itr = limit_groups.lower_bound( limit_order_group_key( group, max_price ) );
-      // use an end itrator to try to avoid expensive price comparison
-      auto end = limit_groups.upper_bound( limit_order_group_key( group, min_price ) );
-      while( itr != end && result.size() < limit )
-      {
-         result.emplace_back( *itr );
-         ++itr;
-      }
-      return result;
+      return run_read_only< vector< limit_order_group > >( *_app.chain_database(), &_app.get_options(), [&] () {
+         FC_ASSERT( limit <= 101 );
+         auto plugin = _app.get_plugin<grouped_orders_plugin>( "grouped_orders" );
+         FC_ASSERT( plugin );
+         vector< limit_order_group > result;
+
+         asset_id_type base_asset_id = database_api.get_asset_id_from_string( base_asset );
+         asset_id_type quote_asset_id = database_api.get_asset_id_from_string( quote_asset );
+         const auto depth = plugin->get_market_depth( group, base_asset_id, quote_asset_id );
+
+         auto itr = depth->begin();
+         if( start.valid() && !start->is_null() )
+         {
+            price max_price = price::max( base_asset_id, quote_asset_id );
+            price min_price = price::min( base_asset_id, quote_asset_id );
+            max_price = std::max( std::min( max_price, *start ), min_price );
+            itr = std::lower_bound( depth->begin(), depth->end(), limit_order_group_key( group, max_price ),
+                                    []( const grouped_orders_plugin::market_depth::value_type& g,
+                                        const limit_order_group_key& k ) { return g.first < k; } );
+         }
+         result.reserve( std::min<size_t>( limit, depth->end() - itr ) );
+         for( ; itr != depth->end() && result.size() < limit; ++itr )
+            result.emplace_back( *itr );
+         return result;
+      });
    }
 
 } } // graphene::app
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_metrics.hpp>
+
+#include <fc/io/json.hpp>
+
+namespace graphene { namespace app {
+
+void api_metrics::record( const std::string& method, const fc::microseconds& latency, size_t request_bytes,
+                          size_t response_bytes, bool failed )
+{
+   static const int64_t bucket_limits[] = { 1000, 10000, 100000, 1000000, 10000000 };
+   const uint64_t us = std::max<int64_t>( latency.count(), 0 );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _metrics.find( method );
+   if( itr == _metrics.end() )
+   {
+      if( _metrics.size() >= max_methods )
+         return;
+      itr = _metrics.emplace( method, api_method_metrics() ).first;
+   }
+   api_method_metrics& m = itr->second;
+   ++m.calls;
+   if( failed )
+      ++m.errors;
+   m.request_bytes += request_bytes;
+   m.response_bytes += response_bytes;
+   m.total_microseconds += us;
+   m.max_microseconds = std::max( m.max_microseconds, us );
+   size_t bucket = 0;
+   while( bucket < 5 && us >= uint64_t( bucket_limits[bucket] ) )
+      ++bucket;
+   ++m.latency_histogram[bucket];
+}
+
+std::map<std::string,api_method_metrics> api_metrics::get_metrics()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _metrics;
+}
+
+void api_metrics::reset()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _metrics.clear();
+}
+
+std::string api_metrics::method_name( const std::string& request )
+{
+   try
+   {
+      const fc::variant_object request_object = fc::json::from_string( request ).get_object();
+      const std::string method = request_object["method"].as_string();
+      if( method != "call" )
+         return method;
+      // [ api, method, args ]
+      const fc::variants& params = request_object["params"].get_array();
+      if( params.size() < 2 )
+         return "unknown";
+      return params[0].as_string() + "." + params[1].as_string();
+   }
+   catch( const fc::exception& )
+   {
+      return "unknown";
+   }
+}
+
+metered_websocket_api_connection::metered_websocket_api_connection( fc::http::websocket_connection& c,
+                                                                    uint32_t max_conversion_depth,
+                                                                    std::shared_ptr<api_metrics> metrics )
+   : batch_websocket_api_connection( c, max_conversion_depth ), _metrics( std::move(metrics) )
+{
+}
+
+std::string metered_websocket_api_connection::on_request( const std::string& message, bool send_message )
+{
+   const fc::time_point start = fc::time_point::now();
+   std::string reply;
+   try
+   {
+      reply = batch_websocket_api_connection::on_request( message, send_message );
+   }
+   catch( ... )
+   {
+      _metrics->record( api_metrics::method_name( message ), fc::time_point::now() - start, message.size(), 0, true );
+      throw;
+   }
+   // on_message() answers failed calls with an error object instead of throwing, the first of the two keys
+   // belongs to the response itself
+   const size_t error_pos = reply.find( "\"error\":" );
+   const size_t result_pos = reply.find( "\"result\":" );
+   const bool failed = error_pos != std::string::npos && ( result_pos == std::string::npos || error_pos < result_pos );
+   _metrics->record( api_metrics::method_name( message ), fc::time_point::now() - start, message.size(),
+                     reply.size(), failed );
+   return reply;
+}
+
+} } // graphene::app
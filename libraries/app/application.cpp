@@ -23,24 +23,39 @@
  */
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_metrics.hpp>
+#include <graphene/app/block_production_telemetry.hpp>
+#include <graphene/app/json_writer.hpp>
+#include <graphene/app/prometheus_metrics.hpp>
+#include <graphene/app/startup_profile.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
 
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <graphene/chain/protocol/key_string_cache.hpp>
+#include <graphene/chain/protocol/signature_cache.hpp>
 #include <graphene/chain/protocol/types.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <graphene/egenesis/egenesis.hpp>
 
 #include <graphene/net/core_messages.hpp>
 #include <graphene/net/exceptions.hpp>
 
+#include <graphene/utilities/allocator_stats.hpp>
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/utilities/task_monitor.hpp>
+#include <graphene/utilities/thread_affinity.hpp>
+
+#include <graphene/db/task_scheduler.hpp>
+#include <graphene/db/trace.hpp>
 #include <graphene/chain/worker_evaluator.hpp>
 
 #include <fc/asio.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/network/resolve.hpp>
@@ -69,6 +84,7 @@ using net::trx_message;
 using chain::block_header;
 using chain::signed_block_header;
 using chain::signed_block;
+using chain::signed_block_ptr;
 using chain::block_id_type;
 
 using std::vector;
@@ -246,11 +262,35 @@ std::vector<fc::ip::endpoint> application_impl::resolve_string_to_ip_endpoints(c
 
 void application_impl::new_connection( const fc::http::websocket_connection_ptr& c )
 {
-   auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+   std::shared_ptr<batch_websocket_api_connection> wsc;
+   if( _app_options.rpc_metrics )
+      wsc = std::make_shared<metered_websocket_api_connection>( *c, GRAPHENE_NET_MAX_NESTED_OBJECTS,
+                                                                _app_options.rpc_metrics );
+   else
+      wsc = std::make_shared<batch_websocket_api_connection>( *c, GRAPHENE_NET_MAX_NESTED_OBJECTS );
    auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
    login->enable_api("database_api");
-
-   wsc->register_api(login->database());
+   // the connection owns the login api, which must not keep it alive
+   std::weak_ptr<batch_websocket_api_connection> weak_wsc = wsc;
+   login->set_notification_batching_handler( [weak_wsc]( bool enabled ) {
+      if( auto connection = weak_wsc.lock() )
+         connection->set_batch_notifications( enabled );
+   });
+
+   // the database api is registered first, as api 0, the large results of these calls skip the variants
+   const fc::api<graphene::app::database_api> database = login->database();
+   wsc->add_json_call( { 0, "database", "get_full_accounts",
+                         [database]( const fc::variants& args, uint32_t depth ) -> std::string {
+      FC_ASSERT( args.size() == 2 );
+      return graphene::app::to_json( database->get_full_accounts( args[0].as< vector<string> >( depth ),
+                                                                  args[1].as_bool() ), depth );
+   } } );
+   wsc->add_json_call( { 0, "database", "get_block",
+                         [database]( const fc::variants& args, uint32_t depth ) -> std::string {
+      FC_ASSERT( args.size() == 1 );
+      return graphene::app::to_json( database->get_block( args[0].as<uint32_t>( depth ) ), depth );
+   } } );
+   wsc->register_api(database);
    wsc->register_api(fc::api<graphene::app::login_api>(login));
    c->set_session_data( wsc );
 
@@ -308,6 +348,115 @@ void application_impl::reset_websocket_tls_server()
    _websocket_tls_server->start_accept();
 } FC_CAPTURE_AND_RETHROW() }
 
+void application_impl::reset_metrics_server()
+{ try {
+   if( !_options->count("metrics-endpoint") )
+      return;
+
+   _metrics_server = std::make_shared<fc::http::websocket_server>();
+   _metrics_server->on_connection( [this]( const fc::http::websocket_connection_ptr& c ) {
+      // a scrape is a plain HTTP GET, websocket messages are ignored
+      c->on_http_handler( [this]( const std::string& ) { return render_metrics(); } );
+   });
+
+   ilog("Configured metrics to listen on ${ip}", ("ip",_options->at("metrics-endpoint").as<string>()));
+   _metrics_server->listen( fc::ip::endpoint::from_string(_options->at("metrics-endpoint").as<string>()) );
+   _metrics_server->start_accept();
+} FC_CAPTURE_AND_RETHROW() }
+
+std::string application_impl::render_metrics()const
+{
+   prometheus_writer out;
+   const chain::database& db = *_chain_db;
+   const auto& dgp = db.get_dynamic_global_properties();
+
+   out.family( "graphene_head_block_number", "gauge", "Number of the head block" );
+   out.sample( "graphene_head_block_number", dgp.head_block_number );
+   out.family( "graphene_last_irreversible_block_number", "gauge", "Number of the last irreversible block" );
+   out.sample( "graphene_last_irreversible_block_number", dgp.last_irreversible_block_num );
+   out.family( "graphene_head_block_age_seconds", "gauge", "Seconds since the timestamp of the head block" );
+   out.sample( "graphene_head_block_age_seconds",
+               ( fc::time_point::now() - fc::time_point( dgp.time ) ).count() / 1000000.0 );
+
+   _app_options.block_apply_latency->write( out, "graphene_block_apply_seconds",
+                                             "Time taken to push the blocks received from the p2p network" );
+
+   out.family( "graphene_pending_transactions", "gauge", "Transactions waiting for the next block" );
+   out.sample( "graphene_pending_transactions", db.get_pending_transaction_count() );
+   out.family( "graphene_pending_transaction_bytes", "gauge", "Packed size of the transactions waiting" );
+   out.sample( "graphene_pending_transaction_bytes", db.get_pending_transaction_bytes() );
+   out.family( "graphene_undo_stack_depth", "gauge", "Blocks and sessions that can still be undone" );
+   out.sample( "graphene_undo_stack_depth", db._undo_db.size() );
+
+   out.family( "graphene_objects", "gauge", "Objects in each index" );
+   db.inspect_all_indexes( [&out]( const graphene::db::index& idx ) {
+      out.sample( "graphene_objects", idx.object_count(),
+                  prometheus_writer::label( "space", std::to_string( idx.object_space_id() ) ) + ","
+                  + prometheus_writer::label( "type", std::to_string( idx.object_type_id() ) ) );
+   });
+
+   if( _p2p_network )
+   {
+      uint64_t inbound = 0;
+      uint64_t outbound = 0;
+      for( const net::peer_status& peer : _p2p_network->get_connected_peers() )
+      {
+         if( peer.info.contains( "inbound" ) && peer.info["inbound"].as_bool() )
+            ++inbound;
+         else
+            ++outbound;
+      }
+      out.family( "graphene_p2p_connections", "gauge", "Connected p2p peers" );
+      out.sample( "graphene_p2p_connections", inbound, prometheus_writer::label( "direction", "inbound" ) );
+      out.sample( "graphene_p2p_connections", outbound, prometheus_writer::label( "direction", "outbound" ) );
+
+      const fc::variant_object usage = _p2p_network->network_get_usage_stats();
+      out.family( "graphene_p2p_received_bytes_total", "counter", "Bytes received from p2p peers" );
+      out.sample( "graphene_p2p_received_bytes_total", usage["total_bytes_received"].as_uint64() );
+      out.family( "graphene_p2p_sent_bytes_total", "counter", "Bytes sent to p2p peers" );
+      out.sample( "graphene_p2p_sent_bytes_total", usage["total_bytes_sent"].as_uint64() );
+   }
+
+   if( _app_options.rpc_metrics )
+   {
+      const std::map<std::string,api_method_metrics> methods = _app_options.rpc_metrics->get_metrics();
+      out.family( "graphene_api_calls_total", "counter", "API calls, by method" );
+      for( const auto& method : methods )
+         out.sample( "graphene_api_calls_total", method.second.calls,
+                     prometheus_writer::label( "method", method.first ) );
+      out.family( "graphene_api_errors_total", "counter", "API calls that failed, by method" );
+      for( const auto& method : methods )
+         out.sample( "graphene_api_errors_total", method.second.errors,
+                     prometheus_writer::label( "method", method.first ) );
+      out.family( "graphene_api_call_seconds_total", "counter", "Time spent in API calls, by method" );
+      for( const auto& method : methods )
+         out.sample( "graphene_api_call_seconds_total", method.second.total_microseconds / 1000000.0,
+                     prometheus_writer::label( "method", method.first ) );
+   }
+
+   const graphene::utilities::allocator_stats heap = graphene::utilities::get_allocator_stats();
+   const std::string allocator_label = prometheus_writer::label( "allocator", heap.allocator );
+   out.family( "graphene_heap_allocated_bytes", "gauge", "Heap memory in use" );
+   out.sample( "graphene_heap_allocated_bytes", heap.allocated_bytes, allocator_label );
+   out.family( "graphene_heap_mapped_bytes", "gauge", "Memory the heap allocator obtained from the operating system" );
+   out.sample( "graphene_heap_mapped_bytes", heap.mapped_bytes, allocator_label );
+   out.family( "graphene_heap_free_bytes", "gauge", "Memory the heap allocator holds but is not in use" );
+   out.sample( "graphene_heap_free_bytes", heap.free_bytes, allocator_label );
+
+   out.family( "graphene_history_queue_depth", "gauge", "Blocks waiting for each history consumer" );
+   for( const auto& queue : db.get_history_queue_depths() )
+      out.sample( "graphene_history_queue_depth", queue.second, prometheus_writer::label( "consumer", queue.first ) );
+
+   out.family( "graphene_plugin_queue_depth", "gauge", "Items waiting in the queues of the plugins" );
+   for( const auto& plugin : _active_plugins )
+      for( const auto& queue : plugin.second->get_queue_depths() )
+         out.sample( "graphene_plugin_queue_depth", queue.second,
+                     prometheus_writer::label( "plugin", plugin.first ) + ","
+                     + prometheus_writer::label( "queue", queue.first ) );
+
+   return out.str();
+}
+
 void application_impl::set_dbg_init_key( graphene::chain::genesis_state_type& genesis, const std::string& init_key )
 {
    flat_set< std::string > initial_witness_names;
@@ -316,17 +465,74 @@ void application_impl::set_dbg_init_key( graphene::chain::genesis_state_type& ge
       genesis.initial_witness_candidates[i].block_signing_key = init_pubkey;
 }
 
+/**
+ * Reads the CPUs of a thread option in the listed order, which pins the threads of a pool one by one, the CPUs of
+ * numa-node if it is not set, empty if neither is set
+ */
+static std::vector<uint32_t> parse_cpu_list( const boost::program_options::variables_map& options, const char* name )
+{
+   if( options.count( name ) )
+      return graphene::utilities::parse_cpu_order( options.at( name ).as<string>() );
+   if( options.count( "numa-node" ) )
+      return graphene::utilities::parse_cpu_set( "node:" + std::to_string( options.at( "numa-node" ).as<uint32_t>() ) );
+   return std::vector<uint32_t>();
+}
+
+void application_impl::place_threads()
+{
+   using graphene::utilities::describe_current_thread_placement;
+   using graphene::utilities::format_cpu_set;
+   using graphene::utilities::set_current_thread_cpus;
+
+   const std::vector<uint32_t> p2p_cpus = parse_cpu_list( *_options, "p2p-cpus" );
+   std::string p2p_placement = "not running";
+   if( _p2p_network )
+      _p2p_network->run_on_network_thread( [&p2p_cpus,&p2p_placement] () {
+         if( !p2p_cpus.empty() )
+            set_current_thread_cpus( p2p_cpus );
+         p2p_placement = describe_current_thread_placement();
+      } );
+
+   // done last because threads inherit the CPUs of the thread that starts them, all of them were started by now
+   const std::vector<uint32_t> chain_cpus = parse_cpu_list( *_options, "chain-cpus" );
+   if( !chain_cpus.empty() )
+      set_current_thread_cpus( chain_cpus );
+
+   auto describe_pool = [this]( const char* option ) -> std::string {
+      const std::vector<uint32_t> cpus = parse_cpu_list( *_options, option );
+      return cpus.empty() ? std::string( "unpinned" ) : "CPUs " + format_cpu_set( cpus );
+   };
+   ilog( "Thread placement: chain thread on ${chain}, p2p thread on ${p2p}, ${n} parallel threads ${parallel}, "
+         "verification threads ${verification}",
+         ("chain", describe_current_thread_placement())("p2p", p2p_placement)
+         ("n", graphene::db::task_scheduler::shared().size())("parallel", describe_pool( "parallel-cpus" ))
+         ("verification", describe_pool( "verification-cpus" )) );
+}
+
 void application_impl::startup()
 { try {
    fc::create_directories(_data_dir / "blockchain");
 
-   auto initial_state = [this] {
+   const std::shared_ptr<startup_profile> profile = _app_options.startup;
+   _chain_db->set_phase_observer( [profile]( const std::string& phase, const fc::time_point& start,
+                                             const fc::microseconds& elapsed ) {
+      profile->record( phase, start, elapsed );
+   });
+
+   auto initial_state = [this,profile] {
       ilog("Initializing database...");
+      const fc::time_point start = fc::time_point::now();
+      struct record_on_exit
+      {
+         const std::shared_ptr<startup_profile>& profile;
+         const fc::time_point& start;
+         ~record_on_exit() { profile->record_since( "load genesis", start ); }
+      } record{ profile, start };
       if( _options->count("genesis-json") )
       {
          std::string genesis_str;
          fc::read_file_contents( _options->at("genesis-json").as<boost::filesystem::path>(), genesis_str );
-         graphene::chain::genesis_state_type genesis = fc::json::from_string( genesis_str ).as<graphene::chain::genesis_state_type>( 20 );
+         graphene::chain::genesis_state_type genesis = graphene::chain::read_genesis_state( genesis_str );
          bool modified_genesis = false;
          if( _options->count("genesis-timestamp") )
          {
@@ -362,11 +568,22 @@ void application_impl::startup()
       }
       else
       {
+         // the packed state, if it was embedded, saves parsing the JSON and has the same chain id
+         std::vector<char> egenesis_packed;
+         graphene::egenesis::compute_egenesis_packed( egenesis_packed );
+         if( !egenesis_packed.empty() )
+         {
+            FC_ASSERT( graphene::egenesis::get_egenesis_packed_hash()
+                       == fc::sha256::hash( egenesis_packed.data(), egenesis_packed.size() ) );
+            auto genesis = fc::raw::unpack<graphene::chain::genesis_state_type>( egenesis_packed );
+            genesis.initial_chain_id = graphene::egenesis::get_egenesis_json_hash();
+            return genesis;
+         }
          std::string egenesis_json;
          graphene::egenesis::compute_egenesis_json( egenesis_json );
          FC_ASSERT( egenesis_json != "" );
          FC_ASSERT( graphene::egenesis::get_egenesis_json_hash() == fc::sha256::hash( egenesis_json ) );
-         auto genesis = fc::json::from_string( egenesis_json ).as<graphene::chain::genesis_state_type>( 20 );
+         auto genesis = graphene::chain::read_genesis_state( egenesis_json );
          genesis.initial_chain_id = fc::sha256::hash( egenesis_json );
          return genesis;
       }
@@ -375,6 +592,21 @@ void application_impl::startup()
    if( _options->count("resync-blockchain") )
       _chain_db->wipe(_data_dir / "blockchain", true);
 
+   if( _options->count("bootstrap-from-snapshot") )
+   {
+      if( fc::exists( _data_dir / "blockchain" / "object_database" ) || fc::exists( _data_dir / "blockchain" / "database" ) )
+         wlog( "Ignoring bootstrap-from-snapshot, the node already has a chain state. Add resync-blockchain to start over" );
+      else
+      {
+         const auto snapshot = _options->at("bootstrap-from-snapshot").as<boost::filesystem::path>();
+         ilog( "Bootstrapping from snapshot ${f}", ("f",snapshot) );
+         const uint32_t head = graphene::chain::database::install_state_snapshot( snapshot, _data_dir / "blockchain",
+                                                                                  GRAPHENE_CURRENT_DB_VERSION,
+                                                                                  initial_state().initial_chain_id );
+         ilog( "Installed the chain state at block ${n}, the remaining blocks are synced from peers", ("n",head) );
+      }
+   }
+
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
    if( _options->count("checkpoint") )
    {
@@ -393,9 +625,71 @@ void application_impl::startup()
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   const uint32_t prune_keep_blocks = _options->count("prune-blocks") ? _options->at("prune-blocks").as<uint32_t>() : 0;
+   if( _options->count("block-log-format") || _options->count("convert-block-log") || prune_keep_blocks > 0 )
+   {
+      const std::string format = _options->count("block-log-format") ? _options->at("block-log-format").as<string>()
+                                                                     : "legacy";
+      FC_ASSERT( format == "legacy" || format == "segmented", "Unknown block-log-format ${f}", ("f",format) );
+      // pruning needs segments
+      _chain_db->set_block_log_format( format == "segmented" || _options->count("convert-block-log") || prune_keep_blocks > 0,
+                                       _options->count("convert-block-log") > 0 );
+   }
+   if( prune_keep_blocks > 0 )
+   {
+      FC_ASSERT( prune_keep_blocks >= GRAPHENE_MAX_UNDO_HISTORY,
+                 "prune-blocks must keep at least ${n} blocks", ("n",GRAPHENE_MAX_UNDO_HISTORY) );
+      _chain_db->set_block_pruning( prune_keep_blocks );
+   }
+
+   if( _options->count("replay-checkpoint-interval") )
+      _chain_db->set_replay_checkpoint_interval( _options->at("replay-checkpoint-interval").as<uint32_t>() );
+
+   if( _options->count("verification-threads") && _options->at("verification-threads").as<uint32_t>() > 0 )
+   {
+      const std::vector<uint32_t> cpus = parse_cpu_list( *_options, "verification-cpus" );
+      _chain_db->set_verification_pool( std::make_shared<graphene::chain::verification_pool>(
+            _options->at("verification-threads").as<uint32_t>(), cpus ) );
+   }
+
+   if( _options->count("analyze-transaction-conflicts") )
+      _chain_db->enable_transaction_conflict_analysis( _options->at("analyze-transaction-conflicts").as<bool>() );
+
+   if( _options->count("block-cache-size") )
+      _chain_db->get_block_cache().set_capacity( _options->at("block-cache-size").as<uint32_t>() );
+
+   if( _options->count("signature-cache-size") )
+      graphene::chain::signature_cache::instance().set_capacity( _options->at("signature-cache-size").as<uint32_t>() );
+
+   if( _options->count("key-string-cache-size") )
+      graphene::chain::key_string_cache::instance().set_capacity( _options->at("key-string-cache-size").as<uint32_t>() );
+
+   _chain_db->set_pending_transaction_limits(
+         uint64_t( _options->count("max-pending-transactions-size")
+                   ? _options->at("max-pending-transactions-size").as<uint32_t>() : 0 ) * 1024 * 1024,
+         _options->count("max-pending-transactions-per-account")
+            ? _options->at("max-pending-transactions-per-account").as<uint32_t>() : 0,
+         _options->count("pack-blocks-by-fee") && _options->at("pack-blocks-by-fee").as<bool>() );
+
+   if( _options->count("memory-usage-log-interval") )
+      _chain_db->set_memory_usage_log_interval(
+            fc::seconds( _options->at("memory-usage-log-interval").as<uint32_t>() ) );
+
    if( _options->count("replay-blockchain") || _options->count("revalidate-blockchain") )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
+   if( _options->count("import-blocks") )
+   {
+      const auto source = _options->at("import-blocks").as<boost::filesystem::path>();
+      ilog( "Importing blocks from ${d}", ("d",source) );
+      const fc::time_point start = fc::time_point::now();
+      const uint32_t thread_count = _options->count("verification-threads")
+                                    ? _options->at("verification-threads").as<uint32_t>() : 0;
+      const uint32_t last = _chain_db->import_blocks( source, _data_dir / "blockchain", thread_count );
+      profile->record_since( "import blocks", start );
+      ilog( "The block database ends at block ${n}, the blocks after the chain state are replayed now", ("n",last) );
+   }
+
    try
    {
       // these flags are used in open() only, i. e. during replay
@@ -418,9 +712,11 @@ void application_impl::startup()
                 graphene::chain::database::skip_tapos_check |
                 graphene::chain::database::skip_witness_schedule_check;
 
+      const fc::time_point start = fc::time_point::now();
       graphene::chain::detail::with_skip_flags( *_chain_db, skip, [this,&initial_state] () {
          _chain_db->open( _data_dir / "blockchain", initial_state, GRAPHENE_CURRENT_DB_VERSION );
       });
+      profile->record_since( "database::open", start );
    }
    catch( const fc::exception& e )
    {
@@ -428,6 +724,9 @@ void application_impl::startup()
       throw;
    }
 
+   if( _options->count("state-journal") && _options->at("state-journal").as<bool>() )
+      _chain_db->open_state_journal( _data_dir / "blockchain" / "state_journal" );
+
    if( _options->count("force-validate") )
    {
       ilog( "All transaction signatures will be validated" );
@@ -440,6 +739,45 @@ void application_impl::startup()
    if( _active_plugins.find( "market_history" ) != _active_plugins.end() )
       _app_options.has_market_history_plugin = true;
 
+   _app_options.block_production = std::make_shared<block_production_telemetry>();
+
+   if( _options->count("enable-api-metrics") && _options->at("enable-api-metrics").as<bool>() )
+      _app_options.rpc_metrics = std::make_shared<api_metrics>();
+
+   if( _options->count("enable-task-monitor") && _options->at("enable-task-monitor").as<bool>() )
+   {
+      graphene::utilities::task_monitor::chain_thread().enable( true );
+      graphene::utilities::task_monitor::chain_thread().start_sampling( fc::seconds(1) );
+   }
+
+   if( _options->count("trace-buffer-size") )
+      graphene::db::tracer::instance().set_capacity( _options->at("trace-buffer-size").as<uint32_t>() );
+   if( _options->count("enable-tracing") && _options->at("enable-tracing").as<bool>() )
+      graphene::db::tracer::instance().enable( true );
+
+   if( _options->count("api-max-pending-notifications") )
+      _app_options.max_pending_notifications = _options->at("api-max-pending-notifications").as<uint32_t>();
+   if( _options->count("api-notification-overflow") )
+   {
+      const string policy = _options->at("api-notification-overflow").as<string>();
+      if( policy == "drop" )
+         _app_options.overflow_policy = notification_overflow_policy::drop_oldest;
+      else if( policy == "coalesce" )
+         _app_options.overflow_policy = notification_overflow_policy::coalesce;
+      else if( policy == "unsubscribe" )
+         _app_options.overflow_policy = notification_overflow_policy::unsubscribe;
+      else
+         FC_THROW( "Invalid api-notification-overflow ${p}, expected drop, coalesce or unsubscribe", ("p",policy) );
+   }
+   _app_options.notification_overflows = std::make_shared<notification_overflow_stats>();
+
+   if( _options->count("api-reader-threads") && _options->at("api-reader-threads").as<uint32_t>() > 0 )
+   {
+      _app_options.api_read_pool = std::make_shared<graphene::chain::verification_pool>(
+            _options->at("api-reader-threads").as<uint32_t>() );
+      _chain_db->enable_concurrent_reads( true );
+   }
+
    if( _options->count("api-access") ) {
 
       fc::path api_access_file = _options->at("api-access").as<boost::filesystem::path>();
@@ -466,9 +804,14 @@ void application_impl::startup()
       _apiaccess.permission_map["*"] = wild_access;
    }
 
+   fc::time_point start = fc::time_point::now();
    reset_p2p_node(_data_dir);
+   profile->record_since( "p2p node", start );
+   start = fc::time_point::now();
    reset_websocket_server();
    reset_websocket_tls_server();
+   reset_metrics_server();
+   profile->record_since( "websocket servers", start );
 } FC_LOG_AND_RETHROW() }
 
 optional< api_access_info > application_impl::get_api_access_info(const string& username)const
@@ -515,6 +858,7 @@ bool application_impl::has_item(const net::item_id& id)
 bool application_impl::handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                           std::vector<fc::uint160_t>& contained_transaction_message_ids)
 { try {
+   graphene::db::trace_scope tracing( "handle_block", blk_msg.block.block_num() );
 
    auto latency = fc::time_point::now() - blk_msg.block.timestamp;
    if (!sync_mode || blk_msg.block.block_num() % 10000 == 0)
@@ -536,14 +880,19 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    try {
       const uint32_t skip = (_is_block_producer | _force_validate) ?
                                database::skip_nothing : database::skip_transaction_signatures;
-      bool result = valve.do_serial( [this,&blk_msg,skip] () {
-         _chain_db->precompute_parallel( blk_msg.block, skip ).wait();
-      }, [this,&blk_msg,skip] () {
+      // the only copy of the block, the chain, its caches and plugins share it from here on
+      const signed_block_ptr block = std::make_shared<const signed_block>( blk_msg.block );
+      bool result = valve.do_serial( [this,&block,skip] () {
+         _chain_db->precompute_parallel( *block, skip ).wait();
+      }, [this,&block,skip] () -> bool {
          // TODO: in the case where this block is valid but on a fork that's too old for us to switch to,
          // you can help the network code out by throwing a block_older_than_undo_history exception.
          // when the net code sees that, it will stop trying to push blocks from that chain, but
          // leave that peer connected so that they can get sync blocks from us
-         return _chain_db->push_block( blk_msg.block, skip );
+         const fc::time_point start = fc::time_point::now();
+         const bool pushed = _chain_db->push_block( block, skip );
+         _app_options.block_apply_latency->record( fc::time_point::now() - start );
+         return pushed;
       });
 
       // the block was accepted, so we now know all of the transactions contained in the block
@@ -598,6 +947,35 @@ void application_impl::handle_transaction(const graphene::net::trx_message& tran
    _chain_db->push_transaction( transaction_message.trx );
 } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
+std::vector<fc::oexception> application_impl::handle_transactions(const std::vector<graphene::net::trx_message>& transaction_messages)
+{
+   std::vector<fc::future<void>> precomputed;
+   precomputed.reserve( transaction_messages.size() );
+   for( const auto& transaction_message : transaction_messages )
+      precomputed.push_back( _chain_db->precompute_parallel( transaction_message.trx ) );
+
+   std::vector<fc::oexception> results( transaction_messages.size() );
+   for( size_t i = 0; i < transaction_messages.size(); ++i )
+   {
+      try
+      {
+         precomputed[i].wait();
+         _chain_db->push_transaction( transaction_messages[i].trx );
+      }
+      catch( const fc::canceled_exception& )
+      {
+         throw;
+      }
+      catch( const fc::exception& e )
+      {
+         results[i] = e;
+      }
+   }
+   if( transaction_messages.size() > 1 )
+      dlog( "Handled ${n} transactions from network in one call", ("n", transaction_messages.size()) );
+   return results;
+}
+
 void application_impl::handle_message(const message& message_to_process)
 {
    // not a transaction, not a block
@@ -656,6 +1034,11 @@ std::vector<item_hash_t> application_impl::get_block_ids(const std::vector<item_
        FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
                            "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis" );
    }
+   // blocks that were pruned can not be served, let the peer sync them from someone else
+   if( block_header::num_from_id(last_known_block_id) + 1 < _chain_db->first_available_block_num() )
+      FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
+                          "Blocks before ${n} were pruned from our block database",
+                          ("n",_chain_db->first_available_block_num()) );
    for( uint32_t num = block_header::num_from_id(last_known_block_id);
         num <= _chain_db->head_block_num() && result.size() < limit;
         ++num )
@@ -676,6 +1059,18 @@ message application_impl::get_item(const item_id& id)
   // ilog("Request for item ${id}", ("id", id));
    if( id.item_type == graphene::net::block_message_type )
    {
+      // blocks of our chain go out as stored, the packed block followed by its id is a packed block_message
+      auto raw_block = _chain_db->fetch_raw_block_by_id( id.item_hash );
+      if( raw_block )
+      {
+         message msg;
+         msg.msg_type = graphene::net::block_message_type;
+         msg.data = std::move( *raw_block );
+         const vector<char> packed_id = fc::raw::pack( block_id_type( id.item_hash ) );
+         msg.data.insert( msg.data.end(), packed_id.begin(), packed_id.end() );
+         msg.size = (uint32_t)msg.data.size();
+         return msg;
+      }
       auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
       if( !opt_block )
          elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
@@ -687,6 +1082,49 @@ message application_impl::get_item(const item_id& id)
    return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+std::vector<signed_block_header> application_impl::get_block_headers( const std::vector<item_hash_t>& block_ids )
+{ try {
+   std::vector<signed_block_header> headers;
+   headers.reserve( block_ids.size() );
+   for( const item_hash_t& block_id : block_ids )
+   {
+      // a packed block starts with its packed header, the transactions don't need to be unpacked
+      auto raw_block = _chain_db->fetch_raw_block_by_id( block_id );
+      if( !raw_block )
+         break;
+      headers.push_back( fc::raw::unpack<signed_block_header>( *raw_block ) );
+   }
+   return headers;
+} FC_CAPTURE_AND_RETHROW( (block_ids) ) }
+
+std::vector<fc::optional<precomputable_transaction>> application_impl::find_pending_transactions(
+      const std::vector<transaction_id_type>& ids )
+{ try {
+   return _chain_db->find_pending_transactions( ids );
+} FC_CAPTURE_AND_RETHROW( (ids) ) }
+
+graphene::net::sync_block_header_check application_impl::check_sync_block_header( const signed_block_header& header )
+{
+   const auto& witnesses = _chain_db->get_index_type<chain::witness_index>().indices().get<chain::by_id>();
+   auto witness_itr = witnesses.find( header.witness );
+   try
+   {
+      if( witness_itr == witnesses.end() )
+      {
+         header.signee();
+         return graphene::net::sync_block_header_check::unknown_witness;
+      }
+      if( header.validate_signee( witness_itr->signing_key ) )
+         return graphene::net::sync_block_header_check::signed_by_witness_key;
+      return graphene::net::sync_block_header_check::other_signing_key;
+   }
+   catch( const fc::exception& )
+   {
+      // not a canonical signature of the header by any key
+      return graphene::net::sync_block_header_check::invalid;
+   }
+}
+
 chain_id_type application_impl::get_chain_id() const
 {
    return _chain_db->get_chain_id();
@@ -938,6 +1376,7 @@ application::application()
 
 application::~application()
 {
+   graphene::utilities::task_monitor::chain_thread().stop_sampling();
    if( my->_p2p_network )
    {
       my->_p2p_network->close();
@@ -964,6 +1403,8 @@ void application::set_program_options(boost::program_options::options_descriptio
           "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"),
           "Endpoint for TLS websocket RPC to listen on")
+         ("metrics-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8091"),
+          "Endpoint for HTTP GET of metrics in the Prometheus text format to listen on")
          ("server-pem,p", bpo::value<string>()->implicit_value("server.pem"), "The TLS certificate file for this server")
          ("server-pem-password,P", bpo::value<string>()->implicit_value(""), "Password for this certificate")
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
@@ -975,12 +1416,89 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("block-log-format", bpo::value<string>(),
+          "Storage format of a new block database, either legacy or segmented (compressed, fixed-size segments)")
+         ("prune-blocks", bpo::value<uint32_t>(),
+          "Only keep this many blocks before the last irreversible block, older blocks are deleted and can neither "
+          "be served to peers nor replayed. Needs the segmented block log, see convert-block-log")
+         ("replay-checkpoint-interval", bpo::value<uint32_t>()->default_value(1000000),
+          "Save the object database every this many blocks while replaying, so that an interrupted replay resumes "
+          "from there. 0 only saves it close to the end")
+         ("parallel-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads of the scheduler that loads, saves, replays and precomputes in parallel, 0 for one per "
+          "CPU")
+         ("parallel-cpus", bpo::value<string>(),
+          "CPUs to pin the parallel-threads to, in order, e.g. 0-3,8 or node:1 for the CPUs of NUMA node 1 (Linux only)")
+         ("chain-cpus", bpo::value<string>(),
+          "CPUs the chain thread may run on, in the notation of parallel-cpus (Linux only)")
+         ("p2p-cpus", bpo::value<string>(),
+          "CPUs the p2p thread may run on, in the notation of parallel-cpus (Linux only)")
+         ("numa-node", bpo::value<uint32_t>(),
+          "Allocate memory on this NUMA node and run all threads without CPUs of their own on its CPUs (Linux only)")
+         ("state-journal", bpo::value<bool>()->implicit_value(true),
+          "Keep the changes of every applied block on disk, so that database_api::get_objects_at_block can show "
+          "objects as of past blocks")
+         ("verification-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads only used to verify signatures of blocks and transactions, 0 shares the threads used "
+          "for other parallel work")
+         ("verification-cpus", bpo::value<string>(),
+          "CPUs to pin the verification threads to, in order, in the notation of parallel-cpus (Linux only)")
+         ("startup-report", bpo::value<boost::filesystem::path>(),
+          "Write how long each step of the startup took to this JSON file once all plugins started, see also "
+          "network_node_api::get_startup_profile")
+         ("enable-api-metrics", bpo::value<bool>()->implicit_value(true),
+          "Count calls, errors, latency and request and response bytes of every RPC method, see "
+          "network_node_api::get_api_metrics")
+         ("enable-task-monitor", bpo::value<bool>()->implicit_value(true),
+          "Sample the task queue of the chain thread every second and time its tasks by source, see "
+          "network_node_api::get_task_monitor_report")
+         ("enable-tracing", bpo::value<bool>()->implicit_value(true),
+          "Record spans of the receipt, validation, application and notification of blocks, see "
+          "network_node_api::get_trace")
+         ("trace-buffer-size", bpo::value<uint32_t>()->default_value(65536),
+          "The most recent spans enable-tracing keeps, older ones are dropped")
+         ("api-max-pending-notifications", bpo::value<uint32_t>()->default_value(10000),
+          "Object and market notifications an API session can have waiting to be sent before "
+          "api-notification-overflow applies, 0 for no limit")
+         ("api-notification-overflow", bpo::value<string>()->default_value("coalesce"),
+          "What to do with the notifications of a session over api-max-pending-notifications: drop those of the "
+          "oldest blocks, coalesce them keeping the latest state of each object, or unsubscribe the session")
+         ("api-reader-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads that run read-only API calls like order book, account and history queries while the "
+          "chain thread applies blocks, 0 runs all API calls on the chain thread")
+         ("analyze-transaction-conflicts", bpo::value<bool>()->implicit_value(true),
+          "Count how many transactions of each block read or write objects written by earlier transactions of the "
+          "block and log how much of a replay could be applied in parallel. Transactions are still applied serially")
+         ("block-cache-size", bpo::value<uint32_t>()->default_value(500),
+          "Number of recently applied or requested blocks to keep deserialized in memory, 0 to disable")
+         ("signature-cache-size", bpo::value<uint32_t>()->default_value(50000),
+          "Number of public keys recovered from transaction signatures to keep in memory, so that transactions "
+          "received before their block are not verified again. 0 to disable")
+         ("key-string-cache-size", bpo::value<uint32_t>()->default_value(20000),
+          "Number of public keys and addresses to keep converted to and from their strings for the API, "
+          "0 to disable")
+         ("max-pending-transactions-size", bpo::value<uint32_t>()->default_value(0),
+          "Megabytes of pending transactions to keep, when they are reached new transactions have to pay more fee "
+          "per byte than the ones they replace. 0 for no limit")
+         ("max-pending-transactions-per-account", bpo::value<uint32_t>()->default_value(0),
+          "Number of pending transactions one fee payer can have, 0 for no limit")
+         ("pack-blocks-by-fee", bpo::value<bool>()->implicit_value(true),
+          "Fill produced blocks with the pending transactions that pay the most fee per byte first, instead of in "
+          "the order they arrived")
+         ("memory-usage-log-interval", bpo::value<uint32_t>(),
+          "Log the estimated memory usage of every object index at most once per this many seconds, 0 to disable")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
          ("replay-blockchain", "Rebuild object graph by replaying all blocks without validation")
          ("revalidate-blockchain", "Rebuild object graph by replaying all blocks with full validation")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("convert-block-log", "Convert an existing legacy block database to the segmented format on startup")
+         ("import-blocks", bpo::value<boost::filesystem::path>(),
+          "Append the blocks of another node's blockchain directory to the block database, checking their ids and "
+          "merkle roots in parallel, and replay them on startup")
+         ("bootstrap-from-snapshot", bpo::value<boost::filesystem::path>(),
+          "Start a new node from a binary snapshot of the snapshot plugin instead of replaying from genesis")
          ("force-validate", "Force validation of all transactions during normal operation")
          ("genesis-timestamp", bpo::value<uint32_t>(),
           "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
@@ -999,6 +1517,15 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
       const uint16_t num_threads = options["io-threads"].as<uint16_t>();
       fc::asio::default_io_service_scope::set_num_threads(num_threads);
    }
+
+   // threads started from here on, also those of the scheduler, inherit the memory policy
+   if( options.count("numa-node") )
+      graphene::utilities::prefer_numa_node_memory( options.at("numa-node").as<uint32_t>() );
+
+   // before anything runs on the scheduler, opening the database already does
+   graphene::db::task_scheduler::configure_shared(
+         options.count("parallel-threads") ? options.at("parallel-threads").as<uint32_t>() : 0,
+         detail::parse_cpu_list( options, "parallel-cpus" ) );
 }
 
 void application::startup()
@@ -1069,6 +1596,7 @@ void application::shutdown_plugins()
 }
 void application::shutdown()
 {
+   graphene::utilities::task_monitor::chain_thread().stop_sampling();
    if( my->_p2p_network )
       my->_p2p_network->close();
    if( my->_chain_db )
@@ -1081,7 +1609,11 @@ void application::shutdown()
 void application::initialize_plugins( const boost::program_options::variables_map& options )
 {
    for( auto& entry : my->_active_plugins )
+   {
+      const fc::time_point start = fc::time_point::now();
       entry.second->plugin_initialize( options );
+      my->_app_options.startup->record_since( "plugin " + entry.second->plugin_name() + " initialize", start );
+   }
    return;
 }
 
@@ -1089,9 +1621,28 @@ void application::startup_plugins()
 {
    for( auto& entry : my->_active_plugins )
    {
+      const fc::time_point start = fc::time_point::now();
       entry.second->plugin_startup();
+      my->_app_options.startup->record_since( "plugin " + entry.second->plugin_name() + " startup", start );
       ilog( "Plugin ${name} started", ( "name", entry.second->plugin_name() ) );
    }
+
+   if( my->_options != nullptr )
+      my->place_threads();
+
+   if( my->_options != nullptr && my->_options->count("startup-report") )
+   {
+      const fc::path report = my->_options->at("startup-report").as<boost::filesystem::path>();
+      try
+      {
+         my->_app_options.startup->write_report( report );
+         ilog( "Wrote the startup report to ${f}", ("f", report) );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Unable to write the startup report to ${f}: ${e}", ("f", report)("e", e.to_detail_string()) );
+      }
+   }
    return;
 }
 
@@ -30,10 +30,18 @@ class application_impl : public net::node_delegate
 
       void reset_websocket_tls_server();
 
+      /// serves render_metrics() over plain HTTP on the metrics-endpoint, if it is set
+      void reset_metrics_server();
+
+      /// @return the state of the node in the Prometheus text format, called on the chain thread
+      std::string render_metrics()const;
+
       explicit application_impl(application* self)
          : _self(self),
            _chain_db(std::make_shared<chain::database>())
       {
+         _app_options.startup = std::make_shared<startup_profile>();
+         _app_options.block_apply_latency = std::make_shared<block_apply_histogram>();
       }
 
       virtual ~application_impl()
@@ -44,6 +52,9 @@ class application_impl : public net::node_delegate
 
       void startup();
 
+      /// restricts the chain and p2p threads to their CPUs and logs where the threads of the node run
+      void place_threads();
+
       fc::optional< api_access_info > get_api_access_info(const string& username)const;
 
       void set_api_access_info(const string& username, api_access_info&& permissions);
@@ -66,6 +77,9 @@ class application_impl : public net::node_delegate
 
       virtual void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
+      /** precomputes all the transactions in parallel before pushing them one by one */
+      virtual std::vector<fc::oexception> handle_transactions(const std::vector<graphene::net::trx_message>& transaction_messages) override;
+
       void handle_message(const graphene::net::message& message_to_process);
 
       bool is_included_block(const graphene::chain::block_id_type& block_id);
@@ -88,6 +102,25 @@ class application_impl : public net::node_delegate
        */
       virtual graphene::net::message get_item(const graphene::net::item_id& id) override;
 
+      /**
+       * The headers of blocks, up to the first one we don't have, unpacked from the front of the stored blocks.
+       */
+      virtual std::vector<graphene::chain::signed_block_header> get_block_headers(
+            const std::vector<graphene::net::item_hash_t>& block_ids ) override;
+
+      /**
+       * Checks the signature of a header far ahead of our head block against the key our head block knows
+       * for its witness.
+       */
+      virtual graphene::net::sync_block_header_check check_sync_block_header(
+            const graphene::chain::signed_block_header& header ) override;
+
+      /**
+       * The given transactions among the pending ones, for rebuilding a compact block.
+       */
+      virtual std::vector<fc::optional<graphene::chain::precomputable_transaction>> find_pending_transactions(
+            const std::vector<graphene::chain::transaction_id_type>& ids ) override;
+
       virtual graphene::chain::chain_id_type get_chain_id()const override;
 
       /**
@@ -191,6 +224,7 @@ class application_impl : public net::node_delegate
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
+      std::shared_ptr<fc::http::websocket_server>      _metrics_server;
 
       std::map<string, std::shared_ptr<abstract_plugin>> _active_plugins;
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
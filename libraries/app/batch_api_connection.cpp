@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/batch_api_connection.hpp>
+#include <graphene/app/application.hpp>
+
+#include <graphene/utilities/task_monitor.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/rpc/state.hpp>
+#include <fc/variant_object.hpp>
+
+
+namespace graphene { namespace app {
+
+namespace {
+   /// makes run_read_only() call inline, the state can not change while the calls of a batch do not yield
+   struct inline_read_only_calls
+   {
+      inline_read_only_calls() : _previous( detail::in_read_only_call() ) { detail::in_read_only_call() = true; }
+      ~inline_read_only_calls() { detail::in_read_only_call() = _previous; }
+      bool _previous;
+   };
+
+   std::string batch_error( int64_t code, const std::string& message )
+   {
+      return fc::json::to_string( fc::mutable_variant_object( "id", fc::variant() )( "jsonrpc", "2.0" )
+                                  ( "error", fc::mutable_variant_object( "code", code )( "message", message ) ) );
+   }
+}
+
+notification_batch*& notification_batch::outermost()
+{
+   static thread_local notification_batch* batch = nullptr;
+   return batch;
+}
+
+notification_batch::notification_batch() : _outermost( outermost() == nullptr )
+{
+   if( _outermost )
+      outermost() = this;
+}
+
+notification_batch::~notification_batch()
+{
+   if( !_outermost )
+      return;
+   // sending may run handlers which start notifying again, those are not batched any more
+   outermost() = nullptr;
+   for( const auto& weak_connection : _connections )
+   {
+      const auto connection = weak_connection.lock();
+      if( !connection )
+         continue;
+      try
+      {
+         connection->send_pending_notices();
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Failed to send batched notices: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+}
+
+notification_batch* notification_batch::current()
+{
+   return outermost();
+}
+
+batch_websocket_api_connection::batch_websocket_api_connection( fc::http::websocket_connection& c,
+                                                                uint32_t max_conversion_depth )
+   : fc::rpc::websocket_api_connection( c, max_conversion_depth ),
+     _max_depth( max_conversion_depth ), _batch_notifications( false )
+{
+   // replace the handlers installed by websocket_api_connection, single requests still go to on_message()
+   _connection.on_message_handler( [this]( const std::string& msg ){ on_batch_message( msg, true ); } );
+   _connection.on_http_handler( [this]( const std::string& msg ){ return on_batch_message( msg, false ); } );
+}
+
+void batch_websocket_api_connection::send_notice( uint64_t callback_id, fc::variants args )
+{
+   notification_batch* batch = notification_batch::current();
+   if( !_batch_notifications || batch == nullptr )
+      return fc::rpc::websocket_api_connection::send_notice( callback_id, std::move(args) );
+   // the batch may end after the connection closed, on another thread than the one closing it
+   if( _pending_notices.empty() )
+      batch->_connections.push_back( std::static_pointer_cast<batch_websocket_api_connection>( shared_from_this() ) );
+   fc::variants params;
+   params.reserve( 2 );
+   params.emplace_back( callback_id );
+   params.emplace_back( std::move(args) );
+   fc::rpc::request notice{ fc::optional<uint64_t>(), "notice", std::move(params) };
+   _pending_notices.emplace_back( notice, _max_depth );
+}
+
+void batch_websocket_api_connection::send_pending_notices()
+{
+   if( _pending_notices.empty() )
+      return;
+   fc::variants notices;
+   std::swap( notices, _pending_notices );
+   _connection.send_message( encode_notices( notices, _max_depth ) );
+}
+
+std::string batch_websocket_api_connection::encode_notices( const fc::variants& notices,
+                                                            uint32_t max_conversion_depth )
+{
+   if( notices.size() == 1 )
+      return fc::json::to_string( notices.front(), fc::json::stringify_large_ints_and_doubles, max_conversion_depth );
+   return fc::json::to_string( fc::variant( notices ), fc::json::stringify_large_ints_and_doubles,
+                               max_conversion_depth );
+}
+
+fc::optional<std::string> batch_websocket_api_connection::dispatch_batch( const std::string& message,
+                                             const std::function<std::string(const std::string&)>& dispatch )
+{
+   const size_t first = message.find_first_not_of( " \t\r\n" );
+   if( first == std::string::npos || message[first] != '[' )
+      return fc::optional<std::string>();
+
+   fc::variants requests;
+   try
+   {
+      requests = fc::json::from_string( message ).get_array();
+   }
+   catch( const fc::exception& )
+   {
+      return batch_error( -32700, "Parse error" );
+   }
+   if( requests.empty() )
+      return batch_error( -32600, "Empty batch" );
+   if( requests.size() > max_batch_size )
+      return batch_error( -32600, "Batch of " + std::to_string( requests.size() ) + " requests exceeds the limit of "
+                                  + std::to_string( max_batch_size ) );
+
+   std::string result = "[";
+   {
+      inline_read_only_calls guard;
+      for( const auto& request : requests )
+      {
+         const std::string response = dispatch( fc::json::to_string( request ) );
+         if( response.empty() )
+            continue;
+         if( result.size() > 1 )
+            result += ',';
+         result += response;
+      }
+   }
+   result += ']';
+   // a batch of notifications only has no response
+   if( result.size() == 2 )
+      return std::string();
+   return result;
+}
+
+fc::optional<std::string> batch_websocket_api_connection::dispatch_json_call( const std::string& message,
+                                             const std::vector<json_call_route>& routes, uint32_t max_conversion_depth )
+{
+   // most requests call none of the routes, see that before parsing them
+   const json_call_route* route = nullptr;
+   for( const auto& candidate : routes )
+      if( message.find( '"' + candidate.method + '"' ) != std::string::npos )
+         route = &candidate;
+   if( route == nullptr )
+      return fc::optional<std::string>();
+
+   try
+   {
+      const fc::variant_object request = fc::json::from_string( message ).get_object();
+      if( !request.contains( "id" ) || !request["id"].is_integer() || !request.contains( "method" )
+            || request["method"].as_string() != "call" || !request.contains( "params" ) )
+         return fc::optional<std::string>();
+      const fc::variants& params = request["params"].get_array();
+      if( params.size() < 2 || !params[1].is_string() )
+         return fc::optional<std::string>();
+      const std::string method = params[1].as_string();
+      route = nullptr;
+      for( const auto& candidate : routes )
+         if( candidate.method == method
+               && ( params[0].is_string() ? params[0].as_string() == candidate.api_name
+                                          : params[0].is_integer() && params[0].as_uint64() == candidate.api_id ) )
+            route = &candidate;
+      if( route == nullptr )
+         return fc::optional<std::string>();
+
+      const fc::variants args = params.size() > 2 ? params[2].get_array() : fc::variants();
+      const std::string result = route->call( args, max_conversion_depth );
+      // the way fc::rpc::response is written, the id is stored as an int64_t
+      return R"({"id":)" + fc::json::to_string( fc::variant( request["id"].as_int64() ),
+                                                   fc::json::stringify_large_ints_and_doubles )
+             + R"(,"jsonrpc":"2.0","result":)" + result + '}';
+   }
+   catch( const fc::exception& )
+   {
+      // fc answers the request again, with the error it reports for it
+      return fc::optional<std::string>();
+   }
+}
+
+std::string batch_websocket_api_connection::on_request( const std::string& message, bool send_message )
+{
+   auto reply = dispatch_json_call( message, _json_calls, _max_depth );
+   if( !reply.valid() )
+      return on_message( message, send_message );
+   if( send_message )
+      _connection.send_message( *reply );
+   return *reply;
+}
+
+std::string batch_websocket_api_connection::on_batch_message( const std::string& message, bool send_message )
+{
+   // the websocket server runs the handlers of its connections on the chain thread
+   graphene::utilities::task_monitor::scope run( graphene::utilities::task_monitor::chain_thread(), "api call" );
+   auto reply = dispatch_batch( message, [this]( const std::string& request ) {
+      return on_request( request, false );
+   });
+   if( !reply.valid() )
+      return on_request( message, send_message );
+   if( send_message && !reply->empty() )
+      _connection.send_message( *reply );
+   return *reply;
+}
+
+} } // graphene::app
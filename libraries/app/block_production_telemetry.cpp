@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/block_production_telemetry.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+const size_t block_production_telemetry::max_records;
+
+void block_production_telemetry::record( const block_production_record& r )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _records.push_back( r );
+   if( _records.size() > max_records )
+      _records.pop_front();
+}
+
+void block_production_telemetry::set_broadcast_time( uint32_t block_num, const fc::microseconds& elapsed )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   // the broadcast finishes soon after the record was added, it is one of the last ones
+   for( auto itr = _records.rbegin(); itr != _records.rend(); ++itr )
+      if( itr->block_num == block_num )
+      {
+         itr->broadcast_us = elapsed.count();
+         return;
+      }
+}
+
+std::vector<block_production_record> block_production_telemetry::get_recent( uint32_t limit )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   std::vector<block_production_record> result;
+   result.reserve( std::min<size_t>( limit, _records.size() ) );
+   for( auto itr = _records.rbegin(); itr != _records.rend() && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
+}
+
+} }
@@ -23,10 +23,15 @@
  */
 
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/api_metrics.hpp>
+#include <graphene/app/application.hpp>
+#include <graphene/app/batch_api_connection.hpp>
 #include <graphene/app/util.hpp>
 #include <graphene/chain/get_config.hpp>
 
-#include <fc/bloom_filter.hpp>
+#include <graphene/utilities/task_monitor.hpp>
+
+#include <graphene/db/trace.hpp>
 
 #include <fc/crypto/hex.hpp>
 #include <fc/uint128.hpp>
@@ -37,15 +42,417 @@
 
 #include <cctype>
 
+#include <array>
 #include <cfenv>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
 
-typedef std::map< std::pair<graphene::chain::asset_id_type, graphene::chain::asset_id_type>, std::vector<fc::variant> > market_queue_type;
-
 namespace graphene { namespace app {
 
+class database_api_impl;
+
+namespace detail {
+
+/**
+ * Market tickers computed for the current head block, shared by all API sessions. Sessions drop the entries on
+ * applied_block, they are also tagged with the database and its head block in case no session is connected.
+ */
+class market_ticker_cache
+{
+   public:
+      static market_ticker_cache& instance()
+      {
+         static market_ticker_cache cache;
+         return cache;
+      }
+
+      bool get_top_markets( const database& db, uint32_t limit, vector<market_ticker>& result )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         check_head( db );
+         auto itr = _top_markets.find( limit );
+         if( itr == _top_markets.end() )
+            return false;
+         result = itr->second;
+         return true;
+      }
+
+      void set_top_markets( const database& db, uint32_t limit, const vector<market_ticker>& result )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         check_head( db );
+         _top_markets[limit] = result;
+      }
+
+      bool get_ticker( const database& db, const string& key, market_ticker& result )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         check_head( db );
+         auto itr = _tickers.find( key );
+         if( itr == _tickers.end() )
+            return false;
+         result = itr->second;
+         return true;
+      }
+
+      void set_ticker( const database& db, const string& key, const market_ticker& result )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         check_head( db );
+         if( _tickers.size() < max_tickers )
+            _tickers[key] = result;
+      }
+
+      void invalidate()
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         _db = nullptr;
+         _top_markets.clear();
+         _tickers.clear();
+      }
+
+   private:
+      /// bounds the memory used by requests for many different markets within one block
+      static const size_t max_tickers = 10000;
+
+      void check_head( const database& db )
+      {
+         if( _db == &db && _head == db.head_block_id() )
+            return;
+         _db = &db;
+         _head = db.head_block_id();
+         _top_markets.clear();
+         _tickers.clear();
+      }
+
+      std::mutex                                        _mutex;
+      const database*                                   _db = nullptr;
+      block_id_type                                     _head;
+      std::unordered_map<uint32_t,vector<market_ticker>> _top_markets;
+      std::unordered_map<string,market_ticker>           _tickers;
+};
+
+/**
+ * Variants of objects, converted once and shared by all API sessions of a database.
+ *
+ * Objects of the frequently read types, like the global properties and the assets, are cached until they are
+ * modified or removed, which the cache learns as an observer of their indexes. get_objects() and the notifications
+ * use these. Other objects are only cached for the notifications of the head block.
+ */
+class object_variant_cache : public index_observer
+{
+   public:
+      /// the cache of db, created on first use, must be called on the chain thread
+      static std::shared_ptr<object_variant_cache> get( database& db );
+
+      /// the variant of obj if its type is cached, converted on a miss, safe to call from reader threads
+      variant to_variant( const object& obj );
+
+      /// the variants of objects like to_variant(), null for nullptr, locking the cache once for all of them
+      fc::variants to_variants( const vector<const object*>& objects );
+
+      /// the variant of obj for notifications about the head block, only used on the chain thread
+      const variant& head_block_variant( const database& db, const object& obj );
+
+      void on_add( const object& obj ) override    { invalidate( obj.id ); }
+      void on_remove( const object& obj ) override { invalidate( obj.id ); }
+      void on_modify( const object& obj ) override { invalidate( obj.id ); }
+
+   private:
+      template<typename ObjectType>
+      void observe( database& db, const std::shared_ptr<object_variant_cache>& self )
+      {
+         db.add_index_observer( ObjectType::space_id, ObjectType::type_id, self );
+         _cached_types.insert( std::make_pair( uint8_t( ObjectType::space_id ), uint8_t( ObjectType::type_id ) ) );
+      }
+
+      bool is_cached_type( object_id_type id )const
+      {
+         return _cached_types.find( std::make_pair( id.space(), id.type() ) ) != _cached_types.end();
+      }
+
+      void invalidate( object_id_type id )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         _variants.erase( id );
+      }
+
+      /// fixed once the observers are installed
+      flat_set< std::pair<uint8_t,uint8_t> > _cached_types;
+
+      std::mutex                                _mutex;
+      std::unordered_map<object_id_type,variant> _variants;
+
+      block_id_type                             _head;
+      std::map<object_id_type,variant>          _head_block_variants;
+};
+
+/// Parts of a full_account that are rebuilt together by get_full_accounts_since()
+enum full_account_section
+{
+   account_section,
+   balances_section,
+   vesting_balances_section,
+   limit_orders_section,
+   call_orders_section,
+   settle_orders_section,
+   proposals_section,
+   assets_section,
+   withdraws_section,
+   full_account_section_count
+};
+
+static const uint32_t all_full_account_sections = ( 1u << full_account_section_count ) - 1;
+
+/**
+ * When each section of each account changed last, as a number that grows with every change. The numbers are the
+ * change tokens of get_full_accounts_since(). They start at the current time shifted into the upper half, so that
+ * the tokens of an earlier run of the node fall outside the range of this one.
+ */
+class account_change_log
+{
+   public:
+      /// the log of db, created and installed on first use, must be called on the chain thread
+      static std::shared_ptr<account_change_log> get( database& db );
+
+      uint64_t token()const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         return _next;
+      }
+
+      /// the sections of account changed after token as a bit mask, all of them if token is unknown
+      uint32_t changed_since( account_id_type account, uint64_t token )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( token < _first || token > _next )
+            return all_full_account_sections;
+         auto itr = _changes.find( account.instance.value );
+         if( itr == _changes.end() )
+            return 0;
+         uint32_t result = 0;
+         for( size_t section = 0; section < full_account_section_count; ++section )
+            if( itr->second[section] > token )
+               result |= 1u << section;
+         return result;
+      }
+
+      void mark( account_id_type account, full_account_section section )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _changes.find( account.instance.value );
+         if( itr == _changes.end() )
+         {
+            // forget everything rather than grow without bound, older tokens then mean a full refresh
+            if( _changes.size() >= max_accounts )
+            {
+               _changes.clear();
+               _first = _next;
+            }
+            itr = _changes.emplace( account.instance.value, std::array<uint64_t,full_account_section_count>() ).first;
+            itr->second.fill( 0 );
+         }
+         itr->second[section] = ++_next;
+      }
+
+   private:
+      static const size_t max_accounts = 100000;
+
+      mutable std::mutex _mutex;
+      uint64_t           _first = uint64_t( fc::time_point::now().sec_since_epoch() ) << 32;
+      uint64_t           _next = _first;
+      std::unordered_map< uint64_t, std::array<uint64_t,full_account_section_count> > _changes;
+};
+
+/// Marks the sections of the accounts affected by changes of the tracked index in an account_change_log
+template<typename ObjectType>
+class account_change_tracker : public secondary_index
+{
+   public:
+      explicit account_change_tracker( std::shared_ptr<account_change_log> log ) : _log( std::move(log) ) {}
+
+      virtual void object_inserted( const object& obj ) override   { mark( obj ); }
+      virtual void object_removed( const object& obj ) override    { mark( obj ); }
+      virtual void about_to_modify( const object& before ) override { mark( before ); }
+      virtual void object_modified( const object& after ) override  { mark( after ); }
+
+   private:
+      void mark( const object& obj ) { mark_accounts( static_cast<const ObjectType&>( obj ) ); }
+
+      void mark_accounts( const account_object& a )             { _log->mark( a.id, account_section ); }
+      void mark_accounts( const account_statistics_object& s )  { _log->mark( s.owner, account_section ); }
+      void mark_accounts( const account_balance_object& b )     { _log->mark( b.owner, balances_section ); }
+      void mark_accounts( const limit_order_object& o )         { _log->mark( o.seller, limit_orders_section ); }
+      void mark_accounts( const call_order_object& o )          { _log->mark( o.borrower, call_orders_section ); }
+      void mark_accounts( const force_settlement_object& o )    { _log->mark( o.owner, settle_orders_section ); }
+      void mark_accounts( const asset_object& a )               { _log->mark( a.issuer, assets_section ); }
+      void mark_accounts( const withdraw_permission_object& w )
+      {
+         _log->mark( w.withdraw_from_account, withdraws_section );
+      }
+      void mark_accounts( const vesting_balance_object& v )
+      {
+         // the cashback balance is part of the account section
+         _log->mark( v.owner, vesting_balances_section );
+         _log->mark( v.owner, account_section );
+      }
+      void mark_accounts( const proposal_object& p )
+      {
+         // the accounts required_approval_index lists the proposal for
+         for( const auto& a : p.required_active_approvals )  _log->mark( a, proposals_section );
+         for( const auto& a : p.required_owner_approvals )   _log->mark( a, proposals_section );
+         for( const auto& a : p.available_active_approvals ) _log->mark( a, proposals_section );
+         for( const auto& a : p.available_owner_approvals )  _log->mark( a, proposals_section );
+      }
+
+      std::shared_ptr<account_change_log> _log;
+};
+
+/// Notifications of one subscriber waiting to be sent, a later update of an object replaces the earlier one
+struct pending_updates
+{
+   vector<variant>                  updates;
+   flat_map<object_id_type,size_t>  positions;
+
+   void add( object_id_type id, const variant& update )
+   {
+      auto itr = positions.find( id );
+      if( itr != positions.end() )
+         updates[itr->second] = update;
+      else
+      {
+         positions.emplace( id, updates.size() );
+         updates.push_back( update );
+      }
+   }
+
+   /// adds the updates of later, which replace those of the same objects here
+   void merge( const pending_updates& later )
+   {
+      for( const auto& item : later.positions )
+         add( item.first, later.updates[item.second] );
+   }
+};
+
+/// Notifications of one subscriber caused by one block
+struct block_updates
+{
+   block_id_type                                                      block_id;
+   pending_updates                                                    objects;
+   std::map< std::pair<asset_id_type,asset_id_type>, pending_updates > markets;
+
+   size_t size()const
+   {
+      size_t result = objects.updates.size();
+      for( const auto& item : markets )
+         result += item.second.updates.size();
+      return result;
+   }
+
+   /// makes these the updates of both blocks, as if they were caused by the later one
+   void merge( const block_updates& later )
+   {
+      block_id = later.block_id;
+      objects.merge( later.objects );
+      for( const auto& item : later.markets )
+         markets[item.first].merge( item.second );
+   }
+};
+
+/**
+ * Which sessions of a database are subscribed to which objects, accounts and markets. It receives the object
+ * signals of the database once and passes each change only to the sessions subscribed to it, so the cost of a
+ * block scales with the subscribers of its changes rather than with the connected sessions. Only used on the
+ * chain thread.
+ */
+class subscription_registry
+{
+   public:
+      typedef std::pair<asset_id_type,asset_id_type> market_type;
+
+      /// the registry of db, shared by its sessions, created with the first one and freed with the last one
+      static std::shared_ptr<subscription_registry> get( database& db );
+
+      explicit subscription_registry( database& db );
+
+      void subscribe_to_object( database_api_impl* session, object_id_type id ) { _objects[id].insert( session ); }
+      void unsubscribe_from_object( database_api_impl* session, object_id_type id ) { erase( _objects, id, session ); }
+      void subscribe_to_account( database_api_impl* session, account_id_type id ) { _accounts[id].insert( session ); }
+      void unsubscribe_from_account( database_api_impl* session, account_id_type id ) { erase( _accounts, id, session ); }
+      void subscribe_to_market( database_api_impl* session, const market_type& market ) { _markets[market].insert( session ); }
+      void unsubscribe_from_market( database_api_impl* session, const market_type& market ) { erase( _markets, market, session ); }
+      /// whether session is sent all created and removed objects
+      void set_notify_all( database_api_impl* session, bool notify_all );
+
+   private:
+      typedef flat_set<database_api_impl*> sessions_type;
+
+      template<typename Key>
+      static void erase( std::map<Key,sessions_type>& subscriptions, const Key& key, database_api_impl* session )
+      {
+         auto itr = subscriptions.find( key );
+         if( itr == subscriptions.end() )
+            return;
+         itr->second.erase( session );
+         if( itr->second.empty() )
+            subscriptions.erase( itr );
+      }
+
+      void notify( const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts,
+                   const std::function<const object*(object_id_type)>& find_object, bool full_object, bool notify_all );
+      optional<market_type> get_order_market( const object& obj )const;
+
+      database&                             _db;
+      std::map<object_id_type,sessions_type>  _objects;
+      std::map<account_id_type,sessions_type> _accounts;
+      std::map<market_type,sessions_type>     _markets;
+      sessions_type                         _notify_all;
+
+      boost::signals2::scoped_connection    _new_connection;
+      boost::signals2::scoped_connection    _change_connection;
+      boost::signals2::scoped_connection    _removed_connection;
+};
+
+/**
+ * Parses an id of the form "space.type.instance" without allocating. Returns nothing for anything else, the caller
+ * then converts through a variant, which accepts the same ids and reports why the others are wrong.
+ */
+template<typename IdType>
+optional<IdType> parse_object_id( const std::string& s )
+{
+   uint64_t parts[3] = { 0, 0, 0 };
+   size_t part = 0;
+   bool has_digit = false;
+   for( char c : s )
+   {
+      if( c == '.' )
+      {
+         if( !has_digit || ++part == 3 )
+            return optional<IdType>();
+         has_digit = false;
+      }
+      else if( c >= '0' && c <= '9' )
+      {
+         parts[part] = parts[part] * 10 + uint64_t( c - '0' );
+         if( parts[part] > GRAPHENE_DB_MAX_INSTANCE_ID )
+            return optional<IdType>();
+         has_digit = true;
+      }
+      else
+         return optional<IdType>();
+   }
+   if( part != 2 || !has_digit || parts[0] != IdType::space_id || parts[1] != IdType::type_id )
+      return optional<IdType>();
+   return IdType( parts[2] );
+}
+
+} // detail
+
+
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
@@ -55,6 +462,8 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       // Objects
       fc::variants get_objects(const vector<object_id_type>& ids)const;
+      vector<vector<char>> get_objects_packed(const vector<object_id_type>& ids)const;
+      fc::variants get_objects_at_block(const vector<object_id_type>& ids, uint32_t block_num)const;
 
       // Subscriptions
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool notify_remove_create );
@@ -83,6 +492,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       account_id_type get_account_id_from_string(const std::string& name_or_id)const;
       vector<optional<account_object>> get_accounts(const vector<std::string>& account_names_or_ids)const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
+      full_accounts_update get_full_accounts_since( const vector<string>& names_or_ids, uint64_t change_token )const;
       optional<account_object> get_account_by_name( string name )const;
       vector<account_id_type> get_account_references( const std::string account_id_or_name )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
@@ -93,6 +503,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<asset> get_account_balances(const std::string& account_name_or_id, const flat_set<asset_id_type>& assets)const;
       vector<asset> get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const;
       vector<balance_object> get_balance_objects( const vector<address>& addrs )const;
+      vector<balance_object> get_balance_objects_by_keys( const vector<public_key_type>& keys )const;
       vector<asset> get_vested_balances( const vector<balance_id_type>& objs )const;
       vector<vesting_balance_object> get_vesting_balances( const std::string account_id_or_name )const;
 
@@ -116,6 +527,10 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<collateral_bid_object>      get_collateral_bids(const std::string& asset, uint32_t limit, uint32_t start)const;
 
       void subscribe_to_market(std::function<void(const variant&)> callback, const std::string& a, const std::string& b);
+      void subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                      const std::string& base, const std::string& quote );
+      void unsubscribe_from_market_depth( const std::string& base, const std::string& quote );
+      market_depth get_market_depth( const std::string& base, const std::string& quote )const;
       void unsubscribe_from_market(const std::string& a, const std::string& b);
 
       market_ticker                      get_ticker( const string& base, const string& quote, bool skip_order_book = false )const;
@@ -155,6 +570,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       bool verify_authority( const signed_transaction& trx )const;
       bool verify_account_authority( const string& account_name_or_id, const flat_set<public_key_type>& signers )const;
       processed_transaction validate_transaction( const signed_transaction& trx )const;
+      vector< dry_run_operation > dry_run_transaction( const signed_transaction& trx )const;
       vector< fc::variant > get_required_fees( const vector<operation>& ops, const std::string& asset_id_or_symbol )const;
 
       // Proposed transactions
@@ -170,73 +586,77 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
    //private:
       static string price_to_string( const price& _price, const asset_object& _base, const asset_object& _quote );
 
+      /**
+       * Appends the trades of the order history entries [itr, end) of one market, newest first, to result until
+       * it has limit trades or an entry is older than stop. The two directions of a fill are merged into one trade,
+       * the entry with the sequence skip is left out along with its other direction.
+       * @return false if the entries ran out before, unless end_is_final they continue in history_index
+       */
+      template<typename Iterator, typename ToTrade>
+      static bool append_market_trades( Iterator itr, Iterator end, bool end_is_final, ToTrade to_trade,
+                                        const asset_object& base, const asset_object& quote,
+                                        fc::time_point_sec stop, unsigned limit, optional<int64_t> skip,
+                                        vector<market_trade>& result );
+
       template<typename T>
       void subscribe_to_item( const T& i )const
       {
-         auto vec = fc::raw::pack(i);
-         if( !_subscribe_callback )
-            return;
-
-         if( !is_subscribed_to_item(i) )
-            _subscribe_filter.insert( vec.data(), vec.size() );
+         subscribe_to_item( i, std::is_convertible<T,object_id_type>() );
       }
 
       template<typename T>
-      bool is_subscribed_to_item( const T& i )const
+      void subscribe_to_item( const T& i, std::true_type )const
       {
          if( !_subscribe_callback )
-            return false;
-
-         return _subscribe_filter.contains( i );
-      }
-
-      bool is_impacted_account( const flat_set<account_id_type>& accounts)
-      {
-         if( !_subscribed_accounts.size() || !accounts.size() )
-            return false;
+            return;
 
-         return std::any_of(accounts.begin(), accounts.end(), [this](const account_id_type& account) {
-            return _subscribed_accounts.find(account) != _subscribed_accounts.end();
-         });
+         if( _subscribed_objects.insert( i ).second )
+            _registry->subscribe_to_object( const_cast<database_api_impl*>( this ), i );
       }
 
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const force_settlement_object& order )
-      {
-         // TODO cache the result to avoid repeatly fetching from db
-         asset_id_type backing_id = order.balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
-         auto tmp = std::make_pair( order.balance.asset_id, backing_id );
-         if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
-         return tmp;
-      }
+      /// keys and addresses, no object change is matched against them
+      template<typename T>
+      void subscribe_to_item( const T&, std::false_type )const {}
 
-      const account_object* get_account_from_string( const std::string& name_or_id ) const
+      const account_object* get_account_from_string( const std::string& name_or_id,
+                                                     bool throw_if_not_found = true ) const
       {
          // TODO cache the result to avoid repeatly fetching from db
          FC_ASSERT( name_or_id.size() > 0);
          const account_object* account = nullptr;
          if (std::isdigit(name_or_id[0]))
-            account = _db.find(fc::variant(name_or_id, 1).as<account_id_type>(1));
+         {
+            const optional<account_id_type> id = detail::parse_object_id<account_id_type>( name_or_id );
+            account = _db.find( id.valid() ? *id : fc::variant(name_or_id, 1).as<account_id_type>(1) );
+         }
          else
          {
-            const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
+            const auto& idx = _db.get_index_type<account_index>().indices().get<by_hashed_name>();
             auto itr = idx.find(name_or_id);
             if (itr != idx.end())
                account = &*itr;
          }
-         FC_ASSERT( account, "no such account" );
+         if( throw_if_not_found )
+            FC_ASSERT( account, "no such account" );
          return account;
       }
 
+      /// the sections of account given by the bit mask, see detail::full_account_section
+      full_account build_full_account( const account_object& account, uint32_t sections )const;
+
       const asset_object* get_asset_from_string( const std::string& symbol_or_id ) const
       {
          // TODO cache the result to avoid repeatly fetching from db
          FC_ASSERT( symbol_or_id.size() > 0);
          const asset_object* asset = nullptr;
          if (std::isdigit(symbol_or_id[0]))
-            asset = _db.find(fc::variant(symbol_or_id, 1).as<asset_id_type>(1));
+         {
+            const optional<asset_id_type> id = detail::parse_object_id<asset_id_type>( symbol_or_id );
+            asset = _db.find( id.valid() ? *id : fc::variant(symbol_or_id, 1).as<asset_id_type>(1) );
+         }
          else
          {
-            const auto& idx = _db.get_index_type<asset_index>().indices().get<by_symbol>();
+            const auto& idx = _db.get_index_type<asset_index>().indices().get<by_hashed_symbol>();
             auto itr = idx.find(symbol_or_id);
             if (itr != idx.end())
                asset = &*itr;
@@ -290,49 +710,162 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return result;
       }
 
-      template<typename T>
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const T& order )
+      /// like get_limit_orders(), read from the published indexes of the database without the state lock
+      vector<limit_order_object> get_published_limit_orders( const std::string& a, const std::string& b,
+                                                             uint32_t limit )const
       {
-         return order.get_market();
+         FC_ASSERT( limit <= 300 );
+
+         const asset_id_type asset_a_id = get_published_asset_id( a );
+         const asset_id_type asset_b_id = get_published_asset_id( b );
+
+         published_limit_order_index::reader orders( *_db.published_limit_orders() );
+         vector<limit_order_object> result;
+         result.reserve( limit * 2 );
+         for( const auto& side : { std::make_pair( asset_a_id, asset_b_id ), std::make_pair( asset_b_id, asset_a_id ) } )
+         {
+            const auto* side_orders = orders.find( side );
+            if( side_orders == nullptr )
+               continue;
+            const size_t count = std::min<size_t>( limit, side_orders->size() );
+            for( size_t i = 0; i < count; ++i )
+               result.push_back( *(*side_orders)[i] );
+         }
+         return result;
       }
 
-      template<typename T>
-      void enqueue_if_subscribed_to_market(const object* obj, market_queue_type& queue, bool full_object=true)
+      /// like get_asset_from_string(), from the published indexes of the database
+      asset_id_type get_published_asset_id( const std::string& symbol_or_id )const
       {
-         const T* order = dynamic_cast<const T*>(obj);
-         FC_ASSERT( order != nullptr);
-
-         const auto& market = get_order_market( *order );
+         const auto asset = find_published_asset( symbol_or_id );
+         FC_ASSERT( asset, "no such asset" );
+         return asset->get_id();
+      }
 
-         auto sub = _market_subscriptions.find( market );
-         if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id, 1) );
+      /// the published asset with the symbol or id, nullptr if there is none
+      std::shared_ptr<const asset_object> find_published_asset( const std::string& symbol_or_id )const
+      {
+         FC_ASSERT( symbol_or_id.size() > 0 );
+         if( std::isdigit( symbol_or_id[0] ) )
+         {
+            const optional<asset_id_type> parsed = detail::parse_object_id<asset_id_type>( symbol_or_id );
+            const asset_id_type id = parsed.valid() ? *parsed : fc::variant( symbol_or_id, 1 ).as<asset_id_type>( 1 );
+            published_asset_index::reader assets( *_db.published_assets() );
+            const auto* matches = assets.find( id );
+            return matches == nullptr ? nullptr : matches->front();
          }
+         published_asset_symbol_index::reader assets( *_db.published_asset_symbols() );
+         const auto* matches = assets.find( symbol_or_id );
+         return matches == nullptr ? nullptr : matches->front();
       }
 
-      void broadcast_updates( const vector<variant>& updates );
-      void broadcast_market_updates( const market_queue_type& queue);
-      void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
+      /// like get_call_orders(), read from the published indexes of the database without the state lock
+      vector<call_order_object> get_published_call_orders( const std::string& a, uint32_t limit )const
+      {
+         FC_ASSERT( limit <= 300 );
 
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts);
+         const auto mia = find_published_asset( a );
+         FC_ASSERT( mia, "no such asset" );
+         FC_ASSERT( mia->is_market_issued() );
+
+         published_call_order_index::reader calls( *_db.published_call_orders() );
+         vector<call_order_object> result;
+         const auto* debts = calls.find( mia->get_id() );
+         if( debts == nullptr )
+            return result;
+         const size_t count = std::min<size_t>( limit, debts->size() );
+         result.reserve( count );
+         for( size_t i = 0; i < count; ++i )
+            result.push_back( *(*debts)[i] );
+         return result;
+      }
+
+      /// like get_order_book(), the levels are summed up from the published limit orders without the state lock
+      order_book get_published_order_book( const string& base, const string& quote, unsigned limit )const
+      {
+         FC_ASSERT( limit <= 50 );
+
+         order_book result;
+         result.base = base;
+         result.quote = quote;
+
+         const auto base_asset = find_published_asset( base );
+         const auto quote_asset = find_published_asset( quote );
+         FC_ASSERT( base_asset, "Invalid base asset symbol: ${s}", ("s",base) );
+         FC_ASSERT( quote_asset, "Invalid quote asset symbol: ${s}", ("s",quote) );
+
+         published_limit_order_index::reader orders( *_db.published_limit_orders() );
+         // the orders of a side are sorted by price, the orders at one price are one level like in the depth index
+         const auto sum_levels = [&]( asset_id_type sell, asset_id_type receive, bool bids ) {
+            const auto* side = orders.find( std::make_pair( sell, receive ) );
+            if( side == nullptr )
+               return;
+            vector<order>& levels = bids ? result.bids : result.asks;
+            size_t i = 0;
+            while( i < side->size() && levels.size() < limit )
+            {
+               const price& level_price = (*side)[i]->sell_price;
+               share_type for_sale;
+               share_type to_receive;
+               for( ; i < side->size() && !( level_price > (*side)[i]->sell_price ); ++i )
+               {
+                  for_sale += (*side)[i]->for_sale;
+                  to_receive += limit_order_depth_index::to_receive( *(*side)[i] );
+               }
+               order ord;
+               ord.price = price_to_string( level_price, *base_asset, *quote_asset );
+               ord.quote = quote_asset->amount_to_string( bids ? to_receive : for_sale );
+               ord.base = base_asset->amount_to_string( bids ? for_sale : to_receive );
+               levels.push_back( ord );
+            }
+         };
+         sum_levels( base_asset->get_id(), quote_asset->get_id(), true );
+         sum_levels( quote_asset->get_id(), base_asset->get_id(), false );
+
+         return result;
+      }
+
+      /// the updates of the head block, a flush is scheduled when the first one is collected
+      detail::block_updates& head_block_updates();
+      /// applies the overflow policy of the options if the unsent updates exceed their limit
+      void limit_unsent_updates();
+      /// sends one notification per block and subscription for the blocks applied since the last flush
+      void flush_updates();
+
+      /** called by the subscription registry for every change of a block this session is subscribed to */
+      void queue_object_update( object_id_type id, bool full_object, const object* obj );
+      void queue_market_update( const std::pair<asset_id_type,asset_id_type>& market, const object& order, bool full_object );
       void on_applied_block();
+      void publish_market_depth();
 
       bool _notify_remove_create = false;
-      mutable fc::bloom_filter _subscribe_filter;
+      std::shared_ptr<detail::subscription_registry> _registry;
+      std::shared_ptr<detail::object_variant_cache>  _variant_cache;
+      std::shared_ptr<detail::account_change_log>    _account_changes;
+      mutable flat_set<object_id_type> _subscribed_objects;
       std::set<account_id_type> _subscribed_accounts;
       std::function<void(const fc::variant&)> _subscribe_callback;
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
+      std::deque<detail::block_updates> _unsent_updates;
+      /// set when the unsent updates overflowed with notification_overflow_policy::unsubscribe
+      bool                              _overflowed = false;
 
-      boost::signals2::scoped_connection                                                                                           _new_connection;
-      boost::signals2::scoped_connection                                                                                           _change_connection;
-      boost::signals2::scoped_connection                                                                                           _removed_connection;
       boost::signals2::scoped_connection                                                                                           _applied_block_connection;
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
+
+      /// the book of a depth subscription as of the last delta sent
+      struct market_depth_subscription
+      {
+         std::function<void(const variant&)>     callback;
+         uint64_t                                sequence = 0;
+         uint32_t                                block_num = 0;
+         limit_order_depth_index::price_levels   bids;
+         limit_order_depth_index::price_levels   asks;
+      };
+      /// keyed by (base, quote)
+      map< pair<asset_id_type,asset_id_type>, market_depth_subscription >                 _market_depth_subscriptions;
       graphene::chain::database&                                                                                                            _db;
       const application_options* _app_options = nullptr;
 };
@@ -349,18 +882,10 @@ database_api::database_api( graphene::chain::database& db, const application_opt
 database_api::~database_api() {}
 
 database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options )
-:_db(db), _app_options(app_options)
+:_registry( detail::subscription_registry::get( db ) ), _variant_cache( detail::object_variant_cache::get( db ) ),
+ _account_changes( detail::account_change_log::get( db ) ), _db(db), _app_options(app_options)
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
-                                });
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 
    _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
@@ -371,6 +896,7 @@ database_api_impl::database_api_impl( graphene::chain::database& db, const appli
 database_api_impl::~database_api_impl()
 {
    elog("freeing database api ${x}", ("x",int64_t(this)) );
+   cancel_all_subscriptions( true, true );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -443,19 +969,46 @@ fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)co
       }
    }
 
-   fc::variants result;
-   result.reserve(ids.size());
+   return _variant_cache->to_variants( _db.find_objects( ids ) );
+}
 
-   std::transform(ids.begin(), ids.end(), std::back_inserter(result),
-                  [this](object_id_type id) -> fc::variant {
-      if(auto obj = _db.find_object(id))
-         return obj->to_variant();
-      return {};
+vector<vector<char>> database_api::get_objects_packed(const vector<object_id_type>& ids)const
+{
+   auto impl = my;
+   return run_read_only< vector<vector<char>> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_objects_packed( ids );
    });
+}
+
+vector<vector<char>> database_api_impl::get_objects_packed(const vector<object_id_type>& ids)const
+{
+   vector<vector<char>> result;
+   result.reserve(ids.size());
+
+   for( const object* obj : _db.find_objects( ids ) )
+   {
+      if( obj != nullptr )
+         result.push_back( obj->pack() );
+      else
+         result.emplace_back();
+   }
 
    return result;
 }
 
+fc::variants database_api::get_objects_at_block(const vector<object_id_type>& ids, uint32_t block_num)const
+{
+   auto impl = my;
+   return run_read_only< fc::variants >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_objects_at_block( ids, block_num );
+   });
+}
+
+fc::variants database_api_impl::get_objects_at_block(const vector<object_id_type>& ids, uint32_t block_num)const
+{
+   return _db.get_objects_at_block( ids, block_num );
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Subscriptions                                                    //
@@ -479,6 +1032,7 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 
    _subscribe_callback = cb;
    _notify_remove_create = notify_remove_create;
+   _registry->set_notify_all( this, notify_remove_create );
 }
 
 void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb )
@@ -510,14 +1064,25 @@ void database_api_impl::cancel_all_subscriptions( bool reset_callback, bool rese
 {
    if ( reset_callback )
       _subscribe_callback = std::function<void(const fc::variant&)>();
+   _unsent_updates.clear();
+   _overflowed = false;
 
    if ( reset_market_subscriptions )
+   {
+      for( const auto& item : _market_subscriptions )
+         _registry->unsubscribe_from_market( this, item.first );
       _market_subscriptions.clear();
+      _market_depth_subscriptions.clear();
+   }
 
    _notify_remove_create = false;
+   _registry->set_notify_all( this, false );
+   for( const auto& account : _subscribed_accounts )
+      _registry->unsubscribe_from_account( this, account );
    _subscribed_accounts.clear();
-   static fc::bloom_parameters param(10000, 1.0/100, 1024*8*8*2);
-   _subscribe_filter = fc::bloom_filter(param);
+   for( const auto& id : _subscribed_objects )
+      _registry->unsubscribe_from_object( this, id );
+   _subscribed_objects.clear();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -533,7 +1098,7 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 
 optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
 {
-   auto result = _db.fetch_block_by_number(block_num);
+   auto result = _db.fetch_block_header_by_number(block_num);
    if(result)
       return *result;
    return {};
@@ -757,16 +1322,10 @@ vector<optional<account_object>> database_api_impl::get_accounts(const vector<st
 {
    vector<optional<account_object>> result; result.reserve(account_names_or_ids.size());
    std::transform(account_names_or_ids.begin(), account_names_or_ids.end(), std::back_inserter(result),
-                  [this](std::string id_or_name) -> optional<account_object> {
-
+                  [this](const std::string& id_or_name) -> optional<account_object> {
       const account_object* account = get_account_from_string(id_or_name);
-      account_id_type id = account->id;
-      if(auto o = _db.find(id))
-      {
-         subscribe_to_item( id );
-         return *o;
-      }
-      return {};
+      subscribe_to_item( account->get_id() );
+      return *account;
    });
    return result;
 }
@@ -774,7 +1333,10 @@ vector<optional<account_object>> database_api_impl::get_accounts(const vector<st
 vector<limit_order_object> database_api::get_account_limit_orders( const string& account_name_or_id, const string &base,
         const string &quote, uint32_t limit, optional<limit_order_id_type> ostart_id, optional<price> ostart_price)
 {
-   return my->get_account_limit_orders( account_name_or_id, base, quote, limit, ostart_id, ostart_price );
+   auto impl = my;
+   return run_read_only< vector<limit_order_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_account_limit_orders( account_name_or_id, base, quote, limit, ostart_id, ostart_price );
+   });
 }
 
 vector<limit_order_object> database_api_impl::get_account_limit_orders( const string& account_name_or_id, const string &base,
@@ -859,15 +1421,16 @@ vector<limit_order_object> database_api_impl::get_account_limit_orders( const st
 
 std::map<string,full_account> database_api::get_full_accounts( const vector<string>& names_or_ids, bool subscribe )
 {
-   return my->get_full_accounts( names_or_ids, subscribe );
+   if( subscribe )
+      return my->get_full_accounts( names_or_ids, subscribe );
+   auto impl = my;
+   return run_read_only< std::map<string,full_account> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_full_accounts( names_or_ids, false );
+   });
 }
 
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids, bool subscribe)
 {
-   const auto& proposal_idx = _db.get_index_type<proposal_index>();
-   const auto& pidx = dynamic_cast<const base_primary_index&>(proposal_idx);
-   const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
-
    std::map<std::string, full_account> results;
 
    for (const std::string& account_name_or_id : names_or_ids)
@@ -879,80 +1442,153 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       if( subscribe )
       {
          if(_subscribed_accounts.size() < 100) {
-            _subscribed_accounts.insert( account->get_id() );
+            if( _subscribed_accounts.insert( account->get_id() ).second )
+               _registry->subscribe_to_account( this, account->get_id() );
             subscribe_to_item( account->id );
          }
       }
 
-      full_account acnt;
-      acnt.account = *account;
-      acnt.statistics = account->statistics(_db);
-      acnt.registrar_name = account->registrar(_db).name;
-      acnt.referrer_name = account->referrer(_db).name;
-      acnt.lifetime_referrer_name = account->lifetime_referrer(_db).name;
-      acnt.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
+      results[account_name_or_id] = build_full_account( *account, detail::all_full_account_sections );
+   }
+   return results;
+}
 
-      if (account->cashback_vb)
+full_accounts_update database_api::get_full_accounts_since( const vector<string>& names_or_ids,
+                                                            uint64_t change_token )const
+{
+   auto impl = my;
+   return run_read_only< full_accounts_update >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_full_accounts_since( names_or_ids, change_token );
+   });
+}
+
+full_accounts_update database_api_impl::get_full_accounts_since( const vector<string>& names_or_ids,
+                                                                 uint64_t change_token )const
+{
+   static const char* const section_names[] = { "account", "balances", "vesting_balances", "limit_orders",
+                                                 "call_orders", "settle_orders", "proposals", "assets", "withdraws" };
+   static_assert( sizeof(section_names) / sizeof(section_names[0]) == detail::full_account_section_count,
+                  "A full_account section has no name" );
+
+   full_accounts_update result;
+   // taken first, a change made while the accounts are built is reported again by the next call
+   result.change_token = _account_changes->token();
+   for( const std::string& account_name_or_id : names_or_ids )
+   {
+      const account_object* account = get_account_from_string( account_name_or_id, false );
+      if( account == nullptr )
+         continue;
+      const uint32_t sections = _account_changes->changed_since( account->id, change_token );
+      if( sections == 0 )
+         continue;
+      full_account_update& update = result.accounts[account_name_or_id];
+      for( size_t section = 0; section < detail::full_account_section_count; ++section )
+         if( sections & ( 1u << section ) )
+            update.sections.push_back( section_names[section] );
+      update.content = build_full_account( *account, sections );
+   }
+   return result;
+}
+
+full_account database_api_impl::build_full_account( const account_object& account, uint32_t sections )const
+{
+   using namespace detail;
+   full_account acnt;
+   if( sections & ( 1u << account_section ) )
+   {
+      acnt.account = account;
+      acnt.statistics = account.statistics(_db);
+      acnt.registrar_name = account.registrar(_db).name;
+      acnt.referrer_name = account.referrer(_db).name;
+      acnt.lifetime_referrer_name = account.lifetime_referrer(_db).name;
+      acnt.votes = lookup_vote_ids( vector<vote_id_type>(account.options.votes.begin(),account.options.votes.end()) );
+
+      if (account.cashback_vb)
       {
-         acnt.cashback_balance = account->cashback_balance(_db);
+         acnt.cashback_balance = account.cashback_balance(_db);
       }
-      // Add the account's proposals
-      auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account->id );
+   }
+
+   // Add the account's proposals
+   if( sections & ( 1u << proposals_section ) )
+   {
+      const auto& proposal_idx = _db.get_index_type<proposal_index>();
+      const auto& pidx = dynamic_cast<const base_primary_index&>(proposal_idx);
+      const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
+      auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account.id );
       if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
       {
          acnt.proposals.reserve( required_approvals_itr->second.size() );
          for( auto proposal_id : required_approvals_itr->second )
             acnt.proposals.push_back( proposal_id(_db) );
       }
+   }
 
-
-      // Add the account's balances
-      const auto& balances = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< balances_by_account_index >().get_account_balances( account->id );
+   // Add the account's balances
+   if( sections & ( 1u << balances_section ) )
+   {
+      const auto& balances = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< balances_by_account_index >().get_account_balances( account.id );
       for( const auto balance : balances )
          acnt.balances.emplace_back( *balance.second );
+   }
 
-      // Add the account's vesting balances
-      auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account->id);
+   // Add the account's vesting balances
+   if( sections & ( 1u << vesting_balances_section ) )
+   {
+      auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account.id);
       std::for_each(vesting_range.first, vesting_range.second,
                     [&acnt](const vesting_balance_object& balance) {
                        acnt.vesting_balances.emplace_back(balance);
                     });
+   }
 
-      // Add the account's orders
-      auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account->id);
+   // Add the account's orders
+   if( sections & ( 1u << limit_orders_section ) )
+   {
+      auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account.id);
       std::for_each(order_range.first, order_range.second,
                     [&acnt] (const limit_order_object& order) {
                        acnt.limit_orders.emplace_back(order);
                     });
-      auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account->id);
+   }
+   if( sections & ( 1u << call_orders_section ) )
+   {
+      auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account.id);
       std::for_each(call_range.first, call_range.second,
                     [&acnt] (const call_order_object& call) {
                        acnt.call_orders.emplace_back(call);
                     });
-      auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account->id);
+   }
+   if( sections & ( 1u << settle_orders_section ) )
+   {
+      auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account.id);
       std::for_each(settle_range.first, settle_range.second,
                     [&acnt] (const force_settlement_object& settle) {
                        acnt.settle_orders.emplace_back(settle);
                     });
+   }
 
-      // get assets issued by user
-      auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account->id);
+   // get assets issued by user
+   if( sections & ( 1u << assets_section ) )
+   {
+      auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account.id);
       std::for_each(asset_range.first, asset_range.second,
                     [&acnt] (const asset_object& asset) {
                        acnt.assets.emplace_back(asset.id);
                     });
+   }
 
-      // get withdraws permissions
-      auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account->id);
+   // get withdraws permissions
+   if( sections & ( 1u << withdraws_section ) )
+   {
+      auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account.id);
       std::for_each(withdraw_range.first, withdraw_range.second,
                     [&acnt] (const withdraw_permission_object& withdraw) {
                        acnt.withdraws.emplace_back(withdraw);
                     });
-
-
-      results[account_name_or_id] = acnt;
    }
-   return results;
+
+   return acnt;
 }
 
 optional<account_object> database_api::get_account_by_name( string name )const
@@ -962,7 +1598,7 @@ optional<account_object> database_api::get_account_by_name( string name )const
 
 optional<account_object> database_api_impl::get_account_by_name( string name )const
 {
-   const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& idx = _db.get_index_type<account_index>().indices().get<by_hashed_name>();
    auto itr = idx.find(name);
    if (itr != idx.end())
       return *itr;
@@ -971,7 +1607,10 @@ optional<account_object> database_api_impl::get_account_by_name( string name )co
 
 vector<account_id_type> database_api::get_account_references( const std::string account_id_or_name )const
 {
-   return my->get_account_references( account_id_or_name );
+   auto impl = my;
+   return run_read_only< vector<account_id_type> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_account_references( account_id_or_name );
+   });
 }
 
 vector<account_id_type> database_api_impl::get_account_references( const std::string account_id_or_name )const
@@ -998,13 +1637,14 @@ vector<optional<account_object>> database_api::lookup_account_names(const vector
 
 vector<optional<account_object>> database_api_impl::lookup_account_names(const vector<string>& account_names)const
 {
-   const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& names = dynamic_cast<const base_primary_index&>( _db.get_index_type<account_index>() )
+                          .get_secondary_index<graphene::chain::account_name_index>();
    vector<optional<account_object> > result;
    result.reserve(account_names.size());
    std::transform(account_names.begin(), account_names.end(), std::back_inserter(result),
-                  [&accounts_by_name](const string& name) -> optional<account_object> {
-      auto itr = accounts_by_name.find(name);
-      return itr == accounts_by_name.end()? optional<account_object>() : *itr;
+                  [this,&names](const string& name) -> optional<account_object> {
+      const optional<account_id_type> id = names.find(name);
+      return id.valid() ? optional<account_object>( _db.get(*id) ) : optional<account_object>();
    });
    return result;
 }
@@ -1017,17 +1657,19 @@ map<string,account_id_type> database_api::lookup_accounts(const string& lower_bo
 map<string,account_id_type> database_api_impl::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
    FC_ASSERT( limit <= 1000 );
-   const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& names = dynamic_cast<const base_primary_index&>( _db.get_index_type<account_index>() )
+                          .get_secondary_index<graphene::chain::account_name_index>();
    map<string,account_id_type> result;
 
-   for( auto itr = accounts_by_name.lower_bound(lower_bound_name);
-        limit-- && itr != accounts_by_name.end();
-        ++itr )
-   {
-      result.insert(make_pair(itr->name, itr->get_id()));
+   names.for_each_from( lower_bound_name,
+                        [this,&result,&limit]( const graphene::chain::account_name_index::entry& e ) -> bool {
+      if( limit-- == 0 )
+         return false;
+      result.emplace_hint( result.end(), e.name, e.id );
       if( limit == 1 )
-         subscribe_to_item( itr->get_id() );
-   }
+         subscribe_to_item( e.id );
+      return true;
+   });
 
    return result;
 }
@@ -1050,7 +1692,10 @@ uint64_t database_api_impl::get_account_count()const
 
 vector<asset> database_api::get_account_balances(const std::string& account_name_or_id, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_account_balances( account_name_or_id, assets );
+   auto impl = my;
+   return run_read_only< vector<asset> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_account_balances( account_name_or_id, assets );
+   });
 }
 
 vector<asset> database_api_impl::get_account_balances(const std::string& account_name_or_id, const flat_set<asset_id_type>& assets)const
@@ -1079,7 +1724,10 @@ vector<asset> database_api_impl::get_account_balances(const std::string& account
 
 vector<asset> database_api::get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_account_balances( name, assets );
+   auto impl = my;
+   return run_read_only< vector<asset> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_account_balances( name, assets );
+   });
 }
 
 vector<balance_object> database_api::get_balance_objects( const vector<address>& addrs )const
@@ -1111,6 +1759,44 @@ vector<balance_object> database_api_impl::get_balance_objects( const vector<addr
    FC_CAPTURE_AND_RETHROW( (addrs) )
 }
 
+vector<balance_object> database_api::get_balance_objects_by_keys( const vector<public_key_type>& keys )const
+{
+   return my->get_balance_objects_by_keys( keys );
+}
+
+vector<balance_object> database_api_impl::get_balance_objects_by_keys( const vector<public_key_type>& keys )const
+{
+   try
+   {
+      FC_ASSERT( keys.size() <= 100, "At most 100 keys can be looked up at once" );
+      vector<address> owners;
+      owners.reserve( keys.size() * 5 );
+      for( const public_key_type& key : keys )
+      {
+         const auto forms = balance_claim_addresses( key );
+         owners.insert( owners.end(), forms.begin(), forms.end() );
+      }
+      // the owners are visited in the order of the index, each balance is returned once
+      std::sort( owners.begin(), owners.end() );
+      owners.erase( std::unique( owners.begin(), owners.end() ), owners.end() );
+
+      const auto& by_owner_idx = _db.get_index_type<balance_index>().indices().get<by_owner>();
+      vector<balance_object> result;
+      for( const address& owner : owners )
+      {
+         subscribe_to_item( owner );
+         auto itr = by_owner_idx.lower_bound( boost::make_tuple( owner, asset_id_type(0) ) );
+         while( itr != by_owner_idx.end() && itr->owner == owner )
+         {
+            result.push_back( *itr );
+            ++itr;
+         }
+      }
+      return result;
+   }
+   FC_CAPTURE_AND_RETHROW( (keys) )
+}
+
 vector<asset> database_api::get_vested_balances( const vector<balance_id_type>& objs )const
 {
    return my->get_vested_balances( objs );
@@ -1131,7 +1817,10 @@ vector<asset> database_api_impl::get_vested_balances( const vector<balance_id_ty
 
 vector<vesting_balance_object> database_api::get_vesting_balances( const std::string account_id_or_name )const
 {
-   return my->get_vesting_balances( account_id_or_name );
+   auto impl = my;
+   return run_read_only< vector<vesting_balance_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_vesting_balances( account_id_or_name );
+   });
 }
 
 vector<vesting_balance_object> database_api_impl::get_vesting_balances( const std::string account_id_or_name )const
@@ -1170,22 +1859,20 @@ vector<optional<asset_object>> database_api_impl::get_assets(const vector<std::s
 {
    vector<optional<asset_object>> result; result.reserve(asset_symbols_or_ids.size());
    std::transform(asset_symbols_or_ids.begin(), asset_symbols_or_ids.end(), std::back_inserter(result),
-                  [this](std::string id_or_name) -> optional<asset_object> {
+                  [this](const std::string& id_or_name) -> optional<asset_object> {
       const asset_object* asset = get_asset_from_string(id_or_name);
-      asset_id_type id = asset->id;
-      if(auto o = _db.find(id))
-      {
-         subscribe_to_item( id );
-         return *o;
-      }
-      return {};
+      subscribe_to_item( asset->get_id() );
+      return *asset;
    });
    return result;
 }
 
 vector<asset_object> database_api::list_assets(const string& lower_bound_symbol, uint32_t limit)const
 {
-   return my->list_assets( lower_bound_symbol, limit );
+   auto impl = my;
+   return run_read_only< vector<asset_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->list_assets( lower_bound_symbol, limit );
+   });
 }
 
 vector<asset_object> database_api_impl::list_assets(const string& lower_bound_symbol, uint32_t limit)const
@@ -1223,14 +1910,15 @@ vector<optional<asset_object>> database_api::lookup_asset_symbols(const vector<s
 
 vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vector<string>& symbols_or_ids)const
 {
-   const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<by_symbol>();
+   const auto& assets_by_symbol = _db.get_index_type<asset_index>().indices().get<by_hashed_symbol>();
    vector<optional<asset_object> > result;
    result.reserve(symbols_or_ids.size());
    std::transform(symbols_or_ids.begin(), symbols_or_ids.end(), std::back_inserter(result),
                   [this, &assets_by_symbol](const string& symbol_or_id) -> optional<asset_object> {
       if( !symbol_or_id.empty() && std::isdigit(symbol_or_id[0]) )
       {
-         auto ptr = _db.find(variant(symbol_or_id, 1).as<asset_id_type>(1));
+         const optional<asset_id_type> id = detail::parse_object_id<asset_id_type>( symbol_or_id );
+         auto ptr = _db.find( id.valid() ? *id : variant(symbol_or_id, 1).as<asset_id_type>(1) );
          return ptr == nullptr? optional<asset_object>() : *ptr;
       }
       auto itr = assets_by_symbol.find(symbol_or_id);
@@ -1247,7 +1935,13 @@ vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vec
 
 vector<limit_order_object> database_api::get_limit_orders(std::string a, std::string b, uint32_t limit)const
 {
-   return my->get_limit_orders( a, b, limit );
+   auto impl = my;
+   // the published orders are read on the calling thread, the chain thread keeps applying blocks meanwhile
+   if( impl->_db.published_limit_orders() != nullptr )
+      return impl->get_published_limit_orders( a, b, limit );
+   return run_read_only< vector<limit_order_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_limit_orders( a, b, limit );
+   });
 }
 
 /**
@@ -1265,7 +1959,12 @@ vector<limit_order_object> database_api_impl::get_limit_orders(const std::string
 
 vector<call_order_object> database_api::get_call_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_call_orders( a, limit );
+   auto impl = my;
+   if( impl->_db.published_call_orders() != nullptr )
+      return impl->get_published_call_orders( a, limit );
+   return run_read_only< vector<call_order_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_call_orders( a, limit );
+   });
 }
 
 vector<call_order_object> database_api_impl::get_call_orders(const std::string& a, uint32_t limit)const
@@ -1290,7 +1989,10 @@ vector<call_order_object> database_api_impl::get_call_orders(const std::string&
 
 vector<force_settlement_object> database_api::get_settle_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_settle_orders( a, limit );
+   auto impl = my;
+   return run_read_only< vector<force_settlement_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_settle_orders( a, limit );
+   });
 }
 
 vector<force_settlement_object> database_api_impl::get_settle_orders(const std::string& a, uint32_t limit)const
@@ -1314,7 +2016,10 @@ vector<force_settlement_object> database_api_impl::get_settle_orders(const std::
 
 vector<call_order_object> database_api::get_margin_positions( const std::string account_id_or_name )const
 {
-   return my->get_margin_positions( account_id_or_name );
+   auto impl = my;
+   return run_read_only< vector<call_order_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_margin_positions( account_id_or_name );
+   });
 }
 
 vector<call_order_object> database_api_impl::get_margin_positions( const std::string account_id_or_name )const
@@ -1338,7 +2043,10 @@ vector<call_order_object> database_api_impl::get_margin_positions( const std::st
 
 vector<collateral_bid_object> database_api::get_collateral_bids(const std::string& asset, uint32_t limit, uint32_t start)const
 {
-   return my->get_collateral_bids( asset, limit, start );
+   auto impl = my;
+   return run_read_only< vector<collateral_bid_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_collateral_bids( asset, limit, start );
+   });
 }
 
 vector<collateral_bid_object> database_api_impl::get_collateral_bids(const std::string& asset, uint32_t limit, uint32_t skip)const
@@ -1368,29 +2076,197 @@ void database_api::subscribe_to_market(std::function<void(const variant&)> callb
    my->subscribe_to_market( callback, a, b );
 }
 
-void database_api_impl::subscribe_to_market(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+void database_api_impl::subscribe_to_market(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+{
+   auto asset_a_id = get_asset_from_string(a)->id;
+   auto asset_b_id = get_asset_from_string(b)->id;
+
+   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+   _market_subscriptions[ std::make_pair(asset_a_id,asset_b_id) ] = callback;
+   _registry->subscribe_to_market( this, std::make_pair(asset_a_id,asset_b_id) );
+}
+
+void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
+{
+   my->unsubscribe_from_market( a, b );
+}
+
+void database_api_impl::unsubscribe_from_market(const std::string& a, const std::string& b)
+{
+   auto asset_a_id = get_asset_from_string(a)->id;
+   auto asset_b_id = get_asset_from_string(b)->id;
+
+   if(a > b) std::swap(asset_a_id,asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+   if( _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id)) )
+      _registry->unsubscribe_from_market( this, std::make_pair(asset_a_id,asset_b_id) );
+}
+
+namespace detail {
+
+   const limit_order_depth_index& get_depth_index( const database& db )
+   {
+      const auto& idx = dynamic_cast<const base_primary_index&>( db.get_index_type<limit_order_index>() );
+      return idx.get_secondary_index<graphene::chain::limit_order_depth_index>();
+   }
+
+   const limit_order_depth_index::price_levels& get_levels( const limit_order_depth_index& depth,
+                                                             asset_id_type sell, asset_id_type receive )
+   {
+      static const limit_order_depth_index::price_levels no_levels;
+      const auto* levels = depth.find_side( sell, receive );
+      return levels == nullptr ? no_levels : *levels;
+   }
+
+   market_depth_level make_level( const price& p, const limit_order_price_level& level )
+   {
+      market_depth_level result;
+      result.sell_price = p;
+      result.for_sale = level.for_sale;
+      result.to_receive = level.to_receive;
+      result.order_count = level.order_count;
+      return result;
+   }
+
+   void copy_levels( const limit_order_depth_index::price_levels& levels, vector<market_depth_level>& result )
+   {
+      result.reserve( levels.size() );
+      for( const auto& level : levels )
+         result.push_back( make_level( level.first, level.second ) );
+   }
+
+   /// adds the levels that differ between the two books to changes, best first
+   void diff_levels( const limit_order_depth_index::price_levels& before,
+                     const limit_order_depth_index::price_levels& after, vector<market_depth_level>& changes )
+   {
+      const auto comes_first = before.key_comp();
+      auto b = before.begin();
+      auto a = after.begin();
+      while( b != before.end() || a != after.end() )
+      {
+         if( a == after.end() || ( b != before.end() && comes_first( b->first, a->first ) ) )
+         {
+            changes.push_back( make_level( b->first, limit_order_price_level() ) );
+            ++b;
+         }
+         else if( b == before.end() || comes_first( a->first, b->first ) )
+         {
+            changes.push_back( make_level( a->first, a->second ) );
+            ++a;
+         }
+         else
+         {
+            if( a->second.for_sale != b->second.for_sale || a->second.to_receive != b->second.to_receive
+                  || a->second.order_count != b->second.order_count )
+               changes.push_back( make_level( a->first, a->second ) );
+            ++a;
+            ++b;
+         }
+      }
+   }
+
+} // detail
+
+void database_api::subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                              const std::string& base, const std::string& quote )
+{
+   my->subscribe_to_market_depth( callback, base, quote );
+}
+
+void database_api_impl::subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                                   const std::string& base, const std::string& quote )
+{
+   auto base_id = get_asset_from_string( base )->id;
+   auto quote_id = get_asset_from_string( quote )->id;
+   FC_ASSERT( base_id != quote_id );
+
+   const auto& depth = detail::get_depth_index( _db );
+   market_depth_subscription& sub = _market_depth_subscriptions[ std::make_pair( base_id, quote_id ) ];
+   sub.callback = callback;
+   sub.block_num = _db.head_block_num();
+   sub.bids = detail::get_levels( depth, base_id, quote_id );
+   sub.asks = detail::get_levels( depth, quote_id, base_id );
+}
+
+void database_api::unsubscribe_from_market_depth( const std::string& base, const std::string& quote )
+{
+   my->unsubscribe_from_market_depth( base, quote );
+}
+
+void database_api_impl::unsubscribe_from_market_depth( const std::string& base, const std::string& quote )
+{
+   auto base_id = get_asset_from_string( base )->id;
+   auto quote_id = get_asset_from_string( quote )->id;
+   _market_depth_subscriptions.erase( std::make_pair( base_id, quote_id ) );
+}
+
+market_depth database_api::get_market_depth( const std::string& base, const std::string& quote )const
 {
-   auto asset_a_id = get_asset_from_string(a)->id;
-   auto asset_b_id = get_asset_from_string(b)->id;
-
-   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
-   FC_ASSERT(asset_a_id != asset_b_id);
-   _market_subscriptions[ std::make_pair(asset_a_id,asset_b_id) ] = callback;
+   return my->get_market_depth( base, quote );
 }
 
-void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
+market_depth database_api_impl::get_market_depth( const std::string& base, const std::string& quote )const
 {
-   my->unsubscribe_from_market( a, b );
+   market_depth result;
+   result.base = get_asset_from_string( base )->id;
+   result.quote = get_asset_from_string( quote )->id;
+   FC_ASSERT( result.base != result.quote );
+
+   auto sub = _market_depth_subscriptions.find( std::make_pair( result.base, result.quote ) );
+   if( sub != _market_depth_subscriptions.end() )
+   {
+      result.sequence = sub->second.sequence;
+      result.block_num = sub->second.block_num;
+      detail::copy_levels( sub->second.bids, result.bids );
+      detail::copy_levels( sub->second.asks, result.asks );
+      return result;
+   }
+
+   const auto& depth = detail::get_depth_index( _db );
+   result.block_num = _db.head_block_num();
+   detail::copy_levels( detail::get_levels( depth, result.base, result.quote ), result.bids );
+   detail::copy_levels( detail::get_levels( depth, result.quote, result.base ), result.asks );
+   return result;
 }
 
-void database_api_impl::unsubscribe_from_market(const std::string& a, const std::string& b)
+void database_api_impl::publish_market_depth()
 {
-   auto asset_a_id = get_asset_from_string(a)->id;
-   auto asset_b_id = get_asset_from_string(b)->id;
+   if( _market_depth_subscriptions.empty() )
+      return;
 
-   if(a > b) std::swap(asset_a_id,asset_b_id);
-   FC_ASSERT(asset_a_id != asset_b_id);
-   _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id));
+   const auto& depth = detail::get_depth_index( _db );
+   vector< pair< std::function<void(const variant&)>, market_depth > > deltas;
+   for( auto& item : _market_depth_subscriptions )
+   {
+      market_depth_subscription& sub = item.second;
+      const auto& bids = detail::get_levels( depth, item.first.first, item.first.second );
+      const auto& asks = detail::get_levels( depth, item.first.second, item.first.first );
+      sub.block_num = _db.head_block_num();
+
+      market_depth delta;
+      detail::diff_levels( sub.bids, bids, delta.bids );
+      detail::diff_levels( sub.asks, asks, delta.asks );
+      if( delta.bids.empty() && delta.asks.empty() )
+         continue;
+
+      sub.bids = bids;
+      sub.asks = asks;
+      delta.base = item.first.first;
+      delta.quote = item.first.second;
+      delta.sequence = ++sub.sequence;
+      delta.block_num = sub.block_num;
+      deltas.emplace_back( sub.callback, std::move( delta ) );
+   }
+   if( deltas.empty() )
+      return;
+
+   /// we need to ensure the database_api is not deleted for the life of the async operation
+   auto capture_this = shared_from_this();
+   graphene::utilities::monitored_async([capture_this,deltas](){
+      for( const auto& delta : deltas )
+         delta.first( fc::variant( delta.second, GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+   }, "database_api market depth");
 }
 
 string database_api_impl::price_to_string( const price& _price, const asset_object& _base, const asset_object& _quote )
@@ -1405,13 +2281,22 @@ string database_api_impl::price_to_string( const price& _price, const asset_obje
 
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
 {
-    return my->get_ticker( base, quote );
+   auto impl = my;
+   return run_read_only< market_ticker >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_ticker( base, quote );
+   });
 }
 
 market_ticker database_api_impl::get_ticker( const string& base, const string& quote, bool skip_order_book )const
 {
    FC_ASSERT( _app_options && _app_options->has_market_history_plugin, "Market history plugin is not enabled." );
 
+   // symbols don't contain spaces
+   const string cache_key = base + ' ' + quote + ( skip_order_book ? " 0" : " 1" );
+   market_ticker cached;
+   if( detail::market_ticker_cache::instance().get_ticker( _db, cache_key, cached ) )
+      return cached;
+
    const auto assets = lookup_asset_symbols( {base, quote} );
 
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
@@ -1430,10 +2315,13 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
       {
          orders = get_order_book(assets[0]->symbol, assets[1]->symbol, 1);
       }
-      return market_ticker(*itr, now, *assets[0], *assets[1], orders);
+      market_ticker result( *itr, now, *assets[0], *assets[1], orders );
+      detail::market_ticker_cache::instance().set_ticker( _db, cache_key, result );
+      return result;
    }
    // if no ticker is found for this market we return an empty ticker
    market_ticker empty_result;
+   detail::market_ticker_cache::instance().set_ticker( _db, cache_key, empty_result );
    return empty_result;
 }
 
@@ -1458,12 +2346,16 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   auto impl = my;
+   if( impl->_db.published_limit_orders() != nullptr )
+      return impl->get_published_order_book( base, quote, limit );
+   return run_read_only< order_book >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_order_book( base, quote, limit);
+   });
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   using boost::multiprecision::uint128_t;
    FC_ASSERT( limit <= 50 );
 
    order_book result;
@@ -1476,24 +2368,30 @@ order_book database_api_impl::get_order_book( const string& base, const string&
 
    auto base_id = assets[0]->id;
    auto quote_id = assets[1]->id;
-   auto orders = get_limit_orders( base_id, quote_id, limit );
+   const auto& depth = detail::get_depth_index( _db );
 
-   for( const auto& o : orders )
+   // orders at the same price are one level
+   const auto* bids = depth.find_side( base_id, quote_id );
+   if( bids != nullptr )
    {
-      if( o.sell_price.base.asset_id == base_id )
+      for( auto itr = bids->begin(); itr != bids->end() && result.bids.size() < limit; ++itr )
       {
          order ord;
-         ord.price = price_to_string( o.sell_price, *assets[0], *assets[1] );
-         ord.quote = assets[1]->amount_to_string( share_type( ( uint128_t( o.for_sale.value ) * o.sell_price.quote.amount.value ) / o.sell_price.base.amount.value ) );
-         ord.base = assets[0]->amount_to_string( o.for_sale );
+         ord.price = price_to_string( itr->first, *assets[0], *assets[1] );
+         ord.quote = assets[1]->amount_to_string( itr->second.to_receive );
+         ord.base = assets[0]->amount_to_string( itr->second.for_sale );
          result.bids.push_back( ord );
       }
-      else
+   }
+   const auto* asks = depth.find_side( quote_id, base_id );
+   if( asks != nullptr )
+   {
+      for( auto itr = asks->begin(); itr != asks->end() && result.asks.size() < limit; ++itr )
       {
          order ord;
-         ord.price = price_to_string( o.sell_price, *assets[0], *assets[1] );
-         ord.quote = assets[1]->amount_to_string( o.for_sale );
-         ord.base = assets[0]->amount_to_string( share_type( ( uint128_t( o.for_sale.value ) * o.sell_price.quote.amount.value ) / o.sell_price.base.amount.value ) );
+         ord.price = price_to_string( itr->first, *assets[0], *assets[1] );
+         ord.quote = assets[1]->amount_to_string( itr->second.for_sale );
+         ord.base = assets[0]->amount_to_string( itr->second.to_receive );
          result.asks.push_back( ord );
       }
    }
@@ -1503,7 +2401,10 @@ order_book database_api_impl::get_order_book( const string& base, const string&
 
 vector<market_ticker> database_api::get_top_markets(uint32_t limit)const
 {
-   return my->get_top_markets(limit);
+   auto impl = my;
+   return run_read_only< vector<market_ticker> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_top_markets(limit);
+   });
 }
 
 vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
@@ -1512,9 +2413,12 @@ vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
 
    FC_ASSERT( limit <= 100 );
 
+   vector<market_ticker> result;
+   if( detail::market_ticker_cache::instance().get_top_markets( _db, limit, result ) )
+      return result;
+
    const auto& volume_idx = _db.get_index_type<graphene::market_history::market_ticker_index>().indices().get<by_volume>();
    auto itr = volume_idx.rbegin();
-   vector<market_ticker> result;
    result.reserve(limit);
    const fc::time_point_sec now = _db.head_block_time();
 
@@ -1528,6 +2432,7 @@ vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
       result.emplace_back(market_ticker(*itr, now, base, quote, orders));
       ++itr;
    }
+   detail::market_ticker_cache::instance().set_top_markets( _db, limit, result );
    return result;
 }
 
@@ -1537,7 +2442,79 @@ vector<market_trade> database_api::get_trade_history( const string& base,
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history( base, quote, start, stop, limit );
+   auto impl = my;
+   return run_read_only< vector<market_trade> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_trade_history( base, quote, start, stop, limit );
+   });
+}
+
+template<typename Iterator, typename ToTrade>
+bool database_api_impl::append_market_trades( Iterator itr, Iterator end, bool end_is_final, ToTrade to_trade,
+                                              const asset_object& base, const asset_object& quote,
+                                              fc::time_point_sec stop, unsigned limit, optional<int64_t> skip,
+                                              vector<market_trade>& result )
+{
+   using graphene::market_history::recent_trade;
+   while( result.size() < limit )
+   {
+      if( itr == end )
+         return end_is_final;
+      const recent_trade entry = to_trade( *itr );
+      if( entry.time < stop )
+         return true;
+
+      // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
+      auto next_itr = std::next( itr );
+      if( next_itr == end && !end_is_final )
+         return false;
+      optional<recent_trade> other;
+      if( next_itr != end )
+      {
+         recent_trade next = to_trade( *next_itr );
+         if( next.time == entry.time && next.is_maker != entry.is_maker )
+         {  // next now could be the other direction // FIXME not 100% sure
+            other = std::move( next );
+            // skip the other direction
+            itr = next_itr;
+         }
+      }
+      ++itr;
+
+      if( skip.valid() && entry.sequence == *skip )
+         continue;
+
+      market_trade trade;
+
+      if( base.id == entry.receives.asset_id )
+      {
+         trade.amount = quote.amount_to_string( entry.pays );
+         trade.value = base.amount_to_string( entry.receives );
+      }
+      else
+      {
+         trade.amount = quote.amount_to_string( entry.receives );
+         trade.value = base.amount_to_string( entry.pays );
+      }
+
+      trade.date = entry.time;
+      trade.price = price_to_string( entry.fill_price, base, quote );
+
+      auto add_side = [&trade]( const recent_trade& side ) {
+         if( side.is_maker )
+         {
+            trade.sequence = -side.sequence;
+            trade.side1_account_id = side.account_id;
+         }
+         else
+            trade.side2_account_id = side.account_id;
+      };
+      add_side( entry );
+      if( other.valid() )
+         add_side( *other );
+
+      result.push_back( trade );
+   }
+   return true;
 }
 
 vector<market_trade> database_api_impl::get_trade_history( const string& base,
@@ -1562,61 +2539,31 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
    if ( start.sec_since_epoch() == 0 )
       start = fc::time_point_sec( fc::time_point::now() );
 
-   uint32_t count = 0;
-   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_market_time>();
-   auto itr = history_idx.lower_bound( std::make_tuple( base_id, quote_id, start ) );
+   using graphene::market_history::recent_trade;
+   using graphene::market_history::order_history_object;
    vector<market_trade> result;
 
-   while( itr != history_idx.end() && count < limit && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
+   // the latest trades are usually in the ring of the market
+   const auto& rings = _db.get_index_type< primary_index< graphene::market_history::history_index > >()
+                          .get_secondary_index< graphene::market_history::recent_trades_index >();
+   const auto* ring = rings.find_market( base_id, quote_id );
+   if( ring != nullptr )
    {
-      {
-         market_trade trade;
-
-         if( assets[0]->id == itr->op.receives.asset_id )
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.pays );
-            trade.value = assets[0]->amount_to_string( itr->op.receives );
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.receives );
-            trade.value = assets[0]->amount_to_string( itr->op.pays );
-         }
-
-         trade.date = itr->time;
-         trade.price = price_to_string( itr->op.fill_price, *assets[0], *assets[1] );
-
-         if( itr->op.is_maker )
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
-
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if( next_itr->op.is_maker )
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
-            // skip the other direction
-            itr = next_itr;
-         }
-
-         result.push_back( trade );
-         ++count;
-      }
-
-      ++itr;
+      auto first = std::partition_point( ring->trades.begin(), ring->trades.end(),
+                                         [start]( const recent_trade& t ) { return t.time > start; } );
+      if( append_market_trades( first, ring->trades.end(),
+                                ring->boundary == std::numeric_limits<int64_t>::max(),
+                                []( const recent_trade& t ) { return t; },
+                                *assets[0], *assets[1], stop, limit, optional<int64_t>(), result ) )
+         return result;
+      result.clear();
    }
 
+   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_market_time>();
+   append_market_trades( history_idx.lower_bound( std::make_tuple( base_id, quote_id, start ) ),
+                         history_idx.upper_bound( std::make_tuple( base_id, quote_id ) ), true,
+                         []( const order_history_object& o ) { return recent_trade::from_history( o ); },
+                         *assets[0], *assets[1], stop, limit, optional<int64_t>(), result );
    return result;
 }
 
@@ -1627,7 +2574,10 @@ vector<market_trade> database_api::get_trade_history_by_sequence(
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history_by_sequence( base, quote, start, stop, limit );
+   auto impl = my;
+   return run_read_only< vector<market_trade> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_trade_history_by_sequence( base, quote, start, stop, limit );
+   });
 }
 
 vector<market_trade> database_api_impl::get_trade_history_by_sequence(
@@ -1651,77 +2601,37 @@ vector<market_trade> database_api_impl::get_trade_history_by_sequence(
    auto quote_id = assets[1]->id;
 
    if( base_id > quote_id ) std::swap( base_id, quote_id );
-   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-   history_key hkey;
-   hkey.base = base_id;
-   hkey.quote = quote_id;
-   hkey.sequence = start_seq;
 
-   uint32_t count = 0;
-   auto itr = history_idx.lower_bound( hkey );
+   using graphene::market_history::recent_trade;
+   using graphene::market_history::order_history_object;
    vector<market_trade> result;
 
-   while( itr != history_idx.end() && count < limit && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
+   // the latest trades are usually in the ring of the market
+   const auto& rings = _db.get_index_type< primary_index< graphene::market_history::history_index > >()
+                          .get_secondary_index< graphene::market_history::recent_trades_index >();
+   const auto* ring = rings.find_market( base_id, quote_id );
+   if( ring != nullptr && start_seq < ring->boundary )
    {
-      if( itr->key.sequence == start_seq ) // found the key, should skip this and the other direction if found
-      {
-         auto next_itr = std::next(itr);
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            // skip the other direction
-            itr = next_itr;
-         }
-      }
-      else
-      {
-         market_trade trade;
-
-         if( assets[0]->id == itr->op.receives.asset_id )
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.pays );
-            trade.value = assets[0]->amount_to_string( itr->op.receives );
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string( itr->op.receives );
-            trade.value = assets[0]->amount_to_string( itr->op.pays );
-         }
-
-         trade.date = itr->time;
-         trade.price = price_to_string( itr->op.fill_price, *assets[0], *assets[1] );
-
-         if( itr->op.is_maker )
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
-
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if( next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-             && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker )
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if( next_itr->op.is_maker )
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
-            // skip the other direction
-            itr = next_itr;
-         }
-
-         result.push_back( trade );
-         ++count;
-      }
-
-      ++itr;
+      auto first = std::lower_bound( ring->trades.begin(), ring->trades.end(), start_seq,
+                                     []( const recent_trade& t, int64_t seq ) { return t.sequence < seq; } );
+      if( append_market_trades( first, ring->trades.end(),
+                                ring->boundary == std::numeric_limits<int64_t>::max(),
+                                []( const recent_trade& t ) { return t; },
+                                *assets[0], *assets[1], stop, limit, start_seq, result ) )
+         return result;
+      result.clear();
    }
 
+   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
+   history_key hkey;
+   hkey.base = base_id;
+   hkey.quote = quote_id;
+   hkey.sequence = start_seq;
+   auto itr = history_idx.lower_bound( hkey );
+   hkey.sequence = std::numeric_limits<int64_t>::max();
+   append_market_trades( itr, history_idx.upper_bound( hkey ), true,
+                         []( const order_history_object& o ) { return recent_trade::from_history( o ); },
+                         *assets[0], *assets[1], stop, limit, start_seq, result );
    return result;
 }
 
@@ -1946,10 +2856,12 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
 {
    FC_ASSERT( votes.size() < 1000, "Only 1000 votes can be queried at a time" );
 
-   const auto& witness_idx = _db.get_index_type<witness_index>().indices().get<by_vote_id>();
-   const auto& committee_idx = _db.get_index_type<committee_member_index>().indices().get<by_vote_id>();
-   const auto& for_worker_idx = _db.get_index_type<worker_index>().indices().get<by_vote_for>();
-   const auto& against_worker_idx = _db.get_index_type<worker_index>().indices().get<by_vote_against>();
+   const auto& witness_idx = dynamic_cast<const base_primary_index&>( _db.get_index_type<witness_index>() )
+                                .get_secondary_index<witness_vote_id_index>();
+   const auto& committee_idx = dynamic_cast<const base_primary_index&>( _db.get_index_type<committee_member_index>() )
+                                  .get_secondary_index<committee_member_vote_id_index>();
+   const auto& worker_idx = dynamic_cast<const base_primary_index&>( _db.get_index_type<worker_index>() )
+                               .get_secondary_index<worker_vote_id_index>();
 
    vector<variant> result;
    result.reserve( votes.size() );
@@ -1959,40 +2871,32 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
       {
          case vote_id_type::committee:
          {
-            auto itr = committee_idx.find( id );
-            if( itr != committee_idx.end() )
-               result.emplace_back( variant( *itr, 2 ) ); // Depth of committee_member_object is 1, add 1 here to be safe
+            const committee_member_object* committee_member = committee_idx.find( id );
+            if( committee_member != nullptr )
+               result.emplace_back( variant( *committee_member, 2 ) ); // Depth of committee_member_object is 1, add 1 here to be safe
             else
                result.emplace_back( variant() );
             break;
          }
          case vote_id_type::witness:
          {
-            auto itr = witness_idx.find( id );
-            if( itr != witness_idx.end() )
-               result.emplace_back( variant( *itr, 2 ) ); // Depth of witness_object is 1, add 1 here to be safe
+            const witness_object* witness = witness_idx.find( id );
+            if( witness != nullptr )
+               result.emplace_back( variant( *witness, 2 ) ); // Depth of witness_object is 1, add 1 here to be safe
             else
                result.emplace_back( variant() );
             break;
          }
          case vote_id_type::worker:
          {
-            auto itr = for_worker_idx.find( id );
-            if( itr != for_worker_idx.end() ) {
-               result.emplace_back( variant( *itr, 4 ) ); // Depth of worker_object is 3, add 1 here to be safe.
-                                                          // If we want to extract the balance object inside,
-                                                          //   need to increase this value
-            }
-            else {
-               auto itr = against_worker_idx.find( id );
-               if( itr != against_worker_idx.end() ) {
-                  result.emplace_back( variant( *itr, 4 ) ); // Depth of worker_object is 3, add 1 here to be safe.
+            const worker_object* worker = worker_idx.find( id );
+            if( worker != nullptr ) {
+               result.emplace_back( variant( *worker, 4 ) ); // Depth of worker_object is 3, add 1 here to be safe.
                                                              // If we want to extract the balance object inside,
                                                              //   need to increase this value
-               }
-               else {
-                  result.emplace_back( variant() );
-               }
+            }
+            else {
+               result.emplace_back( variant() );
             }
             break;
          }
@@ -2168,9 +3072,25 @@ processed_transaction database_api_impl::validate_transaction( const signed_tran
    return _db.validate_transaction(trx);
 }
 
+vector< dry_run_operation > database_api::dry_run_transaction( const signed_transaction& trx )const
+{
+   auto impl = my;
+   return run_read_only< vector< dry_run_operation > >( impl->_db, impl->_app_options, [&] () {
+      return impl->dry_run_transaction( trx );
+   });
+}
+
+vector< dry_run_operation > database_api_impl::dry_run_transaction( const signed_transaction& trx )const
+{
+   return _db.dry_run_transaction( trx );
+}
+
 vector< fc::variant > database_api::get_required_fees( const vector<operation>& ops, const std::string& asset_id_or_symbol )const
 {
-   return my->get_required_fees( ops, asset_id_or_symbol );
+   auto impl = my;
+   return run_read_only< vector< fc::variant > >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_required_fees( ops, asset_id_or_symbol );
+   });
 }
 
 /**
@@ -2259,7 +3179,10 @@ vector< fc::variant > database_api_impl::get_required_fees( const vector<operati
 
 vector<proposal_object> database_api::get_proposed_transactions( const std::string account_id_or_name )const
 {
-   return my->get_proposed_transactions( account_id_or_name );
+   auto impl = my;
+   return run_read_only< vector<proposal_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_proposed_transactions( account_id_or_name );
+   });
 }
 
 /** TODO: add secondary index that will accelerate this process */
@@ -2314,7 +3237,10 @@ vector<blinded_balance_object> database_api_impl::get_blinded_balances( const fl
 
 vector<withdraw_permission_object> database_api::get_withdraw_permissions_by_giver(const std::string account_id_or_name, withdraw_permission_id_type start, uint32_t limit)const
 {
-   return my->get_withdraw_permissions_by_giver( account_id_or_name, start, limit );
+   auto impl = my;
+   return run_read_only< vector<withdraw_permission_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_withdraw_permissions_by_giver( account_id_or_name, start, limit );
+   });
 }
 
 vector<withdraw_permission_object> database_api_impl::get_withdraw_permissions_by_giver(const std::string account_id_or_name, withdraw_permission_id_type start, uint32_t limit)const
@@ -2336,7 +3262,10 @@ vector<withdraw_permission_object> database_api_impl::get_withdraw_permissions_b
 
 vector<withdraw_permission_object> database_api::get_withdraw_permissions_by_recipient(const std::string account_id_or_name, withdraw_permission_id_type start, uint32_t limit)const
 {
-   return my->get_withdraw_permissions_by_recipient( account_id_or_name, start, limit );
+   auto impl = my;
+   return run_read_only< vector<withdraw_permission_object> >( impl->_db, impl->_app_options, [&] () {
+      return impl->get_withdraw_permissions_by_recipient( account_id_or_name, start, limit );
+   });
 }
 
 vector<withdraw_permission_object> database_api_impl::get_withdraw_permissions_by_recipient(const std::string account_id_or_name, withdraw_permission_id_type start, uint32_t limit)const
@@ -2362,129 +3291,338 @@ vector<withdraw_permission_object> database_api_impl::get_withdraw_permissions_b
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+detail::block_updates& database_api_impl::head_block_updates()
 {
-   if( updates.size() && _subscribe_callback ) {
+   if( _unsent_updates.empty() )
+   {
+      // runs once the chain thread yields, after all object signals of the block
       auto capture_this = shared_from_this();
-      fc::async([capture_this,updates](){
-          if(capture_this->_subscribe_callback)
-            capture_this->_subscribe_callback( fc::variant(updates) );
-      });
+      graphene::utilities::monitored_async([capture_this](){
+         capture_this->flush_updates();
+      }, "database_api flush updates");
+   }
+   if( _unsent_updates.empty() || _unsent_updates.back().block_id != _db.head_block_id() )
+   {
+      limit_unsent_updates();
+      _unsent_updates.emplace_back();
+      _unsent_updates.back().block_id = _db.head_block_id();
    }
+   return _unsent_updates.back();
 }
 
-void database_api_impl::broadcast_market_updates( const market_queue_type& queue)
+void database_api_impl::limit_unsent_updates()
 {
-   if( queue.size() )
+   if( _app_options == nullptr || _app_options->max_pending_notifications == 0 || _overflowed )
+      return;
+   size_t pending = 0;
+   for( const auto& block : _unsent_updates )
+      pending += block.size();
+   if( pending <= _app_options->max_pending_notifications )
+      return;
+
+   notification_overflow_stats unused;
+   notification_overflow_stats& stats = _app_options->notification_overflows ? *_app_options->notification_overflows
+                                                                              : unused;
+   switch( _app_options->overflow_policy )
    {
-      auto capture_this = shared_from_this();
-      fc::async([capture_this, this, queue](){
-          for( const auto& item : queue )
-          {
-            auto sub = _market_subscriptions.find(item.first);
-            if( sub != _market_subscriptions.end() )
-                sub->second( fc::variant(item.second ) );
-          }
-      });
+      case notification_overflow_policy::drop_oldest:
+         while( pending > _app_options->max_pending_notifications && !_unsent_updates.empty() )
+         {
+            pending -= _unsent_updates.front().size();
+            stats.dropped += _unsent_updates.front().size();
+            _unsent_updates.pop_front();
+         }
+         break;
+      case notification_overflow_policy::coalesce:
+         // bounded by the objects changed rather than by the blocks, the oldest blocks are merged first
+         while( pending > _app_options->max_pending_notifications && _unsent_updates.size() > 1 )
+         {
+            detail::block_updates& oldest = _unsent_updates[0];
+            const size_t before = oldest.size() + _unsent_updates[1].size();
+            oldest.merge( _unsent_updates[1] );
+            _unsent_updates.erase( _unsent_updates.begin() + 1 );
+            stats.coalesced += before - oldest.size();
+            pending -= before - oldest.size();
+         }
+         break;
+      case notification_overflow_policy::unsubscribe:
+         // the subscriptions are cancelled by flush_updates(), the registry may be iterating over them now
+         wlog( "Unsubscribing API session ${s} with ${n} unsent notifications", ("s",int64_t(this))("n",pending) );
+         stats.dropped += pending;
+         ++stats.unsubscribed;
+         _unsent_updates.clear();
+         _overflowed = true;
+         break;
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts)
+void database_api_impl::flush_updates()
 {
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
+   graphene::db::trace_scope tracing( "flush_subscription_updates" );
+   if( _overflowed )
+   {
+      _overflowed = false;
+      cancel_all_subscriptions( true, true );
+      return;
+   }
 
-         if (it != objs.end())
-            return *it;
+   std::deque<detail::block_updates> unsent;
+   std::swap( unsent, _unsent_updates );
 
-         return nullptr;
+   // connections batching notifications send all the notices below at once
+   notification_batch batch;
+   for( const auto& block : unsent )
+   {
+      if( block.objects.updates.size() && _subscribe_callback )
+         _subscribe_callback( fc::variant(block.objects.updates) );
+      for( const auto& item : block.markets )
+      {
+         auto sub = _market_subscriptions.find(item.first);
+         if( sub != _market_subscriptions.end() )
+            sub->second( fc::variant(item.second.updates) );
       }
-   );
+   }
 }
 
-void database_api_impl::on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
+void database_api_impl::queue_object_update( object_id_type id, bool full_object, const object* obj )
 {
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   if( !_subscribe_callback )
+      return;
+   if( !full_object )
+      head_block_updates().objects.add( id, fc::variant( id, 1 ) );
+   else if( obj )
+      head_block_updates().objects.add( id, _variant_cache->head_block_variant( _db, *obj ) );
 }
 
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
+void database_api_impl::queue_market_update( const std::pair<asset_id_type,asset_id_type>& market, const object& order,
+                                             bool full_object )
 {
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   head_block_updates().markets[market].add( order.id,
+         full_object ? _variant_cache->head_block_variant( _db, order )
+                     : fc::variant( order.id, 1 ) );
 }
 
-void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object)
+namespace detail {
+
+std::shared_ptr<account_change_log> account_change_log::get( database& db )
 {
-   if( _subscribe_callback )
+   // the trackers in the indexes own the log, it expires with the database
+   static std::map< const database*, std::weak_ptr<account_change_log> > logs;
+   auto& entry = logs[&db];
+   auto log = entry.lock();
+   if( !log )
    {
-      vector<variant> updates;
+      log = std::make_shared<account_change_log>();
+      db.add_object_secondary_index< account_object, account_change_tracker<account_object> >( log );
+      db.add_object_secondary_index< account_statistics_object,
+                                     account_change_tracker<account_statistics_object> >( log );
+      db.add_object_secondary_index< account_balance_object, account_change_tracker<account_balance_object> >( log );
+      db.add_object_secondary_index< vesting_balance_object, account_change_tracker<vesting_balance_object> >( log );
+      db.add_object_secondary_index< limit_order_object, account_change_tracker<limit_order_object> >( log );
+      db.add_object_secondary_index< call_order_object, account_change_tracker<call_order_object> >( log );
+      db.add_object_secondary_index< force_settlement_object,
+                                     account_change_tracker<force_settlement_object> >( log );
+      db.add_object_secondary_index< proposal_object, account_change_tracker<proposal_object> >( log );
+      db.add_object_secondary_index< asset_object, account_change_tracker<asset_object> >( log );
+      db.add_object_secondary_index< withdraw_permission_object,
+                                     account_change_tracker<withdraw_permission_object> >( log );
+      entry = log;
+   }
+   return log;
+}
 
-      for(auto id : ids)
-      {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
-         {
-            if( full_object )
-            {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
-            }
-            else
-            {
-               updates.emplace_back( fc::variant( id, 1 ) );
-            }
-         }
-      }
+std::shared_ptr<object_variant_cache> object_variant_cache::get( database& db )
+{
+   // the indexes own the cache, it expires with the database
+   static std::map< const database*, std::weak_ptr<object_variant_cache> > caches;
+   auto& entry = caches[&db];
+   auto cache = entry.lock();
+   if( !cache )
+   {
+      cache = std::make_shared<object_variant_cache>();
+      cache->observe<global_property_object>( db, cache );
+      cache->observe<dynamic_global_property_object>( db, cache );
+      cache->observe<asset_object>( db, cache );
+      cache->observe<asset_dynamic_data_object>( db, cache );
+      cache->observe<asset_bitasset_data_object>( db, cache );
+      entry = cache;
+   }
+   return cache;
+}
+
+variant object_variant_cache::to_variant( const object& obj )
+{
+   if( !is_cached_type( obj.id ) )
+      return obj.to_variant();
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _variants.find( obj.id );
+   if( itr == _variants.end() )
+      itr = _variants.emplace( obj.id, obj.to_variant() ).first;
+   return itr->second;
+}
+
+fc::variants object_variant_cache::to_variants( const vector<const object*>& objects )
+{
+   fc::variants result( objects.size() );
+   bool has_cached_types = false;
+   for( size_t i = 0; i < objects.size(); ++i )
+   {
+      if( objects[i] == nullptr )
+         continue;
+      if( is_cached_type( objects[i]->id ) )
+         has_cached_types = true;
+      else
+         result[i] = objects[i]->to_variant();
+   }
+   if( !has_cached_types )
+      return result;
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   for( size_t i = 0; i < objects.size(); ++i )
+   {
+      if( objects[i] == nullptr || !is_cached_type( objects[i]->id ) )
+         continue;
+      auto itr = _variants.find( objects[i]->id );
+      if( itr == _variants.end() )
+         itr = _variants.emplace( objects[i]->id, objects[i]->to_variant() ).first;
+      result[i] = itr->second;
+   }
+   return result;
+}
+
+const variant& object_variant_cache::head_block_variant( const database& db, const object& obj )
+{
+   if( _head != db.head_block_id() )
+   {
+      _head = db.head_block_id();
+      _head_block_variants.clear();
+   }
+   auto itr = _head_block_variants.find( obj.id );
+   if( itr == _head_block_variants.end() )
+      itr = _head_block_variants.emplace( obj.id, to_variant( obj ) ).first;
+   return itr->second;
+}
+
+std::shared_ptr<subscription_registry> subscription_registry::get( database& db )
+{
+   static std::map< const database*, std::weak_ptr<subscription_registry> > registries;
+   auto& entry = registries[&db];
+   auto registry = entry.lock();
+   if( !registry )
+   {
+      registry = std::make_shared<subscription_registry>( db );
+      entry = registry;
+   }
+   return registry;
+}
+
+subscription_registry::subscription_registry( database& db ) : _db(db)
+{
+   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
+      notify( ids, impacted_accounts, std::bind(&object_database::find_object, &_db, std::placeholders::_1), true, true );
+   });
+   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
+      notify( ids, impacted_accounts, std::bind(&object_database::find_object, &_db, std::placeholders::_1), true, false );
+   });
+   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) {
+      notify( ids, impacted_accounts,
+         [&objs](object_id_type id) -> const object* {
+            auto it = std::find_if(
+                  objs.begin(), objs.end(),
+                  [id](const object* o) {return o != nullptr && o->id == id;});
+
+            if (it != objs.end())
+               return *it;
+
+            return nullptr;
+         }, false, true );
+   });
+}
+
+void subscription_registry::set_notify_all( database_api_impl* session, bool notify_all )
+{
+   if( notify_all )
+      _notify_all.insert( session );
+   else
+      _notify_all.erase( session );
+}
+
+optional<subscription_registry::market_type> subscription_registry::get_order_market( const object& obj )const
+{
+   if( obj.id.is<limit_order_object>() )
+      return static_cast<const limit_order_object&>( obj ).get_market();
+   if( obj.id.is<call_order_object>() )
+      return static_cast<const call_order_object&>( obj ).get_market();
+   if( obj.id.is<force_settlement_object>() )
+   {
+      const auto& order = static_cast<const force_settlement_object&>( obj );
+      asset_id_type backing_id = order.balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
+      auto tmp = std::make_pair( order.balance.asset_id, backing_id );
+      if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
+      return tmp;
+   }
+   return {};
+}
 
-      if( updates.size() )
-         broadcast_updates(updates);
+void subscription_registry::notify( const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts,
+                                    const std::function<const object*(object_id_type)>& find_object,
+                                    bool full_object, bool notify_all )
+{
+   // sessions that get every id, because they subscribed to all or to one of the impacted accounts
+   sessions_type all_ids;
+   if( notify_all )
+      all_ids = _notify_all;
+   for( const auto& account : impacted_accounts )
+   {
+      auto itr = _accounts.find( account );
+      if( itr != _accounts.end() )
+         all_ids.insert( itr->second.begin(), itr->second.end() );
    }
 
-   if( _market_subscriptions.size() )
+   for( const auto& id : ids )
    {
-      market_queue_type broadcast_queue;
+      auto subscribers = _objects.find( id );
+      const bool is_order = id.is<limit_order_object>() || id.is<call_order_object>()
+                            || id.is<force_settlement_object>();
+      if( all_ids.empty() && subscribers == _objects.end() && ( !is_order || _markets.empty() ) )
+         continue;
+
+      const object* obj = find_object( id );
+      for( database_api_impl* session : all_ids )
+         session->queue_object_update( id, full_object, obj );
+      if( subscribers != _objects.end() )
+         for( database_api_impl* session : subscribers->second )
+            if( all_ids.find( session ) == all_ids.end() )
+               session->queue_object_update( id, full_object, obj );
 
-      for(auto id : ids)
+      if( is_order && obj != nullptr && !_markets.empty() )
       {
-         if( id.is<call_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<limit_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<force_settlement_object>() )
-         {
-            enqueue_if_subscribed_to_market<force_settlement_object>( find_object(id), broadcast_queue, full_object );
-         }
+         const auto market = get_order_market( *obj );
+         auto market_subscribers = market.valid() ? _markets.find( *market ) : _markets.end();
+         if( market_subscribers != _markets.end() )
+            for( database_api_impl* session : market_subscribers->second )
+               session->queue_market_update( *market, *obj, full_object );
       }
-
-      if( broadcast_queue.size() )
-         broadcast_market_updates(broadcast_queue);
    }
 }
 
+} // detail
+
 /** note: this method cannot yield because it is called in the middle of
  * apply a block.
  */
 void database_api_impl::on_applied_block()
 {
+   detail::market_ticker_cache::instance().invalidate();
+   publish_market_depth();
+
    if (_block_applied_callback)
    {
       auto capture_this = shared_from_this();
       block_id_type block_id = _db.head_block_id();
-      fc::async([this,capture_this,block_id](){
+      graphene::utilities::monitored_async([this,capture_this,block_id](){
          _block_applied_callback(fc::variant(block_id, 1));
-      });
+      }, "database_api block applied");
    }
 
    if(_market_subscriptions.size() == 0)
@@ -2520,14 +3658,14 @@ void database_api_impl::on_applied_block()
    }
    /// we need to ensure the database_api is not deleted for the life of the async operation
    auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
+   graphene::utilities::monitored_async([this,capture_this,subscribed_markets_ops](){
       for(auto item : subscribed_markets_ops)
       {
          auto itr = _market_subscriptions.find(item.first);
          if(itr != _market_subscriptions.end())
             itr->second(fc::variant(item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
       }
-   });
+   }, "database_api market changes");
 }
 
 } } // graphene::app
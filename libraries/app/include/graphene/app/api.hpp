@@ -23,6 +23,9 @@
  */
 #pragma once
 
+#include <graphene/app/api_metrics.hpp>
+#include <graphene/app/block_production_telemetry.hpp>
+#include <graphene/app/startup_profile.hpp>
 #include <graphene/app/database_api.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
@@ -36,6 +39,8 @@
 
 #include <graphene/net/node.hpp>
 
+#include <graphene/utilities/task_monitor.hpp>
+
 #include <fc/api.hpp>
 #include <fc/optional.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -91,6 +96,32 @@ namespace graphene { namespace app {
       vector<operation_history_object> operation_history_objs;
    };
 
+   /// An operation of an account history, without its contents
+   struct account_history_entry
+   {
+      operation_history_id_type id;
+      uint32_t                  block_num = 0;
+      bool                      is_virtual = false; ///< whether the operation was created by the chain, e.g. a fill
+   };
+
+   /// A page of an account history, see history_api::get_account_history_page
+   struct account_history_page
+   {
+      vector<operation_history_object> operations; ///< the operations, empty if only ids were requested
+      vector<account_history_entry>    entries;    ///< the operations if only ids were requested
+      string                           cursor;     ///< passed to get the next page, empty after the oldest operation
+   };
+
+   /// The proof that a transaction is in a block, see block_api::get_transaction_merkle_proof
+   struct transaction_merkle_proof
+   {
+      signed_block_header   block_header;
+      processed_transaction transaction;
+      uint32_t              trx_in_block = 0;
+      uint32_t              trx_count = 0;    ///< the number of transactions in the block
+      vector<digest_type>   merkle_branch;    ///< see graphene::chain::merkle_branch()
+   };
+
    /**
     * @brief summary data of a group of limit orders
     */
@@ -134,6 +165,42 @@ namespace graphene { namespace app {
             operation_history_id_type start = operation_history_id_type()
          )const;
 
+         /**
+          * @brief Same as @ref get_account_history, but each operation is serialized by fc::raw::pack
+          * @return A list of packed operation_history_object, most recent first
+          *
+          * Skips building the variant of every operation, for clients that fetch and decode history in bulk.
+          */
+         vector<vector<char>> get_account_history_packed(
+            const std::string account_id_or_name,
+            operation_history_id_type stop = operation_history_id_type(),
+            unsigned limit = 100,
+            operation_history_id_type start = operation_history_id_type()
+         )const;
+
+         /// the most operations returned by get_account_history_page, with and without only_ids
+         static const unsigned max_history_page_size = 1000;
+         static const unsigned max_history_page_ids = 10000;
+
+         /**
+          * @brief Get a page of the operations relevant to the specified account, from most recent to oldest
+          * @param account_id_or_name The account ID or name whose history should be queried
+          * @param cursor Empty to start with the most recent operation, otherwise the cursor of the previous page
+          * @param limit Maximum number of operations to retrieve, must not exceed max_history_page_size, or
+          *        max_history_page_ids if only_ids is set
+          * @param only_ids Whether to return entries with the IDs of the operations instead of the operations
+          * @return The page, with the cursor of the next one
+          *
+          * The cursor holds the position in the history at which the next page starts, so that each page starts
+          * with a single lookup and operations added meanwhile do not shift the pages.
+          */
+         account_history_page get_account_history_page(
+            const std::string account_id_or_name,
+            const std::string& cursor = std::string(),
+            unsigned limit = 100,
+            bool only_ids = false
+         )const;
+
          /**
           * @brief Get operations relevant to the specified account filtering by operation type
           * @param account_id_or_name The account ID or name whose history should be queried
@@ -236,6 +303,24 @@ namespace graphene { namespace app {
           */
       vector<optional<signed_block>> get_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
 
+      /**
+          * @brief Get packed blocks, as serialized by fc::raw::pack, without unpacking them on the server
+          * @param first_block_num The lowest block number
+          * @param count The number of blocks, at most 1000
+          * @return The packed blocks from first_block_num on, ends early at the first block that is not available
+          */
+      vector<vector<char>> get_raw_blocks(uint32_t first_block_num, uint32_t count)const;
+
+      /**
+          * @brief Get the proof that a transaction is in a block, without the other transactions of the block
+          * @param block_num The number of the block
+          * @param trx_in_block The position of the transaction in the block
+          * @return The block header, the transaction and its merkle branch. merkle_root_from_branch() of the
+          *         transaction's merkle_digest() and the branch is the transaction_merkle_root of the header.
+          *         The merkle trees of recent blocks are cached.
+          */
+      transaction_merkle_proof get_transaction_merkle_proof(uint32_t block_num, uint32_t trx_in_block)const;
+
    private:
       graphene::chain::database& _db;
    };
@@ -322,6 +407,9 @@ namespace graphene { namespace app {
 
          /**
           * @brief Get status of all current connections to peers
+          *
+          * The info of each peer includes its traffic by message type, its send queue and how quickly it
+          * answered item and sync block requests, for telling slow peers apart.
           */
          std::vector<net::peer_status> get_connected_peers() const;
 
@@ -343,6 +431,45 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Return the counters of every RPC method called since the node started or since the last reset
+          * @param reset whether to clear the counters after reading them
+          *
+          * Only available if the node runs with enable-api-metrics.
+          */
+         std::map<std::string,api_method_metrics> get_api_metrics( bool reset = false );
+
+         /// @brief Return what api-notification-overflow did to the notifications of slow sessions so far
+         notification_overflow_stats get_notification_overflows()const;
+
+         /**
+          * @brief Return how the production of the blocks this node produced most recently went
+          * @param limit the number of blocks to return, at most block_production_telemetry::max_records
+          * @return the most recent block first, empty if the node does not produce blocks
+          */
+         std::vector<block_production_record> get_block_production( uint32_t limit = 100 )const;
+
+         /// @brief Return how long each step of the startup of this node took, in the order they finished
+         std::vector<startup_phase> get_startup_profile()const;
+
+         /**
+          * @brief Return the recent depth of the task queue of the chain thread and the run time of its tasks
+          * @param reset whether to clear the samples and run times after reading them
+          *
+          * Empty unless the node runs with enable-task-monitor.
+          */
+         graphene::utilities::task_monitor_report get_task_monitor_report( bool reset = false );
+
+         /// @brief Start or stop recording the spans of block processing, see also the enable-tracing option
+         void set_tracing( bool enabled );
+
+         /**
+          * @brief Return the recorded spans of block processing, the oldest first
+          * @param format chrome for the trace event format of chrome://tracing and Perfetto, otlp for OTLP/JSON
+          * @param clear whether to drop the spans after reading them
+          */
+         fc::variant get_trace( const std::string& format = "chrome", bool clear = false );
+
       private:
          application& _app;
    };
@@ -465,6 +592,7 @@ namespace graphene { namespace app {
 
       private:
          graphene::chain::database& _db;
+         const application_options* _app_options;
          graphene::app::database_api database_api;
    };
 
@@ -544,11 +672,22 @@ namespace graphene { namespace app {
          /// @brief Retrieve the debug API (if available)
          fc::api<graphene::debug_witness::debug_api> debug()const;
 
+         /**
+          * @brief Have the notices this session gets for the blocks of one flush sent in one frame, a JSON array
+          * of notices, instead of one frame per notice
+          * @param enabled Whether to batch them, sessions start with one frame per notice
+          * @return True if the connection of the session can batch notices
+          */
+         bool set_notification_batching( bool enabled );
+
          /// @brief Called to enable an API, not reflected.
          void enable_api( const string& api_name );
+         /// @brief Called with what switches notification batching on the session's connection, not reflected.
+         void set_notification_batching_handler( std::function<void(bool)> handler );
       private:
 
          application& _app;
+         std::function<void(bool)> _set_notification_batching;
          optional< fc::api<block_api> > _block_api;
          optional< fc::api<database_api> > _database_api;
          optional< fc::api<network_broadcast_api> > _network_broadcast_api;
@@ -570,6 +709,12 @@ FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
         (success)(min_val)(max_val)(value_out)(blind_out)(message_out) )
 FC_REFLECT( graphene::app::history_operation_detail,
             (total_count)(operation_history_objs) )
+FC_REFLECT( graphene::app::account_history_entry,
+            (id)(block_num)(is_virtual) )
+FC_REFLECT( graphene::app::account_history_page,
+            (operations)(entries)(cursor) )
+FC_REFLECT( graphene::app::transaction_merkle_proof,
+            (block_header)(transaction)(trx_in_block)(trx_count)(merkle_branch) )
 FC_REFLECT( graphene::app::limit_order_group,
             (min_price)(max_price)(total_for_sale) )
 //FC_REFLECT_TYPENAME( fc::ecc::compact_signature );
@@ -580,6 +725,8 @@ FC_REFLECT( graphene::app::asset_holders, (asset_id)(count) );
 
 FC_API(graphene::app::history_api,
        (get_account_history)
+       (get_account_history_packed)
+       (get_account_history_page)
        (get_account_history_by_operations)
        (get_account_history_operations)
        (get_relative_account_history)
@@ -589,6 +736,8 @@ FC_API(graphene::app::history_api,
      )
 FC_API(graphene::app::block_api,
        (get_blocks)
+       (get_raw_blocks)
+       (get_transaction_merkle_proof)
      )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
@@ -603,6 +752,13 @@ FC_API(graphene::app::network_node_api,
        (get_potential_peers)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
+       (get_api_metrics)
+       (get_notification_overflows)
+       (get_block_production)
+       (get_startup_profile)
+       (get_task_monitor_report)
+       (set_tracing)
+       (get_trace)
      )
 FC_API(graphene::app::crypto_api,
        (blind)
@@ -624,6 +780,7 @@ FC_API(graphene::app::orders_api,
      )
 FC_API(graphene::app::login_api,
        (login)
+       (set_notification_batching)
        (block)
        (network_broadcast)
        (database)
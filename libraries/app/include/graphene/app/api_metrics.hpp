@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/batch_api_connection.hpp>
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /// Counters of one RPC method, as returned by network_node_api::get_api_metrics()
+   struct api_method_metrics
+   {
+      uint64_t calls = 0;
+      uint64_t errors = 0;
+      uint64_t request_bytes = 0;
+      uint64_t response_bytes = 0;
+      uint64_t total_microseconds = 0;
+      uint64_t max_microseconds = 0;
+      /// calls that took less than 1ms, 10ms, 100ms, 1s, 10s and longer
+      std::vector<uint64_t> latency_histogram = std::vector<uint64_t>( 6 );
+   };
+
+   /// Notifications not sent as they were because their session was too slow, see notification_overflow_policy
+   struct notification_overflow_stats
+   {
+      uint64_t dropped = 0;      ///< notifications dropped
+      uint64_t coalesced = 0;    ///< notifications replaced by a later one about the same object
+      uint64_t unsubscribed = 0; ///< sessions whose subscriptions were cancelled
+   };
+
+   /**
+    * @brief Calls, errors, latency and payload sizes of the RPC methods of all API connections
+    *
+    * Methods are named "api.method" as the client calls them, where api is the API name or the number the
+    * connection assigned to it, e.g. "0.get_objects" or "database.get_objects".
+    */
+   class api_metrics
+   {
+      public:
+         void record( const std::string& method, const fc::microseconds& latency, size_t request_bytes,
+                      size_t response_bytes, bool failed );
+
+         std::map<std::string,api_method_metrics> get_metrics()const;
+         void reset();
+
+         /// the method named in a JSON-RPC request, "unknown" if it can not be parsed
+         static std::string method_name( const std::string& request );
+
+      private:
+         /// bounds the memory used by clients calling many different unknown methods
+         static const size_t max_methods = 1000;
+
+         mutable std::mutex                        _mutex;
+         std::map<std::string,api_method_metrics>  _metrics;
+   };
+
+   /**
+    * A websocket API connection that records every request it answers, over websocket or over HTTP, in metrics.
+    * The requests of a batch are recorded one by one.
+    */
+   class metered_websocket_api_connection : public batch_websocket_api_connection
+   {
+      public:
+         metered_websocket_api_connection( fc::http::websocket_connection& c, uint32_t max_conversion_depth,
+                                           std::shared_ptr<api_metrics> metrics );
+
+      protected:
+         std::string on_request( const std::string& message, bool send_message ) override;
+
+      private:
+
+         std::shared_ptr<api_metrics> _metrics;
+   };
+
+} }
+
+FC_REFLECT( graphene::app::notification_overflow_stats, (dropped)(coalesced)(unsubscribed) )
+FC_REFLECT( graphene::app::api_method_metrics,
+            (calls)(errors)(request_bytes)(response_bytes)(total_microseconds)(max_microseconds)(latency_histogram) )
@@ -27,21 +27,91 @@
 #include <graphene/net/node.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/optional.hpp>
+
 #include <boost/program_options.hpp>
 
+#include <functional>
+#include <memory>
+
 namespace graphene { namespace app {
    namespace detail { class application_impl; }
    using std::string;
 
    class abstract_plugin;
+   class api_metrics;
+   class block_apply_histogram;
+   class block_production_telemetry;
+   class startup_profile;
+   struct notification_overflow_stats;
+
+   /// What is done with the notifications of a session that has more than max_pending_notifications unsent
+   enum class notification_overflow_policy
+   {
+      drop_oldest, ///< the notifications of the oldest blocks are dropped
+      coalesce,    ///< the notifications of the oldest blocks are merged, keeping the latest state of each object
+      unsubscribe  ///< all subscriptions of the session are cancelled
+   };
 
    class application_options
    {
       public:
          bool enable_subscribe_to_all = false;
          bool has_market_history_plugin = false;
+         /// Threads that run read-only API calls, set by the api-reader-threads option
+         std::shared_ptr<graphene::chain::verification_pool> api_read_pool;
+         /// Counters of the RPC methods called on the websocket server, set by the enable-api-metrics option
+         std::shared_ptr<api_metrics> rpc_metrics;
+         /// The blocks the witness plugin produced recently
+         std::shared_ptr<block_production_telemetry> block_production;
+         /// How long each step of the startup took, see the startup-report option
+         std::shared_ptr<startup_profile> startup;
+         /// How long pushing the blocks received from the p2p network took, served by the metrics-endpoint option
+         std::shared_ptr<block_apply_histogram> block_apply_latency;
+         /// Unsent notifications a session can have before overflow_policy applies, 0 for no limit
+         uint32_t max_pending_notifications = 0;
+         notification_overflow_policy overflow_policy = notification_overflow_policy::coalesce;
+         /// What overflow_policy did to the notifications of all sessions, only used on the chain thread
+         std::shared_ptr<notification_overflow_stats> notification_overflows;
    };
 
+   namespace detail {
+      /// whether the current thread runs a call of run_read_only()
+      inline bool& in_read_only_call()
+      {
+         static thread_local bool flag = false;
+         return flag;
+      }
+   }
+
+   /**
+    * Runs a read-only API call on the api_read_pool of options, holding the state lock of db shared, and waits for
+    * it. The chain thread keeps applying blocks meanwhile. Without a pool the call runs on the calling thread. The
+    * call must not touch state of the API session, like subscriptions, which the chain thread uses unlocked.
+    */
+   template<typename Result>
+   Result run_read_only( const graphene::chain::database& db, const application_options* options,
+                         const std::function<Result()>& call )
+   {
+      // a call made from within another one already holds the lock, locking again could wait behind the writer
+      if( options == nullptr || !options->api_read_pool || detail::in_read_only_call() )
+         return call();
+      fc::optional<Result> result;
+      options->api_read_pool->post( [&db,&call,&result] () {
+         auto lock = db.lock_state_for_reading();
+         bool& in_call = detail::in_read_only_call();
+         in_call = true;
+         try {
+            result = call();
+         } catch( ... ) {
+            in_call = false;
+            throw;
+         }
+         in_call = false;
+      }).wait();
+      return std::move( *result );
+   }
+
    class application
    {
       public:
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/optional.hpp>
+#include <fc/rpc/websocket_api.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   class batch_websocket_api_connection;
+
+   /**
+    * While an instance exists on the current thread, the connections whose sessions asked for batched notifications
+    * keep the notices they are asked to send, and send them as one JSON array when the outermost instance is
+    * destroyed. Connections closed meanwhile are skipped.
+    */
+   class notification_batch
+   {
+      public:
+         notification_batch();
+         ~notification_batch();
+
+         /// the outermost batch of the current thread, nullptr if there is none
+         static notification_batch* current();
+
+      private:
+         friend class batch_websocket_api_connection;
+         static notification_batch*& outermost();
+
+         bool _outermost;
+         std::vector< std::weak_ptr<batch_websocket_api_connection> > _connections;
+   };
+
+   /// writes the JSON result of a call from its arguments, throws to leave the call to fc::api after all
+   typedef std::function<std::string( const fc::variants& args, uint32_t max_conversion_depth )> json_call;
+
+   /// a method answered by a json_call, on the API registered as api_id or reached by api_name
+   struct json_call_route
+   {
+      uint32_t    api_id;
+      std::string api_name;
+      std::string method;
+      json_call   call;
+   };
+
+   /**
+    * @brief A websocket API connection that also accepts JSON-RPC 2.0 batches, over websocket and over HTTP
+    *
+    * A batch is a JSON array of requests. They are executed one after the other on the thread of the connection,
+    * without yielding to block processing in between, so that all of them see the same head state. The responses
+    * are returned in one array, in the order of the requests, leaving out notifications which have no response.
+    */
+   class batch_websocket_api_connection : public fc::rpc::websocket_api_connection
+   {
+      public:
+         /// the most requests accepted in one batch
+         static const size_t max_batch_size = 100;
+
+         batch_websocket_api_connection( fc::http::websocket_connection& c, uint32_t max_conversion_depth );
+
+         /// whether the notices sent within a notification_batch go out in one frame, off until the session asks
+         void set_batch_notifications( bool enabled ) { _batch_notifications = enabled; }
+
+         void send_notice( uint64_t callback_id, fc::variants args = fc::variants() ) override;
+
+         /**
+          * Calls of route.method are answered with the JSON route.call writes from the typed result, instead of
+          * converting the result to a variant first. Add the routes before the connection takes requests.
+          */
+         void add_json_call( json_call_route route ) { _json_calls.push_back( std::move(route) ); }
+
+         /**
+          * Answers message with the matching route if it is a call of one of them with a numeric id, returns nothing
+          * otherwise and when the route throws, leaving the request to on_message().
+          */
+         static fc::optional<std::string> dispatch_json_call( const std::string& message,
+                                                              const std::vector<json_call_route>& routes,
+                                                              uint32_t max_conversion_depth );
+
+         /**
+          * Answers message with dispatch called once per request if it is a batch, returns nothing otherwise.
+          * Malformed and oversized batches are answered with a single error response.
+          */
+         static fc::optional<std::string> dispatch_batch( const std::string& message,
+                                                          const std::function<std::string(const std::string&)>& dispatch );
+
+         /// the frame sending notices, a single notice as it is, several as an array
+         static std::string encode_notices( const fc::variants& notices, uint32_t max_conversion_depth );
+
+      protected:
+         /// answers one request which is not a batch, send_message as in on_message()
+         virtual std::string on_request( const std::string& message, bool send_message );
+
+      private:
+         friend class notification_batch;
+
+         std::string on_batch_message( const std::string& message, bool send_message );
+         void send_pending_notices();
+
+         const uint32_t _max_depth;
+         std::atomic<bool> _batch_notifications;
+         fc::variants _pending_notices;
+         std::vector<json_call_route> _json_calls;
+   };
+
+} } // graphene::app
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /// How the production of one block by this node went, as returned by network_node_api::get_block_production()
+   struct block_production_record
+   {
+      uint32_t           block_num = 0;
+      fc::time_point_sec timestamp;
+      uint32_t           transaction_count = 0;
+      /// how much later than scheduled the production loop woke up for the slot
+      int64_t            wakeup_jitter_us = 0;
+      /// applying or collecting the transactions, building and signing the header
+      int64_t            generate_us = 0;
+      /// pushing the signed block into the local database
+      int64_t            apply_us = 0;
+      /// handing the block to the peers, -1 until the broadcast is done
+      int64_t            broadcast_us = -1;
+   };
+
+   /**
+    * @brief The most recent blocks produced by the witness plugin and where their production time went
+    *
+    * Written by the witness plugin on the chain thread and read by API calls on other threads.
+    */
+   class block_production_telemetry
+   {
+      public:
+         /// how many of the most recent blocks are kept
+         static const size_t max_records = 1000;
+
+         void record( const block_production_record& r );
+         void set_broadcast_time( uint32_t block_num, const fc::microseconds& elapsed );
+
+         /// @return up to limit of the most recent records, the most recent first
+         std::vector<block_production_record> get_recent( uint32_t limit )const;
+
+      private:
+         mutable std::mutex                   _mutex;
+         /// oldest first
+         std::deque<block_production_record>  _records;
+   };
+
+} }
+
+FC_REFLECT( graphene::app::block_production_record,
+            (block_num)(timestamp)(transaction_count)(wakeup_jitter_us)(generate_us)(apply_us)(broadcast_us) )
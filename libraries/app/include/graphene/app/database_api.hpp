@@ -79,6 +79,26 @@ struct order_book
   vector< order >             asks;
 };
 
+/// The orders at one price in a @ref market_depth
+struct market_depth_level
+{
+   price                      sell_price;
+   share_type                 for_sale;       ///< zero in a delta when the level is gone
+   share_type                 to_receive;     ///< what the orders receive when they are filled completely
+   uint32_t                   order_count = 0;
+};
+
+/// Aggregated order book of a market, either all price levels or the levels one block changed
+struct market_depth
+{
+   asset_id_type              base;
+   asset_id_type              quote;
+   uint64_t                   sequence = 0;   ///< number of the last delta of the subscription that is included
+   uint32_t                   block_num = 0;
+   vector<market_depth_level> bids;           ///< orders selling base for quote, best first
+   vector<market_depth_level> asks;           ///< orders selling quote for base, best first
+};
+
 struct market_ticker
 {
    time_point_sec             time;
@@ -145,6 +165,27 @@ class database_api
        */
       fc::variants get_objects(const vector<object_id_type>& ids)const;
 
+      /**
+       * @brief Get the objects corresponding to the provided IDs, as serialized by fc::raw::pack
+       * @param ids IDs of the objects to retrieve
+       * @return The packed objects, in the order they are mentioned in ids, empty for IDs without object
+       *
+       * The type of each object follows from its ID. Unlike @ref get_objects this does not subscribe to the objects
+       * and skips building a variant of each object, which is most of the cost of large requests.
+       */
+      vector<vector<char>> get_objects_packed(const vector<object_id_type>& ids)const;
+
+      /**
+       * @brief Get the objects corresponding to the provided IDs as they were at the end of a past block
+       * @param ids IDs of the objects to retrieve
+       * @param block_num the block after which to show the objects
+       * @return The objects, in the order they are mentioned in ids, null for IDs without object at that time
+       *
+       * Only available on nodes that run with state-journal, for the blocks applied since the journal started.
+       * Does not subscribe to the objects.
+       */
+      fc::variants get_objects_at_block(const vector<object_id_type>& ids, uint32_t block_num)const;
+
       ///////////////////
       // Subscriptions //
       ///////////////////
@@ -325,6 +366,18 @@ class database_api
        */
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
 
+      /**
+       * @brief Fetch the parts of the specified accounts that changed since an earlier call
+       * @param names_or_ids Each item must be the name or ID of an account to retrieve
+       * @param change_token The change_token of an earlier result, 0 to fetch everything
+       * @return The token for the next call and the changed sections of the changed accounts
+       *
+       * Accounts without changes are left out, which costs little more than the lookup of the account. A token
+       * issued before the node restarted, or too long ago, makes every section count as changed. Unknown accounts
+       * are ignored. Does not subscribe.
+       */
+      full_accounts_update get_full_accounts_since( const vector<string>& names_or_ids, uint64_t change_token )const;
+
       optional<account_object> get_account_by_name( string name )const;
 
       /**
@@ -367,6 +420,13 @@ class database_api
       /** @return all unclaimed balance objects for a set of addresses */
       vector<balance_object> get_balance_objects( const vector<address>& addrs )const;
 
+      /**
+       * @return all unclaimed balance objects that balance_claim_operation lets the keys claim, owned by any of the
+       * address forms of each key. The addresses are derived on the node, once per key, instead of being sent.
+       * At most 100 keys are taken per call.
+       */
+      vector<balance_object> get_balance_objects_by_keys( const vector<public_key_type>& keys )const;
+
       vector<asset> get_vested_balances( const vector<balance_id_type>& objs )const;
 
       vector<vesting_balance_object> get_vesting_balances( const std::string account_id_or_name )const;
@@ -481,6 +541,35 @@ class database_api
        */
       void unsubscribe_from_market( const std::string& a, const std::string& b );
 
+      /**
+       * @brief Request the changes of the aggregated order book of a market after every block
+       * @param callback Callback method which is called after each block that changed the book
+       * @param base Symbol or ID of the base asset
+       * @param quote Symbol or ID of the quote asset
+       *
+       * Callback will be passed a variant containing a @ref market_depth with the price levels that changed, and
+       * a sequence number that is one higher than the one of the previous call. Removed levels have no amount left.
+       * Applying the deltas to the result of @ref get_market_depth keeps a copy of the book up to date.
+       */
+      void subscribe_to_market_depth( std::function<void(const variant&)> callback,
+                                      const std::string& base, const std::string& quote );
+
+      /**
+       * @brief Unsubscribe from order book changes of a market
+       * @param base Symbol or ID of the base asset
+       * @param quote Symbol or ID of the quote asset
+       */
+      void unsubscribe_from_market_depth( const std::string& base, const std::string& quote );
+
+      /**
+       * @brief Returns all price levels of a market
+       * @param base Symbol or ID of the base asset
+       * @param quote Symbol or ID of the quote asset
+       * @return With a depth subscription for this market, the book as of the last delta and its sequence number,
+       *         without one the current book and sequence number 0
+       */
+      market_depth get_market_depth( const std::string& base, const std::string& quote )const;
+
       /**
        * @brief Returns the ticker for the market assetA:assetB
        * @param a String name of the first asset
@@ -502,7 +591,7 @@ class database_api
        * @param base String name of the first asset
        * @param quote String name of the second asset
        * @param depth of the order book. Up to depth of each asks and bids, capped at 50. Prioritizes most moderate of each
-       * @return Order book of the market
+       * @return Order book of the market, orders at the same price are summed up into one entry
        */
       order_book get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
 
@@ -695,6 +784,14 @@ class database_api
        */
       processed_transaction validate_transaction( const signed_transaction& trx )const;
 
+      /**
+       *  Checks a transaction and evaluates its operations without applying them, which unlike
+       *  validate_transaction() needs no undo session and runs beside other read only calls.
+       *  Each operation is evaluated against the current state, not the one the operations before it leave.
+       *  @return the result, the paid fee and the required fee of each operation
+       */
+      vector< dry_run_operation > dry_run_transaction( const signed_transaction& trx )const;
+
       /**
        *  For each operation calculate the required fee in the specified asset type.
        */
@@ -748,6 +845,8 @@ class database_api
 
 FC_REFLECT( graphene::app::order, (price)(quote)(base) );
 FC_REFLECT( graphene::app::order_book, (base)(quote)(bids)(asks) );
+FC_REFLECT( graphene::app::market_depth_level, (sell_price)(for_sale)(to_receive)(order_count) );
+FC_REFLECT( graphene::app::market_depth, (base)(quote)(sequence)(block_num)(bids)(asks) );
 FC_REFLECT( graphene::app::market_ticker,
             (time)(base)(quote)(latest)(lowest_ask)(highest_bid)(percent_change)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_volume, (time)(base)(quote)(base_volume)(quote_volume) );
@@ -756,6 +855,8 @@ FC_REFLECT( graphene::app::market_trade, (sequence)(date)(price)(amount)(value)(
 FC_API(graphene::app::database_api,
    // Objects
    (get_objects)
+   (get_objects_packed)
+   (get_objects_at_block)
 
    // Subscriptions
    (set_subscribe_callback)
@@ -785,6 +886,7 @@ FC_API(graphene::app::database_api,
    (get_account_id_from_string)
    (get_accounts)
    (get_full_accounts)
+   (get_full_accounts_since)
    (get_account_by_name)
    (get_account_references)
    (lookup_account_names)
@@ -795,6 +897,7 @@ FC_API(graphene::app::database_api,
    (get_account_balances)
    (get_named_account_balances)
    (get_balance_objects)
+   (get_balance_objects_by_keys)
    (get_vested_balances)
    (get_vesting_balances)
 
@@ -815,6 +918,9 @@ FC_API(graphene::app::database_api,
    (get_collateral_bids)
    (subscribe_to_market)
    (unsubscribe_from_market)
+   (subscribe_to_market_depth)
+   (unsubscribe_from_market_depth)
+   (get_market_depth)
    (get_ticker)
    (get_24_volume)
    (get_top_markets)
@@ -850,6 +956,7 @@ FC_API(graphene::app::database_api,
    (verify_authority)
    (verify_account_authority)
    (validate_transaction)
+   (dry_run_transaction)
    (get_required_fees)
 
    // Proposed transactions
@@ -50,6 +50,25 @@ namespace graphene { namespace app {
       vector<withdraw_permission_object> withdraws;
    };
 
+   /// The sections of a full_account changed since a change token, see database_api::get_full_accounts_since
+   struct full_account_update
+   {
+      /**
+       * The names of the sections filled in content, the others are left empty. The sections are named after the
+       * fields of full_account, "account" stands for account, statistics, the referrer names, votes and cashback.
+       */
+      vector<string> sections;
+      full_account   content;
+   };
+
+   struct full_accounts_update
+   {
+      /// passed to the next call to get the changes made after this one
+      uint64_t                             change_token = 0;
+      /// the changed accounts only
+      std::map<string,full_account_update> accounts;
+   };
+
 } }
 
 FC_REFLECT( graphene::app::full_account,
@@ -69,3 +88,6 @@ FC_REFLECT( graphene::app::full_account,
             (assets)
             (withdraws)
           )
+
+FC_REFLECT( graphene::app::full_account_update, (sections)(content) )
+FC_REFLECT( graphene::app::full_accounts_update, (change_token)(accounts) )
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/full_account.hpp>
+#include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/**
+ *  Selects the types json_writer writes member by member from their reflection. This is only correct for types
+ *  whose to_variant() is the reflected one, types with their own to_variant() (keys, addresses, extensions...)
+ *  must not be listed and go through fc::variant instead.
+ */
+template< typename T > struct json_writes_members : std::false_type {};
+
+} } // graphene::app
+
+#define GRAPHENE_JSON_WRITE_MEMBERS( TYPE ) \
+namespace graphene { namespace app { template<> struct json_writes_members< TYPE > : std::true_type {}; } }
+
+namespace graphene { namespace app {
+
+/**
+ *  Appends JSON to a string exactly the way fc::json::to_string( fc::variant( value, max_depth ), format ) writes
+ *  it, without building the variant first. Reflected types selected by json_writes_members, containers,
+ *  optionals, static variants and the common scalar types are written directly, anything else is converted
+ *  through fc::variant on its own.
+ *
+ *  Values can be written as a whole with value(), or JSON can be assembled piece by piece with begin_object(),
+ *  key(), value() and end_object(). The websocket API answers get_full_accounts and get_block with it, see
+ *  batch_websocket_api_connection::add_json_call(), and the elasticsearch plugin writes its documents with it.
+ */
+class json_writer
+{
+   public:
+      explicit json_writer( std::string& out,
+                            fc::json::output_formatting format = fc::json::stringify_large_ints_and_doubles,
+                            uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+         : _out( out ), _format( format ), _max_depth( max_depth ) {}
+
+      json_writer& begin_object() { separate(); _out += '{'; _first = true; return *this; }
+      json_writer& end_object()   { _out += '}'; _first = false; return *this; }
+      json_writer& key( const char* name )
+      {
+         separate();
+         append_string( name );
+         _out += ':';
+         _first = true;
+         return *this;
+      }
+      /** a value or members that are JSON already */
+      json_writer& raw( const std::string& json ) { separate(); _out += json; _first = false; return *this; }
+      json_writer& null()                         { return raw( "null" ); }
+
+      template< typename T >
+      json_writer& value( const T& v )
+      {
+         separate();
+         put( v, _max_depth );
+         _first = false;
+         return *this;
+      }
+
+   private:
+      template< typename T >
+      struct member_writer
+      {
+         json_writer& writer;
+         const T&     object;
+         uint32_t     depth;
+
+         template< typename Member, class Class, Member (Class::*member) >
+         void operator()( const char* name )const { writer.put_member( name, object.*member, depth ); }
+      };
+
+      struct static_variant_writer
+      {
+         typedef void result_type;
+         json_writer& writer;
+         uint32_t     depth;
+
+         template< typename T >
+         void operator()( const T& v )const { writer.put( v, depth ); }
+      };
+
+      enum value_kind { boolean_value, signed_value, unsigned_value, members_value, variant_value };
+
+      template< typename T >
+      void put( const T& v, uint32_t depth )
+      {
+         // char has its own to_variant() in fc, enums are written by name
+         typedef std::integral_constant< value_kind,
+               std::is_same<T,bool>::value ? boolean_value
+            : ( std::is_integral<T>::value && !std::is_same<T,char>::value )
+                  ? ( std::is_signed<T>::value ? signed_value : unsigned_value )
+            : json_writes_members<T>::value ? members_value
+            : variant_value > kind;
+         put( v, depth, kind() );
+      }
+
+      template< typename T >
+      void put( const T& v, uint32_t, std::integral_constant<value_kind,boolean_value> )
+      {
+         _out += v ? "true" : "false";
+      }
+
+      template< typename T >
+      void put( const T& v, uint32_t, std::integral_constant<value_kind,signed_value> )
+      {
+         const int64_t i = v;
+         // small numbers are never quoted, whatever the format
+         if( _format == fc::json::legacy_generator || ( i <= INT32_MAX && i >= INT32_MIN ) )
+            _out += std::to_string( i );
+         else
+            _out += fc::json::to_string( fc::variant( i ), _format );
+      }
+
+      template< typename T >
+      void put( const T& v, uint32_t, std::integral_constant<value_kind,unsigned_value> )
+      {
+         const uint64_t u = v;
+         if( _format == fc::json::legacy_generator || u <= INT32_MAX )
+            _out += std::to_string( u );
+         else
+            _out += fc::json::to_string( fc::variant( u ), _format );
+      }
+
+      template< typename T >
+      void put( const T& v, uint32_t depth, std::integral_constant<value_kind,members_value> )
+      {
+         FC_ASSERT( depth > 0 );
+         _out += '{';
+         _first = true;
+         fc::reflector<T>::visit( member_writer<T>{ *this, v, depth - 1 } );
+         _out += '}';
+      }
+
+      template< typename T >
+      void put( const T& v, uint32_t depth, std::integral_constant<value_kind,variant_value> )
+      {
+         _out += fc::json::to_string( fc::variant( v, depth ), _format );
+      }
+
+      void put( const std::string& v, uint32_t )         { append_string( v ); }
+      void put( const fc::variant& v, uint32_t )         { _out += fc::json::to_string( v, _format ); }
+      void put( const share_type& v, uint32_t depth )    { put( v.value, depth ); }
+      void put( const object_id_type& v, uint32_t )      { append_string( std::string( v ) ); }
+      void put( const fc::time_point_sec& v, uint32_t )  { append_string( v.to_iso_string() ); }
+      void put( double v, uint32_t )
+      {
+         if( _format == fc::json::legacy_generator )
+            _out += fc::to_string( v );
+         else
+            _out += fc::json::to_string( fc::variant( v ), _format );
+      }
+      /** fc writes bytes as a hex string */
+      void put( const std::vector<char>& v, uint32_t depth )
+      {
+         put( v, depth, std::integral_constant<value_kind,variant_value>() );
+      }
+
+      template< uint8_t SpaceID, uint8_t TypeID, typename T >
+      void put( const graphene::db::object_id<SpaceID,TypeID,T>& v, uint32_t depth )
+      {
+         put( object_id_type( v ), depth );
+      }
+
+      template< typename T >
+      void put( const fc::optional<T>& v, uint32_t depth )
+      {
+         if( v.valid() )
+            put( *v, depth );
+         else
+            _out += "null";
+      }
+
+      template< typename T >
+      void put( const std::vector<T>& v, uint32_t depth )   { put_array( v, depth ); }
+      template< typename T >
+      void put( const fc::flat_set<T>& v, uint32_t depth )  { put_array( v, depth ); }
+
+      /** fc writes maps as arrays of pairs */
+      template< typename K, typename V >
+      void put( const std::map<K,V>& v, uint32_t depth )    { put_array( v, depth ); }
+
+      template< typename A, typename B >
+      void put( const std::pair<A,B>& v, uint32_t depth )
+      {
+         FC_ASSERT( depth > 0 );
+         _out += '[';
+         put( v.first, depth - 1 );
+         _out += ',';
+         put( v.second, depth - 1 );
+         _out += ']';
+      }
+
+      template< typename... T >
+      void put( const fc::static_variant<T...>& v, uint32_t depth )
+      {
+         FC_ASSERT( depth > 0 );
+         _out += '[';
+         put( int64_t( v.which() ), depth );
+         _out += ',';
+         v.visit( static_variant_writer{ *this, depth - 1 } );
+         _out += ']';
+      }
+
+      template< typename Container >
+      void put_array( const Container& c, uint32_t depth )
+      {
+         FC_ASSERT( depth > 0 );
+         _out += '[';
+         bool first = true;
+         for( const auto& item : c )
+         {
+            if( !first )
+               _out += ',';
+            first = false;
+            put( item, depth - 1 );
+         }
+         _out += ']';
+      }
+
+      /** the reflected to_variant() leaves out optional members that are not set */
+      template< typename M >
+      void put_member( const char* name, const fc::optional<M>& v, uint32_t depth )
+      {
+         if( v.valid() )
+            put_member( name, *v, depth );
+      }
+
+      template< typename M >
+      void put_member( const char* name, const M& v, uint32_t depth )
+      {
+         key( name );
+         put( v, depth );
+         _first = false;
+      }
+
+      void separate()
+      {
+         if( !_first )
+            _out += ',';
+         _first = false;
+      }
+
+      void append_string( const std::string& v )
+      {
+         static const char hex[] = "0123456789abcdef";
+         _out += '"';
+         for( const char c : v )
+         {
+            switch( c )
+            {
+               case '"':  _out += "\\\""; break;
+               case '\\': _out += "\\\\"; break;
+               case '\b': _out += "\\b"; break;
+               case '\f': _out += "\\f"; break;
+               case '\n': _out += "\\n"; break;
+               case '\r': _out += "\\r"; break;
+               case '\t': _out += "\\t"; break;
+               default:
+                  if( static_cast<unsigned char>( c ) < 0x20 )
+                  {
+                     _out += "\\u00";
+                     _out += hex[ ( c >> 4 ) & 0xf ];
+                     _out += hex[ c & 0xf ];
+                  }
+                  else
+                     _out += c;
+            }
+         }
+         _out += '"';
+      }
+
+      std::string&                _out;
+      fc::json::output_formatting _format;
+      uint32_t                    _max_depth;
+      bool                        _first = true;
+};
+
+/** @return what fc::json::to_string( fc::variant( v, max_depth ) ) returns, see json_writer */
+template< typename T >
+std::string to_json( const T& v, uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+{
+   std::string result;
+   json_writer( result, fc::json::stringify_large_ints_and_doubles, max_depth ).value( v );
+   return result;
+}
+
+} } // graphene::app
+
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::asset )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::price )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::transfer_operation )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::limit_order_create_operation )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::limit_order_cancel_operation )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::fill_order_operation )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::transaction )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::signed_transaction )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::precomputable_transaction )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::processed_transaction )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::block_header )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::signed_block_header )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::signed_block )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::account_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::account_statistics_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::account_balance_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::vesting_balance_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::limit_order_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::call_order_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::force_settlement_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::proposal_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::chain::withdraw_permission_object )
+GRAPHENE_JSON_WRITE_MEMBERS( graphene::app::full_account )
@@ -88,6 +88,14 @@ class abstract_plugin
          boost::program_options::options_description& command_line_options,
          boost::program_options::options_description& config_file_options
          ) = 0;
+
+      /**
+       * @brief The number of items waiting in each queue of the plugin, by queue name
+       *
+       * Reported by the metrics endpoint of the application. Called on the chain thread, plugins without queues
+       * need not override it.
+       */
+      virtual std::map<std::string, uint64_t> get_queue_depths()const { return std::map<std::string, uint64_t>(); }
 };
 
 /**
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/time.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * @brief Collects metrics in the Prometheus text exposition format, as served by the metrics-endpoint option
+    *
+    * Each metric family is started with family(), followed by its samples. Labels are passed preformatted, as
+    * built by label().
+    */
+   class prometheus_writer
+   {
+      public:
+         /// starts the family name, type is "gauge", "counter" or "histogram"
+         void family( const std::string& name, const std::string& type, const std::string& help );
+         void sample( const std::string& name, double value, const std::string& labels = std::string() );
+
+         /// @return key="value" with the value escaped, labels are joined with commas
+         static std::string label( const std::string& key, const std::string& value );
+
+         const std::string& str()const { return _out; }
+
+      private:
+         std::string _out;
+   };
+
+   /**
+    * @brief How long pushing the blocks received from the network took
+    *
+    * Written on the chain thread, read by the metrics endpoint.
+    */
+   class block_apply_histogram
+   {
+      public:
+         /// upper bounds of the buckets in seconds, the last bucket takes everything slower
+         static const std::vector<double>& bucket_bounds();
+
+         block_apply_histogram() : _buckets( bucket_bounds().size() + 1 ) {}
+
+         void record( const fc::microseconds& latency );
+         /// writes the histogram as the family name
+         void write( prometheus_writer& out, const std::string& name, const std::string& help )const;
+
+      private:
+         mutable std::mutex    _mutex;
+         /// not cumulative, the Prometheus buckets are summed up when writing
+         std::vector<uint64_t> _buckets;
+         uint64_t              _count = 0;
+         int64_t               _sum_us = 0;
+   };
+
+} }
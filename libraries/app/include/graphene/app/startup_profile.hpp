@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /// One step of the startup of the node, as returned by network_node_api::get_startup_profile()
+   struct startup_phase
+   {
+      /// e.g. "database::open", "object_database/1.2" or "plugin witness startup"
+      std::string name;
+      /// when the step started, in milliseconds after the application was created
+      int64_t     start_ms = 0;
+      int64_t     duration_us = 0;
+   };
+
+   /**
+    * @brief How long each step of the startup took
+    *
+    * Steps are recorded as they finish, so nested steps such as the indexes of the object database come before
+    * the step they are part of. Written during startup and read by API calls on other threads.
+    */
+   class startup_profile
+   {
+      public:
+         startup_profile() : _created( fc::time_point::now() ) {}
+
+         void record( const std::string& name, const fc::time_point& start, const fc::microseconds& elapsed );
+         /// records the time from start until now
+         void record_since( const std::string& name, const fc::time_point& start )
+         { record( name, start, fc::time_point::now() - start ); }
+
+         std::vector<startup_phase> get_phases()const;
+         /// writes the phases as JSON, the slowest first
+         void write_report( const fc::path& file )const;
+
+      private:
+         const fc::time_point       _created;
+         mutable std::mutex         _mutex;
+         std::vector<startup_phase> _phases;
+   };
+
+} }
+
+FC_REFLECT( graphene::app::startup_phase, (name)(start_ms)(duration_us) )
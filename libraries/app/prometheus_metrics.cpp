@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/prometheus_metrics.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace graphene { namespace app {
+
+namespace {
+   std::string format_value( double value )
+   {
+      if( std::isinf( value ) )
+         return value > 0 ? "+Inf" : "-Inf";
+      std::ostringstream out;
+      out << std::setprecision( 15 ) << value;
+      return out.str();
+   }
+}
+
+void prometheus_writer::family( const std::string& name, const std::string& type, const std::string& help )
+{
+   _out += "# HELP " + name + " " + help + "\n";
+   _out += "# TYPE " + name + " " + type + "\n";
+}
+
+void prometheus_writer::sample( const std::string& name, double value, const std::string& labels )
+{
+   _out += name;
+   if( !labels.empty() )
+      _out += "{" + labels + "}";
+   _out += " " + format_value( value ) + "\n";
+}
+
+std::string prometheus_writer::label( const std::string& key, const std::string& value )
+{
+   std::string result = key + "=\"";
+   for( char c : value )
+   {
+      if( c == '\\' || c == '"' )
+         result += '\\';
+      if( c == '\n' )
+      {
+         result += "\\n";
+         continue;
+      }
+      result += c;
+   }
+   return result + "\"";
+}
+
+const std::vector<double>& block_apply_histogram::bucket_bounds()
+{
+   static const std::vector<double> bounds = { 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5 };
+   return bounds;
+}
+
+void block_apply_histogram::record( const fc::microseconds& latency )
+{
+   const double seconds = latency.count() / 1000000.0;
+   const auto& bounds = bucket_bounds();
+   const size_t bucket = std::lower_bound( bounds.begin(), bounds.end(), seconds ) - bounds.begin();
+   std::lock_guard<std::mutex> lock( _mutex );
+   ++_buckets[bucket];
+   ++_count;
+   _sum_us += latency.count();
+}
+
+void block_apply_histogram::write( prometheus_writer& out, const std::string& name, const std::string& help )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   out.family( name, "histogram", help );
+   const auto& bounds = bucket_bounds();
+   uint64_t cumulative = 0;
+   for( size_t i = 0; i < bounds.size(); ++i )
+   {
+      cumulative += _buckets[i];
+      out.sample( name + "_bucket", cumulative, prometheus_writer::label( "le", format_value( bounds[i] ) ) );
+   }
+   out.sample( name + "_bucket", _count, prometheus_writer::label( "le", "+Inf" ) );
+   out.sample( name + "_sum", _sum_us / 1000000.0 );
+   out.sample( name + "_count", _count );
+}
+
+} }
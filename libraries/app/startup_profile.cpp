@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/startup_profile.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+void startup_profile::record( const std::string& name, const fc::time_point& start, const fc::microseconds& elapsed )
+{
+   startup_phase phase;
+   phase.name = name;
+   phase.start_ms = ( start - _created ).count() / 1000;
+   phase.duration_us = elapsed.count();
+   std::lock_guard<std::mutex> lock( _mutex );
+   _phases.push_back( std::move( phase ) );
+}
+
+std::vector<startup_phase> startup_profile::get_phases()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _phases;
+}
+
+void startup_profile::write_report( const fc::path& file )const
+{
+   std::vector<startup_phase> phases = get_phases();
+   std::stable_sort( phases.begin(), phases.end(), []( const startup_phase& a, const startup_phase& b ) {
+      return a.duration_us > b.duration_us;
+   });
+   fc::json::save_to_file( fc::variant( phases, 5 ), file );
+}
+
+} }
@@ -81,34 +81,42 @@ void verify_account_votes( const database& db, const account_options& options )
 
    if( has_worker_votes && (db.head_block_time() >= HARDFORK_607_TIME) )
    {
-      const auto& against_worker_idx = db.get_index_type<worker_index>().indices().get<by_vote_against>();
+      const auto& worker_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<worker_index>() )
+                                  .get_secondary_index<worker_vote_id_index>();
       for( auto id : options.votes )
       {
          if( id.type() == vote_id_type::worker )
          {
-            FC_ASSERT( against_worker_idx.find( id ) == against_worker_idx.end(),
+            const worker_object* worker = worker_idx.find( id );
+            FC_ASSERT( worker == nullptr || worker->vote_against.content != id.content,
                        "Can no longer vote against a worker." );
          }
       }
    }
    if ( db.head_block_time() >= HARDFORK_CORE_143_TIME ) {
-      const auto& approve_worker_idx = db.get_index_type<worker_index>().indices().get<by_vote_for>();
-      const auto& committee_idx = db.get_index_type<committee_member_index>().indices().get<by_vote_id>();
-      const auto& witness_idx = db.get_index_type<witness_index>().indices().get<by_vote_id>();
+      const auto& worker_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<worker_index>() )
+                                  .get_secondary_index<worker_vote_id_index>();
+      const auto& committee_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<committee_member_index>() )
+                                     .get_secondary_index<committee_member_vote_id_index>();
+      const auto& witness_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<witness_index>() )
+                                   .get_secondary_index<witness_vote_id_index>();
       for ( auto id : options.votes ) {
          switch ( id.type() ) {
             case vote_id_type::committee:
-               FC_ASSERT( committee_idx.find(id) != committee_idx.end(),
+               FC_ASSERT( committee_idx.find( id ) != nullptr,
                           "Can not vote for ${id} which does not exist.", ("id",id) );
                break;
             case vote_id_type::witness:
-               FC_ASSERT( witness_idx.find(id) != witness_idx.end(),
+               FC_ASSERT( witness_idx.find( id ) != nullptr,
                           "Can not vote for ${id} which does not exist.", ("id",id) );
                break;
             case vote_id_type::worker:
-               FC_ASSERT( approve_worker_idx.find( id ) != approve_worker_idx.end(),
+            {
+               const worker_object* worker = worker_idx.find( id );
+               FC_ASSERT( worker != nullptr && worker->vote_for.content == id.content,
                           "Can not vote for ${id} which does not exist.", ("id",id) );
                break;
+            }
             default:
                FC_THROW( "Invalid Vote Type: ${id}", ("id", id) );
                break;
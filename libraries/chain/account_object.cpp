@@ -27,6 +27,9 @@
 #include <graphene/chain/hardfork.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 namespace graphene { namespace chain {
 
 share_type cut_fee(share_type a, uint16_t p)
@@ -112,161 +115,297 @@ void account_statistics_object::pay_fee( share_type core_fee, share_type cashbac
       pending_vested_fees += core_fee;
 }
 
-set<account_id_type> account_member_index::get_account_members(const account_object& a)const
+namespace {
+
+template<typename T, typename Compare = std::less<T>>
+void sort_unique( vector<T>& v, Compare compare = Compare() )
 {
-   set<account_id_type> result;
-   for( auto auth : a.owner.account_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.account_auths )
-      result.insert(auth.first);
-   return result;
+   std::sort( v.begin(), v.end(), compare );
+   v.erase( std::unique( v.begin(), v.end() ), v.end() );
 }
-set<public_key_type, pubkey_comparator> account_member_index::get_key_members(const account_object& a)const
+
+template<typename Map, typename T>
+void add_memberships( Map& memberships, const vector<T>& members, account_id_type account )
 {
-   set<public_key_type, pubkey_comparator> result;
-   for( auto auth : a.owner.key_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.key_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   for( const T& item : members )
+      memberships[item].insert( account );
 }
-set<address> account_member_index::get_address_members(const account_object& a)const
+
+template<typename Map, typename T>
+void remove_memberships( Map& memberships, const vector<T>& members, account_id_type account )
 {
-   set<address> result;
-   for( auto auth : a.owner.address_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.address_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   for( const T& item : members )
+   {
+      auto itr = memberships.find( item );
+      if( itr == memberships.end() )
+         continue;
+      itr->second.erase( account );
+      if( itr->second.empty() )
+         memberships.erase( itr );
+   }
 }
 
-void account_member_index::object_inserted(const object& obj)
+/** Moves account from the members only in before to those only in after, both sorted by compare */
+template<typename Map, typename T, typename Compare = std::less<T>>
+void update_memberships( Map& memberships, const vector<T>& before, const vector<T>& after,
+                         account_id_type account, Compare compare = Compare() )
 {
-    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(obj);
-
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].insert(obj.id);
+   if( before == after )
+      return;
+   vector<T> changed;
+   std::set_difference( before.begin(), before.end(), after.begin(), after.end(),
+                        std::back_inserter( changed ), compare );
+   remove_memberships( memberships, changed, account );
+   changed.clear();
+   std::set_difference( after.begin(), after.end(), before.begin(), before.end(),
+                        std::back_inserter( changed ), compare );
+   add_memberships( memberships, changed, account );
+}
 
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].insert(obj.id);
+} // anonymous namespace
 
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].insert(obj.id);
+void account_member_index::get_members( const account_object& a, members& result )const
+{
+   result.accounts.clear();
+   for( const auto& auth : a.owner.account_auths )
+      result.accounts.push_back( auth.first );
+   for( const auto& auth : a.active.account_auths )
+      result.accounts.push_back( auth.first );
+   sort_unique( result.accounts );
+
+   result.keys.clear();
+   for( const auto& auth : a.owner.key_auths )
+      result.keys.push_back( auth.first );
+   for( const auto& auth : a.active.key_auths )
+      result.keys.push_back( auth.first );
+   result.keys.push_back( a.options.memo_key );
+   sort_unique( result.keys, pubkey_comparator() );
+
+   result.addresses.clear();
+   for( const auto& auth : a.owner.address_auths )
+      result.addresses.push_back( auth.first );
+   for( const auto& auth : a.active.address_auths )
+      result.addresses.push_back( auth.first );
+   result.addresses.push_back( address( a.options.memo_key ) );
+   sort_unique( result.addresses );
 }
 
-void account_member_index::object_removed(const object& obj)
+void account_authority_revision_index::about_to_modify( const object& before )
 {
-    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(obj);
+   assert( dynamic_cast<const account_object*>(&before) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(before);
+   _before_owner = a.owner;
+   _before_active = a.active;
+}
 
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].erase( obj.id );
+void account_authority_revision_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(after);
+   if( !( a.owner == _before_owner ) || !( a.active == _before_active ) )
+      ++_revision;
+}
 
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].erase( obj.id );
+void account_member_index::object_inserted(const object& obj)
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   const account_id_type account = a.get_id();
+
+   get_members( a, after_members );
+   add_memberships( account_to_account_memberships, after_members.accounts, account );
+   add_memberships( account_to_key_memberships, after_members.keys, account );
+   add_memberships( account_to_address_memberships, after_members.addresses, account );
+}
 
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].erase( obj.id );
+void account_member_index::object_removed(const object& obj)
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   const account_id_type account = a.get_id();
+
+   get_members( a, before_members );
+   remove_memberships( account_to_key_memberships, before_members.keys, account );
+   remove_memberships( account_to_address_memberships, before_members.addresses, account );
+   remove_memberships( account_to_account_memberships, before_members.accounts, account );
 }
 
 void account_member_index::about_to_modify(const object& before)
 {
-   before_key_members.clear();
-   before_account_members.clear();
    assert( dynamic_cast<const account_object*>(&before) ); // for debug only
-   const account_object& a = static_cast<const account_object&>(before);
-   before_key_members     = get_key_members(a);
-   before_address_members = get_address_members(a);
-   before_account_members = get_account_members(a);
+   get_members( static_cast<const account_object&>(before), before_members );
 }
 
 void account_member_index::object_modified(const object& after)
 {
-    assert( dynamic_cast<const account_object*>(&after) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(after);
-
-    {
-       set<account_id_type> after_account_members = get_account_members(a);
-       vector<account_id_type> removed; removed.reserve(before_account_members.size());
-       std::set_difference(before_account_members.begin(), before_account_members.end(),
-                           after_account_members.begin(), after_account_members.end(),
-                           std::inserter(removed, removed.end()));
-
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_account_memberships[*itr].erase(after.id);
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(after);
+   get_members( a, after_members );
+   // most modifications leave the authorities and the memo key alone
+   if( after_members == before_members )
+      return;
+
+   const account_id_type account = a.get_id();
+   update_memberships( account_to_account_memberships, before_members.accounts, after_members.accounts, account );
+   update_memberships( account_to_key_memberships, before_members.keys, after_members.keys, account,
+                       pubkey_comparator() );
+   update_memberships( account_to_address_memberships, before_members.addresses, after_members.addresses, account );
+}
 
-       vector<object_id_type> added; added.reserve(after_account_members.size());
-       std::set_difference(after_account_members.begin(), after_account_members.end(),
-                           before_account_members.begin(), before_account_members.end(),
-                           std::inserter(added, added.end()));
+uint64_t account_member_index::estimated_memory_usage()const
+{
+   return graphene::db::dynamic_memory_size( account_to_account_memberships )
+        + graphene::db::dynamic_memory_size( account_to_key_memberships )
+        + graphene::db::dynamic_memory_size( account_to_address_memberships );
+}
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_account_memberships[*itr].insert(after.id);
-    }
+void account_referrer_index::object_inserted( const object& obj )
+{
+}
+void account_referrer_index::object_removed( const object& obj )
+{
+}
+void account_referrer_index::about_to_modify( const object& before )
+{
+}
+void account_referrer_index::object_modified( const object& after  )
+{
+}
 
+uint64_t account_referrer_index::estimated_memory_usage()const
+{
+   return graphene::db::dynamic_memory_size( referred_by );
+}
 
-    {
-       set<public_key_type, pubkey_comparator> after_key_members = get_key_members(a);
+void account_maintenance_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) ); // for debug only
+   const account_statistics_object& stats = static_cast<const account_statistics_object&>(obj);
+   if( stats.need_maintenance() )
+      _accounts[stats.name] = &stats;
+}
 
-       vector<public_key_type> removed; removed.reserve(before_key_members.size());
-       std::set_difference(before_key_members.begin(), before_key_members.end(),
-                           after_key_members.begin(), after_key_members.end(),
-                           std::inserter(removed, removed.end()));
+void account_maintenance_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) ); // for debug only
+   const account_statistics_object& stats = static_cast<const account_statistics_object&>(obj);
+   auto itr = _accounts.find( stats.name );
+   if( itr != _accounts.end() && itr->second == &stats )
+      _accounts.erase( itr );
+}
 
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_key_memberships[*itr].erase(after.id);
+void account_maintenance_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&before) ); // for debug only
+   _needed_maintenance = static_cast<const account_statistics_object&>(before).need_maintenance();
+}
 
-       vector<public_key_type> added; added.reserve(after_key_members.size());
-       std::set_difference(after_key_members.begin(), after_key_members.end(),
-                           before_key_members.begin(), before_key_members.end(),
-                           std::inserter(added, added.end()));
+void account_maintenance_index::object_modified( const object& after  )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&after) ); // for debug only
+   const account_statistics_object& stats = static_cast<const account_statistics_object&>(after);
+   const bool needs_maintenance = stats.need_maintenance();
+   if( needs_maintenance == _needed_maintenance )
+      return;
+   if( needs_maintenance )
+      _accounts[stats.name] = &stats;
+   else
+      _accounts.erase( stats.name );
+}
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_key_memberships[*itr].insert(after.id);
-    }
+uint64_t account_maintenance_index::estimated_memory_usage()const
+{
+   return _accounts.size() * ( sizeof( accounts_type::value_type ) + 4 * sizeof( void* ) );
+}
 
-    {
-       set<address> after_address_members = get_address_members(a);
+uint64_t account_name_index::pack_prefix( const string& name )
+{
+   uint64_t result = 0;
+   for( size_t i = 0; i < 8; ++i )
+      result = ( result << 8 ) | ( i < name.size() ? uint8_t( name[i] ) : 0 );
+   return result;
+}
 
-       vector<address> removed; removed.reserve(before_address_members.size());
-       std::set_difference(before_address_members.begin(), before_address_members.end(),
-                           after_address_members.begin(), after_address_members.end(),
-                           std::inserter(removed, removed.end()));
+void account_name_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   const key k( a.name );
+   const entry e{ k.prefix, a.name, a.get_id() };
+   ++_size;
 
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_address_memberships[*itr].erase(after.id);
+   if( blocks.empty() )
+   {
+      blocks.emplace_back( 1, e );
+      last_entries.push_back( e );
+      return;
+   }
 
-       vector<address> added; added.reserve(after_address_members.size());
-       std::set_difference(after_address_members.begin(), after_address_members.end(),
-                           before_address_members.begin(), before_address_members.end(),
-                           std::inserter(added, added.end()));
+   // names beyond the last one go to the end of the last block
+   const size_t b = std::min( find_block( k ), blocks.size() - 1 );
+   vector<entry>& block = blocks[b];
+   block.insert( std::lower_bound( block.begin(), block.end(), k, entry_less() ), e );
+   last_entries[b] = block.back();
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_address_memberships[*itr].insert(after.id);
-    }
+   if( block.size() > max_block_size )
+   {
+      vector<entry> tail( block.begin() + block.size() / 2, block.end() );
+      block.erase( block.begin() + block.size() / 2, block.end() );
+      last_entries[b] = block.back();
+      last_entries.insert( last_entries.begin() + b + 1, tail.back() );
+      blocks.insert( blocks.begin() + b + 1, std::move( tail ) );
+   }
+}
 
+void account_name_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   const key k( a.name );
+   const size_t b = find_block( k );
+   if( b == blocks.size() ) return;
+
+   vector<entry>& block = blocks[b];
+   const auto itr = std::lower_bound( block.begin(), block.end(), k, entry_less() );
+   if( itr == block.end() || itr->id != a.get_id() ) return;
+   block.erase( itr );
+   --_size;
+
+   if( block.empty() )
+   {
+      blocks.erase( blocks.begin() + b );
+      last_entries.erase( last_entries.begin() + b );
+   }
+   else
+      last_entries[b] = block.back();
 }
 
-void account_referrer_index::object_inserted( const object& obj )
+void account_name_index::about_to_modify( const object& before )
 {
 }
-void account_referrer_index::object_removed( const object& obj )
+
+void account_name_index::object_modified( const object& after  )
 {
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   // account names are immutable, so the entry of the account is still in place
+   assert( find( static_cast<const account_object&>(after).name ).valid() );
 }
-void account_referrer_index::about_to_modify( const object& before )
+
+uint64_t account_name_index::estimated_memory_usage()const
 {
+   return graphene::db::dynamic_memory_size( blocks ) + graphene::db::dynamic_memory_size( last_entries );
 }
-void account_referrer_index::object_modified( const object& after  )
+
+optional<account_id_type> account_name_index::find( const string& name )const
 {
+   const key k( name );
+   const size_t b = find_block( k );
+   if( b == blocks.size() ) return optional<account_id_type>();
+
+   const vector<entry>& block = blocks[b];
+   const auto itr = std::lower_bound( block.begin(), block.end(), k, entry_less() );
+   if( itr == block.end() || itr->name != name ) return optional<account_id_type>();
+   return itr->id;
 }
 
 const uint8_t  balances_by_account_index::bits = 20;
@@ -274,7 +413,7 @@ const uint64_t balances_by_account_index::mask = (1ULL << balances_by_account_in
 
 void balances_by_account_index::object_inserted( const object& obj )
 {
-   const auto& abo = dynamic_cast< const account_balance_object& >( obj );
+   const auto& abo = static_cast< const account_balance_object& >( obj );
    while( balances.size() < (abo.owner.instance.value >> bits) + 1 )
    {
       balances.reserve( (abo.owner.instance.value >> bits) + 1 );
@@ -286,37 +425,135 @@ void balances_by_account_index::object_inserted( const object& obj )
 
 void balances_by_account_index::object_removed( const object& obj )
 {
-   const auto& abo = dynamic_cast< const account_balance_object& >( obj );
+   const auto& abo = static_cast< const account_balance_object& >( obj );
    if( balances.size() < (abo.owner.instance.value >> bits) + 1 ) return;
-   balances[abo.owner.instance.value >> bits][abo.owner.instance.value & mask].erase( abo.asset_type );
+   account_balances& mine = balances[abo.owner.instance.value >> bits][abo.owner.instance.value & mask];
+   mine.erase( abo.asset_type );
+   if( mine.empty() )
+      mine.shrink_to_fit();
 }
 
 void balances_by_account_index::about_to_modify( const object& before )
 {
-   ids_being_modified.emplace( before.id );
 }
 
 void balances_by_account_index::object_modified( const object& after  )
 {
-   FC_ASSERT( ids_being_modified.top() == after.id, "Modification of ID is not supported!");
-   ids_being_modified.pop();
+   // the index is keyed by owner and asset type, which must not change
+   assert( get_account_balance( static_cast< const account_balance_object& >( after ).owner,
+                                static_cast< const account_balance_object& >( after ).asset_type ) == &after );
 }
 
-const map< asset_id_type, const account_balance_object* >& balances_by_account_index::get_account_balances( const account_id_type& acct )const
+uint64_t balances_by_account_index::estimated_memory_usage()const
 {
-   static const map< asset_id_type, const account_balance_object* > _empty;
+   return graphene::db::dynamic_memory_size( balances );
+}
 
-   if( balances.size() < (acct.instance.value >> bits) + 1 ) return _empty;
-   return balances[acct.instance.value >> bits][acct.instance.value & mask];
+void asset_holder_rank_index::add( asset_id_type asset, const holder& h )
+{
+   if( h.balance == 0 ) return;
+   ranked_holders& holders = _assets[asset];
+   ++holders.size;
+
+   if( holders.blocks.empty() )
+   {
+      holders.blocks.emplace_back( 1, h );
+      holders.last_entries.push_back( h );
+      return;
+   }
+
+   // holders beyond the last one go to the end of the last block
+   const size_t b = std::min( size_t( std::lower_bound( holders.last_entries.begin(), holders.last_entries.end(), h,
+                                                        holder_less() ) - holders.last_entries.begin() ),
+                              holders.blocks.size() - 1 );
+   vector<holder>& block = holders.blocks[b];
+   block.insert( std::lower_bound( block.begin(), block.end(), h, holder_less() ), h );
+   holders.last_entries[b] = block.back();
+
+   if( block.size() > max_block_size )
+   {
+      vector<holder> tail( block.begin() + block.size() / 2, block.end() );
+      block.erase( block.begin() + block.size() / 2, block.end() );
+      holders.last_entries[b] = block.back();
+      holders.last_entries.insert( holders.last_entries.begin() + b + 1, tail.back() );
+      holders.blocks.insert( holders.blocks.begin() + b + 1, std::move( tail ) );
+   }
+}
+
+void asset_holder_rank_index::remove( asset_id_type asset, const holder& h )
+{
+   if( h.balance == 0 ) return;
+   const auto itr = _assets.find( asset );
+   if( itr == _assets.end() ) return;
+   ranked_holders& holders = itr->second;
+   const size_t b = std::lower_bound( holders.last_entries.begin(), holders.last_entries.end(), h, holder_less() )
+                    - holders.last_entries.begin();
+   if( b == holders.blocks.size() ) return;
+
+   vector<holder>& block = holders.blocks[b];
+   const auto pos = std::lower_bound( block.begin(), block.end(), h, holder_less() );
+   if( pos == block.end() || pos->owner != h.owner || pos->balance != h.balance ) return;
+   block.erase( pos );
+
+   if( --holders.size == 0 )
+   {
+      _assets.erase( itr );
+      return;
+   }
+   if( block.empty() )
+   {
+      holders.blocks.erase( holders.blocks.begin() + b );
+      holders.last_entries.erase( holders.last_entries.begin() + b );
+   }
+   else
+      holders.last_entries[b] = block.back();
+}
+
+void asset_holder_rank_index::object_inserted( const object& obj )
+{
+   const auto& abo = static_cast< const account_balance_object& >( obj );
+   add( abo.asset_type, holder{ abo.balance, abo.owner } );
+}
+
+void asset_holder_rank_index::object_removed( const object& obj )
+{
+   const auto& abo = static_cast< const account_balance_object& >( obj );
+   remove( abo.asset_type, holder{ abo.balance, abo.owner } );
+}
+
+void asset_holder_rank_index::about_to_modify( const object& before )
+{
+   const auto& abo = static_cast< const account_balance_object& >( before );
+   _before_asset = abo.asset_type;
+   _before = holder{ abo.balance, abo.owner };
+}
+
+void asset_holder_rank_index::object_modified( const object& after  )
+{
+   const auto& abo = static_cast< const account_balance_object& >( after );
+   // most modifications of balance objects only touch the maintenance flag
+   if( abo.balance == _before.balance && abo.owner == _before.owner && abo.asset_type == _before_asset )
+      return;
+   remove( _before_asset, _before );
+   add( abo.asset_type, holder{ abo.balance, abo.owner } );
 }
 
-const account_balance_object* balances_by_account_index::get_account_balance( const account_id_type& acct, const asset_id_type& asset )const
+uint64_t asset_holder_rank_index::estimated_memory_usage()const
 {
-   if( balances.size() < (acct.instance.value >> bits) + 1 ) return nullptr;
-   const auto& mine = balances[acct.instance.value >> bits][acct.instance.value & mask];
-   const auto itr = mine.find( asset );
-   if( mine.end() == itr ) return nullptr;
-   return itr->second;
+   uint64_t result = graphene::db::dynamic_memory_size( _assets );
+   for( const auto& item : _assets )
+      result += graphene::db::dynamic_memory_size( item.second.blocks )
+              + graphene::db::dynamic_memory_size( item.second.last_entries );
+   return result;
+}
+
+const balances_by_account_index::account_balances& balances_by_account_index::get_account_balances(
+      const account_id_type& acct )const
+{
+   static const account_balances _empty;
+
+   if( balances.size() < (acct.instance.value >> bits) + 1 ) return _empty;
+   return balances[acct.instance.value >> bits][acct.instance.value & mask];
 }
 
 } } // graphene::chain
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_cache.hpp>
+
+namespace graphene { namespace chain {
+
+void block_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   shrink();
+}
+
+size_t block_cache::capacity()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity;
+}
+
+void block_cache::insert( const signed_block& b )
+{
+   if( capacity() == 0 ) return;
+   insert( std::make_shared<const signed_block>( b ) );
+}
+
+void block_cache::insert( signed_block_ptr b )
+{
+   const uint32_t num = b->block_num();
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity == 0 ) return;
+   auto itr = _by_num.find( num );
+   if( itr != _by_num.end() )
+   {
+      _lru.erase( itr->second );
+      _by_num.erase( itr );
+   }
+   _lru.push_front( cached_block{ b->id(), std::move( b ), nullptr } );
+   _by_num[num] = _lru.begin();
+   shrink();
+}
+
+void block_cache::remove( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _by_num.find( block_num );
+   if( itr == _by_num.end() ) return;
+   _lru.erase( itr->second );
+   _by_num.erase( itr );
+}
+
+void block_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _lru.clear();
+   _by_num.clear();
+}
+
+void block_cache::shrink()
+{
+   while( _lru.size() > _capacity )
+   {
+      _by_num.erase( block_header::num_from_id( _lru.back().id ) );
+      _lru.pop_back();
+   }
+}
+
+const block_cache::cached_block* block_cache::lookup( uint32_t block_num )const
+{
+   auto itr = _by_num.find( block_num );
+   if( itr == _by_num.end() )
+      return nullptr;
+   _lru.splice( _lru.begin(), _lru, itr->second );
+   return &*itr->second;
+}
+
+signed_block_ptr block_cache::find( uint32_t block_num )const
+{
+   signed_block_ptr result;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const cached_block* entry = lookup( block_num );
+      if( entry != nullptr )
+         result = entry->block;
+   }
+   ++( result ? _hits : _misses );
+   return result;
+}
+
+signed_block_ptr block_cache::find( const block_id_type& id )const
+{
+   signed_block_ptr result;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const cached_block* entry = lookup( block_header::num_from_id( id ) );
+      if( entry != nullptr && entry->id == id )
+         result = entry->block;
+   }
+   ++( result ? _hits : _misses );
+   return result;
+}
+
+std::shared_ptr<const merkle_tree_levels> block_cache::find_merkle_tree( const block_id_type& id )const
+{
+   signed_block_ptr block;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const cached_block* entry = lookup( block_header::num_from_id( id ) );
+      if( entry == nullptr || entry->id != id )
+         return nullptr;
+      if( entry->merkle_tree )
+         return entry->merkle_tree;
+      block = entry->block;
+   }
+   // the tree is calculated without holding the lock, a concurrent call may calculate it as well
+   auto tree = std::make_shared<const merkle_tree_levels>( block->calculate_merkle_tree() );
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _by_num.find( block_header::num_from_id( id ) );
+   if( itr != _by_num.end() && itr->second->id == id && !itr->second->merkle_tree )
+      itr->second->merkle_tree = tree;
+   return tree;
+}
+
+block_cache_stats block_cache::get_stats()const
+{
+   block_cache_stats stats;
+   stats.hits = _hits;
+   stats.misses = _misses;
+   std::lock_guard<std::mutex> lock( _mutex );
+   stats.size = _lru.size();
+   stats.capacity = _capacity;
+   return stats;
+}
+
+} }
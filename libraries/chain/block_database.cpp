@@ -23,8 +23,18 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <cstring>
+#include <limits>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -33,82 +43,580 @@ struct index_entry
    uint32_t      block_size = 0;
    block_id_type block_id;
 };
+
+/** Read-only mapping of the first size bytes of a file */
+class mapped_file
+{
+   public:
+      mapped_file( const fc::path& filename, uint64_t s ) : size( s )
+      {
+         _mapping.reset( new fc::file_mapping( filename.generic_string().c_str(), fc::read_only ) );
+         _region.reset( new fc::mapped_region( *_mapping, fc::read_only, 0, size ) );
+         data = static_cast<const char*>( _region->get_address() );
+      }
+
+      const uint64_t size;
+      const char*    data = nullptr;
+
+   private:
+      std::unique_ptr<fc::file_mapping>  _mapping;
+      std::unique_ptr<fc::mapped_region> _region;
+};
+
+/** Mappings of the index and of all segments, as far as they were flushed when the view was created */
+class block_file_view
+{
+   public:
+      bool covers( uint64_t index_end, uint64_t blocks_end, uint64_t segment_limit )const
+      {
+         if( index_end > 0 && ( !index || index->size < index_end ) )
+            return false;
+         if( blocks_end == 0 )
+            return true;
+         const uint64_t segment = ( blocks_end - 1 ) / segment_limit;
+         return segment < segments.size() && segments[segment]
+                && segments[segment]->size >= blocks_end - segment * segment_limit;
+      }
+
+      std::shared_ptr<const mapped_file>         index;
+      vector< std::shared_ptr<const mapped_file> > segments;
+};
+
+namespace {
+   /** sanity limit for the size stored in a compressed record, well above any block size the chain allows */
+   const uint32_t max_uncompressed_block_size = 64 * 1024 * 1024;
+
+   /** compressed blocks are stored as their uncompressed size followed by the deflate stream, result receives them */
+   void compress_block( const vector<char>& packed, vector<char>& result )
+   {
+      const uint32_t raw_size = packed.size();
+      uLongf compressed_size = compressBound( packed.size() );
+      result.resize( sizeof(raw_size) + compressed_size );
+      std::memcpy( result.data(), &raw_size, sizeof(raw_size) );
+      const int status = compress2( (Bytef*)result.data() + sizeof(raw_size), &compressed_size,
+                                    (const Bytef*)packed.data(), packed.size(), Z_DEFAULT_COMPRESSION );
+      FC_ASSERT( status == Z_OK, "Unable to compress block, zlib error ${s}", ("s",status) );
+      result.resize( sizeof(raw_size) + compressed_size );
+   }
+
+   vector<char> decompress_block( const char* data, uint32_t size )
+   {
+      uint32_t raw_size;
+      FC_ASSERT( size > sizeof(raw_size), "Compressed block is truncated" );
+      std::memcpy( &raw_size, data, sizeof(raw_size) );
+      FC_ASSERT( raw_size <= max_uncompressed_block_size, "Compressed block has an invalid size" );
+      vector<char> result( raw_size );
+      uLongf result_size = raw_size;
+      const int status = uncompress( (Bytef*)result.data(), &result_size,
+                                     (const Bytef*)data + sizeof(raw_size), size - sizeof(raw_size) );
+      FC_ASSERT( status == Z_OK && result_size == raw_size, "Unable to decompress block, zlib error ${s}", ("s",status) );
+      return result;
+   }
+}
+
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
+/** Persistent parameters of a segmented database, stored next to the segments */
+struct block_log_info
+{
+   uint64_t segment_size = block_database::default_segment_size;
+   uint64_t first_segment = 0;
+   uint32_t first_block_num = 1;
+};
+ }}
+FC_REFLECT( graphene::chain::block_log_info, (segment_size)(first_segment)(first_block_num) );
+
+namespace graphene { namespace chain {
+
+const uint64_t block_database::default_segment_size;
+const size_t   block_database::max_pending_writes;
+
+void block_database::save_info()const
+{
+   block_log_info info;
+   info.segment_size = _segment_limit;
+   info.first_segment = _first_segment;
+   info.first_block_num = _first_block_num;
+   const fc::path tmp = _dbdir / "info.tmp";
+   fc::json::save_to_file( info, tmp );
+   fc::rename( tmp, _dbdir / "info" );
+}
+
+bool block_database::is_pruned( const fc::path& dbdir )
+{
+   if( has_legacy_format( dbdir ) || !fc::exists( dbdir / "info" ) )
+      return false;
+   return fc::json::from_file( dbdir / "info" ).as<block_log_info>( 2 ).first_block_num > 1;
+}
+
+fc::path block_database::segment_filename( uint64_t segment )const
+{
+   if( !_segmented )
+      return _dbdir / "blocks";
+   char name[32];
+   snprintf( name, sizeof(name), "blocks.%06u", unsigned(segment) );
+   return _dbdir / name;
+}
+
+bool block_database::has_legacy_format( const fc::path& dbdir )
+{
+   return fc::exists( dbdir / "blocks" );
+}
+
+void block_database::open_segment( uint64_t segment, bool create )
+{
+   _current_segment = segment;
+   auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+   if( create )
+      mode |= std::fstream::trunc;
+   _blocks.open( segment_filename( segment ).generic_string().c_str(), mode );
+}
+
+void block_database::open( const fc::path& dbdir, bool segmented, uint64_t segment_size )
 { try {
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
+   _dbdir = dbdir;
    _index_filename = dbdir / "index";
+   // finish a conversion that was interrupted after the legacy blocks were removed
+   if( fc::exists( dbdir / "index.new" ) && !has_legacy_format( dbdir ) )
+      fc::rename( dbdir / "index.new", _index_filename );
+
+   _first_segment = 0;
+   _first_block_num = 1;
    if( !fc::exists( _index_filename ) )
    {
+     _segmented = segmented;
+     _segment_limit = _segmented ? segment_size : std::numeric_limits<uint64_t>::max();
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     open_segment( 0, true );
+     if( _segmented )
+        save_info();
    }
    else
    {
+     _segmented = !has_legacy_format( dbdir );
+     _segment_limit = std::numeric_limits<uint64_t>::max();
+     if( _segmented )
+     {
+        block_log_info info;
+        if( fc::exists( dbdir / "info" ) )
+           info = fc::json::from_file( dbdir / "info" ).as<block_log_info>( 2 );
+        FC_ASSERT( info.segment_size > 0, "Invalid segment size in ${d}", ("d",dbdir) );
+        _segment_limit = info.segment_size;
+        _first_segment = info.first_segment;
+        _first_block_num = info.first_block_num;
+     }
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     uint64_t last_segment = _first_segment;
+     while( _segmented && fc::exists( segment_filename( last_segment + 1 ) ) )
+        ++last_segment;
+     open_segment( last_segment, !fc::exists( segment_filename( last_segment ) ) );
    }
+   _last_read_end = 0;
+   update_file_sizes();
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
+void block_database::open_read_only( const fc::path& dbdir )
+{ try {
+   FC_ASSERT( fc::exists( dbdir / "index" ), "No block database found in ${d}", ("d",dbdir) );
+   _dbdir = dbdir;
+   _index_filename = dbdir / "index";
+   _read_only = true;
+   _segmented = !has_legacy_format( dbdir );
+   _segment_limit = std::numeric_limits<uint64_t>::max();
+   _current_segment = 0;
+   _first_segment = 0;
+   _first_block_num = 1;
+   if( _segmented )
+   {
+      FC_ASSERT( fc::exists( dbdir / "info" ), "No segmented block database found in ${d}", ("d",dbdir) );
+      const block_log_info info = fc::json::from_file( dbdir / "info" ).as<block_log_info>( 2 );
+      FC_ASSERT( info.segment_size > 0, "Invalid segment size in ${d}", ("d",dbdir) );
+      _segment_limit = info.segment_size;
+   }
+   {
+      std::lock_guard<std::mutex> lock( _view_mutex );
+      _view.reset();
+   }
+   _index_size = 0;
+   _blocks_size = 0;
+   _last_read_end = 0;
+   refresh();
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+bool block_database::refresh()
+{ try {
+   FC_ASSERT( _read_only, "Only read-only block databases follow the files of another process" );
+   if( _segmented )
+   {
+      // the writer replaces the info file atomically when it prunes
+      const block_log_info info = fc::json::from_file( _dbdir / "info" ).as<block_log_info>( 2 );
+      _first_segment = info.first_segment;
+      _first_block_num = info.first_block_num;
+   }
+   // the writer flushes blocks before their index entries, so every entry within this size finds its block below
+   const uint64_t index_size = fc::file_size( _index_filename );
+   uint64_t last_segment = std::max( _current_segment.load(), _first_segment.load() );
+   while( _segmented && fc::exists( segment_filename( last_segment + 1 ) ) )
+      ++last_segment;
+   _current_segment = last_segment;
+   const fc::path last_file = segment_filename( last_segment );
+   const uint64_t blocks_size = last_segment * _segment_limit + ( fc::exists( last_file ) ? fc::file_size( last_file ) : 0 );
+
+   const uint64_t entries_size = index_size - index_size % sizeof(index_entry);
+   const bool changed = entries_size != _index_size || blocks_size != _blocks_size;
+   // blocks first, like update_file_sizes(), readers must not see an entry whose block is beyond the blocks size
+   _blocks_size = blocks_size;
+   _index_size = entries_size;
+   return changed;
+} FC_CAPTURE_AND_RETHROW( (_dbdir) ) }
+
+block_database::~block_database()
+{
+  stop_writer();
+}
+
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _read_only || _block_num_to_pos.is_open();
 }
 
 void block_database::close()
 {
+  if( _read_only )
+  {
+     {
+        std::lock_guard<std::mutex> lock( _view_mutex );
+        _view.reset();
+     }
+     _index_size = 0;
+     _blocks_size = 0;
+     _read_only = false;
+     return;
+  }
+  try
+  {
+     wait_for_writes();
+  }
+  catch( const fc::exception& e )
+  {
+     elog( "Closing the block database without its queued writes: ${e}", ("e", e.to_detail_string()) );
+  }
+  stop_writer();
+  {
+     std::lock_guard<std::mutex> lock( _write_mutex );
+     _write_queue.clear();
+     _pending_by_num.clear();
+     _write_error.reset();
+  }
+  {
+     std::lock_guard<std::mutex> lock( _view_mutex );
+     _view.reset();
+  }
+  _index_size = 0;
+  _blocks_size = 0;
   _blocks.close();
   _block_num_to_pos.close();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+  if( _read_only )
+     return;
+  wait_for_writes();
+  update_file_sizes();
+}
+
+void block_database::enable_write_behind()
+{
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   if( _writer.joinable() )
+      return;
+   _stop_writer = false;
+   _writer = std::thread( [this]{ write_loop(); } );
+}
+
+void block_database::stop_writer()
+{
+   if( !_writer.joinable() )
+      return;
+   {
+      std::lock_guard<std::mutex> lock( _write_mutex );
+      _stop_writer = true;
+   }
+   _write_cv.notify_all();
+   _writer.join();
+}
+
+void block_database::wait_for_writes( uint32_t block_num )const
+{
+   std::unique_lock<std::mutex> lock( _write_mutex );
+   _write_cv.wait( lock, [&]{
+      return _write_error.valid() || _pending_by_num.empty() || _pending_by_num.begin()->first > block_num;
+   } );
+   if( _write_error.valid() )
+      throw *_write_error;
+}
+
+void block_database::check_writes()const
+{
+   std::lock_guard<std::mutex> lock( _write_mutex );
+   if( _write_error.valid() )
+      throw *_write_error;
+}
+
+void block_database::enqueue_write( pending_write w )
+{
+   std::unique_lock<std::mutex> lock( _write_mutex );
+   _write_cv.wait( lock, [this]{ return _write_error.valid() || _write_queue.size() < max_pending_writes; } );
+   if( _write_error.valid() )
+      throw *_write_error;
+   w.sequence = ++_next_write_sequence;
+   _pending_by_num[ block_header::num_from_id( w.id ) ] = w;
+   _write_queue.push_back( std::move( w ) );
+   _write_cv.notify_all();
+}
+
+void block_database::write_loop()
+{
+   std::unique_lock<std::mutex> lock( _write_mutex );
+   while( true )
+   {
+      _write_cv.wait( lock, [this]{ return _stop_writer || !_write_queue.empty(); } );
+      if( _write_queue.empty() )
+         return;
+
+      // the write stays queued while it runs, so lookups keep finding it until it is in the files
+      pending_write w = _write_queue.front();
+      lock.unlock();
+      optional<fc::exception> error;
+      try
+      {
+         if( w.block )
+            store_now( w.id, *w.block );
+         else
+            remove_now( w.id );
+      }
+      catch( const fc::exception& e )
+      {
+         error = e;
+      }
+      catch( const std::exception& e )
+      {
+         error = fc::unhandled_exception( FC_LOG_MESSAGE( error, "${e}", ("e", e.what()) ) );
+      }
+      lock.lock();
+
+      if( error.valid() )
+      {
+         // the later writes would leave a gap in the files, they stay queued so that lookups still find them
+         error->append_log( FC_LOG_MESSAGE( error, "Background write of block #${n} ${id} failed, the block "
+                                                   "database accepts no more changes until it is reopened",
+                                            ("n", block_header::num_from_id( w.id ))("id", w.id) ) );
+         elog( "${e}", ("e", error->to_detail_string()) );
+         _write_error = error;
+         _write_cv.notify_all();
+         return;
+      }
+      _write_queue.pop_front();
+      auto itr = _pending_by_num.find( block_header::num_from_id( w.id ) );
+      if( itr != _pending_by_num.end() && itr->second.sequence == w.sequence )
+         _pending_by_num.erase( itr );
+      _write_cv.notify_all();
+   }
+}
+
+bool block_database::find_pending( uint32_t block_num, pending_write& w )const
+{
+   if( !_writer.joinable() )
+      return false;
+   std::lock_guard<std::mutex> lock( _write_mutex );
+   auto itr = _pending_by_num.find( block_num );
+   if( itr == _pending_by_num.end() )
+      return false;
+   w = itr->second;
+   return true;
+}
+
+void block_database::update_file_sizes()const
+{
+   _blocks.flush();
+   _block_num_to_pos.flush();
+   // publish the blocks first, so that readers never see an index entry without its block
+   _blocks.seekp( 0, _blocks.end );
+   _blocks_size = _current_segment * _segment_limit + uint64_t( _blocks.tellp() );
+   _block_num_to_pos.seekp( 0, _block_num_to_pos.end );
+   _index_size = uint64_t( _block_num_to_pos.tellp() );
+}
+
+std::shared_ptr<const block_file_view> block_database::get_view( uint64_t index_size, uint64_t blocks_size )const
+{
+   std::lock_guard<std::mutex> lock( _view_mutex );
+   if( _view && _view->covers( index_size, blocks_size, _segment_limit ) )
+      return _view;
+
+   auto view = std::make_shared<block_file_view>();
+   const uint64_t index_end = _index_size;
+   const uint64_t blocks_end = _blocks_size;
+   if( index_end > 0 )
+      view->index = std::make_shared<const mapped_file>( _index_filename, index_end );
+   const uint64_t last_segment = blocks_end == 0 ? 0 : ( blocks_end - 1 ) / _segment_limit;
+   for( uint64_t segment = 0; segment <= last_segment && blocks_end > 0; ++segment )
+   {
+      if( segment < _first_segment )
+         view->segments.push_back( std::shared_ptr<const mapped_file>() ); // pruned
+      else if( segment < last_segment )
+      {
+         // completed segments never change, keep their mappings
+         if( _view && segment < _view->segments.size() && _view->segments[segment]
+                   && _view->segments[segment]->size == fc::file_size( segment_filename( segment ) ) )
+            view->segments.push_back( _view->segments[segment] );
+         else
+            view->segments.push_back( std::make_shared<const mapped_file>( segment_filename( segment ),
+                                                                            fc::file_size( segment_filename( segment ) ) ) );
+      }
+      else
+         view->segments.push_back( std::make_shared<const mapped_file>( segment_filename( segment ),
+                                                                         blocks_end - segment * _segment_limit ) );
+   }
+   _view = view;
+   return _view;
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_end = sizeof(e) * uint64_t(block_num) + sizeof(e);
+   if( index_end > _index_size || block_num < _first_block_num )
+      return false;
+   auto view = get_view( index_end, 0 );
+   std::memcpy( (char*)&e, view->index->data + index_end - sizeof(e), sizeof(e) );
+   return true;
+}
+
+const char* block_database::locate_block( const index_entry& e, std::shared_ptr<const block_file_view>& view )const
+{
+   const uint64_t block_end = e.block_pos + e.block_size;
+   FC_ASSERT( e.block_size > 0 && block_end <= _blocks_size, "Block ${id} is not contained in the blocks file",
+              ("id",e.block_id) );
+   const uint64_t segment = e.block_pos / _segment_limit;
+   FC_ASSERT( block_end <= ( segment + 1 ) * _segment_limit, "Block ${id} crosses a segment boundary", ("id",e.block_id) );
+   FC_ASSERT( segment >= _first_segment, "Block ${id} was pruned", ("id",e.block_id) );
+   view = get_view( 0, block_end );
+   _last_read_end = block_end;
+   return view->segments[segment]->data + ( e.block_pos - segment * _segment_limit );
+}
+
+vector<char> block_database::read_raw_block( const index_entry& e )const
+{
+   std::shared_ptr<const block_file_view> view;
+   const char* data = locate_block( e, view );
+   if( _segmented )
+      return decompress_block( data, e.block_size );
+   return vector<char>( data, data + e.block_size );
+}
+
+signed_block block_database::read_block( const index_entry& e )const
+{
+   std::shared_ptr<const block_file_view> view;
+   const char* data = locate_block( e, view );
+
+   signed_block result;
+   if( _segmented )
+      fc::raw::unpack( decompress_block( data, e.block_size ), result );
+   else
+   {
+      fc::datastream<const char*> ds( data, e.block_size );
+      fc::raw::unpack( ds, result );
+   }
+   FC_ASSERT( result.id() == e.block_id );
+   return result;
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
 {
+   FC_ASSERT( !_read_only, "The block database is read-only" );
    block_id_type id = _id;
    if( id == block_id_type() )
    {
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
+   if( !_writer.joinable() )
+      return store_now( id, b );
+   store( id, std::make_shared<const signed_block>( b ) );
+}
+
+void block_database::store( const block_id_type& id, const signed_block_ptr& b )
+{
+   if( id == block_id_type() || !_writer.joinable() )
+      return store( id, *b );
+
+   pending_write w;
+   w.id = id;
+   w.block = b;
+   enqueue_write( std::move( w ) );
+}
+
+void block_database::store_now( const block_id_type& id, const signed_block& b )
+{
    _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
    index_entry e;
    _blocks.seekp( 0, _blocks.end );
-   auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   // the buffers keep their capacity, so storing a block does not allocate once they have grown to the block size
+   _pack_buffer.resize( fc::raw::pack_size( b ) );
+   fc::datastream<char*> ds( _pack_buffer.data(), _pack_buffer.size() );
+   fc::raw::pack( ds, b );
+   if( _segmented )
+      compress_block( _pack_buffer, _compress_buffer );
+   const vector<char>& vec = _segmented ? _compress_buffer : _pack_buffer;
+   uint64_t offset = _blocks.tellp();
+   if( _segmented && offset > 0 && offset + vec.size() > _segment_limit )
+   {
+      _blocks.close();
+      open_segment( _current_segment + 1, true );
+      offset = 0;
+   }
+   e.block_pos  = _current_segment * _segment_limit + offset;
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   update_file_sizes();
 }
 
 void block_database::remove( const block_id_type& id )
-{ try {
+{
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   if( !_writer.joinable() )
+      return remove_now( id );
+
+   pending_write w;
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !find_pending( block_header::num_from_id(id), w ) && !read_index_entry( block_header::num_from_id(id), e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+   w = pending_write();
+   w.id = id;
+   enqueue_write( std::move( w ) );
+}
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+void block_database::remove_now( const block_id_type& id )
+{ try {
+   index_entry e;
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
    if( e.block_id == id )
    {
       e.block_size = 0;
       _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      update_file_sizes();
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
@@ -117,13 +625,13 @@ bool block_database::contains( const block_id_type& id )const
    if( id == block_id_type() )
       return false;
 
+   pending_write w;
+   if( find_pending( block_header::num_from_id(id), w ) )
+      return w.block && w.id == id;
+
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size > 0;
 }
@@ -131,15 +639,14 @@ bool block_database::contains( const block_id_type& id )const
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
+   pending_write w;
+   if( find_pending( block_num, w ) && w.block )
+      return w.id;
+
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
@@ -148,24 +655,21 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
 {
    try
    {
+      pending_write w;
+      if( find_pending( block_header::num_from_id(id), w ) )
+      {
+         if( w.block && w.id == id )
+            return *w.block;
+         return optional<signed_block>();
+      }
+
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -180,19 +684,219 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
+      pending_write w;
+      if( find_pending( block_num, w ) )
+      {
+         if( w.block )
+            return *w.block;
+         return optional<signed_block>();
+      }
+
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      return read_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<signed_block>();
+}
+
+bool block_database::check_index_entry( uint32_t block_num )const
+{
+   try
+   {
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size == 0
+          || block_header::num_from_id( e.block_id ) != block_num )
+         return false;
+      std::shared_ptr<const block_file_view> view;
+      const char* data = locate_block( e, view );
+      // the packed block starts with its packed header, which is all that is needed to check the id
+      signed_block_header header;
+      if( _segmented )
+      {
+         const vector<char> packed = decompress_block( data, e.block_size );
+         fc::datastream<const char*> ds( packed.data(), packed.size() );
+         fc::raw::unpack( ds, header );
+      }
+      else
+      {
+         fc::datastream<const char*> ds( data, e.block_size );
+         fc::raw::unpack( ds, header );
+      }
+      return header.id() == e.block_id;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
+void block_database::truncate_index( uint32_t block_num )const
+{
+   fc::resize_file( _index_filename, sizeof(index_entry) * uint64_t(block_num) );
+   {
+      std::lock_guard<std::mutex> lock( _view_mutex );
+      _view.reset();
+   }
+   update_file_sizes();
+}
+
+uint32_t block_database::verify_and_repair( uint32_t first_block_num, uint32_t thread_count )
+{ try {
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   wait_for_writes();
+   first_block_num = std::max( first_block_num, _first_block_num.load() );
+   const uint64_t entry_count = _index_size / sizeof(index_entry);
+   if( entry_count <= first_block_num )
+      return entry_count > 0 ? uint32_t( entry_count - 1 ) : 0;
+   const uint32_t last_block_num = uint32_t( entry_count - 1 );
+
+   if( thread_count == 0 )
+      thread_count = std::max( 1u, std::thread::hardware_concurrency() );
+   const uint32_t chunk_size = 10000;
+   std::atomic<uint32_t> next_chunk_start{ first_block_num };
+   // lowest invalid block found so far, chunks above it need not be checked
+   std::atomic<uint32_t> first_invalid{ last_block_num + 1 };
+   auto worker = [&]() {
+      while( true )
+      {
+         const uint32_t start = next_chunk_start.fetch_add( chunk_size );
+         if( start > last_block_num || start >= first_invalid )
+            return;
+         const uint32_t end = std::min( last_block_num, start + chunk_size - 1 );
+         for( uint32_t num = start; num <= end && num < first_invalid; ++num )
+         {
+            if( check_index_entry( num ) )
+               continue;
+            uint32_t current = first_invalid;
+            while( num < current && !first_invalid.compare_exchange_weak( current, num ) );
+            break;
+         }
+      }
+   };
+   vector<std::thread> threads;
+   for( uint32_t i = 1; i < thread_count; ++i )
+      threads.emplace_back( worker );
+   worker();
+   for( std::thread& t : threads )
+      t.join();
+
+   if( first_invalid <= last_block_num )
+   {
+      wlog( "Block database is damaged at block ${n}, dropping ${c} blocks from there on",
+            ("n", first_invalid.load())("c", last_block_num + 1 - first_invalid) );
+      truncate_index( first_invalid );
+   }
+   return first_invalid - 1;
+} FC_CAPTURE_AND_RETHROW( (first_block_num) ) }
+
+uint32_t block_database::import_from( const block_database& source, uint32_t thread_count )
+{ try {
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   wait_for_writes();
+   const optional<block_id_type> local_last = last_id();
+   FC_ASSERT( local_last.valid() || source.first_block_num() <= _first_block_num,
+              "The imported block database is pruned, it lacks the blocks before ${n}",
+              ("n", source.first_block_num()) );
+   uint32_t next_num = local_last.valid() ? block_header::num_from_id( *local_last ) + 1 : _first_block_num.load();
+   // the first block of an empty database has nothing to link to
+   optional<block_id_type> previous = local_last;
+
+   if( thread_count == 0 )
+      thread_count = std::max( 1u, std::thread::hardware_concurrency() );
+   const uint32_t window_size = 10000;
+   uint64_t imported = 0;
+   while( true )
+   {
+      const vector<vector<char>> raw = source.fetch_raw_range( next_num, window_size );
+      if( raw.empty() )
+         break;
+
+      // the checks of a window run in parallel, a failed block ends the window before it
+      vector<signed_block> blocks( raw.size() );
+      vector<block_id_type> ids( raw.size() );
+      std::atomic<uint32_t> next_block{ 0 };
+      std::atomic<uint32_t> first_invalid{ uint32_t( raw.size() ) };
+      auto worker = [&]() {
+         while( true )
+         {
+            const uint32_t i = next_block.fetch_add( 1 );
+            if( i >= raw.size() || i >= first_invalid )
+               return;
+            bool valid = false;
+            try
+            {
+               blocks[i] = fc::raw::unpack<signed_block>( raw[i] );
+               ids[i] = blocks[i].id();
+               valid = blocks[i].block_num() == next_num + i && ids[i] == source.fetch_block_id( next_num + i )
+                       && blocks[i].calculate_merkle_root() == blocks[i].transaction_merkle_root;
+            }
+            catch( const fc::exception& e )
+            {
+               wlog( "Unable to read block ${n} of the imported block database: ${e}",
+                     ("n", next_num + i)("e", e.to_detail_string()) );
+            }
+            if( valid )
+               continue;
+            uint32_t current = first_invalid;
+            while( i < current && !first_invalid.compare_exchange_weak( current, i ) );
+         }
+      };
+      vector<std::thread> threads;
+      for( uint32_t t = 1; t < thread_count && t < raw.size(); ++t )
+         threads.emplace_back( worker );
+      worker();
+      for( std::thread& t : threads )
+         t.join();
+
+      uint32_t stored = 0;
+      for( ; stored < first_invalid && ( !previous.valid() || blocks[stored].previous == *previous ); ++stored )
+      {
+         store( ids[stored], blocks[stored] );
+         previous = ids[stored];
+      }
+      imported += stored;
+      next_num += stored;
+      if( stored < raw.size() )
+      {
+         wlog( "Stopped importing blocks at block ${n}, it is damaged or does not link to the block before it",
+               ("n", next_num) );
+         break;
+      }
+      ilog( "Imported blocks up to ${n}", ("n", next_num - 1) );
+   }
+   flush();
+   ilog( "Imported ${c} blocks", ("c", imported) );
+   return next_num - 1;
+} FC_CAPTURE_AND_RETHROW( (thread_count) ) }
+
+optional<packed_block> block_database::fetch_packed_by_number( uint32_t block_num )const
+{
+   try
+   {
+      pending_write w;
+      if( find_pending( block_num, w ) )
+      {
+         if( w.block )
+            return packed_block( *w.block );
+         return optional<packed_block>();
+      }
+
+      index_entry e;
+      if( !read_index_entry( block_num, e ) )
+         return optional<packed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      packed_block result( read_raw_block( e ) );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -202,10 +906,81 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return optional<packed_block>();
+}
+
+optional<vector<char>> block_database::fetch_raw( const block_id_type& id )const
+{
+   try
+   {
+      const uint32_t block_num = block_header::num_from_id(id);
+      pending_write w;
+      if( find_pending( block_num, w ) )
+      {
+         if( w.block && w.id == id )
+            return fc::raw::pack( *w.block );
+         return optional<vector<char>>();
+      }
+
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_id != id )
+         return optional<vector<char>>();
+      return read_raw_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<vector<char>>();
+}
+
+vector<vector<char>> block_database::fetch_raw_range( uint32_t first_block_num, uint32_t count )const
+{
+   vector<vector<char>> result;
+   result.reserve( count );
+   try
+   {
+      for( uint32_t block_num = first_block_num; block_num - first_block_num < count; ++block_num )
+      {
+         pending_write w;
+         if( find_pending( block_num, w ) )
+         {
+            if( !w.block )
+               break;
+            result.push_back( fc::raw::pack( *w.block ) );
+            continue;
+         }
+         index_entry e;
+         if( !read_index_entry( block_num, e ) || e.block_size == 0 )
+            break;
+         result.push_back( read_raw_block( e ) );
+      }
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return result;
 }
 
 optional<index_entry> block_database::last_index_entry()const {
+   if( _read_only )
+   {
+      // the files belong to another process, entries it has not finished writing are skipped rather than truncated
+      for( uint64_t num = _index_size / sizeof(index_entry); num-- > _first_block_num; )
+      {
+         index_entry e;
+         if( check_index_entry( uint32_t( num ) ) && read_index_entry( uint32_t( num ), e ) )
+            return e;
+      }
+      return optional<index_entry>();
+   }
+   // the index is read through the write stream
+   wait_for_writes();
    try
    {
       index_entry e;
@@ -217,26 +992,17 @@ optional<index_entry> block_database::last_index_entry()const {
 
       pos -= pos % sizeof(index_entry);
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
       while( pos > 0 )
       {
          pos -= sizeof(index_entry);
          _block_num_to_pos.seekg( pos );
          _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size > 0
-                && int64_t(e.block_pos + e.block_size) <= blocks_size )
+         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size > 0 )
             try
             {
-               vector<char> data( e.block_size );
-               _blocks.seekg( e.block_pos );
-               _blocks.read( data.data(), e.block_size );
-               if( _blocks.gcount() == long(e.block_size) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               // the header is enough to check the entry against the file
+               FC_ASSERT( packed_block( read_raw_block( e ) ).id() == e.block_id );
+               return e;
             }
             catch (const fc::exception&)
             {
@@ -244,7 +1010,7 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
-         fc::resize_file( _index_filename, pos );
+         truncate_index( uint32_t( pos / sizeof(index_entry) ) );
       }
    }
    catch (const fc::exception&)
@@ -270,15 +1036,101 @@ optional<block_id_type> block_database::last_id()const
    return optional<block_id_type>();
 }
 
+bool block_database::prune( uint32_t first_kept_block, bool dry_run )
+{ try {
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   FC_ASSERT( _segmented, "Only segmented block databases can be pruned" );
+   if( first_kept_block <= _first_block_num )
+      return false;
+
+   // quick check whether the oldest segment can go at all
+   index_entry e;
+   if( !read_index_entry( first_kept_block, e ) || e.block_size == 0
+         || e.block_pos / _segment_limit <= _first_segment )
+      return false;
+
+   // blocks replaced by a fork are appended again, so a kept block can live in any later segment
+   uint64_t keep_segment = _current_segment;
+   const uint64_t entry_count = _index_size / sizeof(index_entry);
+   for( uint64_t num = first_kept_block; num < entry_count && keep_segment > _first_segment; ++num )
+      if( read_index_entry( num, e ) && e.block_size > 0 )
+         keep_segment = std::min( keep_segment, e.block_pos / _segment_limit );
+   if( keep_segment <= _first_segment )
+      return false;
+   if( dry_run )
+      return true;
+
+   const uint64_t old_first_segment = _first_segment;
+   _first_block_num = first_kept_block;
+   _first_segment = keep_segment;
+   save_info();
+   {
+      std::lock_guard<std::mutex> lock( _view_mutex );
+      _view.reset();
+   }
+   for( uint64_t segment = old_first_segment; segment < keep_segment; ++segment )
+      fc::remove( segment_filename( segment ) );
+   ilog( "Pruned block segments ${a} to ${b}, blocks before ${n} are no longer available",
+         ("a",old_first_segment)("b",keep_segment - 1)("n",first_kept_block) );
+   return true;
+} FC_CAPTURE_AND_RETHROW( (first_kept_block)(dry_run) ) }
+
+void block_database::start_at( uint32_t first_block_num )
+{ try {
+   FC_ASSERT( !_read_only, "The block database is read-only" );
+   FC_ASSERT( _segmented, "Only segmented block databases can start after genesis" );
+   FC_ASSERT( !last_id().valid(), "The block database is not empty" );
+   _first_block_num = std::max( first_block_num, 1u );
+   save_info();
+} FC_CAPTURE_AND_RETHROW( (first_block_num) ) }
+
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   return (size_t)_last_read_end.load();
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   return (size_t)_blocks_size.load();
 }
 
+void block_database::convert_to_segmented( const fc::path& dbdir )
+{ try {
+   FC_ASSERT( has_legacy_format( dbdir ) && fc::exists( dbdir / "index" ),
+              "No block database in the legacy format found in ${d}", ("d",dbdir) );
+   const fc::path tmp_dir = dbdir / "segmented.tmp";
+   fc::remove_all( tmp_dir );
+   {
+      block_database src;
+      src.open( dbdir );
+      block_database dst;
+      dst.open( tmp_dir, true );
+      optional<index_entry> last = src.last_index_entry();
+      const uint32_t last_num = last.valid() ? block_header::num_from_id( last->block_id ) : 0;
+      ilog( "Converting ${n} blocks in ${d} to the segmented format", ("n",last_num)("d",dbdir) );
+      for( uint32_t num = 1; num <= last_num; ++num )
+      {
+         index_entry e;
+         if( !src.read_index_entry( num, e ) || e.block_size == 0 )
+            continue;
+         dst.store( e.block_id, src.read_block( e ) );
+         if( num % 100000 == 0 )
+            ilog( "   converted ${i} of ${n} blocks", ("i",num)("n",last_num) );
+      }
+      ilog( "Compressed ${a} bytes of blocks into ${b}", ("a",src.total_block_size())("b",dst.total_block_size()) );
+      dst.close();
+      src.close();
+   }
+
+   // Move the segments in first and the new index last, open() completes the conversion if this is interrupted
+   // after the legacy blocks file is gone.
+   for( fc::directory_iterator itr( tmp_dir ); itr != fc::directory_iterator(); ++itr )
+      if( itr->filename().generic_string() != "index" )
+         fc::rename( *itr, dbdir / itr->filename() );
+   fc::rename( tmp_dir / "index", dbdir / "index.new" );
+   fc::remove( dbdir / "blocks" );
+   fc::rename( dbdir / "index.new", dbdir / "index" );
+   fc::remove_all( tmp_dir );
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
 } }
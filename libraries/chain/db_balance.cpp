@@ -33,8 +33,7 @@ namespace graphene { namespace chain {
 
 asset database::get_balance(account_id_type owner, asset_id_type asset_id) const
 {
-   auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
-   auto abo = index.get_account_balance( owner, asset_id );
+   const account_balance_object* abo = _balances_by_account->get_account_balance( owner, asset_id );
    if( !abo )
       return asset(0, asset_id);
    return abo->get_balance();
@@ -55,8 +54,7 @@ void database::adjust_balance(account_id_type account, asset delta )
    if( delta.amount == 0 )
       return;
 
-   auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
-   auto abo = index.get_account_balance( account, delta.asset_id );
+   const account_balance_object* abo = _balances_by_account->get_account_balance( account, delta.asset_id );
    if( !abo )
    {
       FC_ASSERT( delta.amount > 0, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", 
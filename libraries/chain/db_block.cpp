@@ -25,9 +25,11 @@
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/impacted.hpp>
 
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 
 #include <graphene/chain/proposal_object.hpp>
@@ -37,13 +39,32 @@
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/evaluator.hpp>
 
-#include <fc/thread/parallel.hpp>
+#include <graphene/db/apply_phase.hpp>
+#include <graphene/db/task_scheduler.hpp>
+#include <graphene/db/trace.hpp>
+
+#include <fc/thread/thread_specific.hpp>
+
+#include <limits>
+#include <unordered_map>
 
 namespace graphene { namespace chain {
 
 bool database::is_known_block( const block_id_type& id )const
 {
-   return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
+   if( _fork_db.is_known_block(id) )
+      return true;
+   const uint32_t num = block_header::num_from_id( id );
+   // most inventory announced by peers is either reversible or not there yet, neither needs the disk
+   if( num == 0 || num > head_block_num() )
+      return false;
+   // the block summaries hold the ids of the last 64k blocks of our chain, other forks are in the fork database
+   if( head_block_num() - num < 0x10000 )
+   {
+      if( _block_summaries->size() > ( num & 0xffff ) )
+         return _block_summaries->at( num & 0xffff ).block_id == id;
+   }
+   return _block_id_to_block.contains(id);
 }
 /**
  * Only return true *if* the transaction has not expired or been invalidated. If this
@@ -63,27 +84,93 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
 
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
+   auto cached = _block_cache.find( id );
+   if( cached )
+      return *cached;
    auto b = _fork_db.fetch_block( id );
    if( !b )
       return _block_id_to_block.fetch_optional(id);
-   return b->data;
+   return *b->data;
 }
 
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
 {
+   auto cached = _block_cache.find( num );
+   if( cached )
+      return *cached;
    auto results = _fork_db.fetch_block_by_number(num);
    if( results.size() == 1 )
-      return results[0]->data;
-   else
-      return _block_id_to_block.fetch_by_number(num);
+      return *results[0]->data;
+   optional<signed_block> result = _block_id_to_block.fetch_by_number(num);
+   if( result.valid() && num <= head_block_num() )
+      _block_cache.insert( *result );
+   return result;
+}
+
+optional<signed_block_header> database::fetch_block_header_by_number( uint32_t num )const
+{
+   auto cached = _block_cache.find( num );
+   if( cached )
+      return signed_block_header( *cached );
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return signed_block_header( *results[0]->data );
+   auto packed = _block_id_to_block.fetch_packed_by_number( num );
+   if( packed.valid() )
+      return packed->header();
+   return optional<signed_block_header>();
+}
+
+vector<vector<char>> database::fetch_raw_blocks( uint32_t first_block_num, uint32_t count )const
+{
+   return _block_id_to_block.fetch_raw_range( first_block_num, count );
+}
+
+optional<vector<char>> database::fetch_raw_block_by_id( const block_id_type& id )const
+{
+   return _block_id_to_block.fetch_raw( id );
+}
+
+vector< optional<precomputable_transaction> > database::find_pending_transactions(
+      const vector<transaction_id_type>& trx_ids )const
+{
+   vector< optional<precomputable_transaction> > result( trx_ids.size() );
+   if( trx_ids.empty() || _pending_tx.empty() )
+      return result;
+   std::unordered_map< transaction_id_type, size_t > positions;
+   positions.reserve( trx_ids.size() );
+   for( size_t i = 0; i < trx_ids.size(); ++i )
+      positions.emplace( trx_ids[i], i );
+   for( const processed_transaction& trx : _pending_tx )
+   {
+      auto itr = positions.find( trx.id() );
+      if( itr != positions.end() )
+         result[itr->second] = precomputable_transaction( trx );
+   }
+   return result;
 }
 
-const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
+signed_transaction database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
    auto itr = index.find(trx_id);
    FC_ASSERT(itr != index.end());
-   return itr->trx;
+   if( itr->block_num > head_block_num() )
+   {
+      for( const processed_transaction& trx : _pending_tx )
+         if( trx.id() == trx_id )
+            return trx;
+   }
+   else
+   {
+      optional<signed_block> block = fetch_block_by_number( itr->block_num );
+      if( block.valid() )
+         for( const processed_transaction& trx : block->transactions )
+            if( trx.id() == trx_id )
+               return trx;
+   }
+   FC_THROW_EXCEPTION( fc::key_not_found_exception, "Transaction ${id} is not in block ${n}",
+                       ("id",trx_id)("n",itr->block_num) );
 }
 
 std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of_fork) const
@@ -104,6 +191,72 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
   return result;
 }
 
+/** identifies the fc task that runs, or the thread outside of tasks */
+static const void* current_task_token()
+{
+   static fc::task_specific_ptr<char> token;
+   if( token.get() == nullptr )
+      token.reset( new char() );
+   return token.get();
+}
+
+database::state_write_guard::state_write_guard( database& db ) : _db(db)
+{
+   if( !_db._concurrent_reads )
+      return;
+   const void* self = current_task_token();
+   // only the task that holds the lock reads back its own token
+   if( _db._state_writer.load( std::memory_order_relaxed ) != self )
+   {
+      // a fiber of the writer's thread yields on the fiber mutex, the shared mutex would block the writer as well
+      _db._state_writer_mutex.lock();
+      _db._state_mutex.lock();
+      _db._state_writer.store( self, std::memory_order_relaxed );
+   }
+   ++_db._state_write_depth;
+   _locked = true;
+}
+
+database::state_write_guard::~state_write_guard()
+{
+   if( !_locked || --_db._state_write_depth > 0 )
+      return;
+   _db._state_writer.store( nullptr, std::memory_order_relaxed );
+   _db._state_mutex.unlock();
+   _db._state_writer_mutex.unlock();
+}
+
+/** adds a published index to the primary index of ObjectType and publishes the objects it already holds */
+template<typename ObjectType, typename PublishedIndex>
+static const PublishedIndex* publish_index( database& db )
+{
+   PublishedIndex* published = db.add_object_secondary_index<ObjectType, PublishedIndex>();
+   db.get_index<ObjectType>().inspect_all_objects( [published]( const object& obj ) {
+      published->object_inserted( obj );
+   });
+   published->flush();
+   return published;
+}
+
+void database::enable_concurrent_reads( bool enable )
+{
+   if( enable && _published_limit_orders == nullptr )
+   {
+      _published_limit_orders = publish_index<limit_order_object, published_limit_order_index>( *this );
+      _published_assets = publish_index<asset_object, published_asset_index>( *this );
+      _published_asset_symbols = publish_index<asset_object, published_asset_symbol_index>( *this );
+      _published_call_orders = publish_index<call_order_object, published_call_order_index>( *this );
+   }
+   _concurrent_reads = enable;
+}
+
+boost::shared_lock<boost::shared_mutex> database::lock_state_for_reading()const
+{
+   if( !_concurrent_reads )
+      return boost::shared_lock<boost::shared_mutex>( _state_mutex, boost::defer_lock );
+   return boost::shared_lock<boost::shared_mutex>( _state_mutex );
+}
+
 /**
  * Push block "may fail" in which case every partial change is unwound.  After
  * push block is successful the block is appended to the chain database on disk.
@@ -112,7 +265,17 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
-//   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   return push_block( std::make_shared<const signed_block>( new_block ), skip );
+}
+
+bool database::push_block(const signed_block_ptr& new_block, uint32_t skip)
+{
+//   idump((new_block->block_num())(new_block->id())(new_block->timestamp)(new_block->previous));
+   trace_scope tracing( "push_block", new_block->block_num() );
+   // a block that failed to be written in the background leaves the database unable to take more blocks
+   _block_id_to_block.check_writes();
+   wait_for_simulation();
+   state_write_guard guard( *this );
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -125,25 +288,27 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
    return result;
 }
 
-bool database::_push_block(const signed_block& new_block)
+bool database::_push_block(const signed_block_ptr& new_block_ptr)
 { try {
+   const signed_block& new_block = *new_block_ptr;
    uint32_t skip = get_node_properties().skip_flags;
    // TODO: If the block is greater than the head block and before the next maintenance interval
    // verify that the block signer is in the current set of active witnesses.
 
-   shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
+   shared_ptr<fork_item> new_head = _fork_db.push_block(new_block_ptr);
    //If the head block from the longest chain does not build off of the current head, we need to switch forks.
-   if( new_head->data.previous != head_block_id() )
+   if( new_head->data->previous != head_block_id() )
    {
       //If the newly pushed block is the same height as head, we get head back in new_head
       //Only switch forks if new_head is actually higher than head
-      if( new_head->data.block_num() > head_block_num() )
+      if( new_head->data->block_num() > head_block_num() )
       {
-         wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
-         auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+         wlog( "Switching to fork: ${id}", ("id",new_head->data->id()) );
+         trace_scope switching( "switch_fork", new_head->data->block_num() );
+         auto branches = _fork_db.fetch_branch_from(new_head->data->id(), head_block_id());
 
          // pop blocks until we hit the forked block
-         while( head_block_id() != branches.second.back()->data.previous )
+         while( head_block_id() != branches.second.back()->data->previous )
          {
             ilog( "popping block #${n} ${id}", ("n",head_block_num())("id",head_block_id()) );
             pop_block();
@@ -152,13 +317,14 @@ bool database::_push_block(const signed_block& new_block)
          // push all blocks on the new fork
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
          {
-               ilog( "pushing block from fork #${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->id) );
+               ilog( "pushing block from fork #${n} ${id}", ("n",(*ritr)->data->block_num())("id",(*ritr)->id) );
                optional<fc::exception> except;
                try {
                   undo_database::session session = _undo_db.start_undo_session();
-                  apply_block( (*ritr)->data, skip );
+                  apply_block( *(*ritr)->data, skip );
                   _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
                   session.commit();
+                  _block_cache.insert( (*ritr)->data );
                }
                catch ( const fc::exception& e ) { except = e; }
                if( except )
@@ -167,28 +333,29 @@ bool database::_push_block(const signed_block& new_block)
                   // remove the rest of branches.first from the fork_db, those blocks are invalid
                   while( ritr != branches.first.rend() )
                   {
-                     ilog( "removing block from fork_db #${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->id) );
+                     ilog( "removing block from fork_db #${n} ${id}", ("n",(*ritr)->data->block_num())("id",(*ritr)->id) );
                      _fork_db.remove( (*ritr)->id );
                      ++ritr;
                   }
                   _fork_db.set_head( branches.second.front() );
 
                   // pop all blocks from the bad fork
-                  while( head_block_id() != branches.second.back()->data.previous )
+                  while( head_block_id() != branches.second.back()->data->previous )
                   {
                      ilog( "popping block #${n} ${id}", ("n",head_block_num())("id",head_block_id()) );
                      pop_block();
                   }
 
-                  ilog( "Switching back to fork: ${id}", ("id",branches.second.front()->data.id()) );
+                  ilog( "Switching back to fork: ${id}", ("id",branches.second.front()->data->id()) );
                   // restore all blocks from the good fork
                   for( auto ritr2 = branches.second.rbegin(); ritr2 != branches.second.rend(); ++ritr2 )
                   {
-                     ilog( "pushing block #${n} ${id}", ("n",(*ritr2)->data.block_num())("id",(*ritr2)->id) );
+                     ilog( "pushing block #${n} ${id}", ("n",(*ritr2)->data->block_num())("id",(*ritr2)->id) );
                      auto session = _undo_db.start_undo_session();
-                     apply_block( (*ritr2)->data, skip );
+                     apply_block( *(*ritr2)->data, skip );
                      _block_id_to_block.store( (*ritr2)->id, (*ritr2)->data );
                      session.commit();
+                     _block_cache.insert( (*ritr2)->data );
                   }
                   throw *except;
                }
@@ -201,16 +368,122 @@ bool database::_push_block(const signed_block& new_block)
    try {
       auto session = _undo_db.start_undo_session();
       apply_block(new_block, skip);
-      _block_id_to_block.store(new_block.id(), new_block);
+      _block_id_to_block.store(new_block.id(), new_block_ptr);
       session.commit();
+      _block_cache.insert( new_block_ptr );
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
       _fork_db.remove( new_block.id() );
       throw;
    }
 
+   // blocks are written in the background, make sure nothing irreversible is only in memory
+   try
+   {
+      _block_id_to_block.wait_for_writes( get_dynamic_global_properties().last_irreversible_block_num );
+   }
+   catch( const fc::exception& e )
+   {
+      // the error is about an earlier block, this one was applied and the next push_block() is refused
+      elog( "Blocks before #${n} could not be written: ${e}", ("n",new_block.block_num())("e",e.to_detail_string()) );
+      return false;
+   }
+   prune_blocks( skip );
    return false;
-} FC_CAPTURE_AND_RETHROW( (new_block) ) }
+} FC_CAPTURE_AND_RETHROW( (new_block_ptr) ) }
+
+void database::prune_blocks( uint32_t skip )
+{
+   if( _prune_keep_blocks == 0 || !_block_id_to_block.is_segmented() )
+      return;
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   if( last_irreversible <= _prune_keep_blocks )
+      return;
+   const uint32_t first_kept = last_irreversible - _prune_keep_blocks;
+   try
+   {
+      if( _prune_checkpoint.valid() && _prune_checkpoint.ready() )
+         finish_prune_checkpoint();
+      // a replay after a crash starts from the last checkpoint, it needs all blocks after it
+      if( _last_prune_checkpoint > 0 )
+         _block_id_to_block.prune( std::min( first_kept, _last_prune_checkpoint + 1 ) );
+      if( !_prune_checkpoint.valid() && _last_prune_checkpoint + 1 < first_kept
+          && _block_id_to_block.prune( first_kept, true ) )
+         save_prune_checkpoint( skip );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to prune block database: ${e}", ("e",e.to_detail_string()) );
+   }
+}
+
+void database::save_prune_checkpoint( uint32_t skip )
+{
+   // the reversible blocks have no undo history on disk, the checkpoint must not contain them
+   const uint32_t checkpoint_block = get_dynamic_global_properties().last_irreversible_block_num;
+   vector<item_ptr> reversible;
+   for( item_ptr item = _fork_db.fetch_block( head_block_id() );
+        reversible.size() < head_block_num() - checkpoint_block; item = _fork_db.fetch_block( item->previous_id() ) )
+   {
+      FC_ASSERT( item, "The reversible blocks are not in the fork database" );
+      reversible.push_back( item );
+   }
+   const size_t popped_tx_count = _popped_tx.size();
+   for( size_t i = 0; i < reversible.size(); ++i )
+      pop_block();
+
+   std::shared_ptr< vector<packed_index> > indexes;
+   optional<fc::exception> except;
+   try {
+      indexes = std::make_shared< vector<packed_index> >( pack_indexes() );
+   } catch( const fc::exception& e ) {
+      except = e;
+   }
+
+   // applied again like the blocks of a fork that is switched back to, their transactions are not pending again
+   for( auto ritr = reversible.rbegin(); ritr != reversible.rend(); ++ritr )
+   {
+      auto session = _undo_db.start_undo_session();
+      apply_block( *(*ritr)->data, skip );
+      session.commit();
+      _block_cache.insert( (*ritr)->data );
+   }
+   if( !reversible.empty() )
+      _fork_db.set_head( reversible.front() );
+   _popped_tx.erase( _popped_tx.begin(), _popped_tx.begin() + ( _popped_tx.size() - popped_tx_count ) );
+   if( except )
+      throw *except;
+
+   ilog( "Saving object database at block ${n} before pruning blocks", ("n",checkpoint_block) );
+   forget_saved_files();
+   if( !_checkpoint_writer )
+      _checkpoint_writer = std::make_shared<fc::thread>( "checkpoint" );
+   const fc::path data_dir = get_data_dir();
+   _prune_checkpoint_block = checkpoint_block;
+   _prune_checkpoint = _checkpoint_writer->async( [indexes,data_dir] () {
+      write_index_files( *indexes, data_dir );
+   }, "prune checkpoint" );
+}
+
+bool database::finish_prune_checkpoint()
+{
+   if( !_prune_checkpoint.valid() )
+      return true;
+   fc::future<void> written = _prune_checkpoint;
+   _prune_checkpoint = fc::future<void>();
+   try
+   {
+      written.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to save the object database for pruning: ${e}", ("e",e.to_detail_string()) );
+      return false;
+   }
+   _last_prune_checkpoint = _prune_checkpoint_block;
+   ilog( "Saved object database at block ${n}, blocks before it can be pruned", ("n",_last_prune_checkpoint) );
+   return true;
+}
 
 /**
  * Attempts to push the transaction into the pending queue
@@ -223,6 +496,8 @@ bool database::_push_block(const signed_block& new_block)
  */
 processed_transaction database::push_transaction( const precomputable_transaction& trx, uint32_t skip )
 { try {
+   wait_for_simulation();
+   state_write_guard guard( *this );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -236,26 +511,154 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_tx_session.valid() )
+   {
       _pending_tx_session = _undo_db.start_undo_session();
+      if( _pending_tx.empty() )
+         _pending_block_size = 0;
+      else
+         _pending_block_size.reset();
+   }
 
    // Create a temporary undo session as a child of _pending_tx_session.
    // The temporary session will be discarded by the destructor if
    // _apply_transaction fails.  If we make it to merge(), we
    // apply the changes.
 
+   vector<transaction_id_type> evict;
+   const pending_tx_info info = check_pending_limits( trx, evict );
+
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
+   if( _pre_assemble_blocks )
+      processed_trx.merkle_digest();
    _pending_tx.push_back(processed_trx);
+   const uint32_t block_size = processed_trx.packed_size() + fc::raw::pack_size( processed_trx.operation_results );
+   _pending_tx_block_sizes.push_back( block_size );
+   if( _pending_block_size.valid() )
+      *_pending_block_size += block_size;
+
+   for( const transaction_id_type& id : evict )
+   {
+      auto itr = _pending_tx_info.find( id );
+      _pending_tx_bytes -= itr->second.size;
+      _evicted_pending_bytes += itr->second.size;
+      --_pending_tx_per_account[itr->second.fee_payer];
+      _evicted_pending_tx.insert( id );
+      _pending_tx_info.erase( itr );
+   }
+   _pending_tx_info[trx.id()] = info;
+   _pending_tx_bytes += info.size;
+   ++_pending_tx_per_account[info.fee_payer];
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
+   flush_batched_indexes();
 
    // notify anyone listening to pending transactions
+   apply_phase_scope notifying( apply_phase::notification, -1 );
    notify_on_pending_transaction( trx );
    return processed_trx;
 }
 
+namespace {
+   struct fee_visitor
+   {
+      typedef asset result_type;
+      template<typename Op>
+      asset operator()( const Op& op )const { return op.fee; }
+   };
+   struct fee_payer_visitor
+   {
+      typedef account_id_type result_type;
+      template<typename Op>
+      account_id_type operator()( const Op& op )const { return op.fee_payer(); }
+   };
+}
+
+database::pending_tx_info database::check_pending_limits( const precomputable_transaction& trx,
+                                                          vector<transaction_id_type>& evict )const
+{
+   pending_tx_info info;
+   info.size = trx.packed_size();
+   if( !trx.operations.empty() )
+      info.fee_payer = table_visit( trx.operations.front(), fee_payer_visitor() );
+   if( _pending_tx_max_bytes == 0 && _pending_tx_max_per_account == 0 && !_pending_tx_prioritized )
+      return info;
+
+   fc::uint128 core_fee;
+   for( const operation& op : trx.operations )
+   {
+      const asset fee = table_visit( op, fee_visitor() );
+      if( fee.asset_id == asset_id_type() )
+         core_fee += fee.amount.value;
+      else if( const asset_object* fee_asset = find( fee.asset_id ) )
+      {
+         if( !fee_asset->options.core_exchange_rate.is_null() )
+            core_fee += ( fee * fee_asset->options.core_exchange_rate ).amount.value;
+      }
+   }
+   info.fee_per_kbyte = ( core_fee * 1024 / std::max<uint64_t>( info.size, 1 ) ).to_uint64();
+
+   if( _pending_tx_max_per_account > 0 )
+   {
+      auto itr = _pending_tx_per_account.find( info.fee_payer );
+      FC_ASSERT( itr == _pending_tx_per_account.end() || itr->second < _pending_tx_max_per_account,
+                 "Account ${a} has too many pending transactions", ("a", info.fee_payer) );
+   }
+   if( _pending_tx_max_bytes > 0 && _pending_tx_bytes + info.size > _pending_tx_max_bytes )
+   {
+      // make room by dropping the cheapest pending transactions, when they pay less than this one
+      vector< std::pair<uint64_t,transaction_id_type> > cheaper;
+      for( const auto& item : _pending_tx_info )
+         if( item.second.fee_per_kbyte < info.fee_per_kbyte )
+            cheaper.emplace_back( item.second.fee_per_kbyte, item.first );
+      std::sort( cheaper.begin(), cheaper.end() );
+      uint64_t freed = 0;
+      for( const auto& item : cheaper )
+      {
+         if( _pending_tx_bytes - freed + info.size <= _pending_tx_max_bytes )
+            break;
+         evict.push_back( item.second );
+         freed += _pending_tx_info.find( item.second )->second.size;
+      }
+      // the evicted transactions stay in memory until the next block
+      FC_ASSERT( _pending_tx_bytes - freed + info.size <= _pending_tx_max_bytes
+                 && _evicted_pending_bytes + freed <= _pending_tx_max_bytes,
+                 "Too many pending transactions pay at least ${f} per kilobyte", ("f", info.fee_per_kbyte) );
+   }
+   return info;
+}
+
+vector< const processed_transaction* > database::pending_transactions_by_priority()const
+{
+   vector< std::pair<uint64_t,const processed_transaction*> > ranked;
+   ranked.reserve( _pending_tx.size() );
+   // a transaction does not rank above an earlier one of its fee payer, which it may depend on
+   flat_map< account_id_type, uint64_t > payer_rank;
+   for( const processed_transaction& tx : _pending_tx )
+   {
+      auto itr = _pending_tx_info.find( tx.id() );
+      if( itr == _pending_tx_info.end() ) // evicted
+         continue;
+      uint64_t rank = itr->second.fee_per_kbyte;
+      auto payer = payer_rank.find( itr->second.fee_payer );
+      if( payer == payer_rank.end() )
+         payer_rank[itr->second.fee_payer] = rank;
+      else
+         payer->second = rank = std::min( rank, payer->second );
+      ranked.emplace_back( rank, &tx );
+   }
+   std::stable_sort( ranked.begin(), ranked.end(),
+                     []( const std::pair<uint64_t,const processed_transaction*>& a,
+                         const std::pair<uint64_t,const processed_transaction*>& b ) { return a.first > b.first; } );
+   vector< const processed_transaction* > result;
+   result.reserve( ranked.size() );
+   for( const auto& item : ranked )
+      result.push_back( item.second );
+   return result;
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -312,6 +715,8 @@ processed_transaction database::push_proposal(const proposal_object& proposal)
       {
          _applied_ops.resize( old_applied_ops_size );
       }
+      if( _applied_ops_impacted.size() > old_applied_ops_size )
+         _applied_ops_impacted.resize( old_applied_ops_size );
       wlog( "${e}", ("e",e.to_detail_string() ) );
       throw;
    }
@@ -327,6 +732,8 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   wait_for_simulation();
+   state_write_guard guard( *this );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -342,37 +749,16 @@ signed_block database::_generate_block(
    )
 {
    try {
+   const fc::time_point start = fc::time_point::now();
    uint32_t skip = get_node_properties().skip_flags;
    uint32_t slot_num = get_slot_at_time( when );
    FC_ASSERT( slot_num > 0 );
    witness_id_type scheduled_witness = get_scheduled_witness( slot_num );
    FC_ASSERT( scheduled_witness == witness_id );
 
-   //
-   // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
-   //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
-   //
-
-   // pop pending state (reset to head block state)
-   _pending_tx_session.reset();
-
    // Check witness signing key
    if( !(skip & skip_witness_signature) )
-   {
-      // Note: if this check failed (which won't happen in normal situations),
-      // we would have temporarily broken the invariant that
-      // _pending_tx_session is the result of applying _pending_tx.
-      // In this case, when the node received a new block,
-      // the push_block() call will re-create the _pending_tx_session.
       FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
-   }
 
    static const size_t max_partial_block_header_size = fc::raw::pack_size( signed_block_header() )
                                                        - fc::raw::pack_size( witness_id_type() ) // witness_id
@@ -384,29 +770,67 @@ signed_block database::_generate_block(
 
    signed_block pending_block;
 
-   _pending_tx_session = _undo_db.start_undo_session();
-
-   uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   // The pending state is the result of applying the pending transactions in the order they arrived on top of the
+   // head block, they are evaluated at the head block time there as well as below. Unless some of them were evicted,
+   // rebuilding it below would produce the same results for the transactions up to the first one that does not fit,
+   // so that part of the pre-assembled block is taken as it is and the packing stops there.
+   if( _pre_assemble_blocks && _pending_tx_session.valid() && _pending_block_size.valid()
+       && !_pending_tx_prioritized && _evicted_pending_tx.empty() )
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      size_t count = _pending_tx.size();
+      if( total_block_size + *_pending_block_size > maximum_block_size )
+      {
+         count = 0;
+         while( total_block_size + _pending_tx_block_sizes[count] <= maximum_block_size )
+            total_block_size += _pending_tx_block_sizes[count++];
+         wlog( "Postponed ${n} transactions due to block size limit", ("n", _pending_tx.size() - count) );
+      }
+      pending_block.transactions.assign( _pending_tx.begin(), _pending_tx.begin() + count );
+   }
+   else
+   {
+      //
+      // The following code throws away existing pending_tx_session and
+      // rebuilds it by re-applying pending transactions.
+      //
+      // This rebuild is necessary because pending transactions' validity
+      // and semantics may have changed since they were received, because
+      // time-based semantics are evaluated based on the current block
+      // time.  These changes can only be reflected in the database when
+      // the value of the "when" variable is known, which means we need to
+      // re-apply pending transactions in this method.
+      //
+
+      // pop pending state (reset to head block state)
+      _pending_tx_session.reset();
+      _pending_tx_session = _undo_db.start_undo_session();
 
-      // postpone transaction if it would make block too big
-      if( new_total_size > maximum_block_size )
+      uint64_t postponed_tx_count = 0;
+      vector< const processed_transaction* > packing_order;
+      if( _pending_tx_prioritized )
+         packing_order = pending_transactions_by_priority();
+      else
       {
-         postponed_tx_count++;
-         continue;
+         packing_order.reserve( _pending_tx.size() );
+         for( const processed_transaction& tx : _pending_tx )
+            if( _evicted_pending_tx.find( tx.id() ) == _evicted_pending_tx.end() )
+               packing_order.push_back( &tx );
       }
+      // the smallest pending transaction, once less space is left no other one fits
+      uint32_t smallest_size = std::numeric_limits<uint32_t>::max();
+      for( const processed_transaction* tx_ptr : packing_order )
+         smallest_size = std::min( smallest_size, _pending_tx_block_sizes[ tx_ptr - _pending_tx.data() ] );
 
-      try
+      for( auto tx_itr = packing_order.begin(); tx_itr != packing_order.end(); ++tx_itr )
       {
-         auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         if( total_block_size + smallest_size > maximum_block_size )
+         {
+            postponed_tx_count += packing_order.end() - tx_itr;
+            break;
+         }
+         const processed_transaction& tx = **tx_itr;
+         size_t new_total_size = total_block_size + _pending_tx_block_sizes[ *tx_itr - _pending_tx.data() ];
 
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         new_total_size = total_block_size + fc::raw::pack_size( ptx );
          // postpone transaction if it would make block too big
          if( new_total_size > maximum_block_size )
          {
@@ -414,22 +838,39 @@ signed_block database::_generate_block(
             continue;
          }
 
-         temp_session.merge();
-
-         total_block_size = new_total_size;
-         pending_block.transactions.push_back( ptx );
+         try
+         {
+            auto temp_session = _undo_db.start_undo_session();
+            processed_transaction ptx = _apply_transaction( tx );
+
+            // We have to recompute pack_size(ptx) because it may be different
+            // than pack_size(tx) (i.e. if one or more results increased
+            // their size)
+            new_total_size = total_block_size + ptx.packed_size() + fc::raw::pack_size( ptx.operation_results );
+            // postpone transaction if it would make block too big
+            if( new_total_size > maximum_block_size )
+            {
+               postponed_tx_count++;
+               continue;
+            }
+
+            temp_session.merge();
+
+            total_block_size = new_total_size;
+            pending_block.transactions.push_back( ptx );
+         }
+         catch ( const fc::exception& e )
+         {
+            // Do nothing, transaction will not be re-applied
+            wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
+            wlog( "The transaction was ${t}", ("t", tx) );
+         }
       }
-      catch ( const fc::exception& e )
+      if( postponed_tx_count > 0 )
       {
-         // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
       }
    }
-   if( postponed_tx_count > 0 )
-   {
-      wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
-   }
 
    _pending_tx_session.reset();
 
@@ -441,13 +882,17 @@ signed_block database::_generate_block(
 
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
+   precompute_merkle_digests( pending_block );
    pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
    pending_block.witness = witness_id;
 
    if( !(skip & skip_witness_signature) )
       pending_block.sign( block_signing_private_key );
 
+   const fc::time_point assembled = fc::time_point::now();
+   _last_generation_timing.assemble = assembled - start;
    push_block( pending_block, skip | skip_transaction_signatures ); // skip authority check when pushing self-generated blocks
+   _last_generation_timing.apply = fc::time_point::now() - assembled;
 
    return pending_block;
 } FC_CAPTURE_AND_RETHROW( (witness_id) ) }
@@ -458,6 +903,8 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   wait_for_simulation();
+   state_write_guard guard( *this );
    _pending_tx_session.reset();
    auto fork_db_head = _fork_db.head();
    FC_ASSERT( fork_db_head, "Trying to pop() from empty fork database!?" );
@@ -468,20 +915,37 @@ void database::pop_block()
       fork_db_head = _fork_db.fetch_block( head_block_id() );
       FC_ASSERT( fork_db_head, "Trying to pop() block that's not in fork database!?" );
    }
+   _block_cache.remove( head_block_num() );
+   if( _state_journal )
+      _state_journal->pop_block( head_block_num() );
    pop_undo();
-   _popped_tx.insert( _popped_tx.begin(), fork_db_head->data.transactions.begin(), fork_db_head->data.transactions.end() );
+   flush_batched_indexes();
+   _popped_tx.insert( _popped_tx.begin(), fork_db_head->data->transactions.begin(), fork_db_head->data->transactions.end() );
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_pending()
 { try {
+   state_write_guard guard( *this );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _pending_tx_block_sizes.clear();
+   _pending_tx_info.clear();
+   _pending_tx_bytes = 0;
+   _pending_tx_per_account.clear();
+   _evicted_pending_tx.clear();
+   _evicted_pending_bytes = 0;
    _pending_tx_session.reset();
+   flush_batched_indexes();
 } FC_CAPTURE_AND_RETHROW() }
 
 uint32_t database::push_applied_operation( const operation& op )
 {
-   _applied_ops.emplace_back(op);
+   return push_applied_operation( operation( op ) );
+}
+
+uint32_t database::push_applied_operation( operation&& op )
+{
+   _applied_ops.emplace_back( std::move(op) );
    operation_history_object& oh = *(_applied_ops.back());
    oh.block_num    = _current_block_num;
    oh.trx_in_block = _current_trx_in_block;
@@ -493,7 +957,11 @@ void database::set_applied_operation_result( uint32_t op_id, const operation_res
 {
    assert( op_id < _applied_ops.size() );
    if( _applied_ops[op_id] )
+   {
       _applied_ops[op_id]->result = result;
+      if( op_id < _applied_ops_impacted.size() )
+         _applied_ops_impacted[op_id].reset();
+   }
    else
    {
       elog( "Could not set operation result (head_block_num=${b})", ("b", head_block_num()) );
@@ -505,6 +973,184 @@ const vector<optional< operation_history_object > >& database::get_applied_opera
    return _applied_ops;
 }
 
+const flat_set<account_id_type>& database::get_applied_operation_impacted_accounts( uint32_t op_id )const
+{
+   FC_ASSERT( op_id < _applied_ops.size() && _applied_ops[op_id].valid() );
+   if( _applied_ops_impacted.size() < _applied_ops.size() )
+      _applied_ops_impacted.resize( _applied_ops.size() );
+   optional< flat_set<account_id_type> >& cached = _applied_ops_impacted[op_id];
+   if( cached.valid() )
+      return *cached;
+
+   const operation_history_object& oho = *_applied_ops[op_id];
+   cached = flat_set<account_id_type>();
+   flat_set<account_id_type>& impacted = *cached;
+   vector<authority> other;
+   operation_get_required_authorities( oho.op, impacted, impacted, other ); // fee_payer is added here
+
+   if( oho.op.which() == operation::tag< account_create_operation >::value )
+      impacted.insert( oho.result.get<object_id_type>() );
+   else
+      operation_get_impacted_accounts( oho.op, impacted );
+
+   for( const auto& a : other )
+      for( const auto& item : a.account_auths )
+         impacted.insert( item.first );
+   return impacted;
+}
+
+void database::add_history_consumer( const std::shared_ptr<history_consumer>& consumer )
+{
+   FC_ASSERT( consumer );
+   _history_consumers.push_back( consumer );
+}
+
+std::map< std::string, size_t > database::get_history_queue_depths()const
+{
+   std::map< std::string, size_t > result;
+   for( const auto& consumer : _history_consumers )
+      result[consumer->name()] = 0;
+   for( const auto& stream : _history_replay_streams )
+      result[stream.consumer->name()] = std::count_if( stream.queued.begin(), stream.queued.end(),
+                                                       []( const fc::future<void>& f ) { return !f.ready(); } );
+   return result;
+}
+
+/** plugin exceptions abort the block like they do from the applied_block signal, other exceptions are logged */
+static void index_history( history_consumer& consumer, const applied_block_operations& block )
+{
+   try
+   {
+      consumer.index( block );
+   }
+   catch( const graphene::chain::plugin_exception& e )
+   {
+      elog( "Caught plugin exception in ${c}: ${e}", ("c",consumer.name())("e",e.to_detail_string()) );
+      throw;
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Caught unexpected exception in ${c}: ${e}", ("c",consumer.name())("e",e.to_detail_string()) );
+   }
+   catch( ... )
+   {
+      wlog( "Caught unexpected exception in ${c}", ("c",consumer.name()) );
+   }
+}
+
+void database::dispatch_applied_operations( const signed_block& block )
+{
+   if( _history_consumers.empty() )
+      return;
+
+   const bool replaying = !_history_replay_streams.empty();
+   // the consumers only see _dispatched_ops while index() runs, the queued blocks of a replay need their own
+   std::shared_ptr<applied_block_operations> queued_ops;
+   if( replaying )
+      queued_ops = std::make_shared<applied_block_operations>();
+   applied_block_operations* ops = replaying ? queued_ops.get() : &_dispatched_ops;
+   ops->block_num = block.block_num();
+   ops->timestamp = block.timestamp;
+   ops->last_irreversible_block_num = get_dynamic_global_properties().last_irreversible_block_num;
+   ops->impacted_accounts.resize( _applied_ops.size() );
+   for( uint32_t i = 0; i < _applied_ops.size(); ++i )
+   {
+      if( !_applied_ops[i].valid() )
+      {
+         ops->impacted_accounts[i].clear();
+         continue;
+      }
+      get_applied_operation_impacted_accounts( i );
+      ops->impacted_accounts[i] = std::move( *_applied_ops_impacted[i] );
+   }
+   _applied_ops_impacted.clear();
+
+   if( !replaying )
+   {
+      ops->operations.swap( _applied_ops );
+      try
+      {
+         for( const auto& consumer : _history_consumers )
+            index_history( *consumer, *ops );
+      }
+      catch( ... )
+      {
+         ops->operations.swap( _applied_ops );
+         _applied_ops.clear();
+         throw;
+      }
+      ops->operations.swap( _applied_ops );
+      _applied_ops.clear();
+      return;
+   }
+
+   const size_t applied_ops_capacity = _applied_ops.capacity();
+   ops->operations = std::move( _applied_ops );
+   _applied_ops.clear();
+   _applied_ops.reserve( applied_ops_capacity );
+
+   const std::shared_ptr<const applied_block_operations> shared_ops = queued_ops;
+   for( auto& stream : _history_replay_streams )
+   {
+      // blocks the consumer is done with leave the queue, a full queue makes the chain wait
+      while( !stream.queued.empty()
+             && ( stream.queued.front().ready() || stream.queued.size() >= stream.consumer->max_queued_blocks() ) )
+      {
+         stream.queued.front().wait();
+         stream.queued.pop_front();
+      }
+      const std::shared_ptr<history_consumer> consumer = stream.consumer;
+      stream.queued.push_back( stream.thread->async( [consumer,shared_ops]() {
+         index_history( *consumer, *shared_ops );
+      }, "index history" ) );
+   }
+}
+
+void database::start_history_replay()
+{
+   if( _history_consumers.empty() || !_history_replay_streams.empty() )
+      return;
+   for( const auto& consumer : _history_consumers )
+   {
+      consumer->begin_replay();
+      history_replay_stream stream;
+      stream.consumer = consumer;
+      stream.thread = std::make_shared<fc::thread>( consumer->name() + " history" );
+      _history_replay_streams.push_back( std::move( stream ) );
+   }
+}
+
+void database::finish_history_replay()
+{
+   if( _history_replay_streams.empty() )
+      return;
+   fc::exception_ptr failure;
+   for( auto& stream : _history_replay_streams )
+   {
+      for( auto& queued : stream.queued )
+      {
+         try
+         {
+            queued.wait();
+         }
+         catch( const fc::exception& e )
+         {
+            if( !failure )
+               failure = e.dynamic_copy_exception();
+         }
+      }
+      stream.queued.clear();
+      stream.thread->quit();
+   }
+   vector< history_replay_stream > streams;
+   std::swap( streams, _history_replay_streams );
+   // consumers that failed are not brought up to date, the replay is aborted
+   if( failure )
+      failure->dynamic_rethrow_exception();
+   for( auto& stream : streams )
+      stream.consumer->end_replay();
+}
+
 //////////////////// private methods ////////////////////
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
@@ -524,14 +1170,22 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
    {
       _apply_block( next_block );
    } );
+   // without undo states there is nothing to record, the journal restarts at the next block that has one
+   if( _state_journal && _undo_db.enabled() )
+   {
+      _state_journal->record_block( block_num, _undo_db.head() );
+      _state_journal->flush( get_dynamic_global_properties().last_irreversible_block_num );
+   }
    return;
 }
 
 void database::_apply_block( const signed_block& next_block )
 { try {
    uint32_t next_block_num = next_block.block_num();
+   trace_scope tracing( "apply_block", next_block_num );
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
+   _applied_ops_impacted.clear();
 
    if( !(skip & skip_block_size_check) )
    {
@@ -555,16 +1209,21 @@ void database::_apply_block( const signed_block& next_block )
 
    _issue_453_affected_assets.clear();
 
-   for( const auto& trx : next_block.transactions )
+   if( _analyze_trx_conflicts )
+      apply_transactions_analyzing_conflicts( next_block, skip );
+   else
    {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      apply_transaction( trx, skip );
-      ++_current_trx_in_block;
+      for( const auto& trx : next_block.transactions )
+      {
+         /* We do not need to push the undo state for each transaction
+          * because they either all apply and are valid or the
+          * entire block fails to apply.  We only need an "undo" state
+          * for transactions when validating broadcast transactions or
+          * when building a block.
+          */
+         apply_transaction( trx, skip );
+         ++_current_trx_in_block;
+      }
    }
 
    const uint32_t missed = update_witness_missed_blocks( next_block );
@@ -574,7 +1233,12 @@ void database::_apply_block( const signed_block& next_block )
 
    // Are we at the maintenance interval?
    if( maint_needed )
+   {
+      trace_scope maintaining( "chain_maintenance", next_block_num );
       perform_chain_maintenance(next_block, global_props);
+   }
+   else if( can_reconcile_vote_tally( next_block, global_props ) )
+      prepare_vote_tally( next_block, global_props );
 
    create_block_summary(next_block);
    clear_expired_transactions();
@@ -594,16 +1258,79 @@ void database::_apply_block( const signed_block& next_block )
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
 
+   flush_batched_indexes();
+
+   // a simulated block is only reported to the simulation
+   if( _simulation != nullptr )
+   {
+      collect_simulated_operations();
+      return;
+   }
+
    // notify observers that the block has been applied
-   notify_applied_block( next_block ); //emit
+   {
+      apply_phase_scope running_plugins( apply_phase::plugins, -1 );
+      trace_scope tracing_plugins( "notify_applied_block", next_block_num );
+      notify_applied_block( next_block ); //emit
+      dispatch_applied_operations( next_block );
+   }
    _applied_ops.clear();
+   _applied_ops_impacted.clear();
 
+   log_memory_usage();
+
+   apply_phase_scope notifying( apply_phase::notification, -1 );
+   trace_scope tracing_notification( "notify_changed_objects", next_block_num );
    notify_changed_objects();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
 
 
-processed_transaction database::apply_transaction(const signed_transaction& trx, uint32_t skip)
+void database::apply_transactions_analyzing_conflicts( const signed_block& next_block, uint32_t skip )
+{
+   // round in which a parallel executor would commit the last write to an object, the first round is 1
+   std::unordered_map< object_id_type, uint32_t > written_in_round;
+   uint32_t block_rounds = 0;
+   object_access_set access;
+   for( const auto& trx : next_block.transactions )
+   {
+      access.clear();
+      record_object_access( &access );
+      try
+      {
+         apply_transaction( trx, skip );
+      }
+      catch( ... )
+      {
+         record_object_access( nullptr );
+         throw;
+      }
+      record_object_access( nullptr );
+      ++_current_trx_in_block;
+
+      uint32_t round = 1;
+      auto depend_on = [&]( object_id_type id ) {
+         auto itr = written_in_round.find( id );
+         if( itr != written_in_round.end() )
+            round = std::max( round, itr->second + 1 );
+      };
+      for( object_id_type id : access.reads )
+         depend_on( id );
+      for( object_id_type id : access.writes )
+         depend_on( id );
+      for( object_id_type id : access.writes )
+         written_in_round[id] = round;
+
+      if( round > 1 )
+         ++_trx_conflict_stats.conflicting;
+      block_rounds = std::max( block_rounds, round );
+   }
+   ++_trx_conflict_stats.blocks;
+   _trx_conflict_stats.transactions += next_block.transactions.size();
+   _trx_conflict_stats.rounds += block_rounds;
+}
+
+processed_transaction database::apply_transaction(const precomputable_transaction& trx, uint32_t skip)
 {
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
@@ -613,22 +1340,59 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction(const precomputable_transaction& trx)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
+   // the checks of the transaction are attributed to the type of its first operation
+   const int64_t first_op_tag = trx.operations.empty() ? -1 : trx.operations.front().which();
+   trace_scope tracing( "apply_transaction", first_op_tag );
+   check_transaction( trx, skip );
+
+   transaction_evaluation_state eval_state(this);
+   eval_state._trx = &trx;
+
+   //Insert transaction into unique transactions database.
+   if( !(skip & skip_transaction_dupe_check) )
+   {
+      const uint32_t block_num = head_block_num() + 1;
+      create<transaction_object>([&trx,block_num](transaction_object& transaction) {
+         transaction.trx_id = trx.id();
+         transaction.expiration = trx.expiration;
+         transaction.block_num = block_num;
+      });
+   }
+
+   eval_state.operation_results.reserve(trx.operations.size());
+
+   //Finally process the operations
+   processed_transaction ptrx(trx);
+   _current_op_in_trx = 0;
+   for( const auto& op : ptrx.operations )
+   {
+      eval_state.operation_results.emplace_back(apply_operation(eval_state, op));
+      ++_current_op_in_trx;
+   }
+   ptrx.operation_results = std::move(eval_state.operation_results);
+
+   return ptrx;
+} FC_CAPTURE_AND_RETHROW( (trx) ) }
+
+void database::check_transaction( const precomputable_transaction& trx, uint32_t skip )const
+{
+   const int64_t first_op_tag = trx.operations.empty() ? -1 : trx.operations.front().which();
+   apply_phase_scope validating( apply_phase::validate, first_op_tag );
    trx.validate();
 
-   auto& trx_idx = get_mutable_index_type<transaction_index>();
+   const auto& trx_idx = get_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
    if( !(skip & skip_transaction_dupe_check) )
       FC_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx.id()) == trx_idx.indices().get<by_trx_id>().end() );
-   transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
-   eval_state._trx = &trx;
 
    if( !(skip & skip_transaction_signatures) )
    {
+      apply_phase_scope checking_authority( apply_phase::authority, first_op_tag );
       auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
       auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
       trx.verify_authority( chain_id, get_active, get_owner, get_global_properties().parameters.max_authority_depth );
@@ -640,7 +1404,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    {
       if( !(skip & skip_tapos_check) )
       {
-         const auto& tapos_block_summary = block_summary_id_type( trx.ref_block_num )(*this);
+         const auto& tapos_block_summary = _block_summaries->at( trx.ref_block_num );
 
          //Verify TaPoS block summary has correct ID prefix, and that this block's time is not past the expiration
          FC_ASSERT( trx.ref_block_prefix == tapos_block_summary.block_id._hash[1] );
@@ -652,29 +1416,40 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
                  ("trx.expiration",trx.expiration)("now",now)("max_til_exp",chain_parameters.maximum_time_until_expiration));
       FC_ASSERT( now <= trx.expiration, "", ("now",now)("trx.exp",trx.expiration) );
    }
+}
 
-   //Insert transaction into unique transactions database.
-   if( !(skip & skip_transaction_dupe_check) )
-   {
-      create<transaction_object>([&trx](transaction_object& transaction) {
-         transaction.trx_id = trx.id();
-         transaction.trx = trx;
-      });
-   }
+struct operation_fee_visitor
+{
+   typedef asset result_type;
+   template<typename OpType>
+   asset operator()( const OpType& op )const { return op.fee; }
+};
 
-   eval_state.operation_results.reserve(trx.operations.size());
+vector<dry_run_operation> database::dry_run_transaction( const signed_transaction& trx )const
+{ try {
+   const precomputable_transaction ptrx( trx );
+   check_transaction( ptrx, skip_nothing );
 
-   //Finally process the operations
-   processed_transaction ptrx(trx);
-   _current_op_in_trx = 0;
-   for( const auto& op : ptrx.operations )
+   // the evaluate step of the evaluators only reads, the database is mutable for the apply step
+   transaction_evaluation_state eval_state( const_cast<database*>( this ) );
+   eval_state._trx = &ptrx;
+   eval_state.dry_run = true;
+
+   vector<dry_run_operation> result;
+   result.reserve( ptrx.operations.size() );
+   for( const operation& op : ptrx.operations )
    {
-      eval_state.operation_results.emplace_back(apply_operation(eval_state, op));
-      ++_current_op_in_trx;
+      const int i_which = op.which();
+      FC_ASSERT( i_which >= 0 && uint64_t( i_which ) < _operation_evaluators.size() && _operation_evaluators[i_which],
+                 "No registered evaluator for operation ${op}", ("op",op) );
+      dry_run_operation evaluated;
+      evaluated.fee = op.visit( operation_fee_visitor() );
+      evaluated.required_fee = current_fee_schedule().calculate_fee( op,
+                                  evaluated.fee.asset_id( *this ).options.core_exchange_rate );
+      evaluated.result = _operation_evaluators[i_which]->evaluate( eval_state, op, false );
+      result.push_back( std::move( evaluated ) );
    }
-   ptrx.operation_results = std::move(eval_state.operation_results);
-
-   return ptrx;
+   return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
 operation_result database::apply_operation(transaction_evaluation_state& eval_state, const operation& op)
@@ -685,12 +1460,26 @@ operation_result database::apply_operation(transaction_evaluation_state& eval_st
    FC_ASSERT( u_which < _operation_evaluators.size(), "No registered evaluator for operation ${op}", ("op",op) );
    unique_ptr<op_evaluator>& eval = _operation_evaluators[ u_which ];
    FC_ASSERT( eval, "No registered evaluator for operation ${op}", ("op",op) );
+   apply_phase_scope applying( apply_phase::apply, i_which );
    auto op_id = push_applied_operation( op );
    auto result = eval->evaluate( eval_state, op, true );
    set_applied_operation_result( op_id, result );
    return result;
 } FC_CAPTURE_AND_RETHROW( (op) ) }
 
+void database::enable_operation_timing( bool enable )
+{
+   _time_operations = enable;
+   reset_operation_timing();
+}
+
+void database::reset_operation_timing()
+{
+   _operation_timing.clear();
+   if( _time_operations )
+      _operation_timing.resize( operation::count() );
+}
+
 const witness_object& database::validate_block_header( uint32_t skip, const signed_block& next_block )const
 {
    FC_ASSERT( head_block_id() == next_block.previous, "", ("head_block_id",head_block_id())("next.prev",next_block.previous) );
@@ -716,8 +1505,7 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
 
 void database::create_block_summary(const signed_block& next_block)
 {
-   block_summary_id_type sid(next_block.block_num() & 0xffff );
-   modify( sid(*this), [&](block_summary_object& p) {
+   modify( _block_summaries->at( next_block.block_num() & 0xffff ), [&](block_summary_object& p) {
          p.block_id = next_block.id();
    });
 }
@@ -737,61 +1525,214 @@ bool database::before_last_checkpoint()const
 static const uint32_t skip_expensive = database::skip_transaction_signatures | database::skip_witness_signature
                                        | database::skip_merkle_check | database::skip_transaction_dupe_check;
 
+/** @return true if trx has operations whose validation verifies blinded commitment sums */
+static bool has_confidential_operations( const transaction& trx )
+{
+   for( const auto& op : trx.operations )
+      if( op.which() == operation::tag<transfer_to_blind_operation>::value
+          || op.which() == operation::tag<transfer_from_blind_operation>::value
+          || op.which() == operation::tag<blind_transfer_operation>::value )
+         return true;
+   return false;
+}
+
+/** the leaves of the merkle tree of a block, transactions outside of blocks have none */
+static void precompute_merkle_digest( const processed_transaction& trx ) { trx.merkle_digest(); }
+static void precompute_merkle_digest( const precomputable_transaction& trx ) {}
+
 template<typename Trx>
 void database::_precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const
 {
+   trace_scope tracing( "precompute_transactions", count );
    for( size_t i = 0; i < count; ++i, ++trx )
    {
-      trx->validate(); // TODO - parallelize wrt confidential operations
+      trx->validate();
       if( !(skip&skip_transaction_dupe_check) )
          trx->id();
       if( !(skip&skip_transaction_signatures) )
          trx->get_signature_keys( get_chain_id() );
+      if( !(skip&skip_merkle_check) )
+         precompute_merkle_digest( *trx );
    }
 }
 
+void database::precompute_merkle_digests( const signed_block& block )const
+{
+   if( !_verification_pool || block.transactions.size() < 2 )
+      return;
+   for( auto& worker : _verification_pool->post_batches( block.transactions.size(), 16,
+                                                          [&block] ( size_t begin, size_t end ) {
+           for( size_t i = begin; i < end; ++i )
+              block.transactions[i].merkle_digest();
+        }) )
+      worker.wait();
+}
+
+void database::_precompute_block( const signed_block& block, const uint32_t skip )const
+{
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( !(skip&skip_witness_signature) )
+      block.signee();
+   if( !(skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+}
+
 fc::future<void> database::precompute_parallel( const signed_block& block, const uint32_t skip )const
 { try {
+   trace_scope tracing( "precompute_parallel", block.block_num() );
    std::vector<fc::future<void>> workers;
    if( !block.transactions.empty() )
    {
       if( (skip & skip_expensive) == skip_expensive )
          _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+      else if( _verification_pool )
+      {
+         // a confidential transaction can take longer to validate than hundreds of others, each one gets a task
+         // of its own instead of holding up the batch it falls into
+         vector<size_t> confidential;
+         for( size_t i = 0; i < block.transactions.size(); ++i )
+            if( has_confidential_operations( block.transactions[i] ) )
+               confidential.push_back( i );
+         if( confidential.empty() )
+            workers = _verification_pool->post_batches( block.transactions.size(), 1,
+                                                        [this,&block,skip] ( size_t begin, size_t end ) {
+               _precompute_parallel( &block.transactions[begin], end - begin, skip );
+            });
+         else
+         {
+            workers.reserve( confidential.size() + _verification_pool->size() + 1 );
+            for( size_t i : confidential )
+               workers.push_back( _verification_pool->post( [this,&block,i,skip] () {
+                  _precompute_parallel( &block.transactions[i], 1, skip );
+               }) );
+            for( auto& worker : _verification_pool->post_batches( block.transactions.size(), 1,
+                                                                   [this,&block,skip] ( size_t begin, size_t end ) {
+                    for( size_t i = begin; i < end; ++i )
+                       if( !has_confidential_operations( block.transactions[i] ) )
+                          _precompute_parallel( &block.transactions[i], 1, skip );
+                 }) )
+               workers.push_back( std::move( worker ) );
+         }
+      }
       else
       {
-         uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
+         auto& scheduler = task_scheduler::shared();
+         uint32_t chunks = scheduler.size();
          uint32_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
          workers.reserve( chunks + 1 );
          for( size_t base = 0; base < block.transactions.size(); base += chunk_size )
-            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,skip] () {
+            workers.push_back( scheduler.async( [this,&block,base,chunk_size,skip] () {
                _precompute_parallel( &block.transactions[base],
                                      base + chunk_size < block.transactions.size() ? chunk_size : block.transactions.size() - base,
                                      skip );
-            }) );
+            }, task_priority::high ) );
       }
    }
 
    if( !(skip&skip_witness_signature) )
-      workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
-   if( !(skip&skip_merkle_check) )
-      block.calculate_merkle_root();
+   {
+      if( _verification_pool )
+         workers.push_back( _verification_pool->post( [&block] () { block.signee(); } ) );
+      else
+         workers.push_back( task_scheduler::shared().async( [&block] () { block.signee(); }, task_priority::high ) );
+   }
    block.id();
 
    if( workers.empty() )
+   {
+      if( !(skip&skip_merkle_check) )
+         block.calculate_merkle_root();
       return fc::future< void >( fc::promise< void >::ptr( new fc::promise< void >( true ) ) );
+   }
 
    auto first = workers.begin();
    auto worker = first;
    while( ++worker != workers.end() )
       worker->wait();
+   if( !(skip&skip_merkle_check) )
+   {
+      // the workers computed the leaves, only the levels above them are left
+      first->wait();
+      block.calculate_merkle_root();
+   }
    return *first;
 } FC_LOG_AND_RETHROW() }
 
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
-   return fc::do_parallel([this,&trx] () {
+   if( _verification_pool )
+      return _verification_pool->post( [this,&trx] () {
+         _precompute_parallel( &trx, 1, skip_nothing );
+      });
+   return task_scheduler::shared().async( [this,&trx] () {
       _precompute_parallel( &trx, 1, skip_nothing );
-   });
+   }, task_priority::high );
+}
+
+
+template<typename Trx>
+size_t database::_prefetch_objects( const Trx* trx, const size_t count )const
+{
+   // reading the objects is all that is needed, the sum only keeps the compiler from dropping the reads
+   const size_t max_orders_per_side = 16;
+   const auto& balances = get_index_type< primary_index< account_balance_index > >()
+                              .get_secondary_index< balances_by_account_index >();
+   const auto& orders = get_index_type< limit_order_index >().indices().get< by_price >();
+   uint64_t sum = 0;
+   size_t touched = 0;
+   flat_set<account_id_type> accounts;
+   for( size_t i = 0; i < count; ++i, ++trx )
+   {
+      transaction_get_impacted_accounts( *trx, accounts );
+      for( const operation& op : trx->operations )
+      {
+         if( op.which() != operation::tag< limit_order_create_operation >::value )
+            continue;
+         // the side the new order is matched against
+         const limit_order_create_operation& create = op.get< limit_order_create_operation >();
+         auto itr = orders.lower_bound( price::max( create.min_to_receive.asset_id, create.amount_to_sell.asset_id ) );
+         for( size_t n = 0; n < max_orders_per_side && itr != orders.end()
+                            && itr->sell_price.base.asset_id == create.min_to_receive.asset_id
+                            && itr->sell_price.quote.asset_id == create.amount_to_sell.asset_id; ++n, ++itr )
+         {
+            sum += itr->for_sale.value + itr->seller.instance.value;
+            ++touched;
+         }
+      }
+   }
+   for( account_id_type id : accounts )
+   {
+      const account_object* acc = find( id );
+      if( acc == nullptr )
+         continue;
+      const account_statistics_object* stats = find( acc->statistics );
+      sum += acc->name.size() + ( stats ? stats->total_ops : 0 );
+      touched += 2;
+      for( const auto& balance : balances.get_account_balances( id ) )
+      {
+         sum += balance.second->balance.value;
+         ++touched;
+      }
+   }
+   static volatile uint64_t sink;
+   sink = sum;
+   return touched;
+}
+
+size_t database::prefetch_objects( const signed_block& block )const
+{
+   if( block.transactions.empty() )
+      return 0;
+   return _prefetch_objects( &block.transactions[0], block.transactions.size() );
+}
+
+size_t database::prefetch_pending_objects()const
+{
+   if( _pending_tx.empty() )
+      return 0;
+   return _prefetch_objects( &_pending_tx[0], _pending_tx.size() );
 }
 
 } }
@@ -23,6 +23,7 @@
  */
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/db_with.hpp>
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
@@ -30,6 +31,7 @@
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/fba_object.hpp>
+#include <graphene/chain/vote_tally_cache.hpp>
 
 namespace graphene { namespace chain {
 
@@ -207,4 +209,141 @@ void database::debug_update( const fc::variant_object& update )
    push_block( *head_block );
 }
 
+void database::collect_simulated_operations()
+{
+   for( auto& op : _applied_ops )
+      if( op.valid() )
+         _simulation->operations.push_back( std::move( *op ) );
+   _applied_ops.clear();
+   _applied_ops_impacted.clear();
+}
+
+void database::wait_for_simulation()const
+{
+   while( _simulation != nullptr )
+   {
+      const fc::promise<void>::ptr finished = _simulation_finished;
+      finished->wait();
+   }
+}
+
+simulation_result database::simulate( const simulation_request& request )
+{ try {
+   FC_ASSERT( _undo_db.enabled(), "Simulations need the undo history" );
+   wait_for_simulation();
+
+   // readers on other threads must not see the fork, it is released after the fork was undone and flushed
+   state_write_guard guard( *this );
+   simulation_result result;
+
+   // puts back what the simulation changes besides the objects, after the fork was undone
+   struct simulation_restorer
+   {
+      simulation_restorer( database& db, simulation_result& result, bool simulates_blocks )
+         : _db( db ),
+           _applied_ops( std::move( db._applied_ops ) ),
+           _applied_ops_impacted( std::move( db._applied_ops_impacted ) ),
+           _current_block_num( db._current_block_num ),
+           _current_trx_in_block( db._current_trx_in_block ),
+           _current_op_in_trx( db._current_op_in_trx ),
+           _current_virtual_op( db._current_virtual_op ),
+           _undo_max_size( db._undo_db.max_size() ),
+           _simulates_blocks( simulates_blocks )
+      {
+         _db._applied_ops.clear();
+         _db._applied_ops_impacted.clear();
+         _db._simulation = &result;
+         _db._simulation_finished = fc::promise<void>::ptr( new fc::promise<void>( "simulation finished" ) );
+         // the fork is one more undo state, which must not push out the oldest state of the live chain
+         _db._undo_db.set_max_size( _undo_max_size + 1 );
+      }
+
+      ~simulation_restorer()
+      {
+         // the published indexes still hold the state of the fork
+         _db.flush_batched_indexes();
+         _db._simulation = nullptr;
+         _db._applied_ops = std::move( _applied_ops );
+         _db._applied_ops_impacted = std::move( _applied_ops_impacted );
+         _db._current_block_num = _current_block_num;
+         _db._current_trx_in_block = _current_trx_in_block;
+         _db._current_op_in_trx = _current_op_in_trx;
+         _db._current_virtual_op = _current_virtual_op;
+         _db._undo_db.set_max_size( _undo_max_size );
+         // the tally was reconciled with blocks that are gone now
+         if( _simulates_blocks && _db._vote_tally_cache )
+            _db._vote_tally_cache->invalidate();
+         const fc::promise<void>::ptr finished = std::move( _db._simulation_finished );
+         finished->set_value();
+      }
+
+      database&                                       _db;
+      vector< optional< operation_history_object > >  _applied_ops;
+      vector< optional< flat_set<account_id_type> > > _applied_ops_impacted;
+      uint32_t                                        _current_block_num;
+      uint16_t                                        _current_trx_in_block;
+      uint16_t                                        _current_op_in_trx;
+      uint16_t                                        _current_virtual_op;
+      size_t                                          _undo_max_size;
+      bool                                            _simulates_blocks;
+   } restorer( *this, result, !request.blocks.empty() );
+
+   auto fork = _undo_db.start_undo_session();
+
+   for( const fc::variant_object& update : request.object_updates )
+      debug_apply_update( *this, update );
+
+   const uint32_t skip = get_node_properties().skip_flags | request.skip;
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      _current_block_num = head_block_num() + 1;
+      _current_trx_in_block = 0;
+      for( const signed_transaction& trx : request.transactions )
+      {
+         _current_virtual_op = 0;
+         result.transactions.push_back( _apply_transaction( trx ) );
+         collect_simulated_operations();
+         ++_current_trx_in_block;
+      }
+   } );
+
+   // nobody signs the simulated blocks, and they are produced by whoever is scheduled
+   const uint32_t block_skip = skip | skip_witness_signature | skip_witness_schedule_check;
+   for( const vector<signed_transaction>& transactions : request.blocks )
+   {
+      signed_block block;
+      block.previous = head_block_id();
+      block.timestamp = get_slot_time( 1 );
+      block.witness = get_scheduled_witness( 1 );
+      block.transactions.assign( transactions.begin(), transactions.end() );
+      block.transaction_merkle_root = block.calculate_merkle_root();
+      detail::with_skip_flags( *this, block_skip, [&]()
+      {
+         _apply_block( block );
+      } );
+      result.blocks.push_back( std::move( block ) );
+   }
+
+   const graphene::db::undo_state& changes = _undo_db.head();
+   auto current_value = [this]( object_id_type id ) -> fc::variant {
+      const object* obj = find_object( id );
+      return obj != nullptr ? obj->to_variant() : fc::variant();
+   };
+   for( const auto& item : changes.old_values )
+      result.changes.push_back( { item.first, item.second->to_variant(), current_value( item.first ) } );
+   for( const auto& item : changes.packed_old_values )
+      result.changes.push_back( { item.first,
+                                  get_index( item.first.space(), item.first.type() )
+                                     .packed_object_to_variant( item.second, GRAPHENE_MAX_NESTED_OBJECTS ),
+                                  current_value( item.first ) } );
+   for( const auto& id : changes.new_ids )
+      result.changes.push_back( { id, fc::variant(), current_value( id ) } );
+   for( const auto& item : changes.removed )
+      result.changes.push_back( { item.first, item.second->to_variant(), fc::variant() } );
+   std::sort( result.changes.begin(), result.changes.end(),
+              []( const simulated_object_change& a, const simulated_object_change& b ) { return a.id < b.id; } );
+
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
 } }
@@ -40,51 +40,11 @@ const asset_dynamic_data_object& database::get_core_dynamic_data() const
    return *_p_core_dynamic_data_obj;
 }
 
-const global_property_object& database::get_global_properties()const
-{
-   return *_p_global_prop_obj;
-}
-
-const chain_property_object& database::get_chain_properties()const
-{
-   return *_p_chain_property_obj;
-}
-
-const dynamic_global_property_object& database::get_dynamic_global_properties() const
-{
-   return *_p_dyn_global_prop_obj;
-}
-
 const fee_schedule&  database::current_fee_schedule()const
 {
    return *get_global_properties().parameters.current_fees;
 }
 
-time_point_sec database::head_block_time()const
-{
-   return get_dynamic_global_properties().time;
-}
-
-uint32_t database::head_block_num()const
-{
-   return get_dynamic_global_properties().head_block_number;
-}
-
-block_id_type database::head_block_id()const
-{
-   return get_dynamic_global_properties().head_block_id;
-}
-
-decltype( chain_parameters::block_interval ) database::block_interval( )const
-{
-   return get_global_properties().parameters.block_interval;
-}
-
-const chain_id_type& database::get_chain_id( )const
-{
-   return get_chain_properties().chain_id;
-}
-
 const node_property_object& database::get_node_properties()const
 {
    return _node_property_object;
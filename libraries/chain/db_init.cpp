@@ -64,6 +64,8 @@
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/db/task_scheduler.hpp>
+
 #include <fc/uint128.hpp>
 #include <fc/crypto/digest.hpp>
 
@@ -187,33 +189,43 @@ void database::initialize_indexes()
    auto acnt_index = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
    acnt_index->add_secondary_index<account_member_index>();
    acnt_index->add_secondary_index<account_referrer_index>();
-
-   add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
-   add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
-   add_index< primary_index<limit_order_index > >();
+   acnt_index->add_secondary_index<account_authority_revision_index>();
+   acnt_index->add_secondary_index<account_name_index>();
+
+   add_index< primary_index<committee_member_index, 8> >() // 256 members per chunk
+      ->add_secondary_index<committee_member_vote_id_index>();
+   auto wit_index = add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
+   wit_index->add_secondary_index<witness_vote_id_index>();
+   _witness_confirmations = wit_index->add_secondary_index<witness_confirmation_index>();
+   add_index< primary_index<limit_order_index > >()->add_secondary_index<limit_order_depth_index>();
    add_index< primary_index<call_order_index > >();
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
+   prop_index->add_secondary_index<proposal_authorization_cache>();
+   _proposal_expirations = prop_index->add_secondary_index<proposal_expiration_index>();
 
    add_index< primary_index<withdraw_permission_index > >();
    add_index< primary_index<vesting_balance_index> >();
-   add_index< primary_index<worker_index> >();
+   add_index< primary_index<worker_index> >()->add_secondary_index<worker_vote_id_index>();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
 
    //Implementation object indexes
-   add_index< primary_index<transaction_index                             > >();
+   _transaction_expirations = add_index< primary_index<transaction_index  > >()
+                                 ->add_secondary_index<transaction_expiration_index>();
 
    auto bal_idx = add_index< primary_index<account_balance_index          > >();
-   bal_idx->add_secondary_index<balances_by_account_index>();
+   _balances_by_account = bal_idx->add_secondary_index<balances_by_account_index>();
+   bal_idx->add_secondary_index<asset_holder_rank_index>();
 
    add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
+   add_index< primary_index<account_stats_index,                       20 > >() // 1 Mi
+      ->add_secondary_index<account_maintenance_index>();
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
-   add_index< primary_index<simple_index<block_summary_object            >> >();
+   _block_summaries = add_index< primary_index<block_summary_index> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
    add_index< primary_index<simple_index<budget_record_object           > > >();
@@ -435,31 +447,63 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    for (uint32_t i = 0; i <= 0x10000; i++)
       create<block_summary_object>( [&]( block_summary_object&) {});
 
-   // Create initial accounts
-   for( const auto& account : genesis_state.initial_accounts )
+   // Create initial accounts. Each gets what account_create_evaluator makes of an account_create_operation registered
+   // by temp-account with the committee account as referrer, without evaluating one operation per account. The
+   // fee scaling of account_create has no effect yet because the fees are zero.
    {
-      account_create_operation cop;
-      cop.name = account.name;
-      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
-      cop.owner = authority(1, account.owner_key, 1);
-      if( account.active_key == public_key_type() )
-      {
-         cop.active = cop.owner;
-         cop.options.memo_key = account.owner_key;
-      }
-      else
+      auto& account_idx = dynamic_cast<base_primary_index&>( get_mutable_index( account_object::space_id,
+                                                                                 account_object::type_id ) );
+      const account_id_type lifetime_referrer = account_id_type()(*this).lifetime_referrer;
+      const chain_parameters& params = get_global_properties().parameters;
+      vector<account_id_type> lifetime_members;
+      account_idx.begin_deferred_fill();
+      for( const auto& account : genesis_state.initial_accounts )
       {
-         cop.active = authority(1, account.active_key, 1);
-         cop.options.memo_key = account.active_key;
+         const account_object& new_account = create<account_object>( [&]( account_object& a ) {
+            a.registrar = GRAPHENE_TEMP_ACCOUNT;
+            a.referrer = account_id_type();
+            a.lifetime_referrer = lifetime_referrer;
+            a.network_fee_percentage = params.network_percent_of_fee;
+            a.lifetime_referrer_fee_percentage = params.lifetime_referrer_percent_of_fee;
+            a.referrer_rewards_percentage = 0;
+            a.name = account.name;
+            a.owner = authority(1, account.owner_key, 1);
+            if( account.active_key == public_key_type() )
+            {
+               a.active = a.owner;
+               a.options.memo_key = account.owner_key;
+            }
+            else
+            {
+               a.active = authority(1, account.active_key, 1);
+               a.options.memo_key = account.active_key;
+            }
+            a.statistics = create<account_statistics_object>( [&a]( account_statistics_object& st ) {
+                              st.owner = a.id;
+                              st.name = a.name;
+                              st.is_voting = a.options.is_voting();
+                           }).id;
+         });
+         if( account.is_lifetime_member )
+            lifetime_members.push_back( new_account.get_id() );
       }
-      account_id_type account_id(apply_operation(genesis_eval_state, cop).get<object_id_type>());
 
-      if( account.is_lifetime_member )
+      // the secondary indexes of the accounts are independent of each other
+      task_group fills;
+      for( auto& fill : account_idx.end_deferred_fill() )
+         fills.run( std::move( fill ) );
+      fills.wait();
+
+      modify( get_dynamic_global_properties(), [&genesis_state]( dynamic_global_property_object& p ) {
+         p.accounts_registered_this_interval += genesis_state.initial_accounts.size();
+      });
+
+      for( const account_id_type& account_id : lifetime_members )
       {
-          account_upgrade_operation op;
-          op.account_to_upgrade = account_id;
-          op.upgrade_to_lifetime_member = true;
-          apply_operation(genesis_eval_state, op);
+         account_upgrade_operation op;
+         op.account_to_upgrade = account_id;
+         op.upgrade_to_lifetime_member = true;
+         apply_operation(genesis_eval_state, op);
       }
    }
 
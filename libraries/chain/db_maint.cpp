@@ -32,6 +32,7 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/budget_record_object.hpp>
 #include <graphene/chain/buyback_object.hpp>
 #include <graphene/chain/chain_property_object.hpp>
@@ -42,9 +43,12 @@
 #include <graphene/chain/special_authority_object.hpp>
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/chain/vote_count.hpp>
+#include <graphene/chain/vote_tally_cache.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 
+#include <graphene/db/task_scheduler.hpp>
+
 namespace graphene { namespace chain {
 
 template<class Index>
@@ -53,26 +57,33 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
    using ObjectType = typename Index::object_type;
    const auto& all_objects = get_index_type<Index>().indices();
    count = std::min(count, all_objects.size());
-   vector<std::reference_wrapper<const ObjectType>> refs;
-   refs.reserve(all_objects.size());
-   std::transform(all_objects.begin(), all_objects.end(),
-                  std::back_inserter(refs),
-                  [](const ObjectType& o) { return std::cref(o); });
-   std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
-                   [this](const ObjectType& a, const ObjectType& b)->bool {
-      share_type oa_vote = _vote_tally_buffer[a.vote_id];
-      share_type ob_vote = _vote_tally_buffer[b.vote_id];
-      if( oa_vote != ob_vote )
-         return oa_vote > ob_vote;
+
+   // the votes are looked up once per object instead of twice per comparison
+   struct ranked_object
+   {
+      share_type        votes;
+      vote_id_type      vote_id;
+      const ObjectType* object;
+   };
+   vector<ranked_object> ranking;
+   ranking.reserve(all_objects.size());
+   for( const ObjectType& o : all_objects )
+      ranking.push_back( { share_type( _vote_tally_buffer[o.vote_id] ), o.vote_id, &o } );
+   std::partial_sort(ranking.begin(), ranking.begin() + count, ranking.end(),
+                   [](const ranked_object& a, const ranked_object& b)->bool {
+      if( a.votes != b.votes )
+         return a.votes > b.votes;
       return a.vote_id < b.vote_id;
    });
 
-   refs.resize(count, refs.front());
+   vector<std::reference_wrapper<const ObjectType>> refs;
+   refs.reserve(count);
+   for( size_t i = 0; i < count; ++i )
+      refs.emplace_back( *ranking[i].object );
    return refs;
 }
 
-template<class Type>
-void database::perform_account_maintenance(Type tally_helper)
+void database::update_core_in_balances()
 {
    const auto& bal_idx = get_index_type< account_balance_index >().indices().get< by_maintenance_flag >();
    if( bal_idx.begin() != bal_idx.end() )
@@ -93,13 +104,20 @@ void database::perform_account_maintenance(Type tally_helper)
          bal_itr = bal_idx.rbegin();
       }
    }
+}
+
+template<class Type>
+void database::perform_account_maintenance(Type& tally_helper)
+{
+   update_core_in_balances();
 
-   const auto& stats_idx = get_index_type< account_stats_index >().indices().get< by_maintenance_seq >();
-   auto stats_itr = stats_idx.lower_bound( true );
+   const auto& stats_idx = dynamic_cast<const base_primary_index&>( get_index_type< account_stats_index >() )
+                              .get_secondary_index< account_maintenance_index >().accounts();
+   auto stats_itr = stats_idx.begin();
 
    while( stats_itr != stats_idx.end() )
    {
-      const account_statistics_object& acc_stat = *stats_itr;
+      const account_statistics_object& acc_stat = *stats_itr->second;
       const account_object& acc_obj = acc_stat.owner( *this );
       ++stats_itr;
 
@@ -112,6 +130,142 @@ void database::perform_account_maintenance(Type tally_helper)
 
 }
 
+void database::count_voting_stake( const account_object& acc_obj, const account_statistics_object& acc_stat,
+                                   const global_property_object& props, time_point_sec now )
+{
+   vote_tally_cache& cache = *_vote_tally_cache;
+   if( acc_stat.has_some_core_voting() && ( props.parameters.count_non_member_votes || acc_obj.is_member( now ) ) )
+   {
+      const account_object& opinion_account =
+            ( acc_obj.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT ) ? acc_obj
+                                                                              : get( acc_obj.options.voting_account );
+      uint64_t voting_stake = acc_stat.total_core_in_orders.value
+            + ( acc_obj.cashback_vb.valid() ? (*acc_obj.cashback_vb)(*this).balance.amount.value : 0 )
+            + acc_stat.core_in_balance.value;
+      cache.set_stake( acc_obj.id, &opinion_account, voting_stake );
+   }
+   else
+      cache.set_stake( acc_obj.id, nullptr, 0 );
+}
+
+void database::perform_incremental_account_maintenance( const global_property_object& props )
+{
+   update_core_in_balances();
+
+   // Same order as perform_account_maintenance(): an account is counted when the walk passes its name, after the
+   // fees of the accounts before it were processed. Accounts that process_fees() changes later in the order are
+   // added to the walk, those it changes earlier keep their counted stake and are recounted next time.
+   vote_tally_cache& cache = *_vote_tally_cache;
+   const std::set<account_id_type> dirty = cache.take_dirty();
+   std::map<string, account_id_type> walk;
+   for( account_id_type id : dirty )
+   {
+      // accounts of undone transactions are marked when they are removed again
+      const account_object* acc_obj = find( id );
+      if( acc_obj != nullptr )
+         walk.emplace( acc_obj->name, id );
+      else
+         cache.set_stake( id, nullptr, 0 );
+   }
+   std::set<account_id_type> carried;
+   const time_point_sec now = head_block_time();
+
+   while( !walk.empty() )
+   {
+      const string name = walk.begin()->first;
+      const account_object& acc_obj = walk.begin()->second(*this);
+      walk.erase( walk.begin() );
+      const account_statistics_object& acc_stat = get_account_stats_by_owner( acc_obj.id );
+
+      count_voting_stake( acc_obj, acc_stat, props, now );
+
+      if( acc_stat.has_pending_fees() )
+      {
+         acc_stat.process_fees( acc_obj, *this );
+         for( account_id_type changed : cache.take_dirty() )
+         {
+            const account_object& changed_obj = changed(*this);
+            if( changed_obj.name > name )
+               walk.emplace( changed_obj.name, changed );
+            else
+               carried.insert( changed );
+         }
+      }
+   }
+
+   // options only change outside of the maintenance, the stake that follows them can move now
+   for( account_id_type id : dirty )
+      if( const account_object* acc_obj = find( id ) )
+         cache.update_opinion( *acc_obj );
+   for( account_id_type id : carried )
+      cache.mark_dirty( id );
+}
+
+void database::prepare_vote_tally( const signed_block& next_block, const global_property_object& props )
+{
+   // Counts the accounts that changed in this block now instead of at the next maintenance. Accounts with pending
+   // fees stay marked, process_fees() may still change them and the maintenance walk has to see them in order.
+   // Whatever changes after this block marks the accounts again, so the maintenance recounts exactly the accounts
+   // whose state differs from what was counted here and the totals stay those of a full tally.
+   vote_tally_cache& cache = *_vote_tally_cache;
+   const std::set<account_id_type> dirty = cache.take_dirty();
+   if( dirty.empty() )
+      return;
+   const time_point_sec now = head_block_time();
+   vector<const account_object*> counted;
+   counted.reserve( dirty.size() );
+   for( account_id_type id : dirty )
+   {
+      const account_object* acc_obj = find( id );
+      if( acc_obj == nullptr )
+      {
+         cache.set_stake( id, nullptr, 0 );
+         continue;
+      }
+      const account_statistics_object& acc_stat = get_account_stats_by_owner( id );
+      if( acc_stat.has_pending_fees() )
+      {
+         cache.mark_dirty( id );
+         continue;
+      }
+      count_voting_stake( *acc_obj, acc_stat, props, now );
+      counted.push_back( acc_obj );
+   }
+   for( const account_object* acc_obj : counted )
+      cache.update_opinion( *acc_obj );
+   // the counted stakes are those of this block, a fork that undoes it falls back to a full tally
+   cache.set_reconciled( next_block.block_num(), next_block.id(), props.parameters.count_non_member_votes );
+}
+
+bool database::can_reconcile_vote_tally( const signed_block& next_block, const global_property_object& props )const
+{
+   if( !_vote_tally_cache || !_vote_tally_cache->is_valid() )
+      return false;
+   if( _vote_tally_cache->counts_non_member_votes() != props.parameters.count_non_member_votes )
+      return false;
+   // memberships only stop expiring by time once annual memberships are gone
+   if( get_dynamic_global_properties().next_maintenance_time < HARDFORK_613_TIME )
+      return false;
+   // the totals must not contain changes of blocks that were undone, see create_block_summary()
+   const uint32_t num = _vote_tally_cache->reconciled_block_num();
+   if( num >= next_block.block_num() || next_block.block_num() - num >= 0x10000 )
+      return false;
+   const block_summary_object* summary = find( block_summary_id_type( num & 0xffff ) );
+   return summary != nullptr && summary->block_id == _vote_tally_cache->reconciled_block_id();
+}
+
+void database::enable_incremental_vote_tally()
+{
+   if( _vote_tally_cache )
+      return;
+   _vote_tally_cache.reset( new vote_tally_cache );
+   vote_tally_cache* cache = _vote_tally_cache.get();
+   add_secondary_index< primary_index< account_index, 20 >, vote_tally_tracker< account_object > >( cache );
+   add_secondary_index< primary_index< account_stats_index, 20 >,
+                        vote_tally_tracker< account_statistics_object > >( cache );
+   add_secondary_index< primary_index< vesting_balance_index >, vote_tally_tracker< vesting_balance_object > >( cache );
+}
+
 /// @brief A visitor for @ref worker_type which calls pay_worker on the worker within
 struct worker_pay_visitor
 {
@@ -153,12 +307,13 @@ void database::pay_workers( share_type& budget )
    const auto head_time = head_block_time();
 //   ilog("Processing payroll! Available budget is ${b}", ("b", budget));
    vector<std::reference_wrapper<const worker_object>> active_workers;
-   // TODO optimization: add by_expiration index to avoid iterating through all objects
-   get_index_type<worker_index>().inspect_all_objects([head_time, &active_workers](const object& o) {
-      const worker_object& w = static_cast<const worker_object&>(o);
+   const auto& workers_by_end = get_index_type<worker_index>().indices().get<by_end_date>();
+   for( auto itr = workers_by_end.lower_bound( boost::make_tuple( head_time ) ); itr != workers_by_end.end(); ++itr )
+   {
+      const worker_object& w = *itr;
       if( w.is_active(head_time) && w.approving_stake() > 0 )
          active_workers.emplace_back(w);
-   });
+   }
 
    // worker with more votes is preferred
    // if two workers exactly tie for votes, worker with lower ID is preferred
@@ -707,9 +862,12 @@ void create_buyback_orders( database& db )
          continue;
       }
 
+      // the orders may fill and create balances of the account, which invalidates iterators into its balances
+      vector<const account_balance_object*> holdings;
       for( const auto& entry : bal_idx.get_account_balances( buyback_account.id ) )
+         holdings.push_back( entry.second );
+      for( const account_balance_object* it : holdings )
       {
-         const auto* it = entry.second;
          asset_id_type asset_to_sell = it->asset_type;
          share_type amount_to_sell = it->balance;
          if( asset_to_sell == asset_to_buy.id )
@@ -1085,6 +1243,16 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       database& d;
       const global_property_object& props;
 
+      /** the stake of one account and the account whose opinions it follows */
+      struct voting_stake_entry
+      {
+         account_id_type       stake_account;
+         const account_object* opinion_account;
+         uint64_t              stake;
+      };
+      /** collected in maintenance order, the votes are added up by tally_votes() */
+      vector<voting_stake_entry> stakes;
+
       vote_tally_helper(database& d, const global_property_object& gpo)
          : d(d), props(gpo)
       {
@@ -1106,47 +1274,138 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                    GRAPHENE_PROXY_TO_SELF_ACCOUNT)? stake_account
                                      : d.get(stake_account.options.voting_account);
 
+            // the cashback balance may still change by process_fees() of later accounts, so read it now
             uint64_t voting_stake = stats.total_core_in_orders.value
                   + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
                   + stats.core_in_balance.value;
 
+            stakes.push_back( { stake_account.id, &opinion_account, voting_stake } );
+         }
+      }
+
+      /** adds the votes of stakes[begin,end) to the given buffers */
+      void tally( size_t begin, size_t end, vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram,
+                  vector<uint64_t>& committee_count_histogram, uint64_t& total_voting_stake )const
+      {
+         for( size_t i = begin; i < end; ++i )
+         {
+            const account_object& opinion_account = *stakes[i].opinion_account;
+            const uint64_t voting_stake = stakes[i].stake;
+
             for( vote_id_type id : opinion_account.options.votes )
             {
                uint32_t offset = id.instance();
                // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
+               if( offset < vote_tally.size() )
+                  vote_tally[offset] += voting_stake;
             }
 
             if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
             {
                uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
+                                          witness_count_histogram.size() - 1);
                // votes for a number greater than maximum_witness_count
                // are turned into votes for maximum_witness_count.
                //
                // in particular, this takes care of the case where a
                // member was voting for a high number, then the
                // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
+               witness_count_histogram[offset] += voting_stake;
             }
             if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
             {
                uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
+                                          committee_count_histogram.size() - 1);
                // votes for a number greater than maximum_committee_count
                // are turned into votes for maximum_committee_count.
                //
                // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
+               committee_count_histogram[offset] += voting_stake;
             }
 
-            d._total_voting_stake += voting_stake;
+            total_voting_stake += voting_stake;
+         }
+      }
+
+      /**
+       * Adds up all collected votes, in parallel shards for many voters. The sums wrap around like the serial ones
+       * and addition is commutative, so the result does not depend on the sharding.
+       */
+      void tally_votes()
+      {
+         const size_t min_shard_size = 1000;
+         const size_t shards = d._parallel_vote_tally
+                               ? std::min<size_t>( task_scheduler::shared().size(), stakes.size() / min_shard_size )
+                               : 0;
+         if( shards < 2 )
+         {
+            tally( 0, stakes.size(), d._vote_tally_buffer, d._witness_count_histogram_buffer,
+                   d._committee_count_histogram_buffer, d._total_voting_stake );
+            return;
+         }
+
+         struct partial_tally
+         {
+            vector<uint64_t> vote_tally;
+            vector<uint64_t> witness_count_histogram;
+            vector<uint64_t> committee_count_histogram;
+            uint64_t         total_voting_stake = 0;
+         };
+         vector<partial_tally> partials( shards );
+         task_group workers;
+         const size_t shard_size = ( stakes.size() + shards - 1 ) / shards;
+         for( size_t s = 0; s < shards; ++s )
+         {
+            partial_tally& p = partials[s];
+            p.vote_tally.resize( d._vote_tally_buffer.size() );
+            p.witness_count_histogram.resize( d._witness_count_histogram_buffer.size() );
+            p.committee_count_histogram.resize( d._committee_count_histogram_buffer.size() );
+            const size_t begin = std::min( s * shard_size, stakes.size() );
+            const size_t end = std::min( begin + shard_size, stakes.size() );
+            workers.run( [this,&p,begin,end] () {
+               tally( begin, end, p.vote_tally, p.witness_count_histogram, p.committee_count_histogram,
+                      p.total_voting_stake );
+            } );
+         }
+         workers.wait();
+
+         for( const partial_tally& p : partials )
+         {
+            for( size_t i = 0; i < p.vote_tally.size(); ++i )
+               d._vote_tally_buffer[i] += p.vote_tally[i];
+            for( size_t i = 0; i < p.witness_count_histogram.size(); ++i )
+               d._witness_count_histogram_buffer[i] += p.witness_count_histogram[i];
+            for( size_t i = 0; i < p.committee_count_histogram.size(); ++i )
+               d._committee_count_histogram_buffer[i] += p.committee_count_histogram[i];
+            d._total_voting_stake += p.total_voting_stake;
          }
       }
    } tally_helper(*this, gpo);
 
-   perform_account_maintenance( tally_helper );
+   if( can_reconcile_vote_tally( next_block, gpo ) )
+   {
+      perform_incremental_account_maintenance( gpo );
+      _vote_tally_cache->fill( _vote_tally_buffer, _witness_count_histogram_buffer,
+                               gpo.parameters.maximum_witness_count, _committee_count_histogram_buffer,
+                               gpo.parameters.maximum_committee_count, _total_voting_stake );
+   }
+   else
+   {
+      // changes seen from here on are recounted next time, the totals are rebuilt from this tally
+      if( _vote_tally_cache )
+         _vote_tally_cache->clear_dirty();
+      perform_account_maintenance( tally_helper );
+      tally_helper.tally_votes();
+      if( _vote_tally_cache )
+      {
+         _vote_tally_cache->reset();
+         for( const auto& entry : tally_helper.stakes )
+            _vote_tally_cache->set_stake( entry.stake_account, entry.opinion_account, entry.stake );
+      }
+   }
+   if( _vote_tally_cache )
+      _vote_tally_cache->set_reconciled( next_block.block_num(), next_block.id(),
+                                         gpo.parameters.count_non_member_votes );
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -30,16 +30,71 @@
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/db/task_scheduler.hpp>
+
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
 
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <memory>
 
 namespace graphene { namespace chain {
 
+/** Precedes the indexes in a file written by database::save_state_snapshot() */
+struct state_snapshot_header
+{
+   static const uint64_t expected_magic = 0x50414e5348505247ULL; ///< "GRPHSNAP"
+   static const uint32_t current_version = 1;
+
+   uint64_t      magic = expected_magic;
+   uint32_t      version = current_version;
+   std::string   db_version;
+   chain_id_type chain_id;
+   signed_block  head_block;
+};
+
+/** Written next to a state snapshot by database::write_state_snapshot() */
+struct state_snapshot_manifest
+{
+   struct index_checksum
+   {
+      uint8_t    space_id = 0;
+      uint8_t    type_id = 0;
+      uint64_t   size = 0;
+      fc::sha256 checksum;
+   };
+
+   uint32_t               head_block_num = 0;
+   fc::sha256             checksum; ///< of the whole snapshot file
+   vector<index_checksum> indexes;
+};
+ }}
+FC_REFLECT( graphene::chain::state_snapshot_header, (magic)(version)(db_version)(chain_id)(head_block) );
+FC_REFLECT( graphene::chain::state_snapshot_manifest::index_checksum, (space_id)(type_id)(size)(checksum) );
+FC_REFLECT( graphene::chain::state_snapshot_manifest, (head_block_num)(checksum)(indexes) );
+
+namespace graphene { namespace chain {
+
+namespace {
+   /** consecutive blocks that one replay worker reads, unpacks and precomputes */
+   struct replay_batch
+   {
+      uint32_t             first_block_num = 0;
+      uint32_t             count = 0;
+      /** ends early at a gap in the block database */
+      vector<signed_block> blocks;
+      /** skip flags to apply each block with */
+      vector<uint32_t>     skips;
+      /** microseconds the worker needed */
+      int64_t              decode_time = 0;
+      fc::future<void>     done;
+   };
+}
+
 database::database()
 {
    initialize_indexes();
@@ -61,11 +116,19 @@ void database::reindex( fc::path data_dir )
    }
    if( last_block->block_num() <= head_block_num()) return;
 
+   FC_ASSERT( head_block_num() + 1 >= _block_id_to_block.first_block_num(),
+              "Blocks before ${n} were pruned, replay needs an object database at block ${m} or later, resync instead",
+              ("n",_block_id_to_block.first_block_num())("m",_block_id_to_block.first_block_num() - 1) );
    ilog( "reindexing blockchain" );
    auto start = fc::time_point::now();
    const auto last_block_num = last_block->block_num();
    uint32_t flush_point = last_block_num < 10000 ? 0 : last_block_num - 10000;
    uint32_t undo_point = last_block_num < 50 ? 0 : last_block_num - 50;
+   // a clean shutdown rewinds to the last irreversible block, keep the undo history of everything after it;
+   // a replay from genesis doesn't know that block
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   if( head_block_num() > 0 && last_block_num - last_irreversible <= GRAPHENE_MAX_UNDO_HISTORY )
+      undo_point = std::min( undo_point, last_irreversible );
 
    ilog( "Replaying blocks, starting at ${next}...", ("next",head_block_num() + 1) );
    if( head_block_num() >= undo_point )
@@ -74,31 +137,143 @@ void database::reindex( fc::path data_dir )
          _fork_db.start_block( *fetch_block_by_number( head_block_num() ) );
    }
    else
+   {
       _undo_db.disable();
+      start_history_replay();
+   }
 
-   uint32_t skip = node_properties().skip_flags;
+   const uint32_t skip = node_properties().skip_flags;
+   const size_t total_block_size = _block_id_to_block.total_block_size();
+   const fc::time_point_sec dupe_check_start = last_block->timestamp
+                                               - get_global_properties().parameters.maximum_time_until_expiration;
 
-   size_t total_block_size = _block_id_to_block.total_block_size();
-   const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
+   // Blocks are read, unpacked and precomputed in batches on the task scheduler. The batches queue up in block order,
+   // waiting on the front one is the reorder buffer in front of the single apply stage.
+   const uint32_t batch_size = 50;
+   const size_t threads = task_scheduler::shared().size();
+   const size_t min_depth = threads + 1;
+   const size_t max_depth = 16 * threads;
+   size_t depth = 2 * threads;
+
+   auto decode = [this,skip,dupe_check_start]( replay_batch& batch ) {
+      const auto started = fc::time_point::now();
+      vector<vector<char>> raw = _block_id_to_block.fetch_raw_range( batch.first_block_num, batch.count );
+      batch.blocks.resize( raw.size() );
+      batch.skips.resize( raw.size() );
+      for( size_t k = 0; k < raw.size(); ++k )
+      {
+         signed_block& block = batch.blocks[k];
+         fc::datastream<const char*> ds( raw[k].data(), raw[k].size() );
+         fc::raw::unpack( ds, block );
+         vector<char>().swap( raw[k] );
+         batch.skips[k] = skip;
+         if( block.timestamp >= dupe_check_start )
+            batch.skips[k] &= ~skip_transaction_dupe_check;
+         _precompute_block( block, batch.skips[k] );
+      }
+      batch.decode_time = ( fc::time_point::now() - started ).count();
+   };
+
+   std::deque< std::shared_ptr<replay_batch> > batches;
+   // the workers use the block database, they must be done before it is modified or the replay is left
+   auto drain = [&batches]() {
+      for( const auto& batch : batches )
+      {
+         try
+         {
+            batch->done.wait();
+         }
+         catch( const fc::exception& )
+         {
+         }
+      }
+      batches.clear();
+   };
+
+   // stage timings of the current window, in microseconds
+   int64_t window_decode_time = 0;
+   int64_t window_apply_time = 0;
+   uint32_t window_batches = 0;
+
+   const uint32_t first_replayed = head_block_num() + 1;
+   uint32_t next_block_num = first_replayed;
    uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
+   try
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      while( true )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
+         while( next_block_num <= last_block_num && batches.size() < depth )
          {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= ~skip_transaction_dupe_check;
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
+            auto batch = std::make_shared<replay_batch>();
+            batch->first_block_num = next_block_num;
+            batch->count = std::min( batch_size, last_block_num - next_block_num + 1 );
+            next_block_num += batch->count;
+            batch->done = task_scheduler::shared().async( [decode,batch] () { decode( *batch ); }, task_priority::high );
+            batches.push_back( batch );
          }
-         else
+         if( batches.empty() )
+            break;
+
+         const std::shared_ptr<replay_batch> batch = batches.front();
+         batches.pop_front();
+         batch->done.wait();
+
+         const auto apply_started = fc::time_point::now();
+         for( size_t k = 0; k < batch->blocks.size(); ++k, ++i )
+         {
+            const signed_block& block = batch->blocks[k];
+            if( i % 10000 == 0 )
+            {
+               const size_t processed_block_size = _block_id_to_block.blocks_current_position();
+               ilog(
+                  "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]   [depth: ${depth}]",
+                  ("size", double(processed_block_size) / total_block_size * 100)
+                  ("processed", processed_block_size)
+                  ("total", total_block_size)
+                  ("num", double(i*100)/last_block_num)
+                  ("i", i)
+                  ("last", last_block_num)
+                  ("depth", depth * batch_size)
+               );
+            }
+            // the history consumers write to the indexes that are saved
+            if( i == flush_point )
+            {
+               ilog( "Writing database to disk at block ${i}", ("i",i) );
+               finish_history_replay();
+               flush();
+               if( i < undo_point )
+                  start_history_replay();
+               ilog( "Done" );
+            }
+            // the undo history is off before undo_point, the state between two blocks is consistent on disk
+            else if( _replay_checkpoint_interval > 0 && i % _replay_checkpoint_interval == 0
+                     && i < undo_point && i > first_replayed )
+            {
+               ilog( "Saving replay checkpoint at block ${i}", ("i",i - 1) );
+               finish_history_replay();
+               flush();
+               start_history_replay();
+               ilog( "Done" );
+            }
+            if( i < undo_point )
+               apply_block( block, batch->skips[k] );
+            else
+            {
+               // the consumers index on the chain thread again from here, inside the undo sessions of the blocks
+               finish_history_replay();
+               _undo_db.enable();
+               push_block( block, batch->skips[k] );
+            }
+         }
+         window_apply_time += ( fc::time_point::now() - apply_started ).count();
+         window_decode_time += batch->decode_time;
+
+         if( batch->blocks.size() < batch->count )
          {
             wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+            drain();
+            next_block_num = last_block_num + 1; // don't load more blocks
             uint32_t dropped_count = 0;
             while( true )
             {
@@ -107,60 +282,281 @@ void database::reindex( fc::path data_dir )
                if( !last_id.valid() )
                   break;
                // we've caught up to the gap
-               if( block_header::num_from_id( *last_id ) <= i )
+               if( block_header::num_from_id( *last_id ) < i )
                   break;
                _block_id_to_block.remove( *last_id );
                dropped_count++;
             }
             wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
+            break;
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
-         if( i % 10000 == 0 )
-         {
-            ilog(
-               "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
-               ("size", double(std::get<0>(blocks.front())) / total_block_size * 100)
-               ("processed", std::get<0>(blocks.front()))
-               ("total", total_block_size)
-               ("num", double(i*100)/last_block_num)
-               ("i", i)
-               ("last", last_block_num)
-            );
-         }
-         if( i == flush_point )
-         {
-            ilog( "Writing database to disk at block ${i}", ("i",i) );
-            flush();
-            ilog( "Done" );
-         }
-         if( i < undo_point )
-            apply_block( block, skip );
-         else
+         // enough batches in flight to keep every worker busy for as long as the apply stage needs per batch
+         if( ++window_batches == 16 )
          {
-            _undo_db.enable();
-            push_block( block, skip );
+            const int64_t apply_time = std::max<int64_t>( window_apply_time, 1 );
+            const size_t wanted = threads + size_t( ( window_decode_time + apply_time - 1 ) / apply_time );
+            depth = std::min( std::max( wanted, min_depth ), max_depth );
+            window_decode_time = 0;
+            window_apply_time = 0;
+            window_batches = 0;
          }
-         blocks.pop();
-         i++;
       }
    }
+   catch( ... )
+   {
+      drain();
+      try
+      {
+         finish_history_replay();
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "History consumer failed during the replay: ${e}", ("e",e.to_detail_string()) );
+      }
+      throw;
+   }
+   finish_history_replay();
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+   if( _analyze_trx_conflicts )
+      ilog( "Transaction conflicts: ${c} of ${n} transactions in ${b} blocks, ${r} rounds of parallel application",
+            ("c",_trx_conflict_stats.conflicting)("n",_trx_conflict_stats.transactions)
+            ("b",_trx_conflict_stats.blocks)("r",_trx_conflict_stats.rounds) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::save_fork_db()const
+{
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   vector<signed_block> blocks;
+   for( const signed_block_ptr& b : _fork_db.fetch_all_blocks() )
+      if( b->block_num() > last_irreversible )
+         blocks.push_back( *b );
+   const fc::path fork_db_file = get_data_dir() / "database" / "fork_db";
+   if( blocks.empty() )
+   {
+      fc::remove( fork_db_file );
+      return;
+   }
+
+   ilog( "Saving ${n} reversible blocks of the fork database", ("n", blocks.size()) );
+   std::ofstream out( fork_db_file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Unable to open ${f}", ("f", fork_db_file) );
+   fc::raw::pack( out, blocks );
+}
+
+void database::load_fork_db()
+{
+   const fc::path fork_db_file = get_data_dir() / "database" / "fork_db";
+   if( !fc::exists( fork_db_file ) )
+      return;
+   try
+   {
+      vector<signed_block> blocks;
+      std::string data;
+      fc::read_file_contents( fork_db_file, data );
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      fc::raw::unpack( ds, blocks );
+
+      if( !_fork_db.head() && head_block_num() > 0 )
+         _fork_db.start_block( *fetch_block_by_number( head_block_num() ) );
+      uint32_t restored = 0;
+      for( const signed_block& b : blocks )
+      {
+         // the replay already restored the blocks of the main chain
+         if( b.block_num() <= get_dynamic_global_properties().last_irreversible_block_num
+             || _fork_db.is_known_block( b.id() ) )
+            continue;
+         try
+         {
+            _fork_db.push_block( b );
+            ++restored;
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Dropping saved block ${id}: ${e}", ("id", b.id())("e", e.to_string()) );
+         }
+      }
+      // the chain state decides the head, a restored fork only becomes head through a regular block push
+      auto head = _fork_db.fetch_block( head_block_id() );
+      if( head )
+         _fork_db.set_head( head );
+      ilog( "Restored ${n} fork blocks", ("n", restored) );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to load the saved fork database: ${e}", ("e", e.to_detail_string()) );
+   }
+   // an unclean shutdown must not bring back stale forks
+   fc::remove( fork_db_file );
+}
+
+void database::save_state_snapshot( const fc::path& file, const std::string& db_version )const
+{
+   write_state_snapshot( capture_state_snapshot( db_version ), file );
+}
+
+database::captured_state_snapshot database::capture_state_snapshot( const std::string& db_version )const
+{ try {
+   state_snapshot_header header;
+   header.db_version = db_version;
+   header.chain_id = get_chain_id();
+   optional<signed_block> head = fetch_block_by_number( head_block_num() );
+   FC_ASSERT( head.valid() && head->id() == head_block_id(), "The head block is not in the block database" );
+   header.head_block = std::move( *head );
+
+   captured_state_snapshot result;
+   result.head_block_num = head_block_num();
+   result.header = fc::raw::pack( header );
+   result.indexes = pack_indexes();
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+namespace {
+   /** Writes to a stream and hashes what was written */
+   struct hashing_writer
+   {
+      std::ostream&         out;
+      fc::sha256::encoder   enc;
+
+      void write( const char* data, size_t size )
+      {
+         out.write( data, size );
+         enc.write( data, size );
+      }
+      template<typename T>
+      void pack( const T& value )
+      {
+         const auto bytes = fc::raw::pack( value );
+         write( bytes.data(), bytes.size() );
+      }
+   };
+}
+
+void database::write_state_snapshot( const captured_state_snapshot& snapshot, const fc::path& file )
+{ try {
+   state_snapshot_manifest manifest;
+   manifest.head_block_num = snapshot.head_block_num;
+   const fc::path tmp = file.generic_string() + ".tmp";
+   {
+      std::ofstream out( tmp.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to open ${f}", ("f", tmp) );
+      hashing_writer writer{ out };
+      writer.write( snapshot.header.data(), snapshot.header.size() );
+      // the layout of object_database::write_packed_indexes()
+      writer.pack( uint32_t( snapshot.indexes.size() ) );
+      for( const auto& index : snapshot.indexes )
+      {
+         writer.pack( index.space_id );
+         writer.pack( index.type_id );
+         writer.pack( uint64_t( index.data.size() ) );
+         writer.write( index.data.data(), index.data.size() );
+         state_snapshot_manifest::index_checksum checksum;
+         checksum.space_id = index.space_id;
+         checksum.type_id = index.type_id;
+         checksum.size = index.data.size();
+         checksum.checksum = fc::sha256::hash( index.data.data(), index.data.size() );
+         manifest.indexes.push_back( checksum );
+      }
+      out.flush();
+      FC_ASSERT( out, "Failed to write ${f}", ("f", tmp) );
+      manifest.checksum = writer.enc.result();
+   }
+   // a manifest left from an older snapshot must not describe the new file
+   const fc::path manifest_file = file.generic_string() + ".manifest";
+   fc::remove( manifest_file );
+   fc::rename( tmp, file );
+   fc::json::save_to_file( manifest, manifest_file.generic_string() + ".tmp" );
+   fc::rename( manifest_file.generic_string() + ".tmp", manifest_file );
+   ilog( "Saved state snapshot at block ${n} to ${f}", ("n",snapshot.head_block_num)("f",file) );
+} FC_CAPTURE_AND_RETHROW( (file) ) }
+
+uint32_t database::install_state_snapshot( const fc::path& snapshot, const fc::path& data_dir,
+                                           const std::string& db_version, const chain_id_type& chain_id )
+{ try {
+   const fc::path manifest_file = snapshot.generic_string() + ".manifest";
+   if( fc::exists( manifest_file ) )
+   {
+      const auto manifest = fc::json::from_file( manifest_file ).as<state_snapshot_manifest>( 3 );
+      std::ifstream check( snapshot.generic_string(), std::ifstream::binary );
+      FC_ASSERT( check, "Unable to open ${f}", ("f", snapshot) );
+      fc::sha256::encoder enc;
+      std::vector<char> buffer( 1 << 20 );
+      while( check )
+      {
+         check.read( buffer.data(), buffer.size() );
+         enc.write( buffer.data(), check.gcount() );
+      }
+      FC_ASSERT( enc.result() == manifest.checksum, "${f} does not match the checksum of its manifest",
+                 ("f", snapshot) );
+   }
+   std::ifstream in( snapshot.generic_string(), std::ifstream::binary );
+   FC_ASSERT( in, "Unable to open ${f}", ("f", snapshot) );
+   in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   state_snapshot_header header;
+   fc::raw::unpack( in, header );
+   FC_ASSERT( header.magic == state_snapshot_header::expected_magic, "${f} is not a state snapshot", ("f", snapshot) );
+   FC_ASSERT( header.version == state_snapshot_header::current_version,
+              "Unsupported state snapshot version ${v}", ("v", header.version) );
+   FC_ASSERT( header.db_version == db_version, "The snapshot was taken with database version ${s}, expected ${v}",
+              ("s", header.db_version)("v", db_version) );
+   FC_ASSERT( header.chain_id == chain_id, "The snapshot belongs to chain ${s}, expected ${c}",
+              ("s", header.chain_id)("c", chain_id) );
+   const fc::path block_dir = data_dir / "database" / "block_num_to_block";
+   FC_ASSERT( !fc::exists( block_dir ), "${d} already contains blocks", ("d", data_dir) );
+
+   fc::create_directories( data_dir );
+   object_database::install_indexes( in, data_dir );
+   std::ofstream version_file( (data_dir / "db_version").generic_string().c_str(),
+                               std::ios::out | std::ios::binary | std::ios::trunc );
+   version_file.write( db_version.c_str(), db_version.size() );
+   version_file.close();
+
+   block_database blocks;
+   blocks.open( block_dir, true );
+   blocks.start_at( header.head_block.block_num() );
+   blocks.store( header.head_block.id(), header.head_block );
+   blocks.close();
+   return header.head_block.block_num();
+} FC_CAPTURE_AND_RETHROW( (snapshot)(data_dir) ) }
+
+uint32_t database::import_blocks( const fc::path& source, const fc::path& data_dir, uint32_t thread_count )
+{ try {
+   FC_ASSERT( !_opened, "Blocks can only be imported before the database is opened" );
+   const fc::path source_dir = fc::exists( source / "database" / "block_num_to_block" )
+                               ? source / "database" / "block_num_to_block" : source;
+   const fc::path block_dir = data_dir / "database" / "block_num_to_block";
+   FC_ASSERT( !fc::exists( block_dir ) || fc::canonical( source_dir ) != fc::canonical( block_dir ),
+              "Can not import blocks from the block database of this node" );
+
+   block_database from;
+   from.open_read_only( source_dir );
+   fc::create_directories( block_dir );
+   block_database to;
+   if( _convert_block_log && block_database::has_legacy_format( block_dir ) )
+      block_database::convert_to_segmented( block_dir );
+   to.open( block_dir, _segmented_block_log );
+   const uint32_t last = to.import_from( from, thread_count );
+   to.close();
+   from.close();
+   return last;
+} FC_CAPTURE_AND_RETHROW( (source)(data_dir) ) }
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
    if (_opened) {
      close();
    }
+   // the cached blocks belong to the chain that is wiped
+   _block_cache.clear();
+   if( !include_blocks && block_database::is_pruned( data_dir / "database" / "block_num_to_block" ) )
+   {
+      // without the old blocks a replay has to start from the checkpoint saved while pruning
+      wlog( "Keeping the object database, the block database is pruned" );
+      return;
+   }
    object_database::wipe(data_dir);
    if( include_blocks )
       fc::remove_all( data_dir / "database" );
@@ -192,11 +588,24 @@ void database::open(
       }
 
       object_database::open(data_dir);
+      // a previous open() of this database may have cached the blocks of another chain
+      _block_cache.clear();
 
-      _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+      fc::time_point start = fc::time_point::now();
+      const fc::path block_dir = data_dir / "database" / "block_num_to_block";
+      if( _convert_block_log && block_database::has_legacy_format( block_dir ) )
+         block_database::convert_to_segmented( block_dir );
+      _block_id_to_block.open( block_dir, _segmented_block_log );
+      // keep disk latency off the block-apply path, _push_block fences at irreversibility
+      _block_id_to_block.enable_write_behind();
+      report_phase( "block_database", start );
 
       if( !find(global_property_id_type()) )
+      {
+         start = fc::time_point::now();
          init_genesis(genesis_loader());
+         report_phase( "init_genesis", start );
+      }
       else
       {
          _p_core_asset_obj = &get( asset_id_type() );
@@ -207,19 +616,44 @@ void database::open(
          _p_witness_schedule_obj = &get( witness_schedule_id_type() );
       }
 
+      // find damage left by a crash now instead of when the replay runs into it
+      start = fc::time_point::now();
+      _block_id_to_block.verify_and_repair( std::max<uint32_t>( head_block_num(), 1 ) );
+      report_phase( "block_database verification", start );
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
       if( last_block.valid() )
       {
          FC_ASSERT( *last_block >= head_block_id(),
                     "last block ID does not match current chain state",
                     ("last_block->id", last_block)("head_block_id",head_block_num()) );
+         start = fc::time_point::now();
          reindex( data_dir );
+         report_phase( "reindex", start );
       }
+      start = fc::time_point::now();
+      load_fork_db();
+      report_phase( "fork_database", start );
       _opened = true;
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
+void database::open_state_journal( const fc::path& dir )
+{ try {
+   _state_journal.reset( new state_journal( dir ) );
+   if( _state_journal->last_block() != 0 && _state_journal->last_block() != head_block_num() )
+      wlog( "The state journal ends at block ${j} but the head block is ${h}, it restarts with the next block",
+            ("j",_state_journal->last_block())("h",head_block_num()) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+vector<fc::variant> database::get_objects_at_block( const vector<object_id_type>& ids, uint32_t block_num )const
+{ try {
+   FC_ASSERT( _state_journal, "The state journal is not enabled" );
+   FC_ASSERT( _state_journal->last_block() == head_block_num(), "The state journal is not up to date" );
+   // the pending transactions changed the state since the head block, their session undoes them for the query
+   return _state_journal->get_objects( *this, ids, block_num, _pending_tx_session.valid() ? &_undo_db.head() : nullptr );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 void database::close(bool rewind)
 {
    if (!_opened)
@@ -228,6 +662,15 @@ void database::close(bool rewind)
    // TODO:  Save pending tx's on close()
    clear_pending();
 
+   try
+   {
+      save_fork_db();
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to save fork database: ${e}", ("e", e.to_detail_string()) );
+   }
+
    // pop all of the blocks that we can given our undo history, this should
    // throw when there is no more undo history to pop
    if( rewind )
@@ -255,6 +698,15 @@ void database::close(bool rewind)
    // DB state (issue #336).
    clear_pending();
 
+   // the undo states of the reversible blocks are gone after a restart, the state on disk includes them
+   if( _state_journal )
+   {
+      _state_journal->flush( head_block_num() );
+      _state_journal.reset();
+   }
+
+   // the checkpoint of pruning must not rename the files that flush() writes
+   finish_prune_checkpoint();
    object_database::flush();
    object_database::close();
 
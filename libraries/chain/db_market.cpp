@@ -931,6 +931,25 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     if( bitasset.is_prediction_market ) return false;
     if( bitasset.current_feed.settlement_price.is_null() ) return false;
 
+    const call_order_index& call_index = get_index_type<call_order_index>();
+    const auto& call_price_index = call_index.indices().get<by_price>();
+
+    auto call_min = price::min( bitasset.options.short_backing_asset, mia.id );
+    auto call_max = price::max( bitasset.options.short_backing_asset, mia.id );
+    auto call_itr = call_price_index.lower_bound( call_min );
+    auto call_end = call_price_index.upper_bound( call_max );
+
+    if( call_itr == call_end )
+       return false;
+
+    auto head_time = head_block_time();
+    bool after_hardfork_436 = ( head_time > HARDFORK_436_TIME );
+
+    // Nothing can be called if even the least collateralized call order is feed protected, this is what the first
+    // iteration of the loop below would find out after looking for limit orders.
+    if( after_hardfork_436 && bitasset.current_feed.settlement_price > ~call_itr->call_price )
+       return false;
+
     const limit_order_index& limit_index = get_index_type<limit_order_index>();
     const auto& limit_price_index = limit_index.indices().get<by_price>();
 
@@ -947,22 +966,12 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     if( limit_itr == limit_end )
        return false;
 
-    const call_order_index& call_index = get_index_type<call_order_index>();
-    const auto& call_price_index = call_index.indices().get<by_price>();
-
-    auto call_min = price::min( bitasset.options.short_backing_asset, mia.id );
-    auto call_max = price::max( bitasset.options.short_backing_asset, mia.id );
-    auto call_itr = call_price_index.lower_bound( call_min );
-    auto call_end = call_price_index.upper_bound( call_max );
-
     bool filled_limit = false;
     bool margin_called = false;
 
-    auto head_time = head_block_time();
     auto head_num = head_block_num();
 
     bool before_hardfork_615 = ( head_time < HARDFORK_615_TIME );
-    bool after_hardfork_436 = ( head_time > HARDFORK_436_TIME );
 
     bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
     bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
@@ -261,7 +261,7 @@ struct get_impacted_account_visitor
 void graphene::chain::operation_get_impacted_accounts( const operation& op, flat_set<account_id_type>& result )
 {
   get_impacted_account_visitor vtor = get_impacted_account_visitor( result );
-  op.visit( vtor );
+  table_visit( op, vtor );
 }
 
 void graphene::chain::transaction_get_impacted_accounts( const transaction& tx, flat_set<account_id_type>& result )
@@ -371,12 +371,10 @@ void get_relevant_accounts( const object* obj, flat_set<account_id_type>& accoun
               FC_ASSERT( aobj != nullptr );
               accounts.insert( aobj->owner );
               break;
-           } case impl_transaction_object_type:{
-              const auto& aobj = dynamic_cast<const transaction_object*>(obj);
-              FC_ASSERT( aobj != nullptr );
-              transaction_get_impacted_accounts( aobj->trx, accounts );
+           } case impl_transaction_object_type:
+              // only the id of the transaction is kept
               break;
-           } case impl_blinded_balance_object_type:{
+             case impl_blinded_balance_object_type:{
               const auto& aobj = dynamic_cast<const blinded_balance_object*>(obj);
               FC_ASSERT( aobj != nullptr );
               for( const auto& a : aobj->owner.account_auths )
@@ -449,13 +447,21 @@ void database::notify_changed_objects()
       // Changed
       if( !changed_objects.empty() )
       {
-        vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
+        vector<object_id_type> changed_ids;
+        changed_ids.reserve( head_undo.old_values.size() + head_undo.packed_old_values.size() );
         flat_set<account_id_type> changed_accounts_impacted;
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
           get_relevant_accounts(item.second.get(), changed_accounts_impacted);
         }
+        for( const auto& item : head_undo.packed_old_values )
+        {
+          changed_ids.push_back(item.first);
+          auto old_value = get_object(item.first).clone();
+          old_value->unpack_from(item.second);
+          get_relevant_accounts(old_value.get(), changed_accounts_impacted);
+        }
 
         if( changed_ids.size() )
            GRAPHENE_TRY_NOTIFY( changed_objects, changed_ids, changed_accounts_impacted)
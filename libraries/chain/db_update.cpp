@@ -77,8 +77,12 @@ void database::update_global_dynamic_data( const signed_block& b, const uint32_t
                  ("recently_missed",_dgp.recently_missed_count)("max_undo",GRAPHENE_MAX_UNDO_HISTORY) );
    }
 
-   _undo_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
-   _fork_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
+   // simulated blocks must not drop the undo history or the forks of the live chain
+   if( _simulation == nullptr )
+   {
+      _undo_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
+      _fork_db.set_max_size( _dgp.head_block_number - _dgp.last_irreversible_block_num + 1 );
+   }
 }
 
 void database::update_signing_witness(const witness_object& signing_witness, const signed_block& new_block)
@@ -108,11 +112,16 @@ void database::update_last_irreversible_block()
    const global_property_object& gpo = get_global_properties();
    const dynamic_global_property_object& dpo = get_dynamic_global_properties();
 
-   // TODO for better performance, move this to db_maint, because only need to do it once per maintenance interval
-   vector< const witness_object* > wit_objs;
-   wit_objs.reserve( gpo.active_witnesses.size() );
-   for( const witness_id_type& wid : gpo.active_witnesses )
-      wit_objs.push_back( &(wid(*this)) );
+   // the witnesses change at maintenance, and back when a maintenance block is popped
+   if( !_witness_confirmations->tracks( gpo.active_witnesses ) )
+   {
+      vector< const witness_object* > wit_objs;
+      wit_objs.reserve( gpo.active_witnesses.size() );
+      for( const witness_id_type& wid : gpo.active_witnesses )
+         wit_objs.push_back( &(wid(*this)) );
+      _witness_confirmations->track( gpo.active_witnesses, wit_objs );
+   }
+   const vector<uint32_t>& confirmations = _witness_confirmations->sorted_confirmations();
 
    static_assert( GRAPHENE_IRREVERSIBLE_THRESHOLD > 0, "irreversible threshold must be nonzero" );
 
@@ -121,15 +130,9 @@ void database::update_last_irreversible_block()
    // 3 3 3 3 3 3 3 3 3 3 -> 3
    // 3 3 3 4 4 4 4 4 4 4 -> 4
 
-   size_t offset = ((GRAPHENE_100_PERCENT - GRAPHENE_IRREVERSIBLE_THRESHOLD) * wit_objs.size() / GRAPHENE_100_PERCENT);
+   size_t offset = ((GRAPHENE_100_PERCENT - GRAPHENE_IRREVERSIBLE_THRESHOLD) * confirmations.size() / GRAPHENE_100_PERCENT);
 
-   std::nth_element( wit_objs.begin(), wit_objs.begin() + offset, wit_objs.end(),
-      []( const witness_object* a, const witness_object* b )
-      {
-         return a->last_confirmed_block_num < b->last_confirmed_block_num;
-      } );
-
-   uint32_t new_last_irreversible_block_num = wit_objs[offset]->last_confirmed_block_num;
+   uint32_t new_last_irreversible_block_num = confirmations[offset];
 
    if( new_last_irreversible_block_num > dpo.last_irreversible_block_num )
    {
@@ -144,18 +147,18 @@ void database::clear_expired_transactions()
 { try {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
-   auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids, impl_transaction_object_type));
-   const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.begin());
+   auto& transaction_idx = get_mutable_index(implementation_ids, impl_transaction_object_type);
+   // transactions are kept until their expiration is before the head block time
+   const time_point_sec before_head_time( head_block_time().sec_since_epoch() - 1 );
+   while( const optional<object_id_type> expired = _transaction_expirations->next_expired( before_head_time ) )
+      transaction_idx.remove( transaction_idx.get( *expired ) );
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_expired_proposals()
 {
-   const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
-   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
+   while( const optional<object_id_type> expired = _proposal_expirations->next_expired( head_block_time() ) )
    {
-      const proposal_object& proposal = *proposal_expiration_index.begin();
+      const proposal_object& proposal = static_cast<const proposal_object&>( get_object( *expired ) );
       processed_transaction result;
       try {
          if( proposal.is_authorized_to_execute(*this) )
@@ -209,6 +212,11 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
        // due to #338, we won't check for black swan on incoming limit order, so need to check with MSSP here
        highest = bitasset.current_feed.max_short_squeeze_price();
 
+    // the best bid can only raise highest, no need to look for it if the least collateralized call is safe already
+    auto least_collateral = call_itr->collateralization();
+    if( ~least_collateral < highest )
+       return false;
+
     const limit_order_index& limit_index = get_index_type<limit_order_index>();
     const auto& limit_price_index = limit_index.indices().get<by_price>();
 
@@ -227,7 +235,6 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
        highest = std::max( limit_itr->sell_price, highest );
     }
 
-    auto least_collateral = call_itr->collateralization();
     if( ~least_collateral >= highest  ) 
     {
        wdump( (*call_itr) );
@@ -259,19 +266,19 @@ void database::clear_expired_orders()
          auto head_time = head_block_time();
          auto maint_time = get_dynamic_global_properties().next_maintenance_time;
 
-         bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
-         bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
          bool before_core_hardfork_606 = ( maint_time <= HARDFORK_CORE_606_TIME ); // feed always trigger call
 
          auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
-         while( !limit_index.empty() && limit_index.begin()->expiration <= head_time )
+         if( before_core_hardfork_606 )
          {
-            const limit_order_object& order = *limit_index.begin();
-            auto base_asset = order.sell_price.base.asset_id;
-            auto quote_asset = order.sell_price.quote.asset_id;
-            cancel_limit_order( order );
-            if( before_core_hardfork_606 )
+            // Calls are checked after every single cancellation, and a margin call can fill or remove a later
+            // expiring order of the same batch, so the orders have to be taken one by one from the index here.
+            while( !limit_index.empty() && limit_index.begin()->expiration <= head_time )
             {
+               const limit_order_object& order = *limit_index.begin();
+               auto base_asset = order.sell_price.base.asset_id;
+               auto quote_asset = order.sell_price.quote.asset_id;
+               cancel_limit_order( order );
                // check call orders
                // Comments below are copied from limit_order_cancel_evaluator::do_apply(...)
                // Possible optimization: order can be called by cancelling a limit order
@@ -281,180 +288,165 @@ void database::clear_expired_orders()
                check_call_orders( quote_asset( *this ) );
             }
          }
-
-   //Process expired force settlement orders
-   auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
-   if( !settlement_index.empty() )
-   {
-      asset_id_type current_asset = settlement_index.begin()->settlement_asset_id();
-      asset max_settlement_volume;
-      price settlement_fill_price;
-      price settlement_price;
-      bool current_asset_finished = false;
-      bool extra_dump = false;
-
-      auto next_asset = [&current_asset, &current_asset_finished, &settlement_index, &extra_dump] {
-         auto bound = settlement_index.upper_bound(current_asset);
-         if( bound == settlement_index.end() )
+         else
          {
-            if( extra_dump )
+            // Nothing but the cancellations themselves touches the order book any more, so all orders expired
+            // in this block are cancelled as a single batch without looking them up in the index again.
+            auto expired_end = limit_index.upper_bound( head_time );
+            auto itr = limit_index.begin();
+            uint32_t expired_count = 0;
+            while( itr != expired_end )
             {
-               ilog( "next_asset() returning false" );
+               const limit_order_object& order = *itr;
+               ++itr;
+               cancel_limit_order( order );
+               ++expired_count;
             }
-            return false;
+            if( expired_count > 1000 )
+               ilog( "Cancelled ${n} expired limit orders in block ${b}",
+                     ("n",expired_count)("b",head_block_num()) );
          }
-         if( extra_dump )
-         {
-            ilog( "next_asset returning true, bound is ${b}", ("b", *bound) );
-         }
-         current_asset = bound->settlement_asset_id();
-         current_asset_finished = false;
-         return true;
-      };
 
-      uint32_t count = 0;
+   //Process expired force settlement orders, one asset at a time
+   auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
+   uint32_t count = 0;
+   auto itr = settlement_index.begin();
+   while( itr != settlement_index.end() )
+   {
+      const asset_id_type current_asset = itr->settlement_asset_id();
+      clear_expired_force_settlements( get( current_asset ), count );
+      itr = settlement_index.upper_bound( current_asset );
+   }
+} FC_CAPTURE_AND_RETHROW() }
 
-      // At each iteration, we either consume the current order and remove it, or we move to the next asset
-      for( auto itr = settlement_index.lower_bound(current_asset);
-           itr != settlement_index.end();
-           itr = settlement_index.lower_bound(current_asset) )
-      {
-         ++count;
-         const force_settlement_object& order = *itr;
-         auto order_id = order.id;
-         current_asset = order.settlement_asset_id();
-         const asset_object& mia_object = get(current_asset);
-         const asset_bitasset_data_object& mia = mia_object.bitasset_data(*this);
+void database::clear_expired_force_settlements( const asset_object& mia_object, uint32_t& count )
+{
+   const auto head_time = head_block_time();
+   const auto maint_time = get_dynamic_global_properties().next_maintenance_time;
+   const bool before_core_hardfork_184 = ( maint_time <= HARDFORK_CORE_184_TIME ); // something-for-nothing
+   const bool before_core_hardfork_342 = ( maint_time <= HARDFORK_CORE_342_TIME ); // better rounding
 
-         extra_dump = ((count >= 1000) && (count <= 1020));
+   const asset_id_type current_asset = mia_object.id;
+   const asset_bitasset_data_object& mia = mia_object.bitasset_data(*this);
+   auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
+   auto& call_index = get_index_type<call_order_index>().indices().get<by_collateral>();
+
+   // Calculated once for the asset when the first order is due, neither changes while its queue is processed
+   optional<asset> max_settlement_volume;
+   optional<price> settlement_fill_price;
+   price settlement_price;
+   const price call_min = price::min( mia.options.short_backing_asset, current_asset );
+   bool current_asset_finished = false;
+
+   // At each iteration, we either consume the current order and remove it, or we are done with the asset
+   for( auto itr = settlement_index.lower_bound(current_asset);
+        itr != settlement_index.end() && itr->settlement_asset_id() == current_asset;
+        itr = settlement_index.lower_bound(current_asset) )
+   {
+      ++count;
+      const force_settlement_object& order = *itr;
+      auto order_id = order.id;
 
-         if( extra_dump )
-         {
-            wlog( "clear_expired_orders() dumping extra data for iteration ${c}", ("c", count) );
-            ilog( "head_block_num is ${hb} current_asset is ${a}", ("hb", head_block_num())("a", current_asset) );
-         }
+      if( count >= 1000 && count <= 1020 )
+      {
+         wlog( "clear_expired_orders() dumping extra data for iteration ${c}", ("c", count) );
+         ilog( "head_block_num is ${hb} current_asset is ${a}", ("hb", head_block_num())("a", current_asset) );
+      }
 
-         if( mia.has_settlement() )
-         {
-            ilog( "Canceling a force settlement because of black swan" );
-            cancel_settle_order( order );
-            continue;
-         }
+      if( mia.has_settlement() )
+      {
+         ilog( "Canceling a force settlement because of black swan" );
+         cancel_settle_order( order );
+         continue;
+      }
 
-         // Has this order not reached its settlement date?
-         if( order.settlement_date > head_time )
-         {
-            if( next_asset() )
-            {
-               if( extra_dump )
-               {
-                  ilog( "next_asset() returned true when order.settlement_date > head_block_time()" );
-               }
-               continue;
-            }
-            break;
-         }
-         // Can we still settle in this asset?
-         if( mia.current_feed.settlement_price.is_null() )
-         {
-            ilog("Canceling a force settlement in ${asset} because settlement price is null",
-                 ("asset", mia_object.symbol));
-            cancel_settle_order(order);
-            continue;
-         }
-         if( max_settlement_volume.asset_id != current_asset )
-            max_settlement_volume = mia_object.amount(mia.max_force_settlement_volume(mia_object.dynamic_data(*this).current_supply));
-         // When current_asset_finished is true, this would be the 2nd time processing the same order.
-         // In this case, we move to the next asset.
-         if( mia.force_settled_volume >= max_settlement_volume.amount || current_asset_finished )
-         {
-            /*
-            ilog("Skipping force settlement in ${asset}; settled ${settled_volume} / ${max_volume}",
-                 ("asset", mia_object.symbol)("settlement_price_null",mia.current_feed.settlement_price.is_null())
-                 ("settled_volume", mia.force_settled_volume)("max_volume", max_settlement_volume));
-                 */
-            if( next_asset() )
-            {
-               if( extra_dump )
-               {
-                  ilog( "next_asset() returned true when mia.force_settled_volume >= max_settlement_volume.amount" );
-               }
-               continue;
-            }
-            break;
-         }
+      // Has this order not reached its settlement date?
+      if( order.settlement_date > head_time )
+         return;
+      // Can we still settle in this asset?
+      if( mia.current_feed.settlement_price.is_null() )
+      {
+         ilog("Canceling a force settlement in ${asset} because settlement price is null",
+              ("asset", mia_object.symbol));
+         cancel_settle_order(order);
+         continue;
+      }
+      if( !max_settlement_volume.valid() )
+         max_settlement_volume = mia_object.amount(mia.max_force_settlement_volume(mia_object.dynamic_data(*this).current_supply));
+      // When current_asset_finished is true, this would be the 2nd time processing the same order.
+      // In this case, we move to the next asset.
+      if( mia.force_settled_volume >= max_settlement_volume->amount || current_asset_finished )
+         return;
+
+      if( !settlement_fill_price.valid() )
+      {
+         settlement_fill_price = mia.current_feed.settlement_price
+                                 / ratio_type( GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent,
+                                               GRAPHENE_100_PERCENT );
+         settlement_price = *settlement_fill_price;
+      }
 
-         if( settlement_fill_price.base.asset_id != current_asset ) // only calculate once per asset
-            settlement_fill_price = mia.current_feed.settlement_price
-                                    / ratio_type( GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent,
-                                                  GRAPHENE_100_PERCENT );
+      if( before_core_hardfork_342 )
+      {
+         auto& pays = order.balance;
+         auto receives = (order.balance * mia.current_feed.settlement_price);
+         receives.amount = ( fc::uint128_t(receives.amount.value) *
+                             (GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent) /
+                             GRAPHENE_100_PERCENT ).to_uint64();
+         assert(receives <= order.balance * mia.current_feed.settlement_price);
+         settlement_price = pays / receives;
+      }
 
-         if( before_core_hardfork_342 )
-         {
-            auto& pays = order.balance;
-            auto receives = (order.balance * mia.current_feed.settlement_price);
-            receives.amount = ( fc::uint128_t(receives.amount.value) *
-                                (GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent) /
-                                GRAPHENE_100_PERCENT ).to_uint64();
-            assert(receives <= order.balance * mia.current_feed.settlement_price);
-            settlement_price = pays / receives;
-         }
-         else if( settlement_price.base.asset_id != current_asset ) // only calculate once per asset
-            settlement_price = settlement_fill_price;
+      asset settled = mia_object.amount(mia.force_settled_volume);
+      // Match against the least collateralized short until the settlement is finished or we reach max settlements
+      while( settled < *max_settlement_volume && find_object(order_id) )
+      {
+         auto call_itr = call_index.lower_bound( boost::make_tuple( call_min ) );
+         // There should always be a call order, since asset exists!
+         assert(call_itr != call_index.end() && call_itr->debt_type() == current_asset);
+         asset max_settlement = *max_settlement_volume - settled;
 
-         auto& call_index = get_index_type<call_order_index>().indices().get<by_collateral>();
-         asset settled = mia_object.amount(mia.force_settled_volume);
-         // Match against the least collateralized short until the settlement is finished or we reach max settlements
-         while( settled < max_settlement_volume && find_object(order_id) )
+         if( order.balance.amount == 0 )
          {
-            auto itr = call_index.lower_bound(boost::make_tuple(price::min(mia_object.bitasset_data(*this).options.short_backing_asset,
-                                                                           mia_object.get_id())));
-            // There should always be a call order, since asset exists!
-            assert(itr != call_index.end() && itr->debt_type() == mia_object.get_id());
-            asset max_settlement = max_settlement_volume - settled;
-
-            if( order.balance.amount == 0 )
+            wlog( "0 settlement detected" );
+            cancel_settle_order( order );
+            break;
+         }
+         try {
+            asset new_settled = match(*call_itr, order, settlement_price, max_settlement, *settlement_fill_price);
+            if( !before_core_hardfork_184 && new_settled.amount == 0 ) // unable to fill this settle order
             {
-               wlog( "0 settlement detected" );
-               cancel_settle_order( order );
-               break;
-            }
-            try {
-               asset new_settled = match(*itr, order, settlement_price, max_settlement, settlement_fill_price);
-               if( !before_core_hardfork_184 && new_settled.amount == 0 ) // unable to fill this settle order
-               {
-                  if( find_object( order_id ) ) // the settle order hasn't been cancelled
-                     current_asset_finished = true;
-                  break;
-               }
-               settled += new_settled;
-               // before hard fork core-342, `new_settled > 0` is always true, we'll have:
-               // * call order is completely filled (thus itr will change in next loop), or
-               // * settle order is completely filled (thus find_object(order_id) will be false so will break out), or
-               // * reached max_settlement_volume limit (thus new_settled == max_settlement so will break out).
-               //
-               // after hard fork core-342, if new_settled > 0, we'll have:
-               // * call order is completely filled (thus itr will change in next loop), or
-               // * settle order is completely filled (thus find_object(order_id) will be false so will break out), or
-               // * reached max_settlement_volume limit, but it's possible that new_settled < max_settlement,
-               //   in this case, new_settled will be zero in next iteration of the loop, so no need to check here.
-            } 
-            catch ( const black_swan_exception& e ) { 
-               wlog( "Cancelling a settle_order since it may trigger a black swan: ${o}, ${e}",
-                     ("o", order)("e", e.to_detail_string()) );
-               cancel_settle_order( order );
+               if( find_object( order_id ) ) // the settle order hasn't been cancelled
+                  current_asset_finished = true;
                break;
             }
+            settled += new_settled;
+            // before hard fork core-342, `new_settled > 0` is always true, we'll have:
+            // * call order is completely filled (thus call_itr will change in next loop), or
+            // * settle order is completely filled (thus find_object(order_id) will be false so will break out), or
+            // * reached max_settlement_volume limit (thus new_settled == max_settlement so will break out).
+            //
+            // after hard fork core-342, if new_settled > 0, we'll have:
+            // * call order is completely filled (thus call_itr will change in next loop), or
+            // * settle order is completely filled (thus find_object(order_id) will be false so will break out), or
+            // * reached max_settlement_volume limit, but it's possible that new_settled < max_settlement,
+            //   in this case, new_settled will be zero in next iteration of the loop, so no need to check here.
          }
-         if( mia.force_settled_volume != settled.amount )
-         {
-            modify(mia, [settled](asset_bitasset_data_object& b) {
-               b.force_settled_volume = settled.amount;
-            });
+         catch ( const black_swan_exception& e ) {
+            wlog( "Cancelling a settle_order since it may trigger a black swan: ${o}, ${e}",
+                  ("o", order)("e", e.to_detail_string()) );
+            cancel_settle_order( order );
+            break;
          }
       }
+      if( mia.force_settled_volume != settled.amount )
+      {
+         modify(mia, [settled](asset_bitasset_data_object& b) {
+            b.force_settled_volume = settled.amount;
+         });
+      }
    }
-} FC_CAPTURE_AND_RETHROW() }
+}
 
 void database::update_expired_feeds()
 {
@@ -37,6 +37,8 @@
 
 #include <fc/uint128.hpp>
 
+#include <chrono>
+
 namespace graphene { namespace chain {
 database& generic_evaluator::db()const { return trx_state->db(); }
 
@@ -44,12 +46,57 @@ database& generic_evaluator::db()const { return trx_state->db(); }
    { try {
       trx_state   = &eval_state;
       //check_required_authorities(op);
-      auto result = evaluate( op );
+      using graphene::db::apply_phase;
+      using graphene::db::apply_phase_scope;
+      if( !operation_timing_enabled() )
+      {
+         operation_result result;
+         {
+            apply_phase_scope evaluating( apply_phase::evaluate, op.which() );
+            result = evaluate( op );
+         }
+         if( apply )
+         {
+            apply_phase_scope applying( apply_phase::apply, op.which() );
+            result = this->apply( op );
+         }
+         return result;
+      }
 
-      if( apply ) result = this->apply( op );
+      typedef std::chrono::steady_clock clock;
+      const uint64_t undo_records = db().undo_record_count();
+      const auto start = clock::now();
+      operation_result result;
+      {
+         apply_phase_scope evaluating( apply_phase::evaluate, op.which() );
+         result = evaluate( op );
+      }
+      const auto evaluated = clock::now();
+      if( apply )
+      {
+         apply_phase_scope applying( apply_phase::apply, op.which() );
+         result = this->apply( op );
+      }
+      const auto applied = clock::now();
+
+      operation_timing& timing = db().get_operation_timing( op.which() );
+      const uint64_t evaluate_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( evaluated - start ).count();
+      const uint64_t apply_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( applied - evaluated ).count();
+      ++timing.count;
+      timing.evaluate_ns += evaluate_ns;
+      timing.max_evaluate_ns = std::max( timing.max_evaluate_ns, evaluate_ns );
+      timing.apply_ns += apply_ns;
+      timing.max_apply_ns = std::max( timing.max_apply_ns, apply_ns );
+      timing.undo_records += db().undo_record_count() - undo_records;
       return result;
    } FC_CAPTURE_AND_RETHROW() }
 
+   bool generic_evaluator::operation_timing_enabled()const
+   {
+      // dry runs happen off the chain thread, the measurements belong to it
+      return !trx_state->dry_run && db().operation_timing_enabled();
+   }
+
    void generic_evaluator::prepare_fee(account_id_type account_id, asset fee)
    {
       const database& d = db();
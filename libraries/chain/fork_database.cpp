@@ -44,7 +44,7 @@ void fork_database::pop_block()
 
 void     fork_database::start_block(signed_block b)
 {
-   auto item = std::make_shared<fork_item>(std::move(b));
+   auto item = std::make_shared<fork_item>( std::make_shared<const signed_block>( std::move(b) ) );
    _index.insert(item);
    _head = item;
 }
@@ -54,6 +54,11 @@ void     fork_database::start_block(signed_block b)
  *
  */
 shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+{
+   return push_block( std::make_shared<const signed_block>( b ) );
+}
+
+shared_ptr<fork_item>  fork_database::push_block(const signed_block_ptr& b)
 {
    auto item = std::make_shared<fork_item>(b);
    try {
@@ -61,8 +66,8 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
-      wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",item->id)("num",item->num) );
+      wlog( "Head: ${num}, ${id}", ("num",_head->data->block_num())("id",_head->data->id()) );
       throw;
    }
    return _head;
@@ -145,6 +150,15 @@ vector<item_ptr> fork_database::fetch_block_by_number(uint32_t num)const
    return result;
 }
 
+vector<signed_block_ptr> fork_database::fetch_all_blocks()const
+{
+   vector<signed_block_ptr> result;
+   result.reserve( _index.size() );
+   for( const item_ptr& item : _index.get<block_num>() )
+      result.push_back( item->data );
+   return result;
+}
+
 pair<fork_database::branch_type,fork_database::branch_type>
   fork_database::fetch_branch_from(block_id_type first, block_id_type second)const
 { try {
@@ -160,19 +174,19 @@ pair<fork_database::branch_type,fork_database::branch_type>
    auto second_branch = *second_branch_itr;
 
 
-   while( first_branch->data.block_num() > second_branch->data.block_num() )
+   while( first_branch->data->block_num() > second_branch->data->block_num() )
    {
       result.first.push_back(first_branch);
       first_branch = first_branch->prev.lock();
       FC_ASSERT(first_branch);
    }
-   while( second_branch->data.block_num() > first_branch->data.block_num() )
+   while( second_branch->data->block_num() > first_branch->data->block_num() )
    {
       result.second.push_back( second_branch );
       second_branch = second_branch->prev.lock();
       FC_ASSERT(second_branch);
    }
-   while( first_branch->data.previous != second_branch->data.previous )
+   while( first_branch->data->previous != second_branch->data->previous )
    {
       result.first.push_back(first_branch);
       result.second.push_back(second_branch);
@@ -24,6 +24,14 @@
 
 #include <graphene/chain/genesis_state.hpp>
 
+#include <graphene/db/task_scheduler.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <ostream>
+
 namespace graphene { namespace chain {
 
 chain_id_type genesis_state_type::compute_chain_id() const
@@ -31,4 +39,265 @@ chain_id_type genesis_state_type::compute_chain_id() const
    return initial_chain_id;
 }
 
+namespace {
+
+/** a value in the JSON text, from its first character to one past its last */
+typedef std::pair<size_t, size_t> json_span;
+
+class json_scanner
+{
+   public:
+      explicit json_scanner( const string& text ) : _text( text ) {}
+
+      size_t skip_whitespace( size_t pos )const
+      {
+         while( pos < _text.size() && ( _text[pos] == ' ' || _text[pos] == '\t' || _text[pos] == '\n'
+                                        || _text[pos] == '\r' ) )
+            ++pos;
+         return pos;
+      }
+
+      /** @return the end of the string starting at pos */
+      size_t skip_string( size_t pos )const
+      {
+         FC_ASSERT( pos < _text.size() && _text[pos] == '"', "Expected a string at offset ${p}", ("p",pos) );
+         for( ++pos; pos < _text.size(); ++pos )
+         {
+            if( _text[pos] == '\\' )
+               ++pos;
+            else if( _text[pos] == '"' )
+               return pos + 1;
+         }
+         FC_THROW( "Unterminated string in genesis JSON" );
+      }
+
+      /** @return the end of the value starting at pos */
+      size_t skip_value( size_t pos )const
+      {
+         FC_ASSERT( pos < _text.size(), "Unexpected end of genesis JSON" );
+         const char first = _text[pos];
+         if( first == '"' )
+            return skip_string( pos );
+         if( first != '{' && first != '[' )
+         {
+            while( pos < _text.size() && _text[pos] != ',' && _text[pos] != '}' && _text[pos] != ']'
+                   && skip_whitespace( pos ) == pos )
+               ++pos;
+            return pos;
+         }
+         uint32_t depth = 0;
+         while( pos < _text.size() )
+         {
+            const char c = _text[pos];
+            if( c == '"' )
+            {
+               pos = skip_string( pos );
+               continue;
+            }
+            if( c == '{' || c == '[' )
+               ++depth;
+            else if( c == '}' || c == ']' )
+            {
+               if( --depth == 0 )
+                  return pos + 1;
+            }
+            ++pos;
+         }
+         FC_THROW( "Unterminated object or array in genesis JSON" );
+      }
+
+      /** @return the elements of the array in span */
+      vector<json_span> split_array( const json_span& span )const
+      {
+         vector<json_span> elements;
+         FC_ASSERT( _text[span.first] == '[', "Expected an array at offset ${p}", ("p",span.first) );
+         size_t pos = skip_whitespace( span.first + 1 );
+         if( pos < span.second && _text[pos] == ']' )
+            return elements;
+         while( pos < span.second )
+         {
+            const size_t end = skip_value( pos );
+            elements.emplace_back( pos, end );
+            pos = skip_whitespace( end );
+            FC_ASSERT( pos < span.second, "Unterminated array in genesis JSON" );
+            if( _text[pos] == ']' )
+               break;
+            FC_ASSERT( _text[pos] == ',', "Expected , or ] at offset ${p}", ("p",pos) );
+            pos = skip_whitespace( pos + 1 );
+         }
+         return elements;
+      }
+
+      fc::variant parse( const json_span& span )const
+      {
+         return fc::json::from_string( _text.substr( span.first, span.second - span.first ) );
+      }
+
+   private:
+      const string& _text;
+};
+
+template<typename T>
+void convert_elements( const json_scanner& scanner, const vector<json_span>& elements, vector<T>& result,
+                       uint32_t max_depth )
+{
+   result.resize( elements.size() );
+   const auto convert = [&scanner,&elements,&result,max_depth]( size_t begin, size_t end ) {
+      for( size_t i = begin; i < end; ++i )
+         result[i] = scanner.parse( elements[i] ).as<T>( max_depth );
+   };
+   // an element takes a few microseconds, mostly for its keys or addresses
+   const size_t min_batch = 1024;
+   const size_t chunks = std::min<size_t>( graphene::db::task_scheduler::shared().size(),
+                                           ( elements.size() + min_batch - 1 ) / min_batch );
+   if( chunks <= 1 )
+   {
+      convert( 0, elements.size() );
+      return;
+   }
+   const size_t chunk_size = ( elements.size() + chunks - 1 ) / chunks;
+   graphene::db::task_group workers;
+   for( size_t begin = 0; begin < elements.size(); begin += chunk_size )
+   {
+      const size_t end = std::min( begin + chunk_size, elements.size() );
+      workers.run( [&convert,begin,end] () { convert( begin, end ); } );
+   }
+   workers.wait();
+}
+
+template<typename T>
+void write_elements( const vector<T>& elements, std::ostream& out, uint32_t max_depth )
+{
+   // the elements are converted by windows of one batch per worker, then written in order
+   const size_t batch = 1024;
+   const size_t workers = std::max<size_t>( 1, graphene::db::task_scheduler::shared().size() );
+   vector<string> texts( workers );
+   const auto convert = [&elements,&texts,max_depth,batch]( size_t begin, size_t end, size_t text ) {
+      string& result = texts[text];
+      result.clear();
+      for( size_t i = begin; i < end; ++i )
+      {
+         if( i > 0 )
+            result += ",\n";
+         result += fc::json::to_string( fc::variant( elements[i], max_depth ),
+                                        fc::json::stringify_large_ints_and_doubles, max_depth );
+      }
+   };
+
+   out << '[';
+   for( size_t window = 0; window < elements.size(); window += batch * workers )
+   {
+      const size_t window_end = std::min( elements.size(), window + batch * workers );
+      size_t used = 0;
+      if( window_end - window <= batch )
+         convert( window, window_end, used++ );
+      else
+      {
+         graphene::db::task_group group;
+         for( size_t begin = window; begin < window_end; begin += batch, ++used )
+         {
+            const size_t end = std::min( window_end, begin + batch );
+            group.run( [&convert,begin,end,used] () { convert( begin, end, used ); } );
+         }
+         group.wait();
+      }
+      for( size_t i = 0; i < used; ++i )
+         out << texts[i];
+   }
+   out << ']';
+}
+
+/** writes the members of a genesis state in the order of its reflection, the arrays element by element */
+class genesis_writer
+{
+   public:
+      genesis_writer( const genesis_state_type& genesis, std::ostream& out, uint32_t max_depth )
+         : _genesis( genesis ), _out( out ), _max_depth( max_depth ) {}
+
+      template<typename Member, class Class, Member (Class::*member)>
+      void operator()( const char* name )const
+      {
+         _out << ( _first ? "{\n" : ",\n" ) << fc::json::to_string( string( name ) ) << ':';
+         _first = false;
+         write( _genesis.*member );
+      }
+
+   private:
+      template<typename T>
+      void write( const vector<T>& elements )const
+      {
+         write_elements( elements, _out, _max_depth - 2 );
+      }
+
+      template<typename T>
+      void write( const T& value )const
+      {
+         _out << fc::json::to_string( fc::variant( value, _max_depth - 1 ), fc::json::stringify_large_ints_and_doubles,
+                                      _max_depth - 1 );
+      }
+
+      const genesis_state_type& _genesis;
+      std::ostream&             _out;
+      const uint32_t            _max_depth;
+      mutable bool              _first = true;
+};
+
+} // anonymous namespace
+
+genesis_state_type read_genesis_state( const string& json, uint32_t max_depth )
+{ try {
+   FC_ASSERT( max_depth > 2 );
+   const json_scanner scanner( json );
+   size_t pos = scanner.skip_whitespace( 0 );
+   FC_ASSERT( pos < json.size() && json[pos] == '{', "Genesis JSON must be an object" );
+   pos = scanner.skip_whitespace( pos + 1 );
+
+   // the small members are converted together, the large arrays element by element
+   fc::mutable_variant_object small_members;
+   vector<json_span> accounts, assets, balances, vesting_balances;
+   while( pos < json.size() && json[pos] != '}' )
+   {
+      const size_t key_end = scanner.skip_string( pos );
+      const string key = scanner.parse( json_span( pos, key_end ) ).as_string();
+      pos = scanner.skip_whitespace( key_end );
+      FC_ASSERT( pos < json.size() && json[pos] == ':', "Expected : at offset ${p}", ("p",pos) );
+      pos = scanner.skip_whitespace( pos + 1 );
+      const json_span value( pos, scanner.skip_value( pos ) );
+
+      if( key == "initial_accounts" )
+         accounts = scanner.split_array( value );
+      else if( key == "initial_assets" )
+         assets = scanner.split_array( value );
+      else if( key == "initial_balances" )
+         balances = scanner.split_array( value );
+      else if( key == "initial_vesting_balances" )
+         vesting_balances = scanner.split_array( value );
+      else
+         small_members( key, scanner.parse( value ) );
+
+      pos = scanner.skip_whitespace( value.second );
+      FC_ASSERT( pos < json.size(), "Unterminated genesis JSON" );
+      if( json[pos] == ',' )
+         pos = scanner.skip_whitespace( pos + 1 );
+      else
+         FC_ASSERT( json[pos] == '}', "Expected , or } at offset ${p}", ("p",pos) );
+   }
+   FC_ASSERT( pos < json.size(), "Unterminated genesis JSON" );
+
+   genesis_state_type genesis = fc::variant( small_members ).as<genesis_state_type>( max_depth );
+   convert_elements( scanner, accounts, genesis.initial_accounts, max_depth - 2 );
+   convert_elements( scanner, assets, genesis.initial_assets, max_depth - 2 );
+   convert_elements( scanner, balances, genesis.initial_balances, max_depth - 2 );
+   convert_elements( scanner, vesting_balances, genesis.initial_vesting_balances, max_depth - 2 );
+   return genesis;
+} FC_CAPTURE_AND_RETHROW() }
+
+void write_genesis_state( const genesis_state_type& genesis, std::ostream& out, uint32_t max_depth )
+{ try {
+   FC_ASSERT( max_depth > 2 );
+   fc::reflector<genesis_state_type>::visit( genesis_writer( genesis, out, max_depth ) );
+   out << "\n}\n";
+   FC_ASSERT( out.good(), "Failed to write the genesis JSON" );
+} FC_CAPTURE_AND_RETHROW() }
+
 } } // graphene::chain
@@ -25,6 +25,10 @@
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+
+#include <algorithm>
+#include <unordered_map>
 
 namespace graphene { namespace chain {
    class database;
@@ -46,16 +50,10 @@ namespace graphene { namespace chain {
 
          account_id_type  owner;
 
-         string           name; ///< redundantly store account name here for better maintenance performance
+         interned_string  name; ///< redundantly store account name here for better maintenance performance
 
-         /**
-          * Keep the most recent operation as a root pointer to a linked list of the transaction history.
-          */
-         account_transaction_history_id_type most_recent_op;
-         /** Total operations related to this account. */
-         uint64_t                            total_ops = 0;
-         /** Total operations related to this account that has been removed from the database. */
-         uint64_t                            removed_ops = 0;
+         // The members read by the maintenance and changed by most operations come first, in adjacent memory. The
+         // serialized order is that of the reflection and does not depend on the order of declaration.
 
          /**
           * When calculating votes it is necessary to know how much is stored in orders (and thus unavailable for
@@ -66,23 +64,6 @@ namespace graphene { namespace chain {
 
          share_type core_in_balance = 0; ///< redundantly store core balance here for better maintenance performance
 
-         bool has_cashback_vb = false; ///< redundantly store this for better maintenance performance
-
-         bool is_voting = false; ///< redundately store whether this account is voting for better maintenance performance
-
-         time_point_sec last_vote_time; // add last time voted
-
-         /// Whether this account owns some CORE asset and is voting
-         inline bool has_some_core_voting() const
-         {
-            return is_voting && ( total_core_in_orders > 0 || core_in_balance > 0 || has_cashback_vb );
-         }
-
-         /**
-          * Tracks the total fees paid by this account for the purpose of calculating bulk discounts.
-          */
-         share_type lifetime_fees_paid;
-
          /**
           * Tracks the fees paid by this account which have not been disseminated to the various parties that receive
           * them yet (registrar, referrer, lifetime referrer, network, etc). This is used as an optimization to avoid
@@ -98,6 +79,32 @@ namespace graphene { namespace chain {
           */
          share_type pending_vested_fees;
 
+         bool has_cashback_vb = false; ///< redundantly store this for better maintenance performance
+
+         bool is_voting = false; ///< redundately store whether this account is voting for better maintenance performance
+
+         time_point_sec last_vote_time; // add last time voted
+
+         /**
+          * Keep the most recent operation as a root pointer to a linked list of the transaction history.
+          */
+         account_transaction_history_id_type most_recent_op;
+         /** Total operations related to this account. */
+         uint64_t                            total_ops = 0;
+         /** Total operations related to this account that has been removed from the database. */
+         uint64_t                            removed_ops = 0;
+
+         /**
+          * Tracks the total fees paid by this account for the purpose of calculating bulk discounts.
+          */
+         share_type lifetime_fees_paid;
+
+         /// Whether this account owns some CORE asset and is voting
+         inline bool has_some_core_voting() const
+         {
+            return is_voting && ( total_core_in_orders > 0 || core_in_balance > 0 || has_cashback_vb );
+         }
+
          /// Whether this account has pending fees, no matter vested or not
          inline bool has_pending_fees() const { return pending_fees > 0 || pending_vested_fees > 0; }
 
@@ -176,7 +183,7 @@ namespace graphene { namespace chain {
          uint16_t referrer_rewards_percentage = 0;
 
          /// The account's name. This name must be unique among all account names on the graph. May not be empty.
-         string name;
+         interned_string name;
 
          /**
           * The owner authority represents absolute control over the account. Usually the keys in this authority will
@@ -295,27 +302,45 @@ namespace graphene { namespace chain {
    class account_member_index : public secondary_index
    {
       public:
+         struct account_id_hash
+         {
+            size_t operator()( const account_id_type& id )const { return std::hash<uint64_t>()( id.instance.value ); }
+         };
+
          virtual void object_inserted( const object& obj ) override;
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
+         virtual bool is_self_contained()const override { return true; }
 
-
-         /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
-         map< account_id_type, set<account_id_type> >                    account_to_account_memberships;
-         map< public_key_type, set<account_id_type>, pubkey_comparator > account_to_key_memberships;
+         /**
+          * given an account or key, map it to the accounts that reference it in an active or owner authority, or as
+          * memo key; keys without such accounts are removed
+          */
+         std::unordered_map< account_id_type, flat_set<account_id_type>, account_id_hash > account_to_account_memberships;
+         std::unordered_map< public_key_type, flat_set<account_id_type>, pubkey_hash >     account_to_key_memberships;
          /** some accounts use address authorities in the genesis block */
-         map< address, set<account_id_type> >                            account_to_address_memberships;
+         std::unordered_map< address, flat_set<account_id_type> >                          account_to_address_memberships;
 
 
       protected:
-         set<account_id_type>                    get_account_members( const account_object& a )const;
-         set<public_key_type, pubkey_comparator> get_key_members( const account_object& a )const;
-         set<address>                            get_address_members( const account_object& a )const;
-
-         set<account_id_type>                    before_account_members;
-         set<public_key_type, pubkey_comparator> before_key_members;
-         set<address>                            before_address_members;
+         /** the members of an account, sorted and without duplicates; the vectors are reused to avoid allocations */
+         struct members
+         {
+            vector<account_id_type> accounts;
+            vector<public_key_type> keys;
+            vector<address>         addresses;
+
+            bool operator==( const members& other )const
+            {
+               return accounts == other.accounts && keys == other.keys && addresses == other.addresses;
+            }
+         };
+         void get_members( const account_object& a, members& result )const;
+
+         members before_members;
+         members after_members;
    };
 
 
@@ -323,6 +348,29 @@ namespace graphene { namespace chain {
     *  @brief This secondary index will allow a reverse lookup of all accounts that have been referred by
     *  a particular account.
     */
+   /**
+    *  @brief Counts the changes to the owner and active authorities of accounts
+    *
+    *  Results computed from authorities can be cached together with get_revision() and are current while it did not
+    *  change. Accounts created or removed, also by undoing a block, count as changes.
+    */
+   class account_authority_revision_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override { ++_revision; }
+         virtual void object_removed( const object& obj ) override { ++_revision; }
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual bool is_self_contained()const override { return true; }
+
+         uint64_t get_revision()const { return _revision; }
+
+      private:
+         uint64_t  _revision = 1;
+         authority _before_owner;
+         authority _before_active;
+   };
+
    class account_referrer_index : public secondary_index
    {
       public:
@@ -330,11 +378,96 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
 
          /** maps the referrer to the set of accounts that they have referred */
          map< account_id_type, set<account_id_type> > referred_by;
    };
 
+   /**
+    *  @brief This secondary index keeps the account names sorted for prefix scans and exact lookups by name
+    *
+    *  The names are held in sorted blocks of at most max_block_size entries. Each entry carries the first eight
+    *  characters of its name packed into an integer, and a copy of the last entry of every block is kept in one
+    *  contiguous vector, so a search mostly compares integers in adjacent memory instead of following tree nodes
+    *  to the characters of each name. Inserting or removing an account moves the entries of one block only.
+    *
+    *  Account names never change, so modifications are ignored.
+    */
+   class account_name_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
+         virtual bool is_self_contained()const override { return true; }
+
+         struct entry
+         {
+            uint64_t        prefix; ///< the first eight characters of name, big endian and zero padded
+            interned_string name;
+            account_id_type id;
+         };
+
+         /** @return the id of the account called name, if there is one */
+         optional<account_id_type> find( const string& name )const;
+
+         /**
+          *  Calls visit with every entry whose name is not less than lower_bound, in order of name, until visit
+          *  returns false. The index must not be modified while visiting.
+          */
+         template<typename Visitor>
+         void for_each_from( const string& lower_bound, Visitor&& visit )const
+         {
+            const key k( lower_bound );
+            const size_t first = find_block( k );
+            for( size_t b = first; b < blocks.size(); ++b )
+            {
+               const vector<entry>& block = blocks[b];
+               auto itr = b == first ? std::lower_bound( block.begin(), block.end(), k, entry_less() )
+                                     : block.begin();
+               for( ; itr != block.end(); ++itr )
+                  if( !visit( *itr ) )
+                     return;
+            }
+         }
+
+         size_t size()const { return _size; }
+
+         /** blocks that grow beyond this size are split in half */
+         static const size_t max_block_size = 512;
+
+      private:
+         struct key
+         {
+            explicit key( const string& n ) : prefix( pack_prefix( n ) ), name( n ) {}
+            uint64_t      prefix;
+            const string& name;
+         };
+         struct entry_less
+         {
+            bool operator()( const entry& a, const key& b )const
+            { return a.prefix != b.prefix ? a.prefix < b.prefix : a.name.str() < b.name; }
+            bool operator()( const key& a, const entry& b )const
+            { return a.prefix != b.prefix ? a.prefix < b.prefix : a.name < b.name.str(); }
+         };
+
+         static uint64_t pack_prefix( const string& name );
+         /** @return the first block whose last entry is not less than k, or blocks.size() if there is none */
+         size_t find_block( const key& k )const
+         {
+            return std::lower_bound( last_entries.begin(), last_entries.end(), k, entry_less() )
+                   - last_entries.begin();
+         }
+
+         vector< vector<entry> > blocks;
+         /** the last entry of each block */
+         vector< entry >         last_entries;
+         size_t                  _size = 0;
+   };
+
    /**
     *  @brief This secondary index will allow fast access to the balance objects
     *         that belonging to an account.
@@ -346,17 +479,103 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
+         virtual bool is_self_contained()const override { return true; }
 
-         const map< asset_id_type, const account_balance_object* >& get_account_balances( const account_id_type& acct )const;
-         const account_balance_object* get_account_balance( const account_id_type& acct, const asset_id_type& asset )const;
+         /** The balances of one account sorted by asset; inserting a balance invalidates iterators into it */
+         typedef flat_map< asset_id_type, const account_balance_object* > account_balances;
+
+         const account_balances& get_account_balances( const account_id_type& acct )const;
+         const account_balance_object* get_account_balance( const account_id_type& acct, const asset_id_type& asset )const
+         {
+            const uint64_t instance = acct.instance.value;
+            if( balances.size() <= (instance >> bits) ) return nullptr;
+            const account_balances& mine = balances[instance >> bits][instance & mask];
+            const auto itr = mine.find( asset );
+            return itr == mine.end() ? nullptr : itr->second;
+         }
 
       private:
          static const uint8_t  bits;
          static const uint64_t mask;
 
-         /** Maps each account to its balance objects */
-         vector< vector< map< asset_id_type, const account_balance_object* > > > balances;
-         std::stack< object_id_type > ids_being_modified;
+         /** Maps each account to its balance objects, in chunks of 2^bits accounts */
+         vector< vector< account_balances > > balances;
+   };
+
+   /**
+    *  @brief This secondary index ranks the holders of each asset by balance, for paging through them by position
+    *
+    *  The accounts with a non-zero balance of an asset are kept ordered by balance, the largest first, then by
+    *  account, in sorted blocks of at most max_block_size entries like account_name_index keeps the names. The
+    *  number of holders is kept per asset, and finding the holder at a position skips whole blocks by their size.
+    */
+   class asset_holder_rank_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
+         virtual bool is_self_contained()const override { return true; }
+
+         struct holder
+         {
+            share_type      balance;
+            account_id_type owner;
+         };
+
+         /** @return the number of accounts with a non-zero balance of asset */
+         size_t holder_count( asset_id_type asset )const
+         {
+            const auto itr = _assets.find( asset );
+            return itr == _assets.end() ? 0 : itr->second.size;
+         }
+
+         /**
+          *  Calls visit with the holders of asset from the one at position start on, the largest balance first, until
+          *  visit returns false. The index must not be modified while visiting.
+          */
+         template<typename Visitor>
+         void for_each_holder( asset_id_type asset, size_t start, Visitor&& visit )const
+         {
+            const auto itr = _assets.find( asset );
+            if( itr == _assets.end() ) return;
+            const vector< vector<holder> >& blocks = itr->second.blocks;
+            size_t b = 0;
+            for( ; b < blocks.size() && start >= blocks[b].size(); ++b )
+               start -= blocks[b].size();
+            for( ; b < blocks.size(); ++b, start = 0 )
+               for( auto h = blocks[b].begin() + start; h != blocks[b].end(); ++h )
+                  if( !visit( *h ) )
+                     return;
+         }
+
+         /** blocks that grow beyond this size are split in half */
+         static const size_t max_block_size = 512;
+
+      private:
+         struct holder_less
+         {
+            bool operator()( const holder& a, const holder& b )const
+            { return a.balance != b.balance ? a.balance > b.balance : a.owner < b.owner; }
+         };
+         struct ranked_holders
+         {
+            vector< vector<holder> > blocks;
+            /** the last entry of each block */
+            vector< holder >         last_entries;
+            size_t                   size = 0;
+         };
+
+         void add( asset_id_type asset, const holder& h );
+         void remove( asset_id_type asset, const holder& h );
+
+         flat_map< asset_id_type, ranked_holders > _assets;
+         /** the balance as it was before the current modification */
+         asset_id_type _before_asset;
+         holder        _before;
    };
 
    struct by_asset_balance;
@@ -392,6 +611,8 @@ namespace graphene { namespace chain {
    typedef generic_index<account_balance_object, account_balance_object_multi_index_type> account_balance_index;
 
    struct by_name{};
+   /// exact lookups by name in constant time, by_name serves the ordered scans
+   struct by_hashed_name{};
 
    /**
     * @ingroup object_index
@@ -400,7 +621,10 @@ namespace graphene { namespace chain {
       account_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         ordered_unique< tag<by_name>, member<account_object, string, &account_object::name> >
+         ordered_unique< tag<by_name>, member<account_object, interned_string, &account_object::name>,
+                         interned_string_less >,
+         hashed_unique< tag<by_hashed_name>, member<account_object, interned_string, &account_object::name>,
+                        interned_string_hash, interned_string_equal_to >
       >
    > account_multi_index_type;
 
@@ -410,7 +634,6 @@ namespace graphene { namespace chain {
    typedef generic_index<account_object, account_multi_index_type> account_index;
 
    struct by_owner;
-   struct by_maintenance_seq;
 
    /**
     * @ingroup object_index
@@ -420,14 +643,7 @@ namespace graphene { namespace chain {
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_owner>,
-                         member< account_statistics_object, account_id_type, &account_statistics_object::owner > >,
-         ordered_unique< tag<by_maintenance_seq>,
-            composite_key<
-               account_statistics_object,
-               const_mem_fun<account_statistics_object, bool, &account_statistics_object::need_maintenance>,
-               member<account_statistics_object, string, &account_statistics_object::name>
-            >
-         >
+                         member< account_statistics_object, account_id_type, &account_statistics_object::owner > >
       >
    > account_stats_multi_index_type;
 
@@ -436,8 +652,43 @@ namespace graphene { namespace chain {
     */
    typedef generic_index<account_statistics_object, account_stats_multi_index_type> account_stats_index;
 
+   /**
+    *  @brief This secondary index keeps the statistics that need_maintenance() in the order of their account names
+    *
+    *  It replaces an ordered index on need_maintenance() and the name, which was checked on every change of the
+    *  statistics, e.g. for the fee of every operation. This one only changes when need_maintenance() does, which
+    *  mostly happens on the first fee an account pays after a maintenance and when the maintenance pays it out.
+    */
+   class account_maintenance_index : public secondary_index
+   {
+      public:
+         typedef std::map< interned_string, const account_statistics_object*, interned_string_less > accounts_type;
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+         virtual uint64_t estimated_memory_usage()const override;
+         virtual bool is_self_contained()const override { return true; }
+
+         /** the statistics that need maintenance by account name, entries may be added and removed while iterating */
+         const accounts_type& accounts()const { return _accounts; }
+
+      private:
+         accounts_type _accounts;
+         /** whether the statistics being modified needed maintenance before */
+         bool          _needed_maintenance = false;
+   };
+
 }}
 
+namespace graphene { namespace db {
+   // owns strings, authorities and vote sets, a packed undo copy is much cheaper than a deep one
+   template<> struct is_packed_undo_type<graphene::chain::account_object> : std::true_type {};
+   // modified by nearly every transaction, the packed form keeps the undo history small
+   template<> struct is_packed_undo_type<graphene::chain::account_statistics_object> : std::true_type {};
+} }
+
 FC_REFLECT_DERIVED( graphene::chain::account_object,
                     (graphene::db::object),
                     (membership_expiration_date)(registrar)(referrer)(lifetime_referrer)
@@ -24,7 +24,9 @@
 #pragma once
 #include <graphene/chain/protocol/asset_ops.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/published_index.hpp>
 
 /**
  * @defgroup prediction_market Prediction Market
@@ -115,7 +117,7 @@ namespace graphene { namespace chain {
          { FC_ASSERT(amount.asset_id == id); return amount_to_pretty_string(amount.amount); }
 
          /// Ticker symbol for this asset, i.e. "USD"
-         string symbol;
+         interned_string symbol;
          /// Maximum number of digits after the decimal point (must be <= 12)
          uint8_t precision = 0;
          /// ID of the account which issued this asset.
@@ -277,26 +279,57 @@ namespace graphene { namespace chain {
    typedef generic_index<asset_bitasset_data_object, asset_bitasset_data_object_multi_index_type> asset_bitasset_data_index;
 
    struct by_symbol;
+   /// exact lookups by symbol in constant time, by_symbol serves the ordered scans
+   struct by_hashed_symbol;
    struct by_type;
    struct by_issuer;
    typedef multi_index_container<
       asset_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         ordered_unique< tag<by_symbol>, member<asset_object, string, &asset_object::symbol> >,
+         ordered_unique< tag<by_symbol>, member<asset_object, interned_string, &asset_object::symbol>,
+                         interned_string_less >,
          ordered_non_unique< tag<by_issuer>, member<asset_object, account_id_type, &asset_object::issuer > >,
          ordered_unique< tag<by_type>,
             composite_key< asset_object,
                 const_mem_fun<asset_object, bool, &asset_object::is_market_issued>,
                 member< object, object_id_type, &object::id >
             >
-         >
+         >,
+         hashed_unique< tag<by_hashed_symbol>, member<asset_object, interned_string, &asset_object::symbol>,
+                        interned_string_hash, interned_string_equal_to >
       >
    > asset_object_multi_index_type;
    typedef generic_index<asset_object, asset_object_multi_index_type> asset_index;
 
+   /** Groups assets by id, each group holds one asset */
+   struct asset_id_key
+   {
+      typedef asset_id_type result_type;
+      result_type operator()( const asset_object& a )const { return a.get_id(); }
+   };
+   /** Groups assets by symbol, each group holds one asset */
+   struct asset_symbol_key
+   {
+      typedef std::string result_type;
+      const result_type& operator()( const asset_object& a )const { return a.symbol.str(); }
+   };
+   struct asset_id_order
+   {
+      bool operator()( const asset_object& a, const asset_object& b )const { return a.id < b.id; }
+   };
+
+   /** The assets by id and by symbol for API readers on other threads, see published_index */
+   typedef published_index<asset_object, asset_id_key, asset_id_order>     published_asset_index;
+   typedef published_index<asset_object, asset_symbol_key, asset_id_order> published_asset_symbol_index;
+
 } } // graphene::chain
 
+namespace graphene { namespace db {
+   // holds one feed per feed producer
+   template<> struct is_packed_undo_type<graphene::chain::asset_bitasset_data_object> : std::true_type {};
+} }
+
 FC_REFLECT_DERIVED( graphene::chain::asset_dynamic_data_object, (graphene::db::object),
                     (current_supply)(confidential_supply)(accumulated_fees)(fee_pool) )
 
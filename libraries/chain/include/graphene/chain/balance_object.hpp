@@ -25,6 +25,8 @@
 
 #include <graphene/chain/vesting_balance_object.hpp>
 
+#include <array>
+
 namespace graphene { namespace chain {
 
    class balance_object : public abstract_object<balance_object>
@@ -48,6 +50,14 @@ namespace graphene { namespace chain {
          asset_id_type asset_type()const { return balance.asset_id; }
    };
 
+   /** @return the owner addresses of the balances key can claim, the forms balance_claim_evaluator accepts */
+   inline std::array<address, 5> balance_claim_addresses( const public_key_type& key )
+   {
+      return {{ address( key ),
+                address( pts_address( key, false, 56 ) ), address( pts_address( key, true, 56 ) ),
+                address( pts_address( key, false, 0 ) ), address( pts_address( key, true, 0 ) ) }};
+   }
+
    struct by_owner;
 
    /**
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   struct block_cache_stats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t size = 0;
+      uint64_t capacity = 0;
+   };
+
+   /**
+    *  @brief A bounded, thread-safe LRU cache of deserialized blocks of the current chain
+    *
+    *  Blocks are keyed by number, a lookup by id checks that the cached block at the number encoded in the id
+    *  has that id. The database fills the cache when blocks are applied and evicts blocks that are popped, so
+    *  a cached number always maps to the block currently on the chain.
+    */
+   class block_cache
+   {
+      public:
+         explicit block_cache( size_t capacity = 500 ) : _capacity( capacity ) {}
+
+         /** Changes the number of cached blocks, zero disables the cache */
+         void   set_capacity( size_t capacity );
+         size_t capacity()const;
+
+         void insert( const signed_block& b );
+         void insert( signed_block_ptr b );
+         void remove( uint32_t block_num );
+         void clear();
+
+         /** @return the cached block or nullptr, counts a hit or a miss */
+         signed_block_ptr find( uint32_t block_num )const;
+         signed_block_ptr find( const block_id_type& id )const;
+         /**
+          *  @return the transaction merkle tree of the cached block with the given id, calculated on the first
+          *  call and kept with the block, nullptr if the block is not cached
+          */
+         std::shared_ptr<const merkle_tree_levels> find_merkle_tree( const block_id_type& id )const;
+
+         block_cache_stats get_stats()const;
+
+      private:
+         struct cached_block
+         {
+            block_id_type                       id;
+            signed_block_ptr block;
+            mutable std::shared_ptr<const merkle_tree_levels> merkle_tree;
+         };
+         typedef std::list< cached_block > lru_list;
+
+         /** @pre _mutex is locked */
+         const cached_block* lookup( uint32_t block_num )const;
+         void shrink();
+
+         mutable std::mutex                                      _mutex;
+         size_t                                                  _capacity;
+         /** most recently used first */
+         mutable lru_list                                        _lru;
+         std::unordered_map< uint32_t, lru_list::iterator >      _by_num;
+         mutable std::atomic<uint64_t>                           _hits{ 0 };
+         mutable std::atomic<uint64_t>                           _misses{ 0 };
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::block_cache_stats, (hits)(misses)(size)(capacity) )
@@ -22,35 +22,226 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <graphene/chain/protocol/block.hpp>
 
 namespace graphene { namespace chain {
    struct index_entry;
+   class block_file_view;
 
-   class block_database 
+   /**
+    *  Stores blocks in append-only files with a fixed-size index entry per block number.
+    *
+    *  Two storage formats exist. The legacy format appends raw packed blocks to a single "blocks" file. The
+    *  segmented format compresses every block with deflate and appends it to segment files "blocks.000000",
+    *  "blocks.000001", ... of a fixed maximum size each. Both share the same index, in the segmented
+    *  format block positions count across segments, with segment n starting at n times the segment size.
+    *  A segmented database can be pruned, which deletes whole segments of old blocks.
+    *
+    *  Writes (open, store, remove, close) must come from a single thread. Lookups read the files through
+    *  read-only memory mappings and may be called from any number of threads concurrently.
+    *
+    *  A database opened with open_read_only() follows the files of a database another process writes to, see
+    *  refresh(). It can not be changed.
+    *
+    *  With write-behind enabled, store and remove only queue the change for a background thread and return
+    *  right away. Lookups see queued changes as if they were written already. wait_for_writes() is the
+    *  durability fence, flush() and close() imply it. A failed background write is fatal: the writes queued
+    *  after it are not done and all further changes are refused with its error, see check_writes().
+    */
+   class block_database
    {
       public:
-         void open( const fc::path& dbdir );
+         /** maximum size of one segment file in new segmented databases */
+         static const uint64_t default_segment_size = 1ULL << 30;
+
+         ~block_database();
+
+         /**
+          *  Opens the block database in dbdir. The format of existing data is detected, a new database is
+          *  created in the segmented format with segments of segment_size bytes if segmented is true and in
+          *  the legacy format otherwise.
+          */
+         void open( const fc::path& dbdir, bool segmented = false, uint64_t segment_size = default_segment_size );
+         /** Opens the existing block database in dbdir without writing to it, e.g. one another node writes to */
+         void open_read_only( const fc::path& dbdir );
+         bool is_read_only()const { return _read_only; }
+         /**
+          *  Makes the blocks another process appended to a read-only database visible to lookups.
+          *  @return true if the files changed since the last refresh
+          */
+         bool refresh();
          bool is_open()const;
+         /** waits for all queued writes and flushes the files */
          void flush();
          void close();
 
+         /** moves writes to a background thread, see the class description */
+         void enable_write_behind();
+         bool write_behind_enabled()const { return _writer.joinable(); }
+         /**
+          *  Blocks until all queued writes of blocks up to block_num are in the files. Throws the error of a
+          *  failed background write instead.
+          */
+         void wait_for_writes( uint32_t block_num = std::numeric_limits<uint32_t>::max() )const;
+         /** Throws the error of a failed background write, which names the block that could not be written */
+         void check_writes()const;
+
+         /** @return true if the database uses the segmented, compressed format */
+         bool is_segmented()const { return _segmented; }
+
+         /** @return true if dbdir contains a database in the legacy format */
+         static bool has_legacy_format( const fc::path& dbdir );
+         /**
+          *  Rewrites the legacy database in dbdir into the segmented format. The database must not be open
+          *  while this runs, and the directory needs room for a temporary copy of the converted blocks.
+          */
+         static void convert_to_segmented( const fc::path& dbdir );
+         /** @return true if the database in dbdir was pruned and lacks old blocks */
+         static bool is_pruned( const fc::path& dbdir );
+
+         /**
+          *  Deletes all segments that only contain blocks older than first_kept_block. Blocks before it are no
+          *  longer returned even if their segment is kept. Only segmented databases can be pruned.
+          *  @param dry_run only check whether segments would be deleted
+          *  @return true if segments were (or would be) deleted
+          */
+         bool prune( uint32_t first_kept_block, bool dry_run = false );
+         /**
+          *  Checks the index entries from first_block_num on against the blocks files, in parallel chunks on
+          *  thread_count threads (0 for one per core). An entry is valid if its block lies within the files and its
+          *  header hashes to the recorded id. The index is truncated before the first invalid or empty entry, which
+          *  is where a replay would stop anyway.
+          *  @return the number of the last block that was kept, 0 if none
+          */
+         uint32_t verify_and_repair( uint32_t first_block_num, uint32_t thread_count = 0 );
+         /**
+          *  Appends the blocks of source that follow the last block of this database. They are read in windows of
+          *  consecutive blocks, each window is unpacked and its ids and transaction merkle roots are checked on
+          *  thread_count threads (0 for one per core), then the window is stored in order. The import stops before
+          *  the first block that fails a check or does not link to the block before it.
+          *  @return the number of the last block of this database afterwards, 0 if it is empty
+          */
+         uint32_t import_from( const block_database& source, uint32_t thread_count = 0 );
+         /**
+          *  Makes an empty segmented database start at first_block_num, as if the blocks before it had been pruned.
+          *  Used for nodes that start from a state snapshot instead of genesis.
+          */
+         void start_at( uint32_t first_block_num );
+         /** @return the lowest block number that may be available, 1 unless the database was pruned */
+         uint32_t first_block_num()const { return _first_block_num; }
+
          void store( const block_id_type& id, const signed_block& b );
+         /** like store(), write-behind keeps the pointer instead of a copy */
+         void store( const block_id_type& id, const signed_block_ptr& b );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /** like fetch_by_number(), but only the header is unpacked, see packed_block */
+         optional<packed_block> fetch_packed_by_number( uint32_t block_num )const;
+         /**
+          *  @return the block exactly as fc::raw::pack() serializes it, without unpacking it first
+          */
+         optional<vector<char>> fetch_raw( const block_id_type& id )const;
+         /**
+          *  @return the packed blocks first_block_num, first_block_num + 1, ... up to count blocks, ending early at
+          *  the first block that is not available
+          */
+         vector<vector<char>>   fetch_raw_range( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+         /** @return the position after the most recently read block, useful to report progress */
          size_t                 blocks_current_position()const;
+         /** @return the position after the last stored block */
          size_t                 total_block_size()const;
       private:
+         struct pending_write
+         {
+            uint64_t                            sequence = 0;
+            block_id_type                       id;
+            /** the block to store, nullptr to remove it */
+            std::shared_ptr<const signed_block> block;
+         };
+         /** at most this many writes are queued before store() waits for the background thread */
+         static const size_t max_pending_writes = 10000;
+
+         void store_now( const block_id_type& id, const signed_block& b );
+         void remove_now( const block_id_type& id );
+         void enqueue_write( pending_write w );
+         void write_loop();
+         void stop_writer();
+         /** @return true and the most recent queued write of block_num, if there is one */
+         bool find_pending( uint32_t block_num, pending_write& w )const;
+
          optional<index_entry> last_index_entry()const;
+         /** @return false if there is no entry for block_num */
+         bool read_index_entry( uint32_t block_num, index_entry& e )const;
+         /**
+          *  @return the stored, possibly compressed bytes of the block described by e, throws if they are not
+          *  available. view is set to the mapping that keeps them alive.
+          */
+         const char* locate_block( const index_entry& e, std::shared_ptr<const block_file_view>& view )const;
+         /** @return the block described by e, throws if it can not be read */
+         signed_block read_block( const index_entry& e )const;
+         /** @return the packed block described by e, throws if it can not be read */
+         vector<char> read_raw_block( const index_entry& e )const;
+         /** @return true if the index entry of block_num describes a readable block with the recorded id */
+         bool check_index_entry( uint32_t block_num )const;
+         /** drops the index entries of block_num and all later blocks */
+         void truncate_index( uint32_t block_num )const;
+         /** @return a mapping that covers the given sizes, remapping the files if necessary */
+         std::shared_ptr<const block_file_view> get_view( uint64_t index_size, uint64_t blocks_size )const;
+         /** flushes both files and publishes their sizes to readers */
+         void update_file_sizes()const;
+         fc::path segment_filename( uint64_t segment )const;
+         void open_segment( uint64_t segment, bool create );
+         void save_info()const;
+
+         fc::path _dbdir;
          fc::path _index_filename;
+         bool     _segmented = false;
+         bool     _read_only = false;
+         /** bytes per segment, unlimited in the legacy format which has a single segment */
+         uint64_t _segment_limit = 0;
+         std::atomic<uint64_t> _current_segment{ 0 };
+         /** lowest segment that was not pruned */
+         std::atomic<uint64_t> _first_segment{ 0 };
+         std::atomic<uint32_t> _first_block_num{ 1 };
          mutable std::fstream _blocks;
          mutable std::fstream _block_num_to_pos;
+         /** scratch space of store_now, only touched by the thread that writes */
+         vector<char>         _pack_buffer;
+         vector<char>         _compress_buffer;
+
+         /** size of the flushed index and end position of the flushed blocks, readers never look beyond these */
+         mutable std::atomic<uint64_t>                   _index_size{ 0 };
+         mutable std::atomic<uint64_t>                   _blocks_size{ 0 };
+         mutable std::atomic<uint64_t>                   _last_read_end{ 0 };
+         mutable std::mutex                              _view_mutex;
+         mutable std::shared_ptr<const block_file_view>  _view;
+
+         /** guards the write queue, _pending_by_num and _write_error */
+         mutable std::mutex                              _write_mutex;
+         /** signalled whenever a write is queued or finished */
+         mutable std::condition_variable                 _write_cv;
+         std::deque<pending_write>                       _write_queue;
+         /** most recent queued write per block number */
+         std::map<uint32_t, pending_write>               _pending_by_num;
+         uint64_t                                        _next_write_sequence = 0;
+         bool                                            _stop_writer = false;
+         /** the error of the first failed background write, kept until the database is closed */
+         optional<fc::exception>                         _write_error;
+         std::thread                                     _writer;
    };
 } }
@@ -22,7 +22,7 @@
  * THE SOFTWARE.
  */
 #pragma once
-#include <graphene/db/object.hpp>
+#include <graphene/db/index.hpp>
 
 namespace graphene { namespace chain {
    using namespace graphene::db;
@@ -45,6 +45,103 @@ namespace graphene { namespace chain {
          block_id_type      block_id;
    };
 
+   /**
+    *  @brief Stores the block summaries in one array indexed by block number modulo 0x10000
+    *
+    *  The summaries are created once at genesis and then only modified, one per block, so they are kept by value in
+    *  storage that is allocated up front and never moves. Looking up the summary a transaction refers to for TaPoS is
+    *  a single array access, and an undo assigns the saved summary back in place.
+    *  Summaries can only be created in order and removed from the end.
+    */
+   class block_summary_index : public index
+   {
+      public:
+         typedef block_summary_object object_type;
+
+         /** summaries 0 to 0x10000 are created at genesis */
+         static const size_t capacity = 0x10001;
+
+         block_summary_index() { _objects.reserve( capacity ); }
+
+         virtual const object& create( const std::function<void(object&)>& constructor ) override
+         {
+            const object_id_type id = get_next_id();
+            FC_ASSERT( id.instance() == _objects.size() && _objects.size() < capacity );
+            _objects.emplace_back();
+            block_summary_object& obj = _objects.back();
+            obj.id = id;
+            constructor( obj );
+            obj.id = id; // just in case it changed
+            use_next_id();
+            return obj;
+         }
+
+         virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         {
+            assert( obj.id.instance() < _objects.size() );
+            modify_callback( _objects[obj.id.instance()] );
+         }
+
+         virtual const object& insert( object&& obj ) override
+         {
+            assert( nullptr != dynamic_cast<block_summary_object*>(&obj) );
+            FC_ASSERT( obj.id.instance() == _objects.size() && _objects.size() < capacity,
+                       "block summaries must be inserted in order" );
+            _objects.emplace_back( std::move( static_cast<block_summary_object&>(obj) ) );
+            return _objects.back();
+         }
+
+         virtual void remove( const object& obj ) override
+         {
+            assert( nullptr != dynamic_cast<const block_summary_object*>(&obj) );
+            FC_ASSERT( obj.id.instance() + 1 == _objects.size(), "only the last block summary can be removed" );
+            _objects.pop_back();
+         }
+
+         virtual const object* find( object_id_type id )const override
+         {
+            assert( id.space() == block_summary_object::space_id );
+            assert( id.type() == block_summary_object::type_id );
+            const auto instance = id.instance();
+            return instance < _objects.size() ? &_objects[instance] : nullptr;
+         }
+
+         /** @return the summary of the block whose number is block_num modulo 0x10000, which must exist */
+         const block_summary_object& at( uint16_t block_num )const
+         {
+            assert( block_num < _objects.size() );
+            return _objects[block_num];
+         }
+         size_t size()const { return _objects.size(); }
+
+         virtual uint64_t object_count()const override { return _objects.size(); }
+
+         virtual void inspect_all_objects( std::function<void (const object&)> inspector )const override
+         {
+            try {
+               for( const auto& obj : _objects )
+                  inspector( obj );
+            } FC_CAPTURE_AND_RETHROW()
+         }
+         virtual index_memory_usage get_memory_usage()const override
+         {
+            index_memory_usage usage = index::get_memory_usage();
+            usage.container_bytes = _objects.capacity() * sizeof( block_summary_object );
+            return usage;
+         }
+
+         virtual fc::uint128 hash()const override
+         {
+            fc::uint128 result;
+            for( const auto& obj : _objects )
+               result += obj.hash();
+            return result;
+         }
+
+      private:
+         vector< block_summary_object > _objects;
+   };
+
 } }
 
 FC_REFLECT_DERIVED( graphene::chain::block_summary_object, (graphene::db::object), (block_id) )
@@ -25,6 +25,7 @@
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/chain/vote_id_index.hpp>
 
 namespace graphene { namespace chain {
    using namespace graphene::db;
@@ -71,6 +72,7 @@ namespace graphene { namespace chain {
       >
    >;
    using committee_member_index = generic_index<committee_member_object, committee_member_multi_index_type>;
+   using committee_member_vote_id_index = vote_id_index<committee_member_object, &committee_member_object::vote_id>;
 } } // graphene::chain
 
 FC_REFLECT_DERIVED( graphene::chain::committee_member_object, (graphene::db::object),
@@ -22,22 +22,36 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <graphene/chain/chain_property_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/node_property_object.hpp>
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/fork_database.hpp>
+#include <graphene/chain/block_cache.hpp>
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/history_consumer.hpp>
+#include <graphene/chain/simulation.hpp>
+#include <graphene/chain/verification_pool.hpp>
+#include <graphene/chain/vote_tally_cache.hpp>
 #include <graphene/chain/evaluator.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/simple_index.hpp>
+#include <graphene/db/state_journal.hpp>
 #include <fc/signals.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/thread/mutex.hpp>
 
 #include <fc/log/logger.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <deque>
 #include <map>
 
 namespace graphene { namespace chain {
@@ -45,9 +59,53 @@ namespace graphene { namespace chain {
    using graphene::db::object;
    class op_evaluator;
    class transaction_evaluation_state;
+   class balances_by_account_index;
+   class block_summary_index;
+   class proposal_expiration_index;
+   class transaction_expiration_index;
+   class witness_confirmation_index;
 
    struct budget_record;
 
+   /**
+    * How many of the transactions applied since conflict analysis was enabled could have been evaluated in parallel.
+    * A transaction conflicts with an earlier one of its block if it reads or writes an object that one wrote, it
+    * would have to be evaluated again after the earlier one is committed.
+    */
+   struct transaction_conflict_stats
+   {
+      uint64_t blocks = 0;
+      uint64_t transactions = 0;
+      /// transactions that wrote to or read from an object written by an earlier transaction of their block
+      uint64_t conflicting = 0;
+      /// sum over all blocks of the longest chain of conflicting transactions, the rounds a parallel executor needs
+      uint64_t rounds = 0;
+   };
+
+   /**
+    * Time spent in the evaluators of one operation type, see database::enable_operation_timing(). The operations
+    * proposals execute are included in the times of the proposal operations too.
+    */
+   struct operation_timing
+   {
+      uint64_t count = 0;
+      uint64_t evaluate_ns = 0;
+      uint64_t max_evaluate_ns = 0;
+      uint64_t apply_ns = 0;
+      uint64_t max_apply_ns = 0;
+      /// objects created, modified or removed
+      uint64_t undo_records = 0;
+   };
+
+   /// Where the time of the last database::generate_block() went
+   struct block_generation_timing
+   {
+      /// applying or collecting the transactions, building and signing the header
+      fc::microseconds assemble;
+      /// pushing the signed block
+      fc::microseconds apply;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -109,6 +167,53 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /** The chain state at one block, packed in memory by capture_state_snapshot() */
+         struct captured_state_snapshot
+         {
+            uint32_t                             head_block_num = 0;
+            vector<char>                         header;
+            vector<object_database::packed_index> indexes;
+         };
+         /**
+          * @brief Write the complete chain state at the head block into a single binary file
+          * @param db_version the version string the database was opened with, see @ref open
+          */
+         void save_state_snapshot( const fc::path& file, const std::string& db_version )const;
+         /**
+          * @brief Pack the chain state at the head block in memory, the indexes in parallel
+          *
+          * Only this has to run while the state does not change, write_state_snapshot() can run on another thread
+          * while blocks are applied.
+          */
+         captured_state_snapshot capture_state_snapshot( const std::string& db_version )const;
+         /**
+          * @brief Write a captured snapshot to file, as save_state_snapshot() does
+          *
+          * Also writes file.manifest with the SHA256 of the file and of each index in it, which
+          * @ref install_state_snapshot checks when it is present.
+          */
+         static void write_state_snapshot( const captured_state_snapshot& snapshot, const fc::path& file );
+         /**
+          * @brief Prepare an empty data_dir so that the next @ref open starts from a state snapshot
+          *
+          * Installs the object database of the snapshot and a block database that starts at its head block, like a
+          * pruned one. The remaining blocks have to be synced from peers.
+          *
+          * @param chain_id the chain the snapshot must belong to
+          * @return the head block number of the snapshot
+          */
+         static uint32_t install_state_snapshot( const fc::path& snapshot, const fc::path& data_dir,
+                                                 const std::string& db_version, const chain_id_type& chain_id );
+         /**
+          * @brief Append the blocks of another node's block database to the one in data_dir before @ref open
+          *
+          * source is the blockchain directory of the other node or its block database directory. The blocks are
+          * checked as block_database::import_from() does, the next @ref open replays them.
+          *
+          * @return the number of the last block in data_dir afterwards
+          */
+         uint32_t import_blocks( const fc::path& source, const fc::path& data_dir, uint32_t thread_count = 0 );
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -120,7 +225,17 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
-         const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
+         optional<signed_block_header> fetch_block_header_by_number( uint32_t num )const;
+         /** packed blocks of the chain for serving peers, see block_database::fetch_raw_range() */
+         vector<vector<char>>       fetch_raw_blocks( uint32_t first_block_num, uint32_t count )const;
+         /** @return the packed block if it is in the block database, blocks only known on forks are not */
+         optional<vector<char>>     fetch_raw_block_by_id( const block_id_type& id )const;
+         /** Recently applied and fetched blocks, see block_cache */
+         block_cache&               get_block_cache()const { return _block_cache; }
+         signed_transaction         get_recent_transaction( const transaction_id_type& trx_id )const;
+         /** @return the pending transactions with the given ids, unset for those that are not pending */
+         vector< optional<precomputable_transaction> > find_pending_transactions(
+               const vector<transaction_id_type>& trx_ids )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
          /**
@@ -134,8 +249,10 @@ namespace graphene { namespace chain {
          bool before_last_checkpoint()const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /** pushes a shared block, the fork database, block cache and block database keep the pointer instead of copies */
+         bool push_block( const signed_block_ptr& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
-         bool _push_block( const signed_block& b );
+         bool _push_block( const signed_block_ptr& b );
          processed_transaction _push_transaction( const precomputable_transaction& trx );
 
          ///@throws fc::exception if the proposed transaction fails to apply.
@@ -155,6 +272,13 @@ namespace graphene { namespace chain {
 
          void pop_block();
          void clear_pending();
+         /** @return the pending transactions that made room for better paying ones, see set_pending_transaction_limits() */
+         flat_set<transaction_id_type> take_evicted_pending_transactions()
+         {
+            flat_set<transaction_id_type> result;
+            result.swap( _evicted_pending_tx );
+            return result;
+         }
 
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
@@ -166,8 +290,24 @@ namespace graphene { namespace chain {
           *  @return the op_id which can be used to set the result after it has finished being applied.
           */
          uint32_t  push_applied_operation( const operation& op );
+         /** moves op into the applied operations, virtual operations are built only to be pushed here */
+         uint32_t  push_applied_operation( operation&& op );
          void      set_applied_operation_result( uint32_t op_id, const operation_result& r );
          const vector<optional< operation_history_object > >& get_applied_operations()const;
+         /**
+          *  @return the accounts impacted by the operation at op_id in get_applied_operations(): the accounts of
+          *  its required authorities and of the authorities it requires, the accounts it impacts and the account
+          *  it created. The set is computed once when it is first asked for, so that every plugin indexing the
+          *  operation shares it.
+          */
+         const flat_set<account_id_type>& get_applied_operation_impacted_accounts( uint32_t op_id )const;
+         /**
+          *  Hands the operations of every applied block to consumer after the applied_block signal, on a thread of
+          *  its own during a replay, see history_consumer. Call it before open().
+          */
+         void add_history_consumer( const std::shared_ptr<history_consumer>& consumer );
+         /** @return the blocks each history consumer has yet to index, by name, zero outside of replays */
+         std::map< std::string, size_t > get_history_queue_depths()const;
 
          string to_pretty_string( const asset& a )const;
 
@@ -246,23 +386,26 @@ namespace graphene { namespace chain {
 
          //////////////////// db_getter.cpp ////////////////////
 
-         const chain_id_type&                   get_chain_id()const;
+         // The property objects are kept as pointers, which evaluators and the market code read thousands of times
+         // per block. The getters that only dereference them are inline.
+         const chain_id_type&                   get_chain_id()const { return _p_chain_property_obj->chain_id; }
          const asset_object&                    get_core_asset()const;
          const asset_dynamic_data_object&       get_core_dynamic_data()const;
-         const chain_property_object&           get_chain_properties()const;
-         const global_property_object&          get_global_properties()const;
-         const dynamic_global_property_object&  get_dynamic_global_properties()const;
+         const chain_property_object&           get_chain_properties()const { return *_p_chain_property_obj; }
+         const global_property_object&          get_global_properties()const { return *_p_global_prop_obj; }
+         const dynamic_global_property_object&  get_dynamic_global_properties()const { return *_p_dyn_global_prop_obj; }
          const node_property_object&            get_node_properties()const;
          const fee_schedule&                    current_fee_schedule()const;
          const account_statistics_object&       get_account_stats_by_owner( account_id_type owner )const;
          const witness_schedule_object&         get_witness_schedule_object()const;
 
-         time_point_sec   head_block_time()const;
-         uint32_t         head_block_num()const;
-         block_id_type    head_block_id()const;
+         time_point_sec   head_block_time()const { return _p_dyn_global_prop_obj->time; }
+         uint32_t         head_block_num()const { return _p_dyn_global_prop_obj->head_block_number; }
+         block_id_type    head_block_id()const { return _p_dyn_global_prop_obj->head_block_id; }
          witness_id_type  head_block_witness()const;
 
-         decltype( chain_parameters::block_interval ) block_interval( )const;
+         decltype( chain_parameters::block_interval ) block_interval( )const
+         { return _p_global_prop_obj->parameters.block_interval; }
 
          node_property_object& node_properties();
 
@@ -331,6 +474,12 @@ namespace graphene { namespace chain {
          void debug_dump();
          void apply_debug_updates();
          void debug_update( const fc::variant_object& update );
+         /**
+          * Applies the request to a copy-on-write fork of the current state, an undo session that is undone before
+          * returning, so the live chain only sees the simulation while it runs on the chain thread. Nothing is
+          * notified to the plugins or the history consumers.
+          */
+         simulation_result simulate( const simulation_request& request );
 
          //////////////////// db_market.cpp ////////////////////
 
@@ -401,6 +550,13 @@ namespace graphene { namespace chain {
           *  @return true if the transaction would validate
           */
          processed_transaction validate_transaction( const signed_transaction& trx );
+         /**
+          * Checks trx like _apply_transaction() and runs the evaluate step of its operations, but not the apply step.
+          * It needs no undo session and doesn't write, so it can run on API threads that hold the state lock for
+          * reading. Every operation is evaluated against the state before the transaction, so an operation that
+          * depends on what an earlier one of the transaction does may fail here though the transaction applies.
+          */
+         vector<dry_run_operation> dry_run_transaction( const signed_transaction& trx )const;
 
 
          /** when popping a block, the transactions that were removed get cached here so they
@@ -414,6 +570,79 @@ namespace graphene { namespace chain {
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
 
+         /// Enable or disable adding up the votes of many accounts on several threads during chain maintenance
+         inline void enable_parallel_vote_tally(bool enable)  { _parallel_vote_tally = enable; }
+
+         /**
+          * Keep the vote totals between maintenance intervals and only recount the accounts that changed. The totals
+          * are exactly those of a full tally, which is still done after a restart, a fork the totals cannot follow or
+          * a change of count_non_member_votes. Call it after the indexes are created.
+          */
+         void enable_incremental_vote_tally();
+
+         /**
+          * Selects the storage format of the block database, takes effect on the next open().
+          * @param segmented create new block databases in the compressed, segmented format
+          * @param convert_existing rewrite an existing legacy block database into the segmented format
+          */
+         inline void set_block_log_format( bool segmented, bool convert_existing )
+         {
+            _segmented_block_log = segmented;
+            _convert_block_log = convert_existing;
+         }
+
+         /**
+          * Keep only keep_blocks blocks before the last irreversible block in a segmented block database, 0 keeps
+          * all blocks. Old segments are only deleted up to a checkpoint of the object database at an irreversible
+          * block, which is saved in the background, so that replays can start from that checkpoint.
+          */
+         inline void set_block_pruning( uint32_t keep_blocks ) { _prune_keep_blocks = keep_blocks; }
+         /**
+          * Save the object database every blocks blocks during a replay, 0 to only save it close to the end. An
+          * interrupted replay resumes from the last saved block on the next open().
+          */
+         inline void set_replay_checkpoint_interval( uint32_t blocks ) { _replay_checkpoint_interval = blocks; }
+         /**
+          * Bounds the pending transactions. While max_bytes of them are pending, a new transaction is only accepted
+          * if it pays more fee per byte than pending ones whose size makes room for it, they are dropped when the
+          * next block arrives. With prioritize the block producer packs pending transactions by fee per byte
+          * instead of by arrival, keeping the order of the transactions of each fee payer.
+          * @param max_bytes packed size of the pending transactions, 0 for no limit
+          * @param max_per_account pending transactions with the same fee payer, 0 for no limit
+          */
+         inline void set_pending_transaction_limits( uint64_t max_bytes, uint32_t max_per_account, bool prioritize )
+         {
+            _pending_tx_max_bytes = max_bytes;
+            _pending_tx_max_per_account = max_per_account;
+            _pending_tx_prioritized = prioritize;
+         }
+         size_t   get_pending_transaction_count()const { return _pending_tx.size(); }
+         /** packed size of the pending transactions, as bounded by set_pending_transaction_limits() */
+         uint64_t get_pending_transaction_bytes()const { return _pending_tx_bytes; }
+         /**
+          * Record the objects each transaction of a block reads and writes and count how much of the block could be
+          * applied in parallel, see transaction_conflict_stats. Transactions are still applied one after the other.
+          */
+         inline void enable_transaction_conflict_analysis( bool enable ) { _analyze_trx_conflicts = enable; }
+         /**
+          * Keep the pending state ready to be packed into a block: the merkle digests of pending transactions are
+          * computed as they arrive, and generate_block() takes the pending transactions that fit into the block in
+          * the order they arrived with their results as they are, instead of applying them again.
+          */
+         inline void enable_block_pre_assembly( bool enable ) { _pre_assemble_blocks = enable; }
+         const block_generation_timing& get_last_generation_timing()const { return _last_generation_timing; }
+         const transaction_conflict_stats& get_transaction_conflict_stats()const { return _trx_conflict_stats; }
+         /** Measure how long the evaluators of each operation type take, enabling resets the measurements */
+         void enable_operation_timing( bool enable );
+         bool operation_timing_enabled()const { return _time_operations; }
+         void reset_operation_timing();
+         /** @return the measurements indexed by operation tag */
+         const vector<operation_timing>& get_operation_timing()const { return _operation_timing; }
+         /** @pre operation_timing_enabled() */
+         operation_timing& get_operation_timing( int64_t op_tag ) { return _operation_timing[ op_tag ]; }
+         /** @return the lowest block number that may be fetched from the block database */
+         uint32_t first_available_block_num()const { return _block_id_to_block.first_block_num(); }
+
          /** Precomputes digests, signatures and operation validations depending
           *  on skip flags. "Expensive" computations may be done in a parallel
           *  thread.
@@ -433,9 +662,59 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /**
+          * Reads the accounts, statistics, balances and order book sides that the transactions of block touch, so
+          * they are in memory and cache when the block is applied. Call it on the thread that changes the database,
+          * while it would wait anyway.
+          * @return the number of objects read
+          */
+         size_t prefetch_objects( const signed_block& block )const;
+         /** like prefetch_objects(), for the transactions the next produced block will most likely contain */
+         size_t prefetch_pending_objects()const;
+
+         /** Runs precompute_parallel() on the threads of pool instead of the shared task scheduler, nullptr resets */
+         void set_verification_pool( std::shared_ptr<verification_pool> pool ) { _verification_pool = std::move(pool); }
+
+         /**
+          * Lets other threads read the state between changes. When enabled, push_block(), push_transaction(),
+          * generate_block(), pop_block() and clear_pending() hold the state lock exclusively, so a reader holding
+          * lock_state_for_reading() never sees a half applied block or transaction. Enable it before readers start.
+          *
+          * Enabling it also installs the published indexes of the limit orders, the call orders and the assets, which
+          * readers can use without the state lock. They stay installed once enabled. Publishing costs every flush of
+          * the batched indexes, enable it after open() so that a replay does not publish.
+          */
+         void enable_concurrent_reads( bool enable );
+         bool concurrent_reads_enabled()const { return _concurrent_reads; }
+         /**
+          * The limit orders, the call orders and the assets as of the last pushed transaction or applied block,
+          * readable on any thread without the state lock. nullptr until concurrent reads were enabled.
+          */
+         const published_limit_order_index*  published_limit_orders()const { return _published_limit_orders; }
+         const published_asset_index*        published_assets()const { return _published_assets; }
+         const published_asset_symbol_index* published_asset_symbols()const { return _published_asset_symbols; }
+         const published_call_order_index*   published_call_orders()const { return _published_call_orders; }
+         /** Shared lock on the state for a reader on another thread, an unlocked lock if concurrent reads are off */
+         boost::shared_lock<boost::shared_mutex> lock_state_for_reading()const;
+
+         /**
+          * Records the changes of the blocks applied from now on in a state_journal in dir, so that
+          * get_objects_at_block() can answer for them. Call it after open(), it is closed by close().
+          */
+         void open_state_journal( const fc::path& dir );
+         const state_journal* get_state_journal()const { return _state_journal.get(); }
+         /** @return the given objects as of the end of block_num, null for those that did not exist then */
+         vector<fc::variant> get_objects_at_block( const vector<object_id_type>& ids, uint32_t block_num )const;
    private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         template<typename Trx>
+         size_t _prefetch_objects( const Trx* trx, const size_t count )const;
+         /** like precompute_parallel(), but does all the work on the calling thread */
+         void _precompute_block( const signed_block& block, const uint32_t skip )const;
+         /** computes the merkle digests of the transactions of block on the verification pool, if there is one */
+         void precompute_merkle_digests( const signed_block& block )const;
 
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
@@ -456,12 +735,36 @@ namespace graphene { namespace chain {
        public:
          // these were formerly private, but they have a fairly well-defined API, so let's make them public
          void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
-         processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
+         processed_transaction apply_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
 
       private:
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         /** applies the transactions of next_block and updates _trx_conflict_stats with their object access */
+         void                  apply_transactions_analyzing_conflicts( const signed_block& next_block, uint32_t skip );
+         /** deletes old block segments as configured with set_block_pruning() */
+         void                  prune_blocks( uint32_t skip );
+         /**
+          * packs the state of the last irreversible block, the reversible blocks are popped and applied again with
+          * skip, and starts writing it as the object database in the background
+          */
+         void                  save_prune_checkpoint( uint32_t skip );
+         /** waits for the checkpoint started by save_prune_checkpoint(), @return false if writing it failed */
+         bool                  finish_prune_checkpoint();
+         /** saves the reversible blocks of all forks, so that open() does not need peers to restore them */
+         void                  save_fork_db()const;
+         /** pushes the blocks saved by save_fork_db() back into the fork database */
+         void                  load_fork_db();
+         /** the result keeps what trx precomputed, so a pending transaction is validated only once */
+         processed_transaction _apply_transaction( const precomputable_transaction& trx );
+         /** the checks of _apply_transaction() before the operations are evaluated, which only read */
+         void                  check_transaction( const precomputable_transaction& trx, uint32_t skip )const;
+         /** moves _applied_ops to the history consumers */
+         void                  dispatch_applied_operations( const signed_block& block );
+         /** lets the history consumers index on their own threads until finish_history_replay() */
+         void                  start_history_replay();
+         /** waits until the history consumers caught up, rethrows what the first that failed threw */
+         void                  finish_history_replay();
          void                  _cancel_bids_and_revive_mpa( const asset_object& bitasset, const asset_bitasset_data_object& bad );
 
          ///Steps involved in applying a new block
@@ -482,6 +785,8 @@ namespace graphene { namespace chain {
          void clear_expired_transactions();
          void clear_expired_proposals();
          void clear_expired_orders();
+         /// settles the due force settlement orders of one asset, @p count is the number processed so far
+         void clear_expired_force_settlements( const asset_object& mia_object, uint32_t& count );
          void update_expired_feeds();
          void update_core_exchange_rates();
          void update_maintenance_flag( bool new_maintenance_flag );
@@ -504,14 +809,57 @@ namespace graphene { namespace chain {
          void process_bids( const asset_bitasset_data_object& bad );
          void process_bitassets();
 
+         void update_core_in_balances();
          template<class Type>
-         void perform_account_maintenance( Type tally_helper );
+         void perform_account_maintenance( Type& tally_helper );
+         void count_voting_stake( const account_object& acc_obj, const account_statistics_object& acc_stat,
+                                  const global_property_object& props, time_point_sec now );
+         void perform_incremental_account_maintenance( const global_property_object& props );
+         /// counts the accounts that changed in a block which does not start a maintenance interval
+         void prepare_vote_tally( const signed_block& next_block, const global_property_object& props );
+         bool can_reconcile_vote_tally( const signed_block& next_block, const global_property_object& props )const;
          ///@}
          ///@}
 
          vector< processed_transaction >        _pending_tx;
+         bool                                   _pre_assemble_blocks = false;
+         block_generation_timing                _last_generation_timing;
+         /**
+          * block space taken by _pending_tx, unset if the pending state is not the result of applying all of them,
+          * i.e. after pop_block()
+          */
+         optional<uint64_t>                     _pending_block_size;
+         /** block space taken by each of _pending_tx with the operation results it had when it was pushed */
+         vector<uint32_t>                       _pending_tx_block_sizes;
          fork_database                          _fork_db;
 
+         /** what the pending transaction limits look at, of a transaction in _pending_tx */
+         struct pending_tx_info
+         {
+            uint64_t        size = 0;
+            account_id_type fee_payer;
+            uint64_t        fee_per_kbyte = 0; ///< in the core asset
+         };
+         /**
+          * @return the info of trx, throws if the limits do not admit it
+          * @param evict receives the pending transactions to drop to make room for it
+          */
+         pending_tx_info check_pending_limits( const precomputable_transaction& trx,
+                                               vector<transaction_id_type>& evict )const;
+         /** _pending_tx in the order to pack them into a block */
+         vector< const processed_transaction* > pending_transactions_by_priority()const;
+
+         uint64_t                                         _pending_tx_max_bytes = 0;
+         uint32_t                                         _pending_tx_max_per_account = 0;
+         bool                                             _pending_tx_prioritized = false;
+         /** of the pending transactions that were not evicted */
+         std::map< transaction_id_type, pending_tx_info > _pending_tx_info;
+         uint64_t                                         _pending_tx_bytes = 0;
+         flat_map< account_id_type, uint32_t >            _pending_tx_per_account;
+         /** still applied to the pending state, dropped by the next pending_transactions_restorer */
+         flat_set< transaction_id_type >                  _evicted_pending_tx;
+         uint64_t                                         _evicted_pending_bytes = 0;
+
          /**
           *  Note: we can probably store blocks by block num rather than
           *  block id because after the undo window is past the block ID
@@ -522,6 +870,7 @@ namespace graphene { namespace chain {
           *  the fork tree relatively simple.
           */
          block_database   _block_id_to_block;
+         mutable block_cache _block_cache;
 
          /**
           * Contains the set of ops that are in the process of being applied from
@@ -529,7 +878,34 @@ namespace graphene { namespace chain {
           * order they occur and is cleared after the applied_block signal is
           * emited.
           */
+         /** cleared for every block but keeps its capacity, see dispatch_applied_operations() */
          vector<optional<operation_history_object> >  _applied_ops;
+         /** impacted accounts of _applied_ops, filled by get_applied_operation_impacted_accounts() */
+         mutable vector<optional<flat_set<account_id_type> > > _applied_ops_impacted;
+         /** the result of the simulate() call in progress, which gets the applied operations instead of the observers */
+         simulation_result*                            _simulation = nullptr;
+         /** moves _applied_ops to the simulation in progress */
+         void                                          collect_simulated_operations();
+         /** set when the simulation in progress has undone its fork */
+         fc::promise<void>::ptr                        _simulation_finished;
+         /**
+          * A simulated block may yield while it waits for work in the verification pool. The calls that change the
+          * state wait here, so that they do not run on top of the fork of the simulation.
+          */
+         void                                          wait_for_simulation()const;
+
+         vector< std::shared_ptr<history_consumer> > _history_consumers;
+         /** handed to the history consumers outside of replays, reused so that its buffers keep their capacity */
+         applied_block_operations                    _dispatched_ops;
+         /** a history consumer indexing on its own thread during a replay */
+         struct history_replay_stream
+         {
+            std::shared_ptr<history_consumer> consumer;
+            std::shared_ptr<fc::thread>       thread;
+            std::deque< fc::future<void> >    queued;
+         };
+         /** not empty between start_history_replay() and finish_history_replay() */
+         vector< history_replay_stream >              _history_replay_streams;
 
          uint32_t                          _current_block_num    = 0;
          uint16_t                          _current_trx_in_block = 0;
@@ -545,9 +921,69 @@ namespace graphene { namespace chain {
 
          node_property_object              _node_property_object;
 
+         /// the secondary index of the account balances, looked up once for get_balance() and adjust_balance()
+         const balances_by_account_index*  _balances_by_account = nullptr;
+         /// the block summaries, looked up once for the TaPoS check of every transaction
+         const block_summary_index*        _block_summaries = nullptr;
+         /// the proposals and the transactions of the duplicate check by expiration, advanced once per block
+         proposal_expiration_index*        _proposal_expirations = nullptr;
+         transaction_expiration_index*     _transaction_expirations = nullptr;
+         /// the confirmed block numbers of the active witnesses, sorted for update_last_irreversible_block()
+         witness_confirmation_index*       _witness_confirmations = nullptr;
+         /// installed by enable_concurrent_reads()
+         const published_limit_order_index*  _published_limit_orders = nullptr;
+         const published_asset_index*        _published_assets = nullptr;
+         const published_asset_symbol_index* _published_asset_symbols = nullptr;
+         const published_call_order_index*   _published_call_orders = nullptr;
+
          /// Whether to update votes of standby witnesses and committee members when performing chain maintenance.
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
+         /// Whether to tally votes in parallel shards, the results are the same either way
+         bool                              _parallel_vote_tally = true;
+         /// Vote totals kept between maintenance intervals, only set by enable_incremental_vote_tally()
+         std::unique_ptr<vote_tally_cache> _vote_tally_cache;
+
+         bool                              _segmented_block_log = false;
+         bool                              _convert_block_log = false;
+         uint32_t                          _prune_keep_blocks = 0;
+         /// writes the checkpoints of the object database that pruning relies on
+         std::shared_ptr<fc::thread>       _checkpoint_writer;
+         fc::future<void>                  _prune_checkpoint;
+         /// the block of the checkpoint being written
+         uint32_t                          _prune_checkpoint_block = 0;
+         /// the block of the last checkpoint that was written, the blocks after it are kept
+         uint32_t                          _last_prune_checkpoint = 0;
+         uint32_t                          _replay_checkpoint_interval = 1000000;
+         bool                              _analyze_trx_conflicts = false;
+         std::shared_ptr<verification_pool> _verification_pool;
+         std::unique_ptr<state_journal>    _state_journal;
+         /// Set by enable_concurrent_reads()
+         bool                              _concurrent_reads = false;
+         /// The fc task that holds _state_mutex for writing, nullptr for none
+         std::atomic<const void*>          _state_writer{ nullptr };
+         /// Nesting depth of state_write_guard, only used by _state_writer
+         uint32_t                          _state_write_depth = 0;
+         /// Other writing fibers wait here, they yield instead of blocking the thread of the writer
+         fc::mutex                         _state_writer_mutex;
+         mutable boost::shared_mutex       _state_mutex;
+
+         /**
+          * Holds _state_mutex exclusively while the outermost guarded call of a task that changes the state runs. The
+          * calls of the same task nest, e.g. push_block() within generate_block(), those of other tasks wait.
+          */
+         class state_write_guard
+         {
+            public:
+               explicit state_write_guard( database& db );
+               ~state_write_guard();
+            private:
+               database& _db;
+               bool      _locked = false;
+         };
+         transaction_conflict_stats        _trx_conflict_stats;
+         bool                              _time_operations = false;
+         vector<operation_timing>          _operation_timing;
 
          /**
           * Whether database is successfully opened or not.
@@ -595,3 +1031,6 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::operation_timing,
+            (count)(evaluate_ns)(max_evaluate_ns)(apply_ns)(max_apply_ns)(undo_records) )
@@ -69,7 +69,7 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ), _evicted( db.take_evicted_pending_transactions() )
    {
       _db.clear_pending();
    }
@@ -79,7 +79,7 @@ struct pending_transactions_restorer
       for( const auto& tx : _db._popped_tx )
       {
          try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
+            if( should_restore( tx ) ) {
                _db._push_transaction( tx );
             }
          } catch ( const fc::exception& ) { // ignore invalid transactions
@@ -90,7 +90,7 @@ struct pending_transactions_restorer
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
+            if( should_restore( tx ) ) {
                _db._push_transaction( tx );
             }
          }
@@ -100,8 +100,21 @@ struct pending_transactions_restorer
       }
    }
 
+   /**
+    * Transactions that the new head included or that expired with it are dropped without evaluating them, which
+    * would fail and capture the whole transaction in the exception.
+    */
+   bool should_restore( const precomputable_transaction& tx )const
+   {
+      if( _db.head_block_num() > 0 && tx.expiration < _db.head_block_time() )
+         return false;
+      return !_db.is_known_transaction( tx.id() ) && _evicted.find( tx.id() ) == _evicted.end();
+   }
+
    database& _db;
    std::vector< processed_transaction > _pending_transactions;
+   /** pending transactions that made room for better paying ones */
+   flat_set< transaction_id_type > _evicted;
 };
 
 /**
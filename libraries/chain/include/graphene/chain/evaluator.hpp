@@ -25,6 +25,7 @@
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/transaction_evaluation_state.hpp>
 #include <graphene/chain/protocol/operations.hpp>
+#include <graphene/db/apply_phase.hpp>
 
 namespace graphene { namespace chain {
 
@@ -97,6 +98,9 @@ namespace graphene { namespace chain {
 
       object_id_type get_relative_id( object_id_type rel_id )const;
 
+      /** @pre trx_state is set */
+      bool operation_timing_enabled()const;
+
       /**
        * pay_fee() for FBA subclass should simply call this method
        */
@@ -131,7 +135,7 @@ namespace graphene { namespace chain {
       virtual operation_result evaluate(transaction_evaluation_state& eval_state, const operation& op, bool apply = true) override
       {
          T eval;
-         return eval.start_evaluate(eval_state, op, apply);
+         return eval.start_evaluate_op(eval_state, op, apply);
       }
    };
 
@@ -143,13 +147,48 @@ namespace graphene { namespace chain {
 
       virtual operation_result evaluate(const operation& o) final override
       {
-         auto* eval = static_cast<DerivedEvaluator*>(this);
+         return evaluate_op( o, o.get<typename DerivedEvaluator::operation_type>() );
+      }
+
+      virtual operation_result apply(const operation& o) final override
+      {
+         return apply_op( o.get<typename DerivedEvaluator::operation_type>() );
+      }
+
+      /**
+       * Does what start_evaluate() does without the virtual calls to evaluate() and apply(), and without getting the
+       * operation out of the static_variant twice. Unless operation timing is enabled, which goes through
+       * start_evaluate().
+       */
+      operation_result start_evaluate_op(transaction_evaluation_state& eval_state, const operation& o, bool apply)
+      { try {
+         trx_state = &eval_state;
+         if( operation_timing_enabled() )
+            return start_evaluate( eval_state, o, apply );
          const auto& op = o.get<typename DerivedEvaluator::operation_type>();
+         operation_result result;
+         {
+            graphene::db::apply_phase_scope evaluating( graphene::db::apply_phase::evaluate, o.which() );
+            result = evaluate_op( o, op );
+         }
+         if( apply )
+         {
+            graphene::db::apply_phase_scope applying( graphene::db::apply_phase::apply, o.which() );
+            result = apply_op( op );
+         }
+         return result;
+      } FC_CAPTURE_AND_RETHROW() }
+
+   private:
+      /** o is op as an operation, the fee schedule takes it without copying op into another static_variant */
+      operation_result evaluate_op(const operation& o, const typename DerivedEvaluator::operation_type& op)
+      {
+         auto* eval = static_cast<DerivedEvaluator*>(this);
 
          prepare_fee(op.fee_payer(), op.fee);
          if( !trx_state->skip_fee_schedule_check )
          {
-            share_type required_fee = calculate_fee_for_operation(op);
+            share_type required_fee = calculate_fee_for_operation(o);
             GRAPHENE_ASSERT( core_fee_paid >= required_fee,
                        insufficient_fee,
                        "Insufficient Fee Paid",
@@ -159,10 +198,9 @@ namespace graphene { namespace chain {
          return eval->do_evaluate(op);
       }
 
-      virtual operation_result apply(const operation& o) final override
+      operation_result apply_op(const typename DerivedEvaluator::operation_type& op)
       {
          auto* eval = static_cast<DerivedEvaluator*>(this);
-         const auto& op = o.get<typename DerivedEvaluator::operation_type>();
 
          convert_fee();
          pay_fee();
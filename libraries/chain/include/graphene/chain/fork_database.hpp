@@ -37,15 +37,15 @@ namespace graphene { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( signed_block_ptr d )
+      :num(d->block_num()),id(d->id()),data( std::move(d) ){}
 
-      block_id_type previous_id()const { return data.previous; }
+      block_id_type previous_id()const { return data->previous; }
 
       weak_ptr< fork_item > prev;
       uint32_t              num;    // initialized in ctor
       block_id_type         id;
-      signed_block          data;
+      signed_block_ptr      data;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -76,11 +76,14 @@ namespace graphene { namespace chain {
          bool                             is_known_block(const block_id_type& id)const;
          shared_ptr<fork_item>            fetch_block(const block_id_type& id)const;
          vector<item_ptr>                 fetch_block_by_number(uint32_t n)const;
+         /** @return every block in the fork database, ordered by block number */
+         vector<signed_block_ptr>         fetch_all_blocks()const;
 
          /**
           *  @return the new head block ( the longest fork )
           */
          shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(const signed_block_ptr& b);
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
@@ -29,6 +29,7 @@
 
 #include <fc/crypto/sha256.hpp>
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -125,6 +126,23 @@ struct genesis_state_type {
    chain_id_type compute_chain_id() const;
 };
 
+/**
+ * Reads a genesis state from its JSON text, with the same result as converting the parsed document.
+ *
+ * The arrays of accounts, assets, balances and vesting balances are cut into their elements without building a
+ * variant of the whole document, and the elements are converted on the worker threads, so that the large genesis
+ * files of testnets forked from mainnet state load quickly. initial_chain_id is left to the caller.
+ */
+genesis_state_type read_genesis_state( const string& json, uint32_t max_depth = 20 );
+
+/**
+ * Writes a genesis state as JSON that read_genesis_state() reads back, without converting it to one variant.
+ *
+ * The array members are written one element per line, converted a thousand elements per worker thread at a time,
+ * so that writing a large genesis takes little more memory than the state itself.
+ */
+void write_genesis_state( const genesis_state_type& genesis, std::ostream& out, uint32_t max_depth = 20 );
+
 } } // namespace graphene::chain
 
 FC_REFLECT(graphene::chain::genesis_state_type::initial_account_type, (name)(owner_key)(active_key)(is_lifetime_member))
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/operation_history_object.hpp>
+
+namespace graphene { namespace chain {
+
+   /** The operations applied in a block and the accounts they impact, as handed to a history_consumer */
+   struct applied_block_operations
+   {
+      uint32_t                                        block_num = 0;
+      fc::time_point_sec                              timestamp;
+      uint32_t                                        last_irreversible_block_num = 0;
+      vector< optional< operation_history_object > >  operations;
+      /** the accounts impacted by operations[i], see database::get_applied_operation_impacted_accounts() */
+      vector< flat_set<account_id_type> >             impacted_accounts;
+   };
+
+   /**
+    *  @brief Indexes the operations of applied blocks into indexes of its own, see database::add_history_consumer()
+    *
+    *  index() is normally called on the chain thread right after the applied_block signal. During a replay, while
+    *  the undo history is off, it is called on a thread of the consumer's own instead, in block order and at most
+    *  max_queued_blocks() blocks behind the chain. It must then only use the indexes it owns and the data it is
+    *  given, the object database serializes its writes with those of the chain. begin_replay() and end_replay() are
+    *  called on the chain thread around such a stretch, end_replay() after index() caught up, so that the consumer
+    *  can bring chain objects it kept aside meanwhile up to date.
+    */
+   class history_consumer
+   {
+      public:
+         virtual ~history_consumer() {}
+
+         virtual std::string name()const = 0;
+         virtual void index( const applied_block_operations& block ) = 0;
+         virtual void begin_replay() {}
+         virtual void end_replay() {}
+         /** how far the consumer may fall behind the chain during a replay, before the chain waits for it */
+         virtual size_t max_queued_blocks()const { return 256; }
+   };
+
+} } // graphene::chain
@@ -27,6 +27,7 @@
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/published_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
@@ -97,11 +98,72 @@ typedef multi_index_container<
          >,
          composite_key_compare<std::less<account_id_type>, std::greater<price>, std::less<object_id_type>>
       >
-   >
+   >,
+   pooled_allocator<limit_order_object>
 > limit_order_multi_index_type;
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/** Groups limit orders by their market side, the pair (sell asset, receive asset) */
+struct limit_order_side_key
+{
+   typedef pair<asset_id_type,asset_id_type> result_type;
+   result_type operator()( const limit_order_object& o )const
+   { return std::make_pair( o.sell_price.base.asset_id, o.sell_price.quote.asset_id ); }
+};
+
+/** Orders the limit orders of a side like the by_price index, best price first */
+struct limit_order_price_order
+{
+   bool operator()( const limit_order_object& a, const limit_order_object& b )const
+   { return a.sell_price > b.sell_price || ( a.sell_price == b.sell_price && a.id < b.id ); }
+};
+
+/** The limit orders of every market side for API readers on other threads, see published_index */
+typedef published_index<limit_order_object, limit_order_side_key, limit_order_price_order> published_limit_order_index;
+
+/** The total of all limit orders that sell at one price */
+struct limit_order_price_level
+{
+   share_type for_sale;   ///< asset id is the sell asset of the side
+   share_type to_receive; ///< sum of the amounts each order receives when it is filled completely
+   uint32_t   order_count = 0;
+};
+
+/**
+ *  @brief Aggregates the limit orders of every market side into price levels
+ *
+ *  A side is the pair (sell asset, receive asset), its levels are ordered by price like the by_price index, best
+ *  first. The levels are updated with every change of an order, so that the depth of a market can be read without
+ *  visiting each order.
+ */
+class limit_order_depth_index : public secondary_index
+{
+   public:
+      typedef std::map< price, limit_order_price_level, std::greater<price> > price_levels;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after ) override;
+      virtual uint64_t estimated_memory_usage()const override;
+      virtual bool is_self_contained()const override { return true; }
+
+      /** @return the levels of the orders selling sell for receive, nullptr if there are none */
+      const price_levels* find_side( asset_id_type sell, asset_id_type receive )const;
+
+      /** @return what order receives when it is filled completely, as added to the to_receive of its level */
+      static share_type to_receive( const limit_order_object& order );
+
+   private:
+      void add( const limit_order_object& order );
+      void subtract( const limit_order_object& order );
+
+      map< pair<asset_id_type,asset_id_type>, price_levels > _sides;
+      /** the order as it was before the current modification */
+      limit_order_object                                       _before;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
@@ -120,7 +182,10 @@ class call_order_object : public abstract_object<call_order_object>
       asset amount_to_receive()const { return get_debt(); }
       asset_id_type debt_type()const { return call_price.quote.asset_id; }
       asset_id_type collateral_type()const { return call_price.base.asset_id; }
-      price collateralization()const { return get_collateral() / get_debt(); }
+      /// Key of the by_collateral index, built directly from the stored amounts since it is evaluated on every
+      /// comparison in that index; equal to get_collateral() / get_debt()
+      price collateralization()const
+      { return price{ asset( collateral, call_price.base.asset_id ), asset( debt, call_price.quote.asset_id ) }; }
 
       account_id_type  borrower;
       share_type       collateral;  ///< call_price.base.asset_id, access via get_collateral
@@ -208,7 +273,8 @@ typedef multi_index_container<
             member< object, object_id_type, &object::id >
          >
       >
-   >
+   >,
+   pooled_allocator<call_order_object>
 > call_order_multi_index_type;
 
 struct by_expiration;
@@ -258,6 +324,23 @@ typedef generic_index<call_order_object, call_order_multi_index_type>
 typedef generic_index<force_settlement_object, force_settlement_object_multi_index_type>   force_settlement_index;
 typedef generic_index<collateral_bid_object, collateral_bid_object_multi_index_type>       collateral_bid_index;
 
+/** Groups call orders by their debt asset */
+struct call_order_debt_key
+{
+   typedef asset_id_type result_type;
+   result_type operator()( const call_order_object& o )const { return o.debt_type(); }
+};
+
+/** Orders the call orders of a debt asset like the by_price index */
+struct call_order_price_order
+{
+   bool operator()( const call_order_object& a, const call_order_object& b )const
+   { return a.call_price < b.call_price || ( a.call_price == b.call_price && a.id < b.id ); }
+};
+
+/** The call orders of every debt asset for API readers on other threads, see published_index */
+typedef published_index<call_order_object, call_order_debt_key, call_order_price_order> published_call_order_index;
+
 } } // graphene::chain
 
 FC_REFLECT_DERIVED( graphene::chain::limit_order_object,
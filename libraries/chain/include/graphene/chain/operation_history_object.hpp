@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/dense_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
@@ -50,6 +51,7 @@ namespace graphene { namespace chain {
          static const uint8_t type_id  = operation_history_object_type;
 
          operation_history_object( const operation& o ):op(o){}
+         operation_history_object( operation&& o ):op(std::move(o)){}
          operation_history_object(){}
 
          operation         op;
@@ -94,6 +96,7 @@ namespace graphene { namespace chain {
          operation_history_id_type            operation_id;
          uint64_t                             sequence = 0; /// the operation position within the given account
          account_transaction_history_id_type  next;
+         int32_t                              operation_type = -1; /// which() of the operation, -1 if not known
 
          //std::pair<account_id_type,operation_history_id_type>  account_op()const  { return std::tie( account, operation_id ); }
          //std::pair<account_id_type,uint32_t>                   account_seq()const { return std::tie( account, sequence );     }
@@ -101,14 +104,10 @@ namespace graphene { namespace chain {
 
    struct by_id;
 
-   typedef multi_index_container<
-      operation_history_object,
-      indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >
-      >
-   > operation_history_multi_index_type;
-
-   typedef generic_index<operation_history_object, operation_history_multi_index_type> operation_history_index;
+   /**
+    * Operation history objects are created in sequence and only looked up by id.
+    */
+   typedef graphene::db::dense_index<operation_history_object> operation_history_index;
 
    struct by_seq;
    struct by_op;
@@ -145,4 +144,4 @@ FC_REFLECT_DERIVED( graphene::chain::operation_history_object, (graphene::chain:
                     (op)(result)(block_num)(trx_in_block)(op_in_trx)(virtual_op) )
 
 FC_REFLECT_DERIVED( graphene::chain::account_transaction_history_object, (graphene::chain::object),
-                    (account)(operation_id)(sequence)(next) )
+                    (account)(operation_id)(sequence)(next)(operation_type) )
@@ -26,9 +26,12 @@
 #include <graphene/chain/protocol/transaction.hpp>
 #include <graphene/chain/transaction_evaluation_state.hpp>
 
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
+#include <unordered_map>
+
 namespace graphene { namespace chain {
 
 
@@ -75,28 +78,56 @@ class required_approval_index : public secondary_index
       virtual void object_removed( const object& obj ) override;
       virtual void about_to_modify( const object& before ) override{};
       virtual void object_modified( const object& after  ) override{};
+      virtual bool is_self_contained()const override { return true; }
 
       void remove( account_id_type a, proposal_id_type p );
 
       map<account_id_type, set<proposal_id_type> > _account_to_proposals;
 };
 
+/**
+ *  @brief Remembers what proposal_object::is_authorized_to_execute() returned
+ *
+ *  A result stays valid until the proposal changes, the authority of an account changes or
+ *  max_authority_depth changes, so proposals that expire are not verified again if nothing they depend on
+ *  changed since their last approval. This is a secondary index on the proposal_index, it is not part of the
+ *  chain state and the results are kept in a mutable map.
+ */
+class proposal_authorization_cache : public secondary_index
+{
+   public:
+      virtual void object_removed( const object& obj ) override { _results.erase( obj.id ); }
+      virtual void object_modified( const object& after  ) override { _results.erase( after.id ); }
+
+      /** @return the result for proposal if it was stored with the same authority_revision and max_depth */
+      optional<bool> find( object_id_type proposal, uint64_t authority_revision, uint32_t max_depth )const;
+      void           store( object_id_type proposal, uint64_t authority_revision, uint32_t max_depth,
+                            bool authorized )const;
+
+   private:
+      struct cached_result
+      {
+         uint64_t authority_revision;
+         uint32_t max_depth;
+         bool     authorized;
+      };
+      mutable std::unordered_map< object_id_type, cached_result > _results;
+};
+
 struct by_expiration{};
 typedef boost::multi_index_container<
    proposal_object,
    indexed_by<
-      ordered_unique< tag< by_id >, member< object, object_id_type, &object::id > >,
-      //ordered_non_unique< tag< by_expiration >, member< proposal_object, time_point_sec, &proposal_object::expiration_time > >
-      ordered_unique<tag<by_expiration>,
-         composite_key<proposal_object,
-            member<proposal_object, time_point_sec, &proposal_object::expiration_time>,
-            member< object, object_id_type, &object::id >
-         >
-      >
+      ordered_unique< tag< by_id >, member< object, object_id_type, &object::id > >
    >
 > proposal_multi_index_container;
 typedef generic_index<proposal_object, proposal_multi_index_container> proposal_index;
 
+/** The proposals by expiration and id, see database::clear_expired_proposals() */
+class proposal_expiration_index
+   : public expiring_index< proposal_object, member< proposal_object, time_point_sec, &proposal_object::expiration_time > >
+{};
+
 } } // graphene::chain
 
 FC_REFLECT_DERIVED( graphene::chain::proposal_object, (graphene::chain::object),
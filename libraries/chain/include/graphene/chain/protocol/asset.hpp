@@ -25,6 +25,8 @@
 #include <graphene/chain/protocol/config.hpp>
 #include <graphene/chain/protocol/types.hpp>
 
+#include <cstring>
+
 namespace graphene { namespace chain {
 
    extern const int64_t scaled_precision_lut[];
@@ -143,6 +145,11 @@ namespace graphene { namespace chain {
    bool  operator <  ( const price& a, const price& b );
    bool  operator == ( const price& a, const price& b );
 
+   namespace detail {
+      /// Compares `a * b` with `c * d` without overflow, returns -1, 0 or 1. This is the core of price comparison.
+      int compare_products( int64_t a, int64_t b, int64_t c, int64_t d );
+   }
+
    inline bool  operator >  ( const price& a, const price& b ) { return (b < a); }
    inline bool  operator <= ( const price& a, const price& b ) { return !(b < a); }
    inline bool  operator >= ( const price& a, const price& b ) { return !(a < b); }
@@ -230,3 +237,65 @@ FC_REFLECT( graphene::chain::price, (base)(quote) )
    (core_exchange_rate)
 
 FC_REFLECT( graphene::chain::price_feed, GRAPHENE_PRICE_FEED_FIELDS )
+
+namespace graphene { namespace chain { namespace detail {
+
+   /** the packed asset is the raw amount followed by the varint instance of the asset id */
+   const size_t max_packed_asset_size = sizeof(int64_t) + 10;
+
+   /** writes the asset to out like the reflected serialization does, @return the number of bytes written */
+   inline size_t pack_asset( const asset& a, char* out )
+   {
+      memcpy( out, &a.amount.value, sizeof(a.amount.value) );
+      size_t size = sizeof(a.amount.value);
+      uint64_t instance = a.asset_id.instance.value;
+      do
+      {
+         uint8_t b = uint8_t(instance) & 0x7f;
+         instance >>= 7;
+         b |= uint8_t( instance > 0 ) << 7;
+         out[size++] = char(b);
+      } while( instance );
+      return size;
+   }
+
+} } } // graphene::chain::detail
+
+namespace fc { namespace raw {
+
+template< typename Stream >
+void pack( Stream& s, const graphene::chain::asset& a, uint32_t _max_depth )
+{
+   FC_ASSERT( _max_depth > 0 );
+   char buffer[graphene::chain::detail::max_packed_asset_size];
+   s.write( buffer, graphene::chain::detail::pack_asset( a, buffer ) );
+}
+
+template< typename Stream >
+void unpack( Stream& s, graphene::chain::asset& a, uint32_t _max_depth )
+{
+   FC_ASSERT( _max_depth > 0 );
+   s.read( (char*)&a.amount.value, sizeof(a.amount.value) );
+   fc::raw::unpack( s, a.asset_id.instance, _max_depth - 1 );
+}
+
+template< typename Stream >
+void pack( Stream& s, const graphene::chain::price& p, uint32_t _max_depth )
+{
+   FC_ASSERT( _max_depth > 0 );
+   char buffer[2 * graphene::chain::detail::max_packed_asset_size];
+   size_t size = graphene::chain::detail::pack_asset( p.base, buffer );
+   size += graphene::chain::detail::pack_asset( p.quote, buffer + size );
+   s.write( buffer, size );
+}
+
+template< typename Stream >
+void unpack( Stream& s, graphene::chain::price& p, uint32_t _max_depth )
+{
+   FC_ASSERT( _max_depth > 0 );
+   --_max_depth;
+   fc::raw::unpack( s, p.base, _max_depth );
+   fc::raw::unpack( s, p.quote, _max_depth );
+}
+
+} } // fc::raw
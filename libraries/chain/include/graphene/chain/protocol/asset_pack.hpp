@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/io/varint.hpp>
+
+#include <cstdint>
+
+namespace graphene { namespace chain {
+   struct asset;
+   struct price;
+} }
+
+/**
+ *  Hand-written serializers for asset and price, which appear in nearly every operation. They produce exactly
+ *  the bytes of the reflected serialization, but write a whole asset or price with a single stream write
+ *  instead of going through the member visitors field by field.
+ *
+ *  Like the extension serializers these must be declared before fc/io/raw.hpp, otherwise the serializers of
+ *  the containing types do not find them. The definitions are in asset.hpp.
+ */
+namespace fc { namespace raw {
+
+template< typename Stream >
+void pack( Stream& s, const graphene::chain::asset& a, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+template< typename Stream >
+void unpack( Stream& s, graphene::chain::asset& a, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+template< typename Stream >
+void pack( Stream& s, const graphene::chain::price& p, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+template< typename Stream >
+void unpack( Stream& s, graphene::chain::price& p, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+
+} } // fc::raw
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  Base58 encoding with the bitcoin alphabet, producing the same strings as fc::to_base58() and accepting the
+    *  same ones as fc::from_base58(). The number is converted in limbs of 32 bits, five digits at a time, instead
+    *  of digit by digit, which matters for the keys and addresses converted on every API call.
+    */
+   std::string to_base58( const char* data, size_t size );
+   /**
+    *  Leading and trailing whitespace is skipped like fc::from_base58() does.
+    *  @throws fc::parse_error_exception if the string contains other characters that are not base58 digits
+    */
+   std::vector<char> from_base58( const std::string& base58 );
+
+} } // graphene::chain
@@ -56,15 +56,65 @@ namespace graphene { namespace chain {
       mutable block_id_type       _block_id;
    };
 
+   /** The levels of a transaction merkle tree, from the digests of the transactions up to the single top node */
+   typedef vector< vector<digest_type> > merkle_tree_levels;
+
    class signed_block : public signed_block_header
    {
    public:
       const checksum_type& calculate_merkle_root()const;
+      /** @return the levels of the tree calculate_merkle_root() hashes, empty for a block without transactions */
+      merkle_tree_levels   calculate_merkle_tree()const;
       vector<processed_transaction> transactions;
    protected:
       mutable checksum_type   _calculated_merkle_root;
    };
 
+   /**
+    *  @return the siblings of the nodes on the path from transaction trx_in_block to the top of tree, bottom up;
+    *  levels where the node is the odd last one have no sibling
+    */
+   vector<digest_type> merkle_branch( const merkle_tree_levels& tree, uint32_t trx_in_block );
+   /**
+    *  @return the transaction_merkle_root of a block of trx_count transactions whose transaction trx_in_block has
+    *  the digest leaf and the given merkle_branch()
+    */
+   checksum_type merkle_root_from_branch( const digest_type& leaf, uint32_t trx_in_block, uint32_t trx_count,
+                                          const vector<digest_type>& branch );
+
+   /** blocks that were accepted are immutable, they are passed around by this pointer instead of being copied */
+   typedef std::shared_ptr<const signed_block> signed_block_ptr;
+
+   /**
+    *  A block in the form fc::raw::pack() serializes it. The header is unpacked right away, the transactions
+    *  with their operations and results only on first access. Code that only looks at the header avoids
+    *  decoding the whole block this way.
+    */
+   class packed_block
+   {
+   public:
+      /** throws if data does not start with a valid block header */
+      explicit packed_block( vector<char> data );
+      explicit packed_block( const signed_block& b );
+
+      const signed_block_header&           header()const { return _header; }
+      const block_id_type&                 id()const { return _header.id(); }
+      uint32_t                             block_num()const { return _header.block_num(); }
+      /** the packed transactions start at this position of data() */
+      size_t                               transactions_offset()const { return _transactions_offset; }
+      const vector<char>&                  data()const { return _data; }
+
+      /** @return the transactions, they are unpacked on the first call */
+      const vector<processed_transaction>& transactions()const;
+      /** @return the complete block, unpacking the transactions if that did not happen yet */
+      signed_block                         unpack()const;
+   private:
+      vector<char>                                    _data;
+      signed_block_header                             _header;
+      size_t                                          _transactions_offset = 0;
+      mutable optional<vector<processed_transaction>> _transactions;
+   };
+
 } } // graphene::chain
 
 FC_REFLECT( graphene::chain::block_header, (previous)(timestamp)(witness)(transaction_merkle_root)(extensions) )
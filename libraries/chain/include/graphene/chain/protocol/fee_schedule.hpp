@@ -34,14 +34,41 @@ namespace graphene { namespace chain {
    };
    typedef transform_to_fee_parameters<operation>::type fee_parameters;
 
+   /**
+    * @return the fee parameters of type T in parameters, or nullptr if there are none.
+    *
+    * parameters is sorted by type, so when it holds every type the parameters of an operation are at the index of
+    * its tag. This is the case for the fee schedules of the chain and makes the lookup constant time, other
+    * schedules are searched.
+    */
+   template<typename T>
+   const T* find_fee_parameters( const flat_set<fee_parameters>& parameters )
+   {
+      const int tag = fee_parameters::tag<T>::value;
+      if( size_t( tag ) < parameters.size() )
+      {
+         const fee_parameters& p = *( parameters.begin() + tag );
+         if( p.which() == tag )
+            return &p.get<T>();
+      }
+      auto itr = parameters.find( T() );
+      if( itr == parameters.end() )
+         return nullptr;
+      return &itr->get<T>();
+   }
+
    template<typename Operation>
    class fee_helper {
      public:
       const typename Operation::fee_parameters_type& cget(const flat_set<fee_parameters>& parameters)const
       {
-         auto itr = parameters.find( typename Operation::fee_parameters_type() );
-         FC_ASSERT( itr != parameters.end() );
-         return itr->template get<typename Operation::fee_parameters_type>();
+         const auto* p = find( parameters );
+         FC_ASSERT( p != nullptr );
+         return *p;
+      }
+      const typename Operation::fee_parameters_type* find(const flat_set<fee_parameters>& parameters)const
+      {
+         return find_fee_parameters<typename Operation::fee_parameters_type>( parameters );
       }
    };
 
@@ -50,9 +77,13 @@ namespace graphene { namespace chain {
      public:
       const account_create_operation::fee_parameters_type& cget(const flat_set<fee_parameters>& parameters)const
       {
-         auto itr = parameters.find( account_create_operation::fee_parameters_type() );
-         FC_ASSERT( itr != parameters.end() );
-         return itr->get<account_create_operation::fee_parameters_type>();
+         const auto* p = find( parameters );
+         FC_ASSERT( p != nullptr );
+         return *p;
+      }
+      const account_create_operation::fee_parameters_type* find(const flat_set<fee_parameters>& parameters)const
+      {
+         return find_fee_parameters<account_create_operation::fee_parameters_type>( parameters );
       }
       typename account_create_operation::fee_parameters_type& get(flat_set<fee_parameters>& parameters)const
       {
@@ -67,14 +98,18 @@ namespace graphene { namespace chain {
      public:
       const bid_collateral_operation::fee_parameters_type& cget(const flat_set<fee_parameters>& parameters)const
       {
-         auto itr = parameters.find( bid_collateral_operation::fee_parameters_type() );
-         if ( itr != parameters.end() )
-            return itr->get<bid_collateral_operation::fee_parameters_type>();
+         const auto* p = find_fee_parameters<bid_collateral_operation::fee_parameters_type>( parameters );
+         if ( p != nullptr )
+            return *p;
 
          static bid_collateral_operation::fee_parameters_type bid_collateral_dummy;
          bid_collateral_dummy.fee = fee_helper<call_order_update_operation>().cget(parameters).fee;
          return bid_collateral_dummy;
       }
+      const bid_collateral_operation::fee_parameters_type* find(const flat_set<fee_parameters>& parameters)const
+      {
+         return &cget( parameters );
+      }
    };
 
    template<>
@@ -82,14 +117,18 @@ namespace graphene { namespace chain {
      public:
       const asset_update_issuer_operation::fee_parameters_type& cget(const flat_set<fee_parameters>& parameters)const
       {
-         auto itr = parameters.find( asset_update_issuer_operation::fee_parameters_type() );
-         if ( itr != parameters.end() )
-            return itr->get<asset_update_issuer_operation::fee_parameters_type>();
+         const auto* p = find_fee_parameters<asset_update_issuer_operation::fee_parameters_type>( parameters );
+         if ( p != nullptr )
+            return *p;
 
          static asset_update_issuer_operation::fee_parameters_type dummy;
          dummy.fee = fee_helper<asset_update_operation>().cget(parameters).fee;
          return dummy;
       }
+      const asset_update_issuer_operation::fee_parameters_type* find(const flat_set<fee_parameters>& parameters)const
+      {
+         return &cget( parameters );
+      }
    };
 
    template<>
@@ -97,14 +136,18 @@ namespace graphene { namespace chain {
      public:
       const asset_claim_pool_operation::fee_parameters_type& cget(const flat_set<fee_parameters>& parameters)const
       {
-         auto itr = parameters.find( asset_claim_pool_operation::fee_parameters_type() );
-         if ( itr != parameters.end() )
-            return itr->get<asset_claim_pool_operation::fee_parameters_type>();
+         const auto* p = find_fee_parameters<asset_claim_pool_operation::fee_parameters_type>( parameters );
+         if ( p != nullptr )
+            return *p;
 
          static asset_claim_pool_operation::fee_parameters_type asset_claim_pool_dummy;
          asset_claim_pool_dummy.fee = fee_helper<asset_fund_fee_pool_operation>().cget(parameters).fee;
          return asset_claim_pool_dummy;
       }
+      const asset_claim_pool_operation::fee_parameters_type* find(const flat_set<fee_parameters>& parameters)const
+      {
+         return &cget( parameters );
+      }
    };
 
    /**
@@ -143,8 +186,7 @@ namespace graphene { namespace chain {
       template<typename Operation>
       const bool exists()const
       {
-         auto itr = parameters.find(typename Operation::fee_parameters_type());
-         return itr != parameters.end();
+         return find_fee_parameters<typename Operation::fee_parameters_type>( parameters ) != nullptr;
       }
 
       /**
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/address.hpp>
+#include <graphene/chain/protocol/types.hpp>
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief A bounded, thread-safe LRU cache of the string forms of public keys and addresses
+    *
+    *  The API converts the same keys to and from strings over and over, for every authority, account and memo it
+    *  returns or receives, and each conversion hashes a checksum and converts base58. public_key_type and address
+    *  look their strings up in the process-wide instance(). Strings that fail to convert are not cached.
+    */
+   class key_string_cache
+   {
+      public:
+         explicit key_string_cache( size_t capacity = 20000 ) : _capacity( capacity ) {}
+
+         static key_string_cache& instance();
+
+         /** Changes the number of strings cached in each direction, zero disables the cache */
+         void   set_capacity( size_t capacity );
+         size_t capacity()const;
+         void   clear();
+
+         /** @return the string of key, calling encode() and caching its result if the key is not cached */
+         template< typename Encode >
+         std::string key_to_string( const fc::ecc::public_key_data& key, Encode encode )
+         {
+            return lookup( _key_strings, key, encode );
+         }
+         /** @return the key of str, calling decode() and caching its result if the string is not cached */
+         template< typename Decode >
+         fc::ecc::public_key_data key_from_string( const std::string& str, Decode decode )
+         {
+            return lookup( _string_keys, str, decode );
+         }
+         /** @return the string of addr, calling encode() and caching its result if the address is not cached */
+         template< typename Encode >
+         std::string address_to_string( const address& addr, Encode encode )
+         {
+            return lookup( _address_strings, addr, encode );
+         }
+
+      private:
+         template< typename Key, typename Value, typename Hash >
+         struct lru_map
+         {
+            typedef std::list< std::pair<Key,Value> > lru_list;
+            /** most recently used first */
+            lru_list                                                    lru;
+            std::unordered_map< Key, typename lru_list::iterator, Hash > index;
+
+            void shrink( size_t capacity )
+            {
+               while( lru.size() > capacity )
+               {
+                  index.erase( lru.back().first );
+                  lru.pop_back();
+               }
+            }
+            void clear()
+            {
+               lru.clear();
+               index.clear();
+            }
+         };
+         struct key_hash
+         {
+            size_t operator()( const fc::ecc::public_key_data& k )const
+            {
+               // the first byte is the parity of y, the x coordinate that follows is uniformly distributed
+               size_t h;
+               memcpy( &h, k.data + 1, sizeof(h) );
+               return h;
+            }
+         };
+         struct address_hash
+         {
+            size_t operator()( const address& a )const
+            {
+               size_t h;
+               memcpy( &h, a.addr._hash, sizeof(h) );
+               return h;
+            }
+         };
+
+         template< typename Key, typename Value, typename Hash, typename Convert >
+         Value lookup( lru_map<Key,Value,Hash>& map, const Key& key, Convert convert )
+         {
+            {
+               std::lock_guard<std::mutex> lock( _mutex );
+               auto itr = map.index.find( key );
+               if( itr != map.index.end() )
+               {
+                  map.lru.splice( map.lru.begin(), map.lru, itr->second );
+                  return itr->second->second;
+               }
+            }
+
+            // convert without holding the lock, other threads convert other keys meanwhile
+            Value value = convert();
+
+            std::lock_guard<std::mutex> lock( _mutex );
+            if( _capacity == 0 || map.index.find( key ) != map.index.end() )
+               return value;
+            map.lru.emplace_front( key, value );
+            map.index[key] = map.lru.begin();
+            map.shrink( _capacity );
+            return value;
+         }
+
+         mutable std::mutex                                                   _mutex;
+         size_t                                                               _capacity;
+         lru_map< fc::ecc::public_key_data, std::string, key_hash >           _key_strings;
+         lru_map< std::string, fc::ecc::public_key_data, std::hash<std::string> > _string_keys;
+         lru_map< address, std::string, address_hash >                        _address_strings;
+   };
+
+} }
@@ -64,6 +64,11 @@ namespace graphene { namespace chain {
 
       std::string get_message(const fc::ecc::private_key& priv,
                               const fc::ecc::public_key& pub)const;
+      /**
+       * Like get_message(), with the shared secret of the two keys already derived, so that a reader of many memos
+       * between the same keys only pays for the key exchange once. The secret is ignored for unencrypted memos.
+       */
+      std::string get_message(const fc::sha512& shared_secret)const;
    };
 
    /**
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   struct signature_cache_stats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t size = 0;
+      uint64_t capacity = 0;
+   };
+
+   /**
+    *  @brief A bounded, thread-safe LRU cache of the public keys recovered from signatures
+    *
+    *  A transaction usually arrives twice, first on its own and then in a block, as different objects that each
+    *  recover the keys of their signatures. The recovered key of a signature only depends on the signature and the
+    *  signed digest, so signed_transaction::get_signature_keys() looks them up in the process-wide instance().
+    */
+   class signature_cache
+   {
+      public:
+         explicit signature_cache( size_t capacity = 50000 ) : _capacity( capacity ) {}
+
+         static signature_cache& instance();
+
+         /** Changes the number of cached keys, zero disables the cache */
+         void   set_capacity( size_t capacity );
+         size_t capacity()const;
+
+         /** @return the public key that signed digest with sig, recovering and caching it if it is not cached */
+         public_key_type recover( const digest_type& digest, const signature_type& sig );
+         void clear();
+
+         signature_cache_stats get_stats()const;
+
+      private:
+         struct signature_key
+         {
+            digest_type    digest;
+            signature_type sig;
+
+            bool operator==( const signature_key& other )const
+            {
+               return digest == other.digest && memcmp( sig.data, other.sig.data, sizeof(sig.data) ) == 0;
+            }
+         };
+         struct signature_key_hash
+         {
+            size_t operator()( const signature_key& k )const
+            {
+               // digests and the r values of signatures are uniformly distributed
+               size_t d, r;
+               memcpy( &d, k.digest.data(), sizeof(d) );
+               memcpy( &r, k.sig.data + 1, sizeof(r) );
+               return d ^ r;
+            }
+         };
+         struct cached_key
+         {
+            signature_key   signature;
+            public_key_type key;
+         };
+         typedef std::list< cached_key > lru_list;
+
+         /** @pre _mutex is locked */
+         void shrink();
+
+         mutable std::mutex                                                     _mutex;
+         size_t                                                                 _capacity;
+         /** most recently used first */
+         lru_list                                                               _lru;
+         std::unordered_map< signature_key, lru_list::iterator, signature_key_hash > _by_signature;
+         uint64_t                                                               _hits = 0;
+         uint64_t                                                               _misses = 0;
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::signature_cache_stats, (hits)(misses)(size)(capacity) )
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/static_variant.hpp>
+
+#include <type_traits>
+
+namespace graphene { namespace chain {
+
+   namespace detail {
+      template< typename Result, typename Visitor, typename Variant, typename T >
+      Result visit_alternative( Variant& v, Visitor& visitor )
+      {
+         return visitor( v.template get<T>() );
+      }
+   }
+
+   /**
+    *  Calls visitor with the value v holds, like v.visit( visitor ). static_variant::visit() compares the tag with
+    *  every type in turn until it matches, this looks the call up in a table of one function per type instead,
+    *  which makes a difference for operation with its dozens of types. Visitors define result_type as for
+    *  static_variant::visit().
+    */
+   template< typename Visitor, typename... Types >
+   typename std::remove_reference<Visitor>::type::result_type
+   table_visit( const fc::static_variant<Types...>& v, Visitor&& visitor )
+   {
+      typedef typename std::remove_reference<Visitor>::type visitor_type;
+      typedef typename visitor_type::result_type            result_type;
+      typedef const fc::static_variant<Types...>            variant_type;
+      typedef result_type (*alternative)( variant_type&, visitor_type& );
+      static const alternative table[] = {
+         &detail::visit_alternative< result_type, visitor_type, variant_type, Types >...
+      };
+      return table[ v.which() ]( v, visitor );
+   }
+
+   /** like table_visit() above, for visitors that modify the value */
+   template< typename Visitor, typename... Types >
+   typename std::remove_reference<Visitor>::type::result_type
+   table_visit( fc::static_variant<Types...>& v, Visitor&& visitor )
+   {
+      typedef typename std::remove_reference<Visitor>::type visitor_type;
+      typedef typename visitor_type::result_type            result_type;
+      typedef fc::static_variant<Types...>                  variant_type;
+      typedef result_type (*alternative)( variant_type&, visitor_type& );
+      static const alternative table[] = {
+         &detail::visit_alternative< result_type, visitor_type, variant_type, Types >...
+      };
+      return table[ v.which() ]( v, visitor );
+   }
+
+} } // graphene::chain
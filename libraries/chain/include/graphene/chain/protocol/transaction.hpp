@@ -99,7 +99,7 @@ namespace graphene { namespace chain {
       {
          vector<typename Visitor::result_type> results;
          for( auto& op : operations )
-            results.push_back(op.visit( std::forward<Visitor>( visitor ) ));
+            results.push_back( table_visit( op, visitor ) );
          return results;
       }
       template<typename Visitor>
@@ -107,7 +107,7 @@ namespace graphene { namespace chain {
       {
          vector<typename Visitor::result_type> results;
          for( auto& op : operations )
-            results.push_back(op.visit( std::forward<Visitor>( visitor ) ));
+            results.push_back( table_visit( op, visitor ) );
          return results;
       }
 
@@ -192,6 +192,9 @@ namespace graphene { namespace chain {
       /** Removes all signatures */
       void clear_signatures() { signatures.clear(); }
    protected:
+      /** Sets _signees to the keys that signed digest d */
+      void recover_signees( const digest_type& d )const;
+
       /** Public keys extracted from signatures */
       mutable flat_set<public_key_type> _signees;
    };
@@ -209,8 +212,16 @@ namespace graphene { namespace chain {
       virtual const transaction_id_type&       id()const override;
       virtual void                             validate()const override;
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const override;
+      /** @return fc::raw::pack_size() of this as a signed_transaction */
+      uint32_t                                 packed_size()const;
    protected:
-      mutable bool _validated = false;
+      /** sets the id and the packed size from the packed transaction part */
+      void remember_packed( const std::vector<char>& packed )const;
+
+      mutable bool     _validated = false;
+      mutable bool     _signees_known = false;
+      /** 0 until the id and the size are known, they are computed from one packing of the transaction */
+      mutable uint32_t _packed_size = 0;
    };
 
    void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
@@ -238,10 +249,15 @@ namespace graphene { namespace chain {
    {
       processed_transaction( const signed_transaction& trx = signed_transaction() )
          : precomputable_transaction(trx){}
+      processed_transaction( const precomputable_transaction& trx )
+         : precomputable_transaction(trx){}
 
       vector<operation_result> operation_results;
 
+      /** computed once, like the id the transaction must not change afterwards */
       digest_type merkle_digest()const;
+   protected:
+      mutable digest_type _merkle_digest;
    };
 
    /// @} transactions group
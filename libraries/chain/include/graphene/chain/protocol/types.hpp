@@ -35,6 +35,8 @@
 #include <fc/string.hpp>
 
 #include <graphene/chain/protocol/ext.hpp>
+#include <graphene/chain/protocol/asset_pack.hpp>
+#include <graphene/db/interned_string.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/uint128.hpp>
@@ -44,6 +46,7 @@
 #include <vector>
 #include <deque>
 #include <cstdint>
+#include <cstring>
 #include <graphene/chain/protocol/address.hpp>
 #include <graphene/db/object_id.hpp>
 #include <graphene/chain/protocol/config.hpp>
@@ -272,6 +275,17 @@ namespace graphene { namespace chain {
       }
    };
 
+   /** Hashes the first bytes of the x coordinate of a compressed key, they are as good as random */
+   class pubkey_hash {
+   public:
+      inline size_t operator()( const public_key_type& k )const
+      {
+         size_t result;
+         memcpy( &result, k.key_data.data + 1, sizeof(result) );
+         return result;
+      }
+   };
+
    struct extended_public_key_type
    {
       struct binary_key
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/variant_object.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    * What database::simulate() applies to a fork of the current state, in this order. The fork starts from the
+    * state with the pending transactions applied.
+    */
+   struct simulation_request
+   {
+      /** changes to objects in the format of database::debug_update(), e.g. to move a price feed */
+      vector<fc::variant_object>           object_updates;
+      /** applied one after the other like pushed transactions, in the block after the head block */
+      vector<signed_transaction>           transactions;
+      /**
+       * the transactions of the blocks applied after them, at the next slots and by the witnesses scheduled there;
+       * a block without transactions just moves the chain on by a slot, e.g. to reach a maintenance interval
+       */
+      vector< vector<signed_transaction> > blocks;
+      /** validation to skip in the transactions and blocks, e.g. database::skip_transaction_signatures */
+      uint32_t                             skip = 0;
+   };
+
+   /** an object the simulation changed, with its values before and after, null where the object didn't exist */
+   struct simulated_object_change
+   {
+      object_id_type id;
+      fc::variant    before;
+      fc::variant    after;
+   };
+
+   /** what database::dry_run_transaction() found of an operation */
+   struct dry_run_operation
+   {
+      /** the result of the evaluate step, a void_result for most operations */
+      operation_result result;
+      /** the fee the operation pays */
+      asset            fee;
+      /** the fee the schedule asks for, in the asset of fee */
+      asset            required_fee;
+   };
+
+   struct simulation_result
+   {
+      /** the simulated transactions with their operation results */
+      vector<processed_transaction>    transactions;
+      /** the simulated blocks as they were applied */
+      vector<signed_block>             blocks;
+      /** the operations applied in the simulation, virtual ones like order fills of margin calls included */
+      vector<operation_history_object> operations;
+      /** the objects the simulation changed, by id */
+      vector<simulated_object_change>  changes;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::simulation_request, (object_updates)(transactions)(blocks)(skip) )
+FC_REFLECT( graphene::chain::simulated_object_change, (id)(before)(after) )
+FC_REFLECT( graphene::chain::dry_run_operation, (result)(fee)(required_fee) )
+FC_REFLECT( graphene::chain::simulation_result, (transactions)(blocks)(operations)(changes) )
@@ -47,5 +47,7 @@ namespace graphene { namespace chain {
          bool                             _is_proposed_trx = false;
          bool                             skip_fee = false;
          bool                             skip_fee_schedule_check = false;
+         /** only the evaluate step runs, see database::dry_run_transaction(), and nothing is measured */
+         bool                             dry_run = false;
    };
 } } // namespace graphene::chain
@@ -26,6 +26,7 @@
 
 #include <graphene/chain/protocol/transaction.hpp>
 #include <graphene/db/index.hpp>
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <fc/uint128.hpp>
 
@@ -43,6 +44,9 @@ namespace graphene { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * Only the id and the expiration are kept, the body of a recent transaction is found in the block it was
+    * included in, see database::get_recent_transaction().
     */
    class transaction_object : public abstract_object<transaction_object>
    {
@@ -50,25 +54,31 @@ namespace graphene { namespace chain {
          static const uint8_t space_id = implementation_ids;
          static const uint8_t type_id  = impl_transaction_object_type;
 
-         signed_transaction  trx;
          transaction_id_type trx_id;
+         time_point_sec      expiration;
+         /** the block the transaction was applied in, or the block being produced for a pending transaction */
+         uint32_t            block_num = 0;
 
-         time_point_sec get_expiration()const { return trx.expiration; }
+         time_point_sec get_expiration()const { return expiration; }
    };
 
-   struct by_expiration;
    struct by_id;
    struct by_trx_id;
    typedef multi_index_container<
       transaction_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), std::hash<transaction_id_type> >,
-         ordered_non_unique< tag<by_expiration>, const_mem_fun<transaction_object, time_point_sec, &transaction_object::get_expiration > >
+         hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), std::hash<transaction_id_type> >
       >
    > transaction_multi_index_type;
 
    typedef generic_index<transaction_object, transaction_multi_index_type> transaction_index;
+
+   /** The transaction objects by expiration, see database::clear_expired_transactions() */
+   class transaction_expiration_index
+      : public expiring_index< transaction_object,
+                               const_mem_fun< transaction_object, time_point_sec, &transaction_object::get_expiration > >
+   {};
 } }
 
-FC_REFLECT_DERIVED( graphene::chain::transaction_object, (graphene::db::object), (trx)(trx_id) )
+FC_REFLECT_DERIVED( graphene::chain::transaction_object, (graphene::db::object), (trx_id)(expiration)(block_num) )
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief Threads that only verify blocks and transactions
+    *
+    *  By default database::precompute_parallel() runs on graphene::db::task_scheduler::shared(), which is shared with
+    *  all other work that is done in parallel. A verification_pool set with database::set_verification_pool() keeps
+    *  signature recovery on its own threads, optionally pinned to CPUs.
+    */
+   class verification_pool
+   {
+      public:
+         /**
+          * Starts num_threads threads. If cpus is not empty, thread i is pinned to the CPU cpus[i % cpus.size()],
+          * which is only supported on Linux.
+          */
+         explicit verification_pool( uint32_t num_threads, const std::vector<uint32_t>& cpus = std::vector<uint32_t>() );
+         ~verification_pool();
+
+         uint32_t size()const { return _threads.size(); }
+
+         /** Runs work on the next thread of the pool */
+         fc::future<void> post( const std::function<void()>& work );
+
+         /**
+          * Splits [0,count) into one batch of at least min_batch items per thread and runs work(begin,end) for each
+          * batch on the pool. The caller must wait for all returned futures.
+          */
+         std::vector< fc::future<void> > post_batches( size_t count, size_t min_batch,
+                                                       const std::function<void(size_t,size_t)>& work );
+
+      private:
+         std::vector< std::unique_ptr<fc::thread> > _threads;
+         std::atomic<uint32_t>                      _next{ 0 };
+   };
+
+} }
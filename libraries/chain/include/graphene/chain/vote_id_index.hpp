@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/vote.hpp>
+#include <graphene/db/index.hpp>
+
+#include <cassert>
+#include <initializer_list>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief A secondary index that finds the object a vote id belongs to with one array access
+    *
+    *  Vote ids of all types are numbered by one counter, see global_property_object::next_available_vote_id, so
+    *  their instances are dense and each index can address its objects by instance. VoteIds are the members of
+    *  ObjectType that hold its vote ids, and they must not change after the object was created.
+    */
+   template<typename ObjectType, vote_id_type ObjectType::*... VoteIds>
+   class vote_id_index : public graphene::db::secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override
+         {
+            const ObjectType& o = cast( obj );
+            for( vote_id_type ObjectType::* vote_id : { VoteIds... } )
+            {
+               const uint32_t instance = (o.*vote_id).instance();
+               if( _objects.size() <= instance )
+                  _objects.resize( instance + 1, nullptr );
+               _objects[instance] = &o;
+            }
+         }
+         virtual void object_removed( const object& obj ) override
+         {
+            const ObjectType& o = cast( obj );
+            for( vote_id_type ObjectType::* vote_id : { VoteIds... } )
+            {
+               const uint32_t instance = (o.*vote_id).instance();
+               if( instance < _objects.size() && _objects[instance] == &o )
+                  _objects[instance] = nullptr;
+            }
+         }
+         virtual void object_modified( const object& after ) override
+         {
+            // the vote ids of an object never change
+#ifndef NDEBUG
+            for( vote_id_type ObjectType::* vote_id : { VoteIds... } )
+               assert( find( cast( after ).*vote_id ) == &after );
+#endif
+         }
+         virtual uint64_t estimated_memory_usage()const override
+         { return _objects.capacity() * sizeof( const ObjectType* ); }
+         virtual bool is_self_contained()const override { return true; }
+
+         /** @return the object that has the vote id, or nullptr if none does */
+         const ObjectType* find( vote_id_type id )const
+         {
+            const uint32_t instance = id.instance();
+            if( instance >= _objects.size() || _objects[instance] == nullptr )
+               return nullptr;
+            const ObjectType* o = _objects[instance];
+            // the instance may belong to a vote id of another type
+            for( vote_id_type ObjectType::* vote_id : { VoteIds... } )
+               if( (o->*vote_id).content == id.content )
+                  return o;
+            return nullptr;
+         }
+
+      private:
+         static const ObjectType& cast( const object& obj )
+         {
+            assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
+            return static_cast<const ObjectType&>( obj );
+         }
+
+         std::vector< const ObjectType* > _objects;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief Running vote totals for the incremental vote tally of the chain maintenance
+    *
+    *  The totals are the sums of the stakes that accounts contributed at the last maintenance, grouped by the
+    *  account whose opinions they follow. Trackers on the account, account statistics and vesting balance indexes
+    *  mark every account whose contribution may have changed since, the next maintenance only recounts those. All
+    *  sums wrap around like the full tally does, so adding and subtracting stakes gives the same result as
+    *  recounting everything.
+    *
+    *  The totals are not part of the undo history. The database records the block at which they were last
+    *  reconciled and falls back to a full tally if that block is no longer on the chain.
+    */
+   class vote_tally_cache
+   {
+      public:
+         /** marks the contribution of the account for recounting */
+         void mark_dirty( account_id_type account ) { _dirty.insert( account ); }
+         /** @return the accounts marked since the last call */
+         std::set<account_id_type> take_dirty();
+         void clear_dirty() { _dirty.clear(); }
+
+         /** forgets all totals, until the next reset() the cache can not be reconciled */
+         void invalidate() { _valid = false; }
+         /** removes all contributions, the cache is valid again after the next set_reconciled() */
+         void reset();
+         bool is_valid()const { return _valid; }
+         void set_reconciled( uint32_t block_num, const block_id_type& block_id, bool count_non_member_votes );
+         uint32_t      reconciled_block_num()const { return _block_num; }
+         block_id_type reconciled_block_id()const { return _block_id; }
+         bool          counts_non_member_votes()const { return _count_non_member_votes; }
+
+         /**
+          *  Replaces the contribution of an account.
+          *  @param opinion_account the account whose votes the stake counts for, nullptr if the account does not vote
+          */
+         void set_stake( account_id_type account, const account_object* opinion_account, uint64_t stake );
+         /** moves the stake that follows the opinions of the account to its current options */
+         void update_opinion( const account_object& opinion_account );
+
+         /** writes the totals into the buffers of the chain maintenance, which must be zeroed */
+         void fill( vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram, uint16_t max_witness_count,
+                    vector<uint64_t>& committee_count_histogram, uint16_t max_committee_count,
+                    uint64_t& total_voting_stake )const;
+
+      private:
+         struct stake_entry
+         {
+            account_id_type opinion_account;
+            uint64_t        stake = 0;
+            bool            counted = false;
+         };
+         /** the options of an opinion account as they were counted, and the stake that follows them */
+         struct opinion_entry
+         {
+            flat_set<vote_id_type> votes;
+            uint16_t               num_witness = 0;
+            uint16_t               num_committee = 0;
+            uint64_t               stake = 0;
+            uint32_t               voters = 0;
+         };
+
+         /** adds amount to the totals of the options, or subtracts it */
+         void add( const opinion_entry& opinion, uint64_t amount, bool subtract );
+
+         std::set<account_id_type>                     _dirty;
+         /** indexed by account instance */
+         vector<stake_entry>                           _stakes;
+         std::unordered_map<uint64_t, opinion_entry>   _opinions;
+
+         vector<uint64_t>                              _vote_totals;
+         /** stake by the raw num_witness and num_committee of the opinions */
+         std::map<uint16_t, uint64_t>                  _witness_counts;
+         std::map<uint16_t, uint64_t>                  _committee_counts;
+         uint64_t                                      _total_voting_stake = 0;
+
+         bool                                          _valid = false;
+         uint32_t                                      _block_num = 0;
+         block_id_type                                 _block_id;
+         bool                                          _count_non_member_votes = true;
+   };
+
+   /** @brief Marks the accounts affected by changes of the tracked index in a vote_tally_cache */
+   template<typename ObjectType>
+   class vote_tally_tracker : public secondary_index
+   {
+      public:
+         explicit vote_tally_tracker( vote_tally_cache* cache ) : _cache( cache ) {}
+
+         virtual void object_inserted( const object& obj ) override { mark( obj ); }
+         virtual void object_removed( const object& obj ) override  { mark( obj ); }
+         virtual void about_to_modify( const object& before ) override {}
+         virtual void object_modified( const object& after ) override { mark( after ); }
+
+      private:
+         void mark( const object& obj ) { _cache->mark_dirty( owner_of( static_cast<const ObjectType&>( obj ) ) ); }
+
+         static account_id_type owner_of( const account_object& a )            { return a.id; }
+         static account_id_type owner_of( const account_statistics_object& s ) { return s.owner; }
+         static account_id_type owner_of( const vesting_balance_object& v )    { return v.owner; }
+
+         vote_tally_cache* _cache;
+   };
+
+} }
@@ -25,6 +25,9 @@
 #include <graphene/chain/protocol/asset.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/chain/vote_id_index.hpp>
+
+#include <algorithm>
 
 namespace graphene { namespace chain {
    using namespace graphene::db;
@@ -68,6 +71,86 @@ namespace graphene { namespace chain {
       >
    >;
    using witness_index = generic_index<witness_object, witness_multi_index_type>;
+   using witness_vote_id_index = vote_id_index<witness_object, &witness_object::vote_id>;
+
+   /**
+    * The last_confirmed_block_num of the active witnesses kept sorted, so that the last irreversible block is read
+    * instead of selected among all active witnesses every block. A block only moves the entry of its signer.
+    */
+   class witness_confirmation_index : public graphene::db::secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override
+         {
+            const witness_object& w = static_cast<const witness_object&>( obj );
+            if( _active.count( witness_id_type( w.id ) ) == 0 )
+               return;
+            _confirmations[w.id] = w.last_confirmed_block_num;
+            insert_sorted( w.last_confirmed_block_num );
+         }
+         virtual void object_removed( const object& obj ) override
+         {
+            auto itr = _confirmations.find( obj.id );
+            if( itr == _confirmations.end() )
+               return;
+            erase_sorted( itr->second );
+            _confirmations.erase( itr );
+         }
+         virtual void object_modified( const object& after ) override
+         {
+            auto itr = _confirmations.find( after.id );
+            if( itr == _confirmations.end() )
+               return;
+            const uint32_t confirmed = static_cast<const witness_object&>( after ).last_confirmed_block_num;
+            if( itr->second == confirmed )
+               return;
+            erase_sorted( itr->second );
+            insert_sorted( confirmed );
+            itr->second = confirmed;
+         }
+         virtual uint64_t estimated_memory_usage()const override
+         {
+            return _active.capacity() * sizeof( witness_id_type ) + _sorted.capacity() * sizeof( uint32_t )
+                   + _confirmations.capacity() * sizeof( std::pair<object_id_type, uint32_t> );
+         }
+         virtual bool is_self_contained()const override { return true; }
+
+         /** @return whether the witnesses tracked are exactly active */
+         bool tracks( const flat_set<witness_id_type>& active )const { return _active == active; }
+
+         /** Tracks the confirmations of witnesses instead of those tracked so far */
+         void track( const flat_set<witness_id_type>& active, const vector<const witness_object*>& witnesses )
+         {
+            _active = active;
+            _confirmations.clear();
+            _sorted.clear();
+            for( const witness_object* w : witnesses )
+            {
+               _confirmations[w->id] = w->last_confirmed_block_num;
+               _sorted.push_back( w->last_confirmed_block_num );
+            }
+            std::sort( _sorted.begin(), _sorted.end() );
+         }
+
+         /** @return the confirmations of the tracked witnesses, lowest first */
+         const vector<uint32_t>& sorted_confirmations()const { return _sorted; }
+
+      private:
+         void insert_sorted( uint32_t confirmed )
+         {
+            _sorted.insert( std::upper_bound( _sorted.begin(), _sorted.end(), confirmed ), confirmed );
+         }
+         void erase_sorted( uint32_t confirmed )
+         {
+            auto itr = std::lower_bound( _sorted.begin(), _sorted.end(), confirmed );
+            assert( itr != _sorted.end() && *itr == confirmed );
+            _sorted.erase( itr );
+         }
+
+         flat_set<witness_id_type>           _active;
+         flat_map<object_id_type, uint32_t>  _confirmations;
+         vector<uint32_t>                    _sorted;
+   };
 } } // graphene::chain
 
 FC_REFLECT_DERIVED( graphene::chain::witness_object, (graphene::db::object),
@@ -24,6 +24,9 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/chain/vote_id_index.hpp>
+
+#include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
 
@@ -143,17 +146,26 @@ class worker_object : public abstract_object<worker_object>
 struct by_account;
 struct by_vote_for;
 struct by_vote_against;
+struct by_end_date;
 typedef multi_index_container<
    worker_object,
    indexed_by<
       ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
       ordered_non_unique< tag<by_account>, member< worker_object, account_id_type, &worker_object::worker_account > >,
       ordered_unique< tag<by_vote_for>, member< worker_object, vote_id_type, &worker_object::vote_for > >,
-   ordered_unique< tag<by_vote_against>, member< worker_object, vote_id_type, &worker_object::vote_against > >
+      ordered_unique< tag<by_vote_against>, member< worker_object, vote_id_type, &worker_object::vote_against > >,
+      /// workers that ended are never paid again, the payroll starts at the first one that did not
+      ordered_unique< tag<by_end_date>,
+         composite_key< worker_object,
+            member< worker_object, time_point_sec, &worker_object::work_end_date >,
+            member< object, object_id_type, &object::id >
+         >
+      >
    >
 > worker_object_multi_index_type;
 
 using worker_index = generic_index<worker_object, worker_object_multi_index_type>;
+using worker_vote_id_index = vote_id_index<worker_object, &worker_object::vote_for, &worker_object::vote_against>;
 
 } } // graphene::chain
 
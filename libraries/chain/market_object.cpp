@@ -23,10 +23,78 @@
  */
 #include <graphene/chain/market_object.hpp>
 
+#include <graphene/db/dynamic_memory.hpp>
+
 #include <boost/multiprecision/cpp_int.hpp>
 
 using namespace graphene::chain;
 
+share_type limit_order_depth_index::to_receive( const limit_order_object& order )
+{
+   using boost::multiprecision::uint128_t;
+   return share_type( ( uint128_t( order.for_sale.value ) * order.sell_price.quote.amount.value
+                        / order.sell_price.base.amount.value ).convert_to<int64_t>() );
+}
+
+void limit_order_depth_index::add( const limit_order_object& order )
+{
+   limit_order_price_level& level = _sides[ std::make_pair( order.sell_asset_id(), order.receive_asset_id() ) ]
+                                          [ order.sell_price ];
+   level.for_sale += order.for_sale;
+   level.to_receive += to_receive( order );
+   ++level.order_count;
+}
+
+void limit_order_depth_index::subtract( const limit_order_object& order )
+{
+   auto side = _sides.find( std::make_pair( order.sell_asset_id(), order.receive_asset_id() ) );
+   FC_ASSERT( side != _sides.end(), "Limit order ${id} is not in its market", ("id",order.id) );
+   auto level = side->second.find( order.sell_price );
+   FC_ASSERT( level != side->second.end(), "Limit order ${id} is not at its price", ("id",order.id) );
+   if( --level->second.order_count == 0 )
+   {
+      side->second.erase( level );
+      if( side->second.empty() )
+         _sides.erase( side );
+      return;
+   }
+   level->second.for_sale -= order.for_sale;
+   level->second.to_receive -= to_receive( order );
+}
+
+void limit_order_depth_index::object_inserted( const object& obj )
+{
+   add( static_cast<const limit_order_object&>( obj ) );
+}
+
+void limit_order_depth_index::object_removed( const object& obj )
+{
+   subtract( static_cast<const limit_order_object&>( obj ) );
+}
+
+void limit_order_depth_index::about_to_modify( const object& before )
+{
+   _before = static_cast<const limit_order_object&>( before );
+}
+
+void limit_order_depth_index::object_modified( const object& after )
+{
+   subtract( _before );
+   add( static_cast<const limit_order_object&>( after ) );
+}
+
+uint64_t limit_order_depth_index::estimated_memory_usage()const
+{
+   return graphene::db::dynamic_memory_size( _sides );
+}
+
+const limit_order_depth_index::price_levels* limit_order_depth_index::find_side( asset_id_type sell,
+                                                                                asset_id_type receive )const
+{
+   auto side = _sides.find( std::make_pair( sell, receive ) );
+   return side == _sides.end() ? nullptr : &side->second;
+}
+
 /*
 target_CR = max( target_CR, MCR )
 
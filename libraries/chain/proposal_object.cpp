@@ -28,23 +28,49 @@ namespace graphene { namespace chain {
 
 bool proposal_object::is_authorized_to_execute(database& db) const
 {
+   const uint32_t max_depth = db.get_global_properties().parameters.max_authority_depth;
+   const uint64_t revision = db.get_index_type<account_index>().get_secondary_index<account_authority_revision_index>()
+                                                               .get_revision();
+   const auto& cache = db.get_index_type<proposal_index>().get_secondary_index<proposal_authorization_cache>();
+   optional<bool> cached = cache.find( id, revision, max_depth );
+   if( cached.valid() )
+      return *cached;
+
    transaction_evaluation_state dry_run_eval(&db);
 
+   bool authorized = true;
    try {
       verify_authority( proposed_transaction.operations, 
                         available_key_approvals,
                         [&]( account_id_type id ){ return &id(db).active; },
                         [&]( account_id_type id ){ return &id(db).owner;  },
-                        db.get_global_properties().parameters.max_authority_depth,
+                        max_depth,
                         true, /* allow committeee */
                         available_active_approvals,
                         available_owner_approvals );
    } 
    catch ( const fc::exception& e )
    {
-      return false;
+      authorized = false;
    }
-   return true;
+   cache.store( id, revision, max_depth, authorized );
+   return authorized;
+}
+
+optional<bool> proposal_authorization_cache::find( object_id_type proposal, uint64_t authority_revision,
+                                                   uint32_t max_depth )const
+{
+   auto itr = _results.find( proposal );
+   if( itr == _results.end() || itr->second.authority_revision != authority_revision
+         || itr->second.max_depth != max_depth )
+      return optional<bool>();
+   return itr->second.authorized;
+}
+
+void proposal_authorization_cache::store( object_id_type proposal, uint64_t authority_revision, uint32_t max_depth,
+                                          bool authorized )const
+{
+   _results[proposal] = cached_result{ authority_revision, max_depth, authorized };
 }
 
 void required_approval_index::object_inserted( const object& obj )
@@ -23,6 +23,8 @@
  */
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/chain/protocol/address.hpp>
+#include <graphene/chain/protocol/base58.hpp>
+#include <graphene/chain/protocol/key_string_cache.hpp>
 #include <fc/crypto/elliptic.hpp>
 #include <fc/crypto/base58.hpp>
 #include <algorithm>
@@ -36,7 +38,7 @@ namespace graphene {
       std::string prefix( GRAPHENE_ADDRESS_PREFIX );
       FC_ASSERT( is_valid( base58str, prefix ), "${str}", ("str",base58str) );
 
-      std::vector<char> v = fc::from_base58( base58str.substr( prefix.size() ) );
+      std::vector<char> v = from_base58( base58str.substr( prefix.size() ) );
       memcpy( (char*)addr._hash, v.data(), std::min<size_t>( v.size()-4, sizeof( addr ) ) );
    }
 
@@ -50,7 +52,7 @@ namespace graphene {
       std::vector<char> v;
       try
       {
-		     v = fc::from_base58( base58str.substr( prefix_len ) );
+		     v = from_base58( base58str.substr( prefix_len ) );
       }
       catch( const fc::parse_error_exception& e )
       {
@@ -90,11 +92,13 @@ namespace graphene {
 
    address::operator std::string()const
    {
-        fc::array<char,24> bin_addr;
-        memcpy( (char*)&bin_addr, (char*)&addr, sizeof( addr ) );
-        auto checksum = fc::ripemd160::hash( (char*)&addr, sizeof( addr ) );
-        memcpy( ((char*)&bin_addr)+20, (char*)&checksum._hash[0], 4 );
-        return GRAPHENE_ADDRESS_PREFIX + fc::to_base58( bin_addr.data, sizeof( bin_addr ) );
+        return key_string_cache::instance().address_to_string( *this, [this]() -> std::string {
+           fc::array<char,24> bin_addr;
+           memcpy( (char*)&bin_addr, (char*)&addr, sizeof( addr ) );
+           auto checksum = fc::ripemd160::hash( (char*)&addr, sizeof( addr ) );
+           memcpy( ((char*)&bin_addr)+20, (char*)&checksum._hash[0], 4 );
+           return GRAPHENE_ADDRESS_PREFIX + to_base58( bin_addr.data, sizeof( bin_addr ) );
+        });
    }
 
 } } // namespace graphene::chain
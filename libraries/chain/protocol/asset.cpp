@@ -29,15 +29,50 @@ namespace graphene { namespace chain {
       typedef boost::multiprecision::uint128_t uint128_t;
       typedef boost::multiprecision::int128_t  int128_t;
 
+      namespace detail {
+
+         int compare_products( int64_t a, int64_t b, int64_t c, int64_t d )
+         {
+#ifdef __SIZEOF_INT128__
+            // a single 64x64->128 bit multiplication each, the results are the same as below for non-negative values
+            if( ( a | b | c | d ) >= 0 )
+            {
+               const unsigned __int128 left = (unsigned __int128)uint64_t(a) * uint64_t(b);
+               const unsigned __int128 right = (unsigned __int128)uint64_t(c) * uint64_t(d);
+               return left < right ? -1 : ( left > right ? 1 : 0 );
+            }
+#endif
+            const auto left = uint128_t( a ) * b;
+            const auto right = uint128_t( c ) * d;
+            return left < right ? -1 : ( left > right ? 1 : 0 );
+         }
+
+         /// Calculates `( a * b + add ) / div` for `asset * price`, throws if the result is above the max supply
+         static int64_t multiply_and_divide( int64_t a, int64_t b, int64_t add, int64_t div )
+         {
+#ifdef __SIZEOF_INT128__
+            if( ( a | b | add ) >= 0 )
+            {
+               const unsigned __int128 result = ( (unsigned __int128)uint64_t(a) * uint64_t(b) + uint64_t(add) )
+                                                / uint64_t(div);
+               FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
+               return int64_t( result );
+            }
+#endif
+            uint128_t result = ( uint128_t(a) * b + add ) / div;
+            FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
+            return result.convert_to<int64_t>();
+         }
+
+      } // detail
+
       bool operator == ( const price& a, const price& b )
       {
          if( std::tie( a.base.asset_id, a.quote.asset_id ) != std::tie( b.base.asset_id, b.quote.asset_id ) )
             return false;
 
-         const auto amult = uint128_t( b.quote.amount.value ) * a.base.amount.value;
-         const auto bmult = uint128_t( a.quote.amount.value ) * b.base.amount.value;
-
-         return amult == bmult;
+         return detail::compare_products( b.quote.amount.value, a.base.amount.value,
+                                          a.quote.amount.value, b.base.amount.value ) == 0;
       }
 
       bool operator < ( const price& a, const price& b )
@@ -47,10 +82,8 @@ namespace graphene { namespace chain {
          if( a.quote.asset_id < b.quote.asset_id ) return true;
          if( a.quote.asset_id > b.quote.asset_id ) return false;
 
-         const auto amult = uint128_t( b.quote.amount.value ) * a.base.amount.value;
-         const auto bmult = uint128_t( a.quote.amount.value ) * b.base.amount.value;
-
-         return amult < bmult;
+         return detail::compare_products( b.quote.amount.value, a.base.amount.value,
+                                          a.quote.amount.value, b.base.amount.value ) < 0;
       }
 
       asset operator * ( const asset& a, const price& b )
@@ -58,16 +91,14 @@ namespace graphene { namespace chain {
          if( a.asset_id == b.base.asset_id )
          {
             FC_ASSERT( b.base.amount.value > 0 );
-            uint128_t result = (uint128_t(a.amount.value) * b.quote.amount.value)/b.base.amount.value;
-            FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
-            return asset( result.convert_to<int64_t>(), b.quote.asset_id );
+            int64_t result = detail::multiply_and_divide( a.amount.value, b.quote.amount.value, 0, b.base.amount.value );
+            return asset( result, b.quote.asset_id );
          }
          else if( a.asset_id == b.quote.asset_id )
          {
             FC_ASSERT( b.quote.amount.value > 0 );
-            uint128_t result = (uint128_t(a.amount.value) * b.base.amount.value)/b.quote.amount.value;
-            FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
-            return asset( result.convert_to<int64_t>(), b.base.asset_id );
+            int64_t result = detail::multiply_and_divide( a.amount.value, b.base.amount.value, 0, b.quote.amount.value );
+            return asset( result, b.base.asset_id );
          }
          FC_THROW_EXCEPTION( fc::assert_exception, "invalid asset * price", ("asset",a)("price",b) );
       }
@@ -78,16 +109,16 @@ namespace graphene { namespace chain {
          if( a.asset_id == b.base.asset_id )
          {
             FC_ASSERT( b.base.amount.value > 0 );
-            uint128_t result = (uint128_t(a.amount.value) * b.quote.amount.value + b.base.amount.value - 1)/b.base.amount.value;
-            FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
-            return asset( result.convert_to<int64_t>(), b.quote.asset_id );
+            int64_t result = detail::multiply_and_divide( a.amount.value, b.quote.amount.value,
+                                                          b.base.amount.value - 1, b.base.amount.value );
+            return asset( result, b.quote.asset_id );
          }
          else if( a.asset_id == b.quote.asset_id )
          {
             FC_ASSERT( b.quote.amount.value > 0 );
-            uint128_t result = (uint128_t(a.amount.value) * b.base.amount.value + b.quote.amount.value - 1)/b.quote.amount.value;
-            FC_ASSERT( result <= GRAPHENE_MAX_SHARE_SUPPLY );
-            return asset( result.convert_to<int64_t>(), b.base.asset_id );
+            int64_t result = detail::multiply_and_divide( a.amount.value, b.base.amount.value,
+                                                          b.quote.amount.value - 1, b.quote.amount.value );
+            return asset( result, b.base.asset_id );
          }
          FC_THROW_EXCEPTION( fc::assert_exception, "invalid asset::multiply_and_round_up(price)", ("asset",a)("price",b) );
       }
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/base58.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+namespace graphene { namespace chain {
+
+namespace {
+   const char base58_alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+   /** 58^5, the largest power of 58 that keeps a remainder times 2^32 within 64 bits */
+   const uint64_t digit_group = 656356768;
+   const uint32_t digits_per_group = 5;
+
+   struct digit_table
+   {
+      int8_t values[256];
+      digit_table()
+      {
+         std::fill( values, values + 256, -1 );
+         for( int8_t i = 0; i < 58; ++i )
+            values[ uint8_t( base58_alphabet[i] ) ] = i;
+      }
+   };
+
+   bool is_space( char c ) { return std::isspace( static_cast<unsigned char>( c ) ) != 0; }
+}
+
+std::string to_base58( const char* data, size_t size )
+{
+   size_t zeros = 0;
+   while( zeros < size && data[zeros] == 0 )
+      ++zeros;
+
+   // the remaining bytes as big endian limbs, the first limb takes the bytes that do not fill a whole one
+   const size_t rest = size - zeros;
+   std::vector<uint32_t> limbs( ( rest + 3 ) / 4 );
+   const size_t padding = limbs.size() * 4 - rest;
+   for( size_t i = 0; i < rest; ++i )
+   {
+      uint32_t& limb = limbs[ ( padding + i ) / 4 ];
+      limb = ( limb << 8 ) | uint8_t( data[zeros + i] );
+   }
+
+   // divide by 58^5 until nothing is left, the digits come out least significant first
+   std::string digits;
+   digits.reserve( rest * 138 / 100 + digits_per_group );
+   size_t first = 0;
+   while( first < limbs.size() )
+   {
+      uint64_t remainder = 0;
+      for( size_t i = first; i < limbs.size(); ++i )
+      {
+         const uint64_t current = ( remainder << 32 ) | limbs[i];
+         limbs[i] = uint32_t( current / digit_group );
+         remainder = current % digit_group;
+      }
+      while( first < limbs.size() && limbs[first] == 0 )
+         ++first;
+      for( uint32_t j = 0; j < digits_per_group; ++j )
+      {
+         digits += base58_alphabet[ remainder % 58 ];
+         remainder /= 58;
+      }
+   }
+   // the last group is padded with zero digits
+   while( !digits.empty() && digits.back() == base58_alphabet[0] )
+      digits.pop_back();
+
+   std::string result( zeros, base58_alphabet[0] );
+   result.append( digits.rbegin(), digits.rend() );
+   return result;
+}
+
+std::vector<char> from_base58( const std::string& base58 )
+{
+   static const digit_table table;
+
+   size_t pos = 0;
+   while( pos < base58.size() && is_space( base58[pos] ) )
+      ++pos;
+   size_t zeros = 0;
+   while( pos < base58.size() && base58[pos] == base58_alphabet[0] )
+   {
+      ++zeros;
+      ++pos;
+   }
+
+   // little endian limbs of the number, multiplied by 58^n and added to for every group of n digits
+   std::vector<uint32_t> limbs;
+   limbs.reserve( ( base58.size() - pos ) * 733 / 4000 + 1 );
+   const auto add_group = [&limbs]( uint64_t multiplier, uint64_t value ) {
+      uint64_t carry = value;
+      for( uint32_t& limb : limbs )
+      {
+         const uint64_t current = limb * multiplier + carry;
+         limb = uint32_t( current );
+         carry = current >> 32;
+      }
+      while( carry )
+      {
+         limbs.push_back( uint32_t( carry ) );
+         carry >>= 32;
+      }
+   };
+   uint64_t multiplier = 1;
+   uint64_t value = 0;
+   for( ; pos < base58.size() && !is_space( base58[pos] ); ++pos )
+   {
+      const int8_t digit = table.values[ uint8_t( base58[pos] ) ];
+      if( digit < 0 )
+         FC_THROW_EXCEPTION( fc::parse_error_exception, "Unable to decode base58 string ${base58_str}",
+                             ("base58_str",base58) );
+      multiplier *= 58;
+      value = value * 58 + uint64_t( digit );
+      if( multiplier == digit_group )
+      {
+         add_group( multiplier, value );
+         multiplier = 1;
+         value = 0;
+      }
+   }
+   if( multiplier > 1 )
+      add_group( multiplier, value );
+   while( pos < base58.size() && is_space( base58[pos] ) )
+      ++pos;
+   if( pos != base58.size() )
+      FC_THROW_EXCEPTION( fc::parse_error_exception, "Unable to decode base58 string ${base58_str}",
+                          ("base58_str",base58) );
+
+   std::vector<char> result( zeros, 0 );
+   result.reserve( zeros + limbs.size() * 4 );
+   bool leading = true;
+   for( auto itr = limbs.rbegin(); itr != limbs.rend(); ++itr )
+      for( int shift = 24; shift >= 0; shift -= 8 )
+      {
+         const char byte = char( *itr >> shift );
+         if( leading && byte == 0 )
+            continue;
+         leading = false;
+         result.push_back( byte );
+      }
+   return result;
+}
+
+} } // graphene::chain
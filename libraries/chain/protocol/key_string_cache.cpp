@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/key_string_cache.hpp>
+
+namespace graphene { namespace chain {
+
+key_string_cache& key_string_cache::instance()
+{
+   static key_string_cache cache;
+   return cache;
+}
+
+void key_string_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   _key_strings.shrink( capacity );
+   _string_keys.shrink( capacity );
+   _address_strings.shrink( capacity );
+}
+
+size_t key_string_cache::capacity()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity;
+}
+
+void key_string_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _key_strings.clear();
+   _string_keys.clear();
+   _address_strings.clear();
+}
+
+} }
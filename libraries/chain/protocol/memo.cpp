@@ -55,11 +55,17 @@ void memo_data::set_message(const fc::ecc::private_key& priv, const fc::ecc::pub
 
 string memo_data::get_message(const fc::ecc::private_key& priv,
                               const fc::ecc::public_key& pub)const
+{
+   if( from != public_key_type() )
+      return get_message( priv.get_shared_secret(pub) );
+   return get_message( fc::sha512() );
+}
+
+string memo_data::get_message(const fc::sha512& shared_secret)const
 {
    if( from != public_key_type() )
    {
-      auto secret = priv.get_shared_secret(pub);
-      auto nonce_plus_secret = fc::sha512::hash(fc::to_string(nonce) + secret.str());
+      auto nonce_plus_secret = fc::sha512::hash(fc::to_string(nonce) + shared_secret.str());
       auto plain_text = fc::aes_decrypt( nonce_plus_secret, message );
       auto result = memo_message::deserialize(string(plain_text.begin(), plain_text.end()));
       FC_ASSERT( result.checksum == uint32_t(digest_type::hash(result.text)._hash[0]) );
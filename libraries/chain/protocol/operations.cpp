@@ -79,7 +79,7 @@ struct operation_get_required_auth
 
 void operation_validate( const operation& op )
 {
-   op.visit( operation_validator() );
+   table_visit( op, operation_validator() );
 }
 
 void operation_get_required_authorities( const operation& op, 
@@ -87,7 +87,7 @@ void operation_get_required_authorities( const operation& op,
                                          flat_set<account_id_type>& owner,
                                          vector<authority>&  other )
 {
-   op.visit( operation_get_required_auth( active, owner, other ) );
+   table_visit( op, operation_get_required_auth( active, owner, other ) );
 }
 
 } } // namespace graphene::chain
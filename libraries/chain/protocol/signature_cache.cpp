@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/signature_cache.hpp>
+
+namespace graphene { namespace chain {
+
+signature_cache& signature_cache::instance()
+{
+   static signature_cache cache;
+   return cache;
+}
+
+void signature_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   shrink();
+}
+
+size_t signature_cache::capacity()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity;
+}
+
+public_key_type signature_cache::recover( const digest_type& digest, const signature_type& sig )
+{
+   signature_key signature{ digest, sig };
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      auto itr = _by_signature.find( signature );
+      if( itr != _by_signature.end() )
+      {
+         ++_hits;
+         _lru.splice( _lru.begin(), _lru, itr->second );
+         return itr->second->key;
+      }
+      ++_misses;
+   }
+
+   // recover without holding the lock, other threads recover other signatures meanwhile
+   public_key_type key( fc::ecc::public_key( sig, digest ) );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity == 0 || _by_signature.find( signature ) != _by_signature.end() )
+      return key;
+   _lru.push_front( cached_key{ signature, key } );
+   _by_signature[signature] = _lru.begin();
+   shrink();
+   return key;
+}
+
+void signature_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _lru.clear();
+   _by_signature.clear();
+}
+
+void signature_cache::shrink()
+{
+   while( _lru.size() > _capacity )
+   {
+      _by_signature.erase( _lru.back().signature );
+      _lru.pop_back();
+   }
+}
+
+signature_cache_stats signature_cache::get_stats()const
+{
+   signature_cache_stats stats;
+   std::lock_guard<std::mutex> lock( _mutex );
+   stats.hits = _hits;
+   stats.misses = _misses;
+   stats.size = _lru.size();
+   stats.capacity = _capacity;
+   return stats;
+}
+
+} }
@@ -24,6 +24,7 @@
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/protocol/block.hpp>
+#include <graphene/chain/protocol/signature_cache.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <algorithm>
@@ -32,9 +33,13 @@ namespace graphene { namespace chain {
 
 digest_type processed_transaction::merkle_digest()const
 {
-   digest_type::encoder enc;
-   fc::raw::pack( enc, *this );
-   return enc.result();
+   if( !_merkle_digest._hash[0] )
+   {
+      digest_type::encoder enc;
+      fc::raw::pack( enc, *this );
+      _merkle_digest = enc.result();
+   }
+   return _merkle_digest;
 }
 
 digest_type transaction::digest()const
@@ -122,40 +127,45 @@ struct sign_state
          return itr->second = true;
       }
 
-      optional<map<address,public_key_type>> available_address_sigs;
-      optional<map<address,public_key_type>> provided_address_sigs;
+      /** adds the address forms of k to key_addresses */
+      void add_addresses( const public_key_type& k )
+      {
+         key_addresses.emplace_back( address( pts_address( k, false, 56 ) ), k );
+         key_addresses.emplace_back( address( pts_address( k, true, 56 ) ), k );
+         key_addresses.emplace_back( address( pts_address( k, false, 0 ) ), k );
+         key_addresses.emplace_back( address( pts_address( k, true, 0 ) ), k );
+         key_addresses.emplace_back( address( k ), k );
+      }
+
+      /** the address forms of the provided and the available keys, sorted by address, provided keys first */
+      vector<std::pair<address,public_key_type>> key_addresses;
+      bool                                       key_addresses_known = false;
 
       bool signed_by( const address& a ) {
-         if( !available_address_sigs ) {
-            available_address_sigs = std::map<address,public_key_type>();
-            provided_address_sigs = std::map<address,public_key_type>();
-            for( auto& item : available_keys ) {
-             (*available_address_sigs)[ address(pts_address(item, false, 56) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, true, 56) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, false, 0) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, true, 0) ) ] = item;
-             (*available_address_sigs)[ address(item) ] = item;
-            }
-            for( auto& item : provided_signatures ) {
-             (*provided_address_sigs)[ address(pts_address(item.first, false, 56) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, true, 56) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, false, 0) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, true, 0) ) ] = item.first;
-             (*provided_address_sigs)[ address(item.first) ] = item.first;
-            }
+         if( !key_addresses_known ) {
+            key_addresses.reserve( 5 * ( provided_signatures.size() + available_keys.size() ) );
+            for( const auto& item : provided_signatures )
+               add_addresses( item.first );
+            for( const auto& item : available_keys )
+               if( provided_signatures.find( item ) == provided_signatures.end() )
+                  add_addresses( item );
+            std::stable_sort( key_addresses.begin(), key_addresses.end(),
+                              []( const std::pair<address,public_key_type>& x,
+                                  const std::pair<address,public_key_type>& y ) { return x.first < y.first; } );
+            key_addresses_known = true;
          }
-         auto itr = provided_address_sigs->find(a);
-         if( itr == provided_address_sigs->end() )
-         {
-            auto aitr = available_address_sigs->find(a);
-            if( aitr != available_address_sigs->end() ) {
-               auto pk = available_keys.find(aitr->second);
-               if( pk != available_keys.end() )
-                  return provided_signatures[aitr->second] = true;
-               return false;
-            }
-         }
-         return provided_signatures[itr->second] = true;
+         auto itr = std::lower_bound( key_addresses.begin(), key_addresses.end(), a,
+                                      []( const std::pair<address,public_key_type>& x, const address& y ) {
+                                         return x.first < y;
+                                      } );
+         if( itr == key_addresses.end() || itr->first != a )
+            return false;
+         auto sig = provided_signatures.find( itr->second );
+         if( sig != provided_signatures.end() )
+            return sig->second = true;
+         if( available_keys.find( itr->second ) != available_keys.end() )
+            return provided_signatures[itr->second] = true;
+         return false;
       }
 
       bool check_authority( account_id_type id )
@@ -194,8 +204,9 @@ struct sign_state
          {
             if( approved_by.find(a.first) == approved_by.end() )
             {
-               if( depth == max_recursion )
+               if( depth == max_recursion || known_unapproved( a.first, depth+1 ) )
                   continue;
+               const size_t approved_before = approved_by.size();
                if( check_authority( get_active( a.first ), depth+1 ) )
                {
                   approved_by.insert( a.first );
@@ -203,6 +214,9 @@ struct sign_state
                   if( total_weight >= auth.weight_threshold )
                      return true;
                }
+               // a walk that approved other accounts may pass when it is repeated, it is not cached
+               else if( approved_by.size() == approved_before )
+                  unapproved[a.first] = std::make_pair( depth+1, approved_before );
             }
             else
             {
@@ -214,6 +228,17 @@ struct sign_state
          return total_weight >= auth.weight_threshold;
       }
 
+      /**
+       *  An account whose walk failed without approving any account is not approved at that depth or deeper
+       *  either, until another account gets approved. Walking its authority again would only mark the same signatures as used,
+       *  so accounts that appear in many branches of a multisig tree are only walked once.
+       */
+      bool known_unapproved( account_id_type id, uint32_t depth )const
+      {
+         auto itr = unapproved.find( id );
+         return itr != unapproved.end() && itr->second.first <= depth && itr->second.second == approved_by.size();
+      }
+
       bool remove_unused_signatures()
       {
          vector<public_key_type> remove_sigs;
@@ -231,8 +256,9 @@ struct sign_state
                   const flat_set<public_key_type>& keys = empty_keyset )
       :get_active(a),available_keys(keys)
       {
+         provided_signatures.reserve( sigs.size() );
          for( const auto& key : sigs )
-            provided_signatures[ key ] = false;
+            provided_signatures.emplace_hint( provided_signatures.end(), key, false );
          approved_by.insert( GRAPHENE_TEMP_ACCOUNT  );
       }
 
@@ -241,6 +267,8 @@ struct sign_state
 
       flat_map<public_key_type,bool>   provided_signatures;
       flat_set<account_id_type>        approved_by;
+      /** accounts that were not approved, with the depth and the size of approved_by at that time */
+      flat_map<account_id_type,std::pair<uint32_t,size_t>> unapproved;
       uint32_t                         max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH;
 };
 
@@ -302,17 +330,22 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
 
 const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
 { try {
-   auto d = sig_digest( chain_id );
+   recover_signees( sig_digest( chain_id ) );
+   return _signees;
+} FC_CAPTURE_AND_RETHROW() }
+
+void signed_transaction::recover_signees( const digest_type& d )const
+{ try {
+   signature_cache& cache = signature_cache::instance();
    flat_set<public_key_type> result;
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( cache.recover( d, sig ) ).second,
             tx_duplicate_sig,
             "Duplicate Signature detected" );
    }
    _signees = std::move( result );
-   return _signees;
 } FC_CAPTURE_AND_RETHROW() }
 
 
@@ -378,13 +411,43 @@ set<public_key_type> signed_transaction::minimize_required_signatures(
    return set<public_key_type>( result.begin(), result.end() );
 }
 
+namespace {
+   /**
+    *  packs the unsigned part of trx into a buffer owned by the calling thread, the buffer keeps its capacity so
+    *  that precomputing a stream of transactions does not allocate for each of them. The result is only valid
+    *  until the same thread packs the next transaction.
+    */
+   const std::vector<char>& pack_into_thread_buffer( const transaction& trx )
+   {
+      static thread_local std::vector<char> buffer;
+      buffer.resize( fc::raw::pack_size( trx ) );
+      fc::datastream<char*> ds( buffer.data(), buffer.size() );
+      fc::raw::pack( ds, trx );
+      return buffer;
+   }
+}
+
+void precomputable_transaction::remember_packed( const std::vector<char>& packed )const
+{
+   const digest_type h = digest_type::hash( packed.data(), packed.size() );
+   memcpy(_tx_id_buffer._hash, h._hash, std::min(sizeof(_tx_id_buffer), sizeof(h)));
+   _packed_size = packed.size() + fc::raw::pack_size( signatures );
+}
+
 const transaction_id_type& precomputable_transaction::id()const
 {
-   if( !_tx_id_buffer._hash[0] )
-      transaction::id();
+   if( _packed_size == 0 )
+      remember_packed( pack_into_thread_buffer( *this ) );
    return _tx_id_buffer;
 }
 
+uint32_t precomputable_transaction::packed_size()const
+{
+   if( _packed_size == 0 )
+      remember_packed( pack_into_thread_buffer( *this ) );
+   return _packed_size;
+}
+
 void precomputable_transaction::validate() const
 {
    if( _validated ) return;
@@ -396,8 +459,18 @@ const flat_set<public_key_type>& precomputable_transaction::get_signature_keys(
 {
    // Strictly we should check whether the given chain ID is same as the one used to initialize the `signees` field.
    // However, we don't pass in another chain ID so far, for better performance, we skip the check.
-   if( _signees.empty() )
-      signed_transaction::get_signature_keys( chain_id );
+   if( !_signees_known )
+   {
+      // one packing of the transaction serves the signature digest, the id and the size
+      const std::vector<char>& packed = pack_into_thread_buffer( *this );
+      if( _packed_size == 0 )
+         remember_packed( packed );
+      digest_type::encoder enc;
+      fc::raw::pack( enc, chain_id );
+      enc.write( packed.data(), packed.size() );
+      recover_signees( enc.result() );
+      _signees_known = true;
+   }
    return _signees;
 }
 
@@ -23,6 +23,8 @@
  */
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/protocol/types.hpp>
+#include <graphene/chain/protocol/base58.hpp>
+#include <graphene/chain/protocol/key_string_cache.hpp>
 
 #include <fc/crypto/base58.hpp>
 #include <fc/crypto/ripemd160.hpp>
@@ -43,14 +45,16 @@ namespace graphene { namespace chain {
     {
       // TODO:  Refactor syntactic checks into static is_valid()
       //        to make public_key_type API more similar to address API
-       std::string prefix( GRAPHENE_ADDRESS_PREFIX );
-       const size_t prefix_len = prefix.size();
-       FC_ASSERT( base58str.size() > prefix_len );
-       FC_ASSERT( base58str.substr( 0, prefix_len ) ==  prefix , "", ("base58str", base58str) );
-       auto bin = fc::from_base58( base58str.substr( prefix_len ) );
-       auto bin_key = fc::raw::unpack<binary_key>(bin);
-       key_data = bin_key.data;
-       FC_ASSERT( fc::ripemd160::hash( key_data.data, key_data.size() )._hash[0] == bin_key.check );
+       key_data = key_string_cache::instance().key_from_string( base58str, [&base58str]() -> fc::ecc::public_key_data {
+          std::string prefix( GRAPHENE_ADDRESS_PREFIX );
+          const size_t prefix_len = prefix.size();
+          FC_ASSERT( base58str.size() > prefix_len );
+          FC_ASSERT( base58str.substr( 0, prefix_len ) ==  prefix , "", ("base58str", base58str) );
+          auto bin = from_base58( base58str.substr( prefix_len ) );
+          auto bin_key = fc::raw::unpack<binary_key>(bin);
+          FC_ASSERT( fc::ripemd160::hash( bin_key.data.data, bin_key.data.size() )._hash[0] == bin_key.check );
+          return bin_key.data;
+       });
     };
 
     public_key_type::operator fc::ecc::public_key_data() const
@@ -65,11 +69,13 @@ namespace graphene { namespace chain {
 
     public_key_type::operator std::string() const
     {
-       binary_key k;
-       k.data = key_data;
-       k.check = fc::ripemd160::hash( k.data.data, k.data.size() )._hash[0];
-       auto data = fc::raw::pack( k );
-       return GRAPHENE_ADDRESS_PREFIX + fc::to_base58( data.data(), data.size() );
+       return key_string_cache::instance().key_to_string( key_data, [this]() -> std::string {
+          binary_key k;
+          k.data = key_data;
+          k.check = fc::ripemd160::hash( k.data.data, k.data.size() )._hash[0];
+          auto data = fc::raw::pack( k );
+          return GRAPHENE_ADDRESS_PREFIX + to_base58( data.data(), data.size() );
+       });
     }
 
     bool operator == ( const public_key_type& p1, const fc::ecc::public_key& p2)
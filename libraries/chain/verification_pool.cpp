@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/verification_pool.hpp>
+
+#include <graphene/db/task_scheduler.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+verification_pool::verification_pool( uint32_t num_threads, const std::vector<uint32_t>& cpus )
+{
+   FC_ASSERT( num_threads > 0, "A verification pool needs at least one thread" );
+   _threads.reserve( num_threads );
+   for( uint32_t i = 0; i < num_threads; ++i )
+   {
+      _threads.emplace_back( new fc::thread( "verify-" + std::to_string( i ) ) );
+      if( !cpus.empty() )
+      {
+         const uint32_t cpu = cpus[i % cpus.size()];
+         _threads.back()->async( [cpu] () { graphene::db::pin_current_thread( cpu ); } ).wait();
+      }
+   }
+}
+
+verification_pool::~verification_pool()
+{
+   for( auto& thread : _threads )
+      thread->quit();
+}
+
+fc::future<void> verification_pool::post( const std::function<void()>& work )
+{
+   const uint32_t next = _next++ % _threads.size();
+   return _threads[next]->async( work, "verify" );
+}
+
+std::vector< fc::future<void> > verification_pool::post_batches( size_t count, size_t min_batch,
+                                                                 const std::function<void(size_t,size_t)>& work )
+{
+   std::vector< fc::future<void> > result;
+   if( count == 0 )
+      return result;
+   const size_t batch_size = std::max( std::max<size_t>( min_batch, 1 ), ( count + size() - 1 ) / size() );
+   result.reserve( ( count + batch_size - 1 ) / batch_size );
+   for( size_t begin = 0; begin < count; begin += batch_size )
+   {
+      const size_t end = std::min( count, begin + batch_size );
+      result.push_back( post( [work,begin,end] () { work( begin, end ); } ) );
+   }
+   return result;
+}
+
+} }
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally_cache.hpp>
+
+namespace graphene { namespace chain {
+
+std::set<account_id_type> vote_tally_cache::take_dirty()
+{
+   std::set<account_id_type> result;
+   result.swap( _dirty );
+   return result;
+}
+
+void vote_tally_cache::reset()
+{
+   _stakes.clear();
+   _opinions.clear();
+   _vote_totals.clear();
+   _witness_counts.clear();
+   _committee_counts.clear();
+   _total_voting_stake = 0;
+   _valid = false;
+}
+
+void vote_tally_cache::set_reconciled( uint32_t block_num, const block_id_type& block_id, bool count_non_member_votes )
+{
+   _block_num = block_num;
+   _block_id = block_id;
+   _count_non_member_votes = count_non_member_votes;
+   _valid = true;
+}
+
+void vote_tally_cache::add( const opinion_entry& opinion, uint64_t amount, bool subtract )
+{
+   auto apply = [amount,subtract]( uint64_t& total ) {
+      if( subtract )
+         total -= amount;
+      else
+         total += amount;
+   };
+   for( vote_id_type id : opinion.votes )
+   {
+      if( id.instance() >= _vote_totals.size() )
+         _vote_totals.resize( id.instance() + 1 );
+      apply( _vote_totals[id.instance()] );
+   }
+   apply( _witness_counts[opinion.num_witness] );
+   apply( _committee_counts[opinion.num_committee] );
+   apply( _total_voting_stake );
+}
+
+void vote_tally_cache::set_stake( account_id_type account, const account_object* opinion_account, uint64_t stake )
+{
+   const uint64_t instance = account.instance.value;
+   if( instance >= _stakes.size() )
+      _stakes.resize( instance + 1 );
+   stake_entry& entry = _stakes[instance];
+
+   if( entry.counted )
+   {
+      auto itr = _opinions.find( entry.opinion_account.instance.value );
+      FC_ASSERT( itr != _opinions.end() );
+      add( itr->second, entry.stake, true );
+      itr->second.stake -= entry.stake;
+      if( --itr->second.voters == 0 )
+         _opinions.erase( itr );
+      entry = stake_entry();
+   }
+
+   if( opinion_account == nullptr )
+      return;
+   auto itr = _opinions.find( opinion_account->id.instance() );
+   if( itr == _opinions.end() )
+   {
+      opinion_entry opinion;
+      opinion.votes = opinion_account->options.votes;
+      opinion.num_witness = opinion_account->options.num_witness;
+      opinion.num_committee = opinion_account->options.num_committee;
+      itr = _opinions.emplace( opinion_account->id.instance(), std::move( opinion ) ).first;
+   }
+   add( itr->second, stake, false );
+   itr->second.stake += stake;
+   ++itr->second.voters;
+   entry.opinion_account = opinion_account->id;
+   entry.stake = stake;
+   entry.counted = true;
+}
+
+void vote_tally_cache::update_opinion( const account_object& opinion_account )
+{
+   auto itr = _opinions.find( opinion_account.id.instance() );
+   if( itr == _opinions.end() )
+      return;
+   opinion_entry& opinion = itr->second;
+   if( opinion.votes == opinion_account.options.votes
+         && opinion.num_witness == opinion_account.options.num_witness
+         && opinion.num_committee == opinion_account.options.num_committee )
+      return;
+   add( opinion, opinion.stake, true );
+   opinion.votes = opinion_account.options.votes;
+   opinion.num_witness = opinion_account.options.num_witness;
+   opinion.num_committee = opinion_account.options.num_committee;
+   add( opinion, opinion.stake, false );
+}
+
+void vote_tally_cache::fill( vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram,
+                             uint16_t max_witness_count, vector<uint64_t>& committee_count_histogram,
+                             uint16_t max_committee_count, uint64_t& total_voting_stake )const
+{
+   // same rules as the full tally in perform_chain_maintenance()
+   const size_t votes = std::min( vote_tally.size(), _vote_totals.size() );
+   for( size_t i = 0; i < votes; ++i )
+      vote_tally[i] += _vote_totals[i];
+   for( const auto& count : _witness_counts )
+      if( count.first <= max_witness_count )
+         witness_count_histogram[ std::min( size_t(count.first / 2), witness_count_histogram.size() - 1 ) ]
+               += count.second;
+   for( const auto& count : _committee_counts )
+      if( count.first <= max_committee_count )
+         committee_count_histogram[ std::min( size_t(count.first / 2), committee_count_histogram.size() - 1 ) ]
+               += count.second;
+   total_voting_stake += _total_voting_stake;
+}
+
+} }
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/apply_phase.hpp>
+
+namespace graphene { namespace db {
+
+thread_local apply_phase_state apply_phase_state::current;
+
+const char* apply_phase_name( apply_phase phase )
+{
+   switch( phase )
+   {
+      case apply_phase::validate:     return "validate";
+      case apply_phase::authority:    return "authority";
+      case apply_phase::evaluate:     return "evaluate";
+      case apply_phase::apply:        return "apply";
+      case apply_phase::undo:         return "undo";
+      case apply_phase::plugins:      return "plugins";
+      case apply_phase::notification: return "notification";
+      case apply_phase::other:
+      default:                        return "other";
+   }
+}
+
+void apply_phase_listener::install( apply_phase_listener* listener )
+{
+   apply_phase_state& state = apply_phase_state::current;
+   state.listener = listener;
+   state.phase = apply_phase::other;
+   state.op_tag = -1;
+   if( listener != nullptr )
+      listener->on_phase( apply_phase::other, -1, false );
+}
+
+} } // graphene::db
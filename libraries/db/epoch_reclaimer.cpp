@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/epoch_reclaimer.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace graphene { namespace db {
+
+epoch_reclaimer::reader_guard::reader_guard( const epoch_reclaimer& reclaimer )
+   : _slot( reclaimer.acquire_slot() ) {}
+
+epoch_reclaimer::reader_guard::~reader_guard()
+{
+   _slot.store( 0 );
+}
+
+epoch_reclaimer::epoch_reclaimer() : _epoch( 1 )
+{
+   for( auto& slot : _slots )
+      slot.store( 0 );
+}
+
+epoch_reclaimer::~epoch_reclaimer()
+{
+   for( auto& item : _retired )
+      item.second();
+}
+
+std::atomic<uint64_t>& epoch_reclaimer::acquire_slot()const
+{
+   // All operations are sequentially consistent: a reader that announces its epoch before the writer scans the
+   // slots is seen by the scan, one that announces it later loads the pointers published before the scan.
+   for(;;)
+   {
+      for( auto& slot : _slots )
+      {
+         uint64_t expected = 0;
+         if( slot.load() == 0 && slot.compare_exchange_strong( expected, _epoch.load() ) )
+            return slot;
+      }
+      std::this_thread::yield();
+   }
+}
+
+void epoch_reclaimer::retire( std::function<void()> reclaim )
+{
+   _retired.emplace_back( _epoch.load(), std::move( reclaim ) );
+}
+
+size_t epoch_reclaimer::reclaim()
+{
+   _epoch.fetch_add( 1 );
+   uint64_t oldest = std::numeric_limits<uint64_t>::max();
+   for( const auto& slot : _slots )
+   {
+      const uint64_t announced = slot.load();
+      if( announced != 0 )
+         oldest = std::min( oldest, announced );
+   }
+   while( !_retired.empty() && _retired.front().first < oldest )
+   {
+      _retired.front().second();
+      _retired.pop_front();
+   }
+   return _retired.size();
+}
+
+} } // graphene::db
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/db/expiration_wheel.hpp>
+#include <graphene/db/dynamic_memory.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace db {
+
+namespace {
+   struct by_entry_id
+   {
+      bool operator()( const expiration_wheel::entry& a, const object_id_type& b )const { return a.id < b; }
+   };
+}
+
+uint32_t expiration_wheel::level_of( uint32_t time )const
+{
+   const uint32_t differing = time ^ _now;
+   uint32_t level = 0;
+   while( level < levels && ( differing >> ( ( level + 1 ) * slot_bits ) ) != 0 )
+      ++level;
+   return level;
+}
+
+void expiration_wheel::place( const entry& e )
+{
+   if( e.time <= _now )
+   {
+      _due.insert( e );
+      return;
+   }
+   const uint32_t level = level_of( e.time );
+   if( level == levels )
+   {
+      _overflow.insert( e );
+      return;
+   }
+   slot& s = slot_of( e.time, level );
+   if( s.empty() || s.back().id < e.id )
+      s.push_back( e ); // objects are usually created with increasing ids
+   else
+      s.insert( std::lower_bound( s.begin(), s.end(), e.id, by_entry_id() ), e );
+}
+
+void expiration_wheel::insert( uint32_t time, object_id_type id )
+{
+   place( entry{ time, id } );
+   ++_size;
+}
+
+void expiration_wheel::remove( uint32_t time, object_id_type id )
+{
+   const entry e{ time, id };
+   if( time <= _now )
+      _size -= _due.erase( e );
+   else
+   {
+      const uint32_t level = level_of( time );
+      if( level == levels )
+         _size -= _overflow.erase( e );
+      else
+      {
+         slot& s = slot_of( time, level );
+         const auto itr = std::lower_bound( s.begin(), s.end(), id, by_entry_id() );
+         if( itr != s.end() && itr->id == id )
+         {
+            s.erase( itr );
+            --_size;
+         }
+      }
+   }
+}
+
+void expiration_wheel::step()
+{
+   ++_now;
+   // the entries that now share the higher bits with the current time move down, the overflow first
+   if( ( _now & ( ( 1u << ( levels * slot_bits ) ) - 1 ) ) == 0 )
+   {
+      while( !_overflow.empty() && ( ( _overflow.begin()->time ^ _now ) >> ( levels * slot_bits ) ) == 0 )
+      {
+         const entry e = *_overflow.begin();
+         _overflow.erase( _overflow.begin() );
+         place( e );
+      }
+   }
+   for( uint32_t level = levels; level-- > 0; )
+   {
+      if( level > 0 && ( _now & ( ( 1u << ( level * slot_bits ) ) - 1 ) ) != 0 )
+         continue;
+      slot cascaded;
+      cascaded.swap( slot_of( _now, level ) );
+      for( const entry& e : cascaded )
+         place( e );
+   }
+}
+
+void expiration_wheel::rebuild( uint32_t now )
+{
+   std::vector<entry> entries( _overflow.begin(), _overflow.end() );
+   _overflow.clear();
+   for( auto& level : _slots )
+      for( slot& s : level )
+      {
+         entries.insert( entries.end(), s.begin(), s.end() );
+         slot().swap( s );
+      }
+   _now = now;
+   // placing them in id order keeps the slots sorted without moving entries around
+   std::sort( entries.begin(), entries.end(), []( const entry& a, const entry& b ) { return a.id < b.id; } );
+   for( const entry& e : entries )
+      place( e );
+}
+
+fc::optional<object_id_type> expiration_wheel::next_expired( uint32_t now )
+{
+   if( now > _now )
+   {
+      if( now - _now > max_steps )
+         rebuild( now );
+      else
+         while( _now < now )
+            step();
+   }
+   if( _due.empty() || _due.begin()->time > now )
+      return fc::optional<object_id_type>();
+   return _due.begin()->id;
+}
+
+uint64_t expiration_wheel::memory_usage()const
+{
+   uint64_t result = dynamic_memory_size( _due ) + dynamic_memory_size( _overflow );
+   for( const auto& level : _slots )
+      for( const slot& s : level )
+         result += s.capacity() * sizeof( entry );
+   return result;
+}
+
+} } // graphene::db
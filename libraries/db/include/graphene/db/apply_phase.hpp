@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace graphene { namespace db {
+
+   /** The parts of applying transactions and blocks that profilers attribute their measurements to */
+   enum class apply_phase : uint8_t
+   {
+      other,
+      validate,
+      authority,
+      evaluate,
+      apply,
+      undo,
+      plugins,
+      notification
+   };
+   const uint32_t apply_phase_count = 8;
+
+   const char* apply_phase_name( apply_phase phase );
+
+   /**
+    *  @brief Is told about the phase changes of the thread it is installed on
+    *
+    *  The database marks the phases with apply_phase_scope, which costs a thread local lookup while no listener is
+    *  installed. Phases nest, when a nested phase ends the enclosing one is reported again with resumed set.
+    */
+   class apply_phase_listener
+   {
+      public:
+         virtual ~apply_phase_listener() {}
+
+         /** @param op_tag the type of the operation the phase works on, -1 for the block as a whole */
+         virtual void on_phase( apply_phase phase, int64_t op_tag, bool resumed ) = 0;
+
+         /** Installs listener on the calling thread, nullptr uninstalls. The phase starts as other. */
+         static void install( apply_phase_listener* listener );
+   };
+
+   /** The phase of a thread, zero initialized so that the thread local needs no constructor */
+   struct apply_phase_state
+   {
+      apply_phase_listener* listener;
+      apply_phase           phase;
+      int64_t               op_tag;
+
+      static thread_local apply_phase_state current;
+   };
+
+   /** Enters a phase for its lifetime */
+   class apply_phase_scope
+   {
+      public:
+         /** enters phase for op_tag */
+         apply_phase_scope( apply_phase phase, int64_t op_tag )
+         {
+            apply_phase_state& state = apply_phase_state::current;
+            if( state.listener != nullptr )
+               enter( state, phase, op_tag );
+         }
+         /** enters phase for the operation of the enclosing phase */
+         explicit apply_phase_scope( apply_phase phase )
+         {
+            apply_phase_state& state = apply_phase_state::current;
+            if( state.listener != nullptr )
+               enter( state, phase, state.op_tag );
+         }
+         ~apply_phase_scope()
+         {
+            apply_phase_state& state = apply_phase_state::current;
+            // nothing to restore for a listener that was uninstalled in the meantime
+            if( _listener == nullptr || state.listener != _listener )
+               return;
+            state.phase = _previous_phase;
+            state.op_tag = _previous_op_tag;
+            _listener->on_phase( _previous_phase, _previous_op_tag, true );
+         }
+
+         apply_phase_scope( const apply_phase_scope& ) = delete;
+         apply_phase_scope& operator=( const apply_phase_scope& ) = delete;
+
+      private:
+         void enter( apply_phase_state& state, apply_phase phase, int64_t op_tag )
+         {
+            _listener = state.listener;
+            _previous_phase = state.phase;
+            _previous_op_tag = state.op_tag;
+            state.phase = phase;
+            state.op_tag = op_tag;
+            _listener->on_phase( phase, op_tag, false );
+         }
+
+         apply_phase_listener* _listener = nullptr;
+         apply_phase           _previous_phase = apply_phase::other;
+         int64_t               _previous_op_tag = -1;
+   };
+
+} } // graphene::db
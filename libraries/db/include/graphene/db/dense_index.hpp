@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+
+#include <bitset>
+#include <iterator>
+#include <type_traits>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class dense_index
+    *  @brief An index that stores objects contiguously in chunks addressed by object instance
+    *
+    *  Objects live in chunks of 2^ChunkBits slots and the slot of an object is given by its instance, so
+    *  a lookup by id is a single indexed load. Removing an object leaves an empty slot behind, a chunk is
+    *  released as soon as all of its slots are empty. Chunks never move, references to objects stay valid
+    *  until the objects are removed.
+    *
+    *  This index is preferred for object types that are created with increasing ids, are rarely removed
+    *  and only need to be accessed by ID. Other keys can be provided through secondary indexes.
+    */
+   template<typename T, uint8_t ChunkBits = 10>
+   class dense_index : public index
+   {
+      static_assert( ChunkBits > 0 && ChunkBits < 24, "Chunks should hold between 2 and 2^23 objects" );
+
+         static const uint64_t _chunk_size = 1ULL << ChunkBits;
+         static const uint64_t _mask = _chunk_size - 1;
+
+         struct chunk
+         {
+            typename std::aligned_storage< sizeof(T), alignof(T) >::type slots[_chunk_size];
+            std::bitset< _chunk_size >                                      used;
+            uint64_t                                                        count = 0;
+
+            T&       at( uint64_t slot )       { return *reinterpret_cast<T*>( &slots[slot] ); }
+            const T& at( uint64_t slot )const  { return *reinterpret_cast<const T*>( &slots[slot] ); }
+
+            ~chunk()
+            {
+               for( uint64_t slot = 0; count > 0 && slot < _chunk_size; ++slot )
+                  if( used[slot] )
+                  {
+                     at( slot ).~T();
+                     --count;
+                  }
+            }
+         };
+
+      public:
+         typedef T object_type;
+
+         virtual const object&  create( const std::function<void(object&)>& constructor ) override
+         {
+            T item;
+            item.id = get_next_id();
+            constructor( item );
+            item.id = get_next_id(); // just in case it changed
+            const T& result = emplace( std::move( item ) );
+            use_next_id();
+            return result;
+         }
+
+         virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         {
+            assert( find( obj.id ) == &obj );
+            modify_callback( const_cast<object&>( obj ) );
+         }
+
+         virtual const object& insert( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<T*>(&obj) );
+            return emplace( std::move( static_cast<T&>(obj) ) );
+         }
+
+         virtual void remove( const object& obj ) override
+         {
+            assert( nullptr != dynamic_cast<const T*>(&obj) );
+            const uint64_t instance = obj.id.instance();
+            const uint64_t c = instance >> ChunkBits;
+            const uint64_t slot = instance & _mask;
+            FC_ASSERT( c < _chunks.size() && _chunks[c] && _chunks[c]->used[slot], "Removing non-existent object" );
+            _chunks[c]->at( slot ).~T();
+            _chunks[c]->used.reset( slot );
+            --_size;
+            if( --_chunks[c]->count == 0 )
+            {
+               _chunks[c].reset();
+               while( !_chunks.empty() && !_chunks.back() )
+                  _chunks.pop_back();
+            }
+         }
+
+         virtual const object* find( object_id_type id )const override
+         {
+            assert( id.space() == T::space_id );
+            assert( id.type() == T::type_id );
+            return find_instance( id.instance() );
+         }
+
+         virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( const auto& obj : *this )
+                  inspector( obj );
+            } FC_CAPTURE_AND_RETHROW()
+         }
+
+         virtual uint64_t object_count()const override { return _size; }
+
+         virtual index_memory_usage get_memory_usage()const override
+         {
+            index_memory_usage usage = index::get_memory_usage();
+            usage.container_bytes = _chunks.capacity() * sizeof( unique_ptr<chunk> );
+            for( const auto& c : _chunks )
+               if( c )
+                  usage.container_bytes += sizeof( chunk ) - c->count * sizeof( T ); // unused slots
+            return usage;
+         }
+
+         virtual fc::uint128 hash()const override {
+            fc::uint128 result;
+            for( const auto& obj : *this )
+               result += obj.hash();
+            return result;
+         }
+
+         /** iterates over all objects in ascending id order */
+         class const_iterator
+         {
+            public:
+               typedef std::forward_iterator_tag iterator_category;
+               typedef T                         value_type;
+               typedef std::ptrdiff_t            difference_type;
+               typedef const T*                  pointer;
+               typedef const T&                  reference;
+
+               const_iterator( const dense_index& idx, uint64_t instance ) : _idx( &idx ), _instance( instance )
+               {
+                  skip_empty();
+               }
+
+               friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._instance == b._instance; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._instance != b._instance; }
+               const T& operator*()const  { return *_idx->find_instance( _instance ); }
+               const T* operator->()const { return _idx->find_instance( _instance ); }
+               const_iterator operator++(int)     // postfix
+               {
+                  const_iterator result( *this );
+                  ++(*this);
+                  return result;
+               }
+               const_iterator& operator++()       // prefix
+               {
+                  ++_instance;
+                  skip_empty();
+                  return *this;
+               }
+
+            private:
+               void skip_empty()
+               {
+                  const uint64_t end = _idx->end_instance();
+                  while( _instance < end && _idx->find_instance( _instance ) == nullptr )
+                  {
+                     if( !_idx->_chunks[_instance >> ChunkBits] ) // skip released chunks at once
+                        _instance = ( ( _instance >> ChunkBits ) + 1 ) << ChunkBits;
+                     else
+                        ++_instance;
+                  }
+                  if( _instance > end )
+                     _instance = end;
+               }
+
+               const dense_index* _idx;
+               uint64_t           _instance;
+         };
+         const_iterator begin()const { return const_iterator( *this, 0 ); }
+         const_iterator end()const   { return const_iterator( *this, end_instance() ); }
+
+         /** @return the number of objects in the index */
+         size_t size()const { return _size; }
+
+      private:
+         uint64_t end_instance()const { return uint64_t( _chunks.size() ) << ChunkBits; }
+
+         const T* find_instance( uint64_t instance )const
+         {
+            const uint64_t c = instance >> ChunkBits;
+            if( c >= _chunks.size() || !_chunks[c] ) return nullptr;
+            const uint64_t slot = instance & _mask;
+            if( !_chunks[c]->used[slot] ) return nullptr;
+            return &_chunks[c]->at( slot );
+         }
+
+         const T& emplace( T&& obj )
+         {
+            const uint64_t instance = obj.id.instance();
+            const uint64_t c = instance >> ChunkBits;
+            const uint64_t slot = instance & _mask;
+            if( c >= _chunks.size() )
+               _chunks.resize( c + 1 );
+            if( !_chunks[c] )
+               _chunks[c].reset( new chunk );
+            FC_ASSERT( !_chunks[c]->used[slot], "Could not insert object, its id is already in use" );
+            T* result = new( &_chunks[c]->slots[slot] ) T( std::move( obj ) );
+            _chunks[c]->used.set( slot );
+            ++_chunks[c]->count;
+            ++_size;
+            return *result;
+         }
+
+         vector< unique_ptr< chunk > > _chunks;
+         size_t                        _size = 0;
+   };
+
+} } // graphene::db
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    * Estimates the heap memory owned by the members of a value, not counting sizeof(value) itself.
+    *
+    * Strings, vectors, flat containers, maps, hash maps, sets and optionals are followed recursively, as are the
+    * members of reflected structs. Anything else is assumed to own no heap memory. Node based containers are charged
+    * a fixed per-node overhead that matches the usual red-black tree and hash table implementations.
+    */
+   template<typename T>
+   size_t dynamic_memory_size( const T& value );
+
+   namespace detail {
+      /** per-node bookkeeping of std::map and std::set: color, parent, left and right */
+      const size_t tree_node_overhead = 4 * sizeof(void*);
+      /** per-node bookkeeping of std::unordered_map: next pointer and cached hash, the buckets are counted apart */
+      const size_t hash_node_overhead = 2 * sizeof(void*);
+      /** strings up to this length are stored inline by the small string optimization */
+      const size_t inline_string_capacity = 15;
+
+      template<typename T>
+      size_t memory_size( const T& value, std::true_type /* reflected struct */ );
+      template<typename T>
+      size_t memory_size( const T& value, std::false_type );
+
+      inline size_t memory_size( const std::string& s )
+      { return s.capacity() > inline_string_capacity ? s.capacity() + 1 : 0; }
+      template<typename T>
+      size_t memory_size( const T& value );
+      template<typename T, typename... Ts>
+      size_t memory_size( const std::vector<T, Ts...>& v );
+      template<typename T, typename... Ts>
+      size_t memory_size( const boost::container::flat_set<T, Ts...>& s );
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const boost::container::flat_map<K, V, Ts...>& m );
+      template<typename T, typename... Ts>
+      size_t memory_size( const std::set<T, Ts...>& s );
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const std::map<K, V, Ts...>& m );
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const std::unordered_map<K, V, Ts...>& m );
+      template<typename A, typename B>
+      size_t memory_size( const std::pair<A, B>& p );
+      template<typename T>
+      size_t memory_size( const fc::optional<T>& o );
+
+      template<typename Range>
+      size_t elements_memory_size( const Range& r )
+      {
+         size_t result = 0;
+         for( const auto& item : r )
+            result += memory_size( item );
+         return result;
+      }
+
+      template<typename Class>
+      struct member_memory_visitor
+      {
+         member_memory_visitor( const Class& v, size_t& r ) : value( v ), result( r ) {}
+
+         template<typename Member, class C, Member (C::*member)>
+         void operator()( const char* )const
+         { result += memory_size( value.*member ); }
+
+         const Class& value;
+         size_t&      result;
+      };
+
+      template<typename T>
+      size_t memory_size( const T& value, std::true_type )
+      {
+         size_t result = 0;
+         fc::reflector<T>::visit( member_memory_visitor<T>( value, result ) );
+         return result;
+      }
+      template<typename T>
+      size_t memory_size( const T&, std::false_type ) { return 0; }
+
+      template<typename T>
+      size_t memory_size( const T& value )
+      {
+         return memory_size( value, std::integral_constant< bool, std::is_class<T>::value
+                                                                  && bool( fc::reflector<T>::is_defined::value ) >() );
+      }
+      template<typename T, typename... Ts>
+      size_t memory_size( const std::vector<T, Ts...>& v )
+      { return v.capacity() * sizeof(T) + elements_memory_size( v ); }
+      template<typename T, typename... Ts>
+      size_t memory_size( const boost::container::flat_set<T, Ts...>& s )
+      { return s.capacity() * sizeof(T) + elements_memory_size( s ); }
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const boost::container::flat_map<K, V, Ts...>& m )
+      { return m.capacity() * sizeof(std::pair<K, V>) + elements_memory_size( m ); }
+      template<typename T, typename... Ts>
+      size_t memory_size( const std::set<T, Ts...>& s )
+      { return s.size() * ( sizeof(T) + tree_node_overhead ) + elements_memory_size( s ); }
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const std::map<K, V, Ts...>& m )
+      { return m.size() * ( sizeof(std::pair<const K, V>) + tree_node_overhead ) + elements_memory_size( m ); }
+      template<typename K, typename V, typename... Ts>
+      size_t memory_size( const std::unordered_map<K, V, Ts...>& m )
+      {
+         return m.bucket_count() * sizeof(void*) + m.size() * ( sizeof(std::pair<const K, V>) + hash_node_overhead )
+              + elements_memory_size( m );
+      }
+      template<typename A, typename B>
+      size_t memory_size( const std::pair<A, B>& p )
+      { return memory_size( p.first ) + memory_size( p.second ); }
+      template<typename T>
+      size_t memory_size( const fc::optional<T>& o )
+      { return o.valid() ? memory_size( *o ) : 0; }
+   } // detail
+
+   template<typename T>
+   size_t dynamic_memory_size( const T& value )
+   { return detail::memory_size( value ); }
+
+} } // graphene::db
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class epoch_reclaimer
+    *  @brief Defers freeing memory a single writer replaced until no reader on another thread can still use it
+    *
+    *  A reader announces the current epoch in a slot for the duration of a reader_guard and only then loads
+    *  the pointers it reads through. The writer publishes the replacement first and retires the old memory,
+    *  which is tagged with the epoch of its retirement. reclaim() advances the epoch and runs the reclaim
+    *  functions of all memory retired before the oldest announced epoch, any reader that still holds such
+    *  memory announced that epoch or an earlier one.
+    *
+    *  Readers never wait for the writer. They only wait for each other if more than max_readers are active.
+    *  retire() and reclaim() must be called on the writer thread.
+    */
+   class epoch_reclaimer
+   {
+      public:
+         static const size_t max_readers = 64;
+
+         class reader_guard
+         {
+            public:
+               explicit reader_guard( const epoch_reclaimer& reclaimer );
+               ~reader_guard();
+
+               reader_guard( const reader_guard& ) = delete;
+               reader_guard& operator=( const reader_guard& ) = delete;
+
+            private:
+               std::atomic<uint64_t>& _slot;
+         };
+
+         epoch_reclaimer();
+         /** runs all pending reclaim functions, there must be no readers left */
+         ~epoch_reclaimer();
+
+         /** reclaim is called once no reader that started before this call is active anymore */
+         void retire( std::function<void()> reclaim );
+         /** advances the epoch and reclaims what no active reader can hold, @return the number still pending */
+         size_t reclaim();
+
+         size_t pending()const { return _retired.size(); }
+         uint64_t epoch()const { return _epoch.load(); }
+
+      private:
+         std::atomic<uint64_t>& acquire_slot()const;
+
+         /// the announced epochs of the active readers, 0 for a free slot
+         mutable std::array< std::atomic<uint64_t>, max_readers > _slots;
+         /// starts at 1 so that no announced epoch is 0
+         std::atomic<uint64_t>                                      _epoch;
+         std::deque< std::pair< uint64_t, std::function<void()> > > _retired;
+   };
+
+} } // graphene::db
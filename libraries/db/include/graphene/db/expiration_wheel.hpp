@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+#include <array>
+#include <set>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class expiration_wheel
+    *  @brief A hierarchical timing wheel of object ids by expiration time in seconds
+    *
+    *  Four levels of 64 slots cover the 2^24 seconds (194 days) after the current time of the wheel, level L
+    *  holding the entries whose time first differs from the current time in the L-th group of six bits. An
+    *  insertion appends to one slot instead of rebalancing a tree, and as the wheel is advanced the slot that
+    *  comes up on each level is spread over the levels below until its entries are due. Entries further out
+    *  wait in an ordered overflow set.
+    *
+    *  The wheel only moves forward. Times before its current time, e.g. after blocks were popped and a fork
+    *  with earlier block times is applied, go to the due entries, and next_expired() still only returns those
+    *  that expire at or before the time it is given. The result therefore only depends on the entries in the
+    *  wheel, which is what an undo needs: inserting an entry again restores the previous state.
+    */
+   class expiration_wheel
+   {
+      public:
+         struct entry
+         {
+            uint32_t       time;
+            object_id_type id;
+         };
+
+         void insert( uint32_t time, object_id_type id );
+         void remove( uint32_t time, object_id_type id );
+
+         /**
+          *  Moves the wheel forward to now.
+          *  @return the id that expires first, and among those with the same time the lowest, if it expires at
+          *          or before now
+          */
+         fc::optional<object_id_type> next_expired( uint32_t now );
+
+         size_t   size()const { return _size; }
+         uint64_t memory_usage()const;
+
+      private:
+         static const uint32_t slot_bits = 6;
+         static const uint32_t slot_count = 1 << slot_bits;
+         static const uint32_t levels = 4;
+         /** advancing further than this at once rebuilds the wheel instead of stepping through every second */
+         static const uint32_t max_steps = slot_count * slot_count;
+
+         struct time_then_id
+         {
+            bool operator()( const entry& a, const entry& b )const
+            { return a.time != b.time ? a.time < b.time : a.id < b.id; }
+         };
+         typedef std::set< entry, time_then_id > ordered_entries;
+         /** the entries of a slot, sorted by id so that recently created objects are removed from the end */
+         typedef std::vector< entry > slot;
+
+         /** @return the level of a time after the current time, levels for the overflow */
+         uint32_t level_of( uint32_t time )const;
+         slot&    slot_of( uint32_t time, uint32_t level )
+         { return _slots[level][ ( time >> ( level * slot_bits ) ) & ( slot_count - 1 ) ]; }
+         /** puts an entry where it belongs relative to the current time */
+         void     place( const entry& e );
+         void     step();
+         void     rebuild( uint32_t now );
+
+         uint32_t                                                  _now = 0;
+         size_t                                                    _size = 0;
+         /** entries with a time up to _now */
+         ordered_entries                                           _due;
+         std::array< std::array< slot, slot_count >, levels >      _slots;
+         ordered_entries                                           _overflow;
+   };
+
+   /**
+    *  @class expiring_index
+    *  @brief A secondary index that keeps the objects of its primary index in an expiration_wheel
+    *
+    *  ExpirationOf is a key extractor like those of boost::multi_index that gives the fc::time_point_sec at
+    *  which an object expires. It replaces an ordered index by expiration for loops that take the first
+    *  expired object, process and remove it until none is left, and yields the objects in the same order as a
+    *  composite (expiration, id) key.
+    */
+   template<typename ObjectType, typename ExpirationOf>
+   class expiring_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override
+         { _wheel.insert( expiration( obj ), obj.id ); }
+         virtual void object_removed( const object& obj ) override
+         { _wheel.remove( expiration( obj ), obj.id ); }
+         virtual void about_to_modify( const object& before ) override
+         { _expiration_before = expiration( before ); }
+         virtual void object_modified( const object& after ) override
+         {
+            const uint32_t expiration_after = expiration( after );
+            if( expiration_after == _expiration_before )
+               return;
+            _wheel.remove( _expiration_before, after.id );
+            _wheel.insert( expiration_after, after.id );
+         }
+         virtual uint64_t estimated_memory_usage()const override { return _wheel.memory_usage(); }
+         virtual bool is_self_contained()const override { return true; }
+
+         /** @return the id of the object that expires first, if it expires at or before now */
+         fc::optional<object_id_type> next_expired( fc::time_point_sec now )
+         { return _wheel.next_expired( now.sec_since_epoch() ); }
+
+         size_t size()const { return _wheel.size(); }
+
+      private:
+         static uint32_t expiration( const object& obj )
+         {
+            assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
+            return ExpirationOf()( static_cast<const ObjectType&>(obj) ).sec_since_epoch();
+         }
+
+         expiration_wheel _wheel;
+         uint32_t         _expiration_before = 0;
+   };
+
+} } // graphene::db
@@ -23,21 +23,27 @@
  */
 #pragma once
 #include <graphene/db/index.hpp>
+#include <graphene/db/pooled_allocator.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace graphene { namespace chain {
 
    using boost::multi_index_container;
    using namespace boost::multi_index;
+   using graphene::db::pooled_allocator;
 
    struct by_id{};
    /**
     *  Almost all objects can be tracked and managed via a boost::multi_index container that uses
     *  an unordered_unique key on the object ID.  This template class adapts the generic index interface
     *  to work with arbitrary boost multi_index containers on the same type.
+    *
+    *  The allocator of MultiIndexType decides where the container nodes live. Indexes with a high rate
+    *  of insertions and removals should use pooled_allocator, which recycles the fixed-size nodes.
     */
    template<typename ObjectType, typename MultiIndexType>
    class generic_index : public index
@@ -54,6 +60,17 @@ namespace graphene { namespace chain {
             return *insert_result.first;
          }
 
+         virtual const object& insert_presorted( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<ObjectType*>(&obj) );
+            // the end() hint makes appending to the id-ordered primary key amortized constant
+            const auto old_size = _indices.size();
+            auto insert_result = _indices.insert( _indices.end(), std::move( static_cast<ObjectType&>(obj) ) );
+            FC_ASSERT( _indices.size() > old_size,
+                       "Could not insert object, most likely a uniqueness constraint was violated" );
+            return *insert_result;
+         }
+
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             ObjectType item;
@@ -112,6 +129,17 @@ namespace graphene { namespace chain {
 
          const index_type& indices()const { return _indices; }
 
+         virtual uint64_t object_count()const override { return _indices.size(); }
+
+         virtual index_memory_usage get_memory_usage()const override
+         {
+            index_memory_usage usage = index::get_memory_usage();
+            // every ordered index adds a node header of parent, left and right pointers per object
+            const size_t index_count = boost::mpl::size< typename index_type::index_type_list >::value;
+            usage.container_bytes = _indices.size() * index_count * 3 * sizeof(void*);
+            return usage;
+         }
+
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _indices )
@@ -123,7 +151,6 @@ namespace graphene { namespace chain {
          }
 
       private:
-         fc::uint128 _current_hash;
          index_type  _indices;
    };
 
@@ -131,8 +158,9 @@ namespace graphene { namespace chain {
     * @brief An index type for objects which may be deleted
     *
     * This is the preferred index type for objects which need only be referenced by ID, but may be deleted.
+    * Nodes are recycled through a pool of their own by default.
     */
-   template< class T >
+   template< class T, class Allocator = pooled_allocator<T> >
    struct sparse_index : public generic_index<T, boost::multi_index_container<
       T,
       indexed_by<
@@ -140,7 +168,8 @@ namespace graphene { namespace chain {
             tag<by_id>,
             member<object, object_id_type, &object::id>
          >
-      >
+      >,
+      Allocator
    >>{};
 
 } }
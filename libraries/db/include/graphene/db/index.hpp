@@ -30,6 +30,8 @@
 #include <fc/crypto/sha256.hpp>
 
 #include <fstream>
+#include <functional>
+#include <map>
 #include <stack>
 
 namespace graphene { namespace db {
@@ -52,6 +54,28 @@ namespace graphene { namespace db {
          virtual void on_modify( const object& obj ){}
    };
 
+   /**
+    *  @brief Estimated memory consumption of a single index, see index::get_memory_usage()
+    */
+   struct index_memory_usage
+   {
+      uint8_t  space_id              = 0;
+      uint8_t  type_id               = 0;
+      string   object_type;
+      uint64_t object_count          = 0;
+      /** sum of sizeof() of all objects */
+      uint64_t object_bytes          = 0;
+      /** heap memory owned by strings, vectors, sets and other dynamic members of the objects */
+      uint64_t dynamic_bytes         = 0;
+      /** bookkeeping of the container that holds the objects, such as tree nodes and pointer tables */
+      uint64_t container_bytes       = 0;
+      /** memory used by the secondary indexes, as far as they report it */
+      uint64_t secondary_index_bytes = 0;
+
+      uint64_t total_bytes()const
+      { return object_bytes + dynamic_bytes + container_bytes + secondary_index_bytes; }
+   };
+
    /**
     *  @class index
     *  @brief abstract base class for accessing objects indexed in various ways.
@@ -81,6 +105,13 @@ namespace graphene { namespace db {
          virtual void           set_next_id( object_id_type id ) = 0;
 
          virtual const object&  load( const std::vector<char>& data ) = 0;
+
+         /**
+          *  Inserts an object whose id is greater than the id of any object currently in the index.
+          *  Implementations may use this to append in amortized constant time instead of doing a
+          *  full lookup, the default simply forwards to insert().
+          */
+         virtual const object& insert_presorted( object&& obj ) { return insert( std::move(obj) ); }
          /**
           *  Polymorphically insert by moving an object into the index.
           *  this should throw if the object is already in the database.
@@ -97,7 +128,26 @@ namespace graphene { namespace db {
           *  Opens the index loading objects from a file
           */
          virtual void open( const fc::path& db ) = 0;
+         /**
+          *  Opens the index like open(), but leaves the secondary indexes that are self-contained empty
+          *  @return one task per such secondary index that fills it, the tasks may run concurrently
+          */
+         virtual std::vector< std::function<void()> > open_deferred( const fc::path& db )
+         {
+            open( db );
+            return std::vector< std::function<void()> >();
+         }
          virtual void save( const fc::path& db ) = 0;
+         /** Writes what save() writes to a file into out, starting at its current position */
+         virtual void save( std::ostream& out ) = 0;
+
+         /**
+          *  @return true if objects were added, modified or removed since the index was last opened
+          *  or saved. Indexes that do not track changes are always considered dirty.
+          */
+         virtual bool is_dirty()const { return true; }
+         /** Called after the index has been persisted, resets the dirty state */
+         virtual void clear_dirty() {}
 
 
 
@@ -131,10 +181,40 @@ namespace graphene { namespace db {
 
          virtual void               inspect_all_objects(std::function<void(const object&)> inspector)const = 0;
          virtual fc::uint128        hash()const = 0;
+         /**
+          *  Walks all objects to estimate the memory used by this index. Implementations add their
+          *  container overhead to what the default computes from the objects themselves.
+          */
+         virtual index_memory_usage get_memory_usage()const;
+         /** @return the number of objects, the default walks them, implementations that know it return it right away */
+         virtual uint64_t           object_count()const;
          virtual void               add_observer( const shared_ptr<index_observer>& ) = 0;
 
          virtual void               object_from_variant( const fc::variant& var, object& obj, uint32_t max_depth )const = 0;
          virtual void               object_default( object& obj )const = 0;
+         /** @return the variant of an object of this index given in fc::raw packed form */
+         virtual fc::variant        packed_object_to_variant( const std::vector<char>& data, uint32_t max_depth )const = 0;
+   };
+
+   /**
+    *  @brief Header of the on-disk snapshot of a single primary_index
+    *
+    *  The header is followed by zero padding up to the next page boundary and then by
+    *  object_count packed objects in ascending id order, each prefixed with its size as
+    *  an fc::unsigned_int. The page-aligned, presorted layout allows the file to be mapped
+    *  and bulk-loaded without per-object lookups.
+    */
+   struct index_snapshot_header
+   {
+      static const uint64_t magic          = 0x31504e5342444752ULL; ///< "RGDBSNP1"
+      static const uint32_t current_format = 1;
+      static const uint32_t page_size      = 4096;
+
+      uint64_t       magic_number  = magic;
+      uint32_t       format        = current_format;
+      object_id_type next_id;
+      fc::sha256     object_version;
+      uint64_t       object_count  = 0;
    };
 
    class secondary_index
@@ -145,6 +225,80 @@ namespace graphene { namespace db {
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
+         /** @return an estimate of the heap memory used by this index */
+         virtual uint64_t estimated_memory_usage()const { return 0; }
+         /**
+          * @return true if the index only reads the objects it is told about and only writes its own state.
+          * Such indexes are filled concurrently with each other by object_database::open(), each still sees the
+          * objects of its primary index in ascending id order.
+          */
+         virtual bool is_self_contained()const { return false; }
+   };
+
+   /**
+    * @class batched_secondary_index
+    * @brief A secondary index that is told about changes in batches instead of one at a time
+    *
+    * Changes are coalesced per object until object_database::flush_batched_indexes() is called, which the
+    * chain database does after every pushed transaction and every applied or popped block. Each object that
+    * changed is then reported once, with its value from before the batch and its current value, no matter how
+    * often it was modified in between. Objects created and removed again within a batch are not reported.
+    *
+    * Contents of a batched index lag behind the primary index until the next flush, so it must not be used
+    * in evaluation.
+    */
+   class batched_secondary_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override final;
+         virtual void object_removed( const object& obj ) override final;
+         virtual void about_to_modify( const object& before ) override final;
+         virtual void object_modified( const object& after  ) override final {}
+
+         /**
+          * Called once per changed object when the batch is flushed, in ascending id order.
+          * @param before the value before the batch, nullptr if the object was created within the batch
+          * @param after the current value, nullptr if the object was removed within the batch
+          */
+         virtual void object_changed( const object* before, const object* after ) = 0;
+         /** Called after the changes of a flush were reported */
+         virtual void batch_flushed() {}
+
+         /** Reports all pending changes and starts a new batch */
+         void flush();
+         bool has_pending_changes()const { return !_pending.empty(); }
+
+      private:
+         struct pending_change
+         {
+            unique_ptr<object> before;
+            const object*      after = nullptr;
+         };
+         std::map< object_id_type, pending_change > _pending;
+   };
+
+   /**
+    * @class hash_index
+    * @brief A secondary index that maintains the sum of the hashes of all objects in its primary index
+    *
+    * The sum equals what index::hash() computes by walking all objects, but is updated on every change.
+    * Updating costs a hash of the object before and after each modification, which is why the index is
+    * only installed by object_database::enable_incremental_hash().
+    */
+   class hash_index : public secondary_index
+   {
+      public:
+         explicit hash_index( const fc::uint128& initial ) : _hash( initial ) {}
+
+         virtual void object_inserted( const object& obj ) override     { _hash += obj.hash(); }
+         virtual void object_removed( const object& obj ) override      { _hash -= obj.hash(); }
+         virtual void about_to_modify( const object& before ) override  { _hash -= before.hash(); }
+         virtual void object_modified( const object& after ) override   { _hash += after.hash(); }
+
+         const fc::uint128& hash()const { return _hash; }
+
+      private:
+         fc::uint128 _hash;
    };
 
    /**
@@ -155,8 +309,8 @@ namespace graphene { namespace db {
       public:
          base_primary_index( object_database& db ):_db(db){}
 
-         /** called just before obj is modified */
-         void save_undo( const object& obj );
+         /** called just before obj is modified, if packed is set the undo copy is kept in packed form */
+         void save_undo( const object& obj, bool packed = false );
 
          /** called just after the object is added */
          void on_add( const object& obj );
@@ -167,10 +321,23 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
+         /** @return true if any object was added, modified or removed since the last open or save */
+         bool has_changes()const { return _dirty; }
+
+         /**
+          * Until end_deferred_fill(), objects created in the index are not reported to its self-contained secondary
+          * indexes, which must not be used meanwhile, and the objects must not be modified or removed. Meant for
+          * bulk loads such as the genesis state.
+          */
+         virtual void begin_deferred_fill() = 0;
+         /** @return tasks that report all objects to the self-contained secondary indexes, they may run in parallel */
+         virtual std::vector< std::function<void()> > end_deferred_fill() = 0;
+
          template<typename T, typename... Args>
          T* add_secondary_index(Args... args)
          {
             _sindex.emplace_back( new T(args...) );
+            secondary_index_added( *_sindex.back() );
             return static_cast<T*>(_sindex.back().get());
          }
 
@@ -186,8 +353,26 @@ namespace graphene { namespace db {
          }
 
       protected:
+         /**
+          * Held by primary_index for the duration of every change, keeps read_snapshot lookups out while the
+          * index is inconsistent. Nested changes are allowed.
+          */
+         class write_guard
+         {
+            public:
+               explicit write_guard( base_primary_index& idx ) : _idx( idx ) { _idx.begin_write(); }
+               ~write_guard() { _idx.end_write(); }
+            private:
+               base_primary_index& _idx;
+         };
+
+         void begin_write();
+         void end_write();
+         void secondary_index_added( secondary_index& sindex );
+
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         bool                                   _dirty = false;
 
       private:
          object_database& _db;
@@ -273,6 +458,14 @@ namespace graphene { namespace db {
             ids_being_modified.pop();
          }
 
+         virtual uint64_t estimated_memory_usage()const override
+         {
+            uint64_t result = content.capacity() * sizeof( content[0] );
+            for( const auto& chunk : content )
+               result += chunk.capacity() * sizeof( const Object* );
+            return result;
+         }
+
          template< typename object_id >
          const Object* find( const object_id& id )const
          {
@@ -327,7 +520,7 @@ namespace graphene { namespace db {
 
          virtual object_id_type get_next_id()const override              { return _next_id;    }
          virtual void           use_next_id()override                    { ++_next_id.number;  }
-         virtual void           set_next_id( object_id_type id )override { _next_id = id;      }
+         virtual void           set_next_id( object_id_type id )override { _next_id = id; _dirty = true; }
 
          /** @return the object with id or nullptr if not found */
          virtual const object*  find( object_id_type id )const override
@@ -337,6 +530,17 @@ namespace graphene { namespace db {
             return DerivedIndex::find( id );
          }
 
+         virtual index_memory_usage get_memory_usage()const override
+         {
+            index_memory_usage usage = DerivedIndex::get_memory_usage();
+            usage.space_id = object_space_id();
+            usage.type_id = object_type_id();
+            usage.object_type = fc::get_typename<object_type>::name();
+            for( const auto& item : _sindex )
+               usage.secondary_index_bytes += item->estimated_memory_usage();
+            return usage;
+         }
+
          fc::sha256 get_object_version()const
          {
             std::string desc = "1.0";//get_type_description<object_type>();
@@ -344,22 +548,52 @@ namespace graphene { namespace db {
          }
 
          virtual void open( const path& db )override
-         { 
-            if( !fc::exists( db ) ) return;
+         {
+            for( const auto& fill : open_deferred( db ) )
+               fill();
+         }
+
+         virtual std::vector< std::function<void()> > open_deferred( const path& db )override
+         {
+            std::vector< std::function<void()> > fills;
+            if( !fc::exists( db ) ) return fills;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
             fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
 
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            vector<char> tmp;
-            while( ds.remaining() > 0 )
+            uint64_t magic = 0;
+            if( ds.remaining() >= sizeof(magic) )
+               fc::raw::unpack( ds, magic );
+            _deferring = true;
+            try
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               if( magic == index_snapshot_header::magic )
+                  open_snapshot( ds );
+               else
+               {
+                  // files written before the snapshot format was introduced start with the next id
+                  fc::datastream<const char*> legacy( (const char*)mr.get_address(), mr.get_size() );
+                  open_legacy( legacy );
+               }
+            }
+            catch( ... )
+            {
+               _deferring = false;
+               throw;
             }
+            _deferring = false;
+            return self_contained_fills();
+         }
+
+         virtual void begin_deferred_fill() override
+         {
+            _deferring = true;
+         }
+
+         virtual std::vector< std::function<void()> > end_deferred_fill() override
+         {
+            _deferring = false;
+            return self_contained_fills();
          }
 
          virtual void save( const path& db ) override 
@@ -367,9 +601,31 @@ namespace graphene { namespace db {
             std::ofstream out( db.generic_string(), 
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
+            save( out );
+            FC_ASSERT( out, "Failed to write ${f}", ("f",db) );
+         }
+
+         virtual void save( std::ostream& out ) override
+         {
+            const auto start = out.tellp();
+            index_snapshot_header header;
+            header.next_id = _next_id;
+            header.object_version = get_object_version();
+            this->inspect_all_objects( [&header]( const object& ) { ++header.object_count; } );
+
+            fc::raw::pack( out, header.magic_number );
+            fc::raw::pack( out, header.format );
+            fc::raw::pack( out, header.next_id );
+            fc::raw::pack( out, header.object_version );
+            fc::raw::pack( out, header.object_count );
+            const size_t header_size = out.tellp() - start;
+            const size_t padding = ( index_snapshot_header::page_size
+                                     - header_size % index_snapshot_header::page_size )
+                                   % index_snapshot_header::page_size;
+            const std::vector<char> zeros( padding, 0 );
+            out.write( zeros.data(), zeros.size() );
+
+            // inspect_all_objects() walks the objects in ascending id order, which is what open_snapshot() relies on
             this->inspect_all_objects( [&]( const object& o ) {
                 auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
                 auto packed_vec = fc::raw::pack( vec );
@@ -377,35 +633,39 @@ namespace graphene { namespace db {
             });
          }
 
+         virtual bool is_dirty()const override { return _dirty; }
+         virtual void clear_dirty() override   { _dirty = false; }
+
          virtual const object&  load( const std::vector<char>& data )override
          {
+            write_guard guard( *this );
             const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
+            inserted( result );
             return result;
          }
 
 
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
+            write_guard guard( *this );
             const auto& result = DerivedIndex::create( constructor );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
+            inserted( result );
             on_add( result );
             return result;
          }
 
          virtual const object& insert( object&& obj ) override
          {
+            write_guard guard( *this );
             const auto& result = DerivedIndex::insert( std::move( obj ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
+            inserted( result );
             on_add( result );
             return result;
          }
 
          virtual void  remove( const object& obj ) override
          {
+            write_guard guard( *this );
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
@@ -414,7 +674,8 @@ namespace graphene { namespace db {
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
-            save_undo( obj );
+            write_guard guard( *this );
+            save_undo( obj, is_packed_undo_type<object_type>::value );
             for( const auto& item : _sindex )
                item->about_to_modify( obj );
             DerivedIndex::modify( obj, m );
@@ -446,9 +707,93 @@ namespace graphene { namespace db {
             obj.id = id;
          }
 
+         virtual fc::variant packed_object_to_variant( const std::vector<char>& data, uint32_t max_depth )const override
+         {
+            object_type result;
+            fc::raw::unpack( data, result );
+            return fc::variant( result, max_depth );
+         }
+
       private:
+         /** tells the secondary indexes about a new object, except the self-contained ones while they are deferred */
+         void inserted( const object& result )
+         {
+            for( const auto& item : _sindex )
+               if( !_deferring || !item->is_self_contained() )
+                  item->object_inserted( result );
+         }
+
+         std::vector< std::function<void()> > self_contained_fills()
+         {
+            std::vector< std::function<void()> > fills;
+            for( const auto& item : _sindex )
+            {
+               if( !item->is_self_contained() )
+                  continue;
+               secondary_index* sindex = item.get();
+               fills.push_back( [this,sindex] () {
+                  this->inspect_all_objects( [sindex]( const object& o ) { sindex->object_inserted( o ); } );
+               });
+            }
+            return fills;
+         }
+
+         void open_snapshot( fc::datastream<const char*>& ds )
+         {
+            index_snapshot_header header;
+            fc::raw::unpack( ds, header.format );
+            FC_ASSERT( header.format == index_snapshot_header::current_format,
+                       "Unsupported snapshot format ${f}", ("f",header.format) );
+            fc::raw::unpack( ds, header.next_id );
+            fc::raw::unpack( ds, header.object_version );
+            fc::raw::unpack( ds, header.object_count );
+            FC_ASSERT( header.object_version == get_object_version(),
+                       "Incompatible Version, the serialization of objects in this index has changed" );
+            const size_t header_size = ds.tellp();
+            const size_t padding = ( index_snapshot_header::page_size
+                                     - header_size % index_snapshot_header::page_size )
+                                   % index_snapshot_header::page_size;
+            ds.skip( padding );
+            _next_id = header.next_id;
+
+            object_id_type last_id;
+            for( uint64_t i = 0; i < header.object_count; ++i )
+            {
+               fc::unsigned_int size;
+               fc::raw::unpack( ds, size );
+               FC_ASSERT( ds.remaining() >= size.value, "Truncated snapshot" );
+               fc::datastream<const char*> obj_ds( ds.pos(), size.value );
+               object_type obj;
+               fc::raw::unpack( obj_ds, obj );
+               ds.skip( size.value );
+               FC_ASSERT( i == 0 || last_id < obj.id, "Snapshot is not sorted by id" );
+               last_id = obj.id;
+               inserted( DerivedIndex::insert_presorted( std::move( obj ) ) );
+            }
+         }
+
+         void open_legacy( fc::datastream<const char*>& ds )
+         {
+            fc::sha256 open_ver;
+
+            fc::raw::unpack(ds, _next_id);
+            fc::raw::unpack(ds, open_ver);
+            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            vector<char> tmp;
+            while( ds.remaining() > 0 )
+            {
+               fc::raw::unpack( ds, tmp );
+               load( tmp );
+            }
+         }
+
          object_id_type                                 _next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
+         bool                                           _deferring = false;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::index_memory_usage,
+            (space_id)(type_id)(object_type)(object_count)(object_bytes)(dynamic_bytes)(container_bytes)
+            (secondary_index_bytes) )
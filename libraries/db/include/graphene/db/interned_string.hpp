@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/io/varint.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <atomic>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace fc { class variant; }
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class interned_string
+    *  @brief An immutable string that shares its characters with every equal interned_string
+    *
+    *  Each distinct value is stored once in a process-wide pool together with its hash, an interned_string only
+    *  points to its entry. Copies, such as the undo copies of the objects that hold one, copy a pointer, equal
+    *  values are compared by pointer and hashed without looking at the characters. Entries are reference counted
+    *  and leave the pool with their last holder, so names of objects that were created and undone, e.g. in
+    *  pending transactions that never made it into a block, do not stay in memory.
+    *
+    *  Serialized and converted to variants exactly like a std::string, and ordered like one.
+    */
+   class interned_string
+   {
+      public:
+         interned_string();
+         explicit interned_string( const std::string& value ) : _entry( intern( value ) ) {}
+         interned_string( const interned_string& other ) : _entry( other._entry ) { add_ref( _entry ); }
+         ~interned_string() { release( _entry ); }
+
+         interned_string& operator=( const interned_string& other )
+         {
+            add_ref( other._entry );
+            release( _entry );
+            _entry = other._entry;
+            return *this;
+         }
+         interned_string& operator=( const std::string& value )
+         {
+            const entry* e = intern( value );
+            release( _entry );
+            _entry = e;
+            return *this;
+         }
+
+         const std::string& str()const { return _entry->value; }
+         operator const std::string&()const { return _entry->value; }
+
+         const char* c_str()const { return _entry->value.c_str(); }
+         size_t      size()const  { return _entry->value.size(); }
+         bool        empty()const { return _entry->value.empty(); }
+         /** @return std::hash<std::string> of the value, computed once when it was interned */
+         size_t      hash()const  { return _entry->hash; }
+         /** @return the number of interned_strings sharing this value */
+         size_t      use_count()const { return _entry->refs.load( std::memory_order_relaxed ); }
+
+         friend bool operator==( const interned_string& a, const interned_string& b )
+         { return a._entry == b._entry; }
+         friend bool operator<( const interned_string& a, const interned_string& b )
+         { return a._entry != b._entry && a._entry->value < b._entry->value; }
+
+      private:
+         struct entry
+         {
+            entry( const std::string& value, size_t hash ) : value( value ), hash( hash ), refs( 0 ) {}
+            entry( const entry& other ) : value( other.value ), hash( other.hash ), refs( other.refs.load() ) {}
+
+            std::string                 value;
+            size_t                      hash;
+            mutable std::atomic<size_t> refs;
+         };
+         /** @return the pool entry of value with one more reference */
+         static const entry* intern( const std::string& value );
+         static void add_ref( const entry* e ) { e->refs.fetch_add( 1, std::memory_order_relaxed ); }
+         /** drops a reference, removes the entry from the pool with its last one */
+         static void release( const entry* e );
+
+         const entry* _entry;
+   };
+
+   inline bool operator!=( const interned_string& a, const interned_string& b ) { return !( a == b ); }
+   inline bool operator> ( const interned_string& a, const interned_string& b ) { return b < a; }
+   inline bool operator<=( const interned_string& a, const interned_string& b ) { return !( b < a ); }
+   inline bool operator>=( const interned_string& a, const interned_string& b ) { return !( a < b ); }
+
+   inline bool operator==( const interned_string& a, const std::string& b ) { return a.str() == b; }
+   inline bool operator==( const std::string& a, const interned_string& b ) { return a == b.str(); }
+   inline bool operator!=( const interned_string& a, const std::string& b ) { return a.str() != b; }
+   inline bool operator!=( const std::string& a, const interned_string& b ) { return a != b.str(); }
+   inline bool operator< ( const interned_string& a, const std::string& b ) { return a.str() < b; }
+   inline bool operator< ( const std::string& a, const interned_string& b ) { return a < b.str(); }
+   inline bool operator> ( const interned_string& a, const std::string& b ) { return a.str() > b; }
+   inline bool operator> ( const std::string& a, const interned_string& b ) { return a > b.str(); }
+   inline bool operator<=( const interned_string& a, const std::string& b ) { return a.str() <= b; }
+   inline bool operator<=( const std::string& a, const interned_string& b ) { return a <= b.str(); }
+   inline bool operator>=( const interned_string& a, const std::string& b ) { return a.str() >= b; }
+   inline bool operator>=( const std::string& a, const interned_string& b ) { return a >= b.str(); }
+
+   inline std::string operator+( const std::string& a, const interned_string& b ) { return a + b.str(); }
+   inline std::string operator+( const interned_string& a, const std::string& b ) { return a.str() + b; }
+
+   std::ostream& operator<<( std::ostream& out, const interned_string& s );
+
+   /**
+    *  Orders interned strings like std::less<std::string>, for indexes that are searched with plain strings
+    *  without interning them first
+    */
+   struct interned_string_less
+   {
+      bool operator()( const interned_string& a, const interned_string& b )const { return a < b; }
+      bool operator()( const interned_string& a, const std::string& b )const     { return a.str() < b; }
+      bool operator()( const std::string& a, const interned_string& b )const     { return a < b.str(); }
+   };
+
+   /**
+    *  Hashes interned strings with the hash computed when they were interned and plain strings like
+    *  std::hash<std::string>, so hashed indexes can be searched with either
+    */
+   struct interned_string_hash
+   {
+      size_t operator()( const interned_string& s )const { return s.hash(); }
+      size_t operator()( const std::string& s )const     { return std::hash<std::string>()( s ); }
+   };
+
+   /** Equality of interned strings and plain strings, for hashed indexes that use interned_string_hash */
+   struct interned_string_equal_to
+   {
+      bool operator()( const interned_string& a, const interned_string& b )const { return a == b; }
+      bool operator()( const interned_string& a, const std::string& b )const     { return a.str() == b; }
+      bool operator()( const std::string& a, const interned_string& b )const     { return a == b.str(); }
+   };
+
+} } // graphene::db
+
+namespace std {
+   template<>
+   struct hash< graphene::db::interned_string >
+   {
+      size_t operator()( const graphene::db::interned_string& s )const { return s.hash(); }
+   };
+}
+
+/**
+ *  Like the extension serializers these must be declared before fc/io/raw.hpp, otherwise the serializers of
+ *  the containing types do not find them.
+ */
+namespace fc { namespace raw {
+
+template< typename Stream >
+void pack( Stream& s, const graphene::db::interned_string& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+template< typename Stream >
+void unpack( Stream& s, graphene::db::interned_string& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+
+} } // fc::raw
+
+namespace fc {
+   void to_variant( const graphene::db::interned_string& s, fc::variant& v, uint32_t max_depth = 1 );
+   void from_variant( const fc::variant& v, graphene::db::interned_string& s, uint32_t max_depth = 1 );
+}
+
+FC_REFLECT_TYPENAME( graphene::db::interned_string )
+
+#include <fc/io/raw.hpp>
+
+namespace fc { namespace raw {
+
+template< typename Stream >
+void pack( Stream& s, const graphene::db::interned_string& v, uint32_t _max_depth )
+{
+   fc::raw::pack( s, v.str(), _max_depth );
+}
+
+template< typename Stream >
+void unpack( Stream& s, graphene::db::interned_string& v, uint32_t _max_depth )
+{
+   std::string value;
+   fc::raw::unpack( s, value, _max_depth );
+   v = value;
+}
+
+} } // fc::raw
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/db/object_id.hpp>
+#include <graphene/db/dynamic_memory.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/crypto/city.hpp>
 #include <fc/uint128.hpp>
@@ -74,9 +75,18 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /** @return the size and alignment of storage required by clone_into() */
+         virtual size_t             object_size()const = 0;
+         virtual size_t             object_alignment()const = 0;
+         /** @return an estimate of the heap memory owned by the members of this object */
+         virtual size_t             dynamic_memory_size()const = 0;
+         /** Copy-constructs this object into storage, which must be suitably sized and aligned */
+         virtual object*            clone_into( void* storage )const = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
+         /** Replaces the value of this object with the result of unpacking data, which must come from pack() */
+         virtual void               unpack_from( const vector<char>& data ) = 0;
          virtual fc::uint128        hash()const = 0;
    };
 
@@ -95,6 +105,16 @@ namespace graphene { namespace db {
          {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
+         virtual size_t     object_size()const      { return sizeof(DerivedClass);  }
+         virtual size_t     object_alignment()const { return alignof(DerivedClass); }
+         virtual size_t     dynamic_memory_size()const
+         {
+            return graphene::db::dynamic_memory_size( static_cast<const DerivedClass&>(*this) );
+         }
+         virtual object*    clone_into( void* storage )const
+         {
+            return new (storage) DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
 
          virtual void    move_from( object& obj )
          {
@@ -102,12 +122,29 @@ namespace graphene { namespace db {
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this), MAX_NESTING ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual void         unpack_from( const vector<char>& data )
+         {
+            DerivedClass tmp;
+            fc::raw::unpack( data, tmp );
+            static_cast<DerivedClass&>(*this) = std::move( tmp );
+         }
          virtual fc::uint128  hash()const  {  
              auto tmp = this->pack();
              return fc::city_hash_crc_128( tmp.data(), tmp.size() );
          }
    };
 
+   /**
+    *  Specialize this for object types whose undo copies should be kept in packed form.
+    *
+    *  By default undo_database saves a full copy of an object before it is modified. For objects that own
+    *  many heap-allocated members (strings, maps, vectors) the fc::raw packed form is a single compact
+    *  buffer, which makes the copy cheaper and the undo history considerably smaller, at the cost of
+    *  unpacking on undo. Objects consisting of plain scalars should stick with the default.
+    */
+   template<typename T>
+   struct is_packed_undo_type : std::false_type {};
+
    typedef flat_map<uint8_t, object_id_type> annotation_map;
 
    /**
@@ -25,13 +25,31 @@
 #include <graphene/db/object.hpp>
 #include <graphene/db/index.hpp>
 #include <graphene/db/undo_database.hpp>
+#include <graphene/db/read_snapshot.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/time.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
+#include <thread>
+#include <unordered_set>
 
 namespace graphene { namespace db {
 
+   /** The objects read by id and changed while an object_database records object access */
+   struct object_access_set
+   {
+      std::unordered_set<object_id_type> reads;
+      std::unordered_set<object_id_type> writes;
+
+      void clear() { reads.clear(); writes.clear(); }
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -42,17 +60,55 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes()
+         {
+            _index.clear();
+            _index.resize(255);
+            _hash_indexes.clear();
+            _batched_indexes.clear();
+            _incremental_hash = false;
+            _reuse_unchanged_files = false;
+         }
 
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the complete state of the object_database to disk. Only indexes that changed since they were
+          * last opened or flushed are serialized, the files of all others are carried over from the previous flush.
           */
          void flush();
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
+         /** The file of one index, as flush() would write it, held in memory */
+         struct packed_index
+         {
+            uint8_t     space_id = 0;
+            uint8_t     type_id = 0;
+            std::string data;
+         };
+         /**
+          * Serializes all indexes into memory, in parallel. The result is a consistent image of the state that can
+          * be written by write_packed_indexes() on any thread while the database moves on.
+          */
+         vector<packed_index> pack_indexes()const;
+         /** Writes indexes in the format install_indexes() reads */
+         static void write_packed_indexes( std::ostream& out, const vector<packed_index>& indexes );
+         /** Writes the files of all indexes, as flush() would, into a single stream */
+         void save_indexes( std::ostream& out )const;
+         /**
+          * Replaces the object database files in data_dir with the indexes written by save_indexes(), the next
+          * open() of data_dir loads them.
+          */
+         static void install_indexes( std::istream& in, const fc::path& data_dir );
+         /**
+          * Replaces the object database files in data_dir with indexes packed by pack_indexes(), like flush() does.
+          * It can run on any thread, call forget_saved_files() when the database keeps running on data_dir.
+          */
+         static void write_index_files( const vector<packed_index>& indexes, const fc::path& data_dir );
+         /** The files on disk are not those of the last flush() any more, the next one writes all indexes again */
+         void forget_saved_files() { _reuse_unchanged_files = false; }
+
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
@@ -79,6 +135,26 @@ namespace graphene { namespace db {
 
          const object& get_object( object_id_type id )const;
          const object* find_object( object_id_type id )const;
+         /**
+          * Looks up many objects at once, like find_object() for each of ids. Consecutive ids of the same type share
+          * one lookup of their index, so requests that list the ids of a type together resolve each index once.
+          * @return the objects in the order of ids, nullptr for the ids that are not found
+          */
+         vector<const object*> find_objects( const vector<object_id_type>& ids )const;
+
+         /**
+          * Records the ids of all objects looked up by id and of all objects created, modified or removed into
+          * access until it is called with nullptr. Lookups through secondary keys of the indexes are not recorded.
+          * Only the accesses of the calling thread are recorded, e.g. not those of history consumers during a replay.
+          */
+         void record_object_access( object_access_set* access );
+
+         /** Measure the time spent saving the undo state of created, modified and removed objects */
+         void     enable_undo_timing( bool enable ) { _time_undo = enable; }
+         /** @return nanoseconds spent saving undo state since undo timing was enabled */
+         uint64_t undo_time_ns()const { return _undo_time_ns.load( std::memory_order_relaxed ); }
+         /** @return the number of objects created, modified or removed since the database was constructed */
+         uint64_t undo_record_count()const { return _undo_records.load( std::memory_order_relaxed ); }
 
          /// These methods are mutators of the object_database. You must use these methods to make changes to the object_database,
          /// in order to maintain proper undo history.
@@ -136,7 +212,12 @@ namespace graphene { namespace db {
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
             unique_ptr<index> indexptr( new IndexType(*this) );
             _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            if( _incremental_hash )
+               track_hash( *result );
+            if( _read_snapshots )
+               track_snapshots( *result );
+            return result;
          }
 
          template<typename IndexType, typename SecondaryIndexType, typename... Args>
@@ -147,11 +228,85 @@ namespace graphene { namespace db {
 
          void pop_undo();
 
+         /** Registers observer for the changes of the objects of the given type, the index keeps it alive */
+         void add_index_observer( uint8_t space_id, uint8_t type_id, const shared_ptr<index_observer>& observer )
+         {
+            get_mutable_index( space_id, type_id ).add_observer( observer );
+         }
+
+         /** Adds a secondary index to the primary index of ObjectType, which owns it */
+         template<typename ObjectType, typename SecondaryIndexType, typename... Args>
+         SecondaryIndexType* add_object_secondary_index( Args... args )
+         {
+            auto& idx = dynamic_cast<base_primary_index&>( get_mutable_index<ObjectType>() );
+            return idx.template add_secondary_index<SecondaryIndexType, Args...>( args... );
+         }
+
+         /**
+          * Installs a hash_index on every primary index, including those added later, so that the state hash
+          * is maintained on every change from now on. Must be called on the thread that modifies the database.
+          */
+         void enable_incremental_hash();
+         bool incremental_hash_enabled()const { return _incremental_hash; }
+
+         /**
+          * @return the sum of the hashes of all objects in the database, as maintained incrementally.
+          * @pre enable_incremental_hash() was called
+          */
+         fc::uint128 get_state_hash()const;
+
+         /**
+          * Recomputes the state hash by walking all objects, optionally hashing the indexes in parallel.
+          * The result equals get_state_hash(). The database must not be modified until this returns.
+          */
+         fc::uint128 compute_state_hash( bool parallel = true )const;
+
+         /**
+          * Installs a snapshot_index on every primary index, including those added later, and from then on
+          * serializes every index change against read_snapshot lookups. Must be called on the thread that
+          * modifies the database, before any other thread reads from it.
+          */
+         void enable_read_snapshots();
+         bool read_snapshots_enabled()const { return _read_snapshots; }
+
+         /**
+          * Pins a read_snapshot of the current state. To get a snapshot at a block boundary, call this from
+          * the thread that modifies the database in between two blocks.
+          *
+          * @param revision an arbitrary label stored in the snapshot, typically the head block number
+          * @pre enable_read_snapshots() was called
+          */
+         std::shared_ptr<const read_snapshot> pin_snapshot( uint64_t revision = 0 );
+
+         /** Reports the pending changes of every batched_secondary_index */
+         void flush_batched_indexes();
+
+         /** @return the estimated memory usage of every index, this walks all objects */
+         vector<index_memory_usage> get_memory_usage()const;
+         /** Calls inspector with every index, in the order of their space and type ids */
+         void inspect_all_indexes( const std::function<void(const index&)>& inspector )const;
+         /** Enables log_memory_usage(), an interval of zero disables it */
+         void set_memory_usage_log_interval( fc::microseconds interval ) { _memory_log_interval = interval; }
+         /** Logs the memory usage of all indexes, unless it was logged less than the configured interval ago */
+         void log_memory_usage();
+
+         /** Receives the name, start and duration of every step of open(), e.g. to report where startup goes */
+         typedef std::function<void( const std::string& phase, const fc::time_point& start,
+                                     const fc::microseconds& elapsed )> phase_observer;
+         void set_phase_observer( phase_observer observer ) { _phase_observer = std::move( observer ); }
+
          fc::path get_data_dir()const { return _data_dir; }
 
          /** public for testing purposes only... should be private in practice. */
          undo_database                          _undo_db;
      protected:
+         /** passes the time from start until now to the phase observer, if there is one */
+         void report_phase( const std::string& phase, const fc::time_point& start )const
+         {
+            if( _phase_observer )
+               _phase_observer( phase, start, fc::time_point::now() - start );
+         }
+
          template<typename IndexType>
          IndexType&    get_mutable_index_type() {
             static_assert( std::is_base_of<index,IndexType>::value, "Type must be an index type" );
@@ -163,15 +318,48 @@ namespace graphene { namespace db {
          index& get_mutable_index(uint8_t space_id, uint8_t type_id);
 
      private:
+         void track_hash( index& idx );
+         void track_snapshots( index& idx );
 
          friend class base_primary_index;
+         friend class read_snapshot;
+         friend class snapshot_index;
+         /**
+          * Threads other than the chain's write to the indexes they own, e.g. history consumers during a replay, so
+          * the nesting of writes is counted per thread and each thread takes the version lock for its outermost one.
+          */
+         void begin_write();
+         void end_write();
+         /** @return the set recording the accesses of the calling thread, nullptr for none */
+         object_access_set* current_access()const;
+         void register_batched_index( batched_secondary_index& sindex ) { _batched_indexes.push_back( &sindex ); }
+         /** called with the version lock held, copies obj into every snapshot that doesn't know it yet */
+         void record_version( const object& obj, bool created );
          friend class undo_database;
-         void save_undo( const object& obj );
+         void save_undo( const object& obj, bool packed );
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /// true if the files in _data_dir reflect every index that is not dirty
+         bool                                                      _reuse_unchanged_files = false;
+         bool                                                      _incremental_hash = false;
+         vector< const hash_index* >                               _hash_indexes;
+         vector< batched_secondary_index* >                        _batched_indexes;
+         fc::microseconds                                          _memory_log_interval;
+         fc::time_point                                            _last_memory_log;
+         phase_observer                                            _phase_observer;
+
+         std::atomic<bool>                                         _read_snapshots{ false };
+         mutable boost::shared_mutex                               _version_mutex;
+         vector< std::weak_ptr<read_snapshot> >                    _snapshots;
+         std::atomic<object_access_set*>                           _access{ nullptr };
+         /// the thread that called record_object_access()
+         std::atomic<std::thread::id>                              _access_thread;
+         bool                                                      _time_undo = false;
+         std::atomic<uint64_t>                                     _undo_time_ns{ 0 };
+         std::atomic<uint64_t>                                     _undo_records{ 0 };
    };
 
 } } // graphene::db
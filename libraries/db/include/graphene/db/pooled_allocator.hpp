@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <boost/pool/singleton_pool.hpp>
+
+#include <limits>
+#include <new>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class pooled_allocator
+    *  @brief An allocator that recycles fixed-size blocks instead of returning them to the heap
+    *
+    *  Single-element allocations, which is what node based containers such as boost::multi_index_container
+    *  perform, are served from a boost::singleton_pool shared by all allocators with the same Tag and
+    *  element size. Freed nodes go back into the pool and are handed out again by the next allocation, so
+    *  insert/erase churn does not hit malloc. Array allocations are forwarded to the global heap.
+    *
+    *  Tag should be unique per index to keep the pools of unrelated containers apart.
+    */
+   template<typename T, typename Tag = T>
+   class pooled_allocator
+   {
+      public:
+         typedef T              value_type;
+         typedef T*             pointer;
+         typedef const T*       const_pointer;
+         typedef T&             reference;
+         typedef const T&       const_reference;
+         typedef std::size_t    size_type;
+         typedef std::ptrdiff_t difference_type;
+
+         template<typename U>
+         struct rebind { typedef pooled_allocator<U, Tag> other; };
+
+         pooled_allocator() {}
+         template<typename U>
+         pooled_allocator( const pooled_allocator<U, Tag>& ) {}
+
+         pointer allocate( size_type n, const void* = nullptr )
+         {
+            if( n != 1 )
+               return static_cast<pointer>( ::operator new( n * sizeof(T) ) );
+            void* result = pool::malloc();
+            if( result == nullptr )
+               throw std::bad_alloc();
+            return static_cast<pointer>( result );
+         }
+
+         void deallocate( pointer p, size_type n )
+         {
+            if( n != 1 )
+               ::operator delete( p );
+            else
+               pool::free( p );
+         }
+
+         template<typename U, typename... Args>
+         void construct( U* p, Args&&... args ) { ::new( (void*)p ) U( std::forward<Args>(args)... ); }
+         template<typename U>
+         void destroy( U* p ) { p->~U(); }
+
+         size_type     max_size()const                    { return std::numeric_limits<size_type>::max() / sizeof(T); }
+         pointer       address( reference x )const        { return &x; }
+         const_pointer address( const_reference x )const  { return &x; }
+
+         /** Returns blocks of the pool that are not in use to the heap */
+         static bool release_memory() { return pool::release_memory(); }
+
+      private:
+         typedef boost::singleton_pool< Tag, sizeof(T) > pool;
+   };
+
+   template<typename T, typename U, typename Tag>
+   bool operator==( const pooled_allocator<T, Tag>&, const pooled_allocator<U, Tag>& ) { return true; }
+   template<typename T, typename U, typename Tag>
+   bool operator!=( const pooled_allocator<T, Tag>&, const pooled_allocator<U, Tag>& ) { return false; }
+
+} } // graphene::db
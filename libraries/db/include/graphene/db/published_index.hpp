@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/epoch_reclaimer.hpp>
+#include <graphene/db/index.hpp>
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class published_index
+    *  @brief A batched secondary index that publishes immutable copies of its objects for readers on other threads
+    *
+    *  The objects are grouped by GroupKey, a functor with a result_type, and each group is sorted by Compare, which
+    *  must order the objects of a group totally. When the batched indexes are flushed, i.e. after every pushed
+    *  transaction and every applied or popped block, the changed groups are copied with their changes applied and
+    *  published together with the unchanged ones, which are shared with the previous version like the shards that
+    *  hold no changed group. A reader therefore sees the state of one flush without locking
+    *  against the thread that changes the database. Replaced versions are freed through an epoch_reclaimer once
+    *  no reader can hold them anymore.
+    *
+    *  Copying every changed object and group costs the chain thread, which is why these indexes are only installed
+    *  for readers that need them, see database::enable_concurrent_reads().
+    */
+   template<typename ObjectType, typename GroupKey, typename Compare>
+   class published_index : public batched_secondary_index
+   {
+      public:
+         typedef typename GroupKey::result_type                          key_type;
+         typedef std::vector< std::shared_ptr<const ObjectType> >         group_type;
+         typedef std::map< key_type, std::shared_ptr<const group_type> > shard_type;
+         /** the groups spread over shard_count shards by the hash of their key */
+         typedef std::vector< std::shared_ptr<const shard_type> >         version_type;
+
+         static const size_t shard_count = 64;
+
+         /** Pins the latest published version for its lifetime, may be used on any thread */
+         class reader
+         {
+            public:
+               explicit reader( const published_index& idx )
+                  : _guard( idx._reclaimer ), _version( idx._published.load() ) {}
+
+               /** @return the objects of the group sorted by Compare, nullptr if the group has none */
+               const group_type* find( const key_type& key )const
+               {
+                  const shard_type& shard = *(*_version)[ shard_of( key ) ];
+                  auto itr = shard.find( key );
+                  return itr == shard.end() ? nullptr : itr->second.get();
+               }
+
+            private:
+               epoch_reclaimer::reader_guard _guard;
+               const version_type*           _version;
+         };
+
+         published_index()
+            : _published( new version_type( shard_count, std::make_shared<const shard_type>() ) ) {}
+         virtual ~published_index() { delete _published.load(); }
+
+         virtual void object_changed( const object* before, const object* after ) override
+         {
+            if( before != nullptr )
+            {
+               const ObjectType& o = static_cast<const ObjectType&>( *before );
+               _changes[ GroupKey()( o ) ][ o.id ] = nullptr;
+            }
+            if( after != nullptr )
+            {
+               const ObjectType& o = static_cast<const ObjectType&>( *after );
+               _changes[ GroupKey()( o ) ][ o.id ] = std::make_shared<const ObjectType>( o );
+            }
+         }
+
+         virtual void batch_flushed() override
+         {
+            if( _changes.empty() )
+               return;
+            // only the shards holding changed groups are copied, the others and the unchanged groups are shared
+            const version_type* old_version = _published.load();
+            std::unique_ptr<version_type> next( new version_type( *old_version ) );
+            std::vector< std::shared_ptr<shard_type> > copied( shard_count );
+            for( auto& change : _changes )
+            {
+               const size_t i = shard_of( change.first );
+               if( !copied[i] )
+                  copied[i] = std::make_shared<shard_type>( *(*next)[i] );
+               apply( *copied[i], change.first, change.second );
+            }
+            _changes.clear();
+            for( size_t i = 0; i < shard_count; ++i )
+               if( copied[i] )
+                  (*next)[i] = std::move( copied[i] );
+            _published.store( next.release() );
+            _reclaimer.retire( [old_version]() { delete old_version; } );
+            _reclaimer.reclaim();
+         }
+
+         virtual uint64_t estimated_memory_usage()const override
+         {
+            return _object_count * ( sizeof( ObjectType ) + 2 * sizeof( std::shared_ptr<const ObjectType> ) );
+         }
+
+         /** @return the number of versions that were replaced but may still be read */
+         size_t retired_versions()const { return _reclaimer.pending(); }
+
+      private:
+         typedef std::map< object_id_type, std::shared_ptr<const ObjectType> > group_changes;
+
+         struct compare_pointers
+         {
+            bool operator()( const std::shared_ptr<const ObjectType>& a,
+                             const std::shared_ptr<const ObjectType>& b )const
+            { return Compare()( *a, *b ); }
+         };
+
+         static size_t shard_of( const key_type& key ) { return boost::hash<key_type>()( key ) % shard_count; }
+
+         void apply( shard_type& shard, const key_type& key, group_changes& changes )
+         {
+            std::shared_ptr<group_type> group = std::make_shared<group_type>();
+            auto itr = shard.find( key );
+            if( itr != shard.end() )
+            {
+               group->reserve( itr->second->size() + changes.size() );
+               for( const auto& o : *itr->second )
+                  if( changes.find( o->id ) == changes.end() )
+                     group->push_back( o );
+               _object_count -= itr->second->size();
+            }
+            const size_t unchanged = group->size();
+            for( auto& item : changes )
+               if( item.second )
+                  group->push_back( std::move( item.second ) );
+            std::sort( group->begin() + unchanged, group->end(), compare_pointers() );
+            std::inplace_merge( group->begin(), group->begin() + unchanged, group->end(), compare_pointers() );
+            _object_count += group->size();
+
+            if( group->empty() )
+            {
+               if( itr != shard.end() )
+                  shard.erase( itr );
+            }
+            else if( itr != shard.end() )
+               itr->second = group;
+            else
+               shard.emplace( key, group );
+         }
+
+         std::atomic<const version_type*>   _published;
+         epoch_reclaimer                    _reclaimer;
+         std::map< key_type, group_changes > _changes;
+         uint64_t                           _object_count = 0;
+   };
+
+   template<typename ObjectType, typename GroupKey, typename Compare>
+   const size_t published_index<ObjectType, GroupKey, Compare>::shard_count;
+
+} } // graphene::db
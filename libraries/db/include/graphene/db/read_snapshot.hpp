@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+
+#include <memory>
+#include <unordered_map>
+
+namespace graphene { namespace db {
+   class object_database;
+
+   /**
+    * @class read_snapshot
+    * @brief A consistent, read-only view of the object_database as of the moment it was pinned
+    *
+    * While a snapshot is alive, the database keeps the value every object had when the snapshot was pinned,
+    * copying it just before the object is modified or removed, and remembers which objects were created
+    * afterwards. Lookups through the snapshot therefore keep returning the pinned state while the chain
+    * thread goes on applying blocks.
+    *
+    * Lookups may be done from any thread. They return immutable copies that stay valid after the snapshot
+    * is released, and hold the database's version lock only for the duration of a single lookup.
+    *
+    * Only lookups by id are supported, secondary keys of the live indexes are not versioned.
+    *
+    * @see object_database::pin_snapshot()
+    */
+   class read_snapshot
+   {
+      public:
+         read_snapshot( const object_database& db, uint64_t revision ) : _db( db ), _revision( revision ) {}
+
+         /** @return the value of the object as of the time the snapshot was pinned, or nullptr if it didn't exist */
+         std::shared_ptr<const object> find( object_id_type id )const;
+
+         template<typename T>
+         std::shared_ptr<const T> find( object_id_type id )const
+         {
+            return std::static_pointer_cast<const T>( find( id ) );
+         }
+
+         template<uint8_t SpaceID, uint8_t TypeID, typename T>
+         std::shared_ptr<const T> find( object_id<SpaceID,TypeID,T> id )const { return find<T>( id ); }
+
+         /** @return the revision passed to object_database::pin_snapshot(), e.g. a block number */
+         uint64_t revision()const { return _revision; }
+
+         /** @return number of objects that were copied because they changed after the snapshot was pinned */
+         size_t version_count()const;
+
+      private:
+         friend class object_database;
+
+         const object_database&                                            _db;
+         const uint64_t                                                    _revision;
+         /// pinned values of changed objects, nullptr for objects created after pinning
+         std::unordered_map< object_id_type, std::shared_ptr<const object> > _versions;
+   };
+
+   /**
+    * @class snapshot_index
+    * @brief A secondary index that maintains the copy-on-write versions of all live read_snapshots
+    */
+   class snapshot_index : public secondary_index
+   {
+      public:
+         explicit snapshot_index( object_database& db ) : _db( db ) {}
+
+         virtual void object_inserted( const object& obj ) override  { record( obj, true );  }
+         virtual void object_removed( const object& obj ) override   { record( obj, false ); }
+         virtual void about_to_modify( const object& before ) override { record( before, false ); }
+
+      private:
+         void record( const object& obj, bool created );
+
+         object_database& _db;
+   };
+
+} } // graphene::db
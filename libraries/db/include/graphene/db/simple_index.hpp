@@ -98,10 +98,18 @@ namespace graphene { namespace db {
                }
             } FC_CAPTURE_AND_RETHROW()
          }
+         virtual index_memory_usage get_memory_usage()const override
+         {
+            index_memory_usage usage = index::get_memory_usage();
+            usage.container_bytes = _objects.capacity() * sizeof( unique_ptr<object> );
+            return usage;
+         }
+
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _objects )
-               result += ptr->hash();
+               if( ptr )
+                  result += ptr->hash();
 
             return result;
          }
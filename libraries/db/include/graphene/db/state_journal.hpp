@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/db/object_id.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+#include <fc/variant.hpp>
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   class object_database;
+   struct undo_state;
+
+   /**
+    *  @brief Keeps the undo states of past blocks to answer what objects looked like as of a past block
+    *
+    *  For every block the journal records the value each changed object had before the block, taken from the undo
+    *  state of the block's session. Blocks stay in memory while they are reversible and are appended to a file once
+    *  they are irreversible. Each change in the file links to the previous change of the same object, and only the
+    *  position of the last change of each object is kept in memory, so that a query reads the changes of the
+    *  objects it asks for and nothing else.
+    *
+    *  The positions are saved to an index file when the journal is closed and every few thousand blocks, opening
+    *  the journal only reads the changes appended after the index was saved.
+    *
+    *  The journal covers a contiguous range of blocks. A block that does not follow the last recorded one, e.g.
+    *  after a replay that ran without undo states, restarts the journal from that block.
+    */
+   class state_journal
+   {
+      public:
+         /** Opens the journal in dir, creating it if necessary */
+         explicit state_journal( const fc::path& dir );
+         ~state_journal();
+
+         /** Records the changes of block_num, replacing those of block_num and later blocks recorded before */
+         void record_block( uint32_t block_num, const undo_state& changes );
+         /** Forgets the changes of a block that was popped */
+         void pop_block( uint32_t block_num );
+         /** Appends the recorded blocks up to last_irreversible to the file */
+         void flush( uint32_t last_irreversible );
+
+         /** @return the first block with recorded changes, states from the end of the block before it are known */
+         uint32_t first_block()const;
+         /** @return the last block with recorded changes, 0 if none */
+         uint32_t last_block()const;
+
+         /**
+          * @return the given objects as of the end of block_num, null for objects that did not exist then
+          * @param db the current state, which must be that of the end of last_block() with pending_changes on top
+          * @param pending_changes the undo state of the changes made to db since the end of last_block(), e.g. by
+          *        pending transactions, nullptr if there are none
+          */
+         std::vector<fc::variant> get_objects( const object_database& db, const std::vector<object_id_type>& ids,
+                                               uint32_t block_num, const undo_state* pending_changes )const;
+
+      private:
+         /** The value of an object before a block changed it */
+         struct change
+         {
+            uint32_t          block_num = 0;
+            bool              existed = false;
+            std::vector<char> packed;
+         };
+         struct pending_block
+         {
+            uint32_t                                      block_num;
+            std::unordered_map<object_id_type,change>     changes;
+         };
+
+         void recover();
+         /** @return the position in the file up to which the loaded index covers the changes, 0 if there's none */
+         uint64_t load_index();
+         void save_index();
+         void restart( uint32_t first_block );
+         /** @return the earliest change of id after block_num, if there is one */
+         fc::optional<change> find_change( object_id_type id, uint32_t block_num )const;
+
+         mutable std::mutex                                             _mutex;
+         fc::path                                                       _filename;
+         fc::path                                                       _index_filename;
+         mutable std::fstream                                           _file;
+         uint64_t                                                       _file_size = 0;
+         uint32_t                                                       _first_block = 0;
+         uint32_t                                                       _last_flushed = 0;
+         uint32_t                                                       _flushed_since_index = 0;
+         std::deque<pending_block>                                      _pending;
+         /// the position in the file of the last flushed change of each object
+         std::unordered_map< object_id_type, uint64_t >                 _last_changes;
+   };
+
+} } // graphene::db
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/exception/exception.hpp>
+#include <fc/thread/future.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /** The order in which the threads of a task_scheduler pick up queued tasks */
+   enum class task_priority : uint8_t
+   {
+      high,       ///< work a block waits for, e.g. the precomputation of its transactions
+      normal,
+      background  ///< work nothing urgent waits for, e.g. writing a snapshot
+   };
+   const uint32_t task_priority_count = 3;
+
+   /** Pins the calling thread to cpu, which is only supported on Linux */
+   void pin_current_thread( uint32_t cpu );
+
+   /**
+    *  @brief A pool of threads that steal work from each other
+    *
+    *  Each thread keeps a queue per priority. A task started on one of the threads goes to its own queue and is taken
+    *  from the back by that thread, tasks started elsewhere go to a shared queue. An idle thread takes the
+    *  highest priority task it finds, first from its own queue, then from the shared one, then from the front of the
+    *  queues of the other threads.
+    *
+    *  The parallel work of the chain runs on shared(), configure_shared() sizes it before its first use.
+    */
+   class task_scheduler
+   {
+      public:
+         /**
+          * Starts num_threads threads, 0 for one per CPU. If cpus is not empty, thread i is pinned to the CPU
+          * cpus[i % cpus.size()].
+          */
+         explicit task_scheduler( uint32_t num_threads = 0, const std::vector<uint32_t>& cpus = std::vector<uint32_t>() );
+         /** Runs the queued tasks and stops the threads */
+         ~task_scheduler();
+
+         task_scheduler( const task_scheduler& ) = delete;
+         task_scheduler& operator=( const task_scheduler& ) = delete;
+
+         static task_scheduler& shared();
+         /** Sets the threads of shared(), ignored once it started */
+         static void configure_shared( uint32_t num_threads, const std::vector<uint32_t>& cpus );
+
+         uint32_t size()const { return _workers.size(); }
+
+         /** Queues work, the returned future gets its result or exception */
+         template<typename Functor>
+         auto async( Functor&& work, task_priority priority = task_priority::normal ) -> fc::future<decltype(work())>
+         {
+            typedef decltype(work()) result_type;
+            typename fc::promise<result_type>::ptr promise( new fc::promise<result_type>( "task_scheduler" ) );
+            typename std::decay<Functor>::type task( std::forward<Functor>( work ) );
+            post( [promise,task] () mutable { fulfill( *promise, task ); }, priority );
+            return fc::future<result_type>( promise );
+         }
+
+         /** Queues work, which must not throw */
+         void post( std::function<void()> work, task_priority priority = task_priority::normal );
+
+         /** @return whether the calling thread is one of the threads of this scheduler */
+         bool on_worker_thread()const;
+
+         /** Runs one queued task on the calling thread, @return false if none was queued */
+         bool run_one();
+
+      private:
+         friend class task_group;
+
+         struct worker
+         {
+            std::mutex                          mutex;
+            std::deque< std::function<void()> > queues[task_priority_count];
+            std::thread                         thread;
+         };
+
+         template<typename Result, typename Functor>
+         static void fulfill( fc::promise<Result>& promise, Functor& work )
+         {
+            try {
+               promise.set_value( work() );
+            } catch( ... ) {
+               promise.set_exception( current_exception() );
+            }
+         }
+         template<typename Functor>
+         static void fulfill( fc::promise<void>& promise, Functor& work )
+         {
+            try {
+               work();
+               promise.set_value();
+            } catch( ... ) {
+               promise.set_exception( current_exception() );
+            }
+         }
+         /** Converts the exception in flight to an fc::exception */
+         static fc::exception_ptr current_exception();
+
+         bool take( uint32_t self, std::function<void()>& task );
+         void run( uint32_t self );
+
+         std::vector< std::unique_ptr<worker> > _workers;
+
+         std::mutex                            _shared_mutex;
+         std::deque< std::function<void()> >   _shared_queues[task_priority_count];
+
+         std::atomic<size_t>                   _queued{ 0 };
+         std::mutex                            _sleep_mutex;
+         std::condition_variable               _wake;
+         uint32_t                              _sleeping = 0;
+         bool                                  _stopping = false;
+   };
+
+   /**
+    *  @brief Tasks that are waited for together
+    *
+    *  The tasks may refer to the scope of the group, it waits for all of them before it is left. The waiting thread
+    *  runs queued tasks meanwhile, so groups can nest, and blocks without yielding its fiber, so that the chain code
+    *  that waits is not interleaved with the other fibers of its thread.
+    */
+   class task_group
+   {
+      public:
+         explicit task_group( task_priority priority = task_priority::normal,
+                              task_scheduler& scheduler = task_scheduler::shared() );
+         /** Waits for the tasks, their exceptions are logged */
+         ~task_group();
+
+         task_group( const task_group& ) = delete;
+         task_group& operator=( const task_group& ) = delete;
+
+         void run( std::function<void()> work );
+
+         /** Skips the tasks that did not start yet */
+         void cancel() { _state->cancelled.store( true, std::memory_order_relaxed ); }
+
+         /** Waits for all tasks run so far and rethrows the first of their exceptions */
+         void wait();
+
+      private:
+         /** Shared with the tasks, which may finish after a failed task made the group rethrow */
+         struct state
+         {
+            std::mutex                 mutex;
+            std::condition_variable    finished;
+            size_t                     pending = 0;
+            fc::exception_ptr          error;   ///< the first exception of a task
+            std::atomic<bool>          cancelled{ false };
+         };
+
+         task_scheduler&                          _scheduler;
+         task_priority                            _priority;
+         std::shared_ptr<state>                   _state;
+   };
+
+} } // graphene::db
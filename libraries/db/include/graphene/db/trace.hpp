@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/variant.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /** A finished span of work on one thread */
+   struct trace_span
+   {
+      const char* name = nullptr;   ///< a string literal
+      int64_t     arg = -1;         ///< e.g. the number of the block worked on, -1 for none
+      uint64_t    id = 0;
+      uint64_t    parent_id = 0;    ///< the enclosing span of the same task, 0 for none
+      uint64_t    trace_id = 0;     ///< the outermost span enclosing this one in the same task
+      uint32_t    thread = 0;       ///< numbers the threads in the order they recorded their first span
+      int64_t     start_us = 0;     ///< microseconds since the epoch
+      int64_t     duration_us = 0;
+   };
+
+   /**
+    *  @brief Keeps the most recent spans of block processing
+    *
+    *  Spans are marked with trace_scope, which costs a relaxed atomic load while tracing is disabled. Finished spans
+    *  go to a ring buffer that drops the oldest ones once it is full. The buffer can be exported for chrome://tracing
+    *  and Perfetto or as OTLP/JSON for OpenTelemetry collectors.
+    *
+    *  Spans nest per fc task, so that a fiber that yields within a span does not lend it as the parent of the
+    *  spans of other fibers on the same thread. Outside of tasks they nest per thread. A task started from within
+    *  a span begins a trace of its own.
+    */
+   class tracer
+   {
+      public:
+         static const size_t default_capacity = 1 << 16;
+
+         static tracer& instance();
+
+         void enable( bool enabled ) { _enabled.store( enabled, std::memory_order_relaxed ); }
+         bool is_enabled()const { return _enabled.load( std::memory_order_relaxed ); }
+
+         /** Drops the recorded spans and keeps at most capacity of them from now on */
+         void set_capacity( size_t capacity );
+         size_t capacity()const;
+
+         void record( const trace_span& span );
+
+         /** @return the recorded spans in the order they finished */
+         std::vector<trace_span> spans()const;
+         void clear();
+
+         /** @return the recorded spans in the Chrome trace event format */
+         fc::variant to_chrome_trace()const;
+         /** @return the recorded spans as an OTLP/JSON ExportTraceServiceRequest */
+         fc::variant to_otlp_json()const;
+
+      private:
+         friend class trace_scope;
+
+         std::atomic<bool>      _enabled{ false };
+         std::atomic<uint64_t>  _next_id{ 1 };
+         std::atomic<uint32_t>  _next_thread{ 1 };
+
+         mutable std::mutex       _mutex;
+         std::vector<trace_span>  _ring;
+         size_t                   _capacity = default_capacity;
+         size_t                   _oldest = 0; ///< the slot written next once the ring is full
+   };
+
+   /** Records a span for its lifetime if tracing was enabled when it started */
+   class trace_scope
+   {
+      public:
+         /** @param name a string literal naming the span */
+         explicit trace_scope( const char* name, int64_t arg = -1 )
+         {
+            if( tracer::instance().is_enabled() )
+               begin( name, arg );
+         }
+         ~trace_scope()
+         {
+            if( _span.id != 0 )
+               end();
+         }
+
+         trace_scope( const trace_scope& ) = delete;
+         trace_scope& operator=( const trace_scope& ) = delete;
+
+      private:
+         void begin( const char* name, int64_t arg );
+         void end();
+
+         trace_span _span;
+   };
+
+} } // graphene::db
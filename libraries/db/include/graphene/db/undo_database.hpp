@@ -26,18 +26,81 @@
 #include <deque>
 #include <fc/exception/exception.hpp>
 
+#include <boost/pool/pool_alloc.hpp>
+
 namespace graphene { namespace db {
 
    using std::unordered_map;
    using fc::flat_set;
    class object_database;
 
+   /**
+    * @class undo_arena
+    * @brief bump allocator that owns the object copies of an undo_state
+    *
+    * Memory handed out by the arena is never freed individually, all of it is released at once when the
+    * arena is destroyed. Objects placed in the arena must still be destroyed by their owner, see
+    * undo_object_deleter.
+    */
+   class undo_arena
+   {
+      public:
+         undo_arena() = default;
+         undo_arena( undo_arena&& ) = default;
+         undo_arena& operator=( undo_arena&& ) = default;
+
+         void*  allocate( size_t size, size_t alignment );
+         /** Takes over all memory of other, objects allocated from it stay valid */
+         void   merge( undo_arena&& other );
+         size_t capacity()const { return _capacity; }
+
+      private:
+         static const size_t chunk_size = 64 * 1024;
+
+         std::vector< std::unique_ptr<char[]> > _chunks;
+         size_t                                 _used = chunk_size; ///< bytes used in _chunks.back()
+         size_t                                 _capacity = 0;
+   };
+
+   /** Destroys, but does not deallocate, an object living in an undo_arena */
+   struct undo_object_deleter
+   {
+      void operator()( object* obj )const { obj->~object(); }
+   };
+   typedef std::unique_ptr< object, undo_object_deleter > undo_object_ptr;
+
+   template< typename Key, typename Value >
+   using undo_map = unordered_map< Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                   boost::fast_pool_allocator< std::pair<const Key, Value> > >;
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      /// owns the storage of old_values and removed, declared first so that it is destroyed last
+      undo_arena                                         arena;
+      undo_map<object_id_type, undo_object_ptr>          old_values;
+      /// pre-modification values of objects of packed undo types, see is_packed_undo_type
+      undo_map<object_id_type, vector<char> >            packed_old_values;
+      undo_map<object_id_type, object_id_type>           old_index_next_ids;
+      std::unordered_set<object_id_type, std::hash<object_id_type>, std::equal_to<object_id_type>,
+                         boost::fast_pool_allocator<object_id_type> > new_ids;
+      undo_map<object_id_type, undo_object_ptr>          removed;
+
+      /** @return a copy of obj allocated in this state's arena */
+      undo_object_ptr copy( const object& obj )
+      {
+         return undo_object_ptr( obj.clone_into( arena.allocate( obj.object_size(), obj.object_alignment() ) ) );
+      }
+      /** @return a copy of obj allocated in this state's arena, set to the value stored in packed */
+      undo_object_ptr unpacked_copy( const object& obj, const vector<char>& packed )
+      {
+         undo_object_ptr result = copy( obj );
+         result->unpack_from( packed );
+         return result;
+      }
+      bool is_modified( object_id_type id )const
+      {
+         return old_values.find( id ) != old_values.end() || packed_old_values.find( id ) != packed_old_values.end();
+      }
    };
 
 
@@ -96,8 +159,10 @@ namespace graphene { namespace db {
           * If it's a new object as of this undo state, its pre-modification value is not stored, because prior to this
           * undo state, it did not exist. Any modifications in this undo state are irrelevant, as the object will simply
           * be removed if we undo.
+          *
+          * If packed is true, the pre-modification value is stored in fc::raw packed form instead of as a copy.
           */
-         void on_modify( const object& obj );
+         void on_modify( const object& obj, bool packed = false );
          /**
           * This should be called just before an object is removed.
           *
@@ -127,6 +192,8 @@ namespace graphene { namespace db {
          void undo();
          void merge();
          void commit();
+         /** reverts the changes recorded in the last state on the stack and pops it */
+         void apply_undo_state();
 
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
@@ -26,18 +26,97 @@
 #include <graphene/db/object_database.hpp>
 
 namespace graphene { namespace db {
-   void base_primary_index::save_undo( const object& obj )
-   { _db.save_undo( obj ); }
+   void base_primary_index::begin_write()
+   { _db.begin_write(); }
+
+   void base_primary_index::end_write()
+   { _db.end_write(); }
+
+   index_memory_usage index::get_memory_usage()const
+   {
+      index_memory_usage usage;
+      usage.space_id = object_space_id();
+      usage.type_id = object_type_id();
+      inspect_all_objects( [&usage]( const object& obj ) {
+         ++usage.object_count;
+         usage.object_bytes += obj.object_size();
+         usage.dynamic_bytes += obj.dynamic_memory_size();
+      });
+      return usage;
+   }
+
+   uint64_t index::object_count()const
+   {
+      uint64_t count = 0;
+      inspect_all_objects( [&count]( const object& ) { ++count; } );
+      return count;
+   }
+
+   void base_primary_index::secondary_index_added( secondary_index& sindex )
+   {
+      auto batched = dynamic_cast< batched_secondary_index* >( &sindex );
+      if( batched != nullptr )
+         _db.register_batched_index( *batched );
+   }
+
+   void base_primary_index::save_undo( const object& obj, bool packed )
+   { _db.save_undo( obj, packed ); }
 
    void base_primary_index::on_add( const object& obj )
    {
+      _dirty = true;
       _db.save_undo_add( obj );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   {
+      _dirty = true;
+      _db.save_undo_remove( obj );
+      for( auto ob : _observers ) ob->on_remove( obj );
+   }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   {
+      _dirty = true;
+      for( auto ob : _observers ) ob->on_modify(  obj );
+   }
+
+   void batched_secondary_index::object_inserted( const object& obj )
+   {
+      // if the object was removed earlier in this batch, the entry keeps its original value
+      _pending[obj.id].after = &obj;
+   }
+
+   void batched_secondary_index::about_to_modify( const object& before )
+   {
+      auto itr = _pending.find( before.id );
+      if( itr != _pending.end() ) return;
+      auto& change = _pending[before.id];
+      change.before = before.clone();
+      change.after = &before;
+   }
+
+   void batched_secondary_index::object_removed( const object& obj )
+   {
+      auto itr = _pending.find( obj.id );
+      if( itr == _pending.end() )
+      {
+         _pending[obj.id].before = obj.clone();
+         return;
+      }
+      if( !itr->second.before ) // created within this batch
+         _pending.erase( itr );
+      else
+         itr->second.after = nullptr;
+   }
+
+   void batched_secondary_index::flush()
+   {
+      std::map< object_id_type, pending_change > changes;
+      changes.swap( _pending );
+      for( const auto& item : changes )
+         object_changed( item.second.before.get(), item.second.after );
+      batch_flushed();
+   }
 } } // graphene::chain
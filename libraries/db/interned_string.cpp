@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/interned_string.hpp>
+
+#include <fc/variant.hpp>
+
+#include <mutex>
+#include <ostream>
+#include <unordered_set>
+
+namespace graphene { namespace db {
+
+namespace {
+   struct entry_hash
+   {
+      template< typename Entry >
+      size_t operator()( const Entry& e )const { return e.hash; }
+   };
+   struct entry_equal
+   {
+      template< typename Entry >
+      bool operator()( const Entry& a, const Entry& b )const { return a.value == b.value; }
+   };
+
+   // never destroyed, objects holding interned strings may outlive any static pool
+   std::mutex& pool_mutex()
+   {
+      static std::mutex& mutex = *new std::mutex;
+      return mutex;
+   }
+
+   template< typename Entry >
+   std::unordered_set< Entry, entry_hash, entry_equal >& pool()
+   {
+      static auto& pool = *new std::unordered_set< Entry, entry_hash, entry_equal >;
+      return pool;
+   }
+}
+
+const interned_string::entry* interned_string::intern( const std::string& value )
+{
+   const size_t hash = std::hash<std::string>()( value );
+   std::lock_guard<std::mutex> lock( pool_mutex() );
+   // elements of unordered containers keep their address when the container rehashes
+   const entry* e = &*pool<entry>().emplace( value, hash ).first;
+   // under the lock, so this can't race with release() taking the last reference away
+   add_ref( e );
+   return e;
+}
+
+void interned_string::release( const entry* e )
+{
+   // other holders remain, nothing can remove the entry under us
+   size_t refs = e->refs.load( std::memory_order_relaxed );
+   while( refs > 1 )
+      if( e->refs.compare_exchange_weak( refs, refs - 1, std::memory_order_relaxed ) )
+         return;
+
+   // possibly the last reference, intern() may be handing out a new one at the same time
+   std::lock_guard<std::mutex> lock( pool_mutex() );
+   if( e->refs.fetch_sub( 1, std::memory_order_relaxed ) == 1 )
+      pool<entry>().erase( *e );
+}
+
+interned_string::interned_string()
+{
+   // the static holds a reference of its own, the empty entry is never removed
+   static const entry* const empty = intern( std::string() );
+   _entry = empty;
+   add_ref( _entry );
+}
+
+std::ostream& operator<<( std::ostream& out, const interned_string& s )
+{
+   return out << s.str();
+}
+
+} } // graphene::db
+
+namespace fc {
+   void to_variant( const graphene::db::interned_string& s, fc::variant& v, uint32_t max_depth )
+   {
+      v = s.str();
+   }
+
+   void from_variant( const fc::variant& v, graphene::db::interned_string& s, uint32_t max_depth )
+   {
+      s = v.as_string();
+   }
+}
@@ -22,12 +22,17 @@
  * THE SOFTWARE.
  */
 #include <graphene/db/object_database.hpp>
+#include <graphene/db/apply_phase.hpp>
+#include <graphene/db/task_scheduler.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
-#include <fc/thread/parallel.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
 namespace graphene { namespace db {
 
 object_database::object_database()
@@ -45,10 +50,35 @@ void object_database::close()
 
 const object* object_database::find_object( object_id_type id )const
 {
+   if( object_access_set* access = current_access() )
+      access->reads.insert( id );
    return get_index(id.space(),id.type()).find( id );
 }
+vector<const object*> object_database::find_objects( const vector<object_id_type>& ids )const
+{
+   vector<const object*> result;
+   result.reserve( ids.size() );
+   const index* idx = nullptr;
+   uint8_t space_id = 0;
+   uint8_t type_id = 0;
+   for( const object_id_type id : ids )
+   {
+      if( idx == nullptr || space_id != id.space() || type_id != id.type() )
+      {
+         space_id = id.space();
+         type_id = id.type();
+         idx = &get_index( space_id, type_id );
+      }
+      if( object_access_set* access = current_access() )
+         access->reads.insert( id );
+      result.push_back( idx->find( id ) );
+   }
+   return result;
+}
 const object& object_database::get_object( object_id_type id )const
 {
+   if( object_access_set* access = current_access() )
+      access->reads.insert( id );
    return get_index(id.space(),id.type()).get( id );
 }
 
@@ -73,77 +103,520 @@ void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
    fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
-   std::vector<fc::future<void>> tasks;
-   tasks.reserve(200);
+   // snapshots and shutdown wait for this, blocks being applied meanwhile should not
+   task_group tasks( task_priority::background );
+   uint32_t written = 0;
+   uint32_t reused = 0;
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
       fc::create_directories( _data_dir / "object_database.tmp" / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-               _index[space][type]->save( _data_dir / "object_database.tmp" / fc::to_string(space)/fc::to_string(type) );
-            } ) );
+         {
+            const fc::path current = _data_dir / "object_database" / fc::to_string(space) / fc::to_string(type);
+            const fc::path target = _data_dir / "object_database.tmp" / fc::to_string(space) / fc::to_string(type);
+            // unchanged indexes keep their last written file, only dirty ones are serialized again
+            if( _reuse_unchanged_files && !_index[space][type]->is_dirty() && fc::exists( current ) )
+            {
+               try {
+                  fc::create_hard_link( current, target );
+               } catch( const fc::exception& ) {
+                  fc::copy( current, target );
+               }
+               ++reused;
+               continue;
+            }
+            tasks.run( [this,space,type,target] () {
+               _index[space][type]->save( target );
+            } );
+            ++written;
+         }
    }
-   for( auto& task : tasks )
-      task.wait();
+   tasks.wait();
    fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
    if( fc::exists( _data_dir / "object_database" ) )
       fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
    fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
    fc::remove_all( _data_dir / "object_database.old" );
+
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->clear_dirty();
+   _reuse_unchanged_files = true;
+   dlog( "Flushed object_database: ${w} indexes written, ${r} unchanged", ("w",written)("r",reused) );
 }
 
+static void copy_bytes( std::istream& in, std::ostream& out, uint64_t size )
+{
+   std::vector<char> buffer( std::min<uint64_t>( size, 1 << 20 ) );
+   while( size > 0 )
+   {
+      const size_t chunk = std::min<uint64_t>( size, buffer.size() );
+      in.read( buffer.data(), chunk );
+      FC_ASSERT( in, "Unexpected end of index data" );
+      out.write( buffer.data(), chunk );
+      size -= chunk;
+   }
+   FC_ASSERT( out, "Failed to write index data" );
+}
+
+vector<object_database::packed_index> object_database::pack_indexes()const
+{ try {
+   vector<packed_index> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+         {
+            result.emplace_back();
+            result.back().space_id = idx->object_space_id();
+            result.back().type_id = idx->object_type_id();
+         }
+   task_group tasks( task_priority::background );
+   for( packed_index& packed : result )
+      tasks.run( [this,&packed] () {
+         std::ostringstream out;
+         _index[packed.space_id][packed.type_id]->save( out );
+         FC_ASSERT( out, "Failed to pack index ${s}.${t}", ("s",packed.space_id)("t",packed.type_id) );
+         packed.data = out.str();
+      } );
+   tasks.wait();
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::write_packed_indexes( std::ostream& out, const vector<packed_index>& indexes )
+{ try {
+   fc::raw::pack( out, uint32_t( indexes.size() ) );
+   for( const packed_index& packed : indexes )
+   {
+      fc::raw::pack( out, packed.space_id );
+      fc::raw::pack( out, packed.type_id );
+      fc::raw::pack( out, uint64_t( packed.data.size() ) );
+      out.write( packed.data.data(), packed.data.size() );
+   }
+   FC_ASSERT( out, "Failed to write index data" );
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::save_indexes( std::ostream& out )const
+{
+   write_packed_indexes( out, pack_indexes() );
+}
+
+void object_database::install_indexes( std::istream& in, const fc::path& data_dir )
+{ try {
+   const fc::path target = data_dir / "object_database.tmp";
+   fc::remove_all( target );
+   // like flush(), open() ignores the files until all of them are complete
+   fc::create_directories( target / "lock" );
+   uint32_t count = 0;
+   fc::raw::unpack( in, count );
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      uint8_t space = 0;
+      uint8_t type = 0;
+      uint64_t size = 0;
+      fc::raw::unpack( in, space );
+      fc::raw::unpack( in, type );
+      fc::raw::unpack( in, size );
+      fc::create_directories( target / fc::to_string(space) );
+      const fc::path file = target / fc::to_string(space) / fc::to_string(type);
+      std::ofstream out( file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f",file) );
+      copy_bytes( in, out, size );
+   }
+   fc::remove_all( target / "lock" );
+   fc::remove_all( data_dir / "object_database" );
+   fc::remove_all( data_dir / "object_database.old" );
+   fc::rename( target, data_dir / "object_database" );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+void object_database::write_index_files( const vector<packed_index>& indexes, const fc::path& data_dir )
+{ try {
+   const fc::path target = data_dir / "object_database.tmp";
+   fc::remove_all( target );
+   fc::create_directories( target / "lock" );
+   for( const packed_index& packed : indexes )
+   {
+      fc::create_directories( target / fc::to_string(packed.space_id) );
+      const fc::path file = target / fc::to_string(packed.space_id) / fc::to_string(packed.type_id);
+      std::ofstream out( file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f",file) );
+      out.write( packed.data.data(), packed.data.size() );
+      out.flush();
+      FC_ASSERT( out, "Failed to write ${f}", ("f",file) );
+   }
+   // the same renames as in flush(), open() picks up the newest complete state if they are interrupted
+   fc::remove_all( target / "lock" );
+   if( fc::exists( data_dir / "object_database" ) )
+      fc::rename( data_dir / "object_database", data_dir / "object_database.old" );
+   fc::rename( target, data_dir / "object_database" );
+   fc::remove_all( data_dir / "object_database.old" );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
 void object_database::wipe(const fc::path& data_dir)
 {
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   // leftovers of an interrupted flush() would be picked up by the next open()
+   fc::remove_all(data_dir / "object_database.tmp");
+   fc::remove_all(data_dir / "object_database.old");
+   _reuse_unchanged_files = false;
    ilog("Done wiping object databse.");
 }
 
 void object_database::open(const fc::path& data_dir)
 { try {
    _data_dir = data_dir;
+   // flush() may have been interrupted between its renames, pick up the newest complete state
+   if( !fc::exists( _data_dir / "object_database" ) )
+   {
+      if( fc::exists( _data_dir / "object_database.tmp" ) && !fc::exists( _data_dir / "object_database.tmp" / "lock" ) )
+         fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
+      else if( fc::exists( _data_dir / "object_database.old" ) )
+         fc::rename( _data_dir / "object_database.old", _data_dir / "object_database" );
+   }
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
        return;
    }
-   std::vector<fc::future<void>> tasks;
-   tasks.reserve(200);
+   struct index_open
+   {
+      uint32_t                             space;
+      uint32_t                             type;
+      fc::time_point                       start;
+      fc::microseconds                     elapsed;
+      std::vector< std::function<void()> > fills;
+   };
+   task_group tasks;
+   std::vector<index_open> opened;
+   opened.reserve(200);
+   const fc::time_point start = fc::time_point::now();
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-               _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
-            } ) );
-   for( auto& task : tasks )
-      task.wait();
+            opened.push_back( { space, type, fc::time_point(), fc::microseconds(), {} } );
+   for( index_open& o : opened )
+      tasks.run( [this,&o] () {
+         o.start = fc::time_point::now();
+         o.fills = _index[o.space][o.type]->open_deferred( _data_dir / "object_database"
+                                                           / fc::to_string(o.space)/fc::to_string(o.type) );
+         o.elapsed = fc::time_point::now() - o.start;
+      } );
+   tasks.wait();
+
+   // all primary indexes are complete now, fill the self-contained secondary indexes next to each other
+   const fc::time_point fill_start = fc::time_point::now();
+   for( const index_open& o : opened )
+      for( const auto& fill : o.fills )
+         tasks.run( fill );
+   tasks.wait();
+   // the in-memory state now matches the files on disk
+   _reuse_unchanged_files = true;
+   if( _phase_observer )
+   {
+      for( const index_open& o : opened )
+         _phase_observer( "object_database/" + fc::to_string( o.space ) + "." + fc::to_string( o.type ),
+                          o.start, o.elapsed );
+      report_phase( "object_database secondary indexes", fill_start );
+      report_phase( "object_database", start );
+   }
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 
+void object_database::enable_incremental_hash()
+{
+   if( _incremental_hash ) return;
+   _incremental_hash = true;
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            track_hash( *idx );
+}
+
+void object_database::track_hash( index& idx )
+{
+   auto primary = dynamic_cast< base_primary_index* >( &idx );
+   FC_ASSERT( primary != nullptr, "Incremental hashing requires a primary_index" );
+   _hash_indexes.push_back( primary->add_secondary_index< hash_index >( idx.hash() ) );
+}
+
+fc::uint128 object_database::get_state_hash()const
+{
+   FC_ASSERT( _incremental_hash, "Incremental hashing is not enabled" );
+   fc::uint128 result;
+   for( const auto idx : _hash_indexes )
+      result += idx->hash();
+   return result;
+}
+
+fc::uint128 object_database::compute_state_hash( bool parallel )const
+{
+   fc::uint128 result;
+   if( !parallel )
+   {
+      for( const auto& space : _index )
+         for( const auto& idx : space )
+            if( idx )
+               result += idx->hash();
+      return result;
+   }
+
+   std::vector<fc::future<fc::uint128>> tasks;
+   tasks.reserve(200);
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+         {
+            const index* ptr = idx.get();
+            tasks.push_back( task_scheduler::shared().async( [ptr] () { return ptr->hash(); } ) );
+         }
+   for( auto& task : tasks )
+      result += task.wait();
+   return result;
+}
+
+vector<index_memory_usage> object_database::get_memory_usage()const
+{
+   vector<index_memory_usage> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.push_back( idx->get_memory_usage() );
+   return result;
+}
+
+void object_database::inspect_all_indexes( const std::function<void(const index&)>& inspector )const
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            inspector( *idx );
+}
+
+void object_database::log_memory_usage()
+{
+   if( _memory_log_interval.count() <= 0 ) return;
+   const auto now = fc::time_point::now();
+   if( now - _last_memory_log < _memory_log_interval ) return;
+   _last_memory_log = now;
+
+   auto usage = get_memory_usage();
+   std::sort( usage.begin(), usage.end(), []( const index_memory_usage& a, const index_memory_usage& b ) {
+      return a.total_bytes() > b.total_bytes();
+   });
+   uint64_t total = 0;
+   for( const auto& u : usage )
+      total += u.total_bytes();
+   ilog( "Object database uses an estimated ${t} bytes", ("t",total) );
+   for( const auto& u : usage )
+   {
+      if( u.total_bytes() == 0 ) continue;
+      ilog( "   ${s}.${i} ${n}: ${c} objects, ${o} object, ${d} dynamic, ${x} container, ${y} secondary index bytes",
+            ("s",u.space_id)("i",u.type_id)("n",u.object_type)("c",u.object_count)("o",u.object_bytes)
+            ("d",u.dynamic_bytes)("x",u.container_bytes)("y",u.secondary_index_bytes) );
+   }
+}
+
+void object_database::enable_read_snapshots()
+{
+   if( _read_snapshots ) return;
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            track_snapshots( *idx );
+   _read_snapshots = true;
+}
+
+void object_database::track_snapshots( index& idx )
+{
+   auto primary = dynamic_cast< base_primary_index* >( &idx );
+   FC_ASSERT( primary != nullptr, "Read snapshots require a primary_index" );
+   primary->add_secondary_index< snapshot_index >( std::ref( *this ) );
+}
+
+std::shared_ptr<const read_snapshot> object_database::pin_snapshot( uint64_t revision )
+{
+   FC_ASSERT( _read_snapshots, "Read snapshots are not enabled" );
+   auto result = std::make_shared<read_snapshot>( *this, revision );
+   boost::unique_lock<boost::shared_mutex> lock( _version_mutex );
+   _snapshots.erase( std::remove_if( _snapshots.begin(), _snapshots.end(),
+                                     []( const std::weak_ptr<read_snapshot>& s ) { return s.expired(); } ),
+                     _snapshots.end() );
+   _snapshots.push_back( result );
+   return result;
+}
+
+namespace {
+   /** A database whose version lock the thread holds for its writes, with their nesting depth */
+   struct write_lock_depth
+   {
+      const object_database* db;
+      uint32_t               depth;
+   };
+   /** usually empty or of one entry, a thread writes to more than one database at once only in tests */
+   thread_local vector<write_lock_depth> write_locks;
+
+   vector<write_lock_depth>::iterator find_write_lock( const object_database* db )
+   {
+      return std::find_if( write_locks.begin(), write_locks.end(),
+                           [db]( const write_lock_depth& lock ) { return lock.db == db; } );
+   }
+}
+
+void object_database::begin_write()
+{
+   if( !write_locks.empty() )
+   {
+      auto itr = find_write_lock( this );
+      if( itr != write_locks.end() )
+      {
+         ++itr->depth;
+         return;
+      }
+   }
+   if( !_read_snapshots )
+      return;
+   _version_mutex.lock();
+   write_locks.push_back( write_lock_depth{ this, 1 } );
+}
+
+void object_database::end_write()
+{
+   if( write_locks.empty() )
+      return;
+   auto itr = find_write_lock( this );
+   if( itr == write_locks.end() || --itr->depth > 0 )
+      return;
+   write_locks.erase( itr );
+   _version_mutex.unlock();
+}
+
+void object_database::record_object_access( object_access_set* access )
+{
+   _access_thread.store( std::this_thread::get_id(), std::memory_order_relaxed );
+   _access.store( access, std::memory_order_release );
+}
+
+object_access_set* object_database::current_access()const
+{
+   object_access_set* access = _access.load( std::memory_order_acquire );
+   if( access == nullptr || _access_thread.load( std::memory_order_relaxed ) != std::this_thread::get_id() )
+      return nullptr;
+   return access;
+}
+
+void object_database::record_version( const object& obj, bool created )
+{
+   std::shared_ptr<const object> copy;
+   for( auto itr = _snapshots.begin(); itr != _snapshots.end(); )
+   {
+      auto snapshot = itr->lock();
+      if( !snapshot )
+      {
+         itr = _snapshots.erase( itr );
+         continue;
+      }
+      ++itr;
+      if( snapshot->_versions.find( obj.id ) != snapshot->_versions.end() )
+         continue;
+      // all snapshots pinned before this change share the same copy
+      if( !created && !copy )
+         copy = std::shared_ptr<const object>( obj.clone() );
+      snapshot->_versions[obj.id] = copy;
+   }
+}
+
+std::shared_ptr<const object> read_snapshot::find( object_id_type id )const
+{
+   boost::shared_lock<boost::shared_mutex> lock( _db._version_mutex );
+   auto itr = _versions.find( id );
+   if( itr != _versions.end() )
+      return itr->second;
+   // unchanged since pinning, the copy is taken under the lock so it can't change while being read
+   const object* live = _db.find_object( id );
+   if( live == nullptr )
+      return std::shared_ptr<const object>();
+   return std::shared_ptr<const object>( live->clone() );
+}
+
+size_t read_snapshot::version_count()const
+{
+   boost::shared_lock<boost::shared_mutex> lock( _db._version_mutex );
+   return _versions.size();
+}
+
+void snapshot_index::record( const object& obj, bool created )
+{
+   _db.record_version( obj, created );
+}
+
+void object_database::flush_batched_indexes()
+{
+   for( auto sindex : _batched_indexes )
+      if( sindex->has_pending_changes() )
+         sindex->flush();
+}
+
 void object_database::pop_undo()
 { try {
    _undo_db.pop_commit();
 } FC_CAPTURE_AND_RETHROW() }
 
-void object_database::save_undo( const object& obj )
+void object_database::save_undo( const object& obj, bool packed )
 {
-   _undo_db.on_modify( obj );
+   apply_phase_scope saving_undo( apply_phase::undo );
+   _undo_records.fetch_add( 1, std::memory_order_relaxed );
+   if( object_access_set* access = current_access() )
+      access->writes.insert( obj.id );
+   if( !_time_undo )
+   {
+      _undo_db.on_modify( obj, packed );
+      return;
+   }
+   const auto start = std::chrono::steady_clock::now();
+   _undo_db.on_modify( obj, packed );
+   _undo_time_ns.fetch_add( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start ).count(), std::memory_order_relaxed );
 }
 
 void object_database::save_undo_add( const object& obj )
 {
+   apply_phase_scope saving_undo( apply_phase::undo );
+   _undo_records.fetch_add( 1, std::memory_order_relaxed );
+   if( object_access_set* access = current_access() )
+      access->writes.insert( obj.id );
+   if( !_time_undo )
+   {
+      _undo_db.on_create( obj );
+      return;
+   }
+   const auto start = std::chrono::steady_clock::now();
    _undo_db.on_create( obj );
+   _undo_time_ns.fetch_add( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start ).count(), std::memory_order_relaxed );
 }
 
 void object_database::save_undo_remove(const object& obj)
 {
+   apply_phase_scope saving_undo( apply_phase::undo );
+   _undo_records.fetch_add( 1, std::memory_order_relaxed );
+   if( object_access_set* access = current_access() )
+      access->writes.insert( obj.id );
+   if( !_time_undo )
+   {
+      _undo_db.on_remove( obj );
+      return;
+   }
+   const auto start = std::chrono::steady_clock::now();
    _undo_db.on_remove( obj );
+   _undo_time_ns.fetch_add( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start ).count(), std::memory_order_relaxed );
 }
 
 } } // namespace graphene::db
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/state_journal.hpp>
+
+#include <graphene/db/object_database.hpp>
+#include <graphene/db/undo_database.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace db {
+
+namespace {
+   const uint32_t journal_version = 2;
+
+   /** Starts the file, first_block is the first block with recorded changes */
+   struct journal_header
+   {
+      uint32_t version = journal_version;
+      uint32_t first_block = 0;
+   };
+
+   /** Precedes the packed value of each change in the file */
+   struct journal_entry
+   {
+      uint64_t object_id;
+      uint64_t previous; ///< position of the previous change of the object, 0 if there is none
+      uint32_t block_num;
+      uint32_t size; ///< of the packed value, did_not_exist for objects created by the block, or end_of_block
+   };
+   const uint32_t did_not_exist = uint32_t(-1);
+   /// the size of the entry that follows the changes of each block
+   const uint32_t end_of_block = uint32_t(-2);
+
+   /** Starts the index file, which holds the position of the last change of each object in the file */
+   struct index_header
+   {
+      uint32_t version = journal_version;
+      uint32_t first_block = 0;
+      uint32_t last_flushed = 0;
+      uint64_t file_size = 0; ///< of the journal when the index was saved
+      uint64_t count = 0;     ///< of the objects that follow
+   };
+   struct index_entry
+   {
+      uint64_t object_id;
+      uint64_t position;
+   };
+   /// the index is saved after this many flushed blocks, to bound the part of the file read when opening
+   const uint32_t blocks_per_index = 10000;
+
+   void open_journal_file( std::fstream& file, const fc::path& filename )
+   {
+      if( !fc::exists( filename ) )
+         std::ofstream( filename.generic_string().c_str(), std::ios::binary );
+      file.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      file.open( filename.generic_string().c_str(), std::ios::binary | std::ios::in | std::ios::out );
+   }
+
+   journal_entry read_entry( std::fstream& file, uint64_t position )
+   {
+      journal_entry entry;
+      file.seekg( position );
+      file.read( (char*)&entry, sizeof(entry) );
+      return entry;
+   }
+}
+
+state_journal::state_journal( const fc::path& dir )
+{ try {
+   fc::create_directories( dir );
+   _filename = dir / "changes";
+   _index_filename = dir / "index";
+   open_journal_file( _file, _filename );
+   recover();
+   if( _first_block != 0 )
+      ilog( "Opened the state journal in ${d} with blocks ${first} to ${last}",
+            ("d",dir)("first",_first_block)("last",_last_flushed) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+state_journal::~state_journal()
+{
+   try {
+      if( _first_block != 0 )
+         save_index();
+      _file.close();
+   } catch( const std::exception& e ) {
+      elog( "Error closing the state journal: ${e}", ("e",e.what()) );
+   }
+}
+
+void state_journal::recover()
+{
+   _file_size = fc::file_size( _filename );
+   journal_header header;
+   if( _file_size < sizeof(header) )
+   {
+      _first_block = 0;
+      return;
+   }
+   _file.seekg( 0 );
+   _file.read( (char*)&header, sizeof(header) );
+   if( header.version != journal_version )
+   {
+      // the next recorded block restarts it
+      wlog( "Discarding the state journal of version ${v}", ("v",header.version) );
+      _first_block = 0;
+      return;
+   }
+   _first_block = header.first_block;
+   _last_flushed = _first_block - 1;
+
+   uint64_t position = load_index();
+   if( position == 0 )
+      position = sizeof(header);
+   // keep the blocks that are complete, a crash may have cut off the last one
+   std::vector< std::pair<object_id_type,uint64_t> > block_changes;
+   uint64_t complete = position;
+   while( position + sizeof(journal_entry) <= _file_size )
+   {
+      const journal_entry entry = read_entry( _file, position );
+      if( entry.size == end_of_block )
+      {
+         for( const auto& item : block_changes )
+            _last_changes[item.first] = item.second;
+         block_changes.clear();
+         _last_flushed = entry.block_num;
+         position += sizeof(entry);
+         complete = position;
+         continue;
+      }
+      const uint64_t value_size = entry.size == did_not_exist ? 0 : entry.size;
+      if( position + sizeof(entry) + value_size > _file_size )
+         break;
+      block_changes.emplace_back( object_id_type( entry.object_id ), position );
+      position += sizeof(entry) + value_size;
+   }
+   if( complete != _file_size )
+   {
+      wlog( "Dropping the incomplete block after block ${n} at the end of the state journal", ("n",_last_flushed) );
+      _file.close();
+      fc::resize_file( _filename, complete );
+      open_journal_file( _file, _filename );
+      _file_size = complete;
+   }
+}
+
+uint64_t state_journal::load_index()
+{
+   if( !fc::exists( _index_filename ) )
+      return 0;
+   std::ifstream in( _index_filename.generic_string().c_str(), std::ios::binary );
+   index_header header;
+   in.read( (char*)&header, sizeof(header) );
+   if( !in || header.version != journal_version || header.first_block != _first_block ||
+       header.file_size > _file_size || header.file_size < sizeof(journal_header) ||
+       fc::file_size( _index_filename ) != sizeof(header) + header.count * sizeof(index_entry) )
+   {
+      wlog( "Ignoring the state journal index that doesn't match the journal, reading the whole journal" );
+      return 0;
+   }
+   _last_changes.reserve( header.count );
+   for( uint64_t i = 0; i < header.count; ++i )
+   {
+      index_entry entry;
+      in.read( (char*)&entry, sizeof(entry) );
+      _last_changes[object_id_type( entry.object_id )] = entry.position;
+   }
+   if( !in )
+   {
+      wlog( "Could not read the state journal index, reading the whole journal" );
+      _last_changes.clear();
+      return 0;
+   }
+   _last_flushed = header.last_flushed;
+   return header.file_size;
+}
+
+void state_journal::save_index()
+{
+   const fc::path tmp = _index_filename.generic_string() + ".tmp";
+   {
+      std::ofstream out( tmp.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      out.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      index_header header;
+      header.first_block = _first_block;
+      header.last_flushed = _last_flushed;
+      header.file_size = _file_size;
+      header.count = _last_changes.size();
+      out.write( (const char*)&header, sizeof(header) );
+      for( const auto& item : _last_changes )
+      {
+         index_entry entry;
+         entry.object_id = item.first.number;
+         entry.position = item.second;
+         out.write( (const char*)&entry, sizeof(entry) );
+      }
+   }
+   if( fc::exists( _index_filename ) )
+      fc::remove( _index_filename );
+   fc::rename( tmp, _index_filename );
+   _flushed_since_index = 0;
+}
+
+void state_journal::restart( uint32_t first_block )
+{
+   if( fc::exists( _index_filename ) )
+      fc::remove( _index_filename );
+   _file.close();
+   fc::resize_file( _filename, 0 );
+   open_journal_file( _file, _filename );
+   journal_header header;
+   header.first_block = first_block;
+   _file.seekp( 0 );
+   _file.write( (const char*)&header, sizeof(header) );
+   _file.flush();
+   _file_size = sizeof(header);
+   _first_block = first_block;
+   _last_flushed = first_block - 1;
+   _flushed_since_index = 0;
+   _pending.clear();
+   _last_changes.clear();
+}
+
+void state_journal::record_block( uint32_t block_num, const undo_state& changes )
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   while( !_pending.empty() && _pending.back().block_num >= block_num )
+      _pending.pop_back();
+   const uint32_t last = _pending.empty() ? _last_flushed : _pending.back().block_num;
+   if( _first_block == 0 || block_num != last + 1 )
+   {
+      if( _first_block != 0 )
+         wlog( "Restarting the state journal at block ${n}, the last recorded block is ${l}",
+               ("n",block_num)("l",last) );
+      restart( block_num );
+   }
+
+   _pending.emplace_back();
+   pending_block& pending = _pending.back();
+   pending.block_num = block_num;
+   auto add = [&pending,block_num]( object_id_type id, bool existed, std::vector<char>&& packed ) {
+      change& c = pending.changes[id];
+      c.block_num = block_num;
+      c.existed = existed;
+      c.packed = std::move( packed );
+   };
+   for( const auto& item : changes.old_values )
+      add( item.first, true, item.second->pack() );
+   for( const auto& item : changes.packed_old_values )
+      add( item.first, true, std::vector<char>( item.second ) );
+   for( const auto& item : changes.removed )
+      add( item.first, true, item.second->pack() );
+   for( const auto& id : changes.new_ids )
+      add( id, false, std::vector<char>() );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+void state_journal::pop_block( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   while( !_pending.empty() && _pending.back().block_num >= block_num )
+      _pending.pop_back();
+   if( _first_block != 0 && block_num <= _last_flushed )
+   {
+      wlog( "Restarting the state journal, block ${n} was popped after it was flushed", ("n",block_num) );
+      restart( block_num );
+   }
+}
+
+void state_journal::flush( uint32_t last_irreversible )
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _pending.empty() || _pending.front().block_num > last_irreversible )
+      return;
+   _file.seekp( _file_size );
+   while( !_pending.empty() && _pending.front().block_num <= last_irreversible )
+   {
+      const pending_block& pending = _pending.front();
+      for( const auto& item : pending.changes )
+      {
+         const change& c = item.second;
+         uint64_t& last_change = _last_changes[item.first];
+         journal_entry entry;
+         entry.object_id = item.first.number;
+         entry.previous = last_change;
+         entry.block_num = pending.block_num;
+         entry.size = c.existed ? c.packed.size() : did_not_exist;
+         _file.write( (const char*)&entry, sizeof(entry) );
+         _file.write( c.packed.data(), c.packed.size() );
+         last_change = _file_size;
+         _file_size += sizeof(entry) + c.packed.size();
+      }
+      journal_entry end;
+      end.object_id = 0;
+      end.previous = 0;
+      end.block_num = pending.block_num;
+      end.size = end_of_block;
+      _file.write( (const char*)&end, sizeof(end) );
+      _file_size += sizeof(end);
+      _last_flushed = pending.block_num;
+      ++_flushed_since_index;
+      _pending.pop_front();
+   }
+   _file.flush();
+   if( _flushed_since_index >= blocks_per_index )
+      save_index();
+} FC_CAPTURE_AND_RETHROW( (last_irreversible) ) }
+
+uint32_t state_journal::first_block()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _first_block;
+}
+
+uint32_t state_journal::last_block()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _first_block == 0 )
+      return 0;
+   return _pending.empty() ? _last_flushed : _pending.back().block_num;
+}
+
+fc::optional<state_journal::change> state_journal::find_change( object_id_type id, uint32_t block_num )const
+{
+   // the flushed blocks are older than the pending ones, an earlier change is in the file if there is one
+   auto last_change = _last_changes.find( id );
+   if( last_change != _last_changes.end() )
+   {
+      uint64_t position = last_change->second;
+      journal_entry entry = read_entry( _file, position );
+      if( entry.block_num > block_num )
+      {
+         // walk back to the earliest change after block_num
+         while( entry.previous != 0 )
+         {
+            const journal_entry previous = read_entry( _file, entry.previous );
+            if( previous.block_num <= block_num )
+               break;
+            position = entry.previous;
+            entry = previous;
+         }
+         change c;
+         c.block_num = entry.block_num;
+         c.existed = entry.size != did_not_exist;
+         if( c.existed )
+         {
+            c.packed.resize( entry.size );
+            _file.seekg( position + sizeof(entry) );
+            _file.read( c.packed.data(), c.packed.size() );
+         }
+         return c;
+      }
+   }
+   for( const pending_block& pending : _pending )
+   {
+      if( pending.block_num <= block_num )
+         continue;
+      auto itr = pending.changes.find( id );
+      if( itr != pending.changes.end() )
+         return itr->second;
+   }
+   return fc::optional<change>();
+}
+
+std::vector<fc::variant> state_journal::get_objects( const object_database& db, const std::vector<object_id_type>& ids,
+                                                     uint32_t block_num, const undo_state* pending_changes )const
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   const uint32_t last = _pending.empty() ? _last_flushed : _pending.back().block_num;
+   FC_ASSERT( _first_block != 0 && block_num + 1 >= _first_block && block_num <= last,
+              "The state journal covers the ends of blocks ${first} to ${last}",
+              ("first",_first_block == 0 ? 0 : _first_block - 1)("last",last) );
+   std::vector<fc::variant> result;
+   result.reserve( ids.size() );
+   for( const object_id_type id : ids )
+   {
+      const fc::optional<change> c = find_change( id, block_num );
+      if( c.valid() )
+      {
+         if( !c->existed )
+            result.emplace_back();
+         else
+            result.push_back( db.get_index( id.space(), id.type() ).packed_object_to_variant( c->packed,
+                                                                                             MAX_NESTING ) );
+         continue;
+      }
+      // unchanged since then up to the end of the last block, the changes made since are undone here
+      if( pending_changes != nullptr )
+      {
+         auto old_value = pending_changes->old_values.find( id );
+         if( old_value != pending_changes->old_values.end() )
+         {
+            result.push_back( old_value->second->to_variant() );
+            continue;
+         }
+         auto packed_old_value = pending_changes->packed_old_values.find( id );
+         if( packed_old_value != pending_changes->packed_old_values.end() )
+         {
+            result.push_back( db.get_index( id.space(), id.type() ).packed_object_to_variant( packed_old_value->second,
+                                                                                             MAX_NESTING ) );
+            continue;
+         }
+         auto removed = pending_changes->removed.find( id );
+         if( removed != pending_changes->removed.end() )
+         {
+            result.push_back( removed->second->to_variant() );
+            continue;
+         }
+         if( pending_changes->new_ids.find( id ) != pending_changes->new_ids.end() )
+         {
+            result.emplace_back();
+            continue;
+         }
+      }
+      const object* obj = db.find_object( id );
+      result.push_back( obj != nullptr ? obj->to_variant() : fc::variant() );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+} } // graphene::db
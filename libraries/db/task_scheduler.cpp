@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/task_scheduler.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace graphene { namespace db {
+
+namespace {
+   /** The scheduler and the index of the worker running on this thread */
+   thread_local const task_scheduler* current_scheduler = nullptr;
+   thread_local uint32_t              current_worker = 0;
+
+   std::mutex                        shared_scheduler_mutex;
+   std::unique_ptr<task_scheduler>   shared_scheduler;
+   std::atomic<task_scheduler*>      shared_pointer{ nullptr };
+   uint32_t                          shared_threads = 0;
+   std::vector<uint32_t>             shared_cpus;
+}
+
+void pin_current_thread( uint32_t cpu )
+{
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+   CPU_SET( cpu, &set );
+   int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+   if( err != 0 )
+      wlog( "Failed to pin thread to CPU ${cpu}, error ${err}", ("cpu",cpu)("err",err) );
+#else
+   wlog( "Pinning threads to CPUs is not supported on this platform" );
+#endif
+}
+
+task_scheduler::task_scheduler( uint32_t num_threads, const std::vector<uint32_t>& cpus )
+{
+   if( num_threads == 0 )
+      num_threads = std::max( 1u, std::thread::hardware_concurrency() );
+   _workers.reserve( num_threads );
+   for( uint32_t i = 0; i < num_threads; ++i )
+      _workers.emplace_back( new worker );
+   // the threads steal from each other, all workers must exist before the first one starts
+   for( uint32_t i = 0; i < num_threads; ++i )
+   {
+      const bool pin = !cpus.empty();
+      const uint32_t cpu = pin ? cpus[i % cpus.size()] : 0;
+      _workers[i]->thread = std::thread( [this,i,pin,cpu] () {
+         if( pin )
+            pin_current_thread( cpu );
+         run( i );
+      } );
+   }
+}
+
+task_scheduler::~task_scheduler()
+{
+   {
+      std::lock_guard<std::mutex> lock( _sleep_mutex );
+      _stopping = true;
+   }
+   _wake.notify_all();
+   for( auto& w : _workers )
+      w->thread.join();
+}
+
+task_scheduler& task_scheduler::shared()
+{
+   task_scheduler* scheduler = shared_pointer.load( std::memory_order_acquire );
+   if( scheduler != nullptr )
+      return *scheduler;
+   std::lock_guard<std::mutex> lock( shared_scheduler_mutex );
+   if( !shared_scheduler )
+   {
+      shared_scheduler.reset( new task_scheduler( shared_threads, shared_cpus ) );
+      shared_pointer.store( shared_scheduler.get(), std::memory_order_release );
+   }
+   return *shared_scheduler;
+}
+
+void task_scheduler::configure_shared( uint32_t num_threads, const std::vector<uint32_t>& cpus )
+{
+   std::lock_guard<std::mutex> lock( shared_scheduler_mutex );
+   if( shared_scheduler )
+   {
+      // e.g. a second application in the same process
+      if( num_threads != 0 && num_threads != shared_scheduler->size() )
+         wlog( "The shared task scheduler already runs ${n} threads, keeping them", ("n",shared_scheduler->size()) );
+      return;
+   }
+   shared_threads = num_threads;
+   shared_cpus = cpus;
+}
+
+void task_scheduler::post( std::function<void()> work, task_priority priority )
+{
+   const uint32_t p = static_cast<uint32_t>( priority );
+   if( on_worker_thread() )
+   {
+      worker& self = *_workers[current_worker];
+      std::lock_guard<std::mutex> lock( self.mutex );
+      self.queues[p].push_back( std::move( work ) );
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock( _shared_mutex );
+      _shared_queues[p].push_back( std::move( work ) );
+   }
+   _queued.fetch_add( 1, std::memory_order_release );
+   // taken under the lock, a thread that found nothing cannot miss the wakeup before it sleeps
+   std::lock_guard<std::mutex> lock( _sleep_mutex );
+   if( _sleeping > 0 )
+      _wake.notify_one();
+}
+
+bool task_scheduler::on_worker_thread()const
+{
+   return current_scheduler == this;
+}
+
+bool task_scheduler::take( uint32_t self, std::function<void()>& task )
+{
+   const uint32_t count = _workers.size();
+   for( uint32_t p = 0; p < task_priority_count; ++p )
+   {
+      if( self < count )
+      {
+         worker& own = *_workers[self];
+         std::lock_guard<std::mutex> lock( own.mutex );
+         if( !own.queues[p].empty() )
+         {
+            task = std::move( own.queues[p].back() );
+            own.queues[p].pop_back();
+            return true;
+         }
+      }
+      {
+         std::lock_guard<std::mutex> lock( _shared_mutex );
+         if( !_shared_queues[p].empty() )
+         {
+            task = std::move( _shared_queues[p].front() );
+            _shared_queues[p].pop_front();
+            return true;
+         }
+      }
+      for( uint32_t k = 1; k <= count; ++k )
+      {
+         const uint32_t victim = ( self + k ) % count;
+         if( victim == self )
+            continue;
+         worker& other = *_workers[victim];
+         std::lock_guard<std::mutex> lock( other.mutex );
+         if( !other.queues[p].empty() )
+         {
+            task = std::move( other.queues[p].front() );
+            other.queues[p].pop_front();
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+bool task_scheduler::run_one()
+{
+   std::function<void()> task;
+   // a thread outside of the pool has no queue of its own and steals from all workers
+   if( !take( on_worker_thread() ? current_worker : size(), task ) )
+      return false;
+   _queued.fetch_sub( 1, std::memory_order_relaxed );
+   task();
+   return true;
+}
+
+void task_scheduler::run( uint32_t self )
+{
+   current_scheduler = this;
+   current_worker = self;
+   while( true )
+   {
+      std::function<void()> task;
+      if( take( self, task ) )
+      {
+         _queued.fetch_sub( 1, std::memory_order_relaxed );
+         task();
+         continue;
+      }
+      std::unique_lock<std::mutex> lock( _sleep_mutex );
+      ++_sleeping;
+      _wake.wait( lock, [this] () { return _stopping || _queued.load( std::memory_order_acquire ) > 0; } );
+      --_sleeping;
+      if( _stopping && _queued.load( std::memory_order_acquire ) == 0 )
+         break;
+   }
+   current_scheduler = nullptr;
+}
+
+fc::exception_ptr task_scheduler::current_exception()
+{
+   try {
+      throw;
+   } catch( const fc::exception& e ) {
+      return e.dynamic_copy_exception();
+   } catch( const std::exception& e ) {
+      return fc::std_exception_wrapper::from_current_exception( e ).dynamic_copy_exception();
+   } catch( ... ) {
+      return std::make_shared<fc::unhandled_exception>( FC_LOG_MESSAGE( warn, "unknown exception in task" ),
+                                                        std::current_exception() );
+   }
+}
+
+task_group::task_group( task_priority priority, task_scheduler& scheduler )
+   : _scheduler( scheduler ), _priority( priority ), _state( std::make_shared<state>() )
+{
+}
+
+task_group::~task_group()
+{
+   try {
+      wait();
+   } catch( const fc::exception& e ) {
+      elog( "A task of a group that was left without waiting for it failed: ${e}", ("e",e.to_detail_string()) );
+   }
+}
+
+void task_group::run( std::function<void()> work )
+{
+   std::shared_ptr<state> shared = _state;
+   {
+      std::lock_guard<std::mutex> lock( shared->mutex );
+      ++shared->pending;
+   }
+   _scheduler.post( [shared,work] () {
+      fc::exception_ptr error;
+      if( !shared->cancelled.load( std::memory_order_relaxed ) )
+      {
+         try {
+            work();
+         } catch( ... ) {
+            error = task_scheduler::current_exception();
+         }
+      }
+      std::lock_guard<std::mutex> lock( shared->mutex );
+      if( error )
+      {
+         // the others must still finish, they may refer to the scope of the group
+         if( !shared->error )
+            shared->error = error;
+         shared->cancelled.store( true, std::memory_order_relaxed );
+      }
+      if( --shared->pending == 0 )
+         shared->finished.notify_all();
+   }, _priority );
+}
+
+void task_group::wait()
+{
+   // waiting on an fc future would yield the fiber, the thread is blocked instead
+   while( true )
+   {
+      {
+         std::lock_guard<std::mutex> lock( _state->mutex );
+         if( _state->pending == 0 )
+            break;
+      }
+      // a thread that only blocked could hold up the very tasks it waits for
+      if( _scheduler.run_one() )
+         continue;
+      // the remaining tasks run on other threads, which run the tasks they queue themselves when they wait
+      std::unique_lock<std::mutex> lock( _state->mutex );
+      _state->finished.wait( lock, [this] () { return _state->pending == 0; } );
+   }
+
+   fc::exception_ptr error;
+   {
+      std::lock_guard<std::mutex> lock( _state->mutex );
+      std::swap( error, _state->error );
+      _state->cancelled.store( false, std::memory_order_relaxed );
+   }
+   if( error )
+      error->dynamic_rethrow_exception();
+}
+
+} } // graphene::db
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/trace.hpp>
+
+#include <fc/thread/thread_specific.hpp>
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace graphene { namespace db {
+
+namespace {
+   /** The open spans of a task */
+   struct trace_state
+   {
+      uint64_t current_span = 0;
+      uint64_t current_trace = 0;
+   };
+
+   /** the state of the current fc task, or of the thread outside of tasks; fibers would share a thread local */
+   trace_state& current_trace_state()
+   {
+      static fc::task_specific_ptr<trace_state> state;
+      if( state.get() == nullptr )
+         state.reset( new trace_state() );
+      return *state;
+   }
+
+   /** the number of the thread, the fibers of a thread record the same one */
+   thread_local uint32_t thread_number = 0;
+
+   /** OTLP wants 16 byte trace ids and 8 byte span ids in hex, the trace ids are padded with zeros */
+   std::string to_hex( uint64_t id, bool trace_id )
+   {
+      char buffer[33];
+      std::snprintf( buffer, sizeof(buffer), trace_id ? "%032llx" : "%016llx", (unsigned long long)id );
+      return buffer;
+   }
+
+   fc::mutable_variant_object otlp_attribute( const char* key, int64_t value )
+   {
+      // OTLP/JSON carries 64 bit integers as strings
+      return fc::mutable_variant_object( "key", key )
+                                       ( "value", fc::mutable_variant_object( "intValue", std::to_string( value ) ) );
+   }
+}
+
+tracer& tracer::instance()
+{
+   static tracer the_tracer;
+   return the_tracer;
+}
+
+void tracer::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = std::max<size_t>( capacity, 1 );
+   _ring.clear();
+   _ring.shrink_to_fit();
+   _oldest = 0;
+}
+
+size_t tracer::capacity()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity;
+}
+
+void tracer::record( const trace_span& span )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _ring.size() < _capacity )
+      _ring.push_back( span );
+   else
+   {
+      _ring[_oldest] = span;
+      _oldest = ( _oldest + 1 ) % _capacity;
+   }
+}
+
+std::vector<trace_span> tracer::spans()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   std::vector<trace_span> result;
+   result.reserve( _ring.size() );
+   result.insert( result.end(), _ring.begin() + _oldest, _ring.end() );
+   result.insert( result.end(), _ring.begin(), _ring.begin() + _oldest );
+   return result;
+}
+
+void tracer::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _ring.clear();
+   _oldest = 0;
+}
+
+fc::variant tracer::to_chrome_trace()const
+{
+   fc::variants events;
+   for( const trace_span& span : spans() )
+   {
+      fc::mutable_variant_object args( "id", span.id );
+      args( "parent_id", span.parent_id );
+      if( span.arg >= 0 )
+         args( "arg", span.arg );
+      events.emplace_back( fc::mutable_variant_object( "name", span.name )
+                                                     ( "ph", "X" )
+                                                     ( "ts", span.start_us )
+                                                     ( "dur", span.duration_us )
+                                                     ( "pid", 1 )
+                                                     ( "tid", span.thread )
+                                                     ( "args", std::move( args ) ) );
+   }
+   return fc::mutable_variant_object( "traceEvents", std::move( events ) )( "displayTimeUnit", "ms" );
+}
+
+fc::variant tracer::to_otlp_json()const
+{
+   fc::variants otlp_spans;
+   for( const trace_span& span : spans() )
+   {
+      fc::variants attributes;
+      attributes.emplace_back( otlp_attribute( "thread.id", span.thread ) );
+      if( span.arg >= 0 )
+         attributes.emplace_back( otlp_attribute( "graphene.arg", span.arg ) );
+      fc::mutable_variant_object otlp_span( "traceId", to_hex( span.trace_id, true ) );
+      otlp_span( "spanId", to_hex( span.id, false ) );
+      if( span.parent_id != 0 )
+         otlp_span( "parentSpanId", to_hex( span.parent_id, false ) );
+      otlp_span( "name", span.name )
+               ( "kind", 1 ) // SPAN_KIND_INTERNAL
+               ( "startTimeUnixNano", std::to_string( span.start_us * 1000 ) )
+               ( "endTimeUnixNano", std::to_string( ( span.start_us + span.duration_us ) * 1000 ) )
+               ( "attributes", std::move( attributes ) );
+      otlp_spans.emplace_back( std::move( otlp_span ) );
+   }
+
+   fc::variants resource_attributes;
+   resource_attributes.emplace_back( fc::mutable_variant_object( "key", "service.name" )
+                                        ( "value", fc::mutable_variant_object( "stringValue", "graphene" ) ) );
+   fc::variants scope_spans;
+   scope_spans.emplace_back( fc::mutable_variant_object( "scope", fc::mutable_variant_object( "name", "graphene" ) )
+                                                       ( "spans", std::move( otlp_spans ) ) );
+   fc::variants resource_spans;
+   resource_spans.emplace_back( fc::mutable_variant_object( "resource",
+                                      fc::mutable_variant_object( "attributes", std::move( resource_attributes ) ) )
+                                   ( "scopeSpans", std::move( scope_spans ) ) );
+   return fc::mutable_variant_object( "resourceSpans", std::move( resource_spans ) );
+}
+
+void trace_scope::begin( const char* name, int64_t arg )
+{
+   tracer& the_tracer = tracer::instance();
+   trace_state& state = current_trace_state();
+   if( thread_number == 0 )
+      thread_number = the_tracer._next_thread.fetch_add( 1, std::memory_order_relaxed );
+
+   _span.name = name;
+   _span.arg = arg;
+   _span.id = the_tracer._next_id.fetch_add( 1, std::memory_order_relaxed );
+   _span.parent_id = state.current_span;
+   _span.trace_id = state.current_span == 0 ? _span.id : state.current_trace;
+   _span.thread = thread_number;
+   _span.start_us = fc::time_point::now().time_since_epoch().count();
+
+   state.current_span = _span.id;
+   state.current_trace = _span.trace_id;
+}
+
+void trace_scope::end()
+{
+   _span.duration_us = fc::time_point::now().time_since_epoch().count() - _span.start_us;
+
+   trace_state& state = current_trace_state();
+   state.current_span = _span.parent_id;
+   if( _span.parent_id == 0 )
+      state.current_trace = 0;
+
+   // a span that finishes after tracing was disabled is still recorded so that its children keep their parent
+   tracer::instance().record( _span );
+}
+
+} } // graphene::db
@@ -25,8 +25,50 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <iterator>
+#include <memory>
+
 namespace graphene { namespace db {
 
+void* undo_arena::allocate( size_t size, size_t alignment )
+{
+   // objects that do not fit into a regular chunk get a chunk of their own, it is put in front so that the
+   // partially used current chunk (always the last one) can still be filled up
+   if( size + alignment > chunk_size )
+   {
+      std::unique_ptr<char[]> chunk( new char[size + alignment] );
+      void* ptr = chunk.get();
+      size_t space = size + alignment;
+      std::align( alignment, size, ptr, space );
+      _capacity += size + alignment;
+      _chunks.insert( _chunks.begin(), std::move(chunk) );
+      return ptr;
+   }
+   size_t offset = ( _used + alignment - 1 ) & ~( alignment - 1 );
+   if( _chunks.empty() || offset + size > chunk_size )
+   {
+      _chunks.emplace_back( new char[chunk_size] );
+      _capacity += chunk_size;
+      offset = 0; // new[] returns memory aligned for any fundamental type
+   }
+   _used = offset + size;
+   return _chunks.back().get() + offset;
+}
+
+void undo_arena::merge( undo_arena&& other )
+{
+   if( other._chunks.empty() ) return;
+   if( _chunks.empty() )
+      _used = other._used;
+   // keep our current chunk at the end
+   _chunks.insert( _chunks.begin(), std::make_move_iterator( other._chunks.begin() ),
+                                    std::make_move_iterator( other._chunks.end() ) );
+   _capacity += other._capacity;
+   other._chunks.clear();
+   other._used = chunk_size;
+   other._capacity = 0;
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -70,7 +112,7 @@ void undo_database::on_create( const object& obj )
       state.old_index_next_ids[index_id] = obj.id;
    state.new_ids.insert(obj.id);
 }
-void undo_database::on_modify( const object& obj )
+void undo_database::on_modify( const object& obj, bool packed )
 {
    if( _disabled ) return;
 
@@ -79,9 +121,11 @@ void undo_database::on_modify( const object& obj )
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
-   auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   if( state.is_modified( obj.id ) ) return;
+   if( packed )
+      state.packed_old_values[obj.id] = obj.pack();
+   else
+      state.old_values[obj.id] = state.copy( obj );
 }
 void undo_database::on_remove( const object& obj )
 {
@@ -101,8 +145,15 @@ void undo_database::on_remove( const object& obj )
       state.old_values.erase(obj.id);
       return;
    }
+   auto packed_itr = state.packed_old_values.find(obj.id);
+   if( packed_itr != state.packed_old_values.end() )
+   {
+      state.removed[obj.id] = state.unpacked_copy( obj, packed_itr->second );
+      state.packed_old_values.erase(packed_itr);
+      return;
+   }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed[obj.id] = state.copy( obj );
 }
 
 void undo_database::undo()
@@ -110,13 +161,24 @@ void undo_database::undo()
    FC_ASSERT( !_disabled );
    FC_ASSERT( _active_sessions > 0 );
    disable();
+   apply_undo_state();
+   enable();
+   --_active_sessions;
+} FC_CAPTURE_AND_RETHROW() }
 
+void undo_database::apply_undo_state()
+{
    auto& state = _stack.back();
    for( auto& item : state.old_values )
    {
       _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
    }
 
+   for( auto& item : state.packed_old_values )
+   {
+      _db.modify( _db.get_object( item.first ), [&]( object& obj ){ obj.unpack_from( item.second ); } );
+   }
+
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
    {
       _db.remove( _db.get_object(*ritr) );
@@ -131,9 +193,7 @@ void undo_database::undo()
       _db.insert( std::move(*item.second) );
 
    _stack.pop_back();
-   enable();
-   --_active_sessions;
-} FC_CAPTURE_AND_RETHROW() }
+}
 
 void undo_database::merge()
 {
@@ -148,6 +208,9 @@ void undo_database::merge()
    auto& state = _stack.back();
    auto& prev_state = _stack[_stack.size()-2];
 
+   // copies moved to prev_state below live in state's arena, which must survive state
+   prev_state.arena.merge( std::move( state.arena ) );
+
    // An object's relationship to a state can be:
    // in new_ids            : new
    // in old_values (was=X) : upd(was=X)
@@ -198,7 +261,7 @@ void undo_database::merge()
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.is_modified(obj.second->id) )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
@@ -209,6 +272,17 @@ void undo_database::merge()
       prev_state.old_values[obj.second->id] = std::move(obj.second);
    }
 
+   // same as above for packed values
+   for( auto& obj : state.packed_old_values )
+   {
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
+         continue;
+      if( prev_state.is_modified(obj.first) )
+         continue;
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
+      prev_state.packed_old_values[obj.first] = std::move(obj.second);
+   }
+
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
    for( auto id : state.new_ids )
       prev_state.new_ids.insert(id);
@@ -247,6 +321,14 @@ void undo_database::merge()
          prev_state.old_values.erase(obj.second->id);
          continue;
       }
+      auto packed_it = prev_state.packed_old_values.find(obj.second->id);
+      if( packed_it != prev_state.packed_old_values.end() )
+      {
+         // upd(was=X) + del(was=Y) -> del(was=X), with X in packed form
+         prev_state.removed[obj.second->id] = prev_state.unpacked_copy( *obj.second, packed_it->second );
+         prev_state.packed_old_values.erase(packed_it);
+         continue;
+      }
       // del + del -> N/A
       assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
@@ -268,27 +350,7 @@ void undo_database::pop_commit()
 
    disable();
    try {
-      auto& state = _stack.back();
-
-      for( auto& item : state.old_values )
-      {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
-      }
-
-      for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
-      {
-         _db.remove( _db.get_object(*ritr) );
-      }
-
-      for( auto& item : state.old_index_next_ids )
-      {
-         _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
-      }
-
-      for( auto& item : state.removed )
-         _db.insert( std::move(*item.second) );
-
-      _stack.pop_back();
+      apply_undo_state();
    }
    catch ( const fc::exception& e )
    {
@@ -43,4 +43,14 @@ fc::sha256 get_egenesis_json_hash()
    return fc::sha256::hash( "" );
 }
 
+void compute_egenesis_packed( std::vector<char>& result )
+{
+   result.clear();
+}
+
+fc::sha256 get_egenesis_packed_hash()
+{
+   return fc::sha256::hash( "" );
+}
+
 } }
@@ -33,6 +33,7 @@
 #include <fc/string.hpp>
 #include <fc/io/fstream.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/protocol/types.hpp>
 
@@ -143,6 +144,26 @@ void convert_to_c_array(
    return;
 }
 
+/// writes data as the elements of an unsigned char array, each followed by a comma
+void convert_to_byte_array(
+   const std::vector<char>& data,
+   std::string& dest,
+   int width = 16 )
+{
+   static const char hex_digits[] = "0123456789abcdef";
+   dest.reserve( data.size() * 5 + data.size() / width + 1 );
+   for( std::vector<char>::size_type i=0; i<data.size(); i++ )
+   {
+      const unsigned char c = static_cast<unsigned char>( data[i] );
+      dest.append( "0x" );
+      dest.append( 1, hex_digits[c >> 4] );
+      dest.append( 1, hex_digits[c & 15] );
+      dest.append( "," );
+      if( (i+1) % width == 0 )
+         dest.append( "\n" );
+   }
+}
+
 struct egenesis_info
 {
    fc::optional< genesis_state_type > genesis;
@@ -152,6 +173,7 @@ struct egenesis_info
    fc::optional< std::string > genesis_json_array;
    int genesis_json_array_width,
        genesis_json_array_height;
+   fc::optional< std::vector<char> > genesis_packed;
 
    void fillin()
    {
@@ -223,6 +245,7 @@ int main( int argc, char** argv )
    cli_options.add_options()
       ("help,h", "Print this help message and exit.")
       ("genesis-json,g", boost::program_options::value<boost::filesystem::path>(), "File to read genesis state from")
+      ("packed,p", "Also embed the genesis state packed in binary, so that nodes need not parse the JSON")
       ("tmplsub,t", boost::program_options::value<std::vector< std::string > >()->composing(),
        "Given argument of form src.cpp.tmpl---dest.cpp, write dest.cpp expanding template invocations in src")
       ;
@@ -248,6 +271,8 @@ int main( int argc, char** argv )
 
    load_genesis( options, info );
    info.fillin();
+   if( options.count("packed") )
+      info.genesis_packed = fc::raw::pack( *info.genesis );
 
    fc::mutable_variant_object template_context = fc::mutable_variant_object()
       ( "generated_file_banner", generated_file_banner )
@@ -261,6 +286,20 @@ int main( int argc, char** argv )
       template_context["genesis_json_array_width"] = info.genesis_json_array_width;
       template_context["genesis_json_array_height"] = info.genesis_json_array_height;
    }
+   std::string genesis_packed_array;
+   if( info.genesis_packed.valid() )
+   {
+      convert_to_byte_array( *info.genesis_packed, genesis_packed_array );
+      template_context["genesis_packed_length"] = info.genesis_packed->size();
+      template_context["genesis_packed_hash"] = fc::sha256::hash( info.genesis_packed->data(),
+                                                                  info.genesis_packed->size() ).str();
+   }
+   else
+   {
+      template_context["genesis_packed_length"] = 0;
+      template_context["genesis_packed_hash"] = fc::sha256::hash( "" ).str();
+   }
+   template_context["genesis_packed_array"] = genesis_packed_array;
 
    for( const std::string& src_dest : options["tmplsub"].as< std::vector< std::string > >() )
    {
@@ -25,6 +25,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <fc/crypto/sha256.hpp>
 #include <graphene/chain/protocol/types.hpp>
@@ -48,4 +49,15 @@ void compute_egenesis_json( std::string& result );
  */
 fc::sha256 get_egenesis_json_hash();
 
+/**
+ * Get the egenesis state packed with fc::raw, or nothing if it was not compiled in. Unpacking it gives the state
+ * of the JSON of compute_egenesis_json() without parsing that, its chain ID is still get_egenesis_json_hash().
+ */
+void compute_egenesis_packed( std::vector<char>& result );
+
+/**
+ * The data returned by compute_egenesis_packed() should have this hash.
+ */
+fc::sha256 get_egenesis_packed_hash();
+
 } } // graphene::egenesis
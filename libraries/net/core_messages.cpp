@@ -45,6 +45,25 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_block_transactions_message::type        = core_message_type_enum::fetch_block_transactions_message_type;
+  const core_message_type_enum block_transactions_message::type              = core_message_type_enum::block_transactions_message_type;
+  const core_message_type_enum fetch_block_headers_message::type             = core_message_type_enum::fetch_block_headers_message_type;
+  const core_message_type_enum block_headers_message::type                   = core_message_type_enum::block_headers_message_type;
+
+  compact_block_message::compact_block_message( const item_hash_t& block_message_hash,
+                                                const graphene::chain::signed_block& block ) :
+    block_message_hash( block_message_hash ),
+    header( block )
+  {
+    transaction_ids.reserve( block.transactions.size() );
+    operation_results.reserve( block.transactions.size() );
+    for( const auto& trx : block.transactions )
+    {
+      transaction_ids.push_back( trx.id() );
+      operation_results.push_back( trx.operation_results );
+    }
+  }
 
 } } // graphene::net
 
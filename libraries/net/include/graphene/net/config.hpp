@@ -60,6 +60,14 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Transaction relay queued to a single peer beyond this many bytes is dropped
+ * rather than counted against GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES, so
+ * a peer that can't keep up with a transaction flood sheds transactions instead
+ * of being disconnected or starving its block traffic
+ */
+#define GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTIONS_IN_BYTES    (256 * 1024)
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
@@ -84,6 +92,28 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * During sync, the number of blocks requested from a peer at a time adapts to the rate
+ * the peer delivered its previous batch at, aiming at batches that take
+ * GRAPHENE_NET_SYNC_BATCH_TARGET_SECONDS.  A peer starts with the minimum, and never
+ * gets more than GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING.  Slow peers thus hold
+ * few of the blocks everybody waits for, and fast peers are asked first.
+ */
+#define GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING      20
+#define GRAPHENE_NET_SYNC_BATCH_TARGET_SECONDS               2
+
+/**
+ * During header-first sync, the headers of at most GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST
+ * blocks are asked from a peer at a time, and the headers of at most
+ * GRAPHENE_NET_MAX_SYNC_HEADERS_AHEAD blocks are kept validated ahead of the blocks handed to
+ * the client.  The headers are checked against the witness keys of the head block, which
+ * rarely change within that many blocks.  A peer that doesn't answer a header request within
+ * GRAPHENE_NET_SYNC_HEADERS_REQUEST_TIMEOUT_SEC is disconnected.
+ */
+#define GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST           1000
+#define GRAPHENE_NET_MAX_SYNC_HEADERS_AHEAD                  20000
+#define GRAPHENE_NET_SYNC_HEADERS_REQUEST_TIMEOUT_SEC        10
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -110,3 +140,11 @@
 #define GRAPHENE_NET_MAX_NESTED_OBJECTS                      (250)
 
 #define MAXIMUM_PEERDB_SIZE 1000
+
+/**
+ * The peer database journal is fsynced at most this often, and is compacted
+ * into a fresh snapshot once it holds this many times more records than the
+ * database has live entries
+ */
+#define GRAPHENE_NET_PEERDB_SYNC_INTERVAL_SECONDS            30
+#define GRAPHENE_NET_PEERDB_COMPACTION_RATIO                 4
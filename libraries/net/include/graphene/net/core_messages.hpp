@@ -86,6 +86,11 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_block_transactions_message_type        = 5019,
+    block_transactions_message_type              = 5020,
+    fetch_block_headers_message_type             = 5021,
+    block_headers_message_type                   = 5022,
     core_message_type_last                       = 5099
   };
 
@@ -400,6 +405,66 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /**
+   * A block_message without its transactions, only their ids, sent instead of the block to peers that announced
+   * compact block support in their hello. They already have most of the transactions from the trx_message relay,
+   * and ask for the others with a fetch_block_transactions_message. Blocks are requested compactly by sending
+   * fetch_items_message with this type and the hashes of the block messages.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    compact_block_message() {}
+    compact_block_message( const item_hash_t& block_message_hash, const graphene::chain::signed_block& block );
+
+    /// the hash of the block_message this stands for, under which the block was requested
+    item_hash_t                                      block_message_hash;
+    graphene::chain::signed_block_header             header;
+    std::vector<graphene::chain::transaction_id_type> transaction_ids;
+    /// the results of the operations of each transaction, which the transaction merkle root covers
+    std::vector< std::vector<graphene::chain::operation_result> > operation_results;
+  };
+
+  /// asks the sender of a compact_block_message for the transactions of the block that could not be found
+  struct fetch_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t           block_message_hash;
+    std::vector<uint32_t> transaction_indexes; ///< positions in the block, ascending
+  };
+
+  /// the reply to a fetch_block_transactions_message
+  struct block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t                                         block_message_hash;
+    std::vector<graphene::chain::precomputable_transaction> transactions; ///< in the order they were asked for
+  };
+
+  /**
+   * Asks a peer that announced header sync support in its hello for the headers of blocks it offered during
+   * sync.  The headers are checked against each other and against the witness keys before the blocks are
+   * fetched, so a peer offering a bad chain is found out for the price of its headers, not of its blocks.
+   */
+  struct fetch_block_headers_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<item_hash_t> block_ids; ///< no more than GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST
+  };
+
+  /// the reply to a fetch_block_headers_message
+  struct block_headers_message
+  {
+    static const core_message_type_enum type;
+
+    /// in the order they were asked for, up to the first block the sender doesn't have
+    std::vector<graphene::chain::signed_block_header> headers;
+  };
+
 
 } } // graphene::net
 
@@ -424,6 +489,11 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_block_transactions_message_type)
+                 (block_transactions_message_type)
+                 (fetch_block_headers_message_type)
+                 (block_headers_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -508,6 +578,16 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT( graphene::net::compact_block_message, (block_message_hash)
+                                             (header)
+                                             (transaction_ids)
+                                             (operation_results) )
+FC_REFLECT( graphene::net::fetch_block_transactions_message, (block_message_hash)
+                                                        (transaction_indexes) )
+FC_REFLECT( graphene::net::block_transactions_message, (block_message_hash)
+                                                  (transactions) )
+FC_REFLECT( graphene::net::fetch_block_headers_message, (block_ids) )
+FC_REFLECT( graphene::net::block_headers_message, (headers) )
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
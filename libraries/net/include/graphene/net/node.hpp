@@ -29,6 +29,7 @@
 
 #include <graphene/chain/protocol/types.hpp>
 
+#include <functional>
 #include <list>
 
 namespace graphene { namespace net {
@@ -54,6 +55,15 @@ namespace graphene { namespace net {
     node_id_t originating_peer;
   };
 
+   /// what the client can tell of a block header received during header-first sync, see node_delegate::check_sync_block_header()
+   enum class sync_block_header_check
+   {
+      signed_by_witness_key, ///< signed with the key the client knows for the witness
+      other_signing_key,     ///< the client knows the witness with another key, which may have changed since the head block
+      unknown_witness,       ///< the witness doesn't exist yet at the head block
+      invalid                ///< the signature can't be right whatever happened before the block
+   };
+
    /**
     *  @class node_delegate
     *  @brief used by node reports status to client or fetch data from client
@@ -88,6 +98,16 @@ namespace graphene { namespace net {
           */
          virtual void handle_transaction( const graphene::net::trx_message& trx_msg ) = 0;
 
+         /**
+          *  @brief Called with the transactions that arrived from the network while the previous ones were
+          *         handled, so they cost one call into the delegate's thread.  The default passes them to
+          *         handle_transaction() one by one.
+          *
+          *  @returns for each transaction, the exception it was rejected with, or nothing if it is safe to
+          *           broadcast on
+          */
+         virtual std::vector<fc::oexception> handle_transactions( const std::vector<graphene::net::trx_message>& trx_msgs );
+
          /**
           *  @brief Called when a new message comes in from the network other than a
           *         block or a transaction.  Currently there are no other possible 
@@ -114,6 +134,31 @@ namespace graphene { namespace net {
           */
          virtual message get_item( const item_id& id ) = 0;
 
+         /**
+          *  Fetches several items in one call, nothing for the items the delegate doesn't have.  The default
+          *  calls get_item() for each.
+          */
+         virtual std::vector<fc::optional<message> > get_items( const std::vector<item_id>& ids );
+
+         /**
+          *  Fetches the headers of blocks for a peer syncing header-first, up to the first block the delegate
+          *  doesn't have.  The default gets the blocks through get_items().
+          */
+         virtual std::vector<graphene::chain::signed_block_header> get_block_headers( const std::vector<item_hash_t>& block_ids );
+
+         /**
+          *  Checks the witness signature of a block header received during header-first sync, which can be far
+          *  ahead of the head block, against the witnesses of the head block.  The default can't tell anything.
+          */
+         virtual sync_block_header_check check_sync_block_header( const graphene::chain::signed_block_header& header );
+
+         /**
+          *  Looks up transactions of a compact block among the transactions the client has pending, unset for
+          *  those it doesn't have.  The default has none.
+          */
+         virtual std::vector<fc::optional<graphene::chain::precomputable_transaction> > find_pending_transactions(
+               const std::vector<graphene::chain::transaction_id_type>& ids );
+
          virtual chain_id_type get_chain_id()const = 0;
 
          /**
@@ -292,6 +337,9 @@ namespace graphene { namespace net {
 
         void disable_peer_advertising();
         fc::variant_object get_call_statistics() const;
+
+        /** Runs work on the thread of the node and waits for it, e.g. to set the CPUs of the thread */
+        void run_on_network_thread( const std::function<void()>& work );
       private:
         std::unique_ptr<detail::node_impl, detail::node_impl_deleter> my;
    };
@@ -28,6 +28,7 @@
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
+#include <graphene/net/rolling_bloom_filter.hpp>
 
 #include <boost/tuple/tuple.hpp>
 
@@ -40,6 +41,7 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <map>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -166,8 +168,24 @@ namespace graphene { namespace net
       };
 
 
+      /* messages are sent strictly in priority order, FIFO within a priority.  Blocks and
+       * sync responses go out ahead of ordinary traffic, and transaction relay is only sent
+       * when nothing else is waiting, so a transaction flood can't delay block propagation.
+       */
+      enum message_priority
+      {
+        block_priority,
+        normal_priority,
+        transaction_relay_priority,
+        message_priority_count
+      };
+      static message_priority get_message_priority(const message& message_to_send);
+      static message_priority get_item_priority(const item_id& item_to_send);
+
+      typedef std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > queued_message_queue;
       size_t _total_queued_messages_size;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      size_t _total_queued_transaction_relay_size;
+      queued_message_queue _queued_messages[message_priority_count];
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -231,6 +249,11 @@ namespace graphene { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      uint32_t sync_block_window = GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING; /// how many blocks to request in the next sync batch, adapted to the rate this peer delivers at
+      fc::time_point sync_batch_requested_time; /// when the sync batch in flight was requested
+      uint32_t sync_batch_size = 0; /// the number of blocks in the sync batch in flight, 0 once it is measured
+      std::set<item_hash_t> sync_headers_requested_from_peer; /// ids of blocks whose headers we've asked this peer for during header-first sync
+      fc::time_point sync_headers_requested_time; /// when the header request in flight was sent
       /// @}
 
       /// non-synchronization state data
@@ -251,7 +274,8 @@ namespace graphene { namespace net
                                                                           boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
                                                                                                                  boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
       timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      /// only used to avoid advertising items twice, forgetting one or a rare false positive is harmless there
+      rolling_bloom_filter inventory_advertised_to_peer{fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES)};
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
       /// @}
@@ -261,6 +285,39 @@ namespace graphene { namespace net
       fc::time_point transaction_fetching_inhibited_until;
 
       uint32_t last_known_fork_block_number;
+      /// whether the peer announced in its hello that it understands compact_block_message
+      bool supports_compact_blocks = false;
+      /// whether the peer announced in its hello that it answers fetch_block_headers_message
+      bool supports_block_headers = false;
+      /// blocks rebuilt from compact blocks of this peer that wait for the transactions asked for, by block message hash
+      std::map<item_hash_t, std::pair<graphene::chain::signed_block, std::vector<uint32_t> > > compact_blocks_awaiting_transactions;
+
+      /// telemetry for diagnosing slow peers
+      /// @{
+      struct message_type_traffic
+      {
+        uint64_t messages_sent = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t messages_received = 0;
+        uint64_t bytes_received = 0;
+      };
+      struct request_latency
+      {
+        uint64_t         responses = 0;
+        fc::microseconds total;
+        fc::microseconds max;
+        void record(const fc::microseconds& latency)
+        {
+          ++responses;
+          total += latency;
+          if (latency > max)
+            max = latency;
+        }
+      };
+      std::map<uint32_t, message_type_traffic> traffic_by_message_type; /// bytes include the message headers
+      request_latency fetch_items_latency; /// from requesting an item during normal operation until it arrives
+      request_latency sync_items_latency; /// from requesting a sync block until it arrives
+      /// @}
 
       fc::future<void> accept_or_connect_task_done;
 
@@ -285,7 +342,7 @@ namespace graphene { namespace net
       void on_message(message_oriented_connection* originating_connection, const message& received_message) override;
       void on_connection_closed(message_oriented_connection* originating_connection) override;
 
-      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
+      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send, message_priority priority);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
       void send_item(const item_id& item_to_send);
       void close_connection();
@@ -293,6 +350,8 @@ namespace graphene { namespace net
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      size_t get_queued_message_count() const;
+      size_t get_total_queued_messages_size() const { return _total_queued_messages_size + _total_queued_transaction_relay_size; }
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <fc/time.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   * Remembers the items inserted during the last window of time in a few bloom filters, one per
+   * generation, instead of storing the items themselves.  For the "did we already tell this peer"
+   * kind of question where forgetting or a rare false positive only costs a redundant or a missed
+   * advertisement.
+   *
+   * A new generation starts when the newest one is full or covers more than window / generations.  Each
+   * is sized for twice the items of the previous one, between the minimum and maximum capacity, so idle
+   * peers cost a few kilobytes.  When more generations would be needed to cover the window the oldest is
+   * dropped early, which makes items be forgotten sooner, but keeps the false positive rate at about
+   * 0.05% per generation.
+   */
+  class rolling_bloom_filter
+  {
+  public:
+    rolling_bloom_filter( fc::microseconds window, uint32_t generations = 4,
+                          uint32_t min_capacity = 1024, uint32_t max_capacity = 32768 );
+
+    void insert( const item_id& item, fc::time_point now = fc::time_point::now() );
+    /// false if the item certainly wasn't inserted during the window
+    bool may_contain( const item_id& item ) const;
+    /// forgets the generations that only hold items older than the window
+    void expire( fc::time_point now = fc::time_point::now() );
+
+    /// the number of items the live generations hold, duplicates included
+    size_t size() const;
+    size_t memory_usage() const;
+
+    static const uint32_t bits_per_item = 16;
+    static const uint32_t hash_functions = 11;
+
+  private:
+    struct generation
+    {
+      std::vector<uint64_t> bits;
+      uint32_t              capacity = 0;
+      uint32_t              count = 0;
+      fc::time_point        started;
+    };
+
+    void start_generation( fc::time_point now );
+
+    fc::microseconds       _window;
+    uint32_t               _generations;
+    uint32_t               _min_capacity;
+    uint32_t               _max_capacity;
+    std::deque<generation> _filters; ///< the newest at the back
+  };
+
+} } // graphene::net
@@ -56,6 +56,9 @@ class stcp_socket : public virtual fc::iostream
     using istream::get;
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
+
+    /// bytes encrypted or decrypted per call into the cipher, large enough for a typical block in one go
+    static const size_t buffer_length = 64 * 1024;
   private:
     void do_key_exchange();
 
@@ -21,6 +21,8 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <algorithm>
+
 #include <fc/thread/thread.hpp>
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/scoped_lock.hpp>
@@ -255,15 +257,35 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
         if( message_to_send.size > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        // the socket encrypts whole 16 byte blocks, and the message we send is padded to a multiple of 16 bytes.
+        // Only the first block, which holds the header, and the padded last block are assembled here, the rest
+        // is encrypted straight from the message, so large messages like blocks aren't copied once per peer
+        const size_t BLOCK_SIZE = 16;
+        static_assert(BLOCK_SIZE >= sizeof(message_header), "insufficient buffer");
+        const char* data = message_to_send.data.data();
+        size_t leading_bytes = std::min<size_t>(message_to_send.size, BLOCK_SIZE - sizeof(message_header));
+        char first_block[BLOCK_SIZE] = {};
+        memcpy(first_block, (char*)&message_to_send, sizeof(message_header));
+        memcpy(first_block + sizeof(message_header), data, leading_bytes);
+        _sock.write(first_block, BLOCK_SIZE);
+        size_t size_with_padding = BLOCK_SIZE;
+
+        size_t remaining_bytes = message_to_send.size - leading_bytes;
+        size_t aligned_bytes = remaining_bytes - remaining_bytes % BLOCK_SIZE;
+        if (aligned_bytes)
+        {
+          _sock.write(data + leading_bytes, aligned_bytes);
+          size_with_padding += aligned_bytes;
+        }
+        if (remaining_bytes > aligned_bytes)
+        {
+          char last_block[BLOCK_SIZE] = {};
+          memcpy(last_block, data + leading_bytes + aligned_bytes, remaining_bytes - aligned_bytes);
+          _sock.write(last_block, BLOCK_SIZE);
+          size_with_padding += BLOCK_SIZE;
+        }
         _sock.flush();
         _bytes_sent += size_with_padding;
         _last_message_sent_time = fc::time_point::now();
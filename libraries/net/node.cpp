@@ -80,6 +80,8 @@
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/utilities/task_monitor.hpp>
+
 #include <fc/git_revision.hpp>
 
 //#define ENABLE_DEBUG_ULOGS
@@ -175,6 +177,7 @@ namespace graphene { namespace net {
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
       message get_message( const message_hash_type& hash_of_message_to_lookup );
+      message get_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
@@ -208,6 +211,18 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    message blockchain_tied_message_cache::get_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
+    {
+      if( hash_of_message_contents_to_lookup != fc::uint160_t() )
+      {
+        message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+           _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
+        if( iter != _message_cache.get<message_contents_hash_index>().end() )
+          return iter->message_body;
+      }
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+    }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
     {
       if( hash_of_message_contents_to_lookup != fc::uint160_t() )
@@ -507,9 +522,24 @@ namespace graphene { namespace net { namespace detail {
         peer->last_sync_item_received_time = fc::time_point::now();
         peer->sync_items_requested_from_peer.insert(item_to_request);
       }
+      peer->sync_batch_requested_time = fc::time_point::now();
+      peer->sync_batch_size = (uint32_t)items_to_request.size();
       peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
     }
 
+    void node_impl::request_sync_headers_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& block_ids )
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog( "requesting the headers of ${count} block(s) from peer ${endpoint}",
+            ("count", block_ids.size())("endpoint", peer->get_remote_endpoint()) );
+      _active_sync_header_requests.insert(block_ids.begin(), block_ids.end());
+      peer->sync_headers_requested_from_peer.insert(block_ids.begin(), block_ids.end());
+      peer->sync_headers_requested_time = fc::time_point::now();
+      fetch_block_headers_message request;
+      request.block_ids = block_ids;
+      peer->send_message(request);
+    }
+
     void node_impl::fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -521,42 +551,85 @@ namespace graphene { namespace net { namespace detail {
         if (!_suspend_fetching_sync_blocks)
         {
           std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
+          std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_header_requests_to_send;
 
           {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            // ask the peers that support header-first sync for the headers of the blocks ahead, each peer for
+            // a different part of the range, so the headers of the whole range come in quickly from many peers
+            bool any_peer_has_sync_items = false;
+            std::set<item_hash_t> sync_headers_to_request;
             for( const peer_connection_ptr& peer : _active_connections )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+              if( !peer->we_need_sync_items_from_peer )
+                continue;
+              any_peer_has_sync_items = true;
+              if( !_header_first_sync || !peer->supports_block_headers || peer->inhibit_fetching_sync_blocks ||
+                  !peer->sync_headers_requested_from_peer.empty() )
+                continue;
+              std::vector<item_hash_t> block_ids;
+              for( const item_hash_t& block_id : peer->ids_of_items_to_get )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                if( block_ids.size() >= GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST ||
+                    _validated_sync_headers.size() + _active_sync_header_requests.size() + sync_headers_to_request.size() >=
+                      GRAPHENE_NET_MAX_SYNC_HEADERS_AHEAD )
+                  break;
+                if( _validated_sync_headers.find(block_id) == _validated_sync_headers.end() &&
+                    _active_sync_header_requests.find(block_id) == _active_sync_header_requests.end() &&
+                    sync_headers_to_request.find(block_id) == sync_headers_to_request.end() &&
+                    !have_already_received_sync_item(block_id) )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
+                  block_ids.push_back(block_id);
+                  sync_headers_to_request.insert(block_id);
+                }
+              }
+              if( !block_ids.empty() )
+                sync_header_requests_to_send[peer] = std::move(block_ids);
+            }
+            // headers of blocks that never came, e.g. of a fork its peers left, aren't needed once we're in sync
+            if( !any_peer_has_sync_items )
+              _validated_sync_headers.clear();
+
+            // the idle peers that we're syncing with, the fastest first so they get the blocks we need soonest
+            std::vector<peer_connection_ptr> idle_sync_peers;
+            for( const peer_connection_ptr& peer : _active_connections )
+              if( peer->we_need_sync_items_from_peer && peer->idle() && !peer->inhibit_fetching_sync_blocks )
+                idle_sync_peers.push_back( peer );
+            std::stable_sort( idle_sync_peers.begin(), idle_sync_peers.end(),
+                              []( const peer_connection_ptr& a, const peer_connection_ptr& b ) {
+                                 return a->sync_block_window > b->sync_block_window;
+                              } );
+
+            for( const peer_connection_ptr& peer : idle_sync_peers )
+            {
+              uint32_t window = std::min<uint32_t>( peer->sync_block_window, _maximum_blocks_per_peer_during_syncing );
+              // loop through the items it has that we don't yet have on our blockchain
+              for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
+              {
+                item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
+                // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                    sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                    _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() && // we've requested it in a previous iteration and we're still waiting for it to arrive
+                    ( !_header_first_sync || !peer->supports_block_headers || // the peer can give us its headers, so its blocks wait for them
+                      _validated_sync_headers.find(item_to_potentially_request) != _validated_sync_headers.end() ) )
+                {
+                  // then schedule a request from this peer
+                  sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
+                  sync_items_to_request.insert( item_to_potentially_request );
+                  if (sync_item_requests_to_send[peer].size() >= window)
+                    break;
                 }
               }
             }
           } // end non-preemptable section
 
           // make all the requests we scheduled in the loop above
+          for( auto sync_header_request : sync_header_requests_to_send )
+            request_sync_headers_from_peer( sync_header_request.first, sync_header_request.second );
+          sync_header_requests_to_send.clear();
           for( auto sync_item_request : sync_item_requests_to_send )
             request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
           sync_item_requests_to_send.clear();
@@ -686,7 +759,12 @@ namespace graphene { namespace net { namespace detail {
                  ("count", items_by_type.second.size())("type", (uint32_t)items_by_type.first)
                  ("endpoint", peer_and_items.peer->get_remote_endpoint())
                  ("hashes", items_by_type.second));
-            peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
+            // peers that understand compact blocks send them in place of the blocks, the items stay
+            // recorded as requested blocks
+            uint32_t requested_type = items_by_type.first;
+            if (requested_type == graphene::net::block_message_type && peer_and_items.peer->supports_compact_blocks)
+              requested_type = graphene::net::compact_block_message_type;
+            peer_and_items.peer->send_message(fetch_items_message(requested_type,
                                                                   items_by_type.second));
           }
         }
@@ -730,6 +808,13 @@ namespace graphene { namespace net { namespace detail {
         std::unordered_set<item_id> inventory_to_advertise;
         inventory_to_advertise.swap(_new_inventory);
 
+        // forget what we advertised before the peers forget it, and remember what we're advertising now
+        fc::time_point_sec oldest_advertised_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
+        _advertised_inventory.get<peer_connection::timestamp_index>().erase(_advertised_inventory.get<peer_connection::timestamp_index>().begin(),
+                                                                          _advertised_inventory.get<peer_connection::timestamp_index>().lower_bound(oldest_advertised_inventory_to_keep));
+        for (const item_id& item_to_advertise : inventory_to_advertise)
+          _advertised_inventory.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
+
         // process all inventory to advertise and construct the inventory messages we'll send
         // first, then send them all in a batch (to avoid any fiber interruption points while
         // we're computing the messages)
@@ -749,14 +834,14 @@ namespace graphene { namespace net { namespace detail {
             idump((inventory_to_advertise));
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
-               auto adv_to_peer = peer->inventory_advertised_to_peer.find(item_to_advertise);
+               bool adv_to_peer = peer->inventory_advertised_to_peer.may_contain(item_to_advertise);
                auto adv_to_us   = peer->inventory_peer_advertised_to_us.find(item_to_advertise);
 
-              if (adv_to_peer == peer->inventory_advertised_to_peer.end() &&
+              if (!adv_to_peer &&
                   adv_to_us == peer->inventory_peer_advertised_to_us.end())
               {
                 items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
+                peer->inventory_advertised_to_peer.insert(item_to_advertise);
                 ++total_items_to_send_to_this_peer;
                 if (item_to_advertise.item_type == trx_message_type)
                   testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
@@ -764,8 +849,8 @@ namespace graphene { namespace net { namespace detail {
               }
               else
               {
-                 if (adv_to_peer != peer->inventory_advertised_to_peer.end() )
-                    idump( (*adv_to_peer) );
+                 if (adv_to_peer)
+                    dlog( "already advertised ${item} to peer ${endpoint}", ("item", item_to_advertise)("endpoint", peer->get_remote_endpoint()) );
                  if (adv_to_us != peer->inventory_peer_advertised_to_us.end() )
                     idump( (*adv_to_us) );
               }
@@ -883,6 +968,14 @@ namespace graphene { namespace net { namespace detail {
                    ("peer", active_peer->get_remote_endpoint())("count", active_peer->sync_items_requested_from_peer.size()));
               disconnect_due_to_request_timeout = true;
             }
+            if (!disconnect_due_to_request_timeout &&
+                !active_peer->sync_headers_requested_from_peer.empty() &&
+                active_peer->sync_headers_requested_time < fc::time_point::now() - fc::seconds(GRAPHENE_NET_SYNC_HEADERS_REQUEST_TIMEOUT_SEC))
+            {
+              wlog("Disconnecting peer ${peer} because they didn't answer my request for ${count} block headers",
+                   ("peer", active_peer->get_remote_endpoint())("count", active_peer->sync_headers_requested_from_peer.size()));
+              disconnect_due_to_request_timeout = true;
+            }
             if (!disconnect_due_to_request_timeout &&
                 active_peer->item_ids_requested_from_peer &&
                 active_peer->item_ids_requested_from_peer->get<1>() < active_ignored_request_threshold)
@@ -1039,6 +1132,8 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       _average_network_read_speed_seconds.push_back(bytes_read_this_second);
       _average_network_write_speed_seconds.push_back(bytes_written_this_second);
+      _total_bytes_read += bytes_read_this_second;
+      _total_bytes_written += bytes_written_this_second;
       ++_average_network_usage_second_counter;
       if (_average_network_usage_second_counter >= 60)
       {
@@ -1313,6 +1408,21 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_block_transactions_message_type:
+        on_fetch_block_transactions_message(originating_peer, received_message.as<fetch_block_transactions_message>());
+        break;
+      case core_message_type_enum::block_transactions_message_type:
+        on_block_transactions_message(originating_peer, received_message.as<block_transactions_message>());
+        break;
+      case core_message_type_enum::fetch_block_headers_message_type:
+        on_fetch_block_headers_message(originating_peer, received_message.as<fetch_block_headers_message>());
+        break;
+      case core_message_type_enum::block_headers_message_type:
+        on_block_headers_message(originating_peer, received_message.as<block_headers_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1356,6 +1466,9 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+      user_data["block_headers"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1378,6 +1491,10 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>(1);
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>(1);
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as_bool();
+      if (user_data.contains("block_headers"))
+        originating_peer->supports_block_headers = user_data["block_headers"].as_bool();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2251,46 +2368,55 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
+      if (fetch_items_message_received.item_type == compact_block_message_type)
+      {
+        send_compact_blocks(originating_peer, fetch_items_message_received.items_to_fetch);
+        return;
+      }
+
       fc::optional<message> last_block_message_sent;
 
-      std::list<message> reply_messages;
-      for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
+      // answer from the cache what we can, and ask the delegate for the rest in one call
+      const std::vector<item_hash_t>& items_to_fetch = fetch_items_message_received.items_to_fetch;
+      std::vector<fc::optional<message> > replies(items_to_fetch.size());
+      std::vector<item_id> items_for_delegate;
+      std::vector<size_t> delegate_item_indexes;
+      for (size_t i = 0; i < items_to_fetch.size(); ++i)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          replies[i] = _message_cache.get_message(items_to_fetch[i]);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
-          continue;
+               ("id", replies[i]->id()));
         }
         catch (fc::key_not_found_exception&)
         {
            // it wasn't in our local cache, that's ok ask the client
+           items_for_delegate.emplace_back(fetch_items_message_received.item_type, items_to_fetch[i]);
+           delegate_item_indexes.push_back(i);
         }
+      }
+      if (!items_for_delegate.empty())
+      {
+        std::vector<fc::optional<message> > delegate_items = _delegate->get_items(items_for_delegate);
+        for (size_t i = 0; i < items_for_delegate.size() && i < delegate_items.size(); ++i)
+          replies[delegate_item_indexes[i]] = std::move(delegate_items[i]);
+      }
 
-        item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
-        try
-        {
-          message requested_message = _delegate->get_item(item_to_fetch);
-          dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
-               ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
-          continue;
-        }
-        catch (fc::key_not_found_exception&)
+      std::list<message> reply_messages;
+      for (size_t i = 0; i < items_to_fetch.size(); ++i)
+      {
+        if (!replies[i])
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(item_not_available_message(item_id(fetch_items_message_received.item_type, items_to_fetch[i])));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
+          continue;
         }
+        reply_messages.push_back(*replies[i]);
+        if (fetch_items_message_received.item_type == block_message_type)
+          last_block_message_sent = *replies[i];
       }
 
       // if we sent them a block, update our record of the last block they've seen accordingly
@@ -2315,6 +2441,8 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       const item_id& requested_item = item_not_available_message_received.requested_item;
       auto regular_item_iter = originating_peer->items_requested_from_peer.find(requested_item);
+      if (requested_item.item_type == block_message_type)
+        originating_peer->compact_blocks_awaiting_transactions.erase(requested_item.item_hash);
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
@@ -2357,18 +2485,16 @@ namespace graphene { namespace net { namespace detail {
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
-        bool we_advertised_this_item_to_a_peer = false;
+        // the per peer filters have false positives, whether we advertised it at all is known exactly
+        bool we_advertised_this_item_to_a_peer = _advertised_inventory.find(advertised_item_id) != _advertised_inventory.end();
         bool we_requested_this_item_from_a_peer = false;
-        for (const peer_connection_ptr peer : _active_connections)
-        {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
-          {
-            we_advertised_this_item_to_a_peer = true;
-            break;
-          }
-          if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
-            we_requested_this_item_from_a_peer = true;
-        }
+        if (!we_advertised_this_item_to_a_peer)
+          for (const peer_connection_ptr peer : _active_connections)
+            if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
+            {
+              we_requested_this_item_from_a_peer = true;
+              break;
+            }
 
         // if we have already advertised it to a peer, we must have it, no need to do anything else
         if (!we_advertised_this_item_to_a_peer)
@@ -2518,6 +2644,13 @@ namespace graphene { namespace net { namespace detail {
           _active_sync_requests.erase(sync_item);
         trigger_fetch_sync_items_loop();
       }
+      if (!originating_peer->sync_headers_requested_from_peer.empty())
+      {
+        for (const item_hash_t& block_id : originating_peer->sync_headers_requested_from_peer)
+          _active_sync_header_requests.erase(block_id);
+        trigger_fetch_sync_items_loop();
+      }
+      forget_sync_headers_from_peer(originating_peer);
 
       if (!originating_peer->items_requested_from_peer.empty())
       {
@@ -2539,6 +2672,7 @@ namespace graphene { namespace net { namespace detail {
       bool discontinue_fetching_blocks_from_peer = false;
 
       fc::oexception handle_message_exception;
+      _validated_sync_headers.erase(block_message_to_send.block_id);
 
       try
       {
@@ -3009,6 +3143,23 @@ namespace graphene { namespace net { namespace detail {
         disconnect_from_peer(peer.get(), disconnect_reason, true, *disconnect_exception);
       }
     }
+    void node_impl::update_sync_block_window(peer_connection* peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (peer->sync_batch_size == 0)
+        return;
+      int64_t elapsed_us = std::max<int64_t>((fc::time_point::now() - peer->sync_batch_requested_time).count(), 1000);
+      uint64_t deliverable = uint64_t(peer->sync_batch_size) * fc::seconds(GRAPHENE_NET_SYNC_BATCH_TARGET_SECONDS).count() / elapsed_us;
+      // grow at most twofold per batch, one quick batch may have been luck
+      uint64_t window = std::min<uint64_t>(deliverable, 2 * uint64_t(peer->sync_block_window));
+      window = std::min<uint64_t>(window, _maximum_blocks_per_peer_during_syncing);
+      peer->sync_block_window = (uint32_t)std::max<uint64_t>(window, GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING);
+      dlog("peer ${endpoint} delivered ${count} sync blocks in ${ms} ms, next window ${window}",
+           ("endpoint", peer->get_remote_endpoint())("count", peer->sync_batch_size)
+           ("ms", elapsed_us / 1000)("window", peer->sync_block_window));
+      peer->sync_batch_size = 0;
+    }
+
     void node_impl::process_block_message(peer_connection* originating_peer,
                                           const message& message_to_process,
                                           const message_hash_type& message_hash)
@@ -3022,6 +3173,7 @@ namespace graphene { namespace net { namespace detail {
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
+        originating_peer->fetch_items_latency.record(fc::time_point::now() - item_iter->second);
         originating_peer->items_requested_from_peer.erase(item_iter);
         process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
         if (originating_peer->idle())
@@ -3035,13 +3187,20 @@ namespace graphene { namespace net { namespace detail {
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
+          if (originating_peer->sync_items_requested_from_peer.empty())
+            update_sync_block_window(originating_peer);
           // if exceptions are throw here after removing the sync item from the list (above),
           // it could leave our sync in a stalled state.  Wrap a try/catch around the rest
           // of the function so we can log if this ever happens.
           try
           {
             originating_peer->last_sync_item_received_time = fc::time_point::now();
-            _active_sync_requests.erase(block_message_to_process.block_id);
+            auto active_request_iter = _active_sync_requests.find(block_message_to_process.block_id);
+            if (active_request_iter != _active_sync_requests.end())
+            {
+              originating_peer->sync_items_latency.record(fc::time_point::now() - active_request_iter->second);
+              _active_sync_requests.erase(active_request_iter);
+            }
             process_block_during_sync(originating_peer, block_message_to_process, message_hash);
             if (originating_peer->idle())
             {
@@ -3089,6 +3248,385 @@ namespace graphene { namespace net { namespace detail {
       disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
     }
 
+    void node_impl::on_fetch_block_headers_message( peer_connection* originating_peer,
+                                                    const fetch_block_headers_message& fetch_block_headers_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      const std::vector<item_hash_t>& block_ids = fetch_block_headers_message_received.block_ids;
+      if (block_ids.size() > GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST)
+      {
+        wlog("Peer ${peer} asked me for ${count} block headers at once, disconnecting",
+             ("peer", originating_peer->get_remote_endpoint())("count", block_ids.size()));
+        disconnect_from_peer(originating_peer, "You asked me for too many block headers at once");
+        return;
+      }
+      block_headers_message reply;
+      reply.headers = _delegate->get_block_headers(block_ids);
+      dlog("sending ${count} of the ${requested} block headers peer ${peer} asked for",
+           ("count", reply.headers.size())("requested", block_ids.size())("peer", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_headers_message( peer_connection* originating_peer,
+                                              const block_headers_message& block_headers_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      if (originating_peer->sync_headers_requested_from_peer.empty())
+      {
+        wlog("Received block headers from peer ${peer} I didn't ask for, ignoring them",
+             ("peer", originating_peer->get_remote_endpoint()));
+        return;
+      }
+
+      // the block before each block we asked for in the list the peer offered us, whose id its header must link to
+      std::unordered_map<item_hash_t, item_hash_t> previous_block_ids;
+      {
+        fc::optional<item_hash_t> previous_id;
+        for (const item_hash_t& block_id : originating_peer->ids_of_items_to_get)
+        {
+          if (originating_peer->sync_headers_requested_from_peer.find(block_id) !=
+              originating_peer->sync_headers_requested_from_peer.end())
+            previous_block_ids[block_id] = previous_id ? *previous_id : item_hash_t();
+          previous_id = block_id;
+        }
+      }
+
+      // the witness schedule and the transactions can only be checked when the block is applied; here the header
+      // must link to the one before, be signed and be at least a block interval after the one before
+      const fc::time_point_sec now = fc::time_point::now();
+      std::vector<item_hash_t> validated_block_ids;
+      uint32_t signed_by_known_key = 0;
+      uint32_t signed_by_other_key = 0;
+      std::string invalid_header_reason;
+      item_hash_t invalid_block_id;
+      for (const graphene::chain::signed_block_header& header : block_headers_message_received.headers)
+      {
+        const item_hash_t block_id = header.id();
+        invalid_block_id = block_id;
+        if (originating_peer->sync_headers_requested_from_peer.find(block_id) ==
+            originating_peer->sync_headers_requested_from_peer.end())
+        {
+          invalid_header_reason = "I didn't ask for this block";
+          break;
+        }
+        auto previous_iter = previous_block_ids.find(block_id);
+        if (previous_iter == previous_block_ids.end())
+          continue; // we got the block meanwhile, so it isn't in the peer's list anymore
+
+        bool links_to_previous_block = false;
+        fc::time_point_sec previous_time = fc::time_point_sec::min();
+        auto validated_previous_iter = _validated_sync_headers.find(header.previous);
+        if (validated_previous_iter != _validated_sync_headers.end())
+          previous_time = validated_previous_iter->second.timestamp;
+        if (previous_iter->second != item_hash_t())
+          links_to_previous_block = header.previous == previous_iter->second;
+        else
+        {
+          // the first block of the list follows a block we have
+          links_to_previous_block = validated_previous_iter != _validated_sync_headers.end() ||
+                                    _delegate->has_item(item_id(block_message_type, header.previous)) ||
+                                    have_already_received_sync_item(header.previous);
+          if (validated_previous_iter == _validated_sync_headers.end())
+            previous_time = _delegate->get_block_time(header.previous);
+        }
+        if (!links_to_previous_block)
+        {
+          invalid_header_reason = "it doesn't link to the block before it in the list you offered me";
+          break;
+        }
+        if (previous_time != fc::time_point_sec::min() && header.timestamp < previous_time + GRAPHENE_MIN_BLOCK_INTERVAL)
+        {
+          invalid_header_reason = "it isn't later than the block before it";
+          break;
+        }
+        if (header.timestamp > now + GRAPHENE_NET_FUTURE_SYNC_BLOCKS_GRACE_PERIOD_SEC)
+        {
+          invalid_header_reason = "it is in the future";
+          break;
+        }
+        sync_block_header_check signature_check = _delegate->check_sync_block_header(header);
+        if (signature_check == sync_block_header_check::invalid)
+        {
+          invalid_header_reason = "its witness signature is invalid";
+          break;
+        }
+        if (signature_check == sync_block_header_check::unknown_witness)
+        {
+          // nothing vouches for the signature, the block and those after it are fetched without their headers
+          // and checked when they are applied
+          dlog("the header of block ${id} from peer ${peer} is signed by a witness I don't know yet",
+               ("id", block_id)("peer", originating_peer->get_remote_endpoint()));
+          break;
+        }
+        if (signature_check == sync_block_header_check::signed_by_witness_key)
+          ++signed_by_known_key;
+        else if (signature_check == sync_block_header_check::other_signing_key)
+          ++signed_by_other_key;
+
+        _validated_sync_headers[block_id] = validated_sync_header{header.timestamp, originating_peer};
+        validated_block_ids.push_back(block_id);
+      }
+      // a few witnesses may have changed their key since our head block, but a chain not signed by the
+      // witnesses we know is signed mostly by other keys
+      if (invalid_header_reason.empty() && signed_by_other_key > signed_by_known_key)
+        invalid_header_reason = "most headers aren't signed with the keys of their witnesses";
+
+      uint32_t block_ids_requested = (uint32_t)previous_block_ids.size();
+      for (const item_hash_t& block_id : originating_peer->sync_headers_requested_from_peer)
+        _active_sync_header_requests.erase(block_id);
+      originating_peer->sync_headers_requested_from_peer.clear();
+
+      if (!invalid_header_reason.empty())
+      {
+        // the headers it sent before aren't any more trustworthy than this batch
+        forget_sync_headers_from_peer(originating_peer);
+        wlog("Peer ${peer} sent me an invalid header for block ${id}: ${reason}, disconnecting",
+             ("peer", originating_peer->get_remote_endpoint())("id", invalid_block_id)("reason", invalid_header_reason));
+        fc::exception error_for_peer(FC_LOG_MESSAGE(error, "You sent me an invalid header for block ${id}: ${reason}",
+                                                    ("id", invalid_block_id)("reason", invalid_header_reason)));
+        disconnect_from_peer(originating_peer, "You sent me invalid block headers", true, error_for_peer);
+        return;
+      }
+
+      dlog("validated ${count} block headers from peer ${peer}",
+           ("count", validated_block_ids.size())("peer", originating_peer->get_remote_endpoint()));
+      if (validated_block_ids.size() < block_ids_requested)
+      {
+        // the peer doesn't have all the blocks it offered, maybe it switched forks; fetch its blocks the old way
+        dlog("Peer ${peer} sent only ${count} of the ${requested} block headers I asked for, syncing without its headers",
+             ("peer", originating_peer->get_remote_endpoint())("count", validated_block_ids.size())("requested", block_ids_requested));
+        originating_peer->supports_block_headers = false;
+      }
+      trigger_fetch_sync_items_loop();
+    }
+
+    void node_impl::forget_sync_headers_from_peer( const peer_connection* peer )
+    {
+      VERIFY_CORRECT_THREAD();
+      for (auto iter = _validated_sync_headers.begin(); iter != _validated_sync_headers.end();)
+        if (iter->second.validated_from == peer)
+          iter = _validated_sync_headers.erase(iter);
+        else
+          ++iter;
+    }
+
+    void node_impl::send_compact_blocks( peer_connection* originating_peer, const std::vector<item_hash_t>& block_message_hashes )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::optional<graphene::net::block_id_type> last_block_id_sent;
+      for (const item_hash_t& block_message_hash : block_message_hashes)
+      {
+        // a new block is asked for by most peers at about the same time, it is packed only once for all of them
+        auto recent_iter = std::find_if(_recent_compact_blocks.begin(), _recent_compact_blocks.end(),
+                                        [&block_message_hash](const recent_compact_block& recent) {
+                                          return recent.block_message_hash == block_message_hash;
+                                        });
+        if (recent_iter != _recent_compact_blocks.end())
+        {
+          originating_peer->send_message(recent_iter->compact_block);
+          last_block_id_sent = recent_iter->block_id;
+          continue;
+        }
+
+        item_id block_item(block_message_type, block_message_hash);
+        message block_message_to_send = get_message_for_item(block_item);
+        if (block_message_to_send.msg_type != block_message_type)
+        {
+          dlog("received compact block request from peer ${endpoint} but we don't have the block",
+               ("endpoint", originating_peer->get_remote_endpoint()));
+          originating_peer->send_message(item_not_available_message(block_item));
+          continue;
+        }
+        graphene::net::block_message block = block_message_to_send.as<graphene::net::block_message>();
+        message compact_block(compact_block_message(block_message_hash, block.block));
+        originating_peer->send_message(compact_block);
+        _recent_compact_blocks.push_back(recent_compact_block{block_message_hash, block.block_id, std::move(compact_block)});
+        if (_recent_compact_blocks.size() > GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS)
+          _recent_compact_blocks.pop_front();
+        last_block_id_sent = block.block_id;
+      }
+
+      if (last_block_id_sent)
+      {
+        originating_peer->last_block_delegate_has_seen = *last_block_id_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(*last_block_id_sent);
+      }
+    }
+
+    fc::optional<graphene::chain::precomputable_transaction> node_impl::find_transaction_for_compact_block( const graphene::chain::transaction_id_type& id )
+    {
+      try
+      {
+        return _message_cache.get_message_by_contents_hash(id).as<trx_message>().trx;
+      }
+      catch (fc::key_not_found_exception&)
+      {}
+      return fc::optional<graphene::chain::precomputable_transaction>();
+    }
+
+    void node_impl::on_compact_block_message( peer_connection* originating_peer,
+                                              const compact_block_message& compact_block_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = compact_block_message_received.block_message_hash;
+      if (originating_peer->items_requested_from_peer.find(item_id(block_message_type, block_message_hash)) ==
+          originating_peer->items_requested_from_peer.end() ||
+          compact_block_message_received.transaction_ids.size() != compact_block_message_received.operation_results.size())
+      {
+        wlog("received a compact block I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, hash: ${hash}",
+                                                    ("hash", block_message_hash)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      graphene::chain::signed_block block;
+      static_cast<graphene::chain::signed_block_header&>(block) = compact_block_message_received.header;
+      block.transactions.reserve(compact_block_message_received.transaction_ids.size());
+      // transactions are in the message cache for a while after they were relayed, after that the client may
+      // still have them pending; an applied transaction can't be in a new block
+      std::vector<fc::optional<graphene::chain::precomputable_transaction> > transactions;
+      transactions.reserve(compact_block_message_received.transaction_ids.size());
+      std::vector<graphene::chain::transaction_id_type> uncached_ids;
+      std::vector<uint32_t> uncached_indexes;
+      for (uint32_t i = 0; i < compact_block_message_received.transaction_ids.size(); ++i)
+      {
+        transactions.push_back(find_transaction_for_compact_block(compact_block_message_received.transaction_ids[i]));
+        if (!transactions.back())
+        {
+          uncached_ids.push_back(compact_block_message_received.transaction_ids[i]);
+          uncached_indexes.push_back(i);
+        }
+      }
+      if (!uncached_ids.empty())
+      {
+        std::vector<fc::optional<graphene::chain::precomputable_transaction> > pending =
+            _delegate->find_pending_transactions(uncached_ids);
+        for (size_t i = 0; i < uncached_indexes.size() && i < pending.size(); ++i)
+          transactions[uncached_indexes[i]] = std::move(pending[i]);
+      }
+
+      std::vector<uint32_t> missing_transaction_indexes;
+      for (uint32_t i = 0; i < compact_block_message_received.transaction_ids.size(); ++i)
+      {
+        const fc::optional<graphene::chain::precomputable_transaction>& trx = transactions[i];
+        if (trx)
+        {
+          block.transactions.push_back(graphene::chain::processed_transaction(*trx));
+          block.transactions.back().operation_results = compact_block_message_received.operation_results[i];
+        }
+        else
+        {
+          // keep the position, the operation results are all we know of it until the transaction arrives
+          block.transactions.emplace_back();
+          block.transactions.back().operation_results = compact_block_message_received.operation_results[i];
+          missing_transaction_indexes.push_back(i);
+        }
+      }
+
+      if (missing_transaction_indexes.empty())
+      {
+        process_rebuilt_compact_block(originating_peer, block_message_hash, block);
+        return;
+      }
+
+      dlog("missing ${count} of ${total} transactions of compact block ${hash} from peer ${endpoint}, asking for them",
+           ("count", missing_transaction_indexes.size())("total", block.transactions.size())
+           ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+      fetch_block_transactions_message request;
+      request.block_message_hash = block_message_hash;
+      request.transaction_indexes = missing_transaction_indexes;
+      originating_peer->compact_blocks_awaiting_transactions[block_message_hash] =
+          std::make_pair(std::move(block), std::move(missing_transaction_indexes));
+      originating_peer->send_message(request);
+    }
+
+    void node_impl::on_fetch_block_transactions_message( peer_connection* originating_peer,
+                                                         const fetch_block_transactions_message& fetch_block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id block_item(block_message_type, fetch_block_transactions_message_received.block_message_hash);
+      message block_message_to_send = get_message_for_item(block_item);
+      if (block_message_to_send.msg_type == block_message_type)
+      {
+        graphene::net::block_message block = block_message_to_send.as<graphene::net::block_message>();
+        block_transactions_message reply;
+        reply.block_message_hash = fetch_block_transactions_message_received.block_message_hash;
+        reply.transactions.reserve(fetch_block_transactions_message_received.transaction_indexes.size());
+        bool indexes_valid = true;
+        for (uint32_t index : fetch_block_transactions_message_received.transaction_indexes)
+        {
+          if (index >= block.block.transactions.size())
+          {
+            indexes_valid = false;
+            break;
+          }
+          reply.transactions.push_back(graphene::chain::precomputable_transaction(block.block.transactions[index]));
+        }
+        if (indexes_valid)
+        {
+          originating_peer->send_message(reply);
+          return;
+        }
+      }
+      dlog("received request for transactions of a block from peer ${endpoint} that we can't serve",
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(item_not_available_message(block_item));
+    }
+
+    void node_impl::on_block_transactions_message( peer_connection* originating_peer,
+                                                   const block_transactions_message& block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      auto pending_iter = originating_peer->compact_blocks_awaiting_transactions.find(block_transactions_message_received.block_message_hash);
+      if (pending_iter == originating_peer->compact_blocks_awaiting_transactions.end())
+      {
+        dlog("received transactions of a compact block from peer ${endpoint} that we aren't waiting for, ignoring them",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+      graphene::chain::signed_block block = std::move(pending_iter->second.first);
+      std::vector<uint32_t> missing_transaction_indexes = std::move(pending_iter->second.second);
+      originating_peer->compact_blocks_awaiting_transactions.erase(pending_iter);
+
+      const auto& transactions = block_transactions_message_received.transactions;
+      if (transactions.size() != missing_transaction_indexes.size())
+      {
+        wlog("peer ${endpoint} sent ${count} transactions of a compact block, we asked for ${expected}, fetching the full block",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("count", transactions.size())("expected", missing_transaction_indexes.size()));
+        originating_peer->send_message(fetch_items_message(block_message_type,
+                                                           std::vector<item_hash_t>{block_transactions_message_received.block_message_hash}));
+        return;
+      }
+      for (size_t i = 0; i < transactions.size(); ++i)
+      {
+        graphene::chain::processed_transaction& trx = block.transactions[missing_transaction_indexes[i]];
+        std::vector<graphene::chain::operation_result> operation_results = std::move(trx.operation_results);
+        trx = graphene::chain::processed_transaction(transactions[i]);
+        trx.operation_results = std::move(operation_results);
+      }
+      process_rebuilt_compact_block(originating_peer, block_transactions_message_received.block_message_hash, block);
+    }
+
+    void node_impl::process_rebuilt_compact_block( peer_connection* originating_peer, const item_hash_t& block_message_hash,
+                                                   const graphene::chain::signed_block& block )
+    {
+      VERIFY_CORRECT_THREAD();
+      // the block is handed on as if it arrived in full, so it has to be exactly the block that was requested
+      graphene::net::block_message rebuilt_block_message(block);
+      message rebuilt_message(rebuilt_block_message);
+      if (block.calculate_merkle_root() != block.transaction_merkle_root || rebuilt_message.id() != block_message_hash)
+      {
+        wlog("compact block ${hash} from peer ${endpoint} doesn't rebuild the requested block, fetching the full block",
+             ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(fetch_items_message(block_message_type, std::vector<item_hash_t>{block_message_hash}));
+        return;
+      }
+      process_block_message(originating_peer, rebuilt_message, block_message_hash);
+    }
+
     void node_impl::on_current_time_request_message(peer_connection* originating_peer,
                                                     const current_time_request_message& current_time_request_message_received)
     {
@@ -3372,22 +3910,25 @@ namespace graphene { namespace net { namespace detail {
       }
       else
       {
+        originating_peer->fetch_items_latency.record(fc::time_point::now() - iter->second);
         originating_peer->items_requested_from_peer.erase( iter );
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
+        // transactions are handed to the delegate together with the others that arrive meanwhile
+        if (message_to_process.msg_type == trx_message_type)
+        {
+          _pending_transactions.push_back(pending_transaction{message_to_process, message_hash, message_receive_time,
+                                                              originating_peer->node_id});
+          trigger_process_pending_transactions();
+          return;
+        }
+
         // Next: have the delegate process the message
         fc::time_point message_validated_time;
         try
         {
-          if (message_to_process.msg_type == trx_message_type)
-          {
-            trx_message transaction_message_to_process = message_to_process.as<trx_message>();
-            dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
-            _delegate->handle_transaction(transaction_message_to_process);
-          }
-          else
-            _delegate->handle_message( message_to_process );
+          _delegate->handle_message( message_to_process );
           message_validated_time = fc::time_point::now();
         }
         catch ( const fc::canceled_exception& )
@@ -3408,6 +3949,75 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    void node_impl::trigger_process_pending_transactions()
+    {
+      VERIFY_CORRECT_THREAD();
+      if (!_node_is_shutting_down &&
+          (!_process_pending_transactions_done.valid() || _process_pending_transactions_done.ready()))
+        _process_pending_transactions_done = fc::async([=](){ process_pending_transactions(); }, "process_pending_transactions");
+    }
+
+    void node_impl::process_pending_transactions()
+    {
+      VERIFY_CORRECT_THREAD();
+      while (!_pending_transactions.empty())
+      {
+        std::vector<pending_transaction> batch;
+        batch.swap(_pending_transactions);
+
+        std::vector<trx_message> transactions;
+        std::vector<fc::oexception> results(batch.size());
+        std::vector<size_t> batch_indexes;
+        transactions.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+          try
+          {
+            transactions.push_back(batch[i].transaction_message.as<trx_message>());
+            batch_indexes.push_back(i);
+          }
+          catch (const fc::exception& e)
+          {
+            results[i] = e;
+          }
+        }
+        dlog("passing ${count} transactions to client", ("count", transactions.size()));
+        std::vector<fc::oexception> delegate_results;
+        try
+        {
+          delegate_results = _delegate->handle_transactions(transactions);
+        }
+        catch (const fc::canceled_exception&)
+        {
+          throw;
+        }
+        catch (const fc::exception& e)
+        {
+          delegate_results.assign(transactions.size(), fc::oexception(e));
+        }
+        FC_ASSERT(delegate_results.size() == transactions.size(), "node_delegate::handle_transactions() returned the wrong number of results");
+        fc::time_point message_validated_time = fc::time_point::now();
+        for (size_t i = 0; i < batch_indexes.size(); ++i)
+          results[batch_indexes[i]] = delegate_results[i];
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+          const pending_transaction& transaction = batch[i];
+          if (results[i])
+          {
+            wlog("client rejected transaction sent by peer ${peer}, ${e}", ("peer", transaction.originating_peer)("e", *results[i]));
+            // record it so we don't try to fetch this item again
+            _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(trx_message_type, transaction.message_hash),
+                                                                              fc::time_point::now()));
+            continue;
+          }
+          // the delegate validated the transaction, broadcast it to our other peers
+          message_propagation_data propagation_data{transaction.received_time, message_validated_time, transaction.originating_peer};
+          broadcast(transaction.transaction_message, propagation_data);
+        }
+      }
+    }
+
     void node_impl::start_synchronizing_with_peer( const peer_connection_ptr& peer )
     {
       VERIFY_CORRECT_THREAD();
@@ -3507,6 +4117,24 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating P2P connect loop, ignoring" );
       }
 
+      try
+      {
+        _process_pending_transactions_done.cancel_and_wait("node_impl::close()");
+        dlog("Process pending transactions task terminated");
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        dlog("Process pending transactions task terminated");
+      }
+      catch ( const fc::exception& e )
+      {
+        wlog( "Exception thrown while terminating Process pending transactions task, ignoring: ${e}", ("e", e) );
+      }
+      catch (...)
+      {
+        wlog( "Exception thrown while terminating Process pending transactions task, ignoring" );
+      }
+
       try
       {
         _process_backlog_of_sync_blocks_done.cancel_and_wait("node_impl::close()");
@@ -4415,6 +5043,26 @@ namespace graphene { namespace net { namespace detail {
         peer_details["current_head_block_number"] = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details["current_head_block_time"] = peer->last_block_time_delegate_has_seen;
 
+        // per message type traffic, keyed by the numeric message type, and how quickly the peer answers
+        fc::mutable_variant_object traffic;
+        for (const auto& type_and_traffic : peer->traffic_by_message_type)
+          traffic[std::to_string(type_and_traffic.first)] = fc::mutable_variant_object()
+              ("messages_sent", type_and_traffic.second.messages_sent)
+              ("bytes_sent", type_and_traffic.second.bytes_sent)
+              ("messages_received", type_and_traffic.second.messages_received)
+              ("bytes_received", type_and_traffic.second.bytes_received);
+        peer_details["traffic_by_message_type"] = traffic;
+        peer_details["queued_messages"] = peer->get_queued_message_count();
+        peer_details["queued_bytes"] = peer->get_total_queued_messages_size();
+        auto latency_details = [](const peer_connection::request_latency& latency) -> fc::mutable_variant_object {
+          return fc::mutable_variant_object()
+              ("responses", latency.responses)
+              ("average_us", latency.responses ? latency.total.count() / int64_t(latency.responses) : 0)
+              ("max_us", latency.max.count());
+        };
+        peer_details["fetch_items_latency"] = latency_details(peer->fetch_items_latency);
+        peer_details["sync_items_latency"] = latency_details(peer->sync_items_latency);
+
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
       }
@@ -4498,6 +5146,8 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>(1);
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>(1);
+      if (params.contains("header_first_sync"))
+        _header_first_sync = params["header_first_sync"].as_bool();
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4517,6 +5167,7 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["header_first_sync"] = _header_first_sync;
       return result;
     }
 
@@ -4615,6 +5266,8 @@ namespace graphene { namespace net { namespace detail {
       result["usage_by_second"] = fc::variant( network_usage_by_second, 2 );
       result["usage_by_minute"] = fc::variant( network_usage_by_minute, 2 );
       result["usage_by_hour"]   = fc::variant( network_usage_by_hour, 2 );
+      result["total_bytes_received"] = _total_bytes_read;
+      result["total_bytes_sent"]     = _total_bytes_written;
       return result;
     }
 
@@ -4644,6 +5297,75 @@ namespace graphene { namespace net { namespace detail {
     return my->method_name(__VA_ARGS__)
 #endif // P2P_IN_DEDICATED_THREAD
 
+  std::vector<fc::oexception> node_delegate::handle_transactions( const std::vector<graphene::net::trx_message>& trx_msgs )
+  {
+    std::vector<fc::oexception> results;
+    results.reserve(trx_msgs.size());
+    for (const trx_message& trx_msg : trx_msgs)
+    {
+      try
+      {
+        handle_transaction(trx_msg);
+        results.emplace_back();
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        results.emplace_back(e);
+      }
+    }
+    return results;
+  }
+
+  std::vector<fc::optional<message> > node_delegate::get_items( const std::vector<item_id>& ids )
+  {
+    std::vector<fc::optional<message> > items;
+    items.reserve(ids.size());
+    for (const item_id& id : ids)
+    {
+      try
+      {
+        items.emplace_back(get_item(id));
+      }
+      catch (const fc::key_not_found_exception&)
+      {
+        items.emplace_back();
+      }
+    }
+    return items;
+  }
+
+  std::vector<graphene::chain::signed_block_header> node_delegate::get_block_headers( const std::vector<item_hash_t>& block_ids )
+  {
+    std::vector<item_id> ids;
+    ids.reserve(block_ids.size());
+    for (const item_hash_t& block_id : block_ids)
+      ids.emplace_back(block_message_type, block_id);
+
+    std::vector<graphene::chain::signed_block_header> headers;
+    for (const fc::optional<message>& item : get_items(ids))
+    {
+      if (!item)
+        break;
+      headers.push_back(item->as<block_message>().block);
+    }
+    return headers;
+  }
+
+  sync_block_header_check node_delegate::check_sync_block_header( const graphene::chain::signed_block_header& )
+  {
+    return sync_block_header_check::unknown_witness;
+  }
+
+  std::vector<fc::optional<graphene::chain::precomputable_transaction> > node_delegate::find_pending_transactions(
+        const std::vector<graphene::chain::transaction_id_type>& ids )
+  {
+    return std::vector<fc::optional<graphene::chain::precomputable_transaction> >(ids.size());
+  }
+
   node::node(const std::string& user_agent) :
     my(new detail::node_impl(user_agent))
   {
@@ -4785,6 +5507,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(get_call_statistics);
   }
 
+  void node::run_on_network_thread( const std::function<void()>& work )
+  {
+    my->_thread->async( work, "run_on_network_thread" ).wait();
+  }
+
   fc::variant_object node::network_get_info() const
   {
     INVOKE_IN_IMPL(network_get_info);
@@ -4919,7 +5646,7 @@ namespace graphene { namespace net { namespace detail {
         return _node_delegate->method_name(__VA_ARGS__); \
       } \
       else \
-        return _thread->async([&](){ \
+        return graphene::utilities::monitored_async(*_thread, [&](){ \
           call_statistics_collector::actual_execution_measurement_helper helper(statistics_collector); \
           return _node_delegate->method_name(__VA_ARGS__); \
         }, "invoke " BOOST_STRINGIZE(method_name)).wait(); \
@@ -4951,7 +5678,7 @@ namespace graphene { namespace net { namespace detail {
       return _node_delegate->method_name(__VA_ARGS__); \
     } \
     else \
-      return _thread->async([&](){ \
+      return graphene::utilities::monitored_async(*_thread, [&](){ \
         call_statistics_collector::actual_execution_measurement_helper helper(statistics_collector); \
         return _node_delegate->method_name(__VA_ARGS__); \
       }, "invoke " BOOST_STRINGIZE(method_name)).wait()
@@ -4977,6 +5704,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
     }
 
+    std::vector<fc::oexception> statistics_gathering_node_delegate_wrapper::handle_transactions( const std::vector<graphene::net::trx_message>& transaction_messages )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(handle_transactions, transaction_messages);
+    }
+
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                                                                        uint32_t& remaining_item_count,
                                                                                        uint32_t limit /* = 2000 */)
@@ -4989,6 +5721,27 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
+    std::vector<fc::optional<message> > statistics_gathering_node_delegate_wrapper::get_items( const std::vector<item_id>& ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_items, ids);
+    }
+
+    std::vector<graphene::chain::signed_block_header> statistics_gathering_node_delegate_wrapper::get_block_headers( const std::vector<item_hash_t>& block_ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_block_headers, block_ids);
+    }
+
+    sync_block_header_check statistics_gathering_node_delegate_wrapper::check_sync_block_header( const graphene::chain::signed_block_header& header )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(check_sync_block_header, header);
+    }
+
+    std::vector<fc::optional<graphene::chain::precomputable_transaction> > statistics_gathering_node_delegate_wrapper::find_pending_transactions(
+          const std::vector<graphene::chain::transaction_id_type>& ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(find_pending_transactions, ids);
+    }
+
     chain_id_type statistics_gathering_node_delegate_wrapper::get_chain_id() const
     {
       INVOKE_AND_COLLECT_STATISTICS(get_chain_id);
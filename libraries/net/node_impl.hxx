@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include <memory>
 #include <fc/thread/thread.hpp>
 #include <fc/log/logger.hpp>
@@ -49,8 +50,13 @@ private:
                                (handle_message) \
                                (handle_block) \
                                (handle_transaction) \
+                               (handle_transactions) \
                                (get_block_ids) \
                                (get_item) \
+                               (get_items) \
+                               (get_block_headers) \
+                               (check_sync_block_header) \
+                               (find_pending_transactions) \
                                (get_chain_id) \
                                (get_blockchain_synopsis) \
                                (sync_status) \
@@ -146,10 +152,16 @@ private:
       void handle_message( const message& ) override;
       bool handle_block( const graphene::net::block_message& block_message, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids ) override;
       void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
+      std::vector<fc::oexception> handle_transactions( const std::vector<graphene::net::trx_message>& transaction_messages ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
       message get_item( const item_id& id ) override;
+      std::vector<fc::optional<message> > get_items( const std::vector<item_id>& ids ) override;
+      std::vector<graphene::chain::signed_block_header> get_block_headers( const std::vector<item_hash_t>& block_ids ) override;
+      sync_block_header_check check_sync_block_header( const graphene::chain::signed_block_header& header ) override;
+      std::vector<fc::optional<graphene::chain::precomputable_transaction> > find_pending_transactions(
+            const std::vector<graphene::chain::transaction_id_type>& ids ) override;
       graphene::chain::chain_id_type get_chain_id() const override;
       std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point,
                                                        uint32_t number_of_blocks_after_reference_point) override;
@@ -209,6 +221,16 @@ class node_impl : public peer_connection_delegate
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
       std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+
+      bool _header_first_sync = true; /// fetch blocks from peers supporting it only once their headers passed the checks
+      std::set<item_hash_t> _active_sync_header_requests; /// blocks whose headers we've asked for from peers but have not yet received
+      struct validated_sync_header
+      {
+        fc::time_point_sec timestamp;
+        peer_connection*   validated_from; /// the peer that sent the header, its headers are forgotten when it goes
+      };
+      /// blocks whose headers passed the header-first checks and which weren't handed to the client yet
+      std::unordered_map<item_hash_t, validated_sync_header> _validated_sync_headers;
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -287,6 +309,24 @@ class node_impl : public peer_connection_delegate
       std::vector<uint32_t> _hard_fork_block_numbers; /// list of all block numbers where there are hard forks
 
       blockchain_tied_message_cache _message_cache; /// cache message we have received and might be required to provide to other peers via inventory requests
+      peer_connection::timestamped_items_set_type _advertised_inventory; /// what we advertised to any peer during the last GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES
+      struct recent_compact_block
+      {
+        item_hash_t                   block_message_hash;
+        graphene::net::block_id_type  block_id;
+        message                       compact_block;
+      };
+      std::deque<recent_compact_block> _recent_compact_blocks; /// compact blocks packed for one peer, sent as they are to the others
+
+      struct pending_transaction
+      {
+        message           transaction_message;
+        message_hash_type message_hash;
+        fc::time_point    received_time;
+        node_id_t         originating_peer;
+      };
+      std::vector<pending_transaction> _pending_transactions; /// transactions we asked for that arrived, but aren't yet handed to the delegate
+      fc::future<void> _process_pending_transactions_done;
 
       fc::rate_limiting_group _rate_limiter;
 
@@ -304,6 +344,9 @@ class node_impl : public peer_connection_delegate
       boost::circular_buffer<uint32_t> _average_network_write_speed_hours;
       unsigned _average_network_usage_second_counter;
       unsigned _average_network_usage_minute_counter;
+      /// all bytes read and written since the node started, as counted by the bandwidth monitor
+      uint64_t _total_bytes_read = 0;
+      uint64_t _total_bytes_written = 0;
 
       fc::time_point_sec _bandwidth_monitor_last_update_time;
       fc::future<void> _bandwidth_monitor_loop_done;
@@ -348,6 +391,8 @@ class node_impl : public peer_connection_delegate
       bool have_already_received_sync_item( const item_hash_t& item_hash );
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
+      void request_sync_headers_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& block_ids );
+      void forget_sync_headers_from_peer( const peer_connection* peer );
       void fetch_sync_items_loop();
       void trigger_fetch_sync_items_loop();
 
@@ -444,8 +489,31 @@ class node_impl : public peer_connection_delegate
       void process_block_during_sync(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
       void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
       void process_block_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
+      /** adapts the sync window of a peer to the rate it delivered its last sync batch at */
+      void update_sync_block_window(peer_connection* peer);
+
+      void on_fetch_block_headers_message( peer_connection* originating_peer,
+                                           const fetch_block_headers_message& fetch_block_headers_message_received );
+      void on_block_headers_message( peer_connection* originating_peer,
+                                     const block_headers_message& block_headers_message_received );
+
+      void send_compact_blocks( peer_connection* originating_peer, const std::vector<item_hash_t>& block_message_hashes );
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+      void on_fetch_block_transactions_message( peer_connection* originating_peer,
+                                                const fetch_block_transactions_message& fetch_block_transactions_message_received );
+      void on_block_transactions_message( peer_connection* originating_peer,
+                                          const block_transactions_message& block_transactions_message_received );
+      /** a transaction of a compact block, from the message cache or the pending transactions of the delegate */
+      fc::optional<graphene::chain::precomputable_transaction> find_transaction_for_compact_block( const graphene::chain::transaction_id_type& id );
+      /** processes a block rebuilt from a compact block, or fetches the full block if the rebuilt one is wrong */
+      void process_rebuilt_compact_block( peer_connection* originating_peer, const item_hash_t& block_message_hash,
+                                          const graphene::chain::signed_block& block );
 
       void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
+      /** hands the transactions received since the last call to the delegate at once, and broadcasts the accepted ones */
+      void process_pending_transactions();
+      void trigger_process_pending_transactions();
 
       void start_synchronizing();
       void start_synchronizing_with_peer(const peer_connection_ptr& peer);
@@ -75,6 +75,7 @@ namespace graphene { namespace net
       _node(delegate),
       _message_connection(this),
       _total_queued_messages_size(0),
+      _total_queued_transaction_relay_size(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
       our_state(our_connection_state::disconnected),
@@ -272,6 +273,9 @@ namespace graphene { namespace net
       BOOST_SCOPE_EXIT(this_) {
         this_->_currently_handling_message = false;
       } BOOST_SCOPE_EXIT_END
+      message_type_traffic& traffic = traffic_by_message_type[received_message.msg_type];
+      ++traffic.messages_received;
+      traffic.bytes_received += sizeof(message_header) + received_message.size;
       _node->on_message( this, received_message );
     }
 
@@ -292,16 +296,26 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      for (;;)
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        unsigned priority = 0;
+        while (priority < message_priority_count && _queued_messages[priority].empty())
+          ++priority;
+        if (priority == message_priority_count)
+          break;
+        queued_message_queue& queue = _queued_messages[priority];
+
+        queue.front()->transmission_start_time = fc::time_point::now();
+        message message_to_send = queue.front()->get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
           //     "to send message of type ${type} for peer ${endpoint}",
           //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
           _message_connection.send_message(message_to_send);
+          message_type_traffic& traffic = traffic_by_message_type[message_to_send.msg_type];
+          ++traffic.messages_sent;
+          traffic.bytes_sent += sizeof(message_header) + message_to_send.size;
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -331,18 +345,62 @@ namespace graphene { namespace net
         {
           wlog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        queue.front()->transmission_finish_time = fc::time_point::now();
+        if (priority == transaction_relay_priority)
+          _total_queued_transaction_relay_size -= queue.front()->get_size_in_queue();
+        else
+          _total_queued_messages_size -= queue.front()->get_size_in_queue();
+        queue.pop();
+
+        // give the other peers' send tasks a turn between relayed transactions, so one fast
+        // peer doesn't monopolize the thread while the rest of the network waits for its share
+        if (priority == transaction_relay_priority)
+          fc::yield();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
-    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
+    peer_connection::message_priority peer_connection::get_message_priority(const message& message_to_send)
+    {
+      switch (message_to_send.msg_type)
+      {
+      case block_message_type:
+      case compact_block_message_type:
+      case block_transactions_message_type:
+      case block_headers_message_type:
+      case blockchain_item_ids_inventory_message_type:
+        return block_priority;
+      case trx_message_type:
+        return transaction_relay_priority;
+      case item_ids_inventory_message_type:
+        {
+          // the item type is the first field of the packed message, no need to unpack the hashes
+          uint32_t item_type = 0;
+          if (message_to_send.data.size() >= sizeof(item_type))
+          {
+            fc::datastream<const char*> ds(message_to_send.data.data(), message_to_send.data.size());
+            fc::raw::unpack(ds, item_type);
+          }
+          return item_type == trx_message_type ? transaction_relay_priority : block_priority;
+        }
+      default:
+        return normal_priority;
+      }
+    }
+
+    peer_connection::message_priority peer_connection::get_item_priority(const item_id& item_to_send)
+    {
+      return item_to_send.item_type == trx_message_type ? transaction_relay_priority : block_priority;
+    }
+
+    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send, message_priority priority)
     {
       VERIFY_CORRECT_THREAD();
-      _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
+      if (priority == transaction_relay_priority)
+        _total_queued_transaction_relay_size += message_to_send->get_size_in_queue();
+      else
+        _total_queued_messages_size += message_to_send->get_size_in_queue();
+      _queued_messages[priority].emplace(std::move(message_to_send));
       if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         wlog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -370,13 +428,40 @@ namespace graphene { namespace net
       //  dlog("peer_connection::send_message() doesn't need to fire up send_queued_message_task, it's already running");
     }
 
+    size_t peer_connection::get_queued_message_count() const
+    {
+      size_t count = 0;
+      for (unsigned priority = 0; priority < message_priority_count; ++priority)
+        count += _queued_messages[priority].size();
+      return count;
+    }
+
     void peer_connection::send_message(const message& message_to_send, size_t message_send_time_field_offset)
     {
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
+      message_priority priority = get_message_priority(message_to_send);
       std::unique_ptr<queued_message> message_to_enqueue(new real_queued_message(message_to_send, message_send_time_field_offset));
-      send_queueable_message(std::move(message_to_enqueue));
+      if (priority == transaction_relay_priority &&
+          _total_queued_transaction_relay_size + message_to_enqueue->get_size_in_queue() > GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTIONS_IN_BYTES)
+      {
+        if (message_to_send.msg_type == item_ids_inventory_message_type)
+        {
+          // unsolicited inventory, the peer will hear about these transactions from someone else
+          dlog("dropping transaction inventory to peer ${endpoint}, ${current} bytes already queued",
+               ("endpoint", get_remote_endpoint())("current", _total_queued_transaction_relay_size));
+          return;
+        }
+        // a reply to the peer's fetch_items_message, tell it we can't send the transaction so it
+        // asks someone else instead of waiting for the request to time out
+        dlog("sending item_not_available for a transaction to peer ${endpoint}, ${current} bytes already queued",
+             ("endpoint", get_remote_endpoint())("current", _total_queued_transaction_relay_size));
+        message reply = item_not_available_message(item_id(trx_message_type, message_to_send.id()));
+        message_to_enqueue.reset(new real_queued_message(reply));
+        priority = get_message_priority(reply);
+      }
+      send_queueable_message(std::move(message_to_enqueue), priority);
     }
 
     void peer_connection::send_item(const item_id& item_to_send)
@@ -385,7 +470,7 @@ namespace graphene { namespace net
       //dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", item_to_send.item_type)("endpoint", get_remote_endpoint()));
       std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send));
-      send_queueable_message(std::move(message_to_enqueue));
+      send_queueable_message(std::move(message_to_enqueue), get_item_priority(item_to_send));
     }
 
     void peer_connection::close_connection()
@@ -481,14 +566,13 @@ namespace graphene { namespace net
       fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
 
       // expire old items from inventory_advertised_to_peer
-      auto oldest_inventory_to_keep_iter = inventory_advertised_to_peer.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      auto begin_iter = inventory_advertised_to_peer.get<timestamp_index>().begin();
-      unsigned number_of_elements_advertised_to_peer_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_advertised_to_peer.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+      size_t number_of_elements_advertised_to_peer = inventory_advertised_to_peer.size();
+      inventory_advertised_to_peer.expire();
+      size_t number_of_elements_advertised_to_peer_to_discard = number_of_elements_advertised_to_peer - inventory_advertised_to_peer.size();
 
       // also expire items from inventory_peer_advertised_to_us
-      oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
+      auto oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
+      auto begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
       unsigned number_of_elements_peer_advertised_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
       inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
       dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
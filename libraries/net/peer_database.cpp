@@ -32,6 +32,17 @@
 #include <fc/io/raw_variant.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
+#include <fc/crypto/city.hpp>
+#include <fc/filesystem.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
 
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/config.hpp>
@@ -61,12 +72,45 @@ namespace graphene { namespace net {
       potential_peer_set     _potential_peer_set;
       fc::path _peer_database_filename;
 
+      /**
+       * The binary store lives next to the legacy JSON file.  It is a short header
+       * followed by a journal of update/erase records; replaying the journal in order
+       * reproduces _potential_peer_set.  Records are appended as entries change and
+       * the journal is rewritten as a snapshot once it grows well past the live set.
+       */
+      enum journal_record_kind : uint8_t
+      {
+        journal_update_record = 0,
+        journal_erase_record = 1
+      };
+      static const uint32_t journal_magic = 0x42445047; // "GPDB"
+      static const uint32_t journal_version = 1;
+
+      fc::path      _journal_filename;
+      FILE*         _journal = nullptr;
+      uint32_t      _journal_record_count = 0;
+      fc::time_point _last_journal_sync_time;
+      bool          _journal_needs_sync = false;
+
+      bool replay_journal();
+      void load_legacy_json();
+      void prune();
+      static bool write_journal_record(FILE* journal, journal_record_kind kind, const std::vector<char>& data);
+      void append_journal_record(journal_record_kind kind, const std::vector<char>& data);
+      void sync_journal(bool force);
+      void compact_journal();
+      void close_journal();
+
     public:
+      ~peer_database_impl() { close_journal(); }
+
       void open(const fc::path& databaseFilename);
       void close();
       void clear();
       void erase(const fc::ip::endpoint& endpointToErase);
       void update_entry(const potential_peer_record& updatedRecord);
+      void erase_in_memory(const fc::ip::endpoint& endpointToErase);
+      void update_entry_in_memory(const potential_peer_record& updatedRecord);
       potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
       fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
 
@@ -89,63 +133,286 @@ namespace graphene { namespace net {
 
     void peer_database_impl::open(const fc::path& peer_database_filename)
     {
+      close_journal();
+      _potential_peer_set.clear();
       _peer_database_filename = peer_database_filename;
-      if (fc::exists(_peer_database_filename))
+      _journal_filename = _peer_database_filename.parent_path() / (_peer_database_filename.stem().string() + ".dat");
+
+      bool needs_compaction = true;
+      if (fc::exists(_journal_filename))
+        needs_compaction = !replay_journal();
+      else if (fc::exists(_peer_database_filename))
+        load_legacy_json();
+
+      if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
+      {
+        prune();
+        needs_compaction = true;
+      }
+
+      try
+      {
+        if (needs_compaction)
+          compact_journal();
+        else
+        {
+          _journal = fopen(_journal_filename.generic_string().c_str(), "ab");
+          FC_ASSERT(_journal, "unable to open peer database journal for writing");
+          _last_journal_sync_time = fc::time_point::now();
+        }
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error opening peer database file ${journal_filename}, peer updates will not be persisted: ${e}",
+             ("journal_filename", _journal_filename)("e", e.to_detail_string()));
+      }
+    }
+
+    bool peer_database_impl::replay_journal()
+    {
+      FILE* journal = fopen(_journal_filename.generic_string().c_str(), "rb");
+      if (!journal)
+      {
+        elog("unable to read peer database file ${journal_filename}, starting with a clean database",
+             ("journal_filename", _journal_filename));
+        return false;
+      }
+
+      bool clean = true;
+      uint32_t header[2];
+      if (fread(header, sizeof(header), 1, journal) != 1 ||
+          header[0] != journal_magic || header[1] != journal_version)
       {
+        elog("peer database file ${journal_filename} has an unrecognized header, starting with a clean database",
+             ("journal_filename", _journal_filename));
+        fclose(journal);
+        return false;
+      }
+
+      std::vector<char> data;
+      for (;;)
+      {
+        uint8_t kind;
+        uint32_t size;
+        uint32_t checksum;
+        if (fread(&kind, sizeof(kind), 1, journal) != 1)
+          break; // clean end of the journal
+        if (fread(&size, sizeof(size), 1, journal) != 1 ||
+            fread(&checksum, sizeof(checksum), 1, journal) != 1 ||
+            size > MAX_MESSAGE_SIZE)
+        {
+          clean = false;
+          break;
+        }
+        data.resize(size);
+        if ((size && fread(data.data(), size, 1, journal) != 1) ||
+            fc::city_hash32(data.data(), size) != checksum)
+        {
+          clean = false;
+          break;
+        }
+
         try
         {
-          std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
-          std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
-          if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
+          if (kind == journal_update_record)
+            update_entry_in_memory(fc::raw::unpack<potential_peer_record>(data));
+          else if (kind == journal_erase_record)
+            erase_in_memory(fc::raw::unpack<fc::ip::endpoint>(data));
+          else
           {
-            // prune database to a reasonable size
-            auto iter = _potential_peer_set.begin();
-            std::advance(iter, MAXIMUM_PEERDB_SIZE);
-            _potential_peer_set.erase(iter, _potential_peer_set.end());
+            clean = false;
+            break;
           }
         }
+        catch (const fc::exception&)
+        {
+          clean = false;
+          break;
+        }
+        ++_journal_record_count;
+      }
+      fclose(journal);
+
+      // a torn record at the tail is what a crash mid-append leaves behind; everything
+      // before it is intact, so keep it and let the compaction drop the tail
+      if (!clean)
+        wlog("peer database file ${journal_filename} ends in an incomplete record, recovered ${count} entries",
+             ("journal_filename", _journal_filename)("count", _potential_peer_set.size()));
+      return clean && _journal_record_count <= std::max<size_t>(_potential_peer_set.size(), MAXIMUM_PEERDB_SIZE) * GRAPHENE_NET_PEERDB_COMPACTION_RATIO;
+    }
+
+    void peer_database_impl::load_legacy_json()
+    {
+      try
+      {
+        std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
+        std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
+        ilog("migrated ${count} entries from ${peer_database_filename} to ${journal_filename}",
+             ("count", _potential_peer_set.size())("peer_database_filename", _peer_database_filename)("journal_filename", _journal_filename));
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
+             ("peer_database_filename", _peer_database_filename));
+      }
+    }
+
+    void peer_database_impl::prune()
+    {
+      // prune database to a reasonable size
+      auto iter = _potential_peer_set.begin();
+      std::advance(iter, MAXIMUM_PEERDB_SIZE);
+      _potential_peer_set.erase(iter, _potential_peer_set.end());
+    }
+
+    bool peer_database_impl::write_journal_record(FILE* journal, journal_record_kind kind, const std::vector<char>& data)
+    {
+      uint8_t kind_byte = kind;
+      uint32_t size = data.size();
+      uint32_t checksum = fc::city_hash32(data.data(), data.size());
+      return fwrite(&kind_byte, sizeof(kind_byte), 1, journal) == 1 &&
+             fwrite(&size, sizeof(size), 1, journal) == 1 &&
+             fwrite(&checksum, sizeof(checksum), 1, journal) == 1 &&
+             (!size || fwrite(data.data(), size, 1, journal) == 1);
+    }
+
+    void peer_database_impl::append_journal_record(journal_record_kind kind, const std::vector<char>& data)
+    {
+      if (!_journal)
+        return;
+      if (!write_journal_record(_journal, kind, data) || fflush(_journal) != 0)
+      {
+        elog("error writing to peer database file ${journal_filename}, peer updates will not be persisted",
+             ("journal_filename", _journal_filename));
+        close_journal();
+        return;
+      }
+      ++_journal_record_count;
+      _journal_needs_sync = true;
+
+      if (_journal_record_count > std::max<size_t>(_potential_peer_set.size(), MAXIMUM_PEERDB_SIZE) * GRAPHENE_NET_PEERDB_COMPACTION_RATIO)
+      {
+        try
+        {
+          compact_journal();
+        }
         catch (const fc::exception& e)
         {
-          elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
-               ("peer_database_filename", _peer_database_filename));
+          elog("error compacting peer database file ${journal_filename}: ${e}",
+               ("journal_filename", _journal_filename)("e", e.to_detail_string()));
         }
       }
+      else
+        sync_journal(false);
     }
 
-    void peer_database_impl::close()
+    void peer_database_impl::sync_journal(bool force)
+    {
+      if (!_journal || !_journal_needs_sync)
+        return;
+      fc::time_point now = fc::time_point::now();
+      if (!force && now - _last_journal_sync_time < fc::seconds(GRAPHENE_NET_PEERDB_SYNC_INTERVAL_SECONDS))
+        return;
+#ifdef _WIN32
+      _commit(_fileno(_journal));
+#else
+      fsync(fileno(_journal));
+#endif
+      _last_journal_sync_time = now;
+      _journal_needs_sync = false;
+    }
+
+    void peer_database_impl::compact_journal()
     {
-      std::vector<potential_peer_record> peer_records;
-      peer_records.reserve(_potential_peer_set.size());
-      std::copy(_potential_peer_set.begin(), _potential_peer_set.end(), std::back_inserter(peer_records));
+      close_journal();
+
+      fc::path journal_dir = _journal_filename.parent_path();
+      if (!fc::exists(journal_dir))
+        fc::create_directories(journal_dir);
+
+      // write the snapshot to a temporary file and rename it into place, so a crash
+      // during compaction leaves the previous journal intact
+      fc::path temp_filename = _journal_filename.parent_path() / (_journal_filename.filename().string() + ".tmp");
+      FILE* snapshot = fopen(temp_filename.generic_string().c_str(), "wb");
+      FC_ASSERT(snapshot, "unable to create ${file}", ("file", temp_filename));
+      _journal = snapshot;
+      _journal_record_count = 0;
+
+      uint32_t header[2] = { journal_magic, journal_version };
+      bool ok = fwrite(header, sizeof(header), 1, _journal) == 1;
+      for (auto iter = _potential_peer_set.begin(); ok && iter != _potential_peer_set.end(); ++iter)
+      {
+        ok = write_journal_record(_journal, journal_update_record, fc::raw::pack(*iter));
+        ++_journal_record_count;
+      }
+      ok = ok && fflush(_journal) == 0;
+      if (ok)
+      {
+        _journal_needs_sync = true;
+        sync_journal(true);
+      }
+      fclose(_journal);
+      _journal = nullptr;
+      FC_ASSERT(ok, "error writing ${file}", ("file", temp_filename));
+
+      fc::rename(temp_filename, _journal_filename);
+      _journal = fopen(_journal_filename.generic_string().c_str(), "ab");
+      FC_ASSERT(_journal, "unable to open ${file} for writing", ("file", _journal_filename));
+      _last_journal_sync_time = fc::time_point::now();
+      _journal_needs_sync = false;
+    }
 
+    void peer_database_impl::close_journal()
+    {
+      if (_journal)
+      {
+        sync_journal(true);
+        fclose(_journal);
+        _journal = nullptr;
+      }
+    }
+
+    void peer_database_impl::close()
+    {
       try
       {
-        fc::path peer_database_filename_dir = _peer_database_filename.parent_path();
-        if (!fc::exists(peer_database_filename_dir))
-          fc::create_directories(peer_database_filename_dir);
-        fc::json::save_to_file( peer_records, _peer_database_filename, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+        if (!_journal_filename.string().empty())
+          compact_journal();
       }
       catch (const fc::exception& e)
       {
-        elog("error saving peer database to file ${peer_database_filename}", 
-             ("peer_database_filename", _peer_database_filename));
+        elog("error saving peer database to file ${journal_filename}: ${e}",
+             ("journal_filename", _journal_filename)("e", e.to_detail_string()));
       }
+      close_journal();
       _potential_peer_set.clear();
     }
 
     void peer_database_impl::clear()
     {
       _potential_peer_set.clear();
+      if (_journal)
+      {
+        try
+        {
+          compact_journal();
+        }
+        catch (const fc::exception& e)
+        {
+          elog("error clearing peer database file ${journal_filename}: ${e}",
+               ("journal_filename", _journal_filename)("e", e.to_detail_string()));
+        }
+      }
     }
 
-    void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
+    void peer_database_impl::erase_in_memory(const fc::ip::endpoint& endpointToErase)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
       if (iter != _potential_peer_set.get<endpoint_index>().end())
         _potential_peer_set.get<endpoint_index>().erase(iter);
     }
 
-    void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
+    void peer_database_impl::update_entry_in_memory(const potential_peer_record& updatedRecord)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(updatedRecord.endpoint);
       if (iter != _potential_peer_set.get<endpoint_index>().end())
@@ -154,6 +421,21 @@ namespace graphene { namespace net {
         _potential_peer_set.get<endpoint_index>().insert(updatedRecord);
     }
 
+    void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
+    {
+      auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
+      if (iter == _potential_peer_set.get<endpoint_index>().end())
+        return;
+      _potential_peer_set.get<endpoint_index>().erase(iter);
+      append_journal_record(journal_erase_record, fc::raw::pack(endpointToErase));
+    }
+
+    void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
+    {
+      update_entry_in_memory(updatedRecord);
+      append_journal_record(journal_update_record, fc::raw::pack(updatedRecord));
+    }
+
     potential_peer_record peer_database_impl::lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup)
     {
       auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToLookup);
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/rolling_bloom_filter.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+  const uint32_t rolling_bloom_filter::bits_per_item;
+  const uint32_t rolling_bloom_filter::hash_functions;
+
+  namespace {
+    /// the item hashes are uniformly distributed already, two words of them serve as the double hashing seeds
+    void bloom_seeds( const item_id& item, uint64_t& first, uint64_t& step )
+    {
+      first = ( (uint64_t( item.item_hash._hash[0] ) << 32) | item.item_hash._hash[1] ) ^ item.item_type;
+      step  = ( (uint64_t( item.item_hash._hash[2] ) << 32) | item.item_hash._hash[3] ) | 1;
+    }
+  }
+
+  rolling_bloom_filter::rolling_bloom_filter( fc::microseconds window, uint32_t generations,
+                                              uint32_t min_capacity, uint32_t max_capacity ) :
+    _window( window ),
+    _generations( std::max<uint32_t>( generations, 1 ) ),
+    _min_capacity( std::max<uint32_t>( min_capacity, 64 ) ),
+    _max_capacity( std::max( max_capacity, _min_capacity ) )
+  {}
+
+  void rolling_bloom_filter::start_generation( fc::time_point now )
+  {
+    uint32_t capacity = _min_capacity;
+    if( !_filters.empty() )
+      capacity = std::min<uint64_t>( std::max<uint64_t>( uint64_t( _filters.back().count ) * 2, _min_capacity ), _max_capacity );
+    // a power of two of bits, so that the bit positions are cheap to compute
+    uint64_t bit_count = 64;
+    while( bit_count < uint64_t( capacity ) * bits_per_item )
+      bit_count *= 2;
+
+    _filters.emplace_back();
+    generation& newest = _filters.back();
+    newest.bits.assign( bit_count / 64, 0 );
+    newest.capacity = capacity;
+    newest.started = now;
+    while( _filters.size() > _generations + 1 )
+      _filters.pop_front();
+  }
+
+  void rolling_bloom_filter::expire( fc::time_point now )
+  {
+    // a generation only holds items older than the window once its successor started before the window
+    while( _filters.size() > 1 && _filters[1].started <= now - _window )
+      _filters.pop_front();
+  }
+
+  void rolling_bloom_filter::insert( const item_id& item, fc::time_point now )
+  {
+    if( _filters.empty() || _filters.back().count >= _filters.back().capacity ||
+        _filters.back().started <= now - fc::microseconds( _window.count() / _generations ) )
+    {
+      expire( now );
+      start_generation( now );
+    }
+    generation& newest = _filters.back();
+    const uint64_t mask = uint64_t( newest.bits.size() ) * 64 - 1;
+    uint64_t position, step;
+    bloom_seeds( item, position, step );
+    for( uint32_t i = 0; i < hash_functions; ++i, position += step )
+      newest.bits[ (position & mask) / 64 ] |= uint64_t(1) << (position & 63);
+    ++newest.count;
+  }
+
+  bool rolling_bloom_filter::may_contain( const item_id& item ) const
+  {
+    uint64_t first, step;
+    bloom_seeds( item, first, step );
+    for( auto filter = _filters.rbegin(); filter != _filters.rend(); ++filter )
+    {
+      const uint64_t mask = uint64_t( filter->bits.size() ) * 64 - 1;
+      uint64_t position = first;
+      bool all_set = true;
+      for( uint32_t i = 0; i < hash_functions && all_set; ++i, position += step )
+        all_set = ( filter->bits[ (position & mask) / 64 ] >> (position & 63) ) & 1;
+      if( all_set )
+        return true;
+    }
+    return false;
+  }
+
+  size_t rolling_bloom_filter::size() const
+  {
+    size_t items = 0;
+    for( const generation& filter : _filters )
+      items += filter.count;
+    return items;
+  }
+
+  size_t rolling_bloom_filter::memory_usage() const
+  {
+    size_t bytes = sizeof(*this);
+    for( const generation& filter : _filters )
+      bytes += sizeof(filter) + filter.bits.size() * sizeof(uint64_t);
+    return bytes;
+  }
+
+} } // graphene::net
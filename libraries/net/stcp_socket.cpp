@@ -36,6 +36,8 @@
 
 namespace graphene { namespace net {
 
+const size_t stcp_socket::buffer_length;
+
 stcp_socket::stcp_socket()
 //:_buf_len(0)
 #ifndef NDEBUG
@@ -100,11 +102,10 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
     if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
+      _read_buffer.reset(new char[buffer_length], [](char* p){ delete[] p; });
 
-    len = std::min<size_t>(read_buffer_length, len);
+    len = std::min<size_t>(buffer_length, len);
 
     size_t s = _sock.readsome( _read_buffer, len, 0 );
     if( s % 16 ) 
@@ -141,11 +142,9 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
     if (!_write_buffer)
-      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
-    len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
+      _write_buffer.reset(new char[buffer_length], [](char* p){ delete[] p; });
+    len = std::min<size_t>(buffer_length, len);
     /**
      * every sizeof(crypt_buf) bytes the aes channel
      * has an error and doesn't decrypt properly...  disable
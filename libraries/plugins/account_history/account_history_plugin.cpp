@@ -23,8 +23,8 @@
  */
 
 #include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/history_store.hpp>
 
-#include <graphene/chain/impacted.hpp>
 
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/account_object.hpp>
@@ -34,8 +34,12 @@
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/transaction_evaluation_state.hpp>
 
+#include <graphene/db/dynamic_memory.hpp>
+
 #include <fc/thread/thread.hpp>
 
+#include <unordered_map>
+
 namespace graphene { namespace account_history {
 
 namespace detail
@@ -51,10 +55,17 @@ class account_history_plugin_impl
       virtual ~account_history_plugin_impl();
 
 
-      /** this method is called as a callback after a block is applied
+      /** this method is called by account_history_consumer after a block is applied
        * and will process/index all operations that were applied in the block.
        */
-      void update_account_histories( const signed_block& b );
+      void update_account_histories( const applied_block_operations& b );
+
+      /** moves the history of irreversible blocks from the object database to _history_store */
+      void archive_irreversible_history( uint32_t last_irreversible_block );
+
+      /** the account statistics are kept in _replay_counters during a replay, the chain owns their objects */
+      void begin_replay();
+      void end_replay();
 
       graphene::chain::database& database()
       {
@@ -66,21 +77,56 @@ class account_history_plugin_impl
       bool _partial_operations = false;
       primary_index< operation_history_index >* _oho_index;
       uint64_t _max_ops_per_account = -1;
+      std::unique_ptr<history_store> _history_store;
+      const account_history_type_index* _type_index = nullptr;
    private:
+      /** the fields of account_statistics_object the history is kept in */
+      struct history_counters
+      {
+         uint64_t                            total_ops = 0;
+         uint64_t                            removed_ops = 0;
+         account_transaction_history_id_type most_recent_op;
+      };
+
       /** add one history record, then check and remove the earliest history record */
-      void add_account_history( const account_id_type account_id, const operation_history_id_type op_id );
+      void add_account_history( const account_id_type account_id, const operation_history_object& op );
+      history_counters get_counters( account_id_type account_id );
+      void set_counters( account_id_type account_id, const history_counters& counters );
+
+      bool _replaying = false;
+      std::unordered_map<uint64_t, history_counters> _replay_counters;
 
 };
 
+/** Hands the applied operations to the plugin, which keeps the account statistics aside during a replay */
+class account_history_consumer : public history_consumer
+{
+   public:
+      explicit account_history_consumer( account_history_plugin_impl& impl ) : _impl( impl ) {}
+
+      virtual std::string name()const override { return "account_history"; }
+      virtual void index( const applied_block_operations& block ) override
+      {
+         _impl.update_account_histories( block );
+         if( _impl._history_store )
+            _impl.archive_irreversible_history( block.last_irreversible_block_num );
+      }
+      virtual void begin_replay() override { _impl.begin_replay(); }
+      virtual void end_replay() override { _impl.end_replay(); }
+
+   private:
+      account_history_plugin_impl& _impl;
+};
+
 account_history_plugin_impl::~account_history_plugin_impl()
 {
    return;
 }
 
-void account_history_plugin_impl::update_account_histories( const signed_block& b )
+void account_history_plugin_impl::update_account_histories( const applied_block_operations& b )
 {
    graphene::chain::database& db = database();
-   const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
+   const vector<optional< operation_history_object > >& hist = b.operations;
    bool is_first = true;
    auto skip_oho_id = [&is_first,&db,this]() {
       if( is_first && db._undo_db.enabled() ) // this ensures that the current id is rolled back on undo
@@ -92,8 +138,9 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          _oho_index->use_next_id();
    };
 
-   for( const optional< operation_history_object >& o_op : hist )
+   for( uint32_t op_id = 0; op_id < hist.size(); ++op_id )
    {
+      const optional< operation_history_object >& o_op = hist[op_id];
       optional<operation_history_object> oho;
 
       auto create_oho = [&]() {
@@ -123,21 +170,8 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          // add to the operation history index
          oho = create_oho();
 
-      const operation_history_object& op = *o_op;
-
       // get the set of accounts this operation applies to
-      flat_set<account_id_type> impacted;
-      vector<authority> other;
-      operation_get_required_authorities( op.op, impacted, impacted, other ); // fee_payer is added here
-
-      if( op.op.which() == operation::tag< account_create_operation >::value )
-         impacted.insert( op.result.get<object_id_type>() );
-      else
-         graphene::chain::operation_get_impacted_accounts( op.op, impacted );
-
-      for( auto& a : other )
-         for( auto& item : a.account_auths )
-            impacted.insert( item.first );
+      const flat_set<account_id_type>& impacted = b.impacted_accounts[op_id];
 
       // be here, either _max_ops_per_account > 0, or _partial_operations == false, or both
       // if _partial_operations == false, oho should have been created above
@@ -163,7 +197,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                // that indexing now happens in observers' post_evaluate()
 
                // add history
-               add_account_history( account_id, oho->id );
+               add_account_history( account_id, *oho );
             }
          }
       }
@@ -183,7 +217,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                {
                   if (!oho.valid()) { oho = create_oho(); }
                   // add history
-                  add_account_history( account_id, oho->id );
+                  add_account_history( account_id, *oho );
                }
             }
          }
@@ -193,24 +227,23 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
    }
 }
 
-void account_history_plugin_impl::add_account_history( const account_id_type account_id, const operation_history_id_type op_id )
+void account_history_plugin_impl::add_account_history( const account_id_type account_id, const operation_history_object& op )
 {
    graphene::chain::database& db = database();
-   const auto& stats_obj = account_id(db).statistics(db);
+   history_counters counters = get_counters( account_id );
    // add new entry
    const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-       obj.operation_id = op_id;
+       obj.operation_id = op.id;
        obj.account = account_id;
-       obj.sequence = stats_obj.total_ops + 1;
-       obj.next = stats_obj.most_recent_op;
-   });
-   db.modify( stats_obj, [&]( account_statistics_object& obj ){
-       obj.most_recent_op = ath.id;
-       obj.total_ops = ath.sequence;
+       obj.sequence = counters.total_ops + 1;
+       obj.next = counters.most_recent_op;
+       obj.operation_type = op.op.which();
    });
+   counters.most_recent_op = ath.id;
+   counters.total_ops = ath.sequence;
    // remove the earliest account history entry if too many
    // _max_ops_per_account is guaranteed to be non-zero outside
-   if( stats_obj.total_ops - stats_obj.removed_ops > _max_ops_per_account )
+   if( counters.total_ops - counters.removed_ops > _max_ops_per_account )
    {
       // look for the earliest entry
       const auto& his_idx = db.get_index_type<account_transaction_history_index>();
@@ -224,9 +257,7 @@ void account_history_plugin_impl::add_account_history( const account_id_type acc
          const auto itr_remove = itr;
          ++itr;
          db.remove( *itr_remove );
-         db.modify( stats_obj, [&]( account_statistics_object& obj ){
-             obj.removed_ops = obj.removed_ops + 1;
-         });
+         ++counters.removed_ops;
          // modify previous node's next pointer
          // this should be always true, but just have a check here
          if( itr != by_seq_idx.end() && itr->account == account_id )
@@ -250,10 +281,120 @@ void account_history_plugin_impl::add_account_history( const account_id_type acc
          }
       }
    }
+   set_counters( account_id, counters );
+}
+
+account_history_plugin_impl::history_counters account_history_plugin_impl::get_counters( account_id_type account_id )
+{
+   if( _replaying )
+   {
+      auto itr = _replay_counters.find( account_id.instance.value );
+      return itr == _replay_counters.end() ? history_counters() : itr->second;
+   }
+   const auto& stats_obj = account_id(database()).statistics(database());
+   history_counters counters;
+   counters.total_ops = stats_obj.total_ops;
+   counters.removed_ops = stats_obj.removed_ops;
+   counters.most_recent_op = stats_obj.most_recent_op;
+   return counters;
+}
+
+void account_history_plugin_impl::set_counters( account_id_type account_id, const history_counters& counters )
+{
+   if( _replaying )
+   {
+      _replay_counters[ account_id.instance.value ] = counters;
+      return;
+   }
+   graphene::chain::database& db = database();
+   db.modify( account_id(db).statistics(db), [&]( account_statistics_object& obj ){
+      obj.total_ops = counters.total_ops;
+      obj.removed_ops = counters.removed_ops;
+      obj.most_recent_op = counters.most_recent_op;
+   });
+}
+
+void account_history_plugin_impl::begin_replay()
+{
+   // accounts created during the replay start with empty statistics, only the existing ones need to be copied
+   _replay_counters.clear();
+   for( const auto& stats_obj : database().get_index_type<account_stats_index>().indices() )
+   {
+      if( stats_obj.total_ops == 0 )
+         continue;
+      history_counters& counters = _replay_counters[ stats_obj.owner.instance.value ];
+      counters.total_ops = stats_obj.total_ops;
+      counters.removed_ops = stats_obj.removed_ops;
+      counters.most_recent_op = stats_obj.most_recent_op;
+   }
+   _replaying = true;
+}
+
+void account_history_plugin_impl::end_replay()
+{
+   _replaying = false;
+   graphene::chain::database& db = database();
+   for( const auto& item : _replay_counters )
+   {
+      const auto& stats_obj = account_id_type( item.first )(db).statistics(db);
+      if( stats_obj.total_ops == item.second.total_ops )
+         continue;
+      set_counters( account_id_type( item.first ), item.second );
+   }
+   _replay_counters.clear();
+}
+
+void account_history_plugin_impl::archive_irreversible_history( uint32_t last_irreversible_block )
+{
+   graphene::chain::database& db = database();
+
+   // operations are created in block order, so the irreversible ones are the oldest objects; the walk starts at
+   // the oldest one, which is far beyond the store's end when the store was added to a node with pruned history
+   typedef primary_index< operation_history_index >::const_iterator op_iterator;
+   op_iterator itr = _oho_index->begin();
+   while( itr != _oho_index->end() && itr->block_num <= last_irreversible_block )
+   {
+      const operation_history_object& op = *itr;
+      const uint64_t next_instance = op.id.instance() + 1;
+      _history_store->append_operation( op );
+      db.remove( op );
+      // removing may release the chunk of the iterator, continue from the instance
+      itr = op_iterator( *_oho_index, next_instance );
+   }
+
+   // account history entries are created along with their operations, so the archived ones come first by id
+   const uint64_t archived_end = _history_store->next_operation_instance();
+   const auto& by_id_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_id>();
+   auto entry_itr = by_id_idx.begin();
+   while( entry_itr != by_id_idx.end() && entry_itr->operation_id.instance.value < archived_end )
+   {
+      const account_transaction_history_object& entry = *entry_itr;
+      ++entry_itr;
+      _history_store->append_account_entry( entry.account, entry.sequence, entry.operation_id );
+      db.remove( entry );
+   }
+   _history_store->flush();
 }
 
 } // end namespace detail
 
+void account_history_type_index::object_inserted( const object& obj )
+{
+   const auto& entry = static_cast<const account_transaction_history_object&>( obj );
+   _entries.emplace( entry.account, entry.operation_type, entry.operation_id.instance.value );
+}
+
+void account_history_type_index::object_removed( const object& obj )
+{
+   const auto& entry = static_cast<const account_transaction_history_object&>( obj );
+   _entries.erase( entry_key( entry.account, entry.operation_type, entry.operation_id.instance.value ) );
+}
+
+uint64_t account_history_type_index::estimated_memory_usage()const
+{
+   return graphene::db::dynamic_memory_size( _entries );
+}
+
 
 
 
@@ -282,15 +423,24 @@ void account_history_plugin::plugin_set_program_options(
          ("track-account", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "Account ID to track history for (may specify multiple times)")
          ("partial-operations", boost::program_options::value<bool>(), "Keep only those operations in memory that are related to account history tracking")
          ("max-ops-per-account", boost::program_options::value<uint64_t>(), "Maximum number of operations per account will be kept in memory")
+         ("history-store-dir", boost::program_options::value<std::string>(),
+          "Directory of a disk store to move the history of irreversible blocks to, instead of keeping it in memory. "
+          "Can't be combined with partial-operations or max-ops-per-account")
+         ("compact-history-file", boost::program_options::value<std::string>(),
+          "Keep the history of irreversible blocks packed in memory instead of as objects, and save it to this file "
+          "at shutdown. Can't be combined with history-store-dir, partial-operations or max-ops-per-account")
+         ("index-history-by-operation-type", boost::program_options::value<bool>()->default_value(false),
+          "Index the account history in memory by operation type, so that get_account_history_operations doesn't "
+          "walk the whole history of an account. Can't be combined with history-store-dir or compact-history-file")
          ;
    cfg.add(cli);
 }
 
 void account_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
-   database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); } );
+   database().add_history_consumer( std::make_shared<detail::account_history_consumer>( *my ) );
    my->_oho_index = database().add_index< primary_index< operation_history_index > >();
-   database().add_index< primary_index< account_transaction_history_index > >();
+   auto ath_index = database().add_index< primary_index< account_transaction_history_index > >();
 
    LOAD_VALUE_SET(options, "track-account", my->_tracked_accounts, graphene::chain::account_id_type);
    if (options.count("partial-operations")) {
@@ -299,12 +449,50 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
    if (options.count("max-ops-per-account")) {
        my->_max_ops_per_account = options["max-ops-per-account"].as<uint64_t>();
    }
+   if( options.count("history-store-dir") )
+   {
+      // the store keeps the full history, entries are never removed from it
+      FC_ASSERT( !my->_partial_operations && my->_max_ops_per_account == uint64_t(-1),
+                 "history-store-dir can't be combined with partial-operations or max-ops-per-account" );
+      my->_history_store.reset( new history_store );
+      my->_history_store->open( fc::path( options["history-store-dir"].as<std::string>() ) );
+   }
+   if( options.count("compact-history-file") )
+   {
+      FC_ASSERT( !my->_history_store && !my->_partial_operations && my->_max_ops_per_account == uint64_t(-1),
+                 "compact-history-file can't be combined with history-store-dir, partial-operations or max-ops-per-account" );
+      my->_history_store.reset( new history_store );
+      my->_history_store->open_in_memory( fc::path( options["compact-history-file"].as<std::string>() ) );
+   }
+   if( options.count("index-history-by-operation-type") && options["index-history-by-operation-type"].as<bool>() )
+   {
+      // the index only sees the entries in the object database, a store takes the irreversible ones away
+      FC_ASSERT( !my->_history_store,
+                 "index-history-by-operation-type can't be combined with history-store-dir or compact-history-file" );
+      my->_type_index = ath_index->add_secondary_index< account_history_type_index >();
+   }
 }
 
 void account_history_plugin::plugin_startup()
 {
 }
 
+void account_history_plugin::plugin_shutdown()
+{
+   if( my->_history_store )
+      my->_history_store->close();
+}
+
+const history_store* account_history_plugin::get_history_store()const
+{
+   return my->_history_store.get();
+}
+
+const account_history_type_index* account_history_plugin::get_operation_type_index()const
+{
+   return my->_type_index;
+}
+
 flat_set<account_id_type> account_history_plugin::tracked_accounts() const
 {
    return my->_tracked_accounts;
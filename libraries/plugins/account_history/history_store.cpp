@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/account_history/history_store.hpp>
+
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace graphene { namespace account_history {
+
+namespace detail {
+
+/** Read-only mapping of the first size bytes of a file */
+class mapped_file
+{
+   public:
+      mapped_file( const fc::path& filename, uint64_t s ) : size( s )
+      {
+         _mapping.reset( new fc::file_mapping( filename.generic_string().c_str(), fc::read_only ) );
+         _region.reset( new fc::mapped_region( *_mapping, fc::read_only, 0, size ) );
+         data = static_cast<const char*>( _region->get_address() );
+      }
+
+      const uint64_t size;
+      const char*    data = nullptr;
+
+   private:
+      std::unique_ptr<fc::file_mapping>  _mapping;
+      std::unique_ptr<fc::mapped_region> _region;
+};
+
+/** Contents of the heads file, describing the files as far as they were complete when it was written */
+struct history_store_heads
+{
+   uint64_t first_operation = 0;
+   uint64_t operation_count = 0;
+   uint64_t account_entry_count = 0;
+   vector< std::pair< uint64_t, std::pair<uint64_t,uint64_t> > > heads; ///< account, (entry, sequence)
+};
+
+/** the heads are rewritten once this many account entries were appended since the last time */
+const uint64_t heads_save_interval = 100000;
+
+} } } // graphene::account_history::detail
+
+FC_REFLECT( graphene::account_history::detail::history_store_heads,
+            (first_operation)(operation_count)(account_entry_count)(heads) )
+
+namespace graphene { namespace account_history {
+
+const size_t history_store::slab_size;
+
+history_store::history_store() {}
+
+history_store::~history_store()
+{
+   try {
+      close();
+   } catch( const fc::exception& e ) {
+      elog( "Error closing the history store: ${e}", ("e",e.to_detail_string()) );
+   } catch( const std::exception& e ) {
+      elog( "Error closing the history store: ${e}", ("e",e.what()) );
+   }
+}
+
+static void open_append_file( std::fstream& file, const fc::path& filename )
+{
+   if( !fc::exists( filename ) )
+      std::ofstream( filename.generic_string().c_str(), std::ios::binary );
+   file.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   file.open( filename.generic_string().c_str(), std::ios::binary | std::ios::in | std::ios::out );
+}
+
+void history_store::open( const fc::path& dir )
+{ try {
+   close();
+   _dir = dir;
+   fc::create_directories( dir );
+   open_append_file( _operations, dir / "operations" );
+   open_append_file( _operation_index, dir / "operations.index" );
+   open_append_file( _accounts, dir / "accounts" );
+   recover();
+   update_mappings();
+   ilog( "Opened history store in ${d} with operations ${first} to ${next} and ${n} account history entries",
+         ("d",dir)("first",_first_operation)("next",next_operation_instance())("n",_account_entry_count) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void history_store::open_in_memory( const fc::path& snapshot )
+{ try {
+   close();
+   _in_memory = true;
+   _snapshot = snapshot;
+   _first_operation = 0;
+   _operation_count = 0;
+   _operations_size = 0;
+   _account_entry_count = 0;
+   _saved_account_entry_count = 0;
+   _heads.clear();
+   if( fc::exists( snapshot ) )
+      load_snapshot();
+   ilog( "Opened in-memory history store with operations ${first} to ${next} and ${n} account history entries",
+         ("first",_first_operation)("next",next_operation_instance())("n",_account_entry_count) );
+} FC_CAPTURE_AND_RETHROW( (snapshot) ) }
+
+/**
+ *  The snapshot holds the size of the packed heads, the heads, the index entries with offsets into the packed
+ *  operations that follow the account entries, the account entries and the packed operations
+ */
+void history_store::load_snapshot()
+{
+   std::ifstream in( _snapshot.generic_string().c_str(), std::ios::binary );
+   in.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   uint64_t heads_size = 0;
+   in.read( (char*)&heads_size, sizeof(heads_size) );
+   std::vector<char> data( heads_size );
+   in.read( data.data(), data.size() );
+   const auto heads = fc::raw::unpack<detail::history_store_heads>( data );
+
+   std::vector<operation_index_entry> index( heads.operation_count );
+   in.read( (char*)index.data(), index.size() * sizeof(operation_index_entry) );
+   _memory_accounts.resize( heads.account_entry_count );
+   for( auto& entry : _memory_accounts )
+      in.read( (char*)&entry, sizeof(entry) );
+   for( const auto& entry : index )
+   {
+      data.resize( entry.size );
+      in.read( data.data(), data.size() );
+      _memory_operation_index.push_back( store_in_slab( data.data(), entry.size ) );
+   }
+
+   _first_operation = heads.first_operation;
+   _operation_count = heads.operation_count;
+   _account_entry_count = heads.account_entry_count;
+   _saved_account_entry_count = _account_entry_count;
+   _heads.reserve( heads.heads.size() );
+   for( const auto& head : heads.heads )
+   {
+      account_head& h = _heads[head.first];
+      h.entry = head.second.first;
+      h.sequence = head.second.second;
+   }
+}
+
+void history_store::save_snapshot()const
+{
+   detail::history_store_heads heads;
+   heads.first_operation = _first_operation;
+   heads.operation_count = _operation_count;
+   heads.account_entry_count = _account_entry_count;
+   heads.heads.reserve( _heads.size() );
+   for( const auto& head : _heads )
+      heads.heads.push_back( std::make_pair( head.first, std::make_pair( head.second.entry, head.second.sequence ) ) );
+   const std::vector<char> data = fc::raw::pack( heads );
+
+   const fc::path tmp = _snapshot.generic_string() + ".tmp";
+   {
+      std::ofstream out( tmp.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      const uint64_t heads_size = data.size();
+      out.write( (const char*)&heads_size, sizeof(heads_size) );
+      out.write( data.data(), data.size() );
+      uint64_t offset = 0;
+      for( operation_index_entry entry : _memory_operation_index )
+      {
+         entry.offset = offset;
+         entry.slab = 0;
+         offset += entry.size;
+         out.write( (const char*)&entry, sizeof(entry) );
+      }
+      for( const auto& entry : _memory_accounts )
+         out.write( (const char*)&entry, sizeof(entry) );
+      for( const auto& entry : _memory_operation_index )
+         out.write( _slabs[entry.slab].data() + entry.offset, entry.size );
+      FC_ASSERT( out.good(), "Unable to write ${f}", ("f",tmp) );
+   }
+   fc::rename( tmp, _snapshot );
+}
+
+history_store::operation_index_entry history_store::store_in_slab( const char* data, uint32_t size )
+{
+   if( _slabs.empty() || _slabs.back().size() + size > _slabs.back().capacity() )
+   {
+      _slabs.emplace_back();
+      _slabs.back().reserve( std::max<size_t>( slab_size, size ) );
+   }
+   operation_index_entry entry;
+   entry.slab = _slabs.size() - 1;
+   entry.offset = _slabs.back().size();
+   entry.size = size;
+   _slabs.back().insert( _slabs.back().end(), data, data + size );
+   _operations_size += size;
+   return entry;
+}
+
+uint64_t history_store::memory_usage()const
+{
+   if( !_in_memory )
+      return 0;
+   uint64_t usage = _memory_operation_index.size() * sizeof(operation_index_entry)
+                  + _memory_accounts.size() * sizeof(archived_account_history_entry)
+                  + _heads.size() * ( sizeof(uint64_t) + sizeof(account_head) + 2 * sizeof(void*) )
+                  + _heads.bucket_count() * sizeof(void*);
+   for( const auto& slab : _slabs )
+      usage += slab.capacity();
+   return usage;
+}
+
+void history_store::recover()
+{
+   _first_operation = 0;
+   _operation_count = 0;
+   _account_entry_count = 0;
+   _saved_account_entry_count = 0;
+   _heads.clear();
+
+   uint64_t heads_entry_count = 0;
+   const fc::path heads_filename = _dir / "heads";
+   if( fc::exists( heads_filename ) )
+   {
+      std::ifstream heads_file( heads_filename.generic_string().c_str(), std::ios::binary );
+      std::vector<char> data( (std::istreambuf_iterator<char>( heads_file )), std::istreambuf_iterator<char>() );
+      const auto heads = fc::raw::unpack<detail::history_store_heads>( data );
+      _first_operation = heads.first_operation;
+      heads_entry_count = heads.account_entry_count;
+      _heads.reserve( heads.heads.size() );
+      for( const auto& head : heads.heads )
+      {
+         account_head& h = _heads[head.first];
+         h.entry = head.second.first;
+         h.sequence = head.second.second;
+      }
+   }
+
+   // operations: keep the index entries whose data is complete
+   const uint64_t operations_size = fc::file_size( _dir / "operations" );
+   uint64_t count = fc::file_size( _dir / "operations.index" ) / sizeof(operation_index_entry);
+   while( count > 0 )
+   {
+      operation_index_entry entry;
+      _operation_index.seekg( ( count - 1 ) * sizeof(entry) );
+      _operation_index.read( (char*)&entry, sizeof(entry) );
+      if( entry.offset + entry.size <= operations_size )
+      {
+         _operations_size = entry.offset + entry.size;
+         break;
+      }
+      --count;
+   }
+   if( count == 0 )
+      _operations_size = 0;
+   _operation_count = count;
+
+   // account entries: the heads file covers a prefix, replay the complete entries after it whose operation is kept
+   uint64_t entry_count = fc::file_size( _dir / "accounts" ) / sizeof(archived_account_history_entry);
+   if( heads_entry_count > entry_count )
+   {
+      wlog( "History store heads are ahead of the account history entries, rebuilding them" );
+      _heads.clear();
+      heads_entry_count = 0;
+   }
+   _account_entry_count = heads_entry_count;
+   for( uint64_t position = heads_entry_count; position < entry_count; ++position )
+   {
+      archived_account_history_entry entry;
+      _accounts.seekg( position * sizeof(entry) );
+      _accounts.read( (char*)&entry, sizeof(entry) );
+      if( entry.operation >= next_operation_instance() )
+         break;
+      account_head& head = _heads[entry.account];
+      head.entry = position + 1;
+      head.sequence = entry.sequence;
+      ++_account_entry_count;
+   }
+   _saved_account_entry_count = heads_entry_count;
+
+   // cut off what was not kept, so that appends continue right after the last valid data
+   _operations.close();
+   _operation_index.close();
+   _accounts.close();
+   fc::resize_file( _dir / "operations", _operations_size );
+   fc::resize_file( _dir / "operations.index", _operation_count * sizeof(operation_index_entry) );
+   fc::resize_file( _dir / "accounts", _account_entry_count * sizeof(archived_account_history_entry) );
+   open_append_file( _operations, _dir / "operations" );
+   open_append_file( _operation_index, _dir / "operations.index" );
+   open_append_file( _accounts, _dir / "accounts" );
+   _operations.seekp( 0, std::ios::end );
+   _operation_index.seekp( 0, std::ios::end );
+   _accounts.seekp( 0, std::ios::end );
+   if( _account_entry_count != _saved_account_entry_count )
+      save_heads();
+}
+
+void history_store::close()
+{
+   if( _in_memory )
+   {
+      if( !_snapshot.empty() )
+         save_snapshot();
+      _in_memory = false;
+      _slabs.clear();
+      _memory_operation_index.clear();
+      _memory_accounts.clear();
+      _heads.clear();
+      return;
+   }
+   if( !is_open() )
+      return;
+   flush();
+   save_heads();
+   _operations_view.reset();
+   _operation_index_view.reset();
+   _accounts_view.reset();
+   _operations.close();
+   _operation_index.close();
+   _accounts.close();
+}
+
+void history_store::save_heads()
+{
+   detail::history_store_heads heads;
+   heads.first_operation = _first_operation;
+   heads.operation_count = _operation_count;
+   heads.account_entry_count = _account_entry_count;
+   heads.heads.reserve( _heads.size() );
+   for( const auto& head : _heads )
+      heads.heads.push_back( std::make_pair( head.first, std::make_pair( head.second.entry, head.second.sequence ) ) );
+
+   // the heads describe appended data, which must be on disk before them
+   _operations.flush();
+   _operation_index.flush();
+   _accounts.flush();
+   const fc::path tmp = _dir / "heads.tmp";
+   {
+      const std::vector<char> data = fc::raw::pack( heads );
+      std::ofstream out( tmp.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      out.write( data.data(), data.size() );
+      FC_ASSERT( out.good(), "Unable to write ${f}", ("f",tmp) );
+   }
+   fc::rename( tmp, _dir / "heads" );
+   _saved_account_entry_count = _account_entry_count;
+}
+
+void history_store::append_operation( const operation_history_object& op )
+{
+   const uint64_t instance = op.id.instance();
+   if( _operation_count == 0 && _account_entry_count == 0 )
+   {
+      _first_operation = instance;
+      if( !_in_memory )
+         save_heads();
+   }
+   if( instance < next_operation_instance() )
+      return;
+
+   const std::vector<char> data = fc::raw::pack( op );
+   operation_index_entry missing;
+   missing.offset = _operations_size;
+   while( next_operation_instance() < instance )
+   {
+      if( _in_memory )
+         _memory_operation_index.push_back( missing );
+      else
+         _operation_index.write( (const char*)&missing, sizeof(missing) );
+      ++_operation_count;
+   }
+   if( _in_memory )
+      _memory_operation_index.push_back( store_in_slab( data.data(), data.size() ) );
+   else
+   {
+      operation_index_entry entry;
+      entry.offset = _operations_size;
+      entry.size = data.size();
+      _operations.write( data.data(), data.size() );
+      _operation_index.write( (const char*)&entry, sizeof(entry) );
+      _operations_size += data.size();
+   }
+   ++_operation_count;
+   _dirty = true;
+}
+
+void history_store::append_account_entry( account_id_type account, uint64_t sequence, operation_history_id_type op )
+{
+   account_head& head = _heads[account.instance.value];
+   if( sequence <= head.sequence )
+      return;
+   archived_account_history_entry entry;
+   entry.account = account.instance.value;
+   entry.sequence = sequence;
+   entry.operation = op.instance.value;
+   entry.previous = head.entry;
+   const uint64_t skip_sequence = sequence & ( sequence - 1 );
+   if( skip_sequence != 0 )
+      entry.skip = seek_account_entry( head.entry, skip_sequence );
+   if( _in_memory )
+      _memory_accounts.push_back( entry );
+   else
+   {
+      _accounts.write( (const char*)&entry, sizeof(entry) );
+      _unflushed_accounts.push_back( entry );
+   }
+   ++_account_entry_count;
+   head.entry = _account_entry_count;
+   head.sequence = sequence;
+   _dirty = true;
+}
+
+void history_store::flush()
+{
+   if( !_dirty || _in_memory )
+      return;
+   _operations.flush();
+   _operation_index.flush();
+   _accounts.flush();
+   update_mappings();
+   _unflushed_accounts.clear();
+   if( _account_entry_count - _saved_account_entry_count >= detail::heads_save_interval )
+      save_heads();
+   _dirty = false;
+}
+
+void history_store::update_mappings()
+{
+   const auto map = []( std::unique_ptr<detail::mapped_file>& view, const fc::path& filename, uint64_t size ) {
+      if( size == 0 )
+         view.reset();
+      else if( !view || view->size != size )
+         view.reset( new detail::mapped_file( filename, size ) );
+   };
+   map( _operations_view, _dir / "operations", _operations_size );
+   map( _operation_index_view, _dir / "operations.index", _operation_count * sizeof(operation_index_entry) );
+   map( _accounts_view, _dir / "accounts", _account_entry_count * sizeof(archived_account_history_entry) );
+}
+
+uint64_t history_store::newest_sequence( account_id_type account )const
+{
+   auto itr = _heads.find( account.instance.value );
+   return itr == _heads.end() ? 0 : itr->second.sequence;
+}
+
+bool history_store::read_operation_index( uint64_t position, operation_index_entry& entry )const
+{
+   if( _in_memory )
+   {
+      if( position >= _memory_operation_index.size() )
+         return false;
+      entry = _memory_operation_index[position];
+      return true;
+   }
+   if( !_operation_index_view || ( position + 1 ) * sizeof(operation_index_entry) > _operation_index_view->size )
+      return false;
+   std::memcpy( &entry, _operation_index_view->data + position * sizeof(entry), sizeof(entry) );
+   return true;
+}
+
+optional<operation_history_object> history_store::get_operation( operation_history_id_type id )const
+{
+   const uint64_t instance = id.instance.value;
+   operation_index_entry entry;
+   if( instance < _first_operation || !read_operation_index( instance - _first_operation, entry ) || entry.size == 0 )
+      return optional<operation_history_object>();
+   const char* data = nullptr;
+   if( _in_memory )
+      data = _slabs[entry.slab].data() + entry.offset;
+   else if( _operations_view && entry.offset + entry.size <= _operations_view->size )
+      data = _operations_view->data + entry.offset;
+   else
+      return optional<operation_history_object>();
+   operation_history_object result;
+   fc::datastream<const char*> ds( data, entry.size );
+   fc::raw::unpack( ds, result );
+   return result;
+}
+
+bool history_store::has_account_entry( uint64_t position )const
+{
+   if( _in_memory )
+      return position < _memory_accounts.size();
+   return _accounts_view && ( position + 1 ) * sizeof(archived_account_history_entry) <= _accounts_view->size;
+}
+
+archived_account_history_entry history_store::read_account_entry( uint64_t position )const
+{
+   if( _in_memory )
+      return _memory_accounts[position];
+   const uint64_t mapped = _accounts_view ? _accounts_view->size / sizeof(archived_account_history_entry) : 0;
+   if( position >= mapped )
+      return _unflushed_accounts[position - mapped];
+   archived_account_history_entry entry;
+   std::memcpy( &entry, _accounts_view->data + position * sizeof(entry), sizeof(entry) );
+   return entry;
+}
+
+void history_store::for_each_account_entry( account_id_type account, uint64_t max_sequence,
+                                            const std::function<bool(const archived_account_history_entry&)>& visit )const
+{
+   auto itr = _heads.find( account.instance.value );
+   if( itr == _heads.end() )
+      return;
+   uint64_t next = itr->second.entry;
+   if( next == 0 || !has_account_entry( next - 1 ) )
+      return; // appended after the last flush
+   next = seek_account_entry( next, max_sequence );
+   while( next > 0 )
+   {
+      const archived_account_history_entry entry = read_account_entry( next - 1 );
+      if( !visit( entry ) )
+         return;
+      next = entry.previous;
+   }
+}
+
+uint64_t history_store::seek_account_entry( uint64_t next, uint64_t max_sequence )const
+{
+   while( next > 0 )
+   {
+      const archived_account_history_entry entry = read_account_entry( next - 1 );
+      if( entry.sequence <= max_sequence )
+         return next;
+      // no entry is newer than the skip target and of at most its sequence, jumping can't pass the one we look for
+      const uint64_t skip_sequence = entry.sequence & ( entry.sequence - 1 );
+      next = ( entry.skip != 0 && skip_sequence >= max_sequence ) ? entry.skip : entry.previous;
+   }
+   return 0;
+}
+
+uint64_t history_store::find_sequence( account_id_type account, operation_history_id_type op )const
+{
+   auto itr = _heads.find( account.instance.value );
+   if( itr == _heads.end() || itr->second.entry == 0 || !has_account_entry( itr->second.entry - 1 ) )
+      return 0;
+   // the operations of an account grow with the sequence, search for the highest sequence whose newest entry is
+   // of at most op
+   uint64_t low = 0;
+   uint64_t high = itr->second.sequence;
+   while( low < high )
+   {
+      const uint64_t middle = low + ( high - low + 1 ) / 2;
+      const uint64_t position = seek_account_entry( itr->second.entry, middle );
+      if( position == 0 || read_account_entry( position - 1 ).operation <= op.instance.value )
+         low = middle;
+      else
+         high = middle - 1;
+   }
+   const uint64_t position = seek_account_entry( itr->second.entry, low );
+   return position == 0 ? 0 : read_account_entry( position - 1 ).sequence;
+}
+
+} } // graphene::account_history
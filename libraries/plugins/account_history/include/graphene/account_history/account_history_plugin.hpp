@@ -30,6 +30,9 @@
 
 #include <fc/thread/future.hpp>
 
+#include <set>
+#include <tuple>
+
 namespace graphene { namespace account_history {
    using namespace chain;
    //using namespace graphene::db;
@@ -61,6 +64,30 @@ namespace detail
     class account_history_plugin_impl;
 }
 
+class history_store;
+
+/**
+ * Orders the account history entries by account, operation type and operation, so that the history of one type of
+ * operations of an account is a range. The index-history-by-operation-type option adds it to
+ * account_transaction_history_index.
+ */
+class account_history_type_index : public secondary_index
+{
+   public:
+      /** the account, the operation type and the operation instance of an entry */
+      typedef std::tuple< account_id_type, int32_t, uint64_t > entry_key;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual uint64_t estimated_memory_usage()const override;
+      virtual bool is_self_contained()const override { return true; }
+
+      const std::set< entry_key >& entries()const { return _entries; }
+
+   private:
+      std::set< entry_key > _entries;
+};
+
 class account_history_plugin : public graphene::app::plugin
 {
    public:
@@ -73,8 +100,13 @@ class account_history_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       flat_set<account_id_type> tracked_accounts()const;
+      /** @return the store the history of irreversible blocks is moved to, nullptr if it is kept in memory */
+      const history_store* get_history_store()const;
+      /** @return the index of the entries by operation type, nullptr if index-history-by-operation-type is off */
+      const account_history_type_index* get_operation_type_index()const;
 
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
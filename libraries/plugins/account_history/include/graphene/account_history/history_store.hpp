@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+   namespace detail { class mapped_file; }
+
+   /** One entry of the history of an account, as kept in the history store */
+   struct archived_account_history_entry
+   {
+      uint64_t account = 0;   ///< instance of the account
+      uint64_t sequence = 0;  ///< sequence number of the entry in the history of the account, starting at 1
+      uint64_t operation = 0; ///< instance of the operation
+      uint64_t previous = 0;  ///< 1 + position of the previous entry of the same account in the store, 0 if none
+      /**
+       *  1 + position of the newest entry of the same account whose sequence is at most sequence with its lowest
+       *  set bit cleared, 0 if none. Following these instead of previous reaches any sequence in logarithmic time.
+       */
+      uint64_t skip = 0;
+   };
+
+   /**
+    *  Keeps operation history that can no longer change on disk instead of in the object database.
+    *
+    *  The store consists of append-only files in one directory: "operations" holds the packed
+    *  operation_history_objects and "operations.index" a fixed-size entry per operation instance pointing into it,
+    *  "accounts" holds fixed-size archived_account_history_entry records in which the entries of each account are
+    *  linked from newest to oldest, with skip links to seek a sequence number. The newest entry of every account is kept in memory and written to "heads" from
+    *  time to time. On open, entries appended after the last "heads" are replayed, and a partly written tail left by
+    *  a crash is cut off.
+    *
+    *  Lookups read the files through read-only memory mappings that are renewed by flush(). Appending and flushing
+    *  must only happen while the chain state is locked for writing, lookups while it is locked at least for reading.
+    *
+    *  A store opened with open_in_memory() keeps the same records in memory instead: the packed operations in
+    *  slabs, the index and the account entries in fixed-size records. That takes a fraction of the memory the
+    *  objects take in the object database, operations are decoded when they are looked up. It is saved to a snapshot
+    *  file on close and loaded from it again on open, like the object database is.
+    */
+   class history_store
+   {
+      public:
+         history_store();
+         ~history_store();
+
+         void open( const fc::path& dir );
+         /** Opens an in-memory store, loading it from snapshot if that exists, it's saved to snapshot on close */
+         void open_in_memory( const fc::path& snapshot );
+         void close();
+         bool is_open()const { return _in_memory || _operations.is_open(); }
+         bool is_in_memory()const { return _in_memory; }
+         /** @return the bytes an in-memory store uses, 0 for a store on disk */
+         uint64_t memory_usage()const;
+
+         /**
+          *  Appends an operation, instances between the newest stored one and this one are recorded as missing.
+          *  Operations that are stored already are ignored, that happens when a block that moved operations to the
+          *  store was popped and pushed again.
+          */
+         void append_operation( const operation_history_object& op );
+         /** Appends an entry of the history of an account, entries that are stored already are ignored */
+         void append_account_entry( account_id_type account, uint64_t sequence, operation_history_id_type op );
+         /** Writes appended data to the files and makes it visible to lookups */
+         void flush();
+
+         /** @return the instance following the newest stored operation, everything before it is in the store */
+         uint64_t next_operation_instance()const { return _first_operation + _operation_count; }
+         /** @return the sequence number of the newest stored entry of account, 0 if there is none */
+         uint64_t newest_sequence( account_id_type account )const;
+
+         optional<operation_history_object> get_operation( operation_history_id_type id )const;
+         /**
+          *  Calls visit for the stored entries of account with a sequence number of at most max_sequence, newest
+          *  first, until it returns false
+          */
+         void for_each_account_entry( account_id_type account, uint64_t max_sequence,
+                                      const std::function<bool(const archived_account_history_entry&)>& visit )const;
+         /** @return the sequence number of the newest stored entry of account of at most op, 0 if there is none */
+         uint64_t find_sequence( account_id_type account, operation_history_id_type op )const;
+
+      private:
+         struct account_head
+         {
+            uint64_t entry = 0;    ///< 1 + position of the newest entry
+            uint64_t sequence = 0;
+         };
+
+         struct operation_index_entry
+         {
+            uint64_t offset = 0; ///< offset in the operations file, or in the slab
+            uint32_t size = 0;   ///< 0 for an instance that has no operation
+            uint32_t slab = 0;   ///< slab of an in-memory store
+         };
+
+         void recover();
+         void save_heads();
+         void update_mappings();
+         archived_account_history_entry read_account_entry( uint64_t position )const;
+         /** @return 1 + position of the newest entry of at most max_sequence in the chain starting at next, or 0 */
+         uint64_t seek_account_entry( uint64_t next, uint64_t max_sequence )const;
+         bool has_account_entry( uint64_t position )const;
+         bool read_operation_index( uint64_t position, operation_index_entry& entry )const;
+         operation_index_entry store_in_slab( const char* data, uint32_t size );
+         void load_snapshot();
+         void save_snapshot()const;
+
+         bool          _in_memory = false;
+         fc::path      _snapshot;
+         fc::path      _dir;
+         std::fstream  _operations;
+         std::fstream  _operation_index;
+         std::fstream  _accounts;
+
+         uint64_t      _first_operation = 0;
+         uint64_t      _operation_count = 0;
+         uint64_t      _operations_size = 0;
+         uint64_t      _account_entry_count = 0;
+         uint64_t      _saved_account_entry_count = 0;
+         bool          _dirty = false;
+
+         std::unordered_map<uint64_t, account_head> _heads;
+
+         std::unique_ptr<detail::mapped_file> _operations_view;
+         std::unique_ptr<detail::mapped_file> _operation_index_view;
+         std::unique_ptr<detail::mapped_file> _accounts_view;
+
+         /** packed operations are appended to the last slab, a new one is started when it's full */
+         static const size_t slab_size = 1024 * 1024;
+         std::vector< std::vector<char> >             _slabs;
+         std::deque<operation_index_entry>            _memory_operation_index;
+         std::deque<archived_account_history_entry>   _memory_accounts;
+         /// account entries of a store on disk that were appended after the last flush, not mapped yet
+         std::vector<archived_account_history_entry>  _unflushed_accounts;
+   };
+
+} } // graphene::account_history
+
+FC_REFLECT( graphene::account_history::archived_account_history_entry, (account)(sequence)(operation)(previous)(skip) )
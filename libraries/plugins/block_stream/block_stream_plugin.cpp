@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/block_stream/block_stream_plugin.hpp>
+#include <graphene/block_stream/stream_log.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace graphene { namespace block_stream {
+
+namespace detail
+{
+
+/** The frame of a chain message waiting for the stream thread to log it */
+struct queued_frame
+{
+   vector<char> frame;
+   uint32_t     block_num;
+   bool         applied_block;
+};
+
+/** A connected consumer */
+struct stream_client
+{
+   int                 fd = -1;
+   vector<char>        in;
+   vector<char>        out;
+   size_t              out_pos = 0;
+   bool                subscribed = false;
+   std::string         name;
+   stream_log::cursor  cursor;
+};
+
+class block_stream_plugin_impl
+{
+   public:
+      explicit block_stream_plugin_impl( block_stream_plugin& _plugin ) : _self( _plugin ) {}
+
+      graphene::chain::database& database()
+      {
+         return _self.database();
+      }
+
+      /** carries on from what the log streamed before */
+      void init_chain_state();
+      void on_applied_block( const signed_block& b );
+      void start();
+      void stop();
+
+      block_stream_plugin& _self;
+
+      fc::path _dir;
+      fc::path _socket_path;
+      uint32_t _segment_blocks = 10000;
+      uint32_t _retain_blocks = 100000;
+      uint32_t _max_retain_blocks = 1000000;
+      bool     _object_deltas = true;
+
+      std::unique_ptr<stream_log>        _log;
+      std::map<std::string,uint32_t>     _acks;
+
+   private:
+      void queue( const stream_message& msg, uint32_t block_num );
+      applied_block_message make_applied_block_message( const signed_block& b );
+
+      void run();
+      void log_queued();
+      void accept_clients();
+      /** @return false if the client is to be closed */
+      bool read_client( stream_client& client );
+      bool handle_message( stream_client& client, const stream_message& msg );
+      bool write_client( stream_client& client );
+      void maintain();
+      void save_acks();
+
+      /// what the chain thread streamed so far
+      stream_log::chain_state            _chain;
+
+      std::mutex                         _mutex;
+      /// guarded by _mutex, frames are logged by the chain thread itself while the stream thread is not running
+      std::deque<queued_frame>           _queue;
+      bool                               _running = false;
+
+      std::thread                        _thread;
+      std::atomic<bool>                  _stopping{ false };
+      int                                _listen_fd = -1;
+      int                                _wake[2] = { -1, -1 };
+      std::list<stream_client>           _clients;
+      uint32_t                           _head_block = 0;
+      bool                               _acks_dirty = false;
+      fc::time_point                     _last_maintenance;
+};
+
+/** how much of the log is read ahead for a consumer */
+static const size_t client_buffer_size = 256 * 1024;
+
+void block_stream_plugin_impl::queue( const stream_message& msg, uint32_t block_num )
+{
+   queued_frame queued;
+   queued.frame = pack_stream_frame( msg );
+   queued.block_num = block_num;
+   queued.applied_block = ( msg.which() == stream_message::tag<applied_block_message>::value );
+   std::unique_lock<std::mutex> lock( _mutex );
+   if( !_running )
+   {
+      // e.g. during a replay at startup, consumers connect later anyway
+      _log->append( queued.frame, queued.block_num, queued.applied_block );
+      if( queued.applied_block )
+         _head_block = queued.block_num;
+      return;
+   }
+   _queue.push_back( std::move( queued ) );
+   lock.unlock();
+#ifndef WIN32
+   const char wake = 1;
+   if( ::write( _wake[1], &wake, 1 ) < 0 ) {} // a full pipe wakes the thread up as well
+#endif
+}
+
+applied_block_message block_stream_plugin_impl::make_applied_block_message( const signed_block& b )
+{
+   graphene::chain::database& db = database();
+   applied_block_message msg;
+   msg.block_num = b.block_num();
+   msg.block_id = b.id();
+   msg.timestamp = b.timestamp;
+   const vector< optional<operation_history_object> >& ops = db.get_applied_operations();
+   for( uint32_t i = 0; i < ops.size(); ++i )
+   {
+      if( !ops[i].valid() )
+         continue;
+      msg.operations.push_back( *ops[i] );
+      msg.impacted_accounts.push_back( db.get_applied_operation_impacted_accounts( i ) );
+   }
+
+   if( !_object_deltas || !db._undo_db.enabled() )
+      return msg;
+   const graphene::db::undo_state& changes = db._undo_db.head();
+   auto add_current = [&db,&msg]( const object_id_type& id ) {
+      const object* obj = db.find_object( id );
+      if( obj != nullptr )
+         msg.deltas.push_back( object_delta{ id, obj->pack() } );
+   };
+   for( const auto& id : changes.new_ids )
+      add_current( id );
+   for( const auto& item : changes.old_values )
+      add_current( item.first );
+   for( const auto& item : changes.packed_old_values )
+      add_current( item.first );
+   for( const auto& item : changes.removed )
+      msg.deltas.push_back( object_delta{ item.first, vector<char>() } );
+   std::sort( msg.deltas.begin(), msg.deltas.end(), []( const object_delta& a, const object_delta& b ) {
+      return a.id < b.id;
+   });
+   return msg;
+}
+
+void block_stream_plugin_impl::on_applied_block( const signed_block& b )
+{ try {
+   const uint32_t block_num = b.block_num();
+   // blocks streamed before are applied again by a replay
+   if( block_num <= _chain.last_irreversible )
+      return;
+   const auto known = _chain.reversible.find( block_num );
+   if( known == _chain.reversible.end() || known->second != b.id() )
+   {
+      if( block_num <= _chain.last_block )
+      {
+         queue( undo_blocks_message{ block_num }, block_num );
+         _chain.reversible.erase( _chain.reversible.lower_bound( block_num ), _chain.reversible.end() );
+      }
+      queue( make_applied_block_message( b ), block_num );
+      _chain.reversible[block_num] = b.id();
+      _chain.last_block = block_num;
+   }
+
+   const uint32_t irreversible = database().get_dynamic_global_properties().last_irreversible_block_num;
+   if( irreversible > _chain.last_irreversible )
+   {
+      queue( irreversible_message{ irreversible }, irreversible );
+      _chain.reversible.erase( _chain.reversible.begin(), _chain.reversible.upper_bound( irreversible ) );
+      _chain.last_irreversible = irreversible;
+   }
+} FC_CAPTURE_AND_LOG( (b.block_num()) ) }
+
+void block_stream_plugin_impl::init_chain_state()
+{
+   _chain = _log->recovered_state();
+   _head_block = _chain.last_block;
+}
+
+void block_stream_plugin_impl::save_acks()
+{
+   const fc::path tmp = _dir / "acks.tmp";
+   fc::json::save_to_file( _acks, tmp );
+   fc::rename( tmp, _dir / "acks" );
+   _acks_dirty = false;
+}
+
+#ifdef WIN32
+
+void block_stream_plugin_impl::start()
+{
+   FC_THROW( "The block_stream plugin needs Unix domain sockets" );
+}
+
+void block_stream_plugin_impl::stop() {}
+
+#else
+
+void block_stream_plugin_impl::start()
+{ try {
+   const std::string path = _socket_path.generic_string();
+   sockaddr_un addr = {};
+   FC_ASSERT( path.size() < sizeof(addr.sun_path), "block-stream-socket ${p} is too long", ("p",path) );
+   addr.sun_family = AF_UNIX;
+   std::strncpy( addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1 );
+   ::unlink( path.c_str() );
+
+   _listen_fd = ::socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+   FC_ASSERT( _listen_fd >= 0, "Unable to create the block stream socket: ${e}", ("e",strerror(errno)) );
+   FC_ASSERT( ::bind( _listen_fd, (const sockaddr*)&addr, sizeof(addr) ) == 0,
+              "Unable to bind the block stream socket to ${p}: ${e}", ("p",path)("e",strerror(errno)) );
+   FC_ASSERT( ::listen( _listen_fd, 16 ) == 0, "Unable to listen on ${p}: ${e}", ("p",path)("e",strerror(errno)) );
+   FC_ASSERT( ::pipe2( _wake, O_NONBLOCK | O_CLOEXEC ) == 0, "Unable to create a pipe: ${e}", ("e",strerror(errno)) );
+
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _running = true;
+   }
+   _last_maintenance = fc::time_point::now();
+   _thread = std::thread( [this]() { run(); } );
+   ilog( "Streaming blocks on ${p}", ("p",path) );
+} FC_CAPTURE_AND_RETHROW( (_socket_path) ) }
+
+void block_stream_plugin_impl::stop()
+{
+   if( _thread.joinable() )
+   {
+      _stopping = true;
+      const char wake = 1;
+      if( ::write( _wake[1], &wake, 1 ) < 0 ) {}
+      _thread.join();
+   }
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _running = false;
+   }
+   // frames queued after the thread stopped are logged here
+   log_queued();
+   for( stream_client& client : _clients )
+      ::close( client.fd );
+   _clients.clear();
+   if( _listen_fd >= 0 )
+   {
+      ::close( _listen_fd );
+      ::unlink( _socket_path.generic_string().c_str() );
+      _listen_fd = -1;
+   }
+   for( int& fd : _wake )
+      if( fd >= 0 )
+      {
+         ::close( fd );
+         fd = -1;
+      }
+   if( _acks_dirty )
+      save_acks();
+}
+
+void block_stream_plugin_impl::log_queued()
+{
+   std::deque<queued_frame> queued;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      queued.swap( _queue );
+   }
+   for( const queued_frame& q : queued )
+   {
+      _log->append( q.frame, q.block_num, q.applied_block );
+      if( q.applied_block )
+         _head_block = q.block_num;
+   }
+}
+
+void block_stream_plugin_impl::run()
+{
+   while( !_stopping )
+   {
+      vector<pollfd> fds( 2 + _clients.size() );
+      fds[0] = pollfd{ _wake[0], POLLIN, 0 };
+      fds[1] = pollfd{ _listen_fd, POLLIN, 0 };
+      size_t i = 2;
+      for( const stream_client& client : _clients )
+         fds[i++] = pollfd{ client.fd, short( POLLIN | ( client.out_pos < client.out.size() ? POLLOUT : 0 ) ), 0 };
+      ::poll( fds.data(), fds.size(), 1000 );
+      if( _stopping )
+         break;
+
+      try
+      {
+         char drain[256];
+         while( ::read( _wake[0], drain, sizeof(drain) ) > 0 ) {}
+         log_queued();
+         if( fds[1].revents & POLLIN )
+            accept_clients();
+
+         i = 2;
+         for( auto itr = _clients.begin(); itr != _clients.end(); )
+         {
+            // clients accepted in this round have no pollfd yet
+            const short revents = i < fds.size() ? fds[i++].revents : 0;
+            bool keep = !( revents & ( POLLERR | POLLNVAL ) );
+            if( keep && ( revents & ( POLLIN | POLLHUP ) ) )
+               keep = read_client( *itr );
+            if( keep )
+               keep = write_client( *itr );
+            if( keep )
+               ++itr;
+            else
+            {
+               if( !itr->name.empty() )
+                  ilog( "Block stream consumer ${n} disconnected", ("n",itr->name) );
+               ::close( itr->fd );
+               itr = _clients.erase( itr );
+            }
+         }
+         maintain();
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Block stream failed: ${e}", ("e",e.to_detail_string()) );
+      }
+   }
+}
+
+void block_stream_plugin_impl::accept_clients()
+{
+   for( ;; )
+   {
+      const int fd = ::accept4( _listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+      if( fd < 0 )
+         return;
+      stream_client client;
+      client.fd = fd;
+      _clients.push_back( std::move( client ) );
+   }
+}
+
+bool block_stream_plugin_impl::read_client( stream_client& client )
+{
+   char buffer[4096];
+   bool open = true;
+   for( ;; )
+   {
+      const ssize_t n = ::read( client.fd, buffer, sizeof(buffer) );
+      if( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) )
+         break;
+      if( n <= 0 )
+      {
+         // the messages sent before closing still count, e.g. a last acknowledgement
+         open = false;
+         break;
+      }
+      client.in.insert( client.in.end(), buffer, buffer + n );
+   }
+   size_t pos = 0;
+   try
+   {
+      for( ;; )
+      {
+         stream_message msg;
+         const size_t size = unpack_stream_frame( client.in.data() + pos, client.in.size() - pos, msg );
+         if( size == 0 )
+            break;
+         pos += size;
+         if( !handle_message( client, msg ) )
+            return false;
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Dropping block stream consumer ${n} which sent an invalid message: ${e}",
+            ("n",client.name)("e",e.to_string()) );
+      return false;
+   }
+   client.in.erase( client.in.begin(), client.in.begin() + pos );
+   return open;
+}
+
+bool block_stream_plugin_impl::handle_message( stream_client& client, const stream_message& msg )
+{
+   if( msg.which() == stream_message::tag<subscribe_message>::value && !client.subscribed )
+   {
+      const subscribe_message& subscribe = msg.get<subscribe_message>();
+      client.name = subscribe.consumer;
+      client.subscribed = true;
+      const auto ack = _acks.find( client.name );
+      if( subscribe.start_block != 0 )
+         client.cursor = _log->find( subscribe.start_block );
+      else if( ack != _acks.end() )
+         client.cursor = _log->find( ack->second + 1 );
+      else
+         client.cursor = _log->end();
+      ilog( "Block stream consumer ${n} subscribed from block ${b}", ("n",client.name)("b",subscribe.start_block) );
+      return true;
+   }
+   if( msg.which() == stream_message::tag<ack_message>::value && client.subscribed )
+   {
+      if( !client.name.empty() )
+      {
+         _acks[client.name] = msg.get<ack_message>().block_num;
+         _acks_dirty = true;
+      }
+      return true;
+   }
+   wlog( "Dropping block stream consumer ${n} which sent an unexpected message", ("n",client.name) );
+   return false;
+}
+
+bool block_stream_plugin_impl::write_client( stream_client& client )
+{
+   if( !client.subscribed )
+      return true;
+   if( client.out_pos == client.out.size() )
+   {
+      client.out.resize( client_buffer_size );
+      client.out.resize( _log->read( client.cursor, client.out.data(), client.out.size() ) );
+      client.out_pos = 0;
+   }
+   while( client.out_pos < client.out.size() )
+   {
+      const ssize_t n = ::send( client.fd, client.out.data() + client.out_pos, client.out.size() - client.out_pos,
+                                MSG_NOSIGNAL | MSG_DONTWAIT );
+      if( n < 0 )
+         return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+      client.out_pos += n;
+   }
+   return true;
+}
+
+void block_stream_plugin_impl::maintain()
+{
+   const fc::time_point now = fc::time_point::now();
+   if( now - _last_maintenance < fc::seconds(10) )
+      return;
+   _last_maintenance = now;
+   if( _acks_dirty )
+      save_acks();
+
+   // the blocks of known consumers are kept a while longer than the others
+   const uint32_t floor = _head_block > _max_retain_blocks ? _head_block - _max_retain_blocks : 0;
+   uint32_t keep_from = _head_block > _retain_blocks ? _head_block - _retain_blocks : 0;
+   for( const auto& ack : _acks )
+      if( ack.second >= floor )
+         keep_from = std::min( keep_from, ack.second + 1 );
+   for( const stream_client& client : _clients )
+      if( client.subscribed && client.cursor.segment >= floor )
+         keep_from = std::min( keep_from, client.cursor.segment );
+   _log->prune( keep_from );
+}
+
+#endif
+
+} // end namespace detail
+
+block_stream_plugin::block_stream_plugin() :
+   my( new detail::block_stream_plugin_impl(*this) )
+{
+}
+
+block_stream_plugin::~block_stream_plugin()
+{
+   my->stop();
+}
+
+std::string block_stream_plugin::plugin_name()const
+{
+   return "block_stream";
+}
+
+std::string block_stream_plugin::plugin_description()const
+{
+   return "Streams applied operations, object changes and irreversible blocks to consumers over a Unix socket.";
+}
+
+void block_stream_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("block-stream-dir", boost::program_options::value<std::string>(),
+          "Directory of the log of the block stream, consumers are served from it")
+         ("block-stream-socket", boost::program_options::value<std::string>(),
+          "Path of the Unix socket consumers connect to (block-stream-dir/socket by default)")
+         ("block-stream-segment-blocks", boost::program_options::value<uint32_t>()->default_value(10000),
+          "Number of blocks in each file of the block stream log (10000 by default)")
+         ("block-stream-retain-blocks", boost::program_options::value<uint32_t>()->default_value(100000),
+          "Number of recent blocks kept in the block stream log for consumers to replay (100000 by default)")
+         ("block-stream-max-retain-blocks", boost::program_options::value<uint32_t>()->default_value(1000000),
+          "Number of blocks kept at most for known consumers that did not acknowledge them (1000000 by default)")
+         ("block-stream-object-deltas", boost::program_options::value<bool>()->default_value(true),
+          "Whether to stream the objects changed by each block")
+         ;
+   cfg.add(cli);
+}
+
+void block_stream_plugin::plugin_initialize(const boost::program_options::variables_map& options)
+{ try {
+   FC_ASSERT( options.count("block-stream-dir"), "The block_stream plugin needs block-stream-dir" );
+   my->_dir = fc::path( options.at("block-stream-dir").as<std::string>() );
+   my->_socket_path = options.count("block-stream-socket") ?
+                         fc::path( options.at("block-stream-socket").as<std::string>() ) : my->_dir / "socket";
+   if( options.count("block-stream-segment-blocks") )
+      my->_segment_blocks = options.at("block-stream-segment-blocks").as<uint32_t>();
+   if( options.count("block-stream-retain-blocks") )
+      my->_retain_blocks = options.at("block-stream-retain-blocks").as<uint32_t>();
+   if( options.count("block-stream-max-retain-blocks") )
+      my->_max_retain_blocks = options.at("block-stream-max-retain-blocks").as<uint32_t>();
+   if( options.count("block-stream-object-deltas") )
+      my->_object_deltas = options.at("block-stream-object-deltas").as<bool>();
+   FC_ASSERT( my->_segment_blocks > 0, "block-stream-segment-blocks must be positive" );
+   my->_max_retain_blocks = std::max( my->_max_retain_blocks, my->_retain_blocks );
+
+   my->_log.reset( new stream_log( my->_dir, my->_segment_blocks ) );
+   if( fc::exists( my->_dir / "acks" ) )
+      my->_acks = fc::json::from_file( my->_dir / "acks" ).as< std::map<std::string,uint32_t> >( 2 );
+   my->init_chain_state();
+   database().applied_block.connect( [this]( const signed_block& b ) { my->on_applied_block( b ); } );
+} FC_LOG_AND_RETHROW() }
+
+void block_stream_plugin::plugin_startup()
+{
+   my->start();
+}
+
+void block_stream_plugin::plugin_shutdown()
+{
+   my->stop();
+}
+
+fc::path block_stream_plugin::socket_path()const
+{
+   return my->_socket_path;
+}
+
+} }
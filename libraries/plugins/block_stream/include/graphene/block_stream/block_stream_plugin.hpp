@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/plugin.hpp>
+#include <graphene/chain/database.hpp>
+
+namespace graphene { namespace block_stream {
+
+namespace detail
+{
+    class block_stream_plugin_impl;
+}
+
+/**
+ *  @brief Streams the applied blocks to consumers running out of process, over a Unix domain socket
+ *
+ *  For every applied block the stream carries its operations with the accounts they impact and the new values of
+ *  the objects it changed, followed by the blocks that became irreversible. When a fork undoes blocks, consumers
+ *  are told before the blocks that replace them, see messages.hpp.
+ *
+ *  The messages are appended to a log in block-stream-dir, and consumers are served from the log on a thread of
+ *  the plugin's own, so that the chain never waits for them. A consumer subscribes with its name and the block it
+ *  wants to start from, and acknowledges the blocks it processed. A consumer that reconnects without a start block
+ *  resumes after the last block it acknowledged. The log keeps block-stream-retain-blocks blocks, and the blocks
+ *  known consumers did not acknowledge yet within block-stream-max-retain-blocks.
+ */
+class block_stream_plugin : public graphene::app::plugin
+{
+   public:
+      block_stream_plugin();
+      virtual ~block_stream_plugin();
+
+      std::string plugin_name()const override;
+      std::string plugin_description()const override;
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg) override;
+      virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+      /** @return the path of the socket consumers connect to */
+      fc::path socket_path()const;
+
+      friend class detail::block_stream_plugin_impl;
+      std::unique_ptr<detail::block_stream_plugin_impl> my;
+};
+
+} } //graphene::block_stream
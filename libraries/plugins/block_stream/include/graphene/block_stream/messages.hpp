@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/static_variant.hpp>
+
+namespace graphene { namespace block_stream {
+   using namespace graphene::chain;
+
+   /**
+    *  @file
+    *  The messages exchanged over the block stream socket. Every message is framed as its size as a little endian
+    *  uint32 followed by the fc::raw packed stream_message. All messages of the chain start with the block number
+    *  they are about, so that the stream log can be indexed without unpacking them.
+    */
+
+   /** Sent by a consumer first: the consumer's name and the block to stream from */
+   struct subscribe_message
+   {
+      std::string consumer;
+      /** 0 resumes after the last block the consumer acknowledged, or with the next block if it never did */
+      uint32_t    start_block = 0;
+   };
+
+   /** Sent by a consumer when it processed all messages up to the given block, see block_stream_plugin */
+   struct ack_message
+   {
+      uint32_t block_num = 0;
+   };
+
+   /** An object a block created or modified and its new value, or that it removed when value is empty */
+   struct object_delta
+   {
+      object_id_type id;
+      vector<char>   value;
+   };
+
+   /** An applied block, its operations with the accounts they impact, and the objects it changed */
+   struct applied_block_message
+   {
+      uint32_t                           block_num = 0;
+      block_id_type                      block_id;
+      fc::time_point_sec                 timestamp;
+      vector<operation_history_object>   operations;
+      /** the accounts impacted by operations[i] */
+      vector< flat_set<account_id_type> > impacted_accounts;
+      /** empty while the node replays its blocks without undo history */
+      vector<object_delta>               deltas;
+   };
+
+   /** The blocks from block_num on were undone by a fork, their applied_block_messages are void */
+   struct undo_blocks_message
+   {
+      uint32_t block_num = 0;
+   };
+
+   /** The blocks up to block_num are irreversible */
+   struct irreversible_message
+   {
+      uint32_t block_num = 0;
+   };
+
+   typedef fc::static_variant< subscribe_message, ack_message, applied_block_message, undo_blocks_message,
+                               irreversible_message > stream_message;
+
+   /** @return msg with its frame */
+   vector<char> pack_stream_frame( const stream_message& msg );
+   /**
+    *  Unpacks the first frame of data into msg
+    *  @return the size of the frame, 0 if data does not hold a complete frame yet
+    */
+   size_t unpack_stream_frame( const char* data, size_t size, stream_message& msg );
+
+} } // graphene::block_stream
+
+FC_REFLECT( graphene::block_stream::subscribe_message, (consumer)(start_block) )
+FC_REFLECT( graphene::block_stream::ack_message, (block_num) )
+FC_REFLECT( graphene::block_stream::object_delta, (id)(value) )
+FC_REFLECT( graphene::block_stream::applied_block_message,
+            (block_num)(block_id)(timestamp)(operations)(impacted_accounts)(deltas) )
+FC_REFLECT( graphene::block_stream::undo_blocks_message, (block_num) )
+FC_REFLECT( graphene::block_stream::irreversible_message, (block_num) )
+FC_REFLECT_TYPENAME( graphene::block_stream::stream_message )
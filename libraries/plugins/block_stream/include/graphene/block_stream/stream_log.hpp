@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/block_stream/messages.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+#include <map>
+
+namespace graphene { namespace block_stream {
+
+   /**
+    *  @brief The frames of the chain messages streamed so far, in segment files that are removed once consumed
+    *
+    *  A segment is named after the first block applied in it and holds the frames of the following
+    *  segment_blocks blocks, including the undo and irreversible messages that came with them. Readers move
+    *  through the log with a cursor. A stream_log is not thread safe, see block_stream_plugin.
+    */
+   class stream_log
+   {
+      public:
+         /** A position in the log, the frame at offset of the segment starting with block segment */
+         struct cursor
+         {
+            uint32_t segment = 0;
+            uint64_t offset = 0;
+         };
+
+         /** What the messages of the log tell about the chain, to carry on after a restart */
+         struct chain_state
+         {
+            uint32_t                            last_block = 0;
+            uint32_t                            last_irreversible = 0;
+            /** the ids of the blocks after last_irreversible */
+            std::map<uint32_t,block_id_type>    reversible;
+         };
+
+         /** Opens the log in dir, dropping an incomplete frame at its end */
+         stream_log( const fc::path& dir, uint32_t segment_blocks );
+
+         const chain_state& recovered_state()const { return _recovered; }
+
+         /** Appends the frame of a message about block_num */
+         void append( const vector<char>& frame, uint32_t block_num, bool applied_block );
+
+         /** @return the position of the first applied block from block_num on, end() if there is none yet */
+         cursor find( uint32_t block_num )const;
+         cursor end()const;
+         /**
+          *  Reads up to max bytes at c into buffer and moves c after them, into the next segment once the one it
+          *  is in was read. A cursor in a segment that was removed moves to the first segment.
+          *  @return the number of bytes read
+          */
+         size_t read( cursor& c, char* buffer, size_t max )const;
+
+         /** Removes the segments that only hold messages of blocks before block_num */
+         void prune( uint32_t block_num );
+         /** @return the first block in the log, 0 if it is empty */
+         uint32_t first_block()const;
+
+      private:
+         struct segment
+         {
+            fc::path                            file;
+            uint64_t                            size = 0;
+            /** the offsets of the applied blocks */
+            std::map<uint32_t,uint64_t>         blocks;
+         };
+
+         void scan( uint32_t first_block, segment& seg );
+
+         fc::path                           _dir;
+         uint32_t                           _segment_blocks;
+         std::map<uint32_t,segment>         _segments;
+         chain_state                        _recovered;
+         std::ofstream                      _writer;
+         uint32_t                           _writer_segment = 0;
+         mutable std::ifstream              _reader;
+         mutable uint32_t                   _reader_segment = 0;
+   };
+
+} } // graphene::block_stream
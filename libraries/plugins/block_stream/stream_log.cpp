@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/block_stream/stream_log.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace graphene { namespace block_stream {
+
+namespace {
+   const char* const segment_extension = ".log";
+   /** sanity limit for the size of a frame, well above any block the chain allows */
+   const uint32_t max_frame_size = 256 * 1024 * 1024;
+}
+
+vector<char> pack_stream_frame( const stream_message& msg )
+{
+   const uint32_t size = fc::raw::pack_size( msg );
+   vector<char> frame( sizeof(size) + size );
+   std::memcpy( frame.data(), &size, sizeof(size) );
+   fc::datastream<char*> ds( frame.data() + sizeof(size), size );
+   fc::raw::pack( ds, msg );
+   return frame;
+}
+
+size_t unpack_stream_frame( const char* data, size_t size, stream_message& msg )
+{
+   uint32_t frame_size;
+   if( size < sizeof(frame_size) )
+      return 0;
+   std::memcpy( &frame_size, data, sizeof(frame_size) );
+   FC_ASSERT( frame_size <= max_frame_size, "Block stream frame of ${s} bytes is too large", ("s",frame_size) );
+   if( size < sizeof(frame_size) + frame_size )
+      return 0;
+   fc::datastream<const char*> ds( data + sizeof(frame_size), frame_size );
+   fc::raw::unpack( ds, msg );
+   return sizeof(frame_size) + frame_size;
+}
+
+stream_log::stream_log( const fc::path& dir, uint32_t segment_blocks )
+   : _dir( dir ), _segment_blocks( segment_blocks )
+{ try {
+   FC_ASSERT( segment_blocks > 0 );
+   fc::create_directories( dir );
+   for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const fc::path file = *itr;
+      if( file.extension().generic_string() != segment_extension )
+         continue;
+      segment seg;
+      seg.file = file;
+      _segments[ std::strtoul( file.stem().generic_string().c_str(), nullptr, 10 ) ] = std::move( seg );
+   }
+   for( auto& seg : _segments )
+      scan( seg.first, seg.second );
+   if( !_segments.empty() )
+      ilog( "Block stream log holds blocks ${f} to ${l}", ("f",first_block())("l",_recovered.last_block) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void stream_log::scan( uint32_t first_block, segment& seg )
+{
+   vector<char> data( fc::file_size( seg.file ) );
+   {
+      std::ifstream in( seg.file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      in.read( data.data(), data.size() );
+      FC_ASSERT( in.good() || data.empty(), "Unable to read ${f}", ("f",seg.file) );
+   }
+   uint64_t pos = 0;
+   while( pos + sizeof(uint32_t) <= data.size() )
+   {
+      uint32_t frame_size;
+      std::memcpy( &frame_size, data.data() + pos, sizeof(frame_size) );
+      if( frame_size > max_frame_size || pos + sizeof(frame_size) + frame_size > data.size() )
+         break;
+      // only the type and the block number in front of every chain message are read
+      fc::datastream<const char*> ds( data.data() + pos + sizeof(frame_size), frame_size );
+      fc::unsigned_int which;
+      uint32_t block_num;
+      fc::raw::unpack( ds, which );
+      fc::raw::unpack( ds, block_num );
+      chain_state& state = _recovered;
+      if( which.value == stream_message::tag<applied_block_message>::value )
+      {
+         block_id_type id;
+         fc::raw::unpack( ds, id );
+         seg.blocks.emplace( block_num, pos );
+         state.reversible.erase( state.reversible.lower_bound( block_num ), state.reversible.end() );
+         state.reversible[block_num] = id;
+         state.last_block = block_num;
+      }
+      else if( which.value == stream_message::tag<undo_blocks_message>::value )
+      {
+         state.reversible.erase( state.reversible.lower_bound( block_num ), state.reversible.end() );
+         state.last_block = block_num - 1;
+      }
+      else if( which.value == stream_message::tag<irreversible_message>::value )
+      {
+         state.reversible.erase( state.reversible.begin(), state.reversible.upper_bound( block_num ) );
+         state.last_irreversible = block_num;
+      }
+      pos += sizeof(frame_size) + frame_size;
+   }
+   if( pos < data.size() )
+   {
+      wlog( "Dropping an incomplete message at the end of ${f}", ("f",seg.file) );
+      fc::resize_file( seg.file, pos );
+   }
+   seg.size = pos;
+}
+
+void stream_log::append( const vector<char>& frame, uint32_t block_num, bool applied_block )
+{ try {
+   if( _segments.empty() || ( applied_block && block_num >= _segments.rbegin()->first + _segment_blocks ) )
+   {
+      segment seg;
+      seg.file = _dir / ( fc::to_string( block_num ) + segment_extension );
+      _segments[block_num] = std::move( seg );
+   }
+   const uint32_t key = _segments.rbegin()->first;
+   segment& seg = _segments.rbegin()->second;
+   if( !_writer.is_open() || _writer_segment != key )
+   {
+      if( _writer.is_open() )
+         _writer.close();
+      _writer.open( seg.file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      _writer_segment = key;
+   }
+   _writer.write( frame.data(), frame.size() );
+   _writer.flush();
+   FC_ASSERT( _writer.good(), "Unable to write to ${f}", ("f",seg.file) );
+   if( applied_block )
+      seg.blocks.emplace( block_num, seg.size );
+   seg.size += frame.size();
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+stream_log::cursor stream_log::find( uint32_t block_num )const
+{
+   auto seg = _segments.upper_bound( block_num );
+   if( seg != _segments.begin() )
+      --seg;
+   for( ; seg != _segments.end(); ++seg )
+   {
+      const auto block = seg->second.blocks.lower_bound( block_num );
+      if( block != seg->second.blocks.end() )
+         return cursor{ seg->first, block->second };
+   }
+   return end();
+}
+
+stream_log::cursor stream_log::end()const
+{
+   if( _segments.empty() )
+      return cursor();
+   return cursor{ _segments.rbegin()->first, _segments.rbegin()->second.size };
+}
+
+size_t stream_log::read( cursor& c, char* buffer, size_t max )const
+{
+   if( _segments.empty() )
+      return 0;
+   auto seg = _segments.find( c.segment );
+   if( seg == _segments.end() )
+   {
+      seg = _segments.begin();
+      c = cursor{ seg->first, 0 };
+   }
+   while( c.offset >= seg->second.size )
+   {
+      if( ++seg == _segments.end() )
+         return 0;
+      c = cursor{ seg->first, 0 };
+   }
+   if( !_reader.is_open() || _reader_segment != seg->first )
+   {
+      if( _reader.is_open() )
+         _reader.close();
+      _reader.open( seg->second.file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      _reader_segment = seg->first;
+   }
+   const size_t size = std::min<uint64_t>( max, seg->second.size - c.offset );
+   _reader.clear();
+   _reader.seekg( c.offset );
+   _reader.read( buffer, size );
+   FC_ASSERT( _reader.good(), "Unable to read ${f}", ("f",seg->second.file) );
+   c.offset += size;
+   return size;
+}
+
+void stream_log::prune( uint32_t block_num )
+{
+   while( _segments.size() > 1 && std::next( _segments.begin() )->first <= block_num )
+   {
+      if( _reader_segment == _segments.begin()->first && _reader.is_open() )
+         _reader.close();
+      fc::remove( _segments.begin()->second.file );
+      _segments.erase( _segments.begin() );
+   }
+}
+
+uint32_t stream_log::first_block()const
+{
+   return _segments.empty() ? 0 : _segments.begin()->first;
+}
+
+} } // graphene::block_stream
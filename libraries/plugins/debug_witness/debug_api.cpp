@@ -26,8 +26,13 @@ class debug_api_impl
       void debug_push_blocks( const std::string& src_filename, uint32_t count );
       void debug_generate_blocks( const std::string& debug_key, uint32_t count );
       void debug_update_object( const fc::variant_object& update );
+      graphene::chain::simulation_result debug_simulate( const graphene::chain::simulation_request& request );
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
+      std::vector< graphene::db::index_memory_usage > debug_get_index_memory_usage();
+      void debug_enable_operation_timing( bool enable );
+      void debug_reset_operation_timing();
+      std::map< std::string, graphene::chain::operation_timing > debug_get_operation_timing();
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
 
       graphene::app::application& app;
@@ -104,6 +109,11 @@ void debug_api_impl::debug_update_object( const fc::variant_object& update )
    db->debug_update( update );
 }
 
+graphene::chain::simulation_result debug_api_impl::debug_simulate( const graphene::chain::simulation_request& request )
+{
+   return app.chain_database()->simulate( request );
+}
+
 std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > debug_api_impl::get_plugin()
 {
    return app.get_plugin< graphene::debug_witness_plugin::debug_witness_plugin >( "debug_witness" );
@@ -119,6 +129,48 @@ void debug_api_impl::debug_stream_json_objects_flush()
    get_plugin()->flush_json_object_stream();
 }
 
+std::vector< graphene::db::index_memory_usage > debug_api_impl::debug_get_index_memory_usage()
+{
+   return app.chain_database()->get_memory_usage();
+}
+
+void debug_api_impl::debug_enable_operation_timing( bool enable )
+{
+   app.chain_database()->enable_operation_timing( enable );
+}
+
+void debug_api_impl::debug_reset_operation_timing()
+{
+   app.chain_database()->reset_operation_timing();
+}
+
+struct operation_name_visitor
+{
+   typedef std::string result_type;
+   template<typename T>
+   std::string operator()( const T& )const
+   {
+      std::string name = fc::get_typename<T>::name();
+      auto pos = name.rfind( "::" );
+      return pos == std::string::npos ? name : name.substr( pos + 2 );
+   }
+};
+
+std::map< std::string, graphene::chain::operation_timing > debug_api_impl::debug_get_operation_timing()
+{
+   std::map< std::string, graphene::chain::operation_timing > result;
+   const auto& timing = app.chain_database()->get_operation_timing();
+   for( size_t tag = 0; tag < timing.size(); ++tag )
+   {
+      if( timing[tag].count == 0 )
+         continue;
+      graphene::chain::operation op;
+      op.set_which( tag );
+      result[ op.visit( operation_name_visitor() ) ] = timing[tag];
+   }
+   return result;
+}
+
 } // detail
 
 debug_api::debug_api( graphene::app::application& app )
@@ -141,6 +193,11 @@ void debug_api::debug_update_object( fc::variant_object update )
    my->debug_update_object( update );
 }
 
+graphene::chain::simulation_result debug_api::debug_simulate( graphene::chain::simulation_request request )
+{
+   return my->debug_simulate( request );
+}
+
 void debug_api::debug_stream_json_objects( std::string filename )
 {
    my->debug_stream_json_objects( filename );
@@ -151,5 +208,25 @@ void debug_api::debug_stream_json_objects_flush()
    my->debug_stream_json_objects_flush();
 }
 
+std::vector< graphene::db::index_memory_usage > debug_api::debug_get_index_memory_usage()
+{
+   return my->debug_get_index_memory_usage();
+}
+
+void debug_api::debug_enable_operation_timing( bool enable )
+{
+   my->debug_enable_operation_timing( enable );
+}
+
+void debug_api::debug_reset_operation_timing()
+{
+   my->debug_reset_operation_timing();
+}
+
+std::map< std::string, graphene::chain::operation_timing > debug_api::debug_get_operation_timing()
+{
+   return my->debug_get_operation_timing();
+}
+
 
 } } // graphene::debug_witness
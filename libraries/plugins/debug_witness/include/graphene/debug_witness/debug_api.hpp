@@ -26,6 +26,9 @@
 #include <memory>
 #include <string>
 
+#include <graphene/chain/database.hpp>
+#include <graphene/db/index.hpp>
+
 #include <fc/api.hpp>
 #include <fc/variant_object.hpp>
 
@@ -59,6 +62,13 @@ class debug_api
        */
       void debug_update_object( fc::variant_object update );
 
+      /**
+       * Apply object updates, transactions and blocks to a copy-on-write fork of the current state, without
+       * disturbing the live chain.  The fork is discarded before returning.
+       * @return the applied transactions and blocks, the operations they caused and the objects they changed
+       */
+      graphene::chain::simulation_result debug_simulate( graphene::chain::simulation_request request );
+
       /**
        * Start a node with given initial path.
        */
@@ -82,6 +92,27 @@ class debug_api
        */
       void debug_stream_json_objects_flush();
 
+      /**
+       * Estimate the memory used by every object index. This walks all objects and may take a while.
+       */
+      std::vector< graphene::db::index_memory_usage > debug_get_index_memory_usage();
+
+      /**
+       * Start or stop measuring the evaluators of every operation type, starting clears the measurements.
+       */
+      void debug_enable_operation_timing( bool enable );
+
+      /**
+       * Clear the measurements of debug_enable_operation_timing().
+       */
+      void debug_reset_operation_timing();
+
+      /**
+       * @return the measurements of every operation type that was applied since the timing was started or reset,
+       *         by operation name
+       */
+      std::map< std::string, graphene::chain::operation_timing > debug_get_operation_timing();
+
       std::shared_ptr< detail::debug_api_impl > my;
 };
 
@@ -91,6 +122,11 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_push_blocks)
        (debug_generate_blocks)
        (debug_update_object)
+       (debug_simulate)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
+       (debug_get_index_memory_usage)
+       (debug_enable_operation_timing)
+       (debug_reset_operation_timing)
+       (debug_get_operation_timing)
      )
@@ -31,6 +31,8 @@
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/api.hpp>
 
+#include <deque>
+
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
 
@@ -40,9 +42,17 @@ struct delayed_node_plugin_impl {
    fc::http::websocket_client client;
    std::shared_ptr<fc::rpc::websocket_api_connection> client_connection;
    fc::api<graphene::app::database_api> database_api;
+   /** set if the trusted node grants us its block_api, blocks are then fetched in packed batches */
+   fc::optional< fc::api<graphene::app::block_api> > block_api;
    boost::signals2::scoped_connection client_connection_closed;
    graphene::chain::block_id_type last_received_remote_head;
    graphene::chain::block_id_type last_processed_remote_head;
+   /// blocks per get_raw_blocks() call
+   uint32_t batch_size = 1000;
+   /// get_block() calls in flight without block_api
+   uint32_t request_window = 50;
+   /// blocks precomputed ahead of the one being pushed
+   size_t precompute_window = 32;
 };
 }
 
@@ -57,6 +67,8 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
 {
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>(), "RPC endpoint of a trusted validating node (required for delayed_node)")
+         ("delayed-node-request-window", boost::program_options::value<uint32_t>()->default_value(50),
+          "Blocks requested at once from a trusted node that does not grant block_api access")
          ;
    cfg.add(cli);
 }
@@ -65,6 +77,19 @@ void delayed_node_plugin::connect()
 {
    my->client_connection = std::make_shared<fc::rpc::websocket_api_connection>(*my->client.connect(my->remote_endpoint), GRAPHENE_NET_MAX_NESTED_OBJECTS);
    my->database_api = my->client_connection->get_remote_api<graphene::app::database_api>(0);
+   my->block_api.reset();
+   try
+   {
+      auto login = my->client_connection->get_remote_api<graphene::app::login_api>(1);
+      if( login->login( "", "" ) )
+         my->block_api = login->block();
+   }
+   catch( const fc::exception& )
+   {
+      my->block_api.reset();
+   }
+   if( !my->block_api )
+      ilog( "Trusted node does not grant block_api access, fetching blocks one at a time" );
    my->client_connection_closed = my->client_connection->closed.connect([this] {
       connection_failed();
    });
@@ -75,6 +100,44 @@ void delayed_node_plugin::plugin_initialize(const boost::program_options::variab
    FC_ASSERT(options.count("trusted-node") > 0);
    my = std::unique_ptr<detail::delayed_node_plugin_impl>{ new detail::delayed_node_plugin_impl() };
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   if( options.count("delayed-node-request-window") )
+      my->request_window = std::max<uint32_t>( 1, options.at("delayed-node-request-window").as<uint32_t>() );
+}
+
+void delayed_node_plugin::push_blocks( const vector<graphene::chain::signed_block>& blocks )
+{
+   // the precomputation waits for its workers, which lets the pushes run in between
+   auto& db = database();
+   std::deque< fc::future<void> > precomputing;
+   size_t next = 0;
+   try
+   {
+      for( size_t i = 0; i < blocks.size(); ++i )
+      {
+         for( ; next < blocks.size() && next < i + my->precompute_window; ++next )
+         {
+            const graphene::chain::signed_block& block = blocks[next];
+            precomputing.push_back( fc::async( [&db,&block] () {
+               db.precompute_parallel( block, graphene::chain::database::skip_nothing ).wait();
+            }, "delayed_node precompute" ) );
+         }
+         fc::future<void> precomputed = precomputing.front();
+         precomputing.pop_front();
+         precomputed.wait();
+         if( i == 0 || i + 1 == blocks.size() || blocks[i].block_num() % 1000 == 0 )
+            ilog( "Pushing block #${n}", ("n", blocks[i].block_num()) );
+         db.push_block( blocks[i] );
+      }
+   }
+   catch( const fc::exception& )
+   {
+      // the remaining tasks refer to the blocks
+      for( auto& task : precomputing )
+      {
+         try { task.wait(); } catch( const fc::exception& ) {}
+      }
+      throw;
+   }
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -98,15 +161,56 @@ void delayed_node_plugin::sync_with_trusted_node()
          break;
       }
       pass_count++;
-      while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
+      const uint32_t last_block = remote_dpo.last_irreversible_block_num;
+
+      if( my->block_api )
       {
-         fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
-         // TODO: during sync, decouple requesting blocks from preprocessing + applying them
-         FC_ASSERT(block, "Trusted node claims it has blocks it doesn't actually have.");
-         ilog("Pushing block #${n}", ("n", block->block_num()));
-         db.precompute_parallel( *block, graphene::chain::database::skip_nothing ).wait();
-         db.push_block(*block);
-         synced_blocks++;
+         // the next batch is on its way while the current one is pushed
+         auto request = [this,last_block]( uint32_t first ) {
+            const uint32_t count = std::min<uint32_t>( my->batch_size, last_block - first + 1 );
+            const fc::api<graphene::app::block_api> api = *my->block_api;
+            return fc::async( [api,first,count] () { return api->get_raw_blocks( first, count ); },
+                              "delayed_node fetch" );
+         };
+         fc::future< vector<vector<char>> > next_batch = request( db.head_block_num() + 1 );
+         while( next_batch.valid() )
+         {
+            const vector<vector<char>> raw_blocks = next_batch.wait();
+            FC_ASSERT( !raw_blocks.empty(), "Trusted node claims it has blocks it doesn't actually have." );
+            const uint32_t following = db.head_block_num() + 1 + raw_blocks.size();
+            next_batch = following <= last_block ? request( following ) : fc::future< vector<vector<char>> >();
+            vector<graphene::chain::signed_block> blocks;
+            blocks.reserve( raw_blocks.size() );
+            for( const vector<char>& raw : raw_blocks )
+               blocks.push_back( fc::raw::unpack<graphene::chain::signed_block>( raw ) );
+            push_blocks( blocks );
+            synced_blocks += blocks.size();
+         }
+         continue;
+      }
+
+      // one block per call, but a window of calls in flight
+      while( last_block > db.head_block_num() )
+      {
+         const uint32_t first = db.head_block_num() + 1;
+         const uint32_t count = std::min<uint32_t>( my->request_window, last_block - first + 1 );
+         vector< fc::future< fc::optional<graphene::chain::signed_block> > > requests;
+         requests.reserve( count );
+         for( uint32_t num = first; num < first + count; ++num )
+         {
+            const fc::api<graphene::app::database_api> api = my->database_api;
+            requests.push_back( fc::async( [api,num] () { return api->get_block( num ); }, "delayed_node fetch" ) );
+         }
+         vector<graphene::chain::signed_block> blocks;
+         blocks.reserve( count );
+         for( auto& request : requests )
+         {
+            fc::optional<graphene::chain::signed_block> block = request.wait();
+            FC_ASSERT( block, "Trusted node claims it has blocks it doesn't actually have." );
+            blocks.push_back( std::move( *block ) );
+         }
+         push_blocks( blocks );
+         synced_blocks += blocks.size();
       }
    }
 }
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/app/plugin.hpp>
+#include <graphene/chain/protocol/block.hpp>
 
 namespace graphene { namespace delayed_node {
 namespace detail { struct delayed_node_plugin_impl; }
@@ -46,6 +47,8 @@ protected:
    void connection_failed();
    void connect();
    void sync_with_trusted_node();
+   /// pushes blocks in order, precomputing the ones after the block being pushed
+   void push_blocks( const std::vector<graphene::chain::signed_block>& blocks );
 };
 
 } } //graphene::account_history
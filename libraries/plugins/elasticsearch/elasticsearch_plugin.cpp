@@ -23,16 +23,20 @@
  */
 
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
-#include <graphene/chain/impacted.hpp>
 #include <graphene/chain/account_evaluator.hpp>
+#include <graphene/app/json_writer.hpp>
 #include <curl/curl.h>
 #include <graphene/utilities/elasticsearch.hpp>
+#include <fc/string.hpp>
 
 namespace graphene { namespace elasticsearch {
 
 namespace detail
 {
 
+/// the bulk structs are written the way fc::json::to_string() with the legacy generator writes them
+using graphene::app::json_writer;
+
 class elasticsearch_plugin_impl
 {
    public:
@@ -59,20 +63,34 @@ class elasticsearch_plugin_impl
       std::string _elasticsearch_index_prefix = "bitshares-";
       bool _elasticsearch_operation_object = false;
       uint32_t _elasticsearch_start_es_after_block = 0;
+      uint32_t _elasticsearch_max_queued_bulks = 16;
+      uint32_t _elasticsearch_concurrent_bulks = 1;
+      bool _elasticsearch_compress_bulks = false;
+      fc::path _elasticsearch_checkpoint_file;
+      uint32_t _saved_block = 0;
+      std::unique_ptr<graphene::utilities::BulkSender> _sender;
       CURL *curl; // curl handler
       vector <string> bulk_lines; //  vector of op lines
-      vector<std::string> prepare;
 
-      graphene::utilities::ES es;
       uint32_t limit_documents;
       int16_t op_type;
       operation_history_struct os;
       block_struct bs;
       visitor_struct vs;
-      bulk_struct bulk_line_struct;
       std::string bulk_line;
+      /// the members of the bulk lines of the current operation that are the same for every impacted account
+      std::string operation_json;
+      std::string block_json;
       std::string index_name;
       bool is_sync = false;
+
+      /**
+       * hands bulk_lines to _sender, which sends them while the next bulk is collected
+       * @param complete_block the last block all documents of which are in bulk_lines or were sent before
+       */
+      void sendBulk(uint32_t complete_block);
+      /// writes the last block elasticsearch acknowledged to the checkpoint file, if it moved on
+      void saveCheckpoint();
    private:
       bool add_elasticsearch( const account_id_type account_id, const optional<operation_history_object>& oho, const uint32_t block_number );
       const account_transaction_history_object& addNewEntry(const account_statistics_object& stats_obj,
@@ -86,9 +104,9 @@ class elasticsearch_plugin_impl
       void doVisitor(const optional <operation_history_object>& oho);
       void checkState(const fc::time_point_sec& block_time);
       void cleanObjects(const account_transaction_history_id_type& ath, const account_id_type& account_id);
+      void writeOperationJson();
       void createBulkLine(const account_transaction_history_object& ath);
       void prepareBulk(const account_transaction_history_id_type& ath_id);
-      void populateESstruct();
 };
 
 elasticsearch_plugin_impl::~elasticsearch_plugin_impl()
@@ -113,7 +131,8 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
       else
          _oho_index->use_next_id();
    };
-   for( const optional< operation_history_object >& o_op : hist ) {
+   for( uint32_t op_id = 0; op_id < hist.size(); ++op_id ) {
+      const optional< operation_history_object >& o_op = hist[op_id];
       optional <operation_history_object> oho;
 
       auto create_oho = [&]() {
@@ -144,22 +163,11 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
       doBlock(oho->trx_in_block, b);
       if(_elasticsearch_visitor)
          doVisitor(oho);
-
-      const operation_history_object& op = *o_op;
+      if(b.block_num() > _elasticsearch_start_es_after_block)
+         writeOperationJson();
 
       // get the set of accounts this operation applies to
-      flat_set<account_id_type> impacted;
-      vector<authority> other;
-      operation_get_required_authorities( op.op, impacted, impacted, other ); // fee_payer is added here
-
-      if( op.op.which() == operation::tag< account_create_operation >::value )
-         impacted.insert( op.result.get<object_id_type>() );
-      else
-         graphene::chain::operation_get_impacted_accounts( op.op, impacted );
-
-      for( auto& a : other )
-         for( auto& item : a.account_auths )
-            impacted.insert( item.first );
+      const flat_set<account_id_type>& impacted = db.get_applied_operation_impacted_accounts( op_id );
 
       for( auto& account_id : impacted )
       {
@@ -170,14 +178,9 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
    // we send bulk at end of block when we are in sync for better real time client experience
    if(is_sync)
    {
-      populateESstruct();
-      if(es.bulk_lines.size() > 0)
+      if(bulk_lines.size() > 0)
       {
-         prepare.clear();
-         if(!graphene::utilities::SendBulk(std::move(es)))
-            return false;
-         else
-            bulk_lines.clear();
+         sendBulk(b.block_num());
       }
    }
 
@@ -239,7 +242,7 @@ void elasticsearch_plugin_impl::doVisitor(const optional <operation_history_obje
    graphene::chain::database& db = database();
 
    operation_visitor o_v;
-   oho->op.visit(o_v);
+   table_visit( oho->op, o_v );
 
    auto fee_asset = o_v.fee_asset(db);
    vs.fee_data.asset = o_v.fee_asset;
@@ -289,12 +292,7 @@ bool elasticsearch_plugin_impl::add_elasticsearch( const account_id_type account
    cleanObjects(ath.id, account_id);
 
    if (curl && bulk_lines.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
-      prepare.clear();
-      populateESstruct();
-      if(!graphene::utilities::SendBulk(std::move(es)))
-         return false;
-      else
-         bulk_lines.clear();
+      sendBulk(block_number - 1);
    }
 
    return true;
@@ -318,6 +316,7 @@ const account_transaction_history_object& elasticsearch_plugin_impl::addNewEntry
       obj.account = account_id;
       obj.sequence = stats_obj.total_ops + 1;
       obj.next = stats_obj.most_recent_op;
+      obj.operation_type = oho->op.which();
    });
 
    return ath;
@@ -333,29 +332,98 @@ void elasticsearch_plugin_impl::growStats(const account_statistics_object& stats
    });
 }
 
+void elasticsearch_plugin_impl::writeOperationJson()
+{
+   operation_json.clear();
+   json_writer op( operation_json, fc::json::legacy_generator );
+   op.key("operation_history").begin_object()
+        .key("trx_in_block").value(int64_t(os.trx_in_block))
+        .key("op_in_trx").value(int64_t(os.op_in_trx))
+        .key("operation_result").value(os.operation_result)
+        .key("virtual_op").value(int64_t(os.virtual_op))
+        .key("op").value(os.op)
+        .key("op_object").raw(fc::json::to_string(os.op_object, fc::json::legacy_generator))
+     .end_object()
+     .key("operation_type").value(int64_t(op_type));
+
+   block_json.clear();
+   json_writer block( block_json, fc::json::legacy_generator );
+   block.key("block_data").begin_object()
+           .key("block_num").value(int64_t(bs.block_num))
+           .key("block_time").value(bs.block_time)
+           .key("trx_id").value(bs.trx_id)
+        .end_object()
+        .key("additional_data");
+   if(!_elasticsearch_visitor)
+   {
+      block.null();
+      return;
+   }
+   block.begin_object()
+      .key("fee_data").begin_object()
+         .key("asset").value(vs.fee_data.asset)
+         .key("asset_name").value(vs.fee_data.asset_name)
+         .key("amount").value(vs.fee_data.amount)
+         .key("amount_units").value(vs.fee_data.amount_units)
+      .end_object()
+      .key("transfer_data").begin_object()
+         .key("asset").value(vs.transfer_data.asset)
+         .key("asset_name").value(vs.transfer_data.asset_name)
+         .key("amount").value(vs.transfer_data.amount)
+         .key("amount_units").value(vs.transfer_data.amount_units)
+         .key("from").value(vs.transfer_data.from)
+         .key("to").value(vs.transfer_data.to)
+      .end_object()
+      .key("fill_data").begin_object()
+         .key("order_id").value(vs.fill_data.order_id)
+         .key("account_id").value(vs.fill_data.account_id)
+         .key("pays_asset_id").value(vs.fill_data.pays_asset_id)
+         .key("pays_asset_name").value(vs.fill_data.pays_asset_name)
+         .key("pays_amount").value(vs.fill_data.pays_amount)
+         .key("pays_amount_units").value(vs.fill_data.pays_amount_units)
+         .key("receives_asset_id").value(vs.fill_data.receives_asset_id)
+         .key("receives_asset_name").value(vs.fill_data.receives_asset_name)
+         .key("receives_amount").value(vs.fill_data.receives_amount)
+         .key("receives_amount_units").value(vs.fill_data.receives_amount_units)
+         .key("fill_price").value(vs.fill_data.fill_price)
+         .key("fill_price_units").value(vs.fill_data.fill_price_units)
+         .key("is_maker").value(vs.fill_data.is_maker)
+      .end_object()
+   .end_object();
+}
+
 void elasticsearch_plugin_impl::createBulkLine(const account_transaction_history_object& ath)
 {
-   bulk_line_struct.account_history = ath;
-   bulk_line_struct.operation_history = os;
-   bulk_line_struct.operation_type = op_type;
-   bulk_line_struct.operation_id_num = ath.operation_id.instance.value;
-   bulk_line_struct.block_data = bs;
-   if(_elasticsearch_visitor)
-      bulk_line_struct.additional_data = vs;
-   bulk_line = fc::json::to_string(bulk_line_struct, fc::json::legacy_generator);
+   // the fields of bulk_struct, in its order
+   bulk_line.clear();
+   json_writer line( bulk_line, fc::json::legacy_generator );
+   line.begin_object()
+      .key("account_history").begin_object()
+         .key("id").value(ath.id)
+         .key("account").value(ath.account)
+         .key("operation_id").value(ath.operation_id)
+         .key("sequence").value(ath.sequence)
+         .key("next").value(ath.next)
+      .end_object()
+      .raw(operation_json)
+      .key("operation_id_num").value(int64_t(int(ath.operation_id.instance.value)))
+      .raw(block_json)
+   .end_object();
 }
 
 void elasticsearch_plugin_impl::prepareBulk(const account_transaction_history_id_type& ath_id)
 {
-   const std::string _id = fc::json::to_string(ath_id);
-   fc::mutable_variant_object bulk_header;
-   bulk_header["_index"] = index_name;
-   bulk_header["_type"] = "data";
-   bulk_header["_id"] = fc::to_string(ath_id.space_id) + "." + fc::to_string(ath_id.type_id) + "."
-                      + fc::to_string(ath_id.instance.value);
-   prepare = graphene::utilities::createBulk(bulk_header, std::move(bulk_line));
-   std::move(prepare.begin(), prepare.end(), std::back_inserter(bulk_lines));
-   prepare.clear();
+   std::string header;
+   json_writer writer( header, fc::json::legacy_generator );
+   writer.begin_object().key("index").begin_object()
+            .key("_index").value(index_name)
+            .key("_type").value(std::string("data"))
+            .key("_id").value(ath_id)
+         .end_object()
+      .end_object();
+   bulk_lines.push_back(std::move(header));
+   bulk_lines.push_back(std::move(bulk_line));
+   bulk_line.clear();
 }
 
 void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_id_type& ath_id, const account_id_type& account_id)
@@ -387,15 +455,27 @@ void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_i
    }
 }
 
-void elasticsearch_plugin_impl::populateESstruct()
+void elasticsearch_plugin_impl::sendBulk(uint32_t complete_block)
 {
-   es.curl = curl;
-   es.bulk_lines = std::move(bulk_lines);
-   es.elasticsearch_url = _elasticsearch_node_url;
-   es.auth = _elasticsearch_basic_auth;
-   es.index_prefix = _elasticsearch_index_prefix;
-   es.endpoint = "";
-   es.query = "";
+   if(!_sender)
+      _sender.reset(new graphene::utilities::BulkSender(_elasticsearch_node_url, _elasticsearch_basic_auth,
+                                                         _elasticsearch_max_queued_bulks,
+                                                         _elasticsearch_concurrent_bulks,
+                                                         _elasticsearch_compress_bulks));
+   _sender->send(std::move(bulk_lines), complete_block);
+   bulk_lines.clear();
+   saveCheckpoint();
+}
+
+void elasticsearch_plugin_impl::saveCheckpoint()
+{
+   if(_elasticsearch_checkpoint_file.empty() || !_sender)
+      return;
+   const uint32_t acknowledged = _sender->acknowledged_block();
+   if(acknowledged <= _saved_block)
+      return;
+   graphene::utilities::saveLastBlock(_elasticsearch_checkpoint_file, acknowledged);
+   _saved_block = acknowledged;
 }
 
 } // end namespace detail
@@ -432,6 +512,11 @@ void elasticsearch_plugin::plugin_set_program_options(
          ("elasticsearch-index-prefix", boost::program_options::value<std::string>(), "Add a prefix to the index(bitshares-)")
          ("elasticsearch-operation-object", boost::program_options::value<bool>(), "Save operation as object(false)")
          ("elasticsearch-start-es-after-block", boost::program_options::value<uint32_t>(), "Start doing ES job after block(0)")
+         ("elasticsearch-max-queued-bulks", boost::program_options::value<uint32_t>(), "Number of bulks that may wait to be sent before block processing waits for elasticsearch(16)")
+         ("elasticsearch-concurrent-bulks", boost::program_options::value<uint32_t>(), "Number of bulk requests sent to elasticsearch at the same time(1)")
+         ("elasticsearch-compress-bulks", boost::program_options::value<bool>(), "Send bulk requests gzip compressed, elasticsearch needs http.compression enabled(false)")
+         ("elasticsearch-checkpoint-file", boost::program_options::value<std::string>(),
+          "File to keep the last block acknowledged by elasticsearch in, indexing resumes after it on restart('')")
          ;
    cfg.add(cli);
 }
@@ -469,7 +554,26 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
    }
    if (options.count("elasticsearch-start-es-after-block")) {
       my->_elasticsearch_start_es_after_block = options["elasticsearch-start-es-after-block"].as<uint32_t>();
-   }   
+   }
+   if (options.count("elasticsearch-max-queued-bulks")) {
+      my->_elasticsearch_max_queued_bulks = options["elasticsearch-max-queued-bulks"].as<uint32_t>();
+   }
+   if (options.count("elasticsearch-concurrent-bulks")) {
+      my->_elasticsearch_concurrent_bulks = options["elasticsearch-concurrent-bulks"].as<uint32_t>();
+   }
+   if (options.count("elasticsearch-compress-bulks")) {
+      my->_elasticsearch_compress_bulks = options["elasticsearch-compress-bulks"].as<bool>();
+   }
+   if (options.count("elasticsearch-checkpoint-file")) {
+      my->_elasticsearch_checkpoint_file = options["elasticsearch-checkpoint-file"].as<std::string>();
+      // documents are indexed by account history id, indexing a block again overwrites them
+      my->_saved_block = graphene::utilities::loadLastBlock(my->_elasticsearch_checkpoint_file);
+      if(my->_saved_block > my->_elasticsearch_start_es_after_block)
+      {
+         ilog("Elasticsearch acknowledged blocks up to ${b}, resuming after it", ("b", my->_saved_block));
+         my->_elasticsearch_start_es_after_block = my->_saved_block;
+      }
+   }
 }
 
 void elasticsearch_plugin::plugin_startup()
@@ -484,4 +588,21 @@ void elasticsearch_plugin::plugin_startup()
    ilog("elasticsearch ACCOUNT HISTORY: plugin_startup() begin");
 }
 
+void elasticsearch_plugin::plugin_shutdown()
+{
+   if(my->curl && !my->bulk_lines.empty())
+      my->sendBulk(database().head_block_num());
+   if(my->_sender && !my->_sender->flush(fc::seconds(30)))
+      elog("Elasticsearch did not take the last ${n} bulks in time", ("n", my->_sender->queued()));
+   my->saveCheckpoint();
+   my->_sender.reset();
+}
+
+std::map<std::string, uint64_t> elasticsearch_plugin::get_queue_depths()const
+{
+   std::map<std::string, uint64_t> depths;
+   depths["bulks"] = my->_sender ? my->_sender->queued() : 0;
+   return depths;
+}
+
 } }
@@ -62,18 +62,23 @@ class es_objects_plugin_impl
       bool _es_objects_asset_bitasset = true;
       std::string _es_objects_index_prefix = "objects-";
       uint32_t _es_objects_start_es_after_block = 0;
+      fc::path _es_objects_checkpoint_file;
+      uint32_t _saved_block = 0;
       CURL *curl; // curl handler
       vector <std::string> bulk;
       vector<std::string> prepare;
 
       bool _es_objects_keep_only_current = true;
+      bool _es_objects_partial_updates = false;
 
       uint32_t block_number;
       fc::time_point_sec block_time;
 
    private:
       template<typename T>
-      void prepareTemplate(T blockchain_object, string index_name);
+      void prepareTemplate(const T& blockchain_object, string index_name, bool is_update);
+      /// @return the value the changed object had before the head block, null if it is unknown
+      fc::variant getOldValue(const object_id_type& id);
 };
 
 bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids, std::string action)
@@ -101,7 +106,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(p->id, "proposal");
                else
-                  prepareTemplate<proposal_object>(*p, "proposal");
+                  prepareTemplate<proposal_object>(*p, "proposal", action == "update");
             }
          } else if (value.is<account_object>() && _es_objects_accounts) {
             auto obj = db.find_object(value);
@@ -110,7 +115,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(a->id, "account");
                else
-                  prepareTemplate<account_object>(*a, "account");
+                  prepareTemplate<account_object>(*a, "account", action == "update");
             }
          } else if (value.is<asset_object>() && _es_objects_assets) {
             auto obj = db.find_object(value);
@@ -119,7 +124,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(a->id, "asset");
                else
-                  prepareTemplate<asset_object>(*a, "asset");
+                  prepareTemplate<asset_object>(*a, "asset", action == "update");
             }
          } else if (value.is<account_balance_object>() && _es_objects_balances) {
             auto obj = db.find_object(value);
@@ -128,7 +133,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(b->id, "balance");
                else
-                  prepareTemplate<account_balance_object>(*b, "balance");
+                  prepareTemplate<account_balance_object>(*b, "balance", action == "update");
             }
          } else if (value.is<limit_order_object>() && _es_objects_limit_orders) {
             auto obj = db.find_object(value);
@@ -137,7 +142,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(l->id, "limitorder");
                else
-                  prepareTemplate<limit_order_object>(*l, "limitorder");
+                  prepareTemplate<limit_order_object>(*l, "limitorder", action == "update");
             }
          } else if (value.is<asset_bitasset_data_object>() && _es_objects_asset_bitasset) {
             auto obj = db.find_object(value);
@@ -146,7 +151,7 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
                if (action == "delete")
                   remove_from_database(ba->id, "bitasset");
                else
-                  prepareTemplate<asset_bitasset_data_object>(*ba, "bitasset");
+                  prepareTemplate<asset_bitasset_data_object>(*ba, "bitasset", action == "update");
             }
          }
       }
@@ -163,6 +168,12 @@ bool es_objects_plugin_impl::index_database( const vector<object_id_type>& ids,
             return false;
          else
             bulk.clear();
+
+         // the objects of the head block come in several notifications, the ones before it are complete
+         if (!_es_objects_checkpoint_file.empty() && block_number - 1 > _saved_block) {
+            graphene::utilities::saveLastBlock(_es_objects_checkpoint_file, block_number - 1);
+            _saved_block = block_number - 1;
+         }
       }
    }
 
@@ -185,8 +196,26 @@ void es_objects_plugin_impl::remove_from_database( object_id_type id, std::strin
    }
 }
 
+fc::variant es_objects_plugin_impl::getOldValue(const object_id_type& id)
+{
+   graphene::chain::database &db = _self.database();
+   // changed_objects is only notified while the undo database records the head block
+   const auto& head = db._undo_db.head();
+   auto itr = head.old_values.find(id);
+   if(itr != head.old_values.end())
+      return itr->second->to_variant();
+   auto packed_itr = head.packed_old_values.find(id);
+   if(packed_itr != head.packed_old_values.end())
+   {
+      unique_ptr<object> old_value = db.get_object(id).clone();
+      old_value->unpack_from(packed_itr->second);
+      return old_value->to_variant();
+   }
+   return fc::variant();
+}
+
 template<typename T>
-void es_objects_plugin_impl::prepareTemplate(T blockchain_object, string index_name)
+void es_objects_plugin_impl::prepareTemplate(const T& blockchain_object, string index_name, bool is_update)
 {
    fc::mutable_variant_object bulk_header;
    bulk_header["_index"] = _es_objects_index_prefix + index_name;
@@ -201,6 +230,34 @@ void es_objects_plugin_impl::prepareTemplate(T blockchain_object, string index_n
    fc::to_variant( blockchain_object, blockchain_object_variant, GRAPHENE_NET_MAX_NESTED_OBJECTS );
    fc::mutable_variant_object o = adaptor.adapt(blockchain_object_variant.get_object());
 
+   fc::variant old_value;
+   if(is_update && _es_objects_partial_updates)
+      old_value = getOldValue(blockchain_object.id);
+   if(old_value.is_object())
+   {
+      // send only the fields that changed in the head block, and nothing if none did
+      fc::mutable_variant_object old_o = adaptor.adapt(old_value.get_object());
+      fc::mutable_variant_object doc;
+      for(auto itr = o.begin(); itr != o.end(); ++itr)
+      {
+         auto old_itr = old_o.find(itr->key());
+         if(old_itr == old_o.end() || fc::json::to_string(old_itr->value()) != fc::json::to_string(itr->value()))
+            doc[itr->key()] = itr->value();
+      }
+      if(doc.size() == 0)
+         return;
+      doc["block_time"] = block_time;
+      doc["block_number"] = block_number;
+
+      fc::mutable_variant_object update_line;
+      update_line["update"] = bulk_header;
+      fc::mutable_variant_object body;
+      body["doc"] = doc;
+      bulk.push_back(fc::json::to_string(update_line));
+      bulk.push_back(fc::json::to_string(body, fc::json::legacy_generator));
+      return;
+   }
+
    o["object_id"] = string(blockchain_object.id);
    o["block_time"] = block_time;
    o["block_number"] = block_number;
@@ -255,7 +312,13 @@ void es_objects_plugin::plugin_set_program_options(
          ("es-objects-asset-bitasset", boost::program_options::value<bool>(), "Store feed data(true)")
          ("es-objects-index-prefix", boost::program_options::value<std::string>(), "Add a prefix to the index(objects-)")
          ("es-objects-keep-only-current", boost::program_options::value<bool>(), "Keep only current state of the objects(true)")
+         ("es-objects-partial-updates", boost::program_options::value<bool>(),
+          "Send only the changed fields of changed objects, the objects must have been indexed since their creation. "
+          "Needs es-objects-keep-only-current(false)")
          ("es-objects-start-es-after-block", boost::program_options::value<uint32_t>(), "Start doing ES job after block(0)")
+         ("es-objects-checkpoint-file", boost::program_options::value<std::string>(),
+          "File to keep the last block acknowledged by elasticsearch in, indexing resumes after it on restart. "
+          "Without es-objects-keep-only-current the resumed blocks can be indexed twice('')")
          ;
    cfg.add(cli);
 }
@@ -318,9 +381,22 @@ void es_objects_plugin::plugin_initialize(const boost::program_options::variable
    if (options.count("es-objects-keep-only-current")) {
       my->_es_objects_keep_only_current = options["es-objects-keep-only-current"].as<bool>();
    }
+   if (options.count("es-objects-partial-updates")) {
+      my->_es_objects_partial_updates = options["es-objects-partial-updates"].as<bool>();
+      FC_ASSERT( !my->_es_objects_partial_updates || my->_es_objects_keep_only_current,
+                 "es-objects-partial-updates needs es-objects-keep-only-current" );
+   }
    if (options.count("es-objects-start-es-after-block")) {
       my->_es_objects_start_es_after_block = options["es-objects-start-es-after-block"].as<uint32_t>();
    }
+   if (options.count("es-objects-checkpoint-file")) {
+      my->_es_objects_checkpoint_file = options["es-objects-checkpoint-file"].as<std::string>();
+      my->_saved_block = graphene::utilities::loadLastBlock(my->_es_objects_checkpoint_file);
+      if (my->_saved_block > my->_es_objects_start_es_after_block) {
+         ilog("Elasticsearch acknowledged objects up to block ${b}, resuming after it", ("b", my->_saved_block));
+         my->_es_objects_start_es_after_block = my->_saved_block;
+      }
+   }
 }
 
 void es_objects_plugin::plugin_startup()
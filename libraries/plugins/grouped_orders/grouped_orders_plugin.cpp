@@ -26,6 +26,8 @@
 
 #include <graphene/chain/market_object.hpp>
 
+#include <mutex>
+
 namespace graphene { namespace grouped_orders {
 
 namespace detail
@@ -45,20 +47,31 @@ class grouped_orders_plugin_impl
 
       grouped_orders_plugin&     _self;
       flat_set<uint16_t>         _tracked_groups;
+
+      /// bounds the memory used by requests for many different markets between two changes of the order groups
+      static const size_t max_cached_depths = 10000;
+
+      /// the depths served since the order groups were last changed, shared by all API threads
+      std::mutex                                                     _depth_mutex;
+      uint64_t                                                       _depth_revision = 0;
+      map< std::tuple<uint16_t,asset_id_type,asset_id_type>,
+           std::shared_ptr<const grouped_orders_plugin::market_depth> > _depths;
 };
 
 /**
  *  @brief This secondary index is used to track changes on limit order objects.
  */
-class limit_order_group_index : public secondary_index
+/**
+ * Only serves the API, so it is updated in batches: an order that is filled partially several times within one
+ * transaction or block is moved between groups once.
+ */
+class limit_order_group_index : public batched_secondary_index
 {
    public:
       limit_order_group_index( const flat_set<uint16_t>& groups ) : _tracked_groups( groups ) {};
 
-      virtual void object_inserted( const object& obj ) override;
-      virtual void object_removed( const object& obj ) override;
-      virtual void about_to_modify( const object& before ) override;
-      virtual void object_modified( const object& after  ) override;
+      virtual void object_changed( const object* before, const object* after ) override;
+      virtual bool is_self_contained()const override { return true; }
 
       const flat_set<uint16_t>& get_tracked_groups() const
       { return _tracked_groups; }
@@ -66,7 +79,12 @@ class limit_order_group_index : public secondary_index
       const map< limit_order_group_key, limit_order_group_data >& get_order_groups() const
       { return _og_data; }
 
+      /** changes whenever the order groups do */
+      uint64_t get_revision() const
+      { return _revision; }
+
    private:
+      void insert_order( const limit_order_object& obj );
       void remove_order( const limit_order_object& obj, bool remove_empty = true );
 
       /** tracked groups */
@@ -74,12 +92,22 @@ class limit_order_group_index : public secondary_index
 
       /** maps the group key to group data */
       map< limit_order_group_key, limit_order_group_data > _og_data;
+
+      uint64_t _revision = 0;
 };
 
-void limit_order_group_index::object_inserted( const object& objct )
+void limit_order_group_index::object_changed( const object* before, const object* after )
 { try {
-   const limit_order_object& o = static_cast<const limit_order_object&>( objct );
+   ++_revision;
+   // keep the group of a modified order, as the previous per-change hooks did
+   if( before != nullptr )
+      remove_order( static_cast<const limit_order_object&>( *before ), after == nullptr );
+   if( after != nullptr )
+      insert_order( static_cast<const limit_order_object&>( *after ) );
+} FC_CAPTURE_AND_RETHROW() }
 
+void limit_order_group_index::insert_order( const limit_order_object& o )
+{
    auto& idx = _og_data;
 
    for( uint16_t group : get_tracked_groups() )
@@ -185,24 +213,7 @@ void limit_order_group_index::object_inserted( const object& objct )
          }
       }
    }
-} FC_CAPTURE_AND_RETHROW( (objct) ); }
-
-void limit_order_group_index::object_removed( const object& objct )
-{ try {
-   const limit_order_object& o = static_cast<const limit_order_object&>( objct );
-   remove_order( o );
-} FC_CAPTURE_AND_RETHROW( (objct) ); }
-
-void limit_order_group_index::about_to_modify( const object& objct )
-{ try {
-   const limit_order_object& o = static_cast<const limit_order_object&>( objct );
-   remove_order( o, false );
-} FC_CAPTURE_AND_RETHROW( (objct) ); }
-
-void limit_order_group_index::object_modified( const object& objct )
-{ try {
-   object_inserted( objct );
-} FC_CAPTURE_AND_RETHROW( (objct) ); }
+}
 
 void limit_order_group_index::remove_order( const limit_order_object& o, bool remove_empty )
 {
@@ -300,4 +311,36 @@ const map< limit_order_group_key, limit_order_group_data >& grouped_orders_plugi
    return logidx.get_order_groups();
 }
 
+std::shared_ptr<const grouped_orders_plugin::market_depth> grouped_orders_plugin::get_market_depth(
+      uint16_t group, asset_id_type base, asset_id_type quote )
+{
+   const auto& idx = database().get_index_type< limit_order_index >();
+   const auto& pidx = dynamic_cast<const primary_index< limit_order_index >&>(idx);
+   const auto& logidx = pidx.get_secondary_index< detail::limit_order_group_index >();
+   const auto key = std::make_tuple( group, base, quote );
+
+   std::lock_guard<std::mutex> lock( my->_depth_mutex );
+   if( my->_depth_revision != logidx.get_revision() )
+   {
+      my->_depths.clear();
+      my->_depth_revision = logidx.get_revision();
+   }
+   auto itr = my->_depths.find( key );
+   if( itr != my->_depths.end() )
+      return itr->second;
+
+   const auto& groups = logidx.get_order_groups();
+   auto depth = std::make_shared<market_depth>();
+   auto group_itr = groups.lower_bound( limit_order_group_key( group, price::max( base, quote ) ) );
+   // use an end itrator to try to avoid expensive price comparison
+   auto end = groups.upper_bound( limit_order_group_key( group, price::min( base, quote ) ) );
+   for( ; group_itr != end; ++group_itr )
+      depth->push_back( *group_itr );
+
+   if( my->_depths.size() >= my->max_cached_depths )
+      my->_depths.clear();
+   my->_depths[key] = depth;
+   return depth;
+}
+
 } }
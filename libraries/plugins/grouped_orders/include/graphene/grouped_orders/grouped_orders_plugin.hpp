@@ -84,6 +84,14 @@ class grouped_orders_plugin : public graphene::app::plugin
 
       const map< limit_order_group_key, limit_order_group_data >& limit_order_groups();
 
+      /// the groups of one market, ordered from the best price to the worst
+      typedef vector< std::pair<limit_order_group_key,limit_order_group_data> > market_depth;
+      /**
+       * @return the groups of the given size of the market, computed once after the order groups changed and shared
+       * by all callers until they change again. Safe to call concurrently while the state is locked for reading.
+       */
+      std::shared_ptr<const market_depth> get_market_depth( uint16_t group, asset_id_type base, asset_id_type quote );
+
    private:
       friend class detail::grouped_orders_plugin_impl;
       std::unique_ptr<detail::grouped_orders_plugin_impl> my;
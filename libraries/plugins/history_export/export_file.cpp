@@ -0,0 +1,776 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/history_export/export_file.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/string.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace graphene { namespace history_export {
+
+namespace {
+
+   const uint32_t continuation = 0xFFFFFFFF;
+   /** sanity limit for the metadata of a message, well above what the schema and a record batch need */
+   const uint32_t max_metadata_size = 1024 * 1024;
+
+   template<typename T>
+   void put( std::string& out, const T& value )
+   {
+      out.append( reinterpret_cast<const char*>( &value ), sizeof(T) );
+   }
+
+   template<typename T>
+   T get( const char* data, size_t size, size_t pos )
+   {
+      FC_ASSERT( pos <= size && sizeof(T) <= size - pos, "Export file is truncated" );
+      T value;
+      std::memcpy( &value, data + pos, sizeof(T) );
+      return value;
+   }
+
+   void pad( std::string& out, size_t alignment )
+   {
+      out.append( ( alignment - out.size() % alignment ) % alignment, '\0' );
+   }
+
+   struct fb_table;
+   typedef std::shared_ptr<fb_table> fb_table_ptr;
+
+   /**
+    *  A flatbuffer table to write, as far as the Arrow metadata needs them. Fields are set by slot, scalars by value,
+    *  strings, tables and vectors of tables or structs by what they refer to.
+    */
+   struct fb_table
+   {
+      struct field
+      {
+         enum kind_type { scalar, string, table, tables, structs };
+
+         field( uint16_t s, kind_type k ) : slot( s ), kind( k ), count( 0 ) {}
+
+         uint16_t             slot;
+         kind_type            kind;
+         std::string          bytes;    ///< the scalar, the string or the structs
+         uint32_t             count;    ///< the number of structs
+         vector<fb_table_ptr> children; ///< the table or the tables
+      };
+
+      template<typename T>
+      fb_table& add_scalar( uint16_t slot, T value )
+      {
+         fields.emplace_back( slot, field::scalar );
+         put( fields.back().bytes, value );
+         return *this;
+      }
+      fb_table& add_string( uint16_t slot, const std::string& value )
+      {
+         fields.emplace_back( slot, field::string );
+         fields.back().bytes = value;
+         return *this;
+      }
+      fb_table& add_table( uint16_t slot, fb_table_ptr value )
+      {
+         fields.emplace_back( slot, field::table );
+         fields.back().children.push_back( std::move( value ) );
+         return *this;
+      }
+      fb_table& add_tables( uint16_t slot, vector<fb_table_ptr> values )
+      {
+         fields.emplace_back( slot, field::tables );
+         fields.back().children = std::move( values );
+         return *this;
+      }
+      /** structs holds count structs of 16 bytes, the only structs Arrow metadata uses */
+      fb_table& add_structs( uint16_t slot, std::string structs, uint32_t count )
+      {
+         fields.emplace_back( slot, field::structs );
+         fields.back().bytes = std::move( structs );
+         fields.back().count = count;
+         return *this;
+      }
+
+      vector<field> fields;
+   };
+
+   fb_table_ptr make_table() { return std::make_shared<fb_table>(); }
+
+   /**
+    *  Writes a flatbuffer front to back: each table follows its vtable and is followed by what it refers to, so that
+    *  every offset points forward as flatbuffers require. The buffer must be placed 8 byte aligned.
+    */
+   class fb_writer
+   {
+      public:
+         std::string finish( const fb_table& root )
+         {
+            _out.assign( sizeof(uint32_t), '\0' );
+            patch( 0, write_table( root ) );
+            return std::move( _out );
+         }
+
+      private:
+         size_t write_table( const fb_table& t )
+         {
+            typedef fb_table::field field;
+            // the fields are placed largest first, behind the offset to the vtable
+            vector<const field*> order;
+            uint16_t slots = 0;
+            for( const field& f : t.fields )
+            {
+               order.push_back( &f );
+               slots = std::max<uint16_t>( slots, f.slot + 1 );
+            }
+            const auto inline_size = []( const field* f ) -> size_t {
+               return f->kind == field::scalar ? f->bytes.size() : sizeof(uint32_t);
+            };
+            std::stable_sort( order.begin(), order.end(), [&inline_size]( const field* a, const field* b ) {
+               return inline_size( a ) > inline_size( b );
+            });
+            vector<uint16_t> offsets( slots, 0 );
+            vector<size_t> positions( order.size() );
+            size_t size = sizeof(int32_t);
+            size_t alignment = sizeof(int32_t);
+            for( size_t i = 0; i < order.size(); ++i )
+            {
+               const size_t n = inline_size( order[i] );
+               size += ( n - size % n ) % n;
+               positions[i] = size;
+               offsets[ order[i]->slot ] = uint16_t( size );
+               size += n;
+               alignment = std::max( alignment, n );
+            }
+
+            pad( _out, sizeof(uint16_t) );
+            const size_t vtable = _out.size();
+            put( _out, uint16_t( sizeof(uint16_t) * ( 2 + slots ) ) );
+            put( _out, uint16_t( size ) );
+            for( uint16_t offset : offsets )
+               put( _out, offset );
+
+            pad( _out, alignment );
+            const size_t table = _out.size();
+            std::string inline_part( size, '\0' );
+            const int32_t to_vtable = int32_t( table - vtable );
+            std::memcpy( &inline_part[0], &to_vtable, sizeof(to_vtable) );
+            for( size_t i = 0; i < order.size(); ++i )
+               if( order[i]->kind == field::scalar )
+                  std::memcpy( &inline_part[ positions[i] ], order[i]->bytes.data(), order[i]->bytes.size() );
+            _out += inline_part;
+
+            for( size_t i = 0; i < order.size(); ++i )
+            {
+               const field& f = *order[i];
+               switch( f.kind )
+               {
+                  case field::scalar:
+                     break;
+                  case field::string:
+                     patch( table + positions[i], write_string( f.bytes ) );
+                     break;
+                  case field::table:
+                     patch( table + positions[i], write_table( *f.children.front() ) );
+                     break;
+                  case field::tables:
+                     patch( table + positions[i], write_tables( f.children ) );
+                     break;
+                  case field::structs:
+                     patch( table + positions[i], write_structs( f.bytes, f.count ) );
+                     break;
+               }
+            }
+            return table;
+         }
+
+         size_t write_string( const std::string& s )
+         {
+            pad( _out, sizeof(uint32_t) );
+            const size_t pos = _out.size();
+            put( _out, uint32_t( s.size() ) );
+            _out += s;
+            _out += '\0';
+            return pos;
+         }
+
+         size_t write_tables( const vector<fb_table_ptr>& tables )
+         {
+            pad( _out, sizeof(uint32_t) );
+            const size_t pos = _out.size();
+            put( _out, uint32_t( tables.size() ) );
+            _out.append( tables.size() * sizeof(uint32_t), '\0' );
+            for( size_t i = 0; i < tables.size(); ++i )
+               patch( pos + sizeof(uint32_t) * ( i + 1 ), write_table( *tables[i] ) );
+            return pos;
+         }
+
+         /** the structs are 8 byte aligned, behind their count */
+         size_t write_structs( const std::string& structs, uint32_t count )
+         {
+            _out.append( ( 8 - ( _out.size() + sizeof(uint32_t) ) % 8 ) % 8, '\0' );
+            const size_t pos = _out.size();
+            put( _out, count );
+            _out += structs;
+            return pos;
+         }
+
+         void patch( size_t at, size_t target )
+         {
+            const uint32_t offset = uint32_t( target - at );
+            std::memcpy( &_out[at], &offset, sizeof(offset) );
+         }
+
+         std::string _out;
+   };
+
+   /** Reads a table of a flatbuffer, checking every access against the size of the buffer */
+   class fb_reader
+   {
+      public:
+         fb_reader() : _data( nullptr ), _size( 0 ), _table( 0 ) {}
+         fb_reader( const char* data, size_t size, size_t table ) : _data( data ), _size( size ), _table( table ) {}
+
+         static fb_reader root( const char* data, size_t size )
+         {
+            return fb_reader( data, size, get<uint32_t>( data, size, 0 ) );
+         }
+
+         template<typename T>
+         T scalar( uint16_t slot, T default_value )const
+         {
+            const size_t pos = field( slot );
+            return pos == 0 ? default_value : get<T>( _data, _size, pos );
+         }
+
+         fb_reader table( uint16_t slot )const { return fb_reader( _data, _size, target( slot ) ); }
+
+         std::string string( uint16_t slot )const
+         {
+            const size_t pos = target( slot );
+            const uint32_t length = get<uint32_t>( _data, _size, pos );
+            FC_ASSERT( length <= _size - pos - sizeof(uint32_t), "Export file has an invalid string" );
+            return std::string( _data + pos + sizeof(uint32_t), length );
+         }
+
+         /** @return the number of elements of a vector, 0 if it is not set */
+         uint32_t vector_size( uint16_t slot )const
+         {
+            return field( slot ) == 0 ? 0 : get<uint32_t>( _data, _size, target( slot ) );
+         }
+         fb_reader table_element( uint16_t slot, uint32_t i )const
+         {
+            FC_ASSERT( i < vector_size( slot ) );
+            const size_t pos = target( slot ) + sizeof(uint32_t) * ( i + 1 );
+            return fb_reader( _data, _size, pos + get<uint32_t>( _data, _size, pos ) );
+         }
+         /** @return the two int64 of struct i of a vector of 16 byte structs */
+         std::pair<int64_t,int64_t> struct_element( uint16_t slot, uint32_t i )const
+         {
+            FC_ASSERT( i < vector_size( slot ) );
+            const size_t pos = target( slot ) + sizeof(uint32_t) + 16 * size_t( i );
+            return std::make_pair( get<int64_t>( _data, _size, pos ), get<int64_t>( _data, _size, pos + 8 ) );
+         }
+
+      private:
+         /** @return the position of the field, 0 if it is not set */
+         size_t field( uint16_t slot )const
+         {
+            const size_t vtable = _table - get<int32_t>( _data, _size, _table );
+            const uint16_t vtable_size = get<uint16_t>( _data, _size, vtable );
+            const size_t entry = sizeof(uint16_t) * ( 2 + slot );
+            if( entry >= vtable_size )
+               return 0;
+            const uint16_t offset = get<uint16_t>( _data, _size, vtable + entry );
+            return offset == 0 ? 0 : _table + offset;
+         }
+         /** @return where the offset stored in the field points to */
+         size_t target( uint16_t slot )const
+         {
+            const size_t pos = field( slot );
+            FC_ASSERT( pos != 0, "Export file misses a metadata field" );
+            return pos + get<uint32_t>( _data, _size, pos );
+         }
+
+         const char* _data;
+         size_t      _size;
+         size_t      _table;
+   };
+
+   // the parts of the Arrow format used, see Schema.fbs and Message.fbs of Apache Arrow
+   enum arrow_type : uint8_t { arrow_int = 2, arrow_binary = 4, arrow_timestamp = 10, arrow_list = 12,
+                               arrow_struct = 13 };
+   enum arrow_header : uint8_t { arrow_schema = 1, arrow_record_batch = 3 };
+   const int16_t arrow_metadata_v5 = 4;
+   /** nodes and buffers of a record batch, see append() */
+   const uint32_t batch_nodes = 14;
+   const uint32_t batch_buffers = 28;
+
+   fb_table_ptr arrow_field( const std::string& name, arrow_type type, fb_table_ptr type_table,
+                             vector<fb_table_ptr> children = vector<fb_table_ptr>() )
+   {
+      fb_table_ptr f = make_table();
+      // Arrow readers expect the children, even if there are none
+      f->add_string( 0, name ).add_scalar<uint8_t>( 1, 0 ).add_scalar<uint8_t>( 2, type )
+         .add_table( 3, std::move( type_table ) ).add_tables( 5, std::move( children ) );
+      return f;
+   }
+
+   fb_table_ptr arrow_int_field( const std::string& name, int32_t bits, bool is_signed )
+   {
+      fb_table_ptr type = make_table();
+      type->add_scalar<int32_t>( 0, bits ).add_scalar<uint8_t>( 1, is_signed );
+      return arrow_field( name, arrow_int, type );
+   }
+
+   fb_table_ptr arrow_key_value( const std::string& key, const std::string& value )
+   {
+      fb_table_ptr kv = make_table();
+      kv->add_string( 0, key ).add_string( 1, value );
+      return kv;
+   }
+
+   /** @return the encapsulated message, its metadata padded so that the body starts 8 byte aligned */
+   std::string arrow_message( arrow_header type, fb_table_ptr header, const std::string& body )
+   {
+      fb_table message;
+      message.add_scalar<int16_t>( 0, arrow_metadata_v5 ).add_scalar<uint8_t>( 1, type )
+         .add_table( 2, std::move( header ) ).add_scalar<int64_t>( 3, body.size() );
+      std::string metadata = fb_writer().finish( message );
+      pad( metadata, 8 );
+      std::string result;
+      put( result, continuation );
+      put( result, int32_t( metadata.size() ) );
+      result += metadata;
+      result += body;
+      return result;
+   }
+
+   std::string arrow_schema_message( int64_t op_type, uint32_t first_block, uint32_t last_block )
+   {
+      fb_table_ptr timestamp = make_table();
+      timestamp->add_scalar<int16_t>( 0, 0 ).add_string( 1, "UTC" ); // seconds
+      const fb_table_ptr amount = arrow_field( "item", arrow_struct, make_table(),
+                            { arrow_int_field( "amount", 64, true ), arrow_int_field( "asset", 64, false ) } );
+      const vector<fb_table_ptr> fields{
+         arrow_int_field( "block_num", 32, false ),
+         arrow_field( "block_time", arrow_timestamp, timestamp ),
+         arrow_int_field( "trx_in_block", 16, false ),
+         arrow_int_field( "op_in_trx", 16, false ),
+         arrow_int_field( "virtual_op", 32, false ),
+         arrow_int_field( "fee_amount", 64, true ),
+         arrow_int_field( "fee_asset", 64, false ),
+         arrow_field( "accounts", arrow_list, make_table(), { arrow_int_field( "item", 64, false ) } ),
+         arrow_field( "amounts", arrow_list, make_table(), { amount } ),
+         arrow_field( "op", arrow_binary, make_table() ) };
+
+      fb_table_ptr schema = make_table();
+      schema->add_scalar<int16_t>( 0, 0 ).add_tables( 1, fields ) // little endian
+         .add_tables( 2, { arrow_key_value( "graphene.version", std::to_string( export_file_writer::version ) ),
+                           arrow_key_value( "graphene.op_type", std::to_string( op_type ) ),
+                           arrow_key_value( "graphene.first_block", std::to_string( first_block ) ),
+                           arrow_key_value( "graphene.last_block", std::to_string( last_block ) ) } );
+      return arrow_message( arrow_schema, schema, std::string() );
+   }
+
+   /** A message of an Arrow stream read from memory */
+   struct arrow_stream_message
+   {
+      uint8_t     type = 0;
+      fb_reader   header;
+      const char* body = nullptr;
+      size_t      body_size = 0;
+   };
+
+   /** @return whether there is a message at pos, which it advances to the next one */
+   bool read_arrow_message( const char* data, size_t size, size_t& pos, arrow_stream_message& result )
+   {
+      if( pos == size )
+         return false;
+      FC_ASSERT( get<uint32_t>( data, size, pos ) == continuation, "Export file is not an Arrow stream" );
+      const uint32_t metadata_size = get<uint32_t>( data, size, pos + 4 );
+      // the end of stream marker
+      if( metadata_size == 0 )
+         return false;
+      FC_ASSERT( metadata_size <= max_metadata_size && metadata_size <= size - pos - 8, "Export file is truncated" );
+      const char* metadata = data + pos + 8;
+      const fb_reader message = fb_reader::root( metadata, metadata_size );
+      FC_ASSERT( message.scalar<int16_t>( 0, 0 ) == arrow_metadata_v5, "Unsupported Arrow metadata version" );
+      const int64_t body_size = message.scalar<int64_t>( 3, 0 );
+      pos += 8 + metadata_size;
+      FC_ASSERT( body_size >= 0 && uint64_t( body_size ) <= size - pos, "Export file is truncated" );
+      result.type = message.scalar<uint8_t>( 1, 0 );
+      result.header = message.table( 2 );
+      result.body = data + pos;
+      result.body_size = body_size;
+      pos += body_size;
+      return true;
+   }
+
+   /** takes the operation type and the block range of an export file from its schema */
+   void read_schema( const arrow_stream_message& message, export_file& result, const fc::path& file )
+   {
+      FC_ASSERT( message.type == arrow_schema, "${f} does not start with a schema", ("f",file) );
+      std::map<std::string,std::string> metadata;
+      for( uint32_t i = 0; i < message.header.vector_size( 2 ); ++i )
+      {
+         const fb_reader kv = message.header.table_element( 2, i );
+         metadata[ kv.string( 0 ) ] = kv.string( 1 );
+      }
+      FC_ASSERT( metadata["graphene.version"] == std::to_string( export_file_writer::version ),
+                 "${f} is not an export file of version ${v}", ("f",file)("v",export_file_writer::version) );
+      FC_ASSERT( metadata.count( "graphene.op_type" ) && metadata.count( "graphene.first_block" )
+                    && metadata.count( "graphene.last_block" ), "${f} misses its block range", ("f",file) );
+      FC_ASSERT( message.header.vector_size( 1 ) == 10, "${f} has other columns than expected", ("f",file) );
+      result.op_type = fc::to_int64( metadata["graphene.op_type"] );
+      result.first_block = uint32_t( fc::to_uint64( metadata["graphene.first_block"] ) );
+      result.last_block = uint32_t( fc::to_uint64( metadata["graphene.last_block"] ) );
+   }
+
+   /** the buffers of a record batch, each 8 byte aligned in its body */
+   struct arrow_body
+   {
+      std::string data;
+      std::string buffers;
+      uint32_t    count = 0;
+
+      void add( const std::string& buffer )
+      {
+         put( buffers, int64_t( data.size() ) );
+         put( buffers, int64_t( buffer.size() ) );
+         ++count;
+         data += buffer;
+         pad( data, 8 );
+      }
+      /** a validity buffer, which may be empty without nulls */
+      void add_validity() { add( std::string() ); }
+   };
+
+   /** a buffer of a received record batch */
+   struct arrow_buffer
+   {
+      const char* data;
+      size_t      size;
+
+      template<typename T>
+      T at( size_t i )const
+      {
+         FC_ASSERT( i < size / sizeof(T), "Export file has a short buffer" );
+         T value;
+         std::memcpy( &value, data + i * sizeof(T), sizeof(T) );
+         return value;
+      }
+   };
+
+   struct fee_visitor
+   {
+      typedef asset result_type;
+
+      template<typename T>
+      asset operator()( const T& op )const { return op.fee; }
+   };
+
+   struct name_visitor
+   {
+      typedef std::string result_type;
+
+      template<typename T>
+      std::string operator()( const T& )const
+      {
+         std::string name = fc::get_typename<T>::name();
+         const size_t p = name.rfind(':');
+         return p == std::string::npos ? name : name.substr( p + 1 );
+      }
+   };
+
+   /** collects the asset members of an operation struct, except the fee */
+   template<typename Op>
+   struct amount_collector
+   {
+      const Op&      op;
+      vector<asset>& amounts;
+
+      template<typename Member, class Class, Member (Class::*member)>
+      void operator()( const char* name )const
+      {
+         add( op.*member, name );
+      }
+
+      void add( const asset& a, const char* name )const
+      {
+         if( std::strcmp( name, "fee" ) != 0 )
+            amounts.push_back( a );
+      }
+
+      template<typename T>
+      void add( const T&, const char* )const {}
+   };
+
+   struct amounts_visitor
+   {
+      typedef void result_type;
+
+      vector<asset>& amounts;
+
+      template<typename T>
+      void operator()( const T& op )const
+      {
+         fc::reflector<T>::visit( amount_collector<T>{ op, amounts } );
+      }
+   };
+
+} // anonymous namespace
+
+export_row make_export_row( uint32_t block_num, fc::time_point_sec block_time, uint16_t trx_in_block,
+                            uint16_t op_in_trx, uint32_t virtual_op, const operation& op )
+{
+   export_row row;
+   row.block_num = block_num;
+   row.block_time = block_time;
+   row.trx_in_block = trx_in_block;
+   row.op_in_trx = op_in_trx;
+   row.virtual_op = virtual_op;
+   row.fee = op.visit( fee_visitor() );
+   op.visit( amounts_visitor{ row.amounts } );
+   row.op = op;
+   return row;
+}
+
+std::string operation_type_name( int64_t op_type )
+{
+   FC_ASSERT( op_type >= 0 && op_type < operation::count(), "Unknown operation type ${t}", ("t",op_type) );
+   operation op;
+   op.set_which( op_type );
+   return op.visit( name_visitor() );
+}
+
+export_file_writer::export_file_writer( const fc::path& file, int64_t op_type, uint32_t first_block,
+                                        uint32_t last_block )
+{
+   if( fc::exists( file ) )
+   {
+      // the schema is the first message
+      std::string start( 8, '\0' );
+      export_file existing;
+      {
+         std::ifstream in( file.generic_string().c_str(), std::ios::in | std::ios::binary );
+         in.read( &start[0], start.size() );
+         FC_ASSERT( in.good(), "Unable to read export file ${f}", ("f",file) );
+         const uint32_t metadata_size = get<uint32_t>( start.data(), start.size(), 4 );
+         FC_ASSERT( metadata_size <= max_metadata_size, "${f} is not an export file", ("f",file) );
+         start.resize( 8 + metadata_size );
+         in.read( &start[8], metadata_size );
+         FC_ASSERT( in.good(), "Unable to read export file ${f}", ("f",file) );
+      }
+      size_t pos = 0;
+      arrow_stream_message schema;
+      FC_ASSERT( read_arrow_message( start.data(), start.size(), pos, schema ), "${f} is empty", ("f",file) );
+      read_schema( schema, existing, file );
+      FC_ASSERT( existing.op_type == op_type && existing.first_block == first_block
+                    && existing.last_block == last_block,
+                 "Export file ${f} holds operations of another type or block range", ("f",file) );
+      _size = fc::file_size( file );
+      _out.open( file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+   }
+   else
+   {
+      const std::string schema = arrow_schema_message( op_type, first_block, last_block );
+      _out.open( file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+      _out.write( schema.data(), schema.size() );
+      _out.flush();
+      _size = schema.size();
+   }
+   FC_ASSERT( _out.good(), "Unable to open export file ${f}", ("f",file) );
+}
+
+void export_file_writer::append( const vector<export_row>& rows )
+{
+   if( rows.empty() )
+      return;
+   std::string block_nums, block_times, trx_in_blocks, op_in_trxs, virtual_ops, fee_amounts, fee_assets;
+   std::string account_offsets, accounts, amount_offsets, amounts, amount_assets, op_offsets, ops;
+   int32_t account_end = 0, amount_end = 0;
+   put( account_offsets, account_end );
+   put( amount_offsets, amount_end );
+   put( op_offsets, int32_t( 0 ) );
+   for( const export_row& row : rows )
+   {
+      put( block_nums, row.block_num );
+      put( block_times, int64_t( row.block_time.sec_since_epoch() ) );
+      put( trx_in_blocks, row.trx_in_block );
+      put( op_in_trxs, row.op_in_trx );
+      put( virtual_ops, row.virtual_op );
+      put( fee_amounts, row.fee.amount.value );
+      put( fee_assets, row.fee.asset_id.instance.value );
+      for( const account_id_type& account : row.accounts )
+         put( accounts, account.instance.value );
+      account_end += row.accounts.size();
+      put( account_offsets, account_end );
+      for( const asset& a : row.amounts )
+      {
+         put( amounts, a.amount.value );
+         put( amount_assets, a.asset_id.instance.value );
+      }
+      amount_end += row.amounts.size();
+      put( amount_offsets, amount_end );
+      const vector<char> packed = fc::raw::pack( row.op );
+      ops.append( packed.begin(), packed.end() );
+      FC_ASSERT( ops.size() <= uint32_t( INT32_MAX ), "Too many operations for one record batch" );
+      put( op_offsets, int32_t( ops.size() ) );
+   }
+
+   // the nodes and buffers of the columns depth first, in the order of the schema
+   const int64_t row_count = rows.size();
+   std::string nodes;
+   const auto add_node = [&nodes]( int64_t length ) {
+      put( nodes, length );
+      put( nodes, int64_t( 0 ) ); // no nulls
+   };
+   arrow_body body;
+   for( const std::string* column : { &block_nums, &block_times, &trx_in_blocks, &op_in_trxs, &virtual_ops,
+                                      &fee_amounts, &fee_assets } )
+   {
+      add_node( row_count );
+      body.add_validity();
+      body.add( *column );
+   }
+   add_node( row_count );
+   body.add_validity();
+   body.add( account_offsets );
+   add_node( account_end );
+   body.add_validity();
+   body.add( accounts );
+   add_node( row_count );
+   body.add_validity();
+   body.add( amount_offsets );
+   add_node( amount_end );
+   body.add_validity();
+   for( const std::string* column : { &amounts, &amount_assets } )
+   {
+      add_node( amount_end );
+      body.add_validity();
+      body.add( *column );
+   }
+   add_node( row_count );
+   body.add_validity();
+   body.add( op_offsets );
+   body.add( ops );
+   FC_ASSERT( nodes.size() == 16 * batch_nodes && body.count == batch_buffers );
+
+   fb_table_ptr batch = make_table();
+   batch->add_scalar<int64_t>( 0, row_count ).add_structs( 1, nodes, batch_nodes )
+      .add_structs( 2, body.buffers, body.count );
+   const std::string message = arrow_message( arrow_record_batch, batch, body.data );
+   _out.write( message.data(), message.size() );
+   _out.flush();
+   FC_ASSERT( _out.good(), "Unable to write to an export file" );
+   _size += message.size();
+}
+
+export_file read_export_file( const fc::path& file )
+{
+   vector<char> data( fc::file_size( file ) );
+   {
+      std::ifstream in( file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      in.read( data.data(), data.size() );
+      FC_ASSERT( in.good() || data.empty(), "Unable to read export file ${f}", ("f",file) );
+   }
+   export_file result;
+   size_t pos = 0;
+   arrow_stream_message message;
+   FC_ASSERT( read_arrow_message( data.data(), data.size(), pos, message ), "${f} is empty", ("f",file) );
+   read_schema( message, result, file );
+   while( read_arrow_message( data.data(), data.size(), pos, message ) )
+   {
+      FC_ASSERT( message.type == arrow_record_batch, "Export file holds an unexpected message" );
+      const fb_reader& batch = message.header;
+      FC_ASSERT( batch.vector_size( 1 ) == batch_nodes && batch.vector_size( 2 ) == batch_buffers,
+                 "Export file ${f} has record batches of other columns", ("f",file) );
+      vector<arrow_buffer> buffers;
+      for( uint32_t i = 0; i < batch_buffers; ++i )
+      {
+         const auto buffer = batch.struct_element( 2, i );
+         FC_ASSERT( buffer.first >= 0 && buffer.second >= 0 && uint64_t( buffer.first ) <= message.body_size
+                       && uint64_t( buffer.second ) <= message.body_size - buffer.first,
+                    "Export file has an invalid buffer" );
+         buffers.push_back( arrow_buffer{ message.body + buffer.first, size_t( buffer.second ) } );
+      }
+      // every column has a validity buffer first, which is empty
+      const arrow_buffer& block_nums = buffers[1];
+      const arrow_buffer& block_times = buffers[3];
+      const arrow_buffer& trx_in_blocks = buffers[5];
+      const arrow_buffer& op_in_trxs = buffers[7];
+      const arrow_buffer& virtual_ops = buffers[9];
+      const arrow_buffer& fee_amounts = buffers[11];
+      const arrow_buffer& fee_assets = buffers[13];
+      const arrow_buffer& account_offsets = buffers[15];
+      const arrow_buffer& accounts = buffers[17];
+      const arrow_buffer& amount_offsets = buffers[19];
+      const arrow_buffer& amounts = buffers[22];
+      const arrow_buffer& amount_assets = buffers[24];
+      const arrow_buffer& op_offsets = buffers[26];
+      const arrow_buffer& ops = buffers[27];
+
+      const int64_t row_count = batch.scalar<int64_t>( 0, 0 );
+      FC_ASSERT( row_count >= 0 );
+      for( size_t r = 0; r < size_t( row_count ); ++r )
+      {
+         export_row row;
+         row.block_num = block_nums.at<uint32_t>( r );
+         row.block_time = fc::time_point_sec( uint32_t( block_times.at<int64_t>( r ) ) );
+         row.trx_in_block = trx_in_blocks.at<uint16_t>( r );
+         row.op_in_trx = op_in_trxs.at<uint16_t>( r );
+         row.virtual_op = virtual_ops.at<uint32_t>( r );
+         row.fee.amount = fee_amounts.at<int64_t>( r );
+         row.fee.asset_id = asset_id_type( fee_assets.at<uint64_t>( r ) );
+
+         const int32_t account_begin = account_offsets.at<int32_t>( r );
+         const int32_t account_end = account_offsets.at<int32_t>( r + 1 );
+         FC_ASSERT( account_begin >= 0 && account_end >= account_begin, "Export file has invalid account offsets" );
+         for( int32_t i = account_begin; i < account_end; ++i )
+            row.accounts.push_back( account_id_type( accounts.at<uint64_t>( i ) ) );
+
+         const int32_t amount_begin = amount_offsets.at<int32_t>( r );
+         const int32_t amount_end = amount_offsets.at<int32_t>( r + 1 );
+         FC_ASSERT( amount_begin >= 0 && amount_end >= amount_begin, "Export file has invalid amount offsets" );
+         for( int32_t i = amount_begin; i < amount_end; ++i )
+            row.amounts.push_back( asset( amounts.at<int64_t>( i ),
+                                          asset_id_type( amount_assets.at<uint64_t>( i ) ) ) );
+
+         const int32_t op_begin = op_offsets.at<int32_t>( r );
+         const int32_t op_end = op_offsets.at<int32_t>( r + 1 );
+         FC_ASSERT( op_begin >= 0 && op_end >= op_begin && size_t( op_end ) <= ops.size,
+                    "Export file has invalid operation offsets" );
+         row.op = fc::raw::unpack<operation>( vector<char>( ops.data + op_begin, ops.data + op_end ) );
+
+         result.rows.push_back( std::move( row ) );
+      }
+   }
+   return result;
+}
+
+} } // graphene::history_export
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/history_export/history_export_plugin.hpp>
+#include <graphene/history_export/export_file.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cstdio>
+#include <deque>
+
+namespace graphene { namespace history_export {
+
+namespace detail
+{
+
+/** The rows of a block that is not irreversible yet */
+struct pending_block
+{
+   uint32_t           block_num = 0;
+   vector<export_row> rows;
+};
+
+/** What has been exported, saved in history-export-dir/state after every write to the files */
+struct export_state
+{
+   /** the rows of all blocks up to this one are in the files */
+   uint32_t                      exported_block = 0;
+   /** the first block of the partition the files are appended to, 0 if none */
+   uint32_t                      partition_first = 0;
+   /** the sizes of the files of that partition */
+   std::map<std::string,uint64_t> file_sizes;
+   /** the reversible blocks, only saved at shutdown since the chain does not apply them again */
+   vector<pending_block>         pending;
+};
+
+} } } // graphene::history_export::detail
+
+FC_REFLECT( graphene::history_export::detail::pending_block, (block_num)(rows) )
+FC_REFLECT( graphene::history_export::detail::export_state,
+            (exported_block)(partition_first)(file_sizes)(pending) )
+
+namespace graphene { namespace history_export {
+
+namespace detail
+{
+
+class history_export_plugin_impl
+{
+   public:
+      explicit history_export_plugin_impl( history_export_plugin& _plugin ) : _self( _plugin ) {}
+
+      void index( const applied_block_operations& block );
+      /** writes the buffered rows to the files and saves the state */
+      void flush();
+      /** saves the state and the reversible blocks */
+      void shutdown();
+      /** loads the state and cuts the files back to it, they may hold rows written after it was saved */
+      void recover();
+
+      history_export_plugin& _self;
+
+      fc::path _dir;
+      uint32_t _blocks_per_partition = 100000;
+      uint32_t _rows_per_group = 65536;
+      uint32_t _start_block = 1;
+
+   private:
+      uint32_t partition_of( uint32_t block_num )const
+      {
+         return ( block_num - 1 ) / _blocks_per_partition * _blocks_per_partition + 1;
+      }
+      fc::path partition_dir( uint32_t first_block )const;
+      void open_partition( uint32_t first_block );
+      void save_state( bool with_pending );
+
+      export_state                                                 _state;
+      std::deque<pending_block>                                    _pending;
+      /** irreversible rows not written yet, by operation type */
+      std::map< int64_t, vector<export_row> >                      _buffered;
+      size_t                                                       _buffered_rows = 0;
+      /** the irreversible block the buffered rows reach to */
+      uint32_t                                                     _buffered_block = 0;
+      std::map< int64_t, std::unique_ptr<export_file_writer> >     _writers;
+};
+
+/** Hands the applied operations to the plugin, which keeps no chain objects */
+class history_export_consumer : public history_consumer
+{
+   public:
+      explicit history_export_consumer( history_export_plugin_impl& impl ) : _impl( impl ) {}
+
+      virtual std::string name()const override { return "history_export"; }
+      virtual void index( const applied_block_operations& block ) override { _impl.index( block ); }
+      virtual void end_replay() override { _impl.flush(); }
+
+   private:
+      history_export_plugin_impl& _impl;
+};
+
+fc::path history_export_plugin_impl::partition_dir( uint32_t first_block )const
+{
+   char name[32];
+   std::snprintf( name, sizeof(name), "blocks-%010u-%010u", first_block, first_block + _blocks_per_partition - 1 );
+   return _dir / name;
+}
+
+void history_export_plugin_impl::recover()
+{ try {
+   fc::create_directories( _dir );
+   _state = export_state();
+   const fc::path state_file = _dir / "state";
+   if( fc::exists( state_file ) )
+   {
+      std::vector<char> data( fc::file_size( state_file ) );
+      {
+         std::ifstream in( state_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+         in.read( data.data(), data.size() );
+      }
+      _state = fc::raw::unpack<export_state>( data );
+   }
+   _buffered_block = _state.exported_block;
+   for( pending_block& block : _state.pending )
+      _pending.push_back( std::move( block ) );
+   _state.pending.clear();
+
+   if( _state.partition_first == 0 )
+      return;
+   const fc::path dir = partition_dir( _state.partition_first );
+   if( !fc::exists( dir ) )
+      return;
+   for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const auto size = _state.file_sizes.find( itr->filename().generic_string() );
+      if( size == _state.file_sizes.end() )
+         fc::remove( *itr );
+      else if( fc::file_size( *itr ) > size->second )
+      {
+         wlog( "Cutting ${f} back to the last exported block ${b}", ("f",*itr)("b",_state.exported_block) );
+         fc::resize_file( *itr, size->second );
+      }
+   }
+} FC_CAPTURE_AND_RETHROW( (_dir) ) }
+
+void history_export_plugin_impl::save_state( bool with_pending )
+{
+   _state.exported_block = _buffered_block;
+   _state.file_sizes.clear();
+   for( const auto& writer : _writers )
+      _state.file_sizes[operation_type_name( writer.first ) + ".arrows"] = writer.second->size();
+   if( with_pending )
+      _state.pending.assign( _pending.begin(), _pending.end() );
+   const vector<char> data = fc::raw::pack( _state );
+   _state.pending.clear();
+
+   const fc::path state_file = _dir / "state";
+   const fc::path tmp_file = _dir / "state.tmp";
+   {
+      std::ofstream out( tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+      out.write( data.data(), data.size() );
+      out.flush();
+      FC_ASSERT( out.good(), "Unable to write ${f}", ("f",tmp_file) );
+   }
+   fc::rename( tmp_file, state_file );
+}
+
+void history_export_plugin_impl::open_partition( uint32_t first_block )
+{
+   flush();
+   _writers.clear();
+   _state.partition_first = first_block;
+   // saved before any file of the partition exists, so that recover() knows which files to look at
+   save_state( false );
+   fc::create_directories( partition_dir( first_block ) );
+}
+
+void history_export_plugin_impl::flush()
+{ try {
+   if( _dir.string().empty() )
+      return;
+   for( auto& rows : _buffered )
+   {
+      if( rows.second.empty() )
+         continue;
+      auto& writer = _writers[rows.first];
+      if( !writer )
+      {
+         const fc::path file = partition_dir( _state.partition_first ) / ( operation_type_name( rows.first ) + ".arrows" );
+         writer.reset( new export_file_writer( file, rows.first, _state.partition_first,
+                                               _state.partition_first + _blocks_per_partition - 1 ) );
+      }
+      writer->append( rows.second );
+      rows.second.clear();
+   }
+   _buffered_rows = 0;
+   if( _buffered_block > _state.exported_block )
+      save_state( false );
+} FC_CAPTURE_AND_RETHROW() }
+
+void history_export_plugin_impl::shutdown()
+{ try {
+   if( _dir.string().empty() )
+      return;
+   flush();
+   save_state( true );
+   _writers.clear();
+} FC_CAPTURE_AND_RETHROW() }
+
+void history_export_plugin_impl::index( const applied_block_operations& block )
+{ try {
+   // a block replaces the blocks of a fork it is applied over
+   while( !_pending.empty() && _pending.back().block_num >= block.block_num )
+      _pending.pop_back();
+
+   if( block.block_num > _buffered_block && block.block_num >= _start_block )
+   {
+      pending_block pending;
+      pending.block_num = block.block_num;
+      for( size_t i = 0; i < block.operations.size(); ++i )
+      {
+         const optional<operation_history_object>& o = block.operations[i];
+         if( !o.valid() )
+            continue;
+         export_row row = make_export_row( block.block_num, block.timestamp, o->trx_in_block, o->op_in_trx,
+                                           o->virtual_op, o->op );
+         row.accounts.assign( block.impacted_accounts[i].begin(), block.impacted_accounts[i].end() );
+         pending.rows.push_back( std::move( row ) );
+      }
+      _pending.push_back( std::move( pending ) );
+   }
+
+   const uint32_t irreversible = std::min( block.last_irreversible_block_num, block.block_num );
+   while( !_pending.empty() && _pending.front().block_num <= irreversible )
+   {
+      pending_block& next = _pending.front();
+      const uint32_t partition = partition_of( next.block_num );
+      if( partition != _state.partition_first && !next.rows.empty() )
+         open_partition( partition );
+      for( export_row& row : next.rows )
+      {
+         _buffered[row.op.which()].push_back( std::move( row ) );
+         ++_buffered_rows;
+      }
+      _buffered_block = next.block_num;
+      _pending.pop_front();
+   }
+   _buffered_block = std::max( _buffered_block, irreversible );
+
+   if( _buffered_rows >= _rows_per_group )
+      flush();
+} FC_CAPTURE_AND_RETHROW( (block.block_num) ) }
+
+} // end namespace detail
+
+history_export_plugin::history_export_plugin() :
+   my( new detail::history_export_plugin_impl(*this) )
+{
+}
+
+history_export_plugin::~history_export_plugin()
+{
+}
+
+std::string history_export_plugin::plugin_name()const
+{
+   return "history_export";
+}
+
+std::string history_export_plugin::plugin_description()const
+{
+   return "Exports the applied operations into Apache Arrow files partitioned by block range and type.";
+}
+
+void history_export_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("history-export-dir", boost::program_options::value<std::string>(),
+          "Directory to export the operations of irreversible blocks into, as Apache Arrow IPC stream files")
+         ("history-export-blocks-per-partition", boost::program_options::value<uint32_t>()->default_value(100000),
+          "Number of blocks of each directory of export files (100000 by default)")
+         ("history-export-rows-per-group", boost::program_options::value<uint32_t>()->default_value(65536),
+          "Number of operations buffered before they are written to the export files as a record batch (65536 "
+          "by default)")
+         ("history-export-start-block", boost::program_options::value<uint32_t>()->default_value(1),
+          "First block whose operations are exported (1 by default)")
+         ;
+   cfg.add(cli);
+}
+
+void history_export_plugin::plugin_initialize(const boost::program_options::variables_map& options)
+{ try {
+   if( !options.count("history-export-dir") )
+   {
+      wlog( "history_export plugin enabled without history-export-dir, nothing is exported" );
+      return;
+   }
+   my->_dir = fc::path( options.at("history-export-dir").as<std::string>() );
+   if( options.count("history-export-blocks-per-partition") )
+      my->_blocks_per_partition = options.at("history-export-blocks-per-partition").as<uint32_t>();
+   if( options.count("history-export-rows-per-group") )
+      my->_rows_per_group = options.at("history-export-rows-per-group").as<uint32_t>();
+   if( options.count("history-export-start-block") )
+      my->_start_block = options.at("history-export-start-block").as<uint32_t>();
+   FC_ASSERT( my->_blocks_per_partition > 0, "history-export-blocks-per-partition must be positive" );
+   FC_ASSERT( my->_rows_per_group > 0, "history-export-rows-per-group must be positive" );
+
+   my->recover();
+   database().add_history_consumer( std::make_shared<detail::history_export_consumer>( *my ) );
+} FC_LOG_AND_RETHROW() }
+
+void history_export_plugin::plugin_startup()
+{
+}
+
+void history_export_plugin::plugin_shutdown()
+{
+   my->shutdown();
+}
+
+void history_export_plugin::flush()
+{
+   my->flush();
+}
+
+} }
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/protocol/operations.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+
+namespace graphene { namespace history_export {
+   using namespace graphene::chain;
+
+   /** An applied operation with the fields analytics query most, as exported into an Arrow file */
+   struct export_row
+   {
+      uint32_t                block_num = 0;
+      fc::time_point_sec      block_time;
+      uint16_t                trx_in_block = 0;
+      uint16_t                op_in_trx = 0;
+      uint32_t                virtual_op = 0;
+      asset                   fee;
+      /** the accounts impacted by the operation */
+      vector<account_id_type> accounts;
+      /** the asset members of the operation other than the fee, in declaration order */
+      vector<asset>           amounts;
+      operation               op;
+   };
+
+   /** @return the row of an applied operation, without the accounts */
+   export_row make_export_row( uint32_t block_num, fc::time_point_sec block_time, uint16_t trx_in_block,
+                               uint16_t op_in_trx, uint32_t virtual_op, const operation& op );
+   /** @return the name of the operation type, e.g. transfer_operation */
+   std::string operation_type_name( int64_t op_type );
+
+   /**
+    *  @brief Writes the rows of one operation type and block range into an Apache Arrow IPC stream file
+    *
+    *  The file is an Arrow IPC stream, metadata version 5, little endian, readable by any Arrow implementation,
+    *  e.g. pyarrow.ipc.open_stream(). It starts with the schema, whose custom metadata holds the format version,
+    *  the operation type and the block range as graphene.version, graphene.op_type, graphene.first_block and
+    *  graphene.last_block. The columns are, none of them nullable:
+    *
+    *  - block_num: uint32
+    *  - block_time: timestamp[s, tz=UTC]
+    *  - trx_in_block, op_in_trx: uint16
+    *  - virtual_op: uint32
+    *  - fee_amount: int64, fee_asset: uint64, the asset instance
+    *  - accounts: list<uint64>, the account instances
+    *  - amounts: list<struct<amount: int64, asset: uint64>>
+    *  - op: binary, the packed operation
+    *
+    *  Every append() writes a record batch and no end of stream marker, a file that is cut short at a batch
+    *  boundary stays a valid stream. The buffers are not compressed, the codecs of the Arrow format are no
+    *  dependencies of this tree.
+    */
+   class export_file_writer
+   {
+      public:
+         static const uint32_t version = 2;
+
+         /** Opens file, creating it with the given header if it does not exist */
+         export_file_writer( const fc::path& file, int64_t op_type, uint32_t first_block, uint32_t last_block );
+
+         void append( const vector<export_row>& rows );
+         /** @return the size of the file, all of it record batches appended before */
+         uint64_t size()const { return _size; }
+
+      private:
+         std::ofstream _out;
+         uint64_t      _size = 0;
+   };
+
+   /** The content of an export file */
+   struct export_file
+   {
+      int64_t            op_type = 0;
+      uint32_t           first_block = 0;
+      uint32_t           last_block = 0;
+      vector<export_row> rows;
+   };
+
+   /** @return the content of an export file written by export_file_writer */
+   export_file read_export_file( const fc::path& file );
+
+} } // graphene::history_export
+
+FC_REFLECT( graphene::history_export::export_row,
+            (block_num)(block_time)(trx_in_block)(op_in_trx)(virtual_op)(fee)(accounts)(amounts)(op) )
+FC_REFLECT( graphene::history_export::export_file, (op_type)(first_block)(last_block)(rows) )
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/plugin.hpp>
+#include <graphene/chain/database.hpp>
+
+namespace graphene { namespace history_export {
+
+namespace detail
+{
+    class history_export_plugin_impl;
+}
+
+/**
+ *  @brief Exports the applied operations into Apache Arrow files for bulk analytics
+ *
+ *  Operations are exported once their block is irreversible, into one file per operation type and range of blocks,
+ *  history-export-dir/blocks-<first>-<last>/<operation name>.arrows, see export_file_writer for the format. The files
+ *  can be read with read_export_file(). The export resumes where it stopped on restart and during a replay.
+ */
+class history_export_plugin : public graphene::app::plugin
+{
+   public:
+      history_export_plugin();
+      virtual ~history_export_plugin();
+
+      std::string plugin_name()const override;
+      std::string plugin_description()const override;
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg) override;
+      virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+      /** Writes the operations of the irreversible blocks that are still buffered to the files */
+      void flush();
+
+      friend class detail::history_export_plugin_impl;
+      std::unique_ptr<detail::history_export_plugin_impl> my;
+};
+
+} } //graphene::history_export
@@ -31,6 +31,9 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <deque>
+#include <map>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -53,7 +56,8 @@ enum market_history_object_type
    order_history_object_type = 0,
    bucket_object_type = 1,
    market_ticker_object_type = 2,
-   market_ticker_meta_object_type = 3
+   market_ticker_meta_object_type = 3, ///< no longer used, the tickers roll out market_ticker_slot_objects
+   market_ticker_slot_object_type = 4
 };
 
 struct bucket_key
@@ -150,13 +154,25 @@ struct market_ticker_object : public abstract_object<market_ticker_object>
    fc::uint128         quote_volume;
 };
 
-struct market_ticker_meta_object : public abstract_object<market_ticker_meta_object>
+/**
+ * The maker fills of a market in one slot of the last 24 hours. The ticker of the market adds the fills of a slot
+ * when they happen and subtracts them all at once when the slot leaves the 24 hours.
+ */
+struct market_ticker_slot_object : public abstract_object<market_ticker_slot_object>
 {
    static const uint8_t space_id = MARKET_HISTORY_SPACE_ID;
-   static const uint8_t type_id  = market_ticker_meta_object_type;
+   static const uint8_t type_id  = market_ticker_slot_object_type;
 
-   object_id_type      rolling_min_order_his_id;
-   bool                skip_min_order_his_id = false;
+   /** the width of the slots, 1440 slots make a day */
+   static const uint32_t slot_seconds = 60;
+
+   asset_id_type       base;
+   asset_id_type       quote;
+   fc::time_point_sec  open;          ///< the start of the slot
+   share_type          close_base;    ///< price of the last fill in the slot
+   share_type          close_quote;
+   fc::uint128         base_volume;
+   fc::uint128         quote_volume;
 };
 
 struct by_key;
@@ -211,9 +227,100 @@ typedef multi_index_container<
    >
 > market_ticker_object_multi_index_type;
 
+struct by_market_slot;
+struct by_slot_open;
+typedef multi_index_container<
+   market_ticker_slot_object,
+   indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique<
+         tag<by_market_slot>,
+         composite_key<
+            market_ticker_slot_object,
+            member<market_ticker_slot_object, asset_id_type, &market_ticker_slot_object::base>,
+            member<market_ticker_slot_object, asset_id_type, &market_ticker_slot_object::quote>,
+            member<market_ticker_slot_object, time_point_sec, &market_ticker_slot_object::open>
+         >
+      >,
+      ordered_unique<
+         tag<by_slot_open>,
+         composite_key<
+            market_ticker_slot_object,
+            member<market_ticker_slot_object, time_point_sec, &market_ticker_slot_object::open>,
+            member< object, object_id_type, &object::id >
+         >
+      >
+   >
+> market_ticker_slot_object_multi_index_type;
+
+/** What get_trade_history needs of an order_history_object */
+struct recent_trade
+{
+   int64_t              sequence = 0;
+   fc::time_point_sec   time;
+   bool                 is_maker = true;
+   account_id_type      account_id;
+   asset                pays;
+   asset                receives;
+   price                fill_price;
+
+   static recent_trade from_history( const order_history_object& o )
+   {
+      recent_trade t;
+      t.sequence   = o.key.sequence;
+      t.time       = o.time;
+      t.is_maker   = o.op.is_maker;
+      t.account_id = o.op.account_id;
+      t.pays       = o.op.pays;
+      t.receives   = o.op.receives;
+      t.fill_price = o.op.fill_price;
+      return t;
+   }
+};
+
+/**
+ * Keeps the most recent order history entries of each market in a ring, so that queries for the latest trades read
+ * adjacent memory instead of the objects of history_index.
+ *
+ * The ring of a market holds exactly the entries of the market whose sequence is below its boundary, the newest
+ * first. Entries that are pushed out of a full ring, or that are reinserted by an undo beyond the boundary, stay in
+ * history_index only, and queries that reach the boundary continue there.
+ */
+class recent_trades_index : public secondary_index
+{
+   public:
+      struct market_ring
+      {
+         std::deque< recent_trade > trades;
+         /** all entries of the market not in trades have a sequence not below this */
+         int64_t                    boundary = std::numeric_limits<int64_t>::max();
+      };
+
+      explicit recent_trades_index( size_t capacity ) : _capacity( capacity ) {}
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual uint64_t estimated_memory_usage()const override;
+      virtual bool is_self_contained()const override { return true; }
+
+      /** @return the entries kept per market, 0 if no ring is kept */
+      size_t capacity()const { return _capacity; }
+      /** @return the ring of the market, nullptr if it has no entries in history_index */
+      const market_ring* find_market( asset_id_type base, asset_id_type quote )const
+      {
+         auto itr = _markets.find( std::make_pair( base, quote ) );
+         return itr == _markets.end() ? nullptr : &itr->second;
+      }
+
+   private:
+      size_t                                                      _capacity;
+      std::map< std::pair<asset_id_type,asset_id_type>, market_ring > _markets;
+};
+
 typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
 typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
 typedef generic_index<market_ticker_object, market_ticker_object_multi_index_type> market_ticker_index;
+typedef generic_index<market_ticker_slot_object, market_ticker_slot_object_multi_index_type> market_ticker_slot_index;
 
 
 namespace detail
@@ -267,5 +374,7 @@ FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::d
                     (last_day_base)(last_day_quote)
                     (latest_base)(latest_quote)
                     (base_volume)(quote_volume) )
-FC_REFLECT_DERIVED( graphene::market_history::market_ticker_meta_object, (graphene::db::object),
-                    (rolling_min_order_his_id)(skip_min_order_his_id) )
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_slot_object, (graphene::db::object),
+                    (base)(quote)(open)
+                    (close_base)(close_quote)
+                    (base_volume)(quote_volume) )
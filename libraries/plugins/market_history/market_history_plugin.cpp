@@ -40,6 +40,43 @@ namespace graphene { namespace market_history {
 namespace detail
 {
 
+/// Maker fills of one market in the current block, merged so that its ticker and buckets are updated only once
+struct market_fills
+{
+   asset_id_type base;
+   asset_id_type quote;
+   price         open;          ///< price of the first fill
+   price         close;         ///< price of the last fill
+   price         high;          ///< first fill with the highest price
+   price         low;           ///< first fill with the lowest price
+   share_type    base_volume;   ///< saturated at the maximum like the volumes of buckets
+   share_type    quote_volume;
+   fc::uint128   ticker_base_volume;
+   fc::uint128   ticker_quote_volume;
+
+   void add( const price& trade_price, const price& fill_price )
+   {
+      close = fill_price;
+      if( high < fill_price )
+         high = fill_price;
+      if( low > fill_price )
+         low = fill_price;
+      add_saturated( base_volume, trade_price.base.amount );
+      add_saturated( quote_volume, trade_price.quote.amount );
+      ticker_base_volume  += trade_price.base.amount.value;  // ignore overflow
+      ticker_quote_volume += trade_price.quote.amount.value; // ignore overflow
+   }
+
+   static void add_saturated( share_type& total, share_type amount )
+   {
+      try {
+         total += amount;
+      } catch( fc::overflow_exception& ) {
+         total = std::numeric_limits<int64_t>::max();
+      }
+   }
+};
+
 class market_history_plugin_impl
 {
    public:
@@ -47,10 +84,19 @@ class market_history_plugin_impl
       :_self( _plugin ) {}
       virtual ~market_history_plugin_impl();
 
-      /** this method is called as a callback after a block is applied
+      /** this method is called by market_history_consumer after a block is applied
        * and will process/index all operations that were applied in the block.
        */
-      void update_market_histories( const signed_block& b );
+      void update_market_histories( const applied_block_operations& b );
+
+      /// adds a maker fill to the fills of its market in the current block
+      void add_fill( const bucket_key& market, const price& trade_price, const price& fill_price );
+
+      /// updates the ticker and the buckets of every market with fills in the current block
+      void flush_fills( fc::time_point_sec now );
+
+      /// subtracts the ticker slots that left the last 24 hours from their tickers
+      void roll_out_ticker_slots( fc::time_point_sec now );
 
       graphene::chain::database& database()
       {
@@ -62,17 +108,35 @@ class market_history_plugin_impl
       uint32_t                   _maximum_history_per_bucket_size = 1000;
       uint32_t                   _max_order_his_records_per_market = 1000;
       uint32_t                   _max_order_his_seconds_per_market = 259200;
+
+      /// fills of the current block in the order of the first fill of each market
+      vector<market_fills>                                     _block_fills;
+      flat_map<pair<asset_id_type,asset_id_type>, size_t>      _block_fill_index;
+};
+
+
+/** Hands the applied operations to the plugin, which only uses its own indexes to index them */
+class market_history_consumer : public history_consumer
+{
+   public:
+      explicit market_history_consumer( market_history_plugin_impl& impl ) : _impl( impl ) {}
+
+      virtual std::string name()const override { return "market_history"; }
+      virtual void index( const applied_block_operations& block ) override { _impl.update_market_histories( block ); }
+
+   private:
+      market_history_plugin_impl& _impl;
 };
 
 
 struct operation_process_fill_order
 {
    market_history_plugin&            _plugin;
+   market_history_plugin_impl&       _impl;
    fc::time_point_sec                _now;
-   const market_ticker_meta_object*& _meta;
 
-   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n, const market_ticker_meta_object*& meta )
-   :_plugin(mhp),_now(n),_meta(meta) {}
+   operation_process_fill_order( market_history_plugin& mhp, market_history_plugin_impl& impl, fc::time_point_sec n )
+   :_plugin(mhp),_impl(impl),_now(n) {}
 
    typedef void result_type;
 
@@ -103,25 +167,12 @@ struct operation_process_fill_order
       else
          hkey.sequence = 0;
 
-      const auto& new_order_his_obj = db.create<order_history_object>( [&]( order_history_object& ho ) {
+      db.create<order_history_object>( [&]( order_history_object& ho ) {
          ho.key = hkey;
          ho.time = _now;
          ho.op = o;
       });
 
-      // save a reference to market ticker meta object
-      if( _meta == nullptr )
-      {
-         const auto& meta_idx = db.get_index_type<simple_index<market_ticker_meta_object>>();
-         if( meta_idx.size() == 0 )
-            _meta = &db.create<market_ticker_meta_object>( [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = new_order_his_obj.id;
-               mtm.skip_min_order_his_id = false;
-            });
-         else
-            _meta = &( *meta_idx.begin() );
-      }
-
       // To remove old filled order data
       const auto max_records = _plugin.max_order_his_records_per_market();
       hkey.sequence += max_records;
@@ -176,214 +227,267 @@ struct operation_process_fill_order
       if( fill_price.base.asset_id > fill_price.quote.asset_id )
          fill_price = ~fill_price;
 
-      // To update ticker data
-      const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
-      auto ticker_itr = ticker_idx.find( std::make_tuple( key.base, key.quote ) );
-      if( ticker_itr == ticker_idx.end() )
-      {
-         db.create<market_ticker_object>( [&]( market_ticker_object& mt ) {
-            mt.base           = key.base;
-            mt.quote          = key.quote;
-            mt.last_day_base  = 0;
-            mt.last_day_quote = 0;
-            mt.latest_base    = fill_price.base.amount;
-            mt.latest_quote   = fill_price.quote.amount;
-            mt.base_volume    = trade_price.base.amount.value;
-            mt.quote_volume   = trade_price.quote.amount.value;
-         });
-      }
-      else
-      {
-         db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
-            mt.latest_base    = fill_price.base.amount;
-            mt.latest_quote   = fill_price.quote.amount;
-            mt.base_volume    += trade_price.base.amount.value;  // ignore overflow
-            mt.quote_volume   += trade_price.quote.amount.value; // ignore overflow
-         });
-      }
+      // All fills of a block fall into the same buckets, ticker and buckets are updated once at the end of the block
+      _impl.add_fill( key, trade_price, fill_price );
+   }
+};
 
-      // To update buckets data
-      const auto max_history = _plugin.max_history();
-      if( max_history == 0 ) return;
+void market_history_plugin_impl::add_fill( const bucket_key& market, const price& trade_price, const price& fill_price )
+{
+   auto inserted = _block_fill_index.emplace( std::make_pair( market.base, market.quote ), _block_fills.size() );
+   if( inserted.second )
+   {
+      market_fills fills;
+      fills.base = market.base;
+      fills.quote = market.quote;
+      fills.open = fill_price;
+      fills.close = fill_price;
+      fills.high = fill_price;
+      fills.low = fill_price;
+      fills.base_volume = trade_price.base.amount;
+      fills.quote_volume = trade_price.quote.amount;
+      fills.ticker_base_volume = trade_price.base.amount.value;
+      fills.ticker_quote_volume = trade_price.quote.amount.value;
+      _block_fills.push_back( fills );
+   }
+   else
+      _block_fills[inserted.first->second].add( trade_price, fill_price );
+}
 
-      const auto& buckets = _plugin.tracked_buckets();
-      if( buckets.size() == 0 ) return;
+void market_history_plugin_impl::flush_fills( fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+   const auto& slot_idx = db.get_index_type<market_ticker_slot_index>().indices().get<by_market_slot>();
+   const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+   const fc::time_point_sec slot_open( now.sec_since_epoch()
+                                       - now.sec_since_epoch() % market_ticker_slot_object::slot_seconds );
 
-      const auto& bucket_idx = db.get_index_type<bucket_index>();
-      for( auto bucket : buckets )
+   for( const market_fills& fills : _block_fills )
+   {
+      try
       {
-          auto bucket_num = _now.sec_since_epoch() / bucket;
-          fc::time_point_sec cutoff;
-          if( bucket_num > max_history )
-             cutoff = cutoff + ( bucket * ( bucket_num - max_history ) );
-
-          key.seconds = bucket;
-          key.open    = fc::time_point_sec() + ( bucket_num * bucket );
-
-          const auto& by_key_idx = bucket_idx.indices().get<by_key>();
-          auto bucket_itr = by_key_idx.find( key );
-          if( bucket_itr == by_key_idx.end() )
-          { // create new bucket
-            /* const auto& obj = */
-            db.create<bucket_object>( [&]( bucket_object& b ){
-                 b.key = key;
-                 b.base_volume = trade_price.base.amount;
-                 b.quote_volume = trade_price.quote.amount;
-                 b.open_base = fill_price.base.amount;
-                 b.open_quote = fill_price.quote.amount;
-                 b.close_base = fill_price.base.amount;
-                 b.close_quote = fill_price.quote.amount;
-                 b.high_base = b.close_base;
-                 b.high_quote = b.close_quote;
-                 b.low_base = b.close_base;
-                 b.low_quote = b.close_quote;
+         // To update ticker data
+         auto ticker_itr = ticker_idx.find( std::make_tuple( fills.base, fills.quote ) );
+         if( ticker_itr == ticker_idx.end() )
+         {
+            db.create<market_ticker_object>( [&]( market_ticker_object& mt ) {
+               mt.base           = fills.base;
+               mt.quote          = fills.quote;
+               mt.last_day_base  = 0;
+               mt.last_day_quote = 0;
+               mt.latest_base    = fills.close.base.amount;
+               mt.latest_quote   = fills.close.quote.amount;
+               mt.base_volume    = fills.ticker_base_volume;
+               mt.quote_volume   = fills.ticker_quote_volume;
+            });
+         }
+         else
+         {
+            db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
+               mt.latest_base    = fills.close.base.amount;
+               mt.latest_quote   = fills.close.quote.amount;
+               mt.base_volume    += fills.ticker_base_volume;  // ignore overflow
+               mt.quote_volume   += fills.ticker_quote_volume; // ignore overflow
+            });
+         }
+
+         // the fills leave the ticker along with their slot
+         auto slot_itr = slot_idx.find( std::make_tuple( fills.base, fills.quote, slot_open ) );
+         if( slot_itr == slot_idx.end() )
+         {
+            db.create<market_ticker_slot_object>( [&]( market_ticker_slot_object& slot ) {
+               slot.base         = fills.base;
+               slot.quote        = fills.quote;
+               slot.open         = slot_open;
+               slot.close_base   = fills.close.base.amount;
+               slot.close_quote  = fills.close.quote.amount;
+               slot.base_volume  = fills.ticker_base_volume;
+               slot.quote_volume = fills.ticker_quote_volume;
+            });
+         }
+         else
+         {
+            db.modify( *slot_itr, [&]( market_ticker_slot_object& slot ) {
+               slot.close_base   = fills.close.base.amount;
+               slot.close_quote  = fills.close.quote.amount;
+               slot.base_volume  += fills.ticker_base_volume;  // ignore overflow
+               slot.quote_volume += fills.ticker_quote_volume; // ignore overflow
             });
-            //wlog( "    creating bucket ${b}", ("b",obj) );
-          }
-          else
-          { // update existing bucket
-             //wlog( "    before updating bucket ${b}", ("b",*bucket_itr) );
-             db.modify( *bucket_itr, [&]( bucket_object& b ){
-                  try {
-                     b.base_volume += trade_price.base.amount;
-                  } catch( fc::overflow_exception& ) {
-                     b.base_volume = std::numeric_limits<int64_t>::max();
-                  }
-                  try {
-                     b.quote_volume += trade_price.quote.amount;
-                  } catch( fc::overflow_exception& ) {
-                     b.quote_volume = std::numeric_limits<int64_t>::max();
-                  }
-                  b.close_base = fill_price.base.amount;
-                  b.close_quote = fill_price.quote.amount;
-                  if( b.high() < fill_price )
-                  {
-                      b.high_base = b.close_base;
-                      b.high_quote = b.close_quote;
-                  }
-                  if( b.low() > fill_price )
-                  {
-                      b.low_base = b.close_base;
-                      b.low_quote = b.close_quote;
-                  }
-             });
-             //wlog( "    after bucket bucket ${b}", ("b",*bucket_itr) );
-          }
-
-          {
-             key.open = fc::time_point_sec();
-             bucket_itr = by_key_idx.lower_bound( key );
-
-             while( bucket_itr != by_key_idx.end() &&
-                    bucket_itr->key.base == key.base &&
-                    bucket_itr->key.quote == key.quote &&
-                    bucket_itr->key.seconds == bucket &&
-                    bucket_itr->key.open < cutoff )
+         }
+
+         // To update buckets data
+         if( _maximum_history_per_bucket_size == 0 )
+            continue;
+
+         bucket_key key;
+         key.base  = fills.base;
+         key.quote = fills.quote;
+         for( auto bucket : _tracked_buckets )
+         {
+             auto bucket_num = now.sec_since_epoch() / bucket;
+             fc::time_point_sec cutoff;
+             if( bucket_num > _maximum_history_per_bucket_size )
+                cutoff = cutoff + ( bucket * ( bucket_num - _maximum_history_per_bucket_size ) );
+
+             key.seconds = bucket;
+             key.open    = fc::time_point_sec() + ( bucket_num * bucket );
+
+             auto bucket_itr = by_key_idx.find( key );
+             if( bucket_itr == by_key_idx.end() )
+             { // create new bucket
+               db.create<bucket_object>( [&]( bucket_object& b ){
+                    b.key = key;
+                    b.base_volume = fills.base_volume;
+                    b.quote_volume = fills.quote_volume;
+                    b.open_base = fills.open.base.amount;
+                    b.open_quote = fills.open.quote.amount;
+                    b.close_base = fills.close.base.amount;
+                    b.close_quote = fills.close.quote.amount;
+                    b.high_base = fills.high.base.amount;
+                    b.high_quote = fills.high.quote.amount;
+                    b.low_base = fills.low.base.amount;
+                    b.low_quote = fills.low.quote.amount;
+               });
+             }
+             else
+             { // update existing bucket
+                db.modify( *bucket_itr, [&]( bucket_object& b ){
+                     market_fills::add_saturated( b.base_volume, fills.base_volume );
+                     market_fills::add_saturated( b.quote_volume, fills.quote_volume );
+                     b.close_base = fills.close.base.amount;
+                     b.close_quote = fills.close.quote.amount;
+                     if( b.high() < fills.high )
+                     {
+                         b.high_base = fills.high.base.amount;
+                         b.high_quote = fills.high.quote.amount;
+                     }
+                     if( b.low() > fills.low )
+                     {
+                         b.low_base = fills.low.base.amount;
+                         b.low_quote = fills.low.quote.amount;
+                     }
+                });
+             }
+
              {
-              //  elog( "    removing old bucket ${b}", ("b", *bucket_itr) );
-                auto old_bucket_itr = bucket_itr;
-                ++bucket_itr;
-                db.remove( *old_bucket_itr );
+                key.open = fc::time_point_sec();
+                bucket_itr = by_key_idx.lower_bound( key );
+
+                while( bucket_itr != by_key_idx.end() &&
+                       bucket_itr->key.base == key.base &&
+                       bucket_itr->key.quote == key.quote &&
+                       bucket_itr->key.seconds == bucket &&
+                       bucket_itr->key.open < cutoff )
+                {
+                   auto old_bucket_itr = bucket_itr;
+                   ++bucket_itr;
+                   db.remove( *old_bucket_itr );
+                }
              }
-          }
-      }
+         }
+      } FC_CAPTURE_AND_LOG( (fills.base)(fills.quote) )
    }
-};
+   _block_fills.clear();
+   _block_fill_index.clear();
+}
 
 market_history_plugin_impl::~market_history_plugin_impl()
 {}
 
-void market_history_plugin_impl::update_market_histories( const signed_block& b )
+void market_history_plugin_impl::update_market_histories( const applied_block_operations& b )
 {
-   graphene::chain::database& db = database();
-   const market_ticker_meta_object* _meta = nullptr;
-   const auto& meta_idx = db.get_index_type<simple_index<market_ticker_meta_object>>();
-   if( meta_idx.size() > 0 )
-      _meta = &( *meta_idx.begin() );
-   const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
+   const vector<optional< operation_history_object > >& hist = b.operations;
    for( const optional< operation_history_object >& o_op : hist )
    {
       if( o_op.valid() )
       {
          try
          {
-            o_op->op.visit( operation_process_fill_order( _self, b.timestamp, _meta ) );
+            table_visit( o_op->op, operation_process_fill_order( _self, *this, b.timestamp ) );
          } FC_CAPTURE_AND_LOG( (o_op) )
       }
    }
-   // roll out expired data from ticker
-   if( _meta != nullptr )
-   {
-      time_point_sec last_day = b.timestamp - 86400;
-      object_id_type last_min_his_id = _meta->rolling_min_order_his_id;
-      bool skip = _meta->skip_min_order_his_id;
-
-      const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
-      const auto& history_idx = db.get_index_type<history_index>().indices().get<by_id>();
-      auto history_itr = history_idx.lower_bound( _meta->rolling_min_order_his_id );
-      while( history_itr != history_idx.end() && history_itr->time < last_day )
-      {
-         const fill_order_operation& o = history_itr->op;
-         if( skip && history_itr->id == _meta->rolling_min_order_his_id )
-            skip = false;
-         else if( o.is_maker )
-         {
-            bucket_key key;
-            key.base    = o.pays.asset_id;
-            key.quote   = o.receives.asset_id;
-
-            price trade_price = o.pays / o.receives;
-
-            if( key.base > key.quote )
-            {
-               std::swap( key.base, key.quote );
-               trade_price = ~trade_price;
-            }
-
-            price fill_price = o.fill_price;
-            if( fill_price.base.asset_id > fill_price.quote.asset_id )
-               fill_price = ~fill_price;
+   flush_fills( b.timestamp );
+   roll_out_ticker_slots( b.timestamp );
+}
 
-            auto ticker_itr = ticker_idx.find( std::make_tuple( key.base, key.quote ) );
-            if( ticker_itr != ticker_idx.end() ) // should always be true
-            {
-               db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
-                  mt.last_day_base  = fill_price.base.amount;
-                  mt.last_day_quote = fill_price.quote.amount;
-                  mt.base_volume    -= trade_price.base.amount.value;  // ignore underflow
-                  mt.quote_volume   -= trade_price.quote.amount.value; // ignore underflow
-               });
-            }
-         }
-         last_min_his_id = history_itr->id;
-         ++history_itr;
-      }
-      // update meta
-      if( history_itr != history_idx.end() ) // if still has some data rolling
-      {
-         if( history_itr->id != _meta->rolling_min_order_his_id ) // if rolled out some
-         {
-            db.modify( *_meta, [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = history_itr->id;
-               mtm.skip_min_order_his_id = false;
-            });
-         }
-      }
-      else // if all data are rolled out
+void market_history_plugin_impl::roll_out_ticker_slots( fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   if( now.sec_since_epoch() < 86400 + market_ticker_slot_object::slot_seconds )
+      return;
+   // a slot leaves when all of it is older than 24 hours
+   const fc::time_point_sec cutoff = now - ( 86400 + market_ticker_slot_object::slot_seconds );
+
+   const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+   const auto& slot_idx = db.get_index_type<market_ticker_slot_index>().indices().get<by_slot_open>();
+   auto slot_itr = slot_idx.begin();
+   while( slot_itr != slot_idx.end() && slot_itr->open <= cutoff )
+   {
+      const market_ticker_slot_object& slot = *slot_itr;
+      ++slot_itr;
+      auto ticker_itr = ticker_idx.find( std::make_tuple( slot.base, slot.quote ) );
+      if( ticker_itr != ticker_idx.end() ) // should always be true
       {
-         if( last_min_his_id != _meta->rolling_min_order_his_id ) // if rolled out some
-         {
-            db.modify( *_meta, [&]( market_ticker_meta_object& mtm ) {
-               mtm.rolling_min_order_his_id = last_min_his_id;
-               mtm.skip_min_order_his_id = true;
-            });
-         }
+         db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
+            mt.last_day_base  = slot.close_base;
+            mt.last_day_quote = slot.close_quote;
+            mt.base_volume    -= slot.base_volume;  // ignore underflow
+            mt.quote_volume   -= slot.quote_volume; // ignore underflow
+         });
       }
+      db.remove( slot );
    }
 }
 
 } // end namespace detail
 
+void recent_trades_index::object_inserted( const object& obj )
+{
+   if( _capacity == 0 )
+      return;
+   const auto& o = static_cast<const order_history_object&>( obj );
+   market_ring& ring = _markets[ std::make_pair( o.key.base, o.key.quote ) ];
+   // older than what the ring holds, in history_index only
+   if( o.key.sequence >= ring.boundary )
+      return;
+   auto pos = std::lower_bound( ring.trades.begin(), ring.trades.end(), o.key.sequence,
+                                []( const recent_trade& t, int64_t seq ) { return t.sequence < seq; } );
+   ring.trades.insert( pos, recent_trade::from_history( o ) );
+   if( ring.trades.size() > _capacity )
+   {
+      ring.boundary = ring.trades.back().sequence;
+      ring.trades.pop_back();
+   }
+}
+
+void recent_trades_index::object_removed( const object& obj )
+{
+   if( _capacity == 0 )
+      return;
+   const auto& o = static_cast<const order_history_object&>( obj );
+   auto itr = _markets.find( std::make_pair( o.key.base, o.key.quote ) );
+   if( itr == _markets.end() )
+      return;
+   market_ring& ring = itr->second;
+   auto pos = std::lower_bound( ring.trades.begin(), ring.trades.end(), o.key.sequence,
+                                []( const recent_trade& t, int64_t seq ) { return t.sequence < seq; } );
+   if( pos != ring.trades.end() && pos->sequence == o.key.sequence )
+      ring.trades.erase( pos );
+   if( ring.trades.empty() && ring.boundary == std::numeric_limits<int64_t>::max() )
+      _markets.erase( itr );
+}
+
+uint64_t recent_trades_index::estimated_memory_usage()const
+{
+   uint64_t result = _markets.size() * ( sizeof( std::pair< const std::pair<asset_id_type,asset_id_type>, market_ring > )
+                                         + 4 * sizeof(void*) );
+   for( const auto& item : _markets )
+      result += item.second.trades.size() * sizeof( recent_trade );
+   return result;
+}
+
 
 
 
@@ -417,17 +521,19 @@ void market_history_plugin::plugin_set_program_options(
            "Will only store this amount of matched orders for each market in order history for querying, or those meet the other option, which has more data (default: 1000)")
          ("max-order-his-seconds-per-market", boost::program_options::value<uint32_t>()->default_value(259200),
            "Will only store matched orders in last X seconds for each market in order history for querying, or those meet the other option, which has more data (default: 259200 (3 days))")
+         ("recent-trades-per-market", boost::program_options::value<uint32_t>()->default_value(200),
+           "How many of the latest order history entries of each market to keep in memory for get_trade_history, two per trade, 0 to read them all from the index (default: 200)")
          ;
    cfg.add(cli);
 }
 
 void market_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
-   database().applied_block.connect( [this]( const signed_block& b){ my->update_market_histories(b); } );
+   database().add_history_consumer( std::make_shared<detail::market_history_consumer>( *my ) );
    database().add_index< primary_index< bucket_index  > >();
-   database().add_index< primary_index< history_index  > >();
+   auto his_index = database().add_index< primary_index< history_index  > >();
    database().add_index< primary_index< market_ticker_index  > >();
-   database().add_index< primary_index< simple_index< market_ticker_meta_object > > >();
+   database().add_index< primary_index< market_ticker_slot_index > >();
 
    if( options.count( "bucket-size" ) )
    {
@@ -441,6 +547,9 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
       my->_max_order_his_records_per_market = options["max-order-his-records-per-market"].as<uint32_t>();
    if( options.count( "max-order-his-seconds-per-market" ) )
       my->_max_order_his_seconds_per_market = options["max-order-his-seconds-per-market"].as<uint32_t>();
+   his_index->add_secondary_index< recent_trades_index >( options.count( "recent-trades-per-market" )
+                                                         ? options["recent-trades-per-market"].as<uint32_t>()
+                                                         : uint32_t(200) );
 } FC_CAPTURE_AND_RETHROW() }
 
 void market_history_plugin::plugin_startup()
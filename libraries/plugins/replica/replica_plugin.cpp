@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/replica/replica_plugin.hpp>
+
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+namespace graphene { namespace replica {
+
+namespace detail
+{
+
+class replica_plugin_impl
+{
+   public:
+      replica_plugin_impl(replica_plugin& _plugin)
+         : _self( _plugin )
+      {  }
+
+      graphene::chain::database& database()
+      {
+         return _self.database();
+      }
+
+      /// polls the primary until the plugin shuts down
+      void follow_loop();
+      /// applies the blocks the primary stored since the last call, @return how many
+      uint32_t catch_up();
+
+      replica_plugin& _self;
+
+      /// the blocks of the primary, under its data dir
+      fc::path                        _primary_blocks_dir;
+      graphene::chain::block_database _primary_blocks;
+      fc::microseconds                _poll_interval = fc::milliseconds( 250 );
+      /// the primary validated the blocks, only what changes the state is checked again
+      uint32_t                        _skip = graphene::chain::database::skip_witness_signature
+                                              | graphene::chain::database::skip_transaction_signatures
+                                              | graphene::chain::database::skip_merkle_check;
+      bool                            _reported_gap = false;
+      fc::future<void>                _follow_task;
+};
+
+uint32_t replica_plugin_impl::catch_up()
+{
+   auto& db = database();
+   _primary_blocks.refresh();
+
+   // a block the primary no longer has was replaced by a fork, the blocks of the new branch follow below
+   uint32_t popped = 0;
+   while( db.head_block_num() > 0 && !_primary_blocks.contains( db.head_block_id() ) )
+   {
+      db.pop_block();
+      ++popped;
+   }
+   if( popped > 0 )
+      ilog( "Replica popped ${n} blocks the primary replaced, head is now #${h}",
+            ("n", popped)("h", db.head_block_num()) );
+
+   const uint32_t first = db.head_block_num() + 1;
+   if( first < _primary_blocks.first_block_num() )
+   {
+      if( !_reported_gap )
+         elog( "The primary pruned block #${n} the replica needs next, bootstrap the replica from a snapshot",
+               ("n", first) );
+      _reported_gap = true;
+      return 0;
+   }
+
+   uint32_t pushed = 0;
+   while( true )
+   {
+      const fc::optional<graphene::chain::signed_block> block = _primary_blocks.fetch_by_number( db.head_block_num() + 1 );
+      if( !block.valid() || block->previous != db.head_block_id() )
+         break;
+      db.push_block( *block, _skip );
+      ++pushed;
+      if( pushed % 10000 == 0 )
+         ilog( "Replica applied block #${n}", ("n", block->block_num()) );
+      // API calls are served between the blocks of a long catch-up
+      fc::yield();
+   }
+   return pushed;
+}
+
+void replica_plugin_impl::follow_loop()
+{
+   while( true )
+   {
+      try
+      {
+         catch_up();
+      }
+      catch( const fc::canceled_exception& )
+      {
+         throw;
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Replica failed to follow the primary in ${d}: ${e}",
+               ("d", _primary_blocks_dir)("e", e.to_detail_string()) );
+      }
+      fc::usleep( _poll_interval );
+   }
+}
+
+} // end namespace detail
+
+replica_plugin::replica_plugin() :
+   my( new detail::replica_plugin_impl(*this) )
+{
+}
+
+replica_plugin::~replica_plugin()
+{
+}
+
+std::string replica_plugin::plugin_name()const
+{
+   return "replica";
+}
+std::string replica_plugin::plugin_description()const
+{
+   return "Follows the block database of a primary node on the same host to serve API reads";
+}
+
+void replica_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("replica-of", boost::program_options::value<boost::filesystem::path>(),
+          "Data directory of the primary node whose blocks this node follows (required for replica)")
+         ("replica-poll-interval-ms", boost::program_options::value<uint32_t>()->default_value(250),
+          "Milliseconds between checks for new blocks of the primary")
+         ;
+   cfg.add(cli);
+}
+
+void replica_plugin::plugin_initialize(const boost::program_options::variables_map& options)
+{
+   FC_ASSERT( options.count("replica-of") > 0, "The replica plugin needs the data directory of its primary" );
+   fc::path primary_dir = options.at("replica-of").as<boost::filesystem::path>();
+   if( primary_dir.is_relative() )
+      primary_dir = fc::current_path() / primary_dir;
+   my->_primary_blocks_dir = primary_dir / "blockchain" / "database" / "block_num_to_block";
+   if( options.count("replica-poll-interval-ms") )
+      my->_poll_interval = fc::milliseconds( std::max<uint32_t>( 1, options.at("replica-poll-interval-ms").as<uint32_t>() ) );
+   if( options.count("seed-node") || options.count("seed-nodes") )
+      wlog( "The replica also syncs from the configured seed nodes, run it without them to only follow the primary" );
+}
+
+void replica_plugin::plugin_startup()
+{
+   my->_primary_blocks.open_read_only( my->_primary_blocks_dir );
+   ilog( "Replica following the blocks in ${d}, head is #${h}",
+         ("d", my->_primary_blocks_dir)("h", database().head_block_num()) );
+   my->_follow_task = fc::async( [this]() { my->follow_loop(); }, "replica follow" );
+}
+
+void replica_plugin::plugin_shutdown()
+{
+   if( my->_follow_task.valid() && !my->_follow_task.ready() )
+   {
+      try
+      {
+         my->_follow_task.cancel_and_wait( __FUNCTION__ );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Replica follow task ended with ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+   my->_primary_blocks.close();
+}
+
+} }
@@ -26,6 +26,7 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/thread/thread.hpp>
 #include <fc/time.hpp>
 
 namespace graphene { namespace snapshot_plugin {
@@ -52,6 +53,10 @@ class snapshot_plugin : public graphene::app::plugin {
        uint32_t           snapshot_block = -1, last_block = 0;
        fc::time_point_sec snapshot_time = fc::time_point_sec::maximum(), last_time = fc::time_point_sec(1);
        fc::path           dest;
+       bool               binary = false;
+       /// writes binary snapshots while the chain moves on
+       std::shared_ptr<fc::thread> writer;
+       fc::future<void>            written;
 };
 
 } } //graphene::snapshot_plugin
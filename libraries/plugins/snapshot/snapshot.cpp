@@ -23,6 +23,7 @@
  */
 #include <graphene/snapshot/snapshot.hpp>
 
+#include <graphene/chain/config.hpp>
 #include <graphene/chain/database.hpp>
 
 #include <fc/io/fstream.hpp>
@@ -36,6 +37,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -45,6 +47,9 @@ void snapshot_plugin::plugin_set_program_options(
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
          (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"),
+          "Format of the snapshot, json or binary. A binary snapshot can be loaded with bootstrap-from-snapshot, "
+          "it is written in the background together with a checksum manifest")
          ;
    config_file_options.add(command_line_options);
 }
@@ -67,6 +72,12 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
    {
       FC_ASSERT( options.count(OPT_DEST), "Must specify snapshot-to in addition to snapshot-at-block or snapshot-at-time!" );
       dest = options[OPT_DEST].as<std::string>();
+      if( options.count(OPT_FORMAT) )
+      {
+         const std::string format = options[OPT_FORMAT].as<std::string>();
+         FC_ASSERT( format == "json" || format == "binary", "Unknown snapshot-format ${f}", ("f",format) );
+         binary = ( format == "binary" );
+      }
       if( options.count(OPT_BLOCK_NUM) )
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) )
@@ -82,7 +93,30 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
 
 void snapshot_plugin::plugin_startup() {}
 
-void snapshot_plugin::plugin_shutdown() {}
+void snapshot_plugin::plugin_shutdown()
+{
+   if( written.valid() && !written.ready() )
+   {
+      ilog("snapshot plugin: waiting for the snapshot to be written");
+      written.wait();
+   }
+   writer.reset();
+}
+
+static void write_binary_snapshot( const graphene::chain::database::captured_state_snapshot& snapshot,
+                                   const fc::path& dest )
+{
+   try
+   {
+      graphene::chain::database::write_state_snapshot( snapshot, dest );
+   }
+   catch ( fc::exception& e )
+   {
+      wlog( "Failed to write binary snapshot: ${ex}", ("ex",e) );
+      return;
+   }
+   ilog("snapshot plugin: created snapshot");
+}
 
 static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
 {
@@ -122,7 +156,34 @@ void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+    {
+       if( binary )
+       {
+          // only packing the state holds up the chain, the file is written in the background
+          ilog("snapshot plugin: creating binary snapshot");
+          std::shared_ptr<graphene::chain::database::captured_state_snapshot> snapshot;
+          try
+          {
+             snapshot = std::make_shared<graphene::chain::database::captured_state_snapshot>(
+                   database().capture_state_snapshot( GRAPHENE_CURRENT_DB_VERSION ) );
+          }
+          catch ( fc::exception& e )
+          {
+             wlog( "Failed to create binary snapshot: ${ex}", ("ex",e) );
+          }
+          if( snapshot )
+          {
+             if( !writer )
+                writer = std::make_shared<fc::thread>( "snapshot" );
+             if( written.valid() )
+                written.wait();
+             const fc::path file = dest;
+             written = writer->async( [snapshot,file] () { write_binary_snapshot( *snapshot, file ); } );
+          }
+       }
+       else
+          create_snapshot( database(), dest );
+    }
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
@@ -42,7 +42,8 @@ namespace block_production_condition
       low_participation = 5,
       lag = 6,
       exception_producing_block = 7,
-      shutdown = 8
+      shutdown = 8,
+      standby = 9
    };
 }
 
@@ -75,11 +76,38 @@ private:
    /// Fetch signing keys of all witnesses in the cache from object database and update the cache accordingly
    void refresh_witness_key_cache();
 
+   void write_heartbeat()const;
+   /// @return true if the primary node of a standby still produces the blocks of the witness
+   bool primary_is_alive( chain::witness_id_type scheduled_witness );
+   /// notices blocks of the configured witnesses that another node produced
+   void on_applied_block( const chain::signed_block& b );
+
    boost::program_options::variables_map _options;
    bool _production_enabled = false;
    bool _shutting_down = false;
    uint32_t _required_witness_participation = 33 * GRAPHENE_1_PERCENT;
    uint32_t _production_skip_flags = graphene::chain::database::skip_nothing;
+   /// how long before its slot a block is produced
+   fc::microseconds _production_lead_time;
+   /// when the production loop should wake up next, and how much later than that it did the last time
+   fc::time_point _scheduled_wakeup;
+   fc::microseconds _wakeup_jitter;
+   /// how long before a slot of the witnesses the objects of the pending transactions are read
+   fc::microseconds _prefetch_lead_time;
+
+   /// written by a producing node before each slot, watched by its standby
+   fc::path _heartbeat_file;
+   /// only produce after the primary node of the witnesses failed
+   bool _standby = false;
+   /// whether a standby took over the production from its primary
+   bool _standby_active = false;
+   /// how long the primary may be silent before the standby takes over
+   fc::microseconds _standby_timeout;
+   /// when the last block of the witnesses produced by another node arrived
+   fc::time_point _last_primary_block;
+   /// missed blocks of the witnesses when the primary was last seen producing
+   std::map<chain::witness_id_type, uint32_t> _missed_at_last_primary_block;
+   bool _generating_block = false;
 
    std::map<chain::public_key_type, fc::ecc::private_key, chain::pubkey_comparator> _private_keys;
    std::set<chain::witness_id_type> _witnesses;
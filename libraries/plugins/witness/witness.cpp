@@ -23,11 +23,15 @@
  */
 #include <graphene/witness/witness.hpp>
 
+#include <graphene/app/block_production_telemetry.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/witness_object.hpp>
 
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/utilities/task_monitor.hpp>
 
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
 #include <fc/thread/thread.hpp>
 
 #include <iostream>
@@ -70,6 +74,19 @@ void witness_plugin::plugin_set_program_options(
          ("private-key", bpo::value<vector<string>>()->composing()->multitoken()->
           DEFAULT_VALUE_VECTOR(std::make_pair(chain::public_key_type(default_priv_key.get_public_key()), graphene::utilities::key_to_wif(default_priv_key))),
           "Tuple of [PublicKey, WIF private key] (may specify multiple times)")
+         ("production-lead-time-ms", bpo::value<uint32_t>()->default_value(0),
+          "Milliseconds before each slot to wake up and produce the block of the slot, less than 500")
+         ("prefetch-lead-time-ms", bpo::value<uint32_t>()->default_value(200),
+          "Milliseconds before each slot of the configured witnesses to read the objects that the pending "
+          "transactions touch, 0 to disable")
+         ("standby", bpo::bool_switch()->default_value(false),
+          "Only produce the blocks of the configured witnesses after their primary node failed")
+         ("heartbeat-file", bpo::value<string>(),
+          "File that a producing node writes before each slot and a standby node watches, "
+          "on storage shared by both. Without it the standby takes over after the first missed block")
+         ("standby-timeout-ms", bpo::value<uint32_t>()->default_value(0),
+          "Milliseconds without a heartbeat or block of the primary before the standby takes over, "
+          "0 for two block intervals")
          ;
    config_file_options.add(command_line_options);
 }
@@ -84,6 +101,19 @@ void witness_plugin::plugin_initialize(const boost::program_options::variables_m
    ilog("witness plugin:  plugin_initialize() begin");
    _options = &options;
    LOAD_VALUE_SET(options, "witness-id", _witnesses, chain::witness_id_type)
+   if( options.count("production-lead-time-ms") )
+   {
+      _production_lead_time = fc::milliseconds( options["production-lead-time-ms"].as<uint32_t>() );
+      // the slot is taken from the wakeup time rounded to the nearest second
+      FC_ASSERT( _production_lead_time < fc::milliseconds( 500 ), "production-lead-time-ms must be less than 500" );
+   }
+   if( options.count("prefetch-lead-time-ms") )
+      _prefetch_lead_time = fc::milliseconds( options["prefetch-lead-time-ms"].as<uint32_t>() );
+   _standby = options.count("standby") && options["standby"].as<bool>();
+   if( options.count("heartbeat-file") )
+      _heartbeat_file = options["heartbeat-file"].as<string>();
+   if( options.count("standby-timeout-ms") )
+      _standby_timeout = fc::milliseconds( options["standby-timeout-ms"].as<uint32_t>() );
 
    if( options.count("private-key") )
    {
@@ -126,11 +156,25 @@ void witness_plugin::plugin_startup()
             new_chain_banner(d);
          _production_skip_flags |= graphene::chain::database::skip_undo_history_check;
       }
+      d.enable_block_pre_assembly( true );
       refresh_witness_key_cache();
       d.applied_block.connect( [this]( const chain::signed_block& b )
       {
          refresh_witness_key_cache();
+         on_applied_block( b );
       });
+      if( _standby )
+      {
+         if( _standby_timeout == fc::microseconds() )
+            _standby_timeout = fc::seconds( 2 * d.get_global_properties().parameters.block_interval );
+         for( const chain::witness_id_type wit_id : _witnesses )
+         {
+            const chain::witness_object* wit_obj = d.find( wit_id );
+            _missed_at_last_primary_block[wit_id] = wit_obj ? wit_obj->total_missed : 0;
+         }
+         ilog( "Standing by for ${n} witnesses, taking over after ${ms} ms without the primary",
+               ("n", _witnesses.size())("ms", _standby_timeout.count() / 1000) );
+      }
       schedule_production_loop();
    }
    else
@@ -172,27 +216,110 @@ void witness_plugin::refresh_witness_key_cache()
    }
 }
 
+void witness_plugin::write_heartbeat()const
+{
+   // a missing heartbeat must not keep the primary from producing
+   try
+   {
+      const fc::path tmp = _heartbeat_file.generic_string() + ".tmp";
+      fc::json::save_to_file( fc::variant( fc::time_point::now() ), tmp );
+      fc::rename( tmp, _heartbeat_file );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to write the heartbeat to ${f}: ${e}", ("f", _heartbeat_file)("e", e.to_detail_string()) );
+   }
+}
+
+bool witness_plugin::primary_is_alive( chain::witness_id_type scheduled_witness )
+{
+   const fc::time_point now = fc::time_point::now();
+   if( now - _last_primary_block < _standby_timeout )
+      return true;
+
+   if( !_heartbeat_file.empty() )
+   {
+      try
+      {
+         if( fc::exists( _heartbeat_file ) )
+            return now - fc::json::from_file( _heartbeat_file ).as<fc::time_point>( 1 ) < _standby_timeout;
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Unable to read the heartbeat of the primary: ${e}", ("e", e.to_detail_string()) );
+      }
+      return false;
+   }
+
+   // without a heartbeat the primary failed once the witness missed a block after the last one the primary produced
+   const chain::witness_object* wit_obj = database().find( scheduled_witness );
+   auto itr = _missed_at_last_primary_block.find( scheduled_witness );
+   if( wit_obj == nullptr || itr == _missed_at_last_primary_block.end() )
+      return true;
+   return wit_obj->total_missed <= itr->second;
+}
+
+void witness_plugin::on_applied_block( const chain::signed_block& b )
+{
+   if( !_standby || _generating_block || _witnesses.find( b.witness ) == _witnesses.end() )
+      return;
+
+   // the primary is producing, never race it on the same keys
+   _last_primary_block = fc::time_point::now();
+   const chain::database& db = database();
+   for( auto& missed : _missed_at_last_primary_block )
+   {
+      const chain::witness_object* wit_obj = db.find( missed.first );
+      if( wit_obj )
+         missed.second = wit_obj->total_missed;
+   }
+   if( _standby_active )
+   {
+      wlog( "Witness ${w} produced block #${n} on another node, standing by again",
+            ("w", b.witness)("n", b.block_num()) );
+      _standby_active = false;
+   }
+}
+
 void witness_plugin::schedule_production_loop()
 {
    if (_shutting_down) return;
 
-   //Schedule for the next second's tick regardless of chain state
-   // If we would wait less than 50ms, wait for the whole second.
-   fc::time_point now = fc::time_point::now();
-   int64_t time_to_next_second = 1000000 - (now.time_since_epoch().count() % 1000000);
-   if( time_to_next_second < 50000 )      // we must sleep for at least 50ms
-       time_to_next_second += 1000000;
-
-   fc::time_point next_wakeup( now + fc::microseconds( time_to_next_second ) );
+   // Wake up _production_lead_time before the next slot. If the timer fired a little early for the slot that was
+   // just handled, that slot is still the next one, the minimum sleep skips it.
+   const chain::database& db = database();
+   const fc::time_point now = fc::time_point::now();
+   uint32_t next_slot = db.get_slot_at_time( now + _production_lead_time ) + 1;
+   fc::time_point next_wakeup = fc::time_point( db.get_slot_time( next_slot ) ) - _production_lead_time;
+   if( next_wakeup - now < fc::milliseconds( 50 ) )      // we must sleep for at least 50ms
+      next_wakeup = fc::time_point( db.get_slot_time( ++next_slot ) ) - _production_lead_time;
+   _scheduled_wakeup = next_wakeup;
+
+   // before a slot of ours, read what the pending transactions touch while the chain would be idle anyway
+   const fc::time_point prefetch_time = next_wakeup - _prefetch_lead_time;
+   if( _prefetch_lead_time > fc::microseconds() && prefetch_time - now >= fc::milliseconds( 50 )
+         && _witnesses.find( db.get_scheduled_witness( next_slot ) ) != _witnesses.end() )
+   {
+      _block_production_task = fc::schedule([this]{
+         const size_t touched = database().prefetch_pending_objects();
+         dlog( "Prefetched ${n} objects of pending transactions", ("n", touched) );
+         const fc::microseconds remaining = _scheduled_wakeup - fc::time_point::now();
+         if( remaining > fc::microseconds() )
+            fc::usleep( remaining );
+         block_production_loop();
+      }, prefetch_time, "Witness Block Production");
+      return;
+   }
 
-   _block_production_task = fc::schedule([this]{block_production_loop();},
-                                         next_wakeup, "Witness Block Production");
+   _block_production_task = graphene::utilities::monitored_schedule([this]{block_production_loop();},
+                                                                     next_wakeup, "Witness Block Production");
 }
 
 block_production_condition::block_production_condition_enum witness_plugin::block_production_loop()
 {
    block_production_condition::block_production_condition_enum result;
    fc::limited_mutable_variant_object capture( GRAPHENE_MAX_NESTED_OBJECTS );
+   _wakeup_jitter = fc::time_point::now() - _scheduled_wakeup;
 
    if (_shutting_down) 
    {
@@ -202,6 +329,8 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    {
       try
       {
+         if( !_standby && !_heartbeat_file.empty() )
+            write_heartbeat();
          result = maybe_produce_block(capture);
       }
       catch( const fc::canceled_exception& )
@@ -219,7 +348,7 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}", (capture));
+         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c} in ${ms} ms", (capture));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block (see: --enable-stale-production)");
@@ -240,6 +369,8 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
       case block_production_condition::exception_producing_block:
          elog( "exception producing block" );
          break;
+      case block_production_condition::standby:
+         break;
       case block_production_condition::shutdown:
          ilog( "shutdown producing block" );
          return result;
@@ -316,14 +447,57 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       return block_production_condition::lag;
    }
 
-   auto block = db.generate_block(
-      scheduled_time,
-      scheduled_witness,
-      private_key_itr->second,
-      _production_skip_flags
-      );
-   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size());
-   fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+   if( _standby )
+   {
+      if( primary_is_alive( scheduled_witness ) )
+      {
+         _standby_active = false;
+         return block_production_condition::standby;
+      }
+      if( !_standby_active )
+         wlog( "The primary of witness ${w} failed, taking over block production", ("w", scheduled_witness) );
+      _standby_active = true;
+   }
+
+   _generating_block = true;
+   chain::signed_block block;
+   try
+   {
+      block = db.generate_block(
+         scheduled_time,
+         scheduled_witness,
+         private_key_itr->second,
+         _production_skip_flags
+         );
+   }
+   catch( ... )
+   {
+      _generating_block = false;
+      throw;
+   }
+   _generating_block = false;
+   const chain::block_generation_timing& timing = db.get_last_generation_timing();
+   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size())
+          ("ms", ( timing.assemble + timing.apply ).count() / 1000);
+
+   std::shared_ptr<app::block_production_telemetry> telemetry = app().get_options().block_production;
+   if( telemetry )
+   {
+      app::block_production_record record;
+      record.block_num = block.block_num();
+      record.timestamp = block.timestamp;
+      record.transaction_count = block.transactions.size();
+      record.wakeup_jitter_us = _wakeup_jitter.count();
+      record.generate_us = timing.assemble.count();
+      record.apply_us = timing.apply.count();
+      telemetry->record( record );
+   }
+   graphene::utilities::monitored_async( [this,block,telemetry](){
+      const fc::time_point start = fc::time_point::now();
+      p2p_node().broadcast(net::block_message(block));
+      if( telemetry )
+         telemetry->set_broadcast_time( block.block_num(), fc::time_point::now() - start );
+   }, "Witness Broadcast Block" );
 
    return block_production_condition::produced;
 }
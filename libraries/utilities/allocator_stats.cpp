@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/allocator_stats.hpp>
+
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__GNUC__) && !defined(_WIN32)
+// Declared weak so that they are null unless the executable is linked with the allocator that defines them
+extern "C" {
+   int mallctl( const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen ) __attribute__((weak));
+   int MallocExtension_GetNumericProperty( const char* property, size_t* value ) __attribute__((weak));
+}
+#define GRAPHENE_DETECT_ALLOCATOR
+#endif
+
+namespace graphene { namespace utilities {
+
+namespace {
+
+#ifdef GRAPHENE_DETECT_ALLOCATOR
+   uint64_t jemalloc_stat( const char* name )
+   {
+      size_t value = 0;
+      size_t size = sizeof(value);
+      return mallctl( name, &value, &size, nullptr, 0 ) == 0 ? value : 0;
+   }
+
+   uint64_t tcmalloc_stat( const char* name )
+   {
+      size_t value = 0;
+      return MallocExtension_GetNumericProperty( name, &value ) ? value : 0;
+   }
+#endif
+
+#if defined(__GLIBC__)
+   /// the fields of mallinfo are ints, read them as unsigned to get up to 4 GiB out of them
+   template<typename T>
+   uint64_t mallinfo_bytes( T field )
+   {
+      return static_cast<typename std::make_unsigned<T>::type>( field );
+   }
+#endif
+
+} // anonymous namespace
+
+allocator_stats get_allocator_stats()
+{
+   allocator_stats result;
+#ifdef GRAPHENE_DETECT_ALLOCATOR
+   if( mallctl != nullptr )
+   {
+      // the statistics of jemalloc are a snapshot taken when the epoch advances
+      uint64_t epoch = 1;
+      size_t size = sizeof(epoch);
+      mallctl( "epoch", &epoch, &size, &epoch, size );
+      result.allocator = "jemalloc";
+      result.allocated_bytes = jemalloc_stat( "stats.allocated" );
+      result.mapped_bytes = jemalloc_stat( "stats.mapped" );
+      const uint64_t active = jemalloc_stat( "stats.active" );
+      // dirty pages are part of mapped but not of active
+      result.free_bytes = ( active - result.allocated_bytes ) + ( result.mapped_bytes - active );
+      return result;
+   }
+   if( MallocExtension_GetNumericProperty != nullptr )
+   {
+      result.allocator = "tcmalloc";
+      result.allocated_bytes = tcmalloc_stat( "generic.current_allocated_bytes" );
+      // unmapped pages are counted in the heap size but returned to the operating system
+      result.mapped_bytes = tcmalloc_stat( "generic.heap_size" )
+                            - tcmalloc_stat( "tcmalloc.pageheap_unmapped_bytes" );
+      result.free_bytes = result.mapped_bytes > result.allocated_bytes
+                          ? result.mapped_bytes - result.allocated_bytes : 0;
+      return result;
+   }
+#endif
+#if defined(__GLIBC__)
+   result.allocator = "glibc";
+#if __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 33 )
+   const struct mallinfo2 info = mallinfo2();
+#else
+   const struct mallinfo info = mallinfo();
+#endif
+   // chunks of hblkhd are mmapped one by one for large allocations and unmapped when freed
+   result.allocated_bytes = mallinfo_bytes( info.uordblks ) + mallinfo_bytes( info.hblkhd );
+   result.mapped_bytes = mallinfo_bytes( info.arena ) + mallinfo_bytes( info.hblkhd );
+   result.free_bytes = mallinfo_bytes( info.fordblks );
+#endif
+   return result;
+}
+
+} } // graphene::utilities
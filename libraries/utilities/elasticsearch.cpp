@@ -28,6 +28,12 @@
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <zlib.h>
+
 size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
 {
    ((std::string*)userp)->append((char*)contents, size * nmemb);
@@ -79,6 +85,152 @@ bool SendBulk(ES&& es)
    return false;
 }
 
+BulkSender::BulkSender(const std::string& elasticsearch_url, const std::string& auth, uint32_t max_queued,
+                       uint32_t concurrency, bool compress)
+   : _url(elasticsearch_url + "_bulk"), _auth(auth), _max_queued(std::max(max_queued, 1u)), _compress(compress)
+{
+   for(uint32_t i = 0; i < std::max(concurrency, 1u); ++i)
+      _threads.emplace_back([this]{ sendLoop(); });
+}
+
+BulkSender::~BulkSender()
+{
+   {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if(!_queue.empty())
+         elog("Giving up on ${n} bulks that were not sent to elasticsearch", ("n", _queue.size()));
+      _stopping = true;
+   }
+   _work_cv.notify_all();
+   _done_cv.notify_all();
+   for(std::thread& t : _threads)
+      t.join();
+}
+
+void BulkSender::send(std::vector<std::string>&& bulk_lines, uint32_t complete_block)
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+   if(_queue.size() >= _max_queued)
+   {
+      wlog("Elasticsearch is ${n} bulks behind, waiting for it", ("n", _queue.size()));
+      _done_cv.wait(lock, [this]{ return _queue.size() < _max_queued || _stopping; });
+   }
+   _queue.push_back(bulk{_next_sequence, complete_block, std::move(bulk_lines)});
+   _pending.push_back(pending_bulk{_next_sequence, complete_block, false});
+   ++_next_sequence;
+   lock.unlock();
+   _work_cv.notify_one();
+}
+
+bool BulkSender::flush(const fc::microseconds& timeout)
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+   return _done_cv.wait_for(lock, std::chrono::microseconds(timeout.count()),
+                            [this]{ return _queue.empty() && _sending == 0; });
+}
+
+size_t BulkSender::queued()const
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+   return _queue.size() + _sending;
+}
+
+uint32_t BulkSender::acknowledged_block()const
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+   return _acknowledged_block;
+}
+
+void BulkSender::sendLoop()
+{
+   // reusing the handle reuses its connection
+   CURL* handler = curl_easy_init();
+   curl_easy_setopt(handler, CURLOPT_TCP_KEEPALIVE, 1L);
+   curl_easy_setopt(handler, CURLOPT_TIMEOUT, 120L);
+   std::unique_lock<std::mutex> lock(_mutex);
+   while(true)
+   {
+      _work_cv.wait(lock, [this]{ return !_queue.empty() || _stopping; });
+      if(_stopping)
+         break;
+      bulk next = std::move(_queue.front());
+      _queue.pop_front();
+      ++_sending;
+      lock.unlock();
+      _done_cv.notify_all();
+
+      const std::string body = _compress ? gzipCompress(joinBulkLines(next.lines)) : joinBulkLines(next.lines);
+      std::chrono::milliseconds backoff(100);
+      bool done = false;
+      lock.lock();
+      while(!_stopping)
+      {
+         lock.unlock();
+         done = post(handler, body);
+         lock.lock();
+         if(done)
+            break;
+         _work_cv.wait_for(lock, backoff, [this]{ return _stopping; });
+         backoff = std::min(backoff * 2, std::chrono::milliseconds(30000));
+      }
+      if(done)
+      {
+         // with several threads bulks finish out of order, only a gapless prefix of them is acknowledged
+         for(pending_bulk& p : _pending)
+            if(p.sequence == next.sequence)
+               p.done = true;
+         while(!_pending.empty() && _pending.front().done)
+         {
+            _acknowledged_block = std::max(_acknowledged_block, _pending.front().complete_block);
+            _pending.pop_front();
+         }
+      }
+      --_sending;
+      _done_cv.notify_all();
+   }
+   lock.unlock();
+   curl_easy_cleanup(handler);
+}
+
+bool BulkSender::post(CURL* handler, const std::string& body)
+{ try {
+   CurlRequest curl_request;
+   curl_request.handler = handler;
+   curl_request.url = _url;
+   curl_request.auth = _auth;
+   curl_request.type = "POST";
+   curl_request.query = body;
+   if(_compress)
+      curl_request.content_encoding = "gzip";
+   const std::string response = doCurl(curl_request);
+   const long http_code = getResponseCode(handler);
+
+   if(http_code == 200)
+   {
+      // sending the items elasticsearch rejected again would not help
+      if(!handleBulkResponse(http_code, response))
+         elog("Elasticsearch rejected items of a bulk: ${r}", ("r", response.substr(0, 1000)));
+      return true;
+   }
+   if(http_code == 0)
+   {
+      wlog("Elasticsearch is not reachable at ${u}, retrying", ("u", _url));
+      return false;
+   }
+   // only an overloaded or failing cluster may take the bulk later, it would reject anything else again
+   if(http_code == 429 || (http_code >= 500 && http_code < 600))
+   {
+      wlog("Elasticsearch answered ${c}, retrying: ${r}", ("c", http_code)("r", response.substr(0, 1000)));
+      return false;
+   }
+   elog("Elasticsearch answered ${c}, dropping a bulk of ${n} bytes: ${r}",
+        ("c", http_code)("n", body.size())("r", response.substr(0, 1000)));
+   return true;
+} catch(const fc::exception& e) {
+   elog("Unable to send a bulk to elasticsearch: ${e}", ("e", e.to_detail_string()));
+   return false;
+} }
+
 const std::string joinBulkLines(const std::vector<std::string>& bulk)
 {
    auto bulking = boost::algorithm::join(bulk, "\n");
@@ -86,6 +238,38 @@ const std::string joinBulkLines(const std::vector<std::string>& bulk)
 
    return bulking;
 }
+const std::string gzipCompress(const std::string& data)
+{
+   z_stream stream;
+   memset(&stream, 0, sizeof(stream));
+   // 16 added to the window bits writes a gzip header and trailer around the deflate stream
+   FC_ASSERT(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+   std::string result(deflateBound(&stream, data.size()), '\0');
+   stream.next_in = (Bytef*)data.data();
+   stream.avail_in = data.size();
+   stream.next_out = (Bytef*)&result[0];
+   stream.avail_out = result.size();
+   const int status = deflate(&stream, Z_FINISH);
+   result.resize(stream.total_out);
+   deflateEnd(&stream);
+   FC_ASSERT(status == Z_STREAM_END, "Unable to compress a bulk, zlib error ${s}", ("s", status));
+   return result;
+}
+
+uint32_t loadLastBlock(const fc::path& file)
+{
+   if(!fc::exists(file))
+      return 0;
+   return fc::json::from_file(file).as<uint32_t>(1);
+}
+
+void saveLastBlock(const fc::path& file, uint32_t block_num)
+{
+   const fc::path tmp = file.generic_string() + ".tmp";
+   fc::json::save_to_file(fc::variant(block_num), tmp);
+   fc::rename(tmp, file);
+}
+
 long getResponseCode(CURL *handler)
 {
    long http_code = 0;
@@ -168,6 +352,8 @@ const std::string doCurl(CurlRequest& curl)
    std::string CurlReadBuffer;
    struct curl_slist *headers = NULL;
    headers = curl_slist_append(headers, "Content-Type: application/json");
+   if(!curl.content_encoding.empty())
+      headers = curl_slist_append(headers, ("Content-Encoding: " + curl.content_encoding).c_str());
 
    curl_easy_setopt(curl.handler, CURLOPT_HTTPHEADER, headers);
    curl_easy_setopt(curl.handler, CURLOPT_URL, curl.url.c_str());
@@ -176,6 +362,8 @@ const std::string doCurl(CurlRequest& curl)
    {
       curl_easy_setopt(curl.handler, CURLOPT_POST, true);
       curl_easy_setopt(curl.handler, CURLOPT_POSTFIELDS, curl.query.c_str());
+      // compressed queries contain zeros
+      curl_easy_setopt(curl.handler, CURLOPT_POSTFIELDSIZE, (long)curl.query.size());
    }
    curl_easy_setopt(curl.handler, CURLOPT_WRITEFUNCTION, WriteCallback);
    curl_easy_setopt(curl.handler, CURLOPT_WRITEDATA, (void *)&CurlReadBuffer);
@@ -183,6 +371,8 @@ const std::string doCurl(CurlRequest& curl)
    if(!curl.auth.empty())
       curl_easy_setopt(curl.handler, CURLOPT_USERPWD, curl.auth.c_str());
    curl_easy_perform(curl.handler);
+   curl_easy_setopt(curl.handler, CURLOPT_HTTPHEADER, NULL);
+   curl_slist_free_all(headers);
 
    return CurlReadBuffer;
 }
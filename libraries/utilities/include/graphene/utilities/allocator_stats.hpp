@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace graphene { namespace utilities {
+
+   /**
+    * What the heap allocator of the process holds
+    *
+    * The allocator is detected at run time, so this reports on whichever allocator the executable was linked with:
+    * jemalloc, tcmalloc or the one of glibc. Fragmentation shows as free_bytes, memory the allocator holds in its
+    * pools but the process does not use.
+    */
+   struct allocator_stats
+   {
+      /// jemalloc, tcmalloc, glibc or unknown, the byte counts are 0 for unknown
+      std::string allocator = "unknown";
+      /// in use by the process
+      uint64_t    allocated_bytes = 0;
+      /// obtained from the operating system by the allocator
+      uint64_t    mapped_bytes = 0;
+      /// mapped but not allocated, i.e. free memory in the pools of the allocator
+      uint64_t    free_bytes = 0;
+   };
+
+   allocator_stats get_allocator_stats();
+
+} } // graphene::utilities
+
+FC_REFLECT( graphene::utilities::allocator_stats, (allocator)(allocated_bytes)(mapped_bytes)(free_bytes) )
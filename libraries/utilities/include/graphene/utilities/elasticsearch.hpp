@@ -22,11 +22,16 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <curl/curl.h>
+#include <fc/filesystem.hpp>
 #include <fc/time.hpp>
 #include <fc/variant_object.hpp>
 
@@ -51,6 +56,63 @@ namespace graphene { namespace utilities {
          std::string type;
          std::string auth;
          std::string query;
+         std::string content_encoding; ///< of the query, empty if it is not encoded
+   };
+
+   /**
+    * Sends bulk requests on threads of its own, each of which keeps its connection to elasticsearch open between
+    * requests. A bulk that fails is retried with exponential backoff until it is accepted, only bulks elasticsearch
+    * rejected items of are given up on. send() only waits while max_queued bulks are waiting already, so a slow
+    * cluster delays the indexing instead of the caller. With compress the requests are sent gzip compressed.
+    *
+    * Every bulk is sent with the last block whose documents it completes, acknowledged_block() is the highest one
+    * of them that elasticsearch took together with all bulks sent before it.
+    */
+   class BulkSender {
+      public:
+         BulkSender(const std::string& elasticsearch_url, const std::string& auth, uint32_t max_queued,
+                    uint32_t concurrency, bool compress = false);
+         /// gives up on the bulks that are still queued
+         ~BulkSender();
+
+         void send(std::vector<std::string>&& bulk_lines, uint32_t complete_block = 0);
+         /// waits until every queued bulk was sent, or timeout passed, @return whether they were
+         bool flush(const fc::microseconds& timeout);
+         size_t queued()const;
+         uint32_t acknowledged_block()const;
+
+      private:
+         struct bulk {
+            uint64_t                 sequence;
+            uint32_t                 complete_block;
+            std::vector<std::string> lines;
+         };
+         /// the sequence and block of a bulk that was handed to send(), and whether it was sent
+         struct pending_bulk {
+            uint64_t sequence;
+            uint32_t complete_block;
+            bool     done;
+         };
+
+         void sendLoop();
+         /// @return whether the bulk was done with, false if it should be sent again, which is only tried when
+         /// elasticsearch was not reachable, answered 429 or a 5xx status
+         bool post(CURL* handler, const std::string& body);
+
+         const std::string                       _url;
+         const std::string                       _auth;
+         const uint32_t                          _max_queued;
+         const bool                              _compress;
+         mutable std::mutex                      _mutex;
+         std::condition_variable                 _work_cv;  ///< a bulk was queued or the sender is stopping
+         std::condition_variable                 _done_cv;  ///< a bulk left the queue or was sent
+         std::deque<bulk>                        _queue;
+         std::deque<pending_bulk>                _pending;
+         uint64_t                                _next_sequence = 0;
+         uint32_t                                _acknowledged_block = 0;
+         uint32_t                                _sending = 0;
+         bool                                    _stopping = false;
+         std::vector<std::thread>                _threads;
    };
 
    bool SendBulk(ES&& es);
@@ -63,6 +125,11 @@ namespace graphene { namespace utilities {
    const std::string generateIndexName(const fc::time_point_sec& block_date, const std::string& _elasticsearch_index_prefix);
    const std::string doCurl(CurlRequest& curl);
    const std::string joinBulkLines(const std::vector<std::string>& bulk);
+   const std::string gzipCompress(const std::string& data);
    long getResponseCode(CURL *handler);
 
+   /// @return the block saved to file by saveLastBlock(), 0 if there is none
+   uint32_t loadLastBlock(const fc::path& file);
+   void saveLastBlock(const fc::path& file, uint32_t block_num);
+
 } } // end namespace graphene::utilities
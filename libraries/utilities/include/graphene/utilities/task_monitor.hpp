@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+   /// The tasks of one source that ran on the monitored thread, sources are told apart by their fc task description
+   struct task_source_stats
+   {
+      std::string description;
+      uint64_t    runs = 0;
+      int64_t     total_us = 0;
+      int64_t     max_us = 0;
+      /// time from being queued, or from being due for scheduled tasks, until the task started
+      int64_t     total_wait_us = 0;
+   };
+
+   /// One of the longest tasks since the last reset
+   struct task_run
+   {
+      std::string    description;
+      fc::time_point start;
+      int64_t        duration_us = 0;
+   };
+
+   /// The task queue of the monitored thread at one point in time
+   struct task_queue_sample
+   {
+      fc::time_point time;
+      /// monitored tasks posted to the thread but not started yet
+      uint32_t       queued = 0;
+      /// how late the sampling task itself ran, a saturated thread runs it late
+      int64_t        lag_us = 0;
+   };
+
+   struct task_monitor_report
+   {
+      bool                           enabled = false;
+      uint32_t                       queued = 0;
+      /// the oldest first
+      std::vector<task_queue_sample> samples;
+      /// the most total run time first
+      std::vector<task_source_stats> sources;
+      /// the longest first
+      std::vector<task_run>          longest_tasks;
+   };
+
+   /**
+    * @brief Samples the task queue of a thread and the run time of its tasks by source
+    *
+    * Only the tasks posted through monitored_async() and monitored_schedule(), or timed by a scope, are seen, fc
+    * offers no view of the whole queue of a thread. Run times are wall time, so they include the time a task
+    * spent yielded waiting for a future. Does nothing until enabled.
+    */
+   class task_monitor
+   {
+      public:
+         static const size_t max_samples = 300;
+         static const size_t max_longest_tasks = 20;
+
+         /// the monitor of the thread the chain, the API calls and the p2p delegate calls run on
+         static task_monitor& chain_thread();
+
+         void enable( bool enabled ) { _enabled.store( enabled, std::memory_order_relaxed ); }
+         bool is_enabled()const { return _enabled.load( std::memory_order_relaxed ); }
+
+         /// A task that was posted to the thread, queued until it starts or is destroyed without having run
+         class pending_task
+         {
+            public:
+               explicit pending_task( task_monitor& monitor );
+               ~pending_task() { start(); }
+               pending_task( const pending_task& ) = delete;
+               pending_task& operator=( const pending_task& ) = delete;
+
+               void start();
+               const fc::time_point& posted()const { return _posted; }
+
+            private:
+               task_monitor&        _monitor;
+               const fc::time_point _posted;
+               std::atomic<bool>    _started;
+         };
+
+         /// Times a task from construction to destruction, description must outlive the monitor
+         class scope
+         {
+            public:
+               /// @param ready when the task was posted or due, for its wait time
+               scope( task_monitor& monitor, const char* description, const fc::time_point& ready = fc::time_point() );
+               ~scope();
+               scope( const scope& ) = delete;
+               scope& operator=( const scope& ) = delete;
+
+            private:
+               task_monitor&  _monitor;
+               const char*    _description;
+               fc::time_point _ready;
+               fc::time_point _start;
+         };
+
+         /// records the queue depth, due is when the sample should have been taken
+         void sample( const fc::time_point& due );
+         /// takes a sample every interval on the current thread, until stop_sampling()
+         void start_sampling( const fc::microseconds& interval );
+         void stop_sampling();
+
+         task_monitor_report get_report()const;
+         void reset();
+
+      private:
+         void schedule_sample( const fc::time_point& due );
+         void record_run( const char* description, const fc::time_point& start, const fc::time_point& end,
+                          const fc::time_point& ready );
+
+         std::atomic<bool>     _enabled{ false };
+         std::atomic<uint32_t> _queued{ 0 };
+
+         mutable std::mutex _mutex;
+         /// by the address of the description, sources with equal descriptions are merged in the report
+         std::unordered_map<const char*, task_source_stats> _sources;
+         std::vector<task_run>                               _longest;
+         std::deque<task_queue_sample>                       _samples;
+
+         fc::microseconds   _sample_interval;
+         fc::future<void>   _sampling_task;
+   };
+
+   /// A functor that reports its run to a task_monitor, see monitored_async() and monitored_schedule()
+   template<typename Functor>
+   class monitored_task
+   {
+      public:
+         monitored_task( task_monitor& monitor, const char* description, Functor&& functor, bool queued,
+                         const fc::time_point& due = fc::time_point() )
+            : _monitor( &monitor ), _description( description ), _due( due ),
+              _pending( queued && monitor.is_enabled() ? std::make_shared<task_monitor::pending_task>( monitor )
+                                                       : nullptr ),
+              _functor( std::move( functor ) ) {}
+
+         auto operator()() -> decltype( std::declval<Functor&>()() )
+         {
+            fc::time_point ready = _due;
+            if( _pending )
+            {
+               _pending->start();
+               ready = _pending->posted();
+            }
+            task_monitor::scope run( *_monitor, _description, ready );
+            return _functor();
+         }
+
+      private:
+         task_monitor*                               _monitor;
+         const char*                                 _description;
+         fc::time_point                              _due;
+         std::shared_ptr<task_monitor::pending_task> _pending;
+         Functor                                     _functor;
+   };
+
+   /// fc::thread::async() that the chain thread monitor sees queued and running, for tasks run on the chain thread
+   template<typename Functor>
+   auto monitored_async( fc::thread& thread, Functor&& f, const char* description )
+      -> fc::future<decltype( f() )>
+   {
+      typedef typename std::decay<Functor>::type functor_type;
+      return thread.async( monitored_task<functor_type>( task_monitor::chain_thread(), description,
+                                                         functor_type( std::forward<Functor>( f ) ), true ),
+                           description );
+   }
+
+   /// fc::async() on the current thread, which must be the chain thread, see monitored_async( thread, f, description )
+   template<typename Functor>
+   auto monitored_async( Functor&& f, const char* description ) -> fc::future<decltype( f() )>
+   {
+      return monitored_async( fc::thread::current(), std::forward<Functor>( f ), description );
+   }
+
+   /// fc::schedule() on the current thread, which must be the chain thread, the task is not queued until it is due
+   template<typename Functor>
+   auto monitored_schedule( Functor&& f, const fc::time_point& when, const char* description )
+      -> fc::future<decltype( f() )>
+   {
+      typedef typename std::decay<Functor>::type functor_type;
+      return fc::schedule( monitored_task<functor_type>( task_monitor::chain_thread(), description,
+                                                         functor_type( std::forward<Functor>( f ) ), false, when ),
+                           when, description );
+   }
+
+} }
+
+FC_REFLECT( graphene::utilities::task_source_stats, (description)(runs)(total_us)(max_us)(total_wait_us) )
+FC_REFLECT( graphene::utilities::task_run, (description)(start)(duration_us) )
+FC_REFLECT( graphene::utilities::task_queue_sample, (time)(queued)(lag_us) )
+FC_REFLECT( graphene::utilities::task_monitor_report, (enabled)(queued)(samples)(sources)(longest_tasks) )
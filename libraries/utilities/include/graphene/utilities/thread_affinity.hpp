@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+   /**
+    * Parses a comma separated list of CPUs, ranges like 4-7 and NUMA nodes like node:1 for all CPUs of that node.
+    * @return the CPUs in ascending order without duplicates
+    */
+   std::vector<uint32_t> parse_cpu_set( const std::string& spec );
+
+   /**
+    * Parses a list like parse_cpu_set() does, e.g. for pinning threads one by one.
+    * @return the CPUs in the listed order, repetitions included
+    */
+   std::vector<uint32_t> parse_cpu_order( const std::string& spec );
+
+   /** @return the given CPUs in the notation of parse_cpu_set(), with ranges */
+   std::string format_cpu_set( const std::vector<uint32_t>& cpus );
+
+   /** @return the CPUs of a NUMA node, empty if the node does not exist or NUMA is not supported */
+   std::vector<uint32_t> numa_node_cpus( uint32_t node );
+
+   /** @return the NUMA nodes the given CPUs belong to */
+   std::vector<uint32_t> numa_nodes_of( const std::vector<uint32_t>& cpus );
+
+   /**
+    * Lets the calling thread run on the given CPUs only. Threads it starts afterwards inherit the restriction.
+    * Only supported on Linux, elsewhere a warning is logged.
+    */
+   void set_current_thread_cpus( const std::vector<uint32_t>& cpus );
+
+   /** @return the CPUs the calling thread may run on, empty if unknown */
+   std::vector<uint32_t> get_current_thread_cpus();
+
+   /**
+    * Makes the calling thread allocate its memory on the given NUMA node while the node has free memory. Threads it
+    * starts afterwards inherit the preference. Only supported on Linux, elsewhere a warning is logged.
+    */
+   void prefer_numa_node_memory( uint32_t node );
+
+   /** @return where the calling thread may run and allocate, e.g. "CPUs 0-7 (NUMA node 0)" */
+   std::string describe_current_thread_placement();
+
+} } // graphene::utilities
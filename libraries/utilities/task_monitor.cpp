@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/task_monitor.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace graphene { namespace utilities {
+
+task_monitor& task_monitor::chain_thread()
+{
+   static task_monitor monitor;
+   return monitor;
+}
+
+task_monitor::pending_task::pending_task( task_monitor& monitor )
+   : _monitor( monitor ), _posted( fc::time_point::now() ), _started( false )
+{
+   ++_monitor._queued;
+}
+
+void task_monitor::pending_task::start()
+{
+   if( !_started.exchange( true ) )
+      --_monitor._queued;
+}
+
+task_monitor::scope::scope( task_monitor& monitor, const char* description, const fc::time_point& ready )
+   : _monitor( monitor ), _description( description ), _ready( ready )
+{
+   if( _monitor.is_enabled() )
+      _start = fc::time_point::now();
+}
+
+task_monitor::scope::~scope()
+{
+   if( _start != fc::time_point() )
+      _monitor.record_run( _description, _start, fc::time_point::now(), _ready );
+}
+
+void task_monitor::record_run( const char* description, const fc::time_point& start, const fc::time_point& end,
+                               const fc::time_point& ready )
+{
+   const int64_t duration = ( end - start ).count();
+   std::lock_guard<std::mutex> lock( _mutex );
+   task_source_stats& stats = _sources[description];
+   ++stats.runs;
+   stats.total_us += duration;
+   stats.max_us = std::max( stats.max_us, duration );
+   if( ready != fc::time_point() && ready < start )
+      stats.total_wait_us += ( start - ready ).count();
+
+   if( _longest.size() < max_longest_tasks || duration > _longest.back().duration_us )
+   {
+      task_run run;
+      run.description = description;
+      run.start = start;
+      run.duration_us = duration;
+      const auto pos = std::upper_bound( _longest.begin(), _longest.end(), duration,
+                                         []( int64_t d, const task_run& r ) { return d > r.duration_us; } );
+      _longest.insert( pos, std::move( run ) );
+      if( _longest.size() > max_longest_tasks )
+         _longest.pop_back();
+   }
+}
+
+void task_monitor::sample( const fc::time_point& due )
+{
+   task_queue_sample entry;
+   entry.time = fc::time_point::now();
+   entry.queued = _queued.load();
+   entry.lag_us = std::max<int64_t>( 0, ( entry.time - due ).count() );
+   std::lock_guard<std::mutex> lock( _mutex );
+   _samples.push_back( entry );
+   if( _samples.size() > max_samples )
+      _samples.pop_front();
+}
+
+void task_monitor::start_sampling( const fc::microseconds& interval )
+{
+   FC_ASSERT( interval.count() > 0 );
+   stop_sampling();
+   _sample_interval = interval;
+   schedule_sample( fc::time_point::now() + interval );
+}
+
+void task_monitor::schedule_sample( const fc::time_point& due )
+{
+   _sampling_task = fc::schedule( [this,due]() {
+      sample( due );
+      // a late sample moves the next one on instead of having samples catch up back to back
+      schedule_sample( std::max( due + _sample_interval, fc::time_point::now() ) );
+   }, due, "task_monitor sample" );
+}
+
+void task_monitor::stop_sampling()
+{
+   if( _sampling_task.valid() && !_sampling_task.ready() )
+      _sampling_task.cancel_and_wait( __FUNCTION__ );
+}
+
+task_monitor_report task_monitor::get_report()const
+{
+   task_monitor_report report;
+   report.enabled = is_enabled();
+   report.queued = _queued.load();
+   std::map<std::string, task_source_stats> merged;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      report.samples.assign( _samples.begin(), _samples.end() );
+      report.longest_tasks = _longest;
+      for( const auto& source : _sources )
+      {
+         task_source_stats& stats = merged[source.first];
+         stats.runs += source.second.runs;
+         stats.total_us += source.second.total_us;
+         stats.max_us = std::max( stats.max_us, source.second.max_us );
+         stats.total_wait_us += source.second.total_wait_us;
+      }
+   }
+   report.sources.reserve( merged.size() );
+   for( auto& source : merged )
+   {
+      source.second.description = source.first;
+      report.sources.push_back( std::move( source.second ) );
+   }
+   std::stable_sort( report.sources.begin(), report.sources.end(),
+                     []( const task_source_stats& a, const task_source_stats& b ) {
+      return a.total_us > b.total_us;
+   });
+   return report;
+}
+
+void task_monitor::reset()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _sources.clear();
+   _longest.clear();
+   _samples.clear();
+}
+
+} }
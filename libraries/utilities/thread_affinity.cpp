@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/thread_affinity.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace graphene { namespace utilities {
+
+namespace {
+   /** Parses the CPU lists of the kernel, e.g. 0-3,8,10-11 */
+   void parse_cpu_list( const std::string& list, std::vector<uint32_t>& cpus )
+   {
+      std::vector<std::string> parts;
+      boost::split( parts, list, boost::is_any_of(",") );
+      for( const auto& raw : parts )
+      {
+         const std::string part = boost::trim_copy( raw );
+         if( part.empty() )
+            continue;
+         const auto dash = part.find( '-' );
+         if( dash == std::string::npos )
+            cpus.push_back( boost::lexical_cast<uint32_t>( part ) );
+         else
+         {
+            const uint32_t first = boost::lexical_cast<uint32_t>( boost::trim_copy( part.substr( 0, dash ) ) );
+            const uint32_t last = boost::lexical_cast<uint32_t>( boost::trim_copy( part.substr( dash + 1 ) ) );
+            FC_ASSERT( first <= last, "Invalid CPU range ${r}", ("r",part) );
+            for( uint32_t cpu = first; cpu <= last; ++cpu )
+               cpus.push_back( cpu );
+         }
+      }
+   }
+
+   void sort_unique( std::vector<uint32_t>& values )
+   {
+      std::sort( values.begin(), values.end() );
+      values.erase( std::unique( values.begin(), values.end() ), values.end() );
+   }
+
+#ifdef __linux__
+   // from linux/mempolicy.h
+   const int mpol_preferred = 1;
+   const unsigned long max_numa_nodes = 1024;
+   const size_t bits_per_word = 8 * sizeof(unsigned long);
+#endif
+}
+
+std::vector<uint32_t> parse_cpu_set( const std::string& spec )
+{
+   std::vector<uint32_t> cpus = parse_cpu_order( spec );
+   sort_unique( cpus );
+   return cpus;
+}
+
+std::vector<uint32_t> parse_cpu_order( const std::string& spec )
+{ try {
+   std::vector<uint32_t> cpus;
+   std::vector<std::string> parts;
+   boost::split( parts, spec, boost::is_any_of(",") );
+   for( const auto& raw : parts )
+   {
+      const std::string part = boost::trim_copy( raw );
+      if( boost::starts_with( part, "node:" ) )
+      {
+         const uint32_t node = boost::lexical_cast<uint32_t>( part.substr( 5 ) );
+         const auto node_cpus = numa_node_cpus( node );
+         FC_ASSERT( !node_cpus.empty(), "NUMA node ${n} has no CPUs or does not exist", ("n",node) );
+         cpus.insert( cpus.end(), node_cpus.begin(), node_cpus.end() );
+      }
+      else
+         parse_cpu_list( part, cpus );
+   }
+   return cpus;
+} FC_CAPTURE_AND_RETHROW( (spec) ) }
+
+std::string format_cpu_set( const std::vector<uint32_t>& cpus )
+{
+   std::vector<uint32_t> sorted( cpus );
+   sort_unique( sorted );
+   std::ostringstream out;
+   for( size_t i = 0; i < sorted.size(); )
+   {
+      size_t j = i;
+      while( j + 1 < sorted.size() && sorted[j+1] == sorted[j] + 1 )
+         ++j;
+      if( i > 0 )
+         out << ',';
+      out << sorted[i];
+      if( j > i )
+         out << '-' << sorted[j];
+      i = j + 1;
+   }
+   return out.str();
+}
+
+std::vector<uint32_t> numa_node_cpus( uint32_t node )
+{
+   std::vector<uint32_t> cpus;
+   std::ifstream in( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" );
+   std::string list;
+   if( in && std::getline( in, list ) )
+      parse_cpu_list( list, cpus );
+   sort_unique( cpus );
+   return cpus;
+}
+
+std::vector<uint32_t> numa_nodes_of( const std::vector<uint32_t>& cpus )
+{
+   std::vector<uint32_t> nodes;
+   if( cpus.empty() )
+      return nodes;
+   // node numbers may have gaps, so all possible nodes are asked
+   std::vector<uint32_t> possible;
+   std::ifstream in( "/sys/devices/system/node/possible" );
+   std::string list;
+   if( in && std::getline( in, list ) )
+      parse_cpu_list( list, possible );
+   for( uint32_t node : possible )
+   {
+      const auto node_cpus = numa_node_cpus( node );
+      for( uint32_t cpu : cpus )
+         if( std::binary_search( node_cpus.begin(), node_cpus.end(), cpu ) )
+         {
+            nodes.push_back( node );
+            break;
+         }
+   }
+   return nodes;
+}
+
+void set_current_thread_cpus( const std::vector<uint32_t>& cpus )
+{
+   FC_ASSERT( !cpus.empty(), "A thread needs at least one CPU to run on" );
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+   for( uint32_t cpu : cpus )
+   {
+      FC_ASSERT( cpu < CPU_SETSIZE, "CPU ${c} is out of range", ("c",cpu) );
+      CPU_SET( cpu, &set );
+   }
+   const int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+   if( err != 0 )
+      wlog( "Failed to restrict the thread to CPUs ${c}, error ${e}", ("c",format_cpu_set( cpus ))("e",err) );
+#else
+   wlog( "Restricting threads to CPUs is not supported on this platform" );
+#endif
+}
+
+std::vector<uint32_t> get_current_thread_cpus()
+{
+   std::vector<uint32_t> cpus;
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+   if( pthread_getaffinity_np( pthread_self(), sizeof(set), &set ) == 0 )
+      for( uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+         if( CPU_ISSET( cpu, &set ) )
+            cpus.push_back( cpu );
+#endif
+   return cpus;
+}
+
+void prefer_numa_node_memory( uint32_t node )
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+   FC_ASSERT( node < max_numa_nodes, "NUMA node ${n} is out of range", ("n",node) );
+   std::vector<unsigned long> mask( max_numa_nodes / bits_per_word, 0 );
+   mask[node / bits_per_word] |= 1ul << ( node % bits_per_word );
+   if( syscall( SYS_set_mempolicy, mpol_preferred, mask.data(), max_numa_nodes ) != 0 )
+      wlog( "Failed to prefer the memory of NUMA node ${n}, error ${e}", ("n",node)("e",errno) );
+#else
+   wlog( "NUMA memory policies are not supported on this platform" );
+#endif
+}
+
+std::string describe_current_thread_placement()
+{
+   const auto cpus = get_current_thread_cpus();
+   if( cpus.empty() )
+      return "unknown CPUs";
+   std::string result = "CPUs " + format_cpu_set( cpus );
+   const auto nodes = numa_nodes_of( cpus );
+   if( !nodes.empty() )
+      result += std::string( nodes.size() == 1 ? " (NUMA node " : " (NUMA nodes " ) + format_cpu_set( nodes ) + ")";
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+   int mode = 0;
+   std::vector<unsigned long> mask( max_numa_nodes / bits_per_word, 0 );
+   if( syscall( SYS_get_mempolicy, &mode, mask.data(), max_numa_nodes, nullptr, 0ul ) == 0 && mode == mpol_preferred )
+      for( uint32_t node = 0; node < max_numa_nodes; ++node )
+         if( mask[node / bits_per_word] & ( 1ul << ( node % bits_per_word ) ) )
+         {
+            result += ", memory on NUMA node " + std::to_string( node );
+            break;
+         }
+#endif
+   return result;
+}
+
+} } // graphene::utilities
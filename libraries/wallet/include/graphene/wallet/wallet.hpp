@@ -304,6 +304,16 @@ struct account_history_operation_detail {
    vector<operation_detail_ex>  details;
 };
 
+/// the outcome of one transaction of wallet_api::sign_transaction_batch()
+struct transaction_batch_result {
+   signed_transaction           transaction;
+   transaction_id_type          id;
+   bool                         signed_ok = false;
+   bool                         broadcast_ok = false;
+   /// why the transaction could not be built, signed or broadcast
+   optional<string>             error;
+};
+
 /**
  * This wallet assumes it is connected to the database server with a high-bandwidth, low-latency connection and
  * performs minimal caching. This API could be provided locally to be used by a web interface.
@@ -516,6 +526,18 @@ class wallet_api
        */
       variant                           get_object(object_id_type id) const;
 
+      /**
+       * Keeps the accounts, assets and objects the wallet looks up between commands.
+       *
+       * Without this the wallet only reuses lookups within one command. With it the wallet subscribes to the
+       * objects it caches and the node notifies it of their changes once per block, so commands see the state
+       * as of the last applied block rather than of the pending transactions. Disabling it cancels the
+       * subscriptions of the wallet.
+       *
+       * @param enable true to keep lookups between commands, false to only reuse them within a command
+       */
+      void                              enable_object_cache(bool enable);
+
       /** Returns the current wallet filename.  
        *
        * This is the filename that will be used when automatically saving the wallet.
@@ -886,6 +908,17 @@ class wallet_api
        */
       string read_memo(const memo_data& memo);
 
+      /** Read many memos at once.
+       *
+       * Faster than calling read_memo() for each memo, the shared secret of every pair of keys is only derived once
+       * and the memos are decrypted in parallel.
+       *
+       * @param memos JSON-encoded memos.
+       * @returns the decrypted messages in the order of the memos, an empty string for a memo that could not be
+       *          decrypted.
+       */
+      vector<string> read_memos(const vector<memo_data>& memos);
+
 
       /** These methods are used for stealth transfers */
       ///@{
@@ -1571,6 +1604,20 @@ class wallet_api
        */
       signed_transaction sign_transaction(signed_transaction tx, bool broadcast = false);
 
+      /** Builds, signs and optionally broadcasts many transactions at once.
+       *
+       * Each entry of \c batch becomes one transaction. The fees and the reference block are looked up once
+       * for the whole batch, the required keys once per set of required authorities, the transactions are
+       * signed in parallel and their broadcasts are sent without waiting for each other. A transaction that
+       * fails does not stop the others.
+       *
+       * @param batch the operations of each transaction
+       * @param broadcast true if you wish to broadcast the transactions
+       * @return the result of each transaction, in the order of \c batch
+       */
+      vector<transaction_batch_result> sign_transaction_batch(vector<vector<operation>> batch,
+                                                              bool broadcast = false);
+
       /** Returns an uninitialized object representing a given blockchain operation.
        *
        * This returns a default-initialized object of the given type; it can be used 
@@ -1733,6 +1780,9 @@ FC_REFLECT(graphene::wallet::operation_detail_ex,
 FC_REFLECT( graphene::wallet::account_history_operation_detail,
         (total_count)(result_count)(details))
 
+FC_REFLECT( graphene::wallet::transaction_batch_result,
+            (transaction)(id)(signed_ok)(broadcast_ok)(error) )
+
 FC_API( graphene::wallet::wallet_api,
         (help)
         (gethelp)
@@ -1818,6 +1868,7 @@ FC_API( graphene::wallet::wallet_api,
         (get_global_properties)
         (get_dynamic_global_properties)
         (get_object)
+        (enable_object_cache)
         (get_private_key)
         (load_wallet_file)
         (normalize_brain_key)
@@ -1828,6 +1879,7 @@ FC_API( graphene::wallet::wallet_api,
         (save_wallet_file)
         (serialize_transaction)
         (sign_transaction)
+        (sign_transaction_batch)
         (get_prototype_operation)
         (propose_parameter_change)
         (propose_fee_change)
@@ -1843,6 +1895,7 @@ FC_API( graphene::wallet::wallet_api,
         (network_get_connected_peers)
         (sign_memo)
         (read_memo)
+        (read_memos)
         (set_key_label)
         (get_key_label)
         (get_public_key)
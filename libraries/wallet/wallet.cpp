@@ -29,6 +29,7 @@
 #include <sstream>
 #include <string>
 #include <list>
+#include <mutex>
 
 #include <boost/version.hpp>
 #include <boost/lexical_cast.hpp>
@@ -59,12 +60,14 @@
 #include <fc/crypto/hex.hpp>
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/parallel.hpp>
 #include <fc/rpc/api_connection.hpp>
 
 #include <graphene/app/api.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/impacted.hpp>
 #include <graphene/utilities/git_revision.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 #include <graphene/utilities/words.hpp>
@@ -113,14 +116,18 @@ private:
    ostream& out;
    const wallet_api_impl& wallet;
    operation_result result;
+   /// decrypted_memo optionally points to the text of a memo that was already decrypted, unset if that failed
+   const optional<string>* decrypted_memo;
 
    std::string fee(const asset& a) const;
 
 public:
-   operation_printer( ostream& out, const wallet_api_impl& wallet, const operation_result& r = operation_result() )
+   operation_printer( ostream& out, const wallet_api_impl& wallet, const operation_result& r = operation_result(),
+                      const optional<string>* decrypted_memo = nullptr )
       : out(out),
         wallet(wallet),
-        result(r)
+        result(r),
+        decrypted_memo(decrypted_memo)
    {}
    typedef std::string result_type;
 
@@ -258,6 +265,215 @@ struct op_prototype_visitor
    }
 };
 
+struct op_fee_asset_visitor
+{
+   typedef asset_id_type result_type;
+
+   template<typename T>
+   result_type operator()( const T& op )const
+   {
+      return op.fee.asset_id;
+   }
+};
+
+/**
+ * Accounts, assets and other objects the wallet looked up already
+ *
+ * Only used while a lookup_scope is open, i.e. for the duration of one command, unless the cache is subscribed.
+ * A subscribed cache keeps its entries across commands and applies the object notifications of the node to them,
+ * so it reflects the state of the node as of the last block whose notifications arrived. Notifications arrive on
+ * the thread of the connection, hence the mutex.
+ */
+class object_cache
+{
+   public:
+      /// caches the lookups of a command, nested scopes share the entries of the outermost
+      class lookup_scope
+      {
+         public:
+            explicit lookup_scope( object_cache& cache ) : _cache( cache )
+            {
+               std::lock_guard<std::mutex> lock( _cache._mutex );
+               ++_cache._scopes;
+            }
+            ~lookup_scope()
+            {
+               std::lock_guard<std::mutex> lock( _cache._mutex );
+               if( --_cache._scopes == 0 && !_cache._subscribed )
+                  _cache.clear_locked();
+            }
+         private:
+            object_cache& _cache;
+      };
+
+      void set_subscribed( bool subscribed )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         // entries looked up before the subscription would not be notified of
+         clear_locked();
+         _subscribed = subscribed;
+      }
+      bool is_subscribed()const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         return _subscribed;
+      }
+
+      optional<account_object> find_account( account_id_type id )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _accounts.find( id );
+         return itr == _accounts.end() ? optional<account_object>() : optional<account_object>( itr->second );
+      }
+      optional<account_object> find_account( const string& name )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _account_ids.find( name );
+         return itr == _account_ids.end() ? optional<account_object>() : optional<account_object>( _accounts.at( itr->second ) );
+      }
+      optional<asset_object> find_asset( asset_id_type id )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _assets.find( id );
+         return itr == _assets.end() ? optional<asset_object>() : optional<asset_object>( itr->second );
+      }
+      optional<asset_object> find_asset( const string& symbol )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _asset_ids.find( symbol );
+         return itr == _asset_ids.end() ? optional<asset_object>() : optional<asset_object>( _assets.at( itr->second ) );
+      }
+      bool find_object( object_id_type id, variant& result )const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _objects.find( id );
+         if( itr == _objects.end() )
+            return false;
+         result = itr->second;
+         return true;
+      }
+
+      /// the store methods do nothing unless the cache is in use
+      void store( const account_object& account )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( in_use() )
+            store_locked( account );
+      }
+      void store( const asset_object& asset )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( in_use() )
+            store_locked( asset );
+      }
+      void store( object_id_type id, const variant& object )
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( in_use() && !object.is_null() )
+            _objects[id] = object;
+      }
+      bool in_use_now()const
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         return in_use();
+      }
+
+      /// applies an object notification of the node, i.e. changed objects and the ids of removed ones
+      void on_objects_changed( const variant& updates )
+      {
+         if( !updates.is_array() )
+            return;
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( !_subscribed )
+            return;
+         for( const variant& item : updates.get_array() )
+         {
+            try
+            {
+               if( item.is_object() )
+                  update_locked( item["id"].as<object_id_type>( 1 ), item );
+               else if( item.is_string() )
+                  erase_locked( item.as<object_id_type>( 1 ) );
+            }
+            catch( const fc::exception& e )
+            {
+               // the entry can not be trusted anymore
+               elog( "Could not apply object notification ${n}: ${e}", ("n", item)("e", e.to_detail_string()) );
+               clear_locked();
+            }
+         }
+      }
+
+   private:
+      bool in_use()const { return _subscribed || _scopes > 0; }
+
+      void store_locked( const account_object& account )
+      {
+         _accounts[account.id] = account;
+         _account_ids[account.name] = account.id;
+      }
+      void store_locked( const asset_object& asset )
+      {
+         _assets[asset.id] = asset;
+         _asset_ids[asset.symbol] = asset.id;
+      }
+      void update_locked( object_id_type id, const variant& object )
+      {
+         if( id.is<account_id_type>() )
+         {
+            if( _accounts.count( account_id_type( id ) ) )
+               store_locked( object.as<account_object>( GRAPHENE_MAX_NESTED_OBJECTS ) );
+         }
+         else if( id.is<asset_id_type>() )
+         {
+            if( _assets.count( asset_id_type( id ) ) )
+               store_locked( object.as<asset_object>( GRAPHENE_MAX_NESTED_OBJECTS ) );
+         }
+         auto itr = _objects.find( id );
+         if( itr != _objects.end() )
+            itr->second = object;
+      }
+      void erase_locked( object_id_type id )
+      {
+         if( id.is<account_id_type>() )
+         {
+            auto itr = _accounts.find( account_id_type( id ) );
+            if( itr != _accounts.end() )
+            {
+               _account_ids.erase( itr->second.name );
+               _accounts.erase( itr );
+            }
+         }
+         else if( id.is<asset_id_type>() )
+         {
+            auto itr = _assets.find( asset_id_type( id ) );
+            if( itr != _assets.end() )
+            {
+               _asset_ids.erase( itr->second.symbol );
+               _assets.erase( itr );
+            }
+         }
+         _objects.erase( id );
+      }
+      void clear_locked()
+      {
+         _accounts.clear();
+         _account_ids.clear();
+         _assets.clear();
+         _asset_ids.clear();
+         _objects.clear();
+      }
+
+      mutable std::mutex                    _mutex;
+      bool                                  _subscribed = false;
+      uint32_t                              _scopes = 0;
+      std::map<account_id_type, account_object> _accounts;
+      std::map<string, account_id_type>     _account_ids;
+      std::map<asset_id_type, asset_object> _assets;
+      std::map<string, asset_id_type>       _asset_ids;
+      std::map<object_id_type, variant>     _objects;
+};
+
 class wallet_api_impl
 {
 public:
@@ -499,7 +715,12 @@ public:
    template<typename T>
    T get_object(object_id<T::space_id, T::type_id, T> id)const
    {
-      auto ob = _remote_db->get_objects({id}).front();
+      variant ob;
+      if( !_cache->find_object( id, ob ) )
+      {
+         ob = _remote_db->get_objects({id}).front();
+         _cache->store( id, ob );
+      }
       return ob.template as<T>( GRAPHENE_MAX_NESTED_OBJECTS );
    }
 
@@ -583,10 +804,14 @@ public:
    }
    account_object get_account(account_id_type id) const
    {
+      if( auto cached = _cache->find_account(id) )
+         return *cached;
+
       std::string account_id = account_id_to_string(id);
 
       auto rec = _remote_db->get_accounts({account_id}).front();
       FC_ASSERT(rec);
+      _cache->store(*rec);
       return *rec;
    }
    account_object get_account(string account_name_or_id) const
@@ -598,8 +823,14 @@ public:
          // It's an ID
          return get_account(*id);
       } else {
+         if( auto cached = _cache->find_account(account_name_or_id) )
+            return *cached;
          auto rec = _remote_db->lookup_account_names({account_name_or_id}).front();
          FC_ASSERT( rec && rec->name == account_name_or_id );
+         // looking up a name does not subscribe to the account, looking up its ID does
+         if( _cache->is_subscribed() )
+            return get_account(rec->id);
+         _cache->store(*rec);
          return *rec;
       }
    }
@@ -616,7 +847,11 @@ public:
    }
    optional<asset_object> find_asset(asset_id_type id)const
    {
+      if( auto cached = _cache->find_asset(id) )
+         return cached;
       auto rec = _remote_db->get_assets({asset_id_to_string(id)}).front();
+      if( rec )
+         _cache->store(*rec);
       return rec;
    }
    optional<asset_object> find_asset(string asset_symbol_or_id)const
@@ -629,11 +864,17 @@ public:
          return find_asset(*id);
       } else {
          // It's a symbol
+         if( auto cached = _cache->find_asset(asset_symbol_or_id) )
+            return cached;
          auto rec = _remote_db->lookup_asset_symbols({asset_symbol_or_id}).front();
          if( rec )
          {
             if( rec->symbol != asset_symbol_or_id )
                return optional<asset_object>();
+            // looking up a symbol does not subscribe to the asset, looking up its ID does
+            if( _cache->is_subscribed() )
+               return find_asset(rec->id);
+            _cache->store(*rec);
          }
          return rec;
       }
@@ -654,12 +895,103 @@ public:
    asset_id_type get_asset_id(string asset_symbol_or_id) const
    {
       FC_ASSERT( asset_symbol_or_id.size() > 0 );
-      vector<optional<asset_object>> opt_asset;
       if( std::isdigit( asset_symbol_or_id.front() ) )
          return fc::variant(asset_symbol_or_id, 1).as<asset_id_type>( 1 );
-      opt_asset = _remote_db->lookup_asset_symbols( {asset_symbol_or_id} );
-      FC_ASSERT( (opt_asset.size() > 0) && (opt_asset[0].valid()) );
-      return opt_asset[0]->id;
+      auto opt_asset = find_asset( asset_symbol_or_id );
+      FC_ASSERT( opt_asset.valid() );
+      return opt_asset->id;
+   }
+
+   /**
+    * Fetches the given accounts and assets that are not cached yet with one call each, so that the lookups of
+    * a command touching many of them do not cost a round trip apiece. Does nothing unless the cache is in use.
+    */
+   void prefetch( const flat_set<account_id_type>& accounts, const flat_set<asset_id_type>& assets )const
+   {
+      if( !_cache->in_use_now() )
+         return;
+      vector<string> missing_accounts;
+      for( const auto& id : accounts )
+         if( !_cache->find_account(id) )
+            missing_accounts.push_back( account_id_to_string(id) );
+      vector<string> missing_assets;
+      for( const auto& id : assets )
+         if( !_cache->find_asset(id) )
+            missing_assets.push_back( asset_id_to_string(id) );
+      // best effort, the lookups themselves report anything that does not exist
+      try
+      {
+         if( !missing_accounts.empty() )
+            for( const auto& rec : _remote_db->get_accounts( missing_accounts ) )
+               if( rec )
+                  _cache->store( *rec );
+         if( !missing_assets.empty() )
+            for( const auto& rec : _remote_db->get_assets( missing_assets ) )
+               if( rec )
+                  _cache->store( *rec );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Could not prefetch accounts and assets: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+
+   /// like prefetch, for accounts given by name or ID
+   void prefetch_accounts( const vector<string>& names_or_ids )const
+   {
+      if( !_cache->in_use_now() )
+         return;
+      vector<string> missing;
+      for( const auto& name_or_id : names_or_ids )
+      {
+         auto id = maybe_id<account_id_type>( name_or_id );
+         if( !( id ? _cache->find_account( *id ) : _cache->find_account( name_or_id ) ) )
+            missing.push_back( name_or_id );
+      }
+      if( missing.empty() )
+         return;
+      try
+      {
+         for( const auto& rec : _remote_db->get_accounts( missing ) )
+            if( rec )
+               _cache->store( *rec );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Could not prefetch accounts: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+
+   /// prefetches the accounts and fee assets of the given operations
+   void prefetch( const vector<operation_history_object>& history )const
+   {
+      flat_set<account_id_type> accounts;
+      flat_set<asset_id_type> assets;
+      for( const auto& item : history )
+      {
+         graphene::chain::operation_get_impacted_accounts( item.op, accounts );
+         assets.insert( item.op.visit( op_fee_asset_visitor() ) );
+      }
+      prefetch( accounts, assets );
+   }
+
+   void enable_object_cache( bool enable )
+   {
+      if( enable )
+      {
+         // the callback may outlive the wallet on the connection, it only touches the cache through a weak pointer
+         std::weak_ptr<object_cache> weak_cache = _cache;
+         _remote_db->set_subscribe_callback( [weak_cache]( const variant& updates ) {
+            if( auto cache = weak_cache.lock() )
+               cache->on_objects_changed( updates );
+         }, false );
+         _cache->set_subscribed( true );
+      }
+      else
+      {
+         _cache->set_subscribed( false );
+         _remote_db->cancel_all_subscriptions();
+      }
    }
 
    string                            get_wallet_filename() const
@@ -2003,6 +2335,148 @@ public:
       return tx;
    }
 
+   vector<transaction_batch_result> sign_transaction_batch( const vector<vector<operation>>& batch, bool broadcast )
+   {
+      FC_ASSERT( !self.is_locked() );
+      vector<transaction_batch_result> results( batch.size() );
+      if( batch.empty() )
+         return results;
+
+      // one lookup of the fees and of the reference block for the batch
+      const auto fees = _remote_db->get_global_properties().parameters.current_fees;
+      const auto dyn_props = get_dynamic_global_properties();
+
+      fc::time_point_sec oldest_transaction_ids_to_track(dyn_props.time - fc::minutes(2));
+      auto& by_time = _recently_generated_transactions.get<timestamp_index>();
+      by_time.erase( by_time.begin(), by_time.lower_bound(oldest_transaction_ids_to_track) );
+
+      // transactions needing the same authorities need the same keys, look them up once per set of authorities
+      std::map<fc::sha256, set<public_key_type>> keys_by_authorities;
+      std::map<public_key_type, fc::ecc::private_key> private_keys;
+      vector<const set<public_key_type>*> approving_keys( batch.size() );
+
+      for( size_t i = 0; i < batch.size(); ++i )
+      {
+         transaction_batch_result& result = results[i];
+         try
+         {
+            FC_ASSERT( !batch[i].empty(), "Transaction without operations" );
+            signed_transaction& tx = result.transaction;
+            tx.operations = batch[i];
+            set_operation_fees( tx, fees );
+            tx.validate();
+
+            flat_set<account_id_type> active;
+            flat_set<account_id_type> owner;
+            vector<authority> other;
+            for( const auto& op : tx.operations )
+               operation_get_required_authorities( op, active, owner, other );
+            fc::sha256::encoder enc;
+            fc::raw::pack( enc, active );
+            fc::raw::pack( enc, owner );
+            fc::raw::pack( enc, other );
+            const fc::sha256 authorities = enc.result();
+            auto keys = keys_by_authorities.find( authorities );
+            if( keys == keys_by_authorities.end() )
+            {
+               set<public_key_type> pks = _remote_db->get_potential_signatures( tx );
+               flat_set<public_key_type> owned_keys;
+               for( const auto& pk : pks )
+                  if( _keys.find(pk) != _keys.end() )
+                     owned_keys.insert( pk );
+               keys = keys_by_authorities.emplace( authorities,
+                                                   _remote_db->get_required_signatures( tx, owned_keys ) ).first;
+               for( const auto& pk : keys->second )
+                  if( !private_keys.count(pk) )
+                     private_keys.emplace( pk, get_private_key(pk) );
+            }
+            approving_keys[i] = &keys->second;
+
+            // the IDs do not cover the signatures, so duplicates can be told apart before signing
+            tx.set_reference_block( dyn_props.head_block_id );
+            uint32_t expiration_time_offset = 0;
+            do
+            {
+               tx.set_expiration( dyn_props.time + fc::seconds(30 + expiration_time_offset++) );
+               result.id = tx.id();
+            } while( _recently_generated_transactions.find(result.id) != _recently_generated_transactions.end() );
+            recently_generated_transaction_record this_transaction_record;
+            this_transaction_record.generation_time = dyn_props.time;
+            this_transaction_record.transaction_id = result.id;
+            _recently_generated_transactions.insert(this_transaction_record);
+         }
+         catch( const fc::exception& e )
+         {
+            result.error = e.to_detail_string();
+         }
+      }
+
+      auto sign = [&results,&approving_keys,&private_keys,this] ( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+         {
+            if( results[i].error )
+               continue;
+            for( const public_key_type& key : *approving_keys[i] )
+               results[i].transaction.sign( private_keys.at(key), _chain_id );
+            results[i].signed_ok = true;
+         }
+      };
+      // as in read_memos, a signature takes tens of microseconds, only larger batches are worth the threads
+      const size_t min_batch = 16;
+      const size_t chunks = std::min<size_t>( fc::asio::default_io_service_scope::get_num_threads(),
+                                              ( results.size() + min_batch - 1 ) / min_batch );
+      if( chunks <= 1 )
+         sign( 0, results.size() );
+      else
+      {
+         const size_t chunk_size = ( results.size() + chunks - 1 ) / chunks;
+         vector<fc::future<void>> workers;
+         workers.reserve( chunks );
+         for( size_t begin = 0; begin < results.size(); begin += chunk_size )
+         {
+            const size_t end = std::min( begin + chunk_size, results.size() );
+            workers.push_back( fc::do_parallel( [&sign,begin,end] () { sign( begin, end ); } ) );
+         }
+         for( auto& worker : workers )
+            worker.wait();
+      }
+
+      if( !broadcast )
+         return results;
+
+      // the broadcasts of a window are in flight on the connection at the same time instead of one after another
+      const size_t max_in_flight = 100;
+      for( size_t begin = 0; begin < results.size(); begin += max_in_flight )
+      {
+         const size_t end = std::min( begin + max_in_flight, results.size() );
+         vector<std::pair<size_t, fc::future<void>>> broadcasts;
+         for( size_t i = begin; i < end; ++i )
+         {
+            if( !results[i].signed_ok )
+               continue;
+            const signed_transaction* tx = &results[i].transaction;
+            broadcasts.emplace_back( i, fc::async( [this,tx] () {
+               _remote_net_broadcast->broadcast_transaction( *tx );
+            }, "wallet batch broadcast" ) );
+         }
+         for( auto& item : broadcasts )
+         {
+            transaction_batch_result& result = results[item.first];
+            try
+            {
+               item.second.wait();
+               result.broadcast_ok = true;
+            }
+            catch( const fc::exception& e )
+            {
+               elog( "Caught exception while broadcasting tx ${id}:  ${e}", ("id", result.id.str())("e", e.to_detail_string()) );
+               result.error = e.to_detail_string();
+            }
+         }
+      }
+      return results;
+   }
+
    memo_data sign_memo(string from, string to, string memo)
    {
       FC_ASSERT( !self.is_locked() );
@@ -2053,6 +2527,104 @@ public:
       return clear_text;
    }
 
+   /** @return the shared secret of the keys of md if one of them is in the wallet, derived once per key pair */
+   optional<fc::sha512> memo_shared_secret( const memo_data& md )
+   {
+      if( md.from == public_key_type() )
+         return fc::sha512(); // not encrypted
+      const bool to_me = _keys.count( md.to ) > 0;
+      if( !to_me && !_keys.count( md.from ) )
+         return optional<fc::sha512>();
+      const public_key_type& mine = to_me ? md.to : md.from;
+      const public_key_type& other = to_me ? md.from : md.to;
+      const auto pair = std::make_pair( mine.key_data, other.key_data );
+      auto itr = _memo_secrets.find( pair );
+      if( itr == _memo_secrets.end() )
+      {
+         auto my_key = wif_to_key( _keys.at( mine ) );
+         FC_ASSERT( my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted." );
+         itr = _memo_secrets.emplace( pair, my_key->get_shared_secret( other ) ).first;
+      }
+      return itr->second;
+   }
+
+   /**
+    * Decrypts many memos at once, the key exchange is done once per pair of keys and the memos are decrypted in
+    * parallel. An element of the result is unset if its memo could not be decrypted.
+    */
+   vector<optional<string>> read_memos( const vector<const memo_data*>& memos )
+   {
+      FC_ASSERT( !is_locked() );
+      vector<optional<string>> result( memos.size() );
+      vector<optional<fc::sha512>> secrets( memos.size() );
+      for( size_t i = 0; i < memos.size(); ++i )
+      {
+         try {
+            secrets[i] = memo_shared_secret( *memos[i] );
+         } catch( const fc::exception& e ) {
+            elog( "Error when decrypting memo: ${e}", ("e", e.to_detail_string()) );
+         }
+      }
+
+      auto decrypt = [&memos,&secrets,&result] ( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+         {
+            if( !secrets[i] )
+               continue;
+            try {
+               result[i] = memos[i]->get_message( *secrets[i] );
+            } catch( const fc::exception& e ) {
+               elog( "Error when decrypting memo: ${e}", ("e", e.to_detail_string()) );
+            }
+         }
+      };
+      // a single memo takes a few microseconds, only larger batches are worth the threads
+      const size_t min_batch = 64;
+      const size_t chunks = std::min<size_t>( fc::asio::default_io_service_scope::get_num_threads(),
+                                              ( memos.size() + min_batch - 1 ) / min_batch );
+      if( chunks <= 1 )
+      {
+         decrypt( 0, memos.size() );
+         return result;
+      }
+      const size_t chunk_size = ( memos.size() + chunks - 1 ) / chunks;
+      vector<fc::future<void>> workers;
+      workers.reserve( chunks );
+      for( size_t begin = 0; begin < memos.size(); begin += chunk_size )
+      {
+         const size_t end = std::min( begin + chunk_size, memos.size() );
+         workers.push_back( fc::do_parallel( [&decrypt,begin,end] () { decrypt( begin, end ); } ) );
+      }
+      for( auto& worker : workers )
+         worker.wait();
+      return result;
+   }
+
+   /** @return the decrypted memos of the transfers in ops in the same order, unset for other operations */
+   vector<optional<string>> read_transfer_memos( const vector<operation_history_object>& ops )
+   {
+      vector<optional<string>> result( ops.size() );
+      if( is_locked() )
+         return result;
+      vector<const memo_data*> memos;
+      vector<size_t> positions;
+      for( size_t i = 0; i < ops.size(); ++i )
+      {
+         if( ops[i].op.which() != operation::tag<transfer_operation>::value )
+            continue;
+         const transfer_operation& op = ops[i].op.get<transfer_operation>();
+         if( op.memo )
+         {
+            memos.push_back( &*op.memo );
+            positions.push_back( i );
+         }
+      }
+      vector<optional<string>> texts = read_memos( memos );
+      for( size_t j = 0; j < texts.size(); ++j )
+         result[ positions[j] ] = std::move( texts[j] );
+      return result;
+   }
+
    signed_transaction sell_asset(string seller_account,
                                  string amount_to_sell,
                                  string symbol_to_sell,
@@ -2145,6 +2717,9 @@ public:
                                string asset_symbol, string memo, bool broadcast = false)
    { try {
       FC_ASSERT( !self.is_locked() );
+      // signing looks the accounts up again
+      object_cache::lookup_scope cache_scope( *_cache );
+      prefetch_accounts( { from, to } );
       fc::optional<asset_object> asset_obj = get_asset(asset_symbol);
       FC_ASSERT(asset_obj, "Could not find asset matching ${asset}", ("asset", asset_symbol));
 
@@ -2764,6 +3339,8 @@ public:
    wallet_data             _wallet;
 
    map<public_key_type,string> _keys;
+   /** shared secrets of memos by (wallet key, other key), dropped when the wallet is locked */
+   std::map<std::pair<fc::ecc::public_key_data,fc::ecc::public_key_data>,fc::sha512> _memo_secrets;
    fc::sha512                  _checksum;
 
    chain_id_type           _chain_id;
@@ -2773,6 +3350,7 @@ public:
    fc::api<history_api>    _remote_hist;
    optional< fc::api<network_node_api> > _remote_net_node;
    optional< fc::api<graphene::debug_witness::debug_api> > _remote_debug;
+   std::shared_ptr<object_cache> _cache = std::make_shared<object_cache>();
 
    flat_map<string, operation> _prototype_ops;
 
@@ -2841,6 +3419,14 @@ string operation_printer::operator()(const transfer_operation& op) const
       if( wallet.is_locked() )
       {
          out << " -- Unlock wallet to see memo.";
+      } else if( decrypted_memo ) {
+         if( *decrypted_memo )
+         {
+            memo = **decrypted_memo;
+            out << " -- Memo: " << memo;
+         }
+         else
+            out << " -- could not decrypt memo";
       } else {
          try {
             FC_ASSERT(wallet._keys.count(op.memo->to) || wallet._keys.count(op.memo->from), "Memo is encrypted to a key ${to} or ${from} not in this wallet.", ("to", op.memo->to)("from",op.memo->from));
@@ -3020,6 +3606,7 @@ uint64_t wallet_api::get_asset_count()const
 vector<operation_detail> wallet_api::get_account_history(string name, int limit)const
 {
    vector<operation_detail> result;
+   detail::object_cache::lookup_scope cache_scope( *my->_cache );
 
    /*
     * Compatibility issue
@@ -3053,19 +3640,13 @@ vector<operation_detail> wallet_api::get_account_history(string name, int limit)
             operation_history_id_type(),
             page_limit,
             start );
-      bool first_row = true;
-      for( auto& o : current )
+      my->prefetch( current );
+      const vector<optional<string>> memos = my->read_transfer_memos( current );
+      for( size_t i = skip_first_row ? 1 : 0; i < current.size(); ++i )
       {
-         if( first_row )
-         {
-            first_row = false;
-            if( skip_first_row )
-            {
-               continue;
-            }
-         }
+         const operation_history_object& o = current[i];
          std::stringstream ss;
-         auto memo = o.op.visit(detail::operation_printer(ss, *my, o.result));
+         auto memo = o.op.visit(detail::operation_printer(ss, *my, o.result, &memos[i]));
          result.push_back( operation_detail{ memo, ss.str(), o } );
       }
 
@@ -3087,6 +3668,7 @@ vector<operation_detail> wallet_api::get_relative_account_history(
       uint32_t start)const
 {
    vector<operation_detail> result;
+   detail::object_cache::lookup_scope cache_scope( *my->_cache );
    auto account_id = get_account(name).get_id();
 
    const account_object& account = my->get_account(account_id);
@@ -3111,9 +3693,12 @@ vector<operation_detail> wallet_api::get_relative_account_history(
             stop,
             std::min<uint32_t>(100, limit),
             start);
-      for (auto &o : current) {
+      my->prefetch( current );
+      const vector<optional<string>> memos = my->read_transfer_memos( current );
+      for (size_t i = 0; i < current.size(); ++i) {
+         const operation_history_object& o = current[i];
          std::stringstream ss;
-         auto memo = o.op.visit(detail::operation_printer(ss, *my, o.result));
+         auto memo = o.op.visit(detail::operation_printer(ss, *my, o.result, &memos[i]));
          result.push_back(operation_detail{memo, ss.str(), o});
       }
       if (current.size() < std::min<uint32_t>(100, limit))
@@ -3132,6 +3717,7 @@ account_history_operation_detail wallet_api::get_account_history_by_operations(
       int limit)
 {
     account_history_operation_detail result;
+    detail::object_cache::lookup_scope cache_scope( *my->_cache );
     auto account_id = get_account(name).get_id();
 
     const auto& account = my->get_account(account_id);
@@ -3155,9 +3741,12 @@ account_history_operation_detail wallet_api::get_account_history_by_operations(
     while (limit > 0 && start <= stats.total_ops) {
         uint32_t min_limit = std::min<uint32_t> (100, limit);
         auto current = my->_remote_hist->get_account_history_by_operations(always_id, operation_types, start, min_limit);
-        for (auto& obj : current.operation_history_objs) {
+        my->prefetch( current.operation_history_objs );
+        const vector<optional<string>> memos = my->read_transfer_memos( current.operation_history_objs );
+        for (size_t i = 0; i < current.operation_history_objs.size(); ++i) {
+            const operation_history_object& obj = current.operation_history_objs[i];
             std::stringstream ss;
-            auto memo = obj.op.visit(detail::operation_printer(ss, *my, obj.result));
+            auto memo = obj.op.visit(detail::operation_printer(ss, *my, obj.result, &memos[i]));
 
             transaction_id_type transaction_id;
             auto block = get_block(obj.block_num);
@@ -3249,6 +3838,11 @@ variant wallet_api::get_object( object_id_type id ) const
    return my->_remote_db->get_objects({id});
 }
 
+void wallet_api::enable_object_cache( bool enable )
+{
+   my->enable_object_cache( enable );
+}
+
 string wallet_api::get_wallet_filename() const
 {
    return my->get_wallet_filename();
@@ -3750,6 +4344,12 @@ signed_transaction wallet_api::sign_transaction(signed_transaction tx, bool broa
    return my->sign_transaction( tx, broadcast);
 } FC_CAPTURE_AND_RETHROW( (tx) ) }
 
+vector<transaction_batch_result> wallet_api::sign_transaction_batch( vector<vector<operation>> batch,
+                                                                    bool broadcast /* = false */ )
+{
+   return my->sign_transaction_batch( batch, broadcast );
+}
+
 operation wallet_api::get_prototype_operation(string operation_name)
 {
    return my->get_prototype_operation( operation_name );
@@ -3961,6 +4561,7 @@ void wallet_api::lock()
    for( auto key : my->_keys )
       key.second = key_to_wif(fc::ecc::private_key());
    my->_keys.clear();
+   my->_memo_secrets.clear();
    my->_checksum = fc::sha512();
    my->self.lock_changed(true);
 } FC_CAPTURE_AND_RETHROW() }
@@ -4001,6 +4602,7 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
 
    map< address, private_key_type > keys;  // local index of address -> private key
    vector< address > addrs;
+   vector< public_key_type > claim_keys;
    bool has_wildcard = false;
    addrs.reserve( wif_keys.size() );
    for( const string& wif_key : wif_keys )
@@ -4030,23 +4632,54 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
       {
          optional< private_key_type > key = wif_to_key( wif_key );
          FC_ASSERT( key.valid(), "Invalid private key" );
-         fc::ecc::public_key pk = key->get_public_key();
-         addrs.push_back( pk );
-         keys[addrs.back()] = *key;
-         // see chain/balance_evaluator.cpp
-         addrs.push_back( pts_address( pk, false, 56 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, true, 56 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, false, 0 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, true, 0 ) );
-         keys[addrs.back()] = *key;
+         claim_keys.push_back( key->get_public_key() );
+         // the node looks the balances up by the same address forms
+         for( const address& addr : balance_claim_addresses( claim_keys.back() ) )
+            keys[addr] = *key;
       }
    }
 
-   vector< balance_object > balances = _remote_db->get_balance_objects( addrs );
+   vector< balance_object > balances;
+   if( !addrs.empty() )
+      balances = _remote_db->get_balance_objects( addrs );
    addrs.clear();
+   // a key given twice would return its balances twice
+   set< address > seen_keys;
+   claim_keys.erase( std::remove_if( claim_keys.begin(), claim_keys.end(), [&seen_keys]( const public_key_type& key ) {
+      return !seen_keys.insert( address( key ) ).second;
+   }), claim_keys.end() );
+   const size_t max_keys_per_call = 100;
+   bool lookup_by_keys = true;
+   for( size_t start = 0; start < claim_keys.size(); start += max_keys_per_call )
+   {
+      const vector< public_key_type > chunk( claim_keys.begin() + start,
+                                             claim_keys.begin() + std::min( start + max_keys_per_call,
+                                                                            claim_keys.size() ) );
+      vector< balance_object > claimable;
+      if( lookup_by_keys )
+      {
+         try
+         {
+            claimable = _remote_db->get_balance_objects_by_keys( chunk );
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Node cannot look balances up by keys, sending their addresses instead: ${e}",
+                  ("e", e.to_string()) );
+            lookup_by_keys = false;
+         }
+      }
+      if( !lookup_by_keys )
+      {
+         // nodes before get_balance_objects_by_keys get the address forms of the keys
+         vector< address > chunk_addrs;
+         for( const public_key_type& key : chunk )
+            for( const address& addr : balance_claim_addresses( key ) )
+               chunk_addrs.push_back( addr );
+         claimable = _remote_db->get_balance_objects( chunk_addrs );
+      }
+      balances.insert( balances.end(), claimable.begin(), claimable.end() );
+   }
 
    set<asset_id_type> bal_types;
    for( auto b : balances ) bal_types.insert( b.balance.asset_id );
@@ -4163,6 +4796,20 @@ string wallet_api::read_memo(const memo_data& memo)
    return my->read_memo(memo);
 }
 
+vector<string> wallet_api::read_memos(const vector<memo_data>& memos)
+{
+   FC_ASSERT(!is_locked());
+   vector<const memo_data*> pointers;
+   pointers.reserve(memos.size());
+   for( const memo_data& md : memos )
+      pointers.push_back(&md);
+   vector<string> result;
+   result.reserve(memos.size());
+   for( auto& text : my->read_memos(pointers) )
+      result.push_back(text ? std::move(*text) : string());
+   return result;
+}
+
 string wallet_api::get_key_label( public_key_type key )const
 {
    auto key_itr   = my->_wallet.labeled_keys.get<by_key>().find(key);
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Drives many concurrent websocket API sessions against a node and reports the latency of every kind of call
+ * and how late the notifications of subscriptions arrive relative to the time of the block that caused them.
+ *
+ * Every session logs in, subscribes to the dynamic global properties and then issues calls of a configurable mix
+ * at a configurable rate with exponentially distributed pauses, from one fiber each. The sessions are spread over
+ * worker threads that each have their own websocket client.
+ */
+
+#include <graphene/app/api.hpp>
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/protocol/transfer.hpp>
+#include <graphene/utilities/key_conversion.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/network/http/websocket.hpp>
+#include <fc/rpc/websocket_api.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+using graphene::app::database_api;
+using graphene::app::history_api;
+using graphene::app::login_api;
+using graphene::app::network_broadcast_api;
+using graphene::chain::account_id_type;
+using graphene::chain::asset;
+using graphene::chain::chain_id_type;
+using graphene::chain::dynamic_global_property_object;
+using graphene::chain::object_id_type;
+using graphene::chain::operation_history_id_type;
+using graphene::chain::signed_transaction;
+using graphene::chain::transfer_operation;
+
+enum call_kind
+{
+   call_get_full_accounts,
+   call_get_order_book,
+   call_get_account_history,
+   call_subscribe_to_market,
+   call_broadcast_transaction,
+   call_get_dynamic_global_properties,
+   call_kind_count
+};
+
+static const char* const call_kind_names[call_kind_count] = {
+   "get_full_accounts", "get_order_book", "get_account_history", "subscribe_to_market",
+   "broadcast_transaction", "get_dynamic_global_properties"
+};
+
+/** latencies of one kind of call or notification, kept in microseconds */
+struct latency_samples
+{
+   std::vector<int64_t> samples;
+   uint64_t             errors = 0;
+
+   void record(int64_t us) { samples.push_back(std::max<int64_t>(us, 0)); }
+
+   /** @return the given percentile of the samples in milliseconds, or 0 if there are none */
+   double percentile(double p)
+   {
+      if (samples.empty())
+         return 0;
+      std::sort(samples.begin(), samples.end());
+      size_t index = std::min(samples.size() - 1, (size_t)(p / 100. * samples.size()));
+      return samples[index] / 1000.;
+   }
+
+   /** @return the number of samples below 1, 2, 4, ... 16384 ms, the last bucket holds the slower ones */
+   std::vector<uint64_t> histogram() const
+   {
+      std::vector<uint64_t> buckets(16, 0);
+      for (int64_t us : samples)
+      {
+         size_t bucket = 0;
+         for (int64_t bound = 1000; bucket + 1 < buckets.size() && us >= bound; bound *= 2)
+            ++bucket;
+         ++buckets[bucket];
+      }
+      return buckets;
+   }
+};
+
+/** what all sessions measured; notifications arrive on the threads of the websocket clients, hence the mutex */
+struct load_stats
+{
+   std::mutex      mutex;
+   latency_samples calls[call_kind_count];
+   /** from the time of a block to the arrival of the notification of its dynamic global properties */
+   latency_samples object_notification_lag;
+   /** from the time of the last block a session was notified of to the arrival of a market notification */
+   latency_samples market_notification_lag;
+   uint64_t        sessions_started = 0;
+   uint64_t        sessions_failed = 0;
+};
+
+struct load_config
+{
+   std::string                                       server;
+   std::string                                       user;
+   std::string                                       password;
+   std::vector<std::string>                          accounts;
+   std::vector<std::pair<std::string, std::string> > markets;
+   std::array<uint32_t, call_kind_count>             weights;
+   double                                            calls_per_second = 1;
+   fc::time_point                                    end;
+
+   fc::optional<fc::ecc::private_key> broadcast_key;
+   account_id_type                    broadcast_from;
+   account_id_type                    broadcast_to;
+   asset                              broadcast_fee;
+   chain_id_type                      chain_id;
+};
+
+class load_session
+{
+public:
+   load_session(const load_config& config, load_stats& stats, uint32_t index) :
+      _config(config),
+      _stats(stats),
+      _random(index)
+   {}
+
+   void run(fc::http::websocket_client& client)
+   {
+      try
+      {
+         _connection = client.connect(_config.server);
+         _api = std::make_shared<fc::rpc::websocket_api_connection>(*_connection, GRAPHENE_MAX_NESTED_OBJECTS);
+         fc::api<login_api> login = _api->get_remote_api<login_api>(1);
+         FC_ASSERT(login->login(_config.user, _config.password), "Failed to log in to ${s}", ("s", _config.server));
+         _db = login->database();
+         if (_config.weights[call_get_account_history])
+            _history = login->history();
+         if (_config.weights[call_broadcast_transaction])
+            _broadcast = login->network_broadcast();
+
+         // every block changes the dynamic global properties, their notifications carry the time of the block
+         _db->set_subscribe_callback([this](const fc::variant& updates) { on_objects(updates); }, false);
+         _reference = _db->get_objects({object_id_type(2, 1, 0)})[0].as<dynamic_global_property_object>(1);
+         _reference_fetched = fc::time_point::now();
+      }
+      catch (const fc::exception& e)
+      {
+         wlog("session failed to start: ${e}", ("e", e.to_string()));
+         std::lock_guard<std::mutex> lock(_stats.mutex);
+         ++_stats.sessions_failed;
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> lock(_stats.mutex);
+         ++_stats.sessions_started;
+      }
+
+      std::exponential_distribution<double> pause(_config.calls_per_second);
+      while (fc::time_point::now() < _config.end)
+      {
+         const call_kind kind = pick();
+         const fc::time_point start = fc::time_point::now();
+         bool failed = false;
+         try
+         {
+            call(kind);
+         }
+         catch (const fc::exception& e)
+         {
+            dlog("${c} failed: ${e}", ("c", call_kind_names[kind])("e", e.to_string()));
+            failed = true;
+         }
+         const int64_t elapsed = (fc::time_point::now() - start).count();
+         {
+            std::lock_guard<std::mutex> lock(_stats.mutex);
+            if (failed)
+               ++_stats.calls[kind].errors;
+            else
+               _stats.calls[kind].record(elapsed);
+         }
+         fc::usleep(fc::microseconds(int64_t(pause(_random) * 1000000)));
+      }
+   }
+
+   void close()
+   {
+      if (_connection)
+         _connection->close(1000, "done");
+   }
+
+private:
+   call_kind pick()
+   {
+      uint32_t total = 0;
+      for (uint32_t weight : _config.weights)
+         total += weight;
+      uint32_t choice = std::uniform_int_distribution<uint32_t>(0, total - 1)(_random);
+      for (uint32_t kind = 0; kind < call_kind_count; ++kind)
+      {
+         if (choice < _config.weights[kind])
+            return call_kind(kind);
+         choice -= _config.weights[kind];
+      }
+      return call_get_dynamic_global_properties;
+   }
+
+   template<typename T>
+   const T& random_item(const std::vector<T>& items)
+   {
+      return items[std::uniform_int_distribution<size_t>(0, items.size() - 1)(_random)];
+   }
+
+   void call(call_kind kind)
+   {
+      switch (kind)
+      {
+      case call_get_full_accounts:
+      {
+         std::vector<std::string> names;
+         const uint32_t count = std::uniform_int_distribution<uint32_t>(1, 3)(_random);
+         for (uint32_t i = 0; i < count; ++i)
+            names.push_back(random_item(_config.accounts));
+         _db->get_full_accounts(names, true);
+         break;
+      }
+      case call_get_order_book:
+      {
+         const auto& market = random_item(_config.markets);
+         _db->get_order_book(market.first, market.second, 50);
+         break;
+      }
+      case call_get_account_history:
+         (*_history)->get_account_history(random_item(_config.accounts), operation_history_id_type(), 100,
+                                          operation_history_id_type());
+         break;
+      case call_subscribe_to_market:
+      {
+         const auto& market = random_item(_config.markets);
+         _db->subscribe_to_market([this](const fc::variant&) { on_market(); }, market.first, market.second);
+         break;
+      }
+      case call_broadcast_transaction:
+         (*_broadcast)->broadcast_transaction(make_transfer());
+         break;
+      case call_get_dynamic_global_properties:
+      default:
+         _db->get_dynamic_global_properties();
+      }
+   }
+
+   /** @return a transfer no other session produces, the sequence is spread over amounts and expirations */
+   signed_transaction make_transfer()
+   {
+      static std::atomic<uint64_t> sequence(0);
+      const uint64_t n = sequence++;
+      if (fc::time_point::now() - _reference_fetched > fc::seconds(10))
+      {
+         _reference = _db->get_dynamic_global_properties();
+         _reference_fetched = fc::time_point::now();
+      }
+      transfer_operation op;
+      op.from = _config.broadcast_from;
+      op.to = _config.broadcast_to;
+      op.fee = _config.broadcast_fee;
+      op.amount = asset(1 + (n / 3000) % 1000);
+      signed_transaction trx;
+      trx.operations.push_back(op);
+      trx.set_reference_block(_reference.head_block_id);
+      trx.set_expiration(_reference.time + fc::seconds(60 + n % 3000));
+      trx.sign(*_config.broadcast_key, _config.chain_id);
+      return trx;
+   }
+
+   void on_objects(const fc::variant& updates)
+   {
+      if (!updates.is_array())
+         return;
+      const fc::time_point now = fc::time_point::now();
+      for (const fc::variant& update : updates.get_array())
+      {
+         if (!update.is_object() || !update.get_object().contains("id") || update["id"].as_string() != "2.1.0")
+            continue;
+         const fc::time_point block_time = update["time"].as<fc::time_point_sec>(1);
+         _last_block_time = block_time.time_since_epoch().count();
+         std::lock_guard<std::mutex> lock(_stats.mutex);
+         _stats.object_notification_lag.record((now - block_time).count());
+      }
+   }
+
+   void on_market()
+   {
+      const int64_t last_block_time = _last_block_time;
+      if (last_block_time == 0)
+         return;
+      const int64_t lag = fc::time_point::now().time_since_epoch().count() - last_block_time;
+      std::lock_guard<std::mutex> lock(_stats.mutex);
+      _stats.market_notification_lag.record(lag);
+   }
+
+   const load_config&                                   _config;
+   load_stats&                                          _stats;
+   std::mt19937                                         _random;
+   fc::http::websocket_connection_ptr                   _connection;
+   std::shared_ptr<fc::rpc::websocket_api_connection>   _api;
+   fc::api<database_api>                                _db;
+   fc::optional<fc::api<history_api> >                  _history;
+   fc::optional<fc::api<network_broadcast_api> >        _broadcast;
+   dynamic_global_property_object                       _reference;
+   fc::time_point                                       _reference_fetched;
+   /** microseconds since the epoch, written by the thread of the websocket client */
+   std::atomic<int64_t>                                 _last_block_time{0};
+};
+
+/** @return the weights of the call kinds given as name:weight,..., kinds not mentioned get 0 */
+static std::array<uint32_t, call_kind_count> parse_mix(const std::string& mix)
+{
+   std::array<uint32_t, call_kind_count> weights;
+   weights.fill(0);
+   std::vector<std::string> items;
+   boost::split(items, mix, boost::is_any_of(","));
+   for (const std::string& item : items)
+   {
+      std::vector<std::string> parts;
+      boost::split(parts, item, boost::is_any_of(":"));
+      FC_ASSERT(parts.size() == 2, "Expected <call>:<weight> in ${i}", ("i", item));
+      const auto kind = std::find(std::begin(call_kind_names), std::end(call_kind_names), parts[0]);
+      FC_ASSERT(kind != std::end(call_kind_names), "Unknown call ${c}", ("c", parts[0]));
+      weights[kind - std::begin(call_kind_names)] = std::stoul(parts[1]);
+   }
+   uint32_t total = 0;
+   for (uint32_t weight : weights)
+      total += weight;
+   FC_ASSERT(total > 0, "The call mix is empty");
+   return weights;
+}
+
+static fc::mutable_variant_object report_latencies(latency_samples& samples, double seconds)
+{
+   return fc::mutable_variant_object()
+         ("count", samples.samples.size())
+         ("errors", samples.errors)
+         ("per_second", seconds > 0 ? samples.samples.size() / seconds : 0.)
+         ("p50_ms", samples.percentile(50))("p90_ms", samples.percentile(90))
+         ("p99_ms", samples.percentile(99))("max_ms", samples.percentile(100))
+         ("histogram_ms_upper_bounds_1_2_4", samples.histogram());
+}
+
+static void print_latencies(const std::string& name, latency_samples& samples, double seconds)
+{
+   if (samples.samples.empty() && samples.errors == 0)
+      return;
+   std::cout << name << ": " << samples.samples.size() << " (" << samples.errors << " errors), "
+             << (seconds > 0 ? samples.samples.size() / seconds : 0.) << "/s, p50 " << samples.percentile(50)
+             << " ms, p90 " << samples.percentile(90) << " ms, p99 " << samples.percentile(99) << " ms, max "
+             << samples.percentile(100) << " ms\n  histogram (< 1, 2, 4, ... ms):";
+   for (uint64_t count : samples.histogram())
+      std::cout << " " << count;
+   std::cout << "\n";
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      bpo::options_description options("Graphene Websocket API Load Generator");
+      options.add_options()
+         ("help,h", "Print this help message and exit.")
+         ("server", bpo::value<std::string>()->default_value("ws://127.0.0.1:8090"), "Websocket API endpoint of the node")
+         ("user", bpo::value<std::string>()->default_value(""), "API user to log in as")
+         ("password", bpo::value<std::string>()->default_value(""), "Password of the API user")
+         ("sessions", bpo::value<uint32_t>()->default_value(100), "Concurrent websocket sessions")
+         ("threads", bpo::value<uint32_t>()->default_value(4), "Worker threads, each with its own websocket client")
+         ("duration", bpo::value<uint32_t>()->default_value(60), "Seconds the sessions issue calls")
+         ("ramp-up", bpo::value<uint32_t>()->default_value(10), "Seconds over which the sessions connect")
+         ("calls-per-second", bpo::value<double>()->default_value(1), "Average calls per second of every session")
+         ("mix", bpo::value<std::string>()->default_value("get_full_accounts:30,get_order_book:30,get_account_history:20,"
+                                                          "subscribe_to_market:5,get_dynamic_global_properties:15"),
+          "Relative weights of the calls: get_full_accounts (with subscribe), get_order_book, get_account_history, "
+          "subscribe_to_market, broadcast_transaction and get_dynamic_global_properties")
+         ("account", bpo::value<std::vector<std::string> >()->composing(),
+          "Account name or id to look up, can be given several times (default committee-account)")
+         ("market", bpo::value<std::vector<std::string> >()->composing(),
+          "Market as BASE:QUOTE to query and subscribe to, can be given several times")
+         ("broadcast-from", bpo::value<std::string>(), "Account that pays the transfers of broadcast_transaction")
+         ("broadcast-to", bpo::value<std::string>(), "Account that receives the transfers of broadcast_transaction")
+         ("broadcast-wif-key", bpo::value<std::string>(), "Active key of broadcast-from in WIF format")
+         ("json", "Print the report as JSON instead of text");
+      bpo::variables_map vm;
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      if (vm.count("help"))
+      {
+         std::cout << options << "\n";
+         return 0;
+      }
+
+      load_config config;
+      config.server = vm["server"].as<std::string>();
+      config.user = vm["user"].as<std::string>();
+      config.password = vm["password"].as<std::string>();
+      config.weights = parse_mix(vm["mix"].as<std::string>());
+      config.calls_per_second = std::max(0.001, vm["calls-per-second"].as<double>());
+      config.accounts = vm.count("account") ? vm["account"].as<std::vector<std::string> >()
+                                            : std::vector<std::string>{ "committee-account" };
+      if (vm.count("market"))
+         for (const std::string& market : vm["market"].as<std::vector<std::string> >())
+         {
+            const size_t colon = market.find(':');
+            FC_ASSERT(colon != std::string::npos, "Expected BASE:QUOTE, got ${m}", ("m", market));
+            config.markets.emplace_back(market.substr(0, colon), market.substr(colon + 1));
+         }
+      FC_ASSERT(!config.markets.empty() || (!config.weights[call_get_order_book] && !config.weights[call_subscribe_to_market]),
+                "get_order_book and subscribe_to_market need at least one --market");
+
+      const uint32_t session_count = std::max<uint32_t>(1, vm["sessions"].as<uint32_t>());
+      const uint32_t thread_count = std::max<uint32_t>(1, std::min(session_count, vm["threads"].as<uint32_t>()));
+      const fc::microseconds ramp_up = fc::seconds(vm["ramp-up"].as<uint32_t>());
+      const fc::time_point start_time = fc::time_point::now();
+      config.end = start_time + ramp_up + fc::seconds(vm["duration"].as<uint32_t>());
+
+      if (config.weights[call_broadcast_transaction])
+      {
+         FC_ASSERT(vm.count("broadcast-from") && vm.count("broadcast-to") && vm.count("broadcast-wif-key"),
+                   "broadcast_transaction needs --broadcast-from, --broadcast-to and --broadcast-wif-key");
+         config.broadcast_key = graphene::utilities::wif_to_key(vm["broadcast-wif-key"].as<std::string>());
+         FC_ASSERT(config.broadcast_key, "Invalid --broadcast-wif-key");
+
+         // what all transfers share is looked up once
+         fc::http::websocket_client client;
+         auto connection = client.connect(config.server);
+         auto api = std::make_shared<fc::rpc::websocket_api_connection>(*connection, GRAPHENE_MAX_NESTED_OBJECTS);
+         fc::api<login_api> login = api->get_remote_api<login_api>(1);
+         FC_ASSERT(login->login(config.user, config.password), "Failed to log in to ${s}", ("s", config.server));
+         fc::api<database_api> db = login->database();
+         config.chain_id = db->get_chain_id();
+         const auto accounts = db->get_accounts({ vm["broadcast-from"].as<std::string>(),
+                                                  vm["broadcast-to"].as<std::string>() });
+         FC_ASSERT(accounts[0] && accounts[1], "Unknown broadcast account");
+         config.broadcast_from = accounts[0]->id;
+         config.broadcast_to = accounts[1]->id;
+         transfer_operation op;
+         op.from = config.broadcast_from;
+         op.to = config.broadcast_to;
+         op.amount = asset(1);
+         config.broadcast_fee = db->get_required_fees({ op }, "1.3.0")[0].as<asset>(1);
+         connection->close(1000, "done");
+      }
+
+      load_stats stats;
+      std::vector<std::unique_ptr<fc::thread> > threads;
+      std::vector<std::unique_ptr<fc::http::websocket_client> > clients;
+      for (uint32_t t = 0; t < thread_count; ++t)
+      {
+         threads.emplace_back(new fc::thread("api_load " + std::to_string(t)));
+         clients.emplace_back(new fc::http::websocket_client());
+      }
+      std::vector<std::unique_ptr<load_session> > sessions;
+      std::vector<fc::future<void> > runs;
+      for (uint32_t i = 0; i < session_count; ++i)
+      {
+         sessions.emplace_back(new load_session(config, stats, i));
+         load_session* session = sessions.back().get();
+         fc::http::websocket_client* client = clients[i % thread_count].get();
+         const fc::time_point session_start = start_time + fc::microseconds(ramp_up.count() * i / session_count);
+         runs.push_back(threads[i % thread_count]->async([session, client, session_start]() {
+            fc::usleep(session_start - fc::time_point::now());
+            session->run(*client);
+         }, "api_load session"));
+      }
+      for (auto& run : runs)
+         run.wait();
+      const double seconds = (config.end - start_time - ramp_up).count() / 1000000.;
+      for (auto& session : sessions)
+         session->close();
+
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      if (vm.count("json"))
+      {
+         fc::mutable_variant_object calls;
+         for (uint32_t kind = 0; kind < call_kind_count; ++kind)
+            if (!stats.calls[kind].samples.empty() || stats.calls[kind].errors)
+               calls(call_kind_names[kind], report_latencies(stats.calls[kind], seconds));
+         fc::mutable_variant_object report;
+         report("sessions", session_count)
+               ("sessions_started", stats.sessions_started)
+               ("sessions_failed", stats.sessions_failed)
+               ("seconds", seconds)
+               ("calls", calls)
+               ("object_notification_lag", report_latencies(stats.object_notification_lag, seconds))
+               ("market_notification_lag", report_latencies(stats.market_notification_lag, seconds));
+         std::cout << fc::json::to_pretty_string(report) << "\n";
+      }
+      else
+      {
+         std::cout << "sessions: " << stats.sessions_started << " of " << session_count << " started, "
+                   << stats.sessions_failed << " failed, " << seconds << " s after ramp-up\n";
+         for (uint32_t kind = 0; kind < call_kind_count; ++kind)
+            print_latencies(call_kind_names[kind], stats.calls[kind], seconds);
+         print_latencies("object notification lag behind block time", stats.object_notification_lag, seconds);
+         print_latencies("market notification lag behind block time", stats.market_notification_lag, seconds);
+      }
+      return 0;
+   }
+   catch (const fc::exception& e)
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
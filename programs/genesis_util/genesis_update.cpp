@@ -23,6 +23,8 @@
  */
 
 #include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -33,6 +35,7 @@
 
 #include <graphene/app/api.hpp>
 #include <graphene/chain/protocol/address.hpp>
+#include <graphene/db/task_scheduler.hpp>
 #include <graphene/egenesis/egenesis.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 
@@ -106,7 +109,8 @@ int main( int argc, char** argv )
          std::cerr << "update_genesis:  Reading genesis from file " << genesis_json_filename.preferred_string() << "\n";
          std::string genesis_json;
          read_file_contents( genesis_json_filename, genesis_json );
-         genesis = fc::json::from_string( genesis_json ).as< genesis_state_type >(20);
+         // converts the large arrays element by element on the worker threads, without a variant of the file
+         genesis = read_genesis_state( genesis_json );
       }
       else
       {
@@ -121,29 +125,44 @@ int main( int argc, char** argv )
          return fc::ecc::private_key::regenerate( fc::sha256::hash( dev_key_prefix + prefix + std::to_string(i) ) ).get_public_key();
       };
 
+      // deriving a key takes most of the time, the dev entries are made on the worker threads
+      auto for_each_parallel = []( uint32_t count, const std::function<void(uint32_t)>& make )
+      {
+         const uint32_t batch = 1024;
+         graphene::db::task_group workers;
+         for( uint32_t begin = 0; begin < count; begin += batch )
+         {
+            const uint32_t end = std::min( count, begin + batch );
+            workers.run( [&make,begin,end]() {
+               for( uint32_t i = begin; i < end; i++ )
+                  make( i );
+            });
+         }
+         workers.wait();
+      };
+
       uint32_t dev_account_count = options["dev-account-count"].as<uint32_t>();
       std::string dev_account_prefix = options["dev-account-prefix"].as<std::string>();
-      for(uint32_t i=0;i<dev_account_count;i++)
-      {
-         genesis_state_type::initial_account_type acct(
+      const size_t first_dev_account = genesis.initial_accounts.size();
+      genesis.initial_accounts.resize( first_dev_account + dev_account_count );
+      for_each_parallel( dev_account_count, [&]( uint32_t i ) {
+         genesis.initial_accounts[ first_dev_account + i ] = genesis_state_type::initial_account_type(
             dev_account_prefix+std::to_string(i),
             get_dev_key( "owner-", i ),
             get_dev_key( "active-", i ),
             false );
-
-         genesis.initial_accounts.push_back( acct );
-      }
+      });
 
       uint32_t dev_balance_count = options["dev-balance-count"].as<uint32_t>();
       uint64_t dev_balance_amount = options["dev-balance-amount"].as<uint64_t>();
-      for(uint32_t i=0;i<dev_balance_count;i++)
-      {
-         genesis_state_type::initial_balance_type bal;
+      const size_t first_dev_balance = genesis.initial_balances.size();
+      genesis.initial_balances.resize( first_dev_balance + dev_balance_count );
+      for_each_parallel( dev_balance_count, [&]( uint32_t i ) {
+         genesis_state_type::initial_balance_type& bal = genesis.initial_balances[ first_dev_balance + i ];
          bal.owner = address( get_dev_key( "balance-", i ) );
          bal.asset_symbol = "CORE";
          bal.amount = dev_balance_amount;
-         genesis.initial_balances.push_back( bal );
-      }
+      });
 
       std::map< std::string, size_t > name2index;
       size_t num_accounts = genesis.initial_accounts.size();
@@ -165,7 +184,8 @@ int main( int argc, char** argv )
       }
 
       fc::path output_filename = options["out"].as<boost::filesystem::path>();
-      fc::json::save_to_file( genesis, output_filename );
+      std::ofstream out( output_filename.preferred_string() );
+      write_genesis_state( genesis, out );
    }
    catch ( const fc::exception& e )
    {
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Runs a small p2p network of in-process graphene::net::node instances on loopback, each backed by a
+ * synthetic delegate that keeps a linear chain of empty-signature blocks in memory instead of a
+ * database.  One node produces blocks, transactions are injected at random nodes, and the tool
+ * reports how long blocks and transactions take to reach every other node, how fast late nodes sync,
+ * and how much CPU each node's p2p thread used.
+ */
+
+#include <graphene/net/node.hpp>
+#include <graphene/net/exceptions.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+# include <dirent.h>
+# include <fstream>
+# include <unistd.h>
+#endif
+
+namespace bpo = boost::program_options;
+
+using graphene::chain::block_id_type;
+using graphene::chain::signed_block;
+using graphene::chain::signed_transaction;
+using graphene::net::item_hash_t;
+using graphene::net::item_id;
+using graphene::net::message;
+
+/** latencies of one kind of item, kept in microseconds */
+struct latency_samples
+{
+   std::vector<int64_t> samples;
+
+   void record(const fc::time_point& start) { samples.push_back((fc::time_point::now() - start).count()); }
+
+   /** @return the given percentile of the samples in milliseconds, or 0 if there are none */
+   double percentile(double p)
+   {
+      if (samples.empty())
+         return 0;
+      std::sort(samples.begin(), samples.end());
+      size_t index = std::min(samples.size() - 1, (size_t)(p / 100. * samples.size()));
+      return samples[index] / 1000.;
+   }
+};
+
+/** state shared by all delegates; every delegate runs on the main thread, so this needs no locking */
+struct workload_tracker
+{
+   std::map<block_id_type, fc::time_point>                   block_creation_times;
+   std::map<graphene::net::message_hash_type, fc::time_point> transaction_creation_times;
+   latency_samples block_latencies;
+   latency_samples transaction_latencies;
+   uint64_t        sync_blocks_received = 0;
+};
+
+class synthetic_delegate : public graphene::net::node_delegate
+{
+public:
+   synthetic_delegate(workload_tracker& tracker, const graphene::chain::chain_id_type& chain_id, uint8_t block_interval) :
+      _tracker(tracker),
+      _chain_id(chain_id),
+      _block_interval(block_interval)
+   {}
+
+   uint32_t head_block_num() const { return _blocks.size(); }
+
+   /** appends a block extending our head that includes every transaction we know of and haven't seen included */
+   signed_block generate_block()
+   {
+      signed_block block;
+      block.previous = get_head_block_id();
+      block.timestamp = fc::time_point_sec(fc::time_point::now());
+      for (const auto& hash_and_trx : _pending_transactions)
+         block.transactions.push_back(graphene::chain::processed_transaction(hash_and_trx.second.trx));
+      block.transaction_merkle_root = block.calculate_merkle_root();
+      std::vector<fc::uint160_t> contained_transaction_message_ids;
+      append_block(block, contained_transaction_message_ids);
+      return block;
+   }
+
+   /** creates a transaction that no other call will produce, and treats it as received */
+   graphene::net::trx_message generate_transaction(uint64_t sequence)
+   {
+      signed_transaction trx;
+      trx.ref_block_num = sequence & 0xffff;
+      trx.ref_block_prefix = sequence >> 16;
+      trx.expiration = fc::time_point_sec(fc::time_point::now()) + fc::hours(1);
+      graphene::net::trx_message trx_msg(trx);
+      message trx_message_to_broadcast(trx_msg);
+      _transactions[trx_message_to_broadcast.id()] = trx_msg;
+      _pending_transactions[trx_message_to_broadcast.id()] = trx_msg;
+      return trx_msg;
+   }
+
+   bool has_item(const item_id& id) override
+   {
+      if (id.item_type == graphene::net::block_message_type)
+         return _block_numbers.find(id.item_hash) != _block_numbers.end();
+      return _transactions.find(id.item_hash) != _transactions.end();
+   }
+
+   bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
+                     std::vector<fc::uint160_t>& contained_transaction_message_ids) override
+   {
+      if (_block_numbers.find(blk_msg.block_id) != _block_numbers.end())
+         return false;
+      if (blk_msg.block.previous != get_head_block_id())
+         FC_THROW_EXCEPTION(graphene::net::unlinkable_block_exception, "block ${id} does not link to our head",
+                            ("id", blk_msg.block_id));
+      append_block(blk_msg.block, contained_transaction_message_ids);
+
+      auto creation_iter = _tracker.block_creation_times.find(blk_msg.block_id);
+      if (sync_mode)
+         ++_tracker.sync_blocks_received;
+      else if (creation_iter != _tracker.block_creation_times.end())
+         _tracker.block_latencies.record(creation_iter->second);
+      return false;
+   }
+
+   void handle_transaction(const graphene::net::trx_message& trx_msg) override
+   {
+      graphene::net::message_hash_type message_hash = message(trx_msg).id();
+      if (_transactions.find(message_hash) != _transactions.end())
+         return;
+      _transactions[message_hash] = trx_msg;
+      _pending_transactions[message_hash] = trx_msg;
+
+      auto creation_iter = _tracker.transaction_creation_times.find(message_hash);
+      if (creation_iter != _tracker.transaction_creation_times.end())
+         _tracker.transaction_latencies.record(creation_iter->second);
+   }
+
+   void handle_message(const message&) override {}
+
+   std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
+                                          uint32_t& remaining_item_count,
+                                          uint32_t limit) override
+   {
+      std::vector<item_hash_t> result;
+      remaining_item_count = 0;
+      if (_blocks.empty())
+         return result;
+
+      // same contract as the application: start at the last synopsis entry we share, or at genesis
+      uint32_t last_known_block_num = 0;
+      for (auto iter = blockchain_synopsis.rbegin(); iter != blockchain_synopsis.rend(); ++iter)
+      {
+         auto known = _block_numbers.find(*iter);
+         if (known != _block_numbers.end())
+         {
+            last_known_block_num = known->second;
+            break;
+         }
+      }
+      for (uint32_t num = std::max<uint32_t>(last_known_block_num, 1); num <= _blocks.size() && result.size() < limit; ++num)
+         result.push_back(_blocks[num - 1].id());
+      if (!result.empty() && graphene::chain::block_header::num_from_id(result.back()) < _blocks.size())
+         remaining_item_count = _blocks.size() - graphene::chain::block_header::num_from_id(result.back());
+      return result;
+   }
+
+   message get_item(const item_id& id) override
+   {
+      if (id.item_type == graphene::net::block_message_type)
+      {
+         auto iter = _block_numbers.find(id.item_hash);
+         if (iter == _block_numbers.end())
+            FC_THROW_EXCEPTION(fc::key_not_found_exception, "unknown block ${id}", ("id", id.item_hash));
+         return graphene::net::block_message(_blocks[iter->second - 1]);
+      }
+      auto iter = _transactions.find(id.item_hash);
+      if (iter == _transactions.end())
+         FC_THROW_EXCEPTION(fc::key_not_found_exception, "unknown transaction ${id}", ("id", id.item_hash));
+      return iter->second;
+   }
+
+   graphene::chain::chain_id_type get_chain_id() const override { return _chain_id; }
+
+   std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point,
+                                                    uint32_t number_of_blocks_after_reference_point) override
+   {
+      // there are no forks in the benchmark, so this is the application's synopsis without the fork handling
+      std::vector<item_hash_t> synopsis;
+      uint32_t high_block_num = _blocks.size();
+      if (reference_point != item_hash_t())
+      {
+         auto iter = _block_numbers.find(reference_point);
+         if (iter != _block_numbers.end())
+            high_block_num = iter->second;
+      }
+      if (high_block_num == 0)
+         return synopsis;
+
+      uint32_t true_high_block_num = high_block_num + number_of_blocks_after_reference_point;
+      uint32_t low_block_num = 1;
+      do
+      {
+         synopsis.push_back(_blocks[low_block_num - 1].id());
+         low_block_num += (true_high_block_num - low_block_num + 2) / 2;
+      }
+      while (low_block_num <= high_block_num);
+      return synopsis;
+   }
+
+   void sync_status(uint32_t, uint32_t) override {}
+   void connection_count_changed(uint32_t) override {}
+
+   uint32_t get_block_number(const item_hash_t& block_id) override
+   {
+      return graphene::chain::block_header::num_from_id(block_id);
+   }
+
+   fc::time_point_sec get_block_time(const item_hash_t& block_id) override
+   {
+      auto iter = _block_numbers.find(block_id);
+      if (iter == _block_numbers.end())
+         return fc::time_point_sec::min();
+      return _blocks[iter->second - 1].timestamp;
+   }
+
+   item_hash_t get_head_block_id() const override
+   {
+      return _blocks.empty() ? item_hash_t() : _blocks.back().id();
+   }
+
+   uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t) const override { return 0; }
+
+   void error_encountered(const std::string& message, const fc::oexception& error) override
+   {
+      wlog("network error: ${message}", ("message", message));
+   }
+
+   uint8_t get_current_block_interval_in_seconds() const override { return _block_interval; }
+
+private:
+   void append_block(const signed_block& block, std::vector<fc::uint160_t>& contained_transaction_message_ids)
+   {
+      _blocks.push_back(block);
+      _block_numbers[block.id()] = _blocks.size();
+      for (const graphene::chain::processed_transaction& trx : block.transactions)
+      {
+         graphene::net::message_hash_type message_hash = message(graphene::net::trx_message(trx)).id();
+         contained_transaction_message_ids.push_back(message_hash);
+         _pending_transactions.erase(message_hash);
+      }
+   }
+
+   workload_tracker&                                                  _tracker;
+   graphene::chain::chain_id_type                                     _chain_id;
+   uint8_t                                                            _block_interval;
+   std::vector<signed_block>                                          _blocks;
+   std::map<block_id_type, uint32_t>                                  _block_numbers;
+   std::map<graphene::net::message_hash_type, graphene::net::trx_message> _transactions;
+   std::map<graphene::net::message_hash_type, graphene::net::trx_message> _pending_transactions;
+};
+
+/** CPU time used by one thread, read from /proc since the nodes don't expose their threads */
+class thread_cpu_meter
+{
+public:
+   /** @return the ids of the threads in this process */
+   static std::set<std::string> list_threads()
+   {
+      std::set<std::string> threads;
+#ifdef __linux__
+      DIR* task_dir = opendir("/proc/self/task");
+      if (task_dir)
+      {
+         while (struct dirent* entry = readdir(task_dir))
+            if (entry->d_name[0] != '.')
+               threads.insert(entry->d_name);
+         closedir(task_dir);
+      }
+#endif
+      return threads;
+   }
+
+   /** @return the user+system CPU seconds the given threads have used */
+   static double cpu_seconds(const std::set<std::string>& threads)
+   {
+      double seconds = 0;
+#ifdef __linux__
+      static const long ticks_per_second = sysconf(_SC_CLK_TCK);
+      for (const std::string& thread : threads)
+      {
+         std::ifstream stat(("/proc/self/task/" + thread + "/stat").c_str());
+         std::string line;
+         if (!std::getline(stat, line))
+            continue;
+         // skip past the parenthesized thread name, which may contain spaces
+         size_t name_end = line.rfind(')');
+         if (name_end == std::string::npos)
+            continue;
+         std::istringstream fields(line.substr(name_end + 2));
+         std::string field;
+         uint64_t utime = 0, stime = 0;
+         // utime and stime are fields 14 and 15, counting from the pid
+         for (int i = 3; i <= 15 && fields >> field; ++i)
+            if (i == 14)
+               utime = std::stoull(field);
+            else if (i == 15)
+               stime = std::stoull(field);
+         seconds += double(utime + stime) / ticks_per_second;
+      }
+#endif
+      return seconds;
+   }
+};
+
+struct bench_node
+{
+   std::unique_ptr<synthetic_delegate>   delegate;
+   std::shared_ptr<graphene::net::node>  node;
+   std::set<std::string>                 threads;
+   fc::ip::endpoint                      endpoint;
+};
+
+static bool wait_until(const std::function<bool()>& condition, const fc::microseconds& timeout)
+{
+   fc::time_point deadline = fc::time_point::now() + timeout;
+   while (!condition())
+   {
+      if (fc::time_point::now() > deadline)
+         return false;
+      fc::usleep(fc::milliseconds(10));
+   }
+   return true;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      bpo::options_description options("Graphene P2P Network Benchmark");
+      options.add_options()
+         ("help,h", "Print this help message and exit.")
+         ("nodes", bpo::value<uint32_t>()->default_value(8), "Number of nodes to run")
+         ("connections", bpo::value<uint32_t>()->default_value(4), "Outbound connections each node makes to the next nodes in a ring")
+         ("blocks", bpo::value<uint32_t>()->default_value(30), "Number of blocks node 0 produces during the workload")
+         ("block-interval-ms", bpo::value<uint32_t>()->default_value(1000), "Time between produced blocks")
+         ("transactions-per-second", bpo::value<uint32_t>()->default_value(200), "Transactions injected at random nodes during the workload")
+         ("sync-blocks", bpo::value<uint32_t>()->default_value(0), "Blocks node 0 has before the network starts; the others sync them first")
+         ("json", "Print the report as JSON instead of text");
+      bpo::variables_map vm;
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      if (vm.count("help"))
+      {
+         std::cout << options << "\n";
+         return 0;
+      }
+
+      const uint32_t node_count = std::max<uint32_t>(vm["nodes"].as<uint32_t>(), 2);
+      const uint32_t connections = std::min<uint32_t>(vm["connections"].as<uint32_t>(), node_count - 1);
+      const uint32_t block_count = vm["blocks"].as<uint32_t>();
+      const fc::microseconds block_interval = fc::milliseconds(vm["block-interval-ms"].as<uint32_t>());
+      const uint32_t transactions_per_second = vm["transactions-per-second"].as<uint32_t>();
+      const uint32_t sync_block_count = vm["sync-blocks"].as<uint32_t>();
+      const uint8_t block_interval_seconds = std::max<uint32_t>(1, std::min<uint32_t>(255, block_interval.count() / 1000000));
+
+      fc::temp_directory data_dir(fc::temp_directory_path());
+      graphene::chain::chain_id_type chain_id = fc::sha256::hash(std::string("network_bench"));
+      workload_tracker tracker;
+
+      std::vector<bench_node> nodes(node_count);
+      for (uint32_t i = 0; i < node_count; ++i)
+      {
+         bench_node& n = nodes[i];
+         n.delegate.reset(new synthetic_delegate(tracker, chain_id, block_interval_seconds));
+         if (i == 0)
+            for (uint32_t block_num = 0; block_num < sync_block_count; ++block_num)
+               n.delegate->generate_block();
+
+         std::set<std::string> threads_before = thread_cpu_meter::list_threads();
+         n.node = std::make_shared<graphene::net::node>("network_bench");
+         std::set<std::string> threads_after = thread_cpu_meter::list_threads();
+         std::set_difference(threads_after.begin(), threads_after.end(), threads_before.begin(), threads_before.end(),
+                             std::inserter(n.threads, n.threads.end()));
+
+         n.node->load_configuration(data_dir.path() / ("node" + std::to_string(i)));
+         n.node->set_node_delegate(n.delegate.get());
+         n.node->disable_peer_advertising();
+         n.node->set_advanced_node_parameters(fc::mutable_variant_object()
+                                              ("desired_number_of_connections", connections)
+                                              ("maximum_number_of_connections", node_count));
+         n.node->listen_on_endpoint(fc::ip::endpoint(fc::ip::address("127.0.0.1"), 0), false);
+         n.node->accept_incoming_connections(true);
+         n.node->listen_to_p2p_network();
+         n.node->connect_to_p2p_network();
+         n.node->sync_from(item_id(graphene::net::block_message_type, n.delegate->get_head_block_id()), std::vector<uint32_t>());
+         n.endpoint = fc::ip::endpoint(fc::ip::address("127.0.0.1"), n.node->get_actual_listening_endpoint().port());
+      }
+
+      fc::time_point start_time = fc::time_point::now();
+      std::set<std::pair<uint32_t, uint32_t> > connected_pairs;
+      for (uint32_t i = 0; i < node_count; ++i)
+         for (uint32_t j = 1; j <= connections; ++j)
+         {
+            uint32_t peer = (i + j) % node_count;
+            if (!connected_pairs.insert(std::make_pair(std::min(i, peer), std::max(i, peer))).second)
+               continue;
+            try
+            {
+               nodes[i].node->connect_to_endpoint(nodes[peer].endpoint);
+            }
+            catch (const fc::exception& e)
+            {
+               wlog("node ${i} failed to connect to node ${peer}: ${e}", ("i", i)("peer", peer)("e", e.to_detail_string()));
+            }
+         }
+
+      auto all_nodes_at = [&nodes](uint32_t block_num) -> bool {
+         for (const bench_node& n : nodes)
+            if (n.delegate->head_block_num() < block_num)
+               return false;
+         return true;
+      };
+
+      double sync_seconds = 0;
+      if (sync_block_count)
+      {
+         if (!wait_until([&]() { return all_nodes_at(sync_block_count); }, fc::seconds(600)))
+            elog("not all nodes finished syncing ${count} blocks", ("count", sync_block_count));
+         sync_seconds = (fc::time_point::now() - start_time).count() / 1000000.;
+      }
+      if (!wait_until([&nodes]() -> bool {
+                         for (const bench_node& n : nodes)
+                            if (n.node->get_connection_count() == 0)
+                               return false;
+                         return true;
+                      }, fc::seconds(30)))
+         elog("some nodes failed to connect to the network");
+
+      std::vector<double> cpu_at_start;
+      for (const bench_node& n : nodes)
+         cpu_at_start.push_back(thread_cpu_meter::cpu_seconds(n.threads));
+
+      // workload: node 0 produces a block every interval, transactions arrive at random nodes in between
+      std::mt19937 random_generator(1776);
+      std::uniform_int_distribution<uint32_t> random_node(0, node_count - 1);
+      const fc::microseconds transaction_interval = transactions_per_second ? fc::microseconds(1000000 / transactions_per_second) : block_interval;
+      uint64_t transaction_sequence = 0;
+      fc::time_point workload_start = fc::time_point::now();
+      fc::time_point next_block_time = workload_start + block_interval;
+      fc::time_point next_transaction_time = workload_start;
+      uint32_t blocks_produced = 0;
+      while (blocks_produced < block_count)
+      {
+         fc::time_point now = fc::time_point::now();
+         if (now >= next_block_time)
+         {
+            signed_block block = nodes[0].delegate->generate_block();
+            tracker.block_creation_times[block.id()] = fc::time_point::now();
+            nodes[0].node->broadcast(graphene::net::block_message(block));
+            ++blocks_produced;
+            next_block_time += block_interval;
+         }
+         while (transactions_per_second && now >= next_transaction_time)
+         {
+            bench_node& n = nodes[random_node(random_generator)];
+            graphene::net::trx_message trx_msg = n.delegate->generate_transaction(++transaction_sequence);
+            tracker.transaction_creation_times[message(trx_msg).id()] = fc::time_point::now();
+            n.node->broadcast(trx_msg);
+            next_transaction_time += transaction_interval;
+         }
+         fc::usleep(fc::milliseconds(1));
+      }
+      uint32_t final_block_num = nodes[0].delegate->head_block_num();
+      if (!wait_until([&]() { return all_nodes_at(final_block_num); }, fc::seconds(30)))
+         elog("not all nodes reached block ${num}", ("num", final_block_num));
+      double workload_seconds = (fc::time_point::now() - workload_start).count() / 1000000.;
+
+      std::vector<double> cpu_used;
+      for (uint32_t i = 0; i < node_count; ++i)
+         cpu_used.push_back(thread_cpu_meter::cpu_seconds(nodes[i].threads) - cpu_at_start[i]);
+
+      uint64_t expected_block_deliveries = uint64_t(block_count) * (node_count - 1);
+      uint64_t expected_transaction_deliveries = transaction_sequence * (node_count - 1);
+
+      double block_p50 = tracker.block_latencies.percentile(50);
+      double block_p90 = tracker.block_latencies.percentile(90);
+      double block_p99 = tracker.block_latencies.percentile(99);
+      double block_max = tracker.block_latencies.percentile(100);
+      double transaction_p50 = tracker.transaction_latencies.percentile(50);
+      double transaction_p90 = tracker.transaction_latencies.percentile(90);
+      double transaction_p99 = tracker.transaction_latencies.percentile(99);
+      double transaction_max = tracker.transaction_latencies.percentile(100);
+      double sync_rate = sync_seconds > 0 ? sync_block_count / sync_seconds : 0.;
+
+      if (vm.count("json"))
+      {
+         fc::mutable_variant_object report;
+         report("nodes", node_count)
+               ("connections_per_node", connections)
+               ("workload_seconds", workload_seconds)
+               ("block_propagation", fc::mutable_variant_object()
+                     ("produced", block_count)
+                     ("delivered", tracker.block_latencies.samples.size())
+                     ("expected", expected_block_deliveries)
+                     ("p50_ms", block_p50)("p90_ms", block_p90)("p99_ms", block_p99)("max_ms", block_max))
+               ("transaction_propagation", fc::mutable_variant_object()
+                     ("injected", transaction_sequence)
+                     ("delivered", tracker.transaction_latencies.samples.size())
+                     ("expected", expected_transaction_deliveries)
+                     ("p50_ms", transaction_p50)("p90_ms", transaction_p90)("p99_ms", transaction_p99)("max_ms", transaction_max))
+               ("cpu_seconds_per_node", cpu_used);
+         if (sync_block_count)
+            report("sync", fc::mutable_variant_object()
+                     ("blocks", sync_block_count)
+                     ("seconds", sync_seconds)
+                     ("blocks_per_second_per_node", sync_rate)
+                     ("blocks_received", tracker.sync_blocks_received));
+         std::cout << fc::json::to_pretty_string(report) << "\n";
+      }
+      else
+      {
+         std::cout << "nodes: " << node_count << ", " << connections << " outbound connections each\n";
+         std::cout << "blocks: " << tracker.block_latencies.samples.size() << "/" << expected_block_deliveries << " delivered, "
+                   << "p50 " << block_p50 << " ms, p90 " << block_p90 << " ms, p99 " << block_p99 << " ms, max " << block_max << " ms\n";
+         std::cout << "transactions: " << tracker.transaction_latencies.samples.size() << "/" << expected_transaction_deliveries << " delivered, "
+                   << "p50 " << transaction_p50 << " ms, p90 " << transaction_p90 << " ms, p99 " << transaction_p99 << " ms, max " << transaction_max << " ms\n";
+         if (sync_block_count)
+            std::cout << "sync: " << sync_block_count << " blocks to " << (node_count - 1) << " nodes in " << sync_seconds << " s ("
+                      << sync_rate << " blocks/s per node)\n";
+         std::cout << "cpu seconds per node over " << workload_seconds << " s:";
+         for (double seconds : cpu_used)
+            std::cout << " " << seconds;
+         std::cout << "\n";
+      }
+
+      for (bench_node& n : nodes)
+         n.node->close();
+      return 0;
+   }
+   catch (const fc::exception& e)
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
@@ -22,13 +22,18 @@
  * THE SOFTWARE.
  */
 
+#include <fc/io/fstream.hpp>
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
 #include <fc/variant_object.hpp>
 
+#include <graphene/chain/database.hpp>
 #include <graphene/chain/protocol/block.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
 #include <algorithm>
 #include <iostream>
 #include <sstream>
@@ -36,6 +41,7 @@
 #include <vector>
 
 using namespace graphene::chain;
+namespace bpo = boost::program_options;
 
 vector< fc::variant_object > g_op_types;
 
@@ -64,10 +70,112 @@ struct size_check_type_visitor
    }
 };
 
+/**
+ * Loads the object database of a node and prints per object type the memory its objects use: sizeof, the average,
+ * 99th percentile and largest heap memory owned by the members of one object, the bookkeeping of the multi_index
+ * container per object and the totals, largest total first. Only the indexes of the chain are loaded, objects of
+ * plugins are skipped.
+ */
+static void report_object_sizes( const fc::path& data_dir )
+{
+   fc::path blockchain_dir = data_dir;
+   if( fc::exists( data_dir / "blockchain" ) )
+      blockchain_dir = data_dir / "blockchain";
+   FC_ASSERT( fc::exists( blockchain_dir / "object_database" ), "No object database in ${d}", ("d",blockchain_dir) );
+   FC_ASSERT( !fc::exists( blockchain_dir / "object_database" / "lock" ),
+              "The object database in ${d} is locked, stop the node or use a copy", ("d",blockchain_dir) );
+   std::string version;
+   if( fc::exists( blockchain_dir / "db_version" ) )
+      fc::read_file_contents( blockchain_dir / "db_version", version );
+   FC_ASSERT( version == GRAPHENE_CURRENT_DB_VERSION, "The object database has version ${v}, this build reads ${c}",
+              ("v",version)("c",GRAPHENE_CURRENT_DB_VERSION) );
+
+   database db;
+   // opens the saved objects without the block database, so that nothing is replayed
+   graphene::db::object_database& objects = db;
+   objects.open( blockchain_dir );
+
+   vector< fc::mutable_variant_object > types;
+   uint64_t total_bytes = 0;
+   objects.inspect_all_indexes( [&types,&total_bytes]( const graphene::db::index& idx ) {
+      const graphene::db::index_memory_usage usage = idx.get_memory_usage();
+      if( usage.object_count == 0 )
+         return;
+      vector< uint64_t > dynamic_sizes;
+      dynamic_sizes.reserve( usage.object_count );
+      uint64_t object_size = 0;
+      idx.inspect_all_objects( [&dynamic_sizes,&object_size]( const graphene::db::object& obj ) {
+         object_size = obj.object_size();
+         dynamic_sizes.push_back( obj.dynamic_memory_size() );
+      });
+      std::sort( dynamic_sizes.begin(), dynamic_sizes.end() );
+      total_bytes += usage.total_bytes();
+
+      fc::mutable_variant_object vo;
+      vo["id"] = fc::to_string( usage.space_id ) + "." + fc::to_string( usage.type_id );
+      vo["name"] = usage.object_type;
+      vo["count"] = usage.object_count;
+      vo["mem_size"] = object_size;
+      vo["avg_dynamic_size"] = double( usage.dynamic_bytes ) / usage.object_count;
+      vo["p99_dynamic_size"] = dynamic_sizes[ std::min( dynamic_sizes.size() - 1, dynamic_sizes.size() * 99 / 100 ) ];
+      vo["max_dynamic_size"] = dynamic_sizes.back();
+      vo["container_size_per_object"] = double( usage.container_bytes ) / usage.object_count;
+      vo["object_bytes"] = usage.object_bytes;
+      vo["dynamic_bytes"] = usage.dynamic_bytes;
+      vo["container_bytes"] = usage.container_bytes;
+      vo["secondary_index_bytes"] = usage.secondary_index_bytes;
+      vo["total_bytes"] = usage.total_bytes();
+      types.push_back( vo );
+   });
+
+   std::stable_sort( types.begin(), types.end(),
+   [](const fc::mutable_variant_object& a, const fc::mutable_variant_object& b) {
+   return a["total_bytes"].as_uint64() > b["total_bytes"].as_uint64();
+   });
+   std::cout << "[\n";
+   for( size_t i=0; i<types.size(); i++ )
+   {
+      std::cout << "   " << fc::json::to_string( types[i] );
+      if( i < types.size()-1 )
+         std::cout << ",\n";
+      else
+         std::cout << "\n";
+   }
+   std::cout << "]\n";
+   std::cerr << "Estimated memory of all objects: " << total_bytes << " bytes\n";
+}
+
 int main( int argc, char** argv )
 {
    try
    {
+      bpo::options_description cli_options("Prints the sizes of operations, or of the objects of a data directory");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("data-dir,d", bpo::value<boost::filesystem::path>(),
+             "Data directory of a stopped node, or a copy of it, whose objects to report instead of the operations")
+            ;
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "size_checker:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 0;
+      }
+      if( options.count("data-dir") )
+      {
+         report_object_sizes( options["data-dir"].as<boost::filesystem::path>() );
+         return 0;
+      }
+
       graphene::chain::operation op;
 
 
@@ -30,9 +30,12 @@
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
 #include <graphene/market_history/market_history_plugin.hpp>
 #include <graphene/delayed_node/delayed_node_plugin.hpp>
+#include <graphene/replica/replica_plugin.hpp>
 #include <graphene/snapshot/snapshot.hpp>
 #include <graphene/es_objects/es_objects.hpp>
 #include <graphene/grouped_orders/grouped_orders_plugin.hpp>
+#include <graphene/history_export/history_export_plugin.hpp>
+#include <graphene/block_stream/block_stream_plugin.hpp>
 
 #include <fc/thread/thread.hpp>
 #include <fc/interprocess/signals.hpp>
@@ -79,9 +82,12 @@ int main(int argc, char** argv) {
       auto elasticsearch_plug = node->register_plugin<elasticsearch::elasticsearch_plugin>();
       auto market_history_plug = node->register_plugin<market_history::market_history_plugin>();
       auto delayed_plug = node->register_plugin<delayed_node::delayed_node_plugin>();
+      auto replica_plug = node->register_plugin<replica::replica_plugin>();
       auto snapshot_plug = node->register_plugin<snapshot_plugin::snapshot_plugin>();
       auto es_objects_plug = node->register_plugin<es_objects::es_objects_plugin>();
       auto grouped_orders_plug = node->register_plugin<grouped_orders::grouped_orders_plugin>();
+      auto history_export_plug = node->register_plugin<history_export::history_export_plugin>();
+      auto block_stream_plug = node->register_plugin<block_stream::block_stream_plugin>();
 
       try
       {
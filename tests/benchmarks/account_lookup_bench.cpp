@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <chrono>
+
+using namespace graphene::chain;
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( bench_clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+uint32_t base_count( uint32_t release, uint32_t debug )
+{
+#ifdef NDEBUG
+   return release;
+#else
+   return debug;
+#endif
+}
+
+/// names of the form a wallet user types, with common prefixes
+string bench_name( uint64_t n )
+{
+   static const char* const stems[] = { "bts-", "init", "user-", "trader", "a", "gateway-" };
+   return stems[ n % 6 ] + fc::to_string( n * 2654435761ull % 1000000007ull );
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( account_lookup_bench )
+
+/**
+ * Prefix scans of 10 names, as wallet autocomplete issues them for every keystroke, and exact lookups by name,
+ * through the by_name index and through account_name_index, on accounts created directly in the database.
+ */
+BOOST_AUTO_TEST_CASE( account_name_lookup_bench )
+{ try {
+   const uint32_t accounts = base_count( 1000000, 50000 );
+   const uint32_t lookups = base_count( 200000, 10000 );
+   database db;
+   for( uint32_t i = 0; i < accounts; ++i )
+      db.create<account_object>( [i]( account_object& a ) { a.name = bench_name( i ); } );
+
+   vector<string> prefixes;
+   vector<string> names;
+   for( uint32_t i = 0; i < lookups; ++i )
+   {
+      names.push_back( bench_name( uint64_t( i ) * 7919 % accounts ) );
+      prefixes.push_back( names.back().substr( 0, 1 + i % names.back().size() ) );
+   }
+
+   const auto& by_name_idx = db.get_index_type<account_index>().indices().get<by_name>();
+   const auto& names_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<account_index>() )
+                              .get_secondary_index<account_name_index>();
+   uint64_t check = 0;
+
+   auto start = bench_clock::now();
+   for( const string& p : prefixes )
+   {
+      uint32_t limit = 10;
+      for( auto itr = by_name_idx.lower_bound( p ); limit-- && itr != by_name_idx.end(); ++itr )
+         check += itr->id.instance();
+   }
+   const int64_t tree_scan_ns = elapsed_ns( start );
+
+   start = bench_clock::now();
+   for( const string& p : prefixes )
+   {
+      uint32_t limit = 10;
+      names_idx.for_each_from( p, [&check,&limit]( const account_name_index::entry& e ) -> bool {
+         check -= e.id.instance.value;
+         return --limit > 0;
+      });
+   }
+   const int64_t index_scan_ns = elapsed_ns( start );
+
+   start = bench_clock::now();
+   for( const string& n : names )
+      check += by_name_idx.find( n )->id.instance();
+   const int64_t tree_find_ns = elapsed_ns( start );
+
+   start = bench_clock::now();
+   for( const string& n : names )
+      check -= names_idx.find( n )->instance.value;
+   const int64_t index_find_ns = elapsed_ns( start );
+
+   graphene::app::database_api db_api( db );
+   start = bench_clock::now();
+   for( const string& p : prefixes )
+      check += db_api.lookup_accounts( p, 10 ).size();
+   const int64_t api_ns = elapsed_ns( start );
+   check -= 10 * prefixes.size();
+
+   BOOST_CHECK_EQUAL( check, 0u );
+   ilog( "${n} account names, per lookup: prefix scan of 10 ${ts} ns by_name, ${is} ns account_name_index; "
+         "exact lookup ${tf} ns by_name, ${if} ns account_name_index; lookup_accounts ${a} ns; "
+         "account_name_index uses ${m} bytes, the by_name tree nodes about ${t} bytes",
+         ("n",accounts)("ts",tree_scan_ns / lookups)("is",index_scan_ns / lookups)
+         ("tf",tree_find_ns / lookups)("if",index_find_ns / lookups)("a",api_ns / lookups)
+         ("m",names_idx.estimated_memory_usage())("t",by_name_idx.size() * 4 * sizeof(void*)) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
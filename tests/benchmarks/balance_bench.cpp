@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( bench_clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+uint32_t base_count( uint32_t release, uint32_t debug )
+{
+#ifdef NDEBUG
+   return release;
+#else
+   return debug;
+#endif
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( balance_bench )
+
+/**
+ * get_balance() and adjust_balance() on accounts holding 1 to 8 assets, with the balance objects created directly.
+ * Every account is looked up in random order, so the lookups miss the cache like those of a block would.
+ */
+BOOST_AUTO_TEST_CASE( balance_lookup_bench )
+{ try {
+   const uint32_t accounts = base_count( 1000000, 50000 );
+   const uint32_t max_assets = 8;
+   database db;
+   for( uint32_t a = 0; a < accounts; ++a )
+      for( uint32_t i = 0; i <= a % max_assets; ++i )
+         db.create<account_balance_object>( [a,i]( account_balance_object& b ) {
+            b.owner = account_id_type( a );
+            b.asset_type = asset_id_type( i );
+            b.balance = 1000000;
+         });
+
+   vector<uint32_t> order( accounts );
+   uint64_t state = 88172645463325252ull;
+   for( uint32_t i = 0; i < accounts; ++i )
+      order[i] = i;
+   for( uint32_t i = accounts; i > 1; --i )
+   {
+      state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+      std::swap( order[i - 1], order[ state % i ] );
+   }
+
+   int64_t total = 0;
+   auto start = bench_clock::now();
+   for( uint32_t a : order )
+      total += db.get_balance( account_id_type( a ), asset_id_type( a % max_assets / 2 ) ).amount.value;
+   const int64_t lookup_ns = elapsed_ns( start );
+
+   start = bench_clock::now();
+   for( uint32_t a : order )
+      db.adjust_balance( account_id_type( a ), asset( a % 2 ? 1 : -1, asset_id_type( a % max_assets / 2 ) ) );
+   const int64_t adjust_ns = elapsed_ns( start );
+
+   ilog( "Balances of ${n} accounts with 1 to ${m} assets: get_balance ${l} ns, adjust_balance ${a} ns, ${s} bytes "
+         "in balances_by_account_index (${t})",
+         ("n",accounts)("m",max_assets)("l",lookup_ns / accounts)("a",adjust_ns / accounts)
+         ("s",db.get_index_type< primary_index< account_balance_index > >()
+                .get_secondary_index< balances_by_account_index >().estimated_memory_usage())("t",total) );
+} FC_LOG_AND_RETHROW() }
+
+/// Blocks of transfers between accounts that hold CORE and three user issued assets
+BOOST_FIXTURE_TEST_CASE( transfer_blocks_bench, database_fixture )
+{ try {
+   const uint32_t accounts = base_count( 10000, 1000 );
+   const uint32_t blocks = base_count( 100, 10 );
+   const uint32_t transfers_per_block = 1000;
+
+   vector<asset_id_type> assets;
+   for( const char* symbol : { "BENCHA", "BENCHB", "BENCHC" } )
+      assets.push_back( create_user_issued_asset( symbol ).id );
+   assets.push_back( asset_id_type() );
+   vector<account_id_type> holders;
+   for( uint32_t i = 0; i < accounts; ++i )
+   {
+      holders.push_back( create_account( "holder" + fc::to_string(i) ).id );
+      for( const asset_id_type& a : assets )
+      {
+         if( a == asset_id_type() )
+            transfer( committee_account, holders.back(), asset( 1000000 ) );
+         else
+            issue_uia( holders.back(), asset( 1000000, a ) );
+      }
+      if( i % 500 == 499 )
+         generate_block();
+   }
+   generate_block();
+
+   int64_t push_ns = 0;
+   int64_t block_ns = 0;
+   for( uint32_t b = 0; b < blocks; ++b )
+   {
+      auto start = bench_clock::now();
+      for( uint32_t t = 0; t < transfers_per_block; ++t )
+      {
+         const uint32_t n = b * transfers_per_block + t;
+         transfer_operation op;
+         op.from = holders[ n % accounts ];
+         op.to = holders[ ( n * 7919 + 1 ) % accounts ];
+         if( op.to == op.from )
+            op.to = holders[ ( n + 1 ) % accounts ];
+         op.amount = asset( 1, assets[ n % assets.size() ] );
+         trx.operations.push_back( op );
+         set_expiration( db, trx );
+         db.push_transaction( trx, ~0 );
+         trx.clear();
+      }
+      push_ns += elapsed_ns( start );
+      start = bench_clock::now();
+      generate_block( ~0 );
+      block_ns += elapsed_ns( start );
+   }
+   ilog( "${b} blocks of ${t} transfers between ${n} accounts: ${p} ns per transfer pushed, ${g} ms per block generated",
+         ("b",blocks)("t",transfers_per_block)("n",accounts)
+         ("p",push_ns / ( int64_t(blocks) * transfers_per_block ))("g",block_ns / 1000000 / blocks) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/transaction_evaluation_state.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( evaluator_dispatch_bench, database_fixture )
+
+/** Times the evaluation of transfers through database::apply_operation() and within a block */
+BOOST_AUTO_TEST_CASE( transfer_dispatch )
+{ try {
+#ifdef NDEBUG
+   const uint32_t transfers = 200000;
+   const uint32_t block_transfers = 10000;
+#else
+   const uint32_t transfers = 20000;
+   const uint32_t block_transfers = 2000;
+#endif
+   typedef std::chrono::steady_clock clock;
+
+   ACTORS( (alice)(bob) );
+   fund( alice, asset( 100000000 ) );
+   generate_block();
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset( 1 );
+   const operation transfer_op( op );
+   {
+      auto session = db._undo_db.start_undo_session();
+      transaction_evaluation_state eval_state( &db );
+      eval_state.skip_fee_schedule_check = true;
+      const auto start = clock::now();
+      for( uint32_t i = 0; i < transfers; ++i )
+         db.apply_operation( eval_state, transfer_op );
+      const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+      ilog( "Evaluator dispatch: ${n} transfers applied in ${t} ms, ${r} per second",
+            ("n",transfers)("t",ns/1000000)("r",ns > 0 ? uint64_t(transfers) * 1000000000 / ns : 0) );
+   }
+
+   // one transfer per transaction, the amounts keep the transactions distinct
+   set_expiration( db, trx );
+   for( uint32_t i = 0; i < block_transfers; ++i )
+   {
+      op.amount = asset( 1 + i );
+      trx.operations = { op };
+      PUSH_TX( db, trx, ~0 );
+   }
+   trx.clear();
+   const auto start = clock::now();
+   const signed_block block = generate_block();
+   const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+   BOOST_CHECK_EQUAL( block.transactions.size(), block_transfers );
+   ilog( "Evaluator dispatch: block of ${n} transfers produced and applied in ${t} ms, ${r} transfers per second",
+         ("n",block_transfers)("t",ns/1000000)("r",ns > 0 ? uint64_t(block_transfers) * 1000000000 / ns : 0) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
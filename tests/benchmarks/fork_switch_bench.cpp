@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace graphene::chain;
+
+/*
+ * Fork switches of configurable depth: two databases build competing branches from a common head, the second one
+ * one block longer, and the blocks of the longer branch are pushed into the first database until it switches. A
+ * switch pops the blocks of the old branch through the undo database and applies the new branch again, so this is
+ * the guard for changes to undo_database, fork_database and database::_push_block.
+ *
+ * Only three of the ten witnesses produce blocks, so the last irreversible block stays put and the branches may be
+ * arbitrarily deep. Every block carries account_create and account_update transactions, which the undo database
+ * reverts as removals and as restored old values. Per depth one JSON object is printed per line on stdout:
+ *   {"bench":"fork_switch","depth":16,"txs_per_block":50,"reps":5,"median_switch_us":..,"min_switch_us":..,
+ *    "pop_blocks_per_s":..,"reapply_blocks_per_s":..,"peak_rss_growth_kb":..}
+ * pop_blocks_per_s undoes a branch block by block with pop_block, reapply_blocks_per_s pushes it again, and
+ * peak_rss_growth_kb is the largest growth of the peak resident set during a switch, on Linux only.
+ *
+ * Options (after `--` on the command line):
+ *   --fork-bench-depth=<n>[,<n>...] depths of the branches that are switched away from
+ *   --fork-bench-txs=<n>            transactions per block, defaults to 50
+ *   --fork-bench-reps=<n>           switches per depth, defaults to 5
+ *   --fork-bench-output=<file>      appends the JSON lines to file as well
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( bench_clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+struct fork_bench_options
+{
+   vector<uint32_t> depths;
+   uint32_t         txs_per_block = 50;
+   uint32_t         reps = 5;
+   std::string      output;
+
+   fork_bench_options()
+   {
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--fork-bench-depth=" ) == 0 )
+         {
+            std::stringstream list( arg.substr( 19 ) );
+            std::string depth;
+            while( std::getline( list, depth, ',' ) )
+               depths.push_back( std::max( 1, std::stoi( depth ) ) );
+         }
+         else if( arg.find( "--fork-bench-txs=" ) == 0 )
+            txs_per_block = std::max( 0, std::stoi( arg.substr( 17 ) ) );
+         else if( arg.find( "--fork-bench-reps=" ) == 0 )
+            reps = std::max( 1, std::stoi( arg.substr( 18 ) ) );
+         else if( arg.find( "--fork-bench-output=" ) == 0 )
+            output = arg.substr( 20 );
+      }
+      if( depths.empty() )
+#ifdef NDEBUG
+         depths = { 1, 4, 16, 64 };
+#else
+         depths = { 1, 4, 16 };
+#endif
+   }
+};
+
+/// @return the value of a field of /proc/self/status in kilobytes, 0 where it is not available
+int64_t status_kb( const char* field )
+{
+   std::ifstream status( "/proc/self/status" );
+   std::string line;
+   while( std::getline( status, line ) )
+      if( line.compare( 0, strlen( field ), field ) == 0 )
+         return std::stoll( line.substr( strlen( field ) ) );
+   return 0;
+}
+
+/// Restarts the peak resident set size (VmHWM) at the current one, Linux 4.0 and later
+void reset_peak_rss()
+{
+   std::ofstream( "/proc/self/clear_refs" ) << "5";
+}
+
+const fc::ecc::private_key& bench_key()
+{
+   static const fc::ecc::private_key key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "null_key" ) ) );
+   return key;
+}
+
+genesis_state_type make_fork_genesis()
+{
+   genesis_state_type genesis_state;
+   genesis_state.initial_timestamp = time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+   genesis_state.initial_active_witnesses = 10;
+   for( unsigned int i = 0; i < genesis_state.initial_active_witnesses; ++i )
+   {
+      auto name = "init"+fc::to_string(i);
+      genesis_state.initial_accounts.emplace_back( name, bench_key().get_public_key(), bench_key().get_public_key(),
+                                                   true );
+      genesis_state.initial_committee_candidates.push_back({name});
+      genesis_state.initial_witness_candidates.push_back({name, bench_key().get_public_key()});
+   }
+   genesis_state.initial_parameters.current_fees->zero_all_fees();
+   return genesis_state;
+}
+
+const uint32_t bench_skip = database::skip_witness_signature | database::skip_transaction_signatures;
+
+/// Builds the blocks of one branch on one database
+class branch_builder
+{
+   public:
+      branch_builder( database& db, const flat_set<witness_id_type>& producers )
+         : _db( db ), _producers( producers )
+      {
+         const auto& by_account_name = db.get_index_type<account_index>().indices().get<by_name>();
+         for( unsigned int i = 0; i < 10; ++i )
+            _updated.push_back( by_account_name.find( "init"+fc::to_string(i) )->get_id() );
+      }
+
+      /**
+       * Appends blocks to the database, the first one after skipped_slots slots of the producers.
+       * Transactions create accounts named after prefix and update the options of the initial accounts.
+       */
+      vector<signed_block> extend( const std::string& prefix, uint32_t blocks, uint32_t txs_per_block,
+                                   uint32_t skipped_slots )
+      {
+         vector<signed_block> result;
+         for( uint32_t b = 0; b < blocks; ++b )
+         {
+            for( uint32_t t = 0; t < txs_per_block; ++t )
+            {
+               signed_transaction trx;
+               if( t % 2 == 0 )
+               {
+                  account_create_operation op;
+                  op.registrar = GRAPHENE_TEMP_ACCOUNT;
+                  op.name = prefix + "x" + fc::to_string(b) + "x" + fc::to_string(t);
+                  op.owner = authority( 1, bench_key().get_public_key(), 1 );
+                  op.active = op.owner;
+                  op.options.memo_key = bench_key().get_public_key();
+                  trx.operations.push_back( op );
+               }
+               else
+               {
+                  const account_object& account = _updated[ t / 2 % _updated.size() ]( _db );
+                  account_update_operation op;
+                  op.account = account.get_id();
+                  op.new_options = account.options;
+                  op.new_options->memo_key = public_key_type( fc::ecc::private_key::regenerate(
+                                                fc::sha256::hash( prefix + fc::to_string(b) ) ).get_public_key() );
+                  trx.operations.push_back( op );
+               }
+               // the expiration keeps transactions of equal operations apart
+               trx.set_expiration( _db.head_block_time() + fc::seconds( 60 + t ) );
+               trx.set_reference_block( _db.head_block_id() );
+               _db.push_transaction( trx, bench_skip );
+            }
+            uint32_t slot = next_slot( 0 );
+            for( uint32_t skipped = 0; b == 0 && skipped < skipped_slots; ++skipped )
+               slot = next_slot( slot );
+            result.push_back( _db.generate_block( _db.get_slot_time( slot ), _db.get_scheduled_witness( slot ),
+                                                  bench_key(), bench_skip ) );
+         }
+         return result;
+      }
+
+   private:
+      /// @return the first slot after the given one that belongs to a producer
+      uint32_t next_slot( uint32_t slot )const
+      {
+         do
+            ++slot;
+         while( _producers.find( _db.get_scheduled_witness( slot ) ) == _producers.end() );
+         return slot;
+      }
+
+      database&                       _db;
+      const flat_set<witness_id_type> _producers;
+      vector<account_id_type>         _updated;
+};
+
+double median_of( vector<int64_t> samples )
+{
+   std::sort( samples.begin(), samples.end() );
+   return samples.size() % 2 ? samples[ samples.size() / 2 ]
+         : ( samples[ samples.size() / 2 - 1 ] + samples[ samples.size() / 2 ] ) / 2.0;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( fork_switch_bench )
+{
+   try {
+      const fork_bench_options options;
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1, db2;
+      db1.open( dir1.path(), make_fork_genesis, "TEST" );
+      db2.open( dir2.path(), make_fork_genesis, "TEST" );
+
+      // fewer than a third of the witnesses confirm blocks, so nothing becomes irreversible
+      const auto& active = db1.get_global_properties().active_witnesses;
+      const flat_set<witness_id_type> producers( active.begin(), active.begin() + 3 );
+      branch_builder branch1( db1, producers ), branch2( db2, producers );
+
+      for( const signed_block& b : branch1.extend( "base", 5, 0, 0 ) )
+         db2.push_block( b, bench_skip );
+
+      for( uint32_t depth : options.depths )
+      {
+         vector<int64_t> switches, pops, reapplies;
+         int64_t peak_rss_growth_kb = 0;
+         for( uint32_t rep = 0; rep < options.reps; ++rep )
+         {
+            const std::string tag = "d" + fc::to_string(depth) + "r" + fc::to_string(rep);
+            const vector<signed_block> old_branch = branch1.extend( "forka" + tag, depth, options.txs_per_block, 0 );
+            const vector<signed_block> new_branch = branch2.extend( "forkb" + tag, depth + 1, options.txs_per_block,
+                                                                    1 );
+            for( uint32_t i = 0; i < depth; ++i )
+               db1.push_block( new_branch[i], bench_skip );
+            BOOST_REQUIRE( db1.head_block_id() == old_branch.back().id() );
+
+            reset_peak_rss();
+            const int64_t rss_kb = status_kb( "VmRSS:" );
+            auto start = bench_clock::now();
+            db1.push_block( new_branch.back(), bench_skip );
+            switches.push_back( elapsed_ns( start ) );
+            peak_rss_growth_kb = std::max( peak_rss_growth_kb, status_kb( "VmHWM:" ) - rss_kb );
+            BOOST_REQUIRE( db1.head_block_id() == new_branch.back().id() );
+            // drop the transactions of the old branch, they were pushed back as pending
+            db1.clear_pending();
+
+            start = bench_clock::now();
+            for( size_t i = 0; i < new_branch.size(); ++i )
+               db2.pop_block();
+            pops.push_back( elapsed_ns( start ) );
+            db2.clear_pending();
+
+            // this includes pushing the transactions handed back by pop_block, as a node would
+            start = bench_clock::now();
+            for( const signed_block& b : new_branch )
+               db2.push_block( b, bench_skip );
+            reapplies.push_back( elapsed_ns( start ) );
+            db2.clear_pending();
+            BOOST_REQUIRE( db2.head_block_id() == db1.head_block_id() );
+         }
+
+         const double blocks = depth + 1;
+         fc::mutable_variant_object result;
+         result( "bench", "fork_switch" )( "depth", depth )( "txs_per_block", options.txs_per_block )
+               ( "reps", options.reps )
+               ( "median_switch_us", median_of( switches ) / 1000 )
+               ( "min_switch_us", *std::min_element( switches.begin(), switches.end() ) / 1000 )
+               ( "pop_blocks_per_s", blocks * 1e9 / std::max( median_of( pops ), 1.0 ) )
+               ( "reapply_blocks_per_s", blocks * 1e9 / std::max( median_of( reapplies ), 1.0 ) )
+               ( "peak_rss_growth_kb", peak_rss_growth_kb );
+         const std::string line = fc::json::to_string( result );
+         std::cout << line << std::endl;
+         if( !options.output.empty() )
+            std::ofstream( options.output, std::ios::app ) << line << '\n';
+      }
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -26,6 +26,7 @@
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/test/auto_unit_test.hpp>
 
@@ -63,16 +64,36 @@ BOOST_AUTO_TEST_CASE( genesis_and_persistence_bench )
          genesis_state.initial_accounts.emplace_back("target"+fc::to_string(i),
                                                      public_key_type(fc::ecc::private_key::regenerate(fc::digest(i)).get_public_key()));
 
+      {
+         const string genesis_json = fc::json::to_string( genesis_state );
+         fc::time_point start_time = fc::time_point::now();
+         genesis_state_type parsed = fc::json::from_string( genesis_json ).as<genesis_state_type>( 20 );
+         fc::microseconds serial = fc::time_point::now() - start_time;
+         start_time = fc::time_point::now();
+         genesis_state_type parsed_in_parallel = read_genesis_state( genesis_json );
+         fc::microseconds parallel = fc::time_point::now() - start_time;
+         BOOST_CHECK( parsed_in_parallel.compute_chain_id() == parsed.compute_chain_id() );
+         ilog( "Parsed genesis of ${n} bytes in ${s} milliseconds, or in ${p} milliseconds in parallel.",
+               ("n",genesis_json.size())("s",serial.count() / 1000)("p",parallel.count() / 1000) );
+      }
+
       fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
 
       {
          database db;
+         fc::time_point start_time = fc::time_point::now();
          db.open(data_dir.path(), [&]{return genesis_state;}, "test");
+         fc::microseconds elapsed = fc::time_point::now() - start_time;
+         // every account comes with its statistics object
+         const uint64_t objects = 2 * uint64_t(account_count);
+         ilog( "Initialized genesis of ${a} accounts in ${t} milliseconds, ${r} objects per second.",
+               ("a",account_count)("t",elapsed.count() / 1000)
+               ("r",objects * 1000000 / std::max<int64_t>( elapsed.count(), 1 )) );
 
          for( int i = 11; i < account_count + 11; ++i)
             BOOST_CHECK(db.get_balance(account_id_type(i), asset_id_type()).amount == GRAPHENE_MAX_SHARE_SUPPLY / account_count);
 
-         fc::time_point start_time = fc::time_point::now();
+         start_time = fc::time_point::now();
          db.close();
          ilog("Closed database in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000));
       }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/market_object.hpp>
+
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+namespace {
+
+struct bench_pool_tag;
+
+/// same layout as limit_order_multi_index_type, with a configurable allocator
+template<typename Allocator>
+using order_container = multi_index_container<
+   limit_order_object,
+   indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_expiration>,
+         composite_key< limit_order_object,
+            member< limit_order_object, time_point_sec, &limit_order_object::expiration>,
+            member< object, object_id_type, &object::id>
+         >
+      >,
+      ordered_unique< tag<by_price>,
+         composite_key< limit_order_object,
+            member< limit_order_object, price, &limit_order_object::sell_price>,
+            member< object, object_id_type, &object::id>
+         >,
+         composite_key_compare< std::greater<price>, std::less<object_id_type> >
+      >
+   >,
+   Allocator
+>;
+
+/** Simulates order churn: keeps a window of live orders, creating one and removing the oldest per step */
+template<typename Container>
+int64_t churn( uint32_t window, uint32_t steps )
+{
+   Container orders;
+   limit_order_object order;
+   order.sell_price = price( asset( 1 ), asset( 1, asset_id_type(1) ) );
+
+   const fc::time_point start = fc::time_point::now();
+   for( uint32_t i = 0; i < window + steps; ++i )
+   {
+      order.id = limit_order_id_type( i );
+      order.expiration = fc::time_point_sec( i );
+      order.sell_price.base.amount = 1 + ( i * 7919 ) % 100000;
+      orders.insert( order );
+      if( i >= window )
+         orders.erase( object_id_type( limit_order_id_type( i - window ) ) );
+   }
+   return ( fc::time_point::now() - start ).count();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( index_allocator_bench )
+{
+#ifdef NDEBUG
+   const uint32_t steps = 2000000;
+#else
+   const uint32_t steps = 200000;
+#endif
+   const uint32_t window = 10000;
+
+   // warm up the pool so both variants start from a populated heap
+   churn< order_container< pooled_allocator< limit_order_object, bench_pool_tag > > >( window, window );
+
+   const int64_t heap = churn< order_container< std::allocator< limit_order_object > > >( window, steps );
+   const int64_t pooled = churn< order_container< pooled_allocator< limit_order_object, bench_pool_tag > > >( window, steps );
+
+   ilog( "Order churn with std::allocator: ${n} create/remove pairs in ${t} ms, ${r} per second",
+         ("n",steps)("t",heap/1000)("r",heap > 0 ? uint64_t(steps) * 1000000 / heap : 0) );
+   ilog( "Order churn with pooled_allocator: ${n} create/remove pairs in ${t} ms, ${r} per second",
+         ("n",steps)("t",pooled/1000)("r",pooled > 0 ? uint64_t(steps) * 1000000 / pooled : 0) );
+}
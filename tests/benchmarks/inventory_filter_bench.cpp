@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/asset.hpp>
+#include <graphene/net/peer_connection.hpp>
+#include <graphene/net/rolling_bloom_filter.hpp>
+
+#include <fc/crypto/ripemd160.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::net;
+
+BOOST_AUTO_TEST_CASE( inventory_filter_bench )
+{
+   // what one peer is told about in GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES at GRAPHENE_NET_MAX_TRX_PER_SECOND
+   const uint32_t seconds = GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * 60;
+   const uint32_t per_second = GRAPHENE_NET_MAX_TRX_PER_SECOND;
+   std::vector<item_id> items;
+   items.reserve( seconds * per_second * 2 );
+   for( uint32_t i = 0; i < seconds * per_second * 2; ++i )
+      items.emplace_back( trx_message_type, fc::ripemd160::hash( (const char*)&i, sizeof(i) ) );
+   const size_t inserted = items.size() / 2; // the others are never inserted
+
+   const fc::time_point start_time = fc::time_point::now();
+   peer_connection::timestamped_items_set_type set;
+   rolling_bloom_filter filter( fc::minutes( GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES ) );
+
+   fc::time_point start = fc::time_point::now();
+   for( size_t i = 0; i < inserted; ++i )
+      set.insert( peer_connection::timestamped_item_id( items[i], start_time + fc::seconds( i / per_second ) ) );
+   const int64_t set_insert_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+   start = fc::time_point::now();
+   for( size_t i = 0; i < inserted; ++i )
+      filter.insert( items[i], start_time + fc::seconds( i / per_second ) );
+   const int64_t filter_insert_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+   uint64_t set_hits = 0;
+   start = fc::time_point::now();
+   for( const item_id& item : items )
+      set_hits += set.find( item ) != set.end();
+   const int64_t set_lookup_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+   uint64_t false_negatives = 0;
+   uint64_t false_positives = 0;
+   start = fc::time_point::now();
+   for( size_t i = 0; i < items.size(); ++i )
+   {
+      const bool found = filter.may_contain( items[i] );
+      if( i < inserted && !found )
+         ++false_negatives;
+      else if( i >= inserted && found )
+         ++false_positives;
+   }
+   const int64_t filter_lookup_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+   BOOST_CHECK_EQUAL( set_hits, inserted );
+   // at full traffic the oldest items may have been dropped early, but nothing of the last 30 seconds
+   for( size_t i = inserted - 30 * per_second; i < inserted; ++i )
+      BOOST_CHECK( filter.may_contain( items[i] ) );
+   BOOST_CHECK_LT( false_positives, inserted / 200 );
+
+   // a hashed and an ordered index node per element, roughly what boost::multi_index allocates
+   const size_t set_memory = set.size() * ( sizeof(peer_connection::timestamped_item_id) + 5 * sizeof(void*) )
+                             + set.bucket_count() * sizeof(void*);
+   ilog( "Inventory of ${n} items: multi_index set ~${s} bytes, rolling bloom filter ${f} bytes",
+         ("n", inserted)("s", set_memory)("f", filter.memory_usage()) );
+   ilog( "Inserts per second: set ${s}, filter ${f}",
+         ("s", inserted * 1000000 / set_insert_time)("f", inserted * 1000000 / filter_insert_time) );
+   ilog( "Lookups per second: set ${s}, filter ${f}",
+         ("s", items.size() * 1000000 / set_lookup_time)("f", items.size() * 1000000 / filter_lookup_time) );
+   ilog( "Filter forgot ${n} of the oldest items, ${p} false positives in ${c} lookups of unknown items",
+         ("n", false_negatives)("p", false_positives)("c", items.size() - inserted) );
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/database_api.hpp>
+#include <graphene/app/json_writer.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+typedef std::chrono::steady_clock clock;
+
+/** writes the value through fc::variant and directly, checks both agree and logs the times */
+template< typename T >
+void compare_json( const char* what, const T& value, uint32_t rounds )
+{
+   std::string through_variant;
+   auto start = clock::now();
+   for( uint32_t i = 0; i < rounds; ++i )
+      through_variant = fc::json::to_string( fc::variant( value, GRAPHENE_MAX_NESTED_OBJECTS ) );
+   const int64_t variant_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+
+   std::string direct;
+   start = clock::now();
+   for( uint32_t i = 0; i < rounds; ++i )
+      direct = graphene::app::to_json( value );
+   const int64_t direct_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+
+   BOOST_CHECK( direct == through_variant );
+   ilog( "JSON writer: ${w} (${s} bytes) written ${r} times, ${v} ms through fc::variant, ${d} ms directly",
+         ("w",what)("s",direct.size())("r",rounds)("v",variant_ns/1000000)("d",direct_ns/1000000) );
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE( json_writer_bench, database_fixture )
+
+/** Compares the JSON of a block of transfers and of full accounts written through fc::variant and directly */
+BOOST_AUTO_TEST_CASE( block_and_full_account_json )
+{ try {
+#ifdef NDEBUG
+   const uint32_t rounds = 100;
+   const uint32_t block_transfers = 2000;
+#else
+   const uint32_t rounds = 10;
+   const uint32_t block_transfers = 500;
+#endif
+   ACTORS( (alice)(bob) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).id;
+   fund( alice, asset( 100000000 ) );
+   for( uint32_t i = 0; i < 50; ++i )
+      create_sell_order( alice_id, asset( 10 + i ), asset( 100, usd_id ) );
+   generate_block();
+
+   set_expiration( db, trx );
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   for( uint32_t i = 0; i < block_transfers; ++i )
+   {
+      op.amount = asset( 1 + i );
+      trx.operations = { op };
+      PUSH_TX( db, trx, ~0 );
+   }
+   trx.clear();
+   const signed_block block = generate_block();
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), block_transfers );
+   compare_json( "block", block, rounds );
+
+   graphene::app::database_api db_api( db );
+   const auto accounts = db_api.get_full_accounts( { "alice" }, false );
+   BOOST_REQUIRE_EQUAL( 1u, accounts.size() );
+   compare_json( "full account", accounts.begin()->second, rounds * 10 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
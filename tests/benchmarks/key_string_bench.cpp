@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/protocol/base58.hpp>
+#include <graphene/chain/protocol/key_string_cache.hpp>
+
+#include <fc/crypto/base58.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( key_string_bench, database_fixture )
+
+/** Times base58 conversions of keys and get_full_accounts results converted to JSON with and without the cache */
+BOOST_AUTO_TEST_CASE( full_account_key_strings )
+{ try {
+#ifdef NDEBUG
+   const uint32_t conversions = 200000;
+   const uint32_t rounds = 50;
+#else
+   const uint32_t conversions = 20000;
+   const uint32_t rounds = 5;
+#endif
+   const uint32_t account_count = 100;
+   typedef std::chrono::steady_clock clock;
+   const auto elapsed_ms = []( clock::time_point start ) {
+      return std::chrono::duration_cast<std::chrono::milliseconds>( clock::now() - start ).count();
+   };
+
+   const public_key_type key( generate_private_key( "key" ).get_public_key() );
+   public_key_type::binary_key bin;
+   bin.data = key.key_data;
+   const vector<char> packed = fc::raw::pack( bin );
+   auto start = clock::now();
+   for( uint32_t i = 0; i < conversions; ++i )
+      fc::from_base58( fc::to_base58( packed.data(), packed.size() ) );
+   const auto fc_ms = elapsed_ms( start );
+   start = clock::now();
+   for( uint32_t i = 0; i < conversions; ++i )
+      from_base58( to_base58( packed.data(), packed.size() ) );
+   const auto limb_ms = elapsed_ms( start );
+   ilog( "Key strings: ${n} base58 round trips of a key in ${f} ms with fc, ${l} ms in limbs",
+         ("n",conversions)("f",fc_ms)("l",limb_ms) );
+
+   vector<string> names;
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      names.push_back( "account" + fc::to_string( i ) );
+      create_account( names.back(), generate_private_key( names.back() ).get_public_key() );
+   }
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   key_string_cache& cache = key_string_cache::instance();
+   const size_t capacity = cache.capacity();
+   for( size_t cache_size : { size_t(0), capacity } )
+   {
+      cache.set_capacity( cache_size );
+      cache.clear();
+      start = clock::now();
+      size_t json_size = 0;
+      for( uint32_t i = 0; i < rounds; ++i )
+         json_size += fc::json::to_string( fc::variant( db_api.get_full_accounts( names, false ),
+                                                        GRAPHENE_MAX_NESTED_OBJECTS ) ).size();
+      ilog( "Key strings: ${r} times get_full_accounts of ${n} accounts to JSON (${s} bytes) in ${t} ms, "
+            "cache of ${c} strings", ("r",rounds)("n",account_count)("s",json_size)("t",elapsed_ms( start ))
+            ("c",cache_size) );
+   }
+   cache.set_capacity( capacity );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
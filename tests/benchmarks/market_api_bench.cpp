@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api.hpp>
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/grouped_orders/grouped_orders_plugin.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../performance/allocation_profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/// Latency and heap allocations of the calls of one API method
+class api_call_recorder
+{
+   public:
+      explicit api_call_recorder( const string& name ) : _name( name ) {}
+
+      /// Calls f the given number of times, timing and counting the allocations of every call
+      template<typename F>
+      void run( uint32_t calls, F&& f )
+      {
+         size_t results = 0;
+         for( uint32_t i = 0; i < calls; ++i )
+         {
+            allocation_profiler allocations;
+            auto start = std::chrono::steady_clock::now();
+            allocations.start();
+            results += f( i );
+            allocations.stop();
+            _samples.push_back( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - start ).count() );
+            _allocations += allocations.total().allocations;
+            _bytes += allocations.total().bytes;
+         }
+         _results_per_call = calls > 0 ? results / calls : 0;
+      }
+
+      void report()
+      {
+         if( _samples.empty() )
+            return;
+         std::sort( _samples.begin(), _samples.end() );
+         ilog( "${s}: ${n} calls of ${r} results, latency in us p50 ${p50} p99 ${p99} max ${max}, "
+               "${a} allocations of ${b} bytes per call",
+               ("s",_name)("n",_samples.size())("r",_results_per_call)
+               ("p50",percentile(50)/1000)("p99",percentile(99)/1000)("max",_samples.back()/1000)
+               ("a",_allocations / _samples.size())("b",_bytes / _samples.size()) );
+      }
+
+   private:
+      int64_t percentile( uint32_t p )const { return _samples[ ( _samples.size() - 1 ) * p / 100 ]; }
+
+      string          _name;
+      vector<int64_t> _samples;
+      uint64_t        _allocations = 0;
+      uint64_t        _bytes = 0;
+      size_t          _results_per_call = 0;
+};
+
+/**
+ * Fills a bitasset market with limit, call and settle orders and its trade history, then calls the market data
+ * APIs against it. The objects are created directly instead of through operations, the read APIs only look at the
+ * indexes, so owners of call and settle orders are account ids that do not exist.
+ *
+ * Options (after `--` on the command line):
+ *   --market-api-orders=<n>   limit orders on the book, half asks and half bids; a tenth as many call and settle
+ *                             orders
+ *   --market-api-history=<n>  trades in the history, two order_history_objects each
+ *   --market-api-calls=<n>    calls of every API method
+ */
+struct market_api_bench_fixture : database_fixture
+{
+   uint32_t        orders = 0;
+   uint32_t        history = 0;
+   uint32_t        calls = 1000;
+   asset_id_type   usd;
+   string          usd_symbol;
+   string          core_symbol;
+
+   market_api_bench_fixture()
+   {
+#ifdef NDEBUG
+      orders = 1000000;
+      history = 1000000;
+#else
+      orders = 10000;
+      history = 10000;
+#endif
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--market-api-orders=" ) == 0 )
+            orders = std::max( 2, std::stoi( arg.substr( 20 ) ) );
+         else if( arg.find( "--market-api-history=" ) == 0 )
+            history = std::max( 1, std::stoi( arg.substr( 21 ) ) );
+         else if( arg.find( "--market-api-calls=" ) == 0 )
+            calls = std::max( 1, std::stoi( arg.substr( 19 ) ) );
+      }
+
+      generate_blocks( HARDFORK_CORE_1479_TIME );
+      generate_block();
+      const account_id_type feedproducer = create_account( "feedproducer" ).id;
+      usd = create_bitasset( "USDBIT", feedproducer ).id;
+      usd_symbol = usd( db ).symbol;
+      core_symbol = asset_id_type()( db ).symbol;
+      update_feed_producers( usd, { feedproducer } );
+      price_feed feed;
+      feed.maintenance_collateral_ratio = 1750;
+      feed.maximum_short_squeeze_ratio = 1100;
+      feed.settlement_price = asset( 1, usd ) / asset( 5 );
+      publish_feed( usd, feedproducer, feed );
+      generate_block();
+
+      auto start = std::chrono::steady_clock::now();
+      populate( create_account( "trader" ).id );
+      ilog( "Market API benchmark: ${o} limit orders, ${c} call and settle orders and ${h} trades in ${t} ms",
+            ("o",orders)("c",orders / 10)("h",history)
+            ("t",std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start )
+                 .count()) );
+   }
+
+   void populate( account_id_type trader )
+   {
+      // 1000 price levels on either side, asks from 5 CORE per USD up and bids from 4.999 down
+      for( uint32_t i = 0; i < orders; ++i )
+      {
+         const int64_t level = i / 2 % 1000;
+         db.create<limit_order_object>( [&]( limit_order_object& o ) {
+            o.seller = trader;
+            o.for_sale = 1000;
+            o.expiration = time_point_sec::maximum();
+            if( i % 2 == 0 )
+               o.sell_price = price( asset( 1000, usd ), asset( 5000 + level ) );
+            else
+               o.sell_price = price( asset( 4999 - level ), asset( 1000, usd ) );
+         });
+      }
+      for( uint32_t i = 0; i < orders / 10; ++i )
+      {
+         const account_id_type owner( 1000000 + i );
+         db.create<call_order_object>( [&]( call_order_object& o ) {
+            o.borrower = owner;
+            o.debt = 1000;
+            o.collateral = 10000 + i % 5000;
+            o.call_price = price::call_price( asset( o.debt, usd ), asset( o.collateral ), 1750 );
+         });
+         db.create<force_settlement_object>( [&]( force_settlement_object& o ) {
+            o.owner = owner;
+            o.balance = asset( 100, usd );
+            o.settlement_date = db.head_block_time() + fc::days( 1 ) + fc::seconds( i );
+         });
+      }
+      // every trade is recorded for the maker and the taker, one trade per block interval back in time
+      const asset_id_type core_id;
+      for( uint32_t i = 0; i < history; ++i )
+      {
+         const time_point_sec time = db.head_block_time() - fc::seconds( 5 * int64_t(i) );
+         for( int side = 0; side < 2; ++side )
+            db.create<graphene::market_history::order_history_object>(
+               [&]( graphene::market_history::order_history_object& o ) {
+                  o.key.base = core_id;
+                  o.key.quote = usd;
+                  o.key.sequence = -( 2 * int64_t(i) + side + 1 );
+                  o.time = time;
+                  const asset pays = side == 0 ? asset( 1000, usd ) : asset( 5000 );
+                  const asset receives = side == 0 ? asset( 5000 ) : asset( 1000, usd );
+                  o.op = fill_order_operation( limit_order_id_type( i ), trader, pays, receives, asset(),
+                                               price( pays, receives ), side == 0 );
+               });
+      }
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( market_api_bench, market_api_bench_fixture )
+
+BOOST_AUTO_TEST_CASE( market_data_api_bench )
+{ try {
+   graphene::app::application_options options;
+   options.has_market_history_plugin = true;
+   graphene::app::database_api db_api( db, &options );
+   graphene::app::orders_api orders_api( app );
+   const time_point_sec now = db.head_block_time();
+
+   api_call_recorder order_book( "get_order_book of 50" );
+   order_book.run( calls, [&]( uint32_t ) -> size_t {
+      const auto book = db_api.get_order_book( usd_symbol, core_symbol, 50 );
+      return book.bids.size() + book.asks.size();
+   });
+   order_book.report();
+
+   api_call_recorder limit_orders( "get_limit_orders of 300" );
+   limit_orders.run( calls, [&]( uint32_t ) {
+      return db_api.get_limit_orders( usd_symbol, core_symbol, 300 ).size();
+   });
+   limit_orders.report();
+
+   api_call_recorder call_orders( "get_call_orders of 300" );
+   call_orders.run( calls, [&]( uint32_t ) {
+      return db_api.get_call_orders( usd_symbol, 300 ).size();
+   });
+   call_orders.report();
+
+   api_call_recorder settle_orders( "get_settle_orders of 300" );
+   settle_orders.run( calls, [&]( uint32_t ) {
+      return db_api.get_settle_orders( usd_symbol, 300 ).size();
+   });
+   settle_orders.report();
+
+   api_call_recorder recent_trades( "get_trade_history of the latest 100" );
+   recent_trades.run( calls, [&]( uint32_t ) {
+      return db_api.get_trade_history( usd_symbol, core_symbol, now, time_point_sec(), 100 ).size();
+   });
+   recent_trades.report();
+
+   // pages spread over the whole history
+   api_call_recorder old_trades( "get_trade_history of 100 anywhere in the history" );
+   old_trades.run( calls, [&]( uint32_t i ) {
+      const time_point_sec start = now - fc::seconds( 5 * int64_t( uint64_t(i) * 7919 % history ) );
+      return db_api.get_trade_history( usd_symbol, core_symbol, start, time_point_sec(), 100 ).size();
+   });
+   old_trades.report();
+
+   const auto plugin = app.get_plugin<graphene::grouped_orders::grouped_orders_plugin>( "grouped_orders" );
+   BOOST_REQUIRE( plugin && !plugin->tracked_groups().empty() );
+   for( uint16_t group : plugin->tracked_groups() )
+   {
+      api_call_recorder grouped( "get_grouped_limit_orders of 101 in group " + fc::to_string( group ) );
+      grouped.run( calls, [&]( uint32_t ) {
+         return orders_api.get_grouped_limit_orders( usd_symbol, core_symbol, group, optional<price>(), 101 ).size();
+      });
+      grouped.report();
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/// Collects the latency of every measured operation of a scenario
+class latency_recorder
+{
+   public:
+      explicit latency_recorder( const string& name ) : _name( name ) {}
+
+      void record( int64_t ns ) { _samples.push_back( ns ); }
+
+      void report()
+      {
+         if( _samples.empty() )
+            return;
+         std::sort( _samples.begin(), _samples.end() );
+         int64_t total = 0;
+         for( int64_t ns : _samples )
+            total += ns;
+         ilog( "${s}: ${n} operations in ${t} ms, ${r} per second, latency in us p50 ${p50} p90 ${p90} p99 ${p99} max ${max}",
+               ("s",_name)("n",_samples.size())("t",total/1000000)
+               ("r",total > 0 ? uint64_t(_samples.size()) * 1000000000 / total : 0)
+               ("p50",percentile(50)/1000)("p90",percentile(90)/1000)("p99",percentile(99)/1000)
+               ("max",_samples.back()/1000) );
+      }
+
+   private:
+      int64_t percentile( uint32_t p )const { return _samples[ ( _samples.size() - 1 ) * p / 100 ]; }
+
+      string          _name;
+      vector<int64_t> _samples;
+};
+
+/**
+ * Sets up a bitasset market at a configurable point in time, so that matching can be compared across hardforks.
+ *
+ * Options (after `--` on the command line):
+ *   --market-bench-scale=<n>   multiplies the number of orders of every scenario
+ *   --market-bench-time=<iso>  chain time at which the scenarios run, defaults to after all market hardforks
+ */
+struct market_bench_fixture : database_fixture
+{
+   uint32_t        scale = 1;
+   account_id_type feedproducer;
+   asset_id_type   usd;
+   price_feed      feed;
+
+   market_bench_fixture()
+   {
+      time_point_sec bench_time = HARDFORK_CORE_1479_TIME;
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--market-bench-scale=" ) == 0 )
+            scale = std::max( 1, std::stoi( arg.substr( 21 ) ) );
+         else if( arg.find( "--market-bench-time=" ) == 0 )
+            bench_time = time_point_sec::from_iso_string( arg.substr( 20 ) );
+      }
+
+      generate_blocks( bench_time );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      generate_block();
+      ilog( "Running market benchmark at ${t}, scale ${s}", ("t",db.head_block_time())("s",scale) );
+
+      feedproducer = create_account( "feedproducer" ).id;
+      usd = create_bitasset( "USDBIT", feedproducer ).id;
+      update_feed_producers( usd, { feedproducer } );
+      feed.maintenance_collateral_ratio = 1750;
+      feed.maximum_short_squeeze_ratio = 1100;
+      publish( asset( 1, usd ) / asset( 5 ) );
+      generate_block();
+   }
+
+   /// Pushes a single operation and adds its latency to the recorder if there is one
+   operation_result push( const operation& op, latency_recorder* recorder = nullptr )
+   {
+      trx.operations.push_back( op );
+      set_expiration( db, trx );
+      auto start = std::chrono::steady_clock::now();
+      processed_transaction ptx = db.push_transaction( trx, ~0 );
+      if( recorder != nullptr )
+         recorder->record( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start ).count() );
+      trx.clear();
+      // keep the pending state small, it is applied again for every generated block
+      if( ++_pending >= 1000 )
+      {
+         generate_block();
+         _pending = 0;
+      }
+      return ptx.operation_results[0];
+   }
+
+   void publish( const price& settlement_price, latency_recorder* recorder = nullptr )
+   {
+      feed.settlement_price = settlement_price;
+      asset_publish_feed_operation op;
+      op.publisher = feedproducer;
+      op.asset_id = usd;
+      op.feed = feed;
+      push( op, recorder );
+   }
+
+   account_id_type make_trader( const string& name, int64_t core )
+   {
+      account_id_type id = create_account( name ).id;
+      transfer_operation op;
+      op.from = committee_account;
+      op.to = id;
+      op.amount = asset( core );
+      push( op );
+      return id;
+   }
+
+   void borrow_usd( account_id_type who, int64_t debt, int64_t collateral )
+   {
+      call_order_update_operation op;
+      op.funding_account = who;
+      op.delta_debt = asset( debt, usd );
+      op.delta_collateral = asset( collateral );
+      push( op );
+   }
+
+   void send_usd( account_id_type from, account_id_type to, int64_t amount )
+   {
+      transfer_operation op;
+      op.from = from;
+      op.to = to;
+      op.amount = asset( amount, usd );
+      push( op );
+   }
+
+   limit_order_create_operation make_order( account_id_type seller, const asset& sell, const asset& receive )const
+   {
+      limit_order_create_operation op;
+      op.seller = seller;
+      op.amount_to_sell = sell;
+      op.min_to_receive = receive;
+      return op;
+   }
+
+   private:
+      uint32_t _pending = 0;
+};
+
+uint32_t base_count( uint32_t release, uint32_t debug )
+{
+#ifdef NDEBUG
+   return release;
+#else
+   return debug;
+#endif
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( market_bench, market_bench_fixture )
+
+/// Builds a deep book of asks at distinct prices, then sweeps it with takers that fill ten levels each
+BOOST_AUTO_TEST_CASE( deep_book_bench )
+{ try {
+   const uint32_t levels = base_count( 50000, 5000 ) * scale;
+   account_id_type maker = make_trader( "maker", int64_t(levels) * 400 );
+   account_id_type taker = make_trader( "taker", int64_t(levels) * 200 + int64_t(levels) * levels );
+   borrow_usd( maker, int64_t(levels) * 10, int64_t(levels) * 400 );
+
+   latency_recorder inserts( "deep book insert" );
+   for( uint32_t i = 0; i < levels; ++i )
+      push( make_order( maker, asset( 10, usd ), asset( 60 + i ) ), &inserts );
+   inserts.report();
+
+   latency_recorder sweeps( "deep book sweep of 10 levels" );
+   for( uint32_t level = 0; level + 10 <= levels / 2; level += 10 )
+      push( make_order( taker, asset( 10 * ( 60 + level + 9 ) ), asset( 100, usd ) ), &sweeps );
+   sweeps.report();
+} FC_LOG_AND_RETHROW() }
+
+/// Alternates small asks and bids that cross each other completely
+BOOST_AUTO_TEST_CASE( small_crossing_orders_bench )
+{ try {
+   const uint32_t pairs = base_count( 50000, 5000 ) * scale;
+   account_id_type seller = make_trader( "seller", int64_t(pairs) * 40 );
+   account_id_type buyer = make_trader( "buyer", int64_t(pairs) * 10 );
+   borrow_usd( seller, pairs, int64_t(pairs) * 40 );
+
+   latency_recorder makers( "small crossing maker" );
+   latency_recorder takers( "small crossing taker" );
+   for( uint32_t i = 0; i < pairs; ++i )
+   {
+      push( make_order( seller, asset( 1, usd ), asset( 6 ) ), &makers );
+      push( make_order( buyer, asset( 6 ), asset( 1, usd ) ), &takers );
+   }
+   makers.report();
+   takers.report();
+   BOOST_CHECK( db.get_index_type<limit_order_index>().indices().empty() );
+} FC_LOG_AND_RETHROW() }
+
+/**
+ * Drops the feed so that every position gets into margin call territory. Half of the positions are called by
+ * asks that are already on the book when the feed is published, the other half one by one by incoming asks.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_cascade_bench )
+{ try {
+   const uint32_t positions = base_count( 10000, 1000 ) * scale;
+   account_id_type seller = make_trader( "seller", 1000 );
+   vector<account_id_type> borrowers;
+   for( uint32_t i = 0; i < positions; ++i )
+   {
+      // collateral ratio from 2 to 3 at the initial feed of 5 CORE per USD
+      const int64_t collateral = 10000 + int64_t(5000) * i / positions;
+      borrowers.push_back( make_trader( "borrower" + fc::to_string(i), collateral ) );
+      borrow_usd( borrowers.back(), 1000, collateral );
+      send_usd( borrowers.back(), seller, 1000 );
+   }
+
+   // above the MSSP before and below it after the feed drop
+   for( uint32_t i = 0; i < positions / 2; ++i )
+      push( make_order( seller, asset( 1000, usd ), asset( 9500 ) ) );
+
+   const auto& call_index = db.get_index_type<call_order_index>().indices();
+   const size_t before = call_index.size();
+   latency_recorder cascade( "margin call cascade on feed update" );
+   publish( asset( 1, usd ) / asset( 9 ), &cascade );
+   cascade.report();
+   ilog( "Margin call cascade: ${n} positions called by one feed update", ("n",before - call_index.size()) );
+
+   latency_recorder incoming( "margin call by incoming ask" );
+   for( uint32_t i = positions / 2; i < positions; ++i )
+      push( make_order( seller, asset( 1000, usd ), asset( 9500 ) ), &incoming );
+   incoming.report();
+} FC_LOG_AND_RETHROW() }
+
+/// Creates many force settlements, then times the block that executes them
+BOOST_AUTO_TEST_CASE( force_settlement_bench )
+{ try {
+   const uint32_t settlements = base_count( 20000, 2000 ) * scale;
+   // the settlements are a tenth of the supply, below the maximum settlement volume
+   account_id_type holder = make_trader( "holder", int64_t(settlements) * 1000 * 40 );
+   borrow_usd( holder, int64_t(settlements) * 1000, int64_t(settlements) * 1000 * 40 );
+
+   latency_recorder requests( "force settlement request" );
+   asset_settle_operation op;
+   op.account = holder;
+   op.amount = asset( 100, usd );
+   for( uint32_t i = 0; i < settlements; ++i )
+      push( op, &requests );
+   requests.report();
+   generate_block();
+
+   const auto& settle_index = db.get_index_type<force_settlement_index>().indices();
+   const time_point_sec settlement_time = settle_index.get<by_expiration>().begin()->settlement_date;
+   generate_blocks( settlement_time - 60 );
+   publish( asset( 1, usd ) / asset( 5 ) ); // the feed would have expired
+   generate_block();
+
+   const size_t before = settle_index.size();
+   auto start = std::chrono::steady_clock::now();
+   generate_blocks( settlement_time );
+   auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start );
+   ilog( "Force settlement: ${n} settlements executed in ${t} ms",
+         ("n",before - settle_index.size())("t",elapsed.count()/1000) );
+} FC_LOG_AND_RETHROW() }
+
+/// Publishes feeds that keep many positions safe, every update runs the black swan and margin call checks
+BOOST_AUTO_TEST_CASE( black_swan_check_bench )
+{ try {
+   const uint32_t positions = base_count( 10000, 1000 ) * scale;
+   const uint32_t updates = base_count( 20000, 2000 );
+   for( uint32_t i = 0; i < positions; ++i )
+   {
+      const int64_t collateral = 10000 + int64_t(5000) * i / positions;
+      borrow_usd( make_trader( "borrower" + fc::to_string(i), collateral ), 1000, collateral );
+   }
+   // a bid on the book, like on a live market
+   account_id_type buyer = make_trader( "buyer", 100000 );
+   push( make_order( buyer, asset( 60000 ), asset( 10000, usd ) ) );
+
+   latency_recorder checks( "feed update with black swan check" );
+   for( uint32_t i = 0; i < updates; ++i )
+      publish( i % 2 ? asset( 2, usd ) / asset( 11 ) : asset( 1, usd ) / asset( 5 ), &checks );
+   checks.report();
+   BOOST_CHECK( !usd( db ).bitasset_data( db ).has_settlement() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
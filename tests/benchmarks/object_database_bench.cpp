@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/block_summary_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace graphene::chain;
+
+/*
+ * Microbenchmarks of the object database layer, meant as the baseline for changes to generic_index, undo_database
+ * and the allocators of the indexes.
+ *
+ * Every measurement is repeated and reported as one JSON object per line on stdout, with the median and the
+ * minimum of the repetitions:
+ *   {"bench":"object_database","case":"create","index":"limit_order","objects":100000,"ops":100000,
+ *    "median_ns_per_op":412.5,"min_ns_per_op":398.1}
+ *
+ * Options (after `--` on the command line):
+ *   --db-bench-scale=<n>     multiplies the number of objects
+ *   --db-bench-reps=<n>      repetitions of every measurement, defaults to 5
+ *   --db-bench-output=<file> appends the JSON lines to file as well
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( bench_clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+struct db_bench_options
+{
+   uint32_t    objects = 0;
+   uint32_t    reps = 5;
+   std::string output;
+
+   db_bench_options()
+   {
+#ifdef NDEBUG
+      objects = 100000;
+#else
+      objects = 10000;
+#endif
+      uint32_t scale = 1;
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--db-bench-scale=" ) == 0 )
+            scale = std::max( 1, std::stoi( arg.substr( 17 ) ) );
+         else if( arg.find( "--db-bench-reps=" ) == 0 )
+            reps = std::max( 1, std::stoi( arg.substr( 16 ) ) );
+         else if( arg.find( "--db-bench-output=" ) == 0 )
+            output = arg.substr( 18 );
+      }
+      objects *= scale;
+   }
+};
+
+/// The timings of one case across the repetitions
+class bench_samples
+{
+   public:
+      bench_samples( std::string name, fc::mutable_variant_object params, uint64_t ops )
+         : _name( std::move(name) ), _params( std::move(params) ), _ops( ops ) {}
+
+      void add( int64_t ns ) { _samples.push_back( ns ); }
+
+      void report( const db_bench_options& options )
+      {
+         if( _samples.empty() || _ops == 0 )
+            return;
+         std::sort( _samples.begin(), _samples.end() );
+         const double median = _samples.size() % 2 ? _samples[ _samples.size() / 2 ]
+               : ( _samples[ _samples.size() / 2 - 1 ] + _samples[ _samples.size() / 2 ] ) / 2.0;
+         fc::mutable_variant_object result;
+         result( "bench", "object_database" )( "case", _name );
+         for( const auto& param : _params )
+            result( param.key(), param.value() );
+         result( "ops", _ops )
+               ( "median_ns_per_op", median / _ops )
+               ( "min_ns_per_op", double( _samples.front() ) / _ops );
+         const std::string line = fc::json::to_string( result );
+         std::cout << line << std::endl;
+         if( !options.output.empty() )
+            std::ofstream( options.output, std::ios::app ) << line << '\n';
+      }
+
+   private:
+      std::string                _name;
+      fc::mutable_variant_object _params;
+      uint64_t                   _ops;
+      std::vector<int64_t>       _samples;
+};
+
+/// How the index benchmarks fill and change the objects of one index type
+struct limit_order_traits
+{
+   typedef limit_order_object object_type;
+   static const char* name() { return "limit_order"; }
+   static void init( limit_order_object& o, uint32_t i )
+   {
+      o.seller = account_id_type( i % 1000 );
+      o.for_sale = 1000;
+      o.sell_price = price( asset( 1 + ( i * 7919 ) % 100000 ), asset( 1000, asset_id_type( 1 + i % 4 ) ) );
+      o.expiration = time_point_sec( i );
+   }
+   static void change( limit_order_object& o ) { o.for_sale -= 1; }
+};
+
+struct call_order_traits
+{
+   typedef call_order_object object_type;
+   static const char* name() { return "call_order"; }
+   static void init( call_order_object& o, uint32_t i )
+   {
+      o.borrower = account_id_type( i );
+      o.collateral = 1000000 + ( i * 7919 ) % 100000;
+      o.debt = 1000;
+      o.call_price = price( asset( 1, asset_id_type( 1 ) ), asset( 1 ) );
+   }
+   /// changes the collateralization, i.e. moves the order in the ordered index
+   static void change( call_order_object& o ) { o.collateral += 1; }
+};
+
+struct account_balance_traits
+{
+   typedef account_balance_object object_type;
+   static const char* name() { return "account_balance"; }
+   static void init( account_balance_object& o, uint32_t i )
+   {
+      o.owner = account_id_type( i / 4 );
+      o.asset_type = asset_id_type( i % 4 );
+      o.balance = 1000000;
+   }
+   static void change( account_balance_object& o ) { o.balance -= 1; }
+};
+
+struct block_summary_traits
+{
+   typedef block_summary_object object_type;
+   static const char* name() { return "block_summary"; }
+   static void init( block_summary_object& o, uint32_t i ) { o.block_id._hash[0] = i; }
+   static void change( block_summary_object& o ) { ++o.block_id._hash[0]; }
+};
+
+/// does nothing but be called, to measure what the secondary index mechanism itself costs
+struct noop_secondary_index : public graphene::db::secondary_index
+{
+   virtual void object_inserted( const object& )override { ++calls; }
+   virtual void object_removed( const object& )override { ++calls; }
+   virtual void about_to_modify( const object& )override { ++calls; }
+   virtual void object_modified( const object& )override { ++calls; }
+   uint64_t calls = 0;
+};
+
+/// the number of objects to create in an index, block summaries fit in a fixed array
+template<typename ObjectType>
+uint32_t object_limit( uint32_t objects )
+{
+   return std::is_same< ObjectType, block_summary_object >::value
+          ? std::min<uint32_t>( objects, block_summary_index::capacity ) : objects;
+}
+
+/// visits the numbers below count in a fixed order that jumps around, so that lookups do not only hit the cache
+vector<uint32_t> shuffled( uint32_t count )
+{
+   vector<uint32_t> result( count );
+   for( uint32_t i = 0; i < count; ++i )
+      result[i] = i;
+   uint64_t state = 88172645463325252ull;
+   for( uint32_t i = count; i > 1; --i )
+   {
+      state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+      std::swap( result[i - 1], result[ state % i ] );
+   }
+   return result;
+}
+
+template<typename Traits>
+vector<object_id_type> fill( database& db, uint32_t count )
+{
+   typedef typename Traits::object_type object_type;
+   vector<object_id_type> ids;
+   ids.reserve( count );
+   for( uint32_t i = 0; i < count; ++i )
+      ids.push_back( db.create<object_type>( [i]( object_type& o ) { Traits::init( o, i ); } ).id );
+   return ids;
+}
+
+/** create, find, modify and remove of all objects of an index, with secondary_indexes no-op secondary indexes added */
+template<typename Traits>
+void bench_index( const db_bench_options& options, uint32_t secondary_indexes = 0 )
+{
+   typedef typename Traits::object_type object_type;
+   const uint32_t objects = object_limit<object_type>( options.objects );
+   fc::mutable_variant_object params;
+   params( "index", Traits::name() )( "objects", objects );
+   if( secondary_indexes > 0 )
+      params( "noop_secondary_indexes", secondary_indexes );
+   const string prefix = secondary_indexes > 0 ? "secondary_" : "";
+   bench_samples create( prefix + "create", params, objects );
+   bench_samples find( prefix + "find", params, objects );
+   bench_samples modify( prefix + "modify", params, objects );
+   bench_samples remove( prefix + "remove", params, objects );
+   const vector<uint32_t> order = shuffled( objects );
+   vector<uint32_t> remove_order = order;
+   // block summaries can only be removed from the end
+   if( std::is_same< object_type, block_summary_object >::value )
+      for( uint32_t i = 0; i < objects; ++i )
+         remove_order[i] = objects - 1 - i;
+
+   for( uint32_t rep = 0; rep < options.reps; ++rep )
+   {
+      database db;
+      for( uint32_t i = 0; i < secondary_indexes; ++i )
+         dynamic_cast<graphene::db::base_primary_index&>( const_cast<graphene::db::index&>( db.get_index<object_type>() ) )
+               .add_secondary_index<noop_secondary_index>();
+
+      auto start = bench_clock::now();
+      const vector<object_id_type> ids = fill<Traits>( db, objects );
+      create.add( elapsed_ns( start ) );
+
+      uint64_t found = 0;
+      start = bench_clock::now();
+      for( uint32_t i : order )
+         found += db.find<object_type>( ids[i] ) != nullptr;
+      find.add( elapsed_ns( start ) );
+      FC_ASSERT( found == objects );
+
+      start = bench_clock::now();
+      for( uint32_t i : order )
+         db.modify( db.get<object_type>( ids[i] ), []( object_type& o ) { Traits::change( o ); } );
+      modify.add( elapsed_ns( start ) );
+
+      start = bench_clock::now();
+      for( uint32_t i : remove_order )
+         db.remove( db.get<object_type>( ids[i] ) );
+      remove.add( elapsed_ns( start ) );
+   }
+
+   create.report( options );
+   find.report( options );
+   modify.report( options );
+   remove.report( options );
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( object_database_bench )
+
+BOOST_AUTO_TEST_CASE( index_operations )
+{
+   const db_bench_options options;
+   bench_index<limit_order_traits>( options );
+   bench_index<call_order_traits>( options );
+   bench_index<account_balance_traits>( options );
+   bench_index<block_summary_traits>( options );
+}
+
+BOOST_AUTO_TEST_CASE( secondary_index_overhead )
+{
+   const db_bench_options options;
+   // call orders have no secondary index of their own
+   for( uint32_t count : { 1, 4 } )
+      bench_index<call_order_traits>( options, count );
+}
+
+BOOST_AUTO_TEST_CASE( undo_sessions )
+{
+   const db_bench_options options;
+   // changes per session, about what a block of transfers touches
+   const uint32_t per_session = 100;
+
+   for( uint32_t depth : { 1, 16, 128 } )
+   {
+      fc::mutable_variant_object params;
+      params( "index", account_balance_traits::name() )( "objects", options.objects )
+            ( "depth", depth )( "modifications_per_session", per_session );
+      bench_samples start_session( "undo_start_session", params, depth );
+      bench_samples modify( "undo_modify", params, uint64_t( depth ) * per_session );
+      bench_samples undo( "undo_undo", params, depth );
+      bench_samples merge( "undo_merge", params, depth );
+      const vector<uint32_t> order = shuffled( options.objects );
+
+      for( uint32_t rep = 0; rep < options.reps; ++rep )
+      {
+         database db;
+         const vector<object_id_type> ids = fill<account_balance_traits>( db, options.objects );
+         db._undo_db.set_max_size( depth + 1 );
+         db._undo_db.enable();
+
+         // the sessions are filled twice, once to be undone and once to be merged down and committed
+         for( int pass = 0; pass < 2; ++pass )
+         {
+            vector<graphene::db::undo_database::session> sessions;
+            sessions.reserve( depth );
+            int64_t start_ns = 0;
+            int64_t modify_ns = 0;
+            for( uint32_t d = 0; d < depth; ++d )
+            {
+               auto start = bench_clock::now();
+               sessions.emplace_back( db._undo_db.start_undo_session() );
+               start_ns += elapsed_ns( start );
+               start = bench_clock::now();
+               for( uint32_t m = 0; m < per_session; ++m )
+               {
+                  const auto& balance = db.get<account_balance_object>(
+                        ids[ order[ ( d * per_session + m ) % order.size() ] ] );
+                  db.modify( balance, []( account_balance_object& o ) { account_balance_traits::change( o ); } );
+               }
+               modify_ns += elapsed_ns( start );
+            }
+            if( pass == 0 )
+            {
+               start_session.add( start_ns );
+               modify.add( modify_ns );
+               auto start = bench_clock::now();
+               while( !sessions.empty() )
+               {
+                  sessions.back().undo();
+                  sessions.pop_back();
+               }
+               undo.add( elapsed_ns( start ) );
+            }
+            else
+            {
+               auto start = bench_clock::now();
+               while( sessions.size() > 1 )
+               {
+                  sessions.back().merge();
+                  sessions.pop_back();
+               }
+               sessions.back().commit();
+               merge.add( elapsed_ns( start ) );
+            }
+         }
+         db._undo_db.disable();
+      }
+
+      start_session.report( options );
+      modify.report( options );
+      undo.report( options );
+      merge.report( options );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( save_and_open )
+{
+   const db_bench_options options;
+   fc::mutable_variant_object params;
+   params( "objects_per_index", options.objects );
+   const uint64_t saved = options.objects * 3 + object_limit<block_summary_object>( options.objects );
+   bench_samples save( "save_indexes", params, saved );
+   bench_samples open( "open", params, saved );
+   uint64_t bytes = 0;
+
+   for( uint32_t rep = 0; rep < options.reps; ++rep )
+   {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         fill<limit_order_traits>( db, options.objects );
+         fill<call_order_traits>( db, options.objects );
+         fill<account_balance_traits>( db, options.objects );
+         fill<block_summary_traits>( db, object_limit<block_summary_object>( options.objects ) );
+
+         std::stringstream image;
+         auto start = bench_clock::now();
+         db.save_indexes( image );
+         save.add( elapsed_ns( start ) );
+         bytes = image.str().size();
+         graphene::db::object_database::install_indexes( image, data_dir.path() );
+      }
+
+      database db;
+      graphene::db::object_database& objects = db;
+      auto start = bench_clock::now();
+      objects.open( data_dir.path() );
+      open.add( elapsed_ns( start ) );
+      FC_ASSERT( db.get_index<limit_order_object>().object_count() == options.objects );
+   }
+
+   ilog( "Object database image of ${n} objects: ${b} bytes", ("n",options.objects * 4)("b",bytes) );
+   save.report( options );
+   open.report( options );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( const bench_clock::time_point& start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+/**
+ * Measures how much reading the objects of a block ahead of time shortens applying it when they are not in the
+ * CPU cache, like after the idle time between two blocks.
+ *
+ * Options (after `--` on the command line):
+ *   --prefetch-bench-accounts=<n>   number of accounts the transfers are spread over, defaults to 20000
+ */
+struct prefetch_bench_fixture : database_fixture
+{
+   uint32_t     account_count = 20000;
+   vector<char> evict_buffer;
+
+   prefetch_bench_fixture()
+   {
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--prefetch-bench-accounts=" ) == 0 )
+            account_count = std::max( 2, std::stoi( arg.substr( 26 ) ) );
+      }
+      evict_buffer.resize( 256 * 1024 * 1024 );
+   }
+
+   /// writes a buffer much larger than the CPU caches, which pushes the objects of the database out of them
+   void evict_caches()
+   {
+      for( size_t i = 0; i < evict_buffer.size(); i += 64 )
+         ++evict_buffer[i];
+   }
+
+   /// applies block on top of the head and undoes it again, @return the time it took to apply it in ns
+   int64_t apply_and_undo( const signed_block& block )
+   {
+      auto session = db._undo_db.start_undo_session();
+      auto start = bench_clock::now();
+      db.apply_block( block, ~0 );
+      return elapsed_ns( start );
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( prefetch_bench, prefetch_bench_fixture )
+
+BOOST_AUTO_TEST_CASE( apply_after_prefetch )
+{ try {
+   vector<account_id_type> accounts;
+   accounts.reserve( account_count );
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      accounts.push_back( create_account( "prefetch" + std::to_string( i ) ).id );
+      transfer( committee_account, accounts.back(), asset( 1000000 ) );
+      if( i % 1000 == 999 )
+         generate_block();
+   }
+   generate_block();
+
+   // transfers between accounts far apart in the indexes
+   const uint32_t transfers = 2000;
+   for( uint32_t i = 0; i < transfers; ++i )
+   {
+      transfer_operation op;
+      op.from = accounts[ ( uint64_t( i ) * 7919 ) % accounts.size() ];
+      op.to = accounts[ ( uint64_t( i ) * 104729 + 1 ) % accounts.size() ];
+      op.amount = asset( 1 + i );
+      trx.operations.push_back( op );
+      for( auto& o : trx.operations ) db.current_fee_schedule().set_fee( o );
+      set_expiration( db, trx );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+   const signed_block block = generate_block();
+   db.pop_block();
+   db.clear_pending();
+
+   const uint32_t rounds = 10;
+   int64_t warm = 0, cold = 0, prefetched = 0, prefetch = 0;
+   size_t touched = 0;
+   for( uint32_t r = 0; r < rounds; ++r )
+   {
+      warm += apply_and_undo( block );
+
+      evict_caches();
+      cold += apply_and_undo( block );
+
+      evict_caches();
+      auto start = bench_clock::now();
+      touched = db.prefetch_objects( block );
+      prefetch += elapsed_ns( start );
+      prefetched += apply_and_undo( block );
+   }
+
+   ilog( "Block of ${n} transfers between ${a} accounts, apply time in us: warm ${w}, cold ${c}, "
+         "cold after prefetch ${p} (prefetch of ${t} objects took ${f})",
+         ("n",transfers)("a",accounts.size())("w",warm/rounds/1000)("c",cold/rounds/1000)
+         ("p",prefetched/rounds/1000)("t",touched)("f",prefetch/rounds/1000) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
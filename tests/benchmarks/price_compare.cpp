@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/asset.hpp>
+
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <random>
+
+using namespace graphene::chain;
+
+namespace {
+
+typedef boost::multiprecision::uint128_t uint128_t;
+
+/// the cross multiplication price comparison and asset * price used before the native 128 bit kernels
+bool reference_less( const price& a, const price& b )
+{
+   if( a.base.asset_id != b.base.asset_id ) return a.base.asset_id < b.base.asset_id;
+   if( a.quote.asset_id != b.quote.asset_id ) return a.quote.asset_id < b.quote.asset_id;
+   return uint128_t( b.quote.amount.value ) * a.base.amount.value < uint128_t( a.quote.amount.value ) * b.base.amount.value;
+}
+
+bool reference_equal( const price& a, const price& b )
+{
+   if( a.base.asset_id != b.base.asset_id || a.quote.asset_id != b.quote.asset_id ) return false;
+   return uint128_t( b.quote.amount.value ) * a.base.amount.value == uint128_t( a.quote.amount.value ) * b.base.amount.value;
+}
+
+int64_t reference_multiply( const asset& a, const price& p )
+{
+   uint128_t result = ( uint128_t( a.amount.value ) * p.quote.amount.value ) / p.base.amount.value;
+   if( result > GRAPHENE_MAX_SHARE_SUPPLY )
+      return -1;
+   return result.convert_to<int64_t>();
+}
+
+int64_t native_multiply( const asset& a, const price& p )
+{
+   try {
+      return ( a * p ).amount.value;
+   } catch( const fc::assert_exception& ) {
+      return -1;
+   }
+}
+
+/// mixes small amounts, amounts near the max supply and equal prices with different amounts
+vector<price> make_prices( uint32_t count )
+{
+   std::mt19937_64 rng( 42 );
+   std::uniform_int_distribution<int64_t> small( 1, 100000 );
+   std::uniform_int_distribution<int64_t> large( 1, GRAPHENE_MAX_SHARE_SUPPLY );
+   vector<price> prices;
+   prices.reserve( count );
+   while( prices.size() < count )
+   {
+      int64_t base = ( rng() & 1 ) ? small( rng ) : large( rng );
+      int64_t quote = ( rng() & 1 ) ? small( rng ) : large( rng );
+      prices.push_back( asset( base ) / asset( quote, asset_id_type(1) ) );
+      if( base <= GRAPHENE_MAX_SHARE_SUPPLY / 3 && quote <= GRAPHENE_MAX_SHARE_SUPPLY / 3 )
+         prices.push_back( asset( base * 3 ) / asset( quote * 3, asset_id_type(1) ) );
+   }
+   prices.push_back( price::max( asset_id_type(), asset_id_type(1) ) );
+   prices.push_back( price::min( asset_id_type(), asset_id_type(1) ) );
+   return prices;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( price_compare_bench )
+{
+#ifdef NDEBUG
+   const uint32_t count = 4000;
+#else
+   const uint32_t count = 1000;
+#endif
+   const vector<price> prices = make_prices( count );
+
+   uint64_t mismatches = 0;
+   for( const price& a : prices )
+      for( const price& b : prices )
+         if( ( a < b ) != reference_less( a, b ) || ( a == b ) != reference_equal( a, b ) )
+            ++mismatches;
+   for( const price& p : prices )
+      for( uint32_t i = 0; i < 64; ++i )
+      {
+         const asset a( int64_t(1) << ( i % 50 ) );
+         if( native_multiply( a, p ) != reference_multiply( a, p ) )
+            ++mismatches;
+      }
+   BOOST_CHECK_EQUAL( mismatches, 0u );
+
+   const uint64_t comparisons = uint64_t( prices.size() ) * prices.size();
+   uint64_t sum = 0;
+   fc::time_point start = fc::time_point::now();
+   for( const price& a : prices )
+      for( const price& b : prices )
+         sum += reference_less( a, b );
+   const int64_t reference_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+
+   start = fc::time_point::now();
+   for( const price& a : prices )
+      for( const price& b : prices )
+         sum -= ( a < b );
+   const int64_t native_time = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+   BOOST_CHECK_EQUAL( sum, 0u );
+
+   ilog( "Price comparison with boost::multiprecision: ${r} per second", ("r",comparisons * 1000000 / reference_time) );
+   ilog( "Price comparison with native 128 bit kernel: ${r} per second", ("r",comparisons * 1000000 / native_time) );
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+/** laid out like asset and price, but serialized by the reflected member visitors */
+struct reflected_asset
+{
+   share_type    amount;
+   asset_id_type asset_id;
+};
+struct reflected_price
+{
+   reflected_asset base;
+   reflected_asset quote;
+};
+
+typedef std::chrono::steady_clock clock;
+
+int64_t elapsed_ns( clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+}
+
+/** packs and unpacks the values repeatedly, @return the nanoseconds it took */
+template< typename T >
+int64_t time_round_trips( const vector<T>& values, uint32_t rounds )
+{
+   vector<char> buffer( fc::raw::pack_size( values ) );
+   vector<T> unpacked;
+   const auto start = clock::now();
+   for( uint32_t i = 0; i < rounds; ++i )
+   {
+      fc::datastream<char*> out( buffer.data(), buffer.size() );
+      fc::raw::pack( out, values );
+      fc::datastream<const char*> in( buffer.data(), buffer.size() );
+      fc::raw::unpack( in, unpacked );
+   }
+   const int64_t ns = elapsed_ns( start );
+   FC_ASSERT( unpacked.size() == values.size() );
+   return ns;
+}
+}
+
+FC_REFLECT( reflected_asset, (amount)(asset_id) )
+FC_REFLECT( reflected_price, (base)(quote) )
+
+BOOST_FIXTURE_TEST_SUITE( raw_pack_bench, database_fixture )
+
+/** Compares the hand-written asset and price serializers with the reflected ones and times blocks of transfers */
+BOOST_AUTO_TEST_CASE( asset_and_block_serialization )
+{ try {
+#ifdef NDEBUG
+   const uint32_t rounds = 200;
+   const uint32_t block_transfers = 5000;
+#else
+   const uint32_t rounds = 20;
+   const uint32_t block_transfers = 1000;
+#endif
+   const uint32_t count = 10000;
+
+   vector<price> prices;
+   vector<reflected_price> reflected;
+   prices.reserve( count );
+   reflected.reserve( count );
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      const asset base( 1000 + i * 7919, asset_id_type( i % 300 ) );
+      const asset quote( 1 + i * 31, asset_id_type( 300 + i % 50 ) );
+      prices.push_back( price( base, quote ) );
+      reflected.push_back( reflected_price{ { base.amount, base.asset_id }, { quote.amount, quote.asset_id } } );
+   }
+   BOOST_REQUIRE( fc::raw::pack( prices ) == fc::raw::pack( reflected ) );
+   const int64_t fast_ns = time_round_trips( prices, rounds );
+   const int64_t reflected_ns = time_round_trips( reflected, rounds );
+   ilog( "Raw serialization: ${n} prices packed and unpacked ${r} times, ${f} ms hand-written, ${g} ms reflected",
+         ("n",count)("r",rounds)("f",fast_ns/1000000)("g",reflected_ns/1000000) );
+
+   ACTORS( (alice)(bob) );
+   fund( alice, asset( 100000000 ) );
+   generate_block();
+   set_expiration( db, trx );
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   for( uint32_t i = 0; i < block_transfers; ++i )
+   {
+      op.amount = asset( 1 + i );
+      trx.operations = { op };
+      PUSH_TX( db, trx, ~0 );
+   }
+   trx.clear();
+   const signed_block block = generate_block();
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), block_transfers );
+
+   const vector<char> packed = fc::raw::pack( block );
+   auto start = clock::now();
+   for( uint32_t i = 0; i < rounds; ++i )
+      fc::raw::pack( block );
+   const int64_t pack_ns = elapsed_ns( start );
+   start = clock::now();
+   for( uint32_t i = 0; i < rounds; ++i )
+      fc::raw::unpack<signed_block>( packed );
+   const int64_t unpack_ns = elapsed_ns( start );
+   ilog( "Raw serialization: block of ${n} transfers (${s} bytes) packed ${r} times in ${p} ms, unpacked in ${u} ms",
+         ("n",block_transfers)("s",packed.size())("r",rounds)("p",pack_ns/1000000)("u",unpack_ns/1000000) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/verification_pool.hpp>
+#include <graphene/chain/protocol/signature_cache.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <chrono>
+#include <thread>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+int64_t elapsed_ns( const bench_clock::time_point& start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+}
+
+/// Runs work(begin,end) on threads threads that split [0,count) evenly, and returns the wall time in ns
+int64_t run_on_threads( uint32_t threads, size_t count, const std::function<void(size_t,size_t)>& work )
+{
+   vector<std::thread> workers;
+   workers.reserve( threads );
+   const size_t per_thread = ( count + threads - 1 ) / threads;
+   auto start = bench_clock::now();
+   for( size_t begin = 0; begin < count; begin += per_thread )
+      workers.emplace_back( work, begin, std::min( count, begin + per_thread ) );
+   for( std::thread& worker : workers )
+      worker.join();
+   return elapsed_ns( start );
+}
+
+/**
+ * Measures how signature verification scales with the number of threads, to size the CPUs of witness and seed
+ * nodes. Every measurement reports its rate and the scaling efficiency, i.e. the rate divided by the number of
+ * threads times the rate of a single thread.
+ *
+ * The signature cache is disabled while the benchmarks run, so that every signature is actually recovered.
+ *
+ * Options (after `--` on the command line):
+ *   --sig-bench-threads=<n>   highest number of threads, defaults to the number of hardware threads
+ */
+struct signature_bench_fixture : database_fixture
+{
+   uint32_t                     max_threads = std::max( 1u, std::thread::hardware_concurrency() );
+   vector<fc::ecc::private_key> keys;
+   size_t                       cache_capacity;
+
+   signature_bench_fixture()
+   {
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         if( arg.find( "--sig-bench-threads=" ) == 0 )
+            max_threads = std::max( 1, std::stoi( arg.substr( 20 ) ) );
+      }
+      for( uint32_t i = 0; i < 16; ++i )
+         keys.push_back( generate_private_key( "sigbench" + std::to_string( i ) ) );
+      cache_capacity = signature_cache::instance().capacity();
+      signature_cache::instance().set_capacity( 0 );
+   }
+
+   ~signature_bench_fixture()
+   {
+      db.set_verification_pool( nullptr );
+      signature_cache::instance().set_capacity( cache_capacity );
+   }
+
+   /// 1, 2, 4, ... up to and including max_threads
+   vector<uint32_t> thread_counts()const
+   {
+      vector<uint32_t> result;
+      for( uint32_t t = 1; t < max_threads; t *= 2 )
+         result.push_back( t );
+      result.push_back( max_threads );
+      return result;
+   }
+
+   /// A transaction with a transfer that is signed by sigs distinct keys, starting at the key with index first_key
+   signed_transaction make_transaction( uint32_t seq, uint32_t sigs, uint32_t first_key )const
+   {
+      signed_transaction trx;
+      transfer_operation op;
+      op.from = account_id_type( 100 + seq );
+      op.to = account_id_type( 99 );
+      op.amount = asset( 1 + seq );
+      trx.operations.push_back( op );
+      trx.expiration = time_point_sec( 1000000 + seq );
+      for( uint32_t s = 0; s < sigs; ++s )
+         trx.sign( keys[ ( first_key + s ) % keys.size() ], db.get_chain_id() );
+      return trx;
+   }
+
+   /// A block of tx_count transactions with one signature each, its signature and merkle root are valid
+   signed_block make_block( uint32_t tx_count )const
+   {
+      signed_block block;
+      block.timestamp = time_point_sec( 1000000 );
+      block.transactions.reserve( tx_count );
+      for( uint32_t i = 0; i < tx_count; ++i )
+         block.transactions.push_back( processed_transaction( make_transaction( i, 1, i ) ) );
+      block.transaction_merkle_root = block.calculate_merkle_root();
+      block.sign( keys[0] );
+      return block;
+   }
+
+   void report( const string& what, uint32_t threads, uint64_t items, int64_t ns, double single_thread_rate )const
+   {
+      const double rate = ns > 0 ? double( items ) * 1000000000 / ns : 0;
+      ilog( "${w}: ${t} threads, ${r} per second, scaling efficiency ${e}%",
+            ("w",what)("t",threads)("r",uint64_t(rate))
+            ("e",single_thread_rate > 0 ? uint32_t( 100 * rate / ( threads * single_thread_rate ) ) : 100) );
+   }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( signature_bench, signature_bench_fixture )
+
+/** Public key recovery from compact signatures, the bulk of the verification work */
+BOOST_AUTO_TEST_CASE( recovery_scaling )
+{ try {
+#ifdef NDEBUG
+   const size_t count = 20000;
+#else
+   const size_t count = 2000;
+#endif
+   vector<fc::sha256> digests;
+   vector<signature_type> sigs;
+   for( size_t i = 0; i < count; ++i )
+   {
+      digests.push_back( fc::sha256::hash( std::to_string( i ) ) );
+      sigs.push_back( keys[ i % keys.size() ].sign_compact( digests.back() ) );
+   }
+
+   double single_thread_rate = 0;
+   for( uint32_t threads : thread_counts() )
+   {
+      const int64_t ns = run_on_threads( threads, count, [&digests,&sigs] ( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            fc::ecc::public_key( sigs[i], digests[i] );
+      });
+      if( threads == 1 )
+         single_thread_rate = double( count ) * 1000000000 / ns;
+      report( "Signature recovery", threads, count, ns, single_thread_rate );
+   }
+} FC_LOG_AND_RETHROW() }
+
+/** signed_transaction::get_signature_keys(), i.e. the signature digest and the recovery of all signatures */
+BOOST_AUTO_TEST_CASE( get_signature_keys_scaling )
+{ try {
+#ifdef NDEBUG
+   const size_t count = 10000;
+#else
+   const size_t count = 1000;
+#endif
+   for( uint32_t sigs_per_tx : { 1u, 3u } )
+   {
+      vector<signed_transaction> trxs;
+      for( size_t i = 0; i < count; ++i )
+         trxs.push_back( make_transaction( i, sigs_per_tx, i ) );
+
+      const chain_id_type chain_id = db.get_chain_id();
+      const string what = "get_signature_keys with " + std::to_string( sigs_per_tx ) + " signatures";
+      double single_thread_rate = 0;
+      for( uint32_t threads : thread_counts() )
+      {
+         // signed_transaction does not keep the keys it recovered, every call recovers them again
+         const int64_t ns = run_on_threads( threads, count, [&trxs,&chain_id] ( size_t begin, size_t end ) {
+            for( size_t i = begin; i < end; ++i )
+               trxs[i].get_signature_keys( chain_id );
+         });
+         if( threads == 1 )
+            single_thread_rate = double( count ) * 1000000000 / ns;
+         report( what, threads, count, ns, single_thread_rate );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+/** database::precompute_parallel() on verification pools of increasing size, for blocks of several sizes */
+BOOST_AUTO_TEST_CASE( precompute_block_scaling )
+{ try {
+#ifdef NDEBUG
+   const uint32_t total_transactions = 20000;
+   const vector<uint32_t> block_sizes = { 10, 100, 1000 };
+#else
+   const uint32_t total_transactions = 2000;
+   const vector<uint32_t> block_sizes = { 10, 100 };
+#endif
+   for( uint32_t block_size : block_sizes )
+   {
+      // precompute_parallel() remembers its results in the block, so every round gets an unpacked copy
+      const vector<char> packed = fc::raw::pack( make_block( block_size ) );
+      const uint32_t rounds = std::max( 1u, total_transactions / block_size );
+      const string what = "precompute_parallel of blocks with " + std::to_string( block_size ) + " transactions";
+      double single_thread_rate = 0;
+      for( uint32_t threads : thread_counts() )
+      {
+         vector<signed_block> blocks( rounds );
+         for( signed_block& block : blocks )
+            fc::raw::unpack( packed, block );
+         db.set_verification_pool( std::make_shared<verification_pool>( threads ) );
+
+         auto start = bench_clock::now();
+         for( const signed_block& block : blocks )
+            db.precompute_parallel( block ).wait();
+         const int64_t ns = elapsed_ns( start );
+
+         BOOST_CHECK( blocks.back().transactions.back().get_signature_keys( db.get_chain_id() ).size() == 1 );
+         if( threads == 1 )
+            single_thread_rate = double( rounds ) * 1000000000 / ns;
+         report( what, threads, rounds, ns, single_thread_rate );
+      }
+      db.set_verification_pool( nullptr );
+   }
+} FC_LOG_AND_RETHROW() }
+
+/**
+ * verify_authority() for an account whose active authority requires all of its width children at every level,
+ * down to keys at the given depth. The keys are known, so this measures the authority walk only.
+ */
+BOOST_AUTO_TEST_CASE( verify_authority_depth )
+{ try {
+#ifdef NDEBUG
+   const uint32_t iterations = 20000;
+#else
+   const uint32_t iterations = 2000;
+#endif
+   const uint32_t width = 3;
+   for( uint32_t depth = 0; depth <= GRAPHENE_MAX_SIG_CHECK_DEPTH + 1; ++depth )
+   {
+      std::map<account_id_type, authority> authorities;
+      flat_set<public_key_type> signers;
+      uint64_t next_account = 101;
+      std::function<void(account_id_type,uint32_t)> build = [&]( account_id_type account, uint32_t level ) {
+         authority& auth = authorities[account];
+         auth.weight_threshold = width;
+         for( uint32_t c = 0; c < width; ++c )
+         {
+            if( level == depth )
+            {
+               const public_key_type key = generate_private_key( "sigbench" + std::to_string( signers.size() ) )
+                                              .get_public_key();
+               auth.key_auths[key] = 1;
+               signers.insert( key );
+            }
+            else
+            {
+               const account_id_type child( next_account++ );
+               auth.account_auths[child] = 1;
+               build( child, level + 1 );
+            }
+         }
+      };
+      build( account_id_type( 100 ), 0 );
+
+      const auto get_authority = [&authorities] ( account_id_type id ) -> const authority* {
+         auto itr = authorities.find( id );
+         return itr == authorities.end() ? nullptr : &itr->second;
+      };
+      transfer_operation op;
+      op.from = account_id_type( 100 );
+      op.to = account_id_type( 99 );
+      op.amount = asset( 1 );
+      const vector<operation> ops = { op };
+
+      auto start = bench_clock::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+         verify_authority( ops, signers, get_authority, get_authority, depth );
+      const int64_t ns = elapsed_ns( start );
+      ilog( "verify_authority at depth ${d}: ${k} keys, ${r} per second, ${n} ns each",
+            ("d",depth)("k",signers.size())("r",ns > 0 ? uint64_t(iterations) * 1000000000 / ns : 0)
+            ("n",ns / iterations) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
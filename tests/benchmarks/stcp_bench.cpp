@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/asset.hpp>
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/log/logger.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+using graphene::net::stcp_socket;
+
+BOOST_AUTO_TEST_CASE( stcp_throughput_bench )
+{
+#ifdef NDEBUG
+   const uint64_t total_bytes = 512 * 1024 * 1024;
+#else
+   const uint64_t total_bytes = 32 * 1024 * 1024;
+#endif
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+
+   stcp_socket receiver;
+   fc::future<void> accepted = fc::async( [&server,&receiver]() {
+      server.accept( receiver.get_socket() );
+      receiver.accept();
+   }, "stcp_bench accept" );
+   stcp_socket sender;
+   sender.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+   accepted.wait();
+
+   // frames of the size of a large block, what seed nodes mostly send while peers sync from them
+   std::vector<char> frame( 256 * 1024 );
+   for( size_t i = 0; i < frame.size(); ++i )
+      frame[i] = char( i * 31 + 7 );
+   const uint64_t frames = total_bytes / frame.size();
+
+   fc::time_point start = fc::time_point::now();
+   fc::future<void> sent = fc::async( [&sender,&frame,frames]() {
+      for( uint64_t i = 0; i < frames; ++i )
+         sender.write( frame.data(), frame.size() );
+      sender.flush();
+   }, "stcp_bench send" );
+
+   std::vector<char> received( frame.size() );
+   uint64_t mismatches = 0;
+   for( uint64_t i = 0; i < frames; ++i )
+   {
+      receiver.read( received.data(), received.size() );
+      if( received != frame )
+         ++mismatches;
+   }
+   sent.wait();
+   const int64_t elapsed = std::max<int64_t>( ( fc::time_point::now() - start ).count(), 1 );
+   BOOST_CHECK_EQUAL( mismatches, 0u );
+
+   ilog( "stcp_socket throughput of one connection: ${r} MB/s", ("r", frames * frame.size() / elapsed) );
+   sender.close();
+   receiver.close();
+}
@@ -444,6 +444,90 @@ BOOST_FIXTURE_TEST_CASE( cli_set_voting_proxy, cli_fixture )
    }
 }
 
+///////////////////
+// Keep lookups between commands and see the cached account follow the chain
+///////////////////
+BOOST_FIXTURE_TEST_CASE( cli_object_cache, cli_fixture )
+{
+   try {
+      INVOKE(create_new_account);
+
+      con.wallet_api_ptr->enable_object_cache(true);
+      account_object prior_voting_account = con.wallet_api_ptr->get_account("jmjatlanta");
+      con.wallet_api_ptr->set_voting_proxy("jmjatlanta", "nathan", true);
+      BOOST_CHECK(generate_block(app1));
+
+      // the change arrives with the notifications of the block
+      account_object after_voting_account = con.wallet_api_ptr->get_account("jmjatlanta");
+      for( int i = 0; i < 50 && after_voting_account.options.voting_account == prior_voting_account.options.voting_account; ++i )
+      {
+         fc::usleep(fc::milliseconds(100));
+         after_voting_account = con.wallet_api_ptr->get_account("jmjatlanta");
+      }
+      BOOST_CHECK(prior_voting_account.options.voting_account != after_voting_account.options.voting_account);
+
+      // without the cache the account is looked up again
+      con.wallet_api_ptr->enable_object_cache(false);
+      con.wallet_api_ptr->set_voting_proxy("jmjatlanta", optional<string>(), true);
+      BOOST_CHECK(generate_block(app1));
+      BOOST_CHECK(con.wallet_api_ptr->get_account("jmjatlanta").options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT);
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+///////////////////
+// Build, sign and broadcast several transfers at once
+///////////////////
+BOOST_FIXTURE_TEST_CASE( cli_sign_transaction_batch, cli_fixture )
+{
+   try {
+      INVOKE(create_new_account);
+
+      transfer_operation xfer;
+      xfer.from = con.wallet_api_ptr->get_account_id("nathan");
+      xfer.to = con.wallet_api_ptr->get_account_id("jmjatlanta");
+      xfer.amount = asset( 1000 );
+
+      // identical transfers still become distinct transactions, the last one can not pay
+      vector<vector<operation>> batch( 3, vector<operation>{ xfer } );
+      batch.push_back( vector<operation>() );
+      transfer_operation overdraft = xfer;
+      overdraft.from = xfer.to;
+      overdraft.to = xfer.from;
+      overdraft.amount = asset( GRAPHENE_MAX_SHARE_SUPPLY );
+      batch.push_back( vector<operation>{ overdraft } );
+
+      auto before = con.wallet_api_ptr->list_account_balances("jmjatlanta");
+      auto results = con.wallet_api_ptr->sign_transaction_batch(batch, true);
+      BOOST_REQUIRE_EQUAL( results.size(), 5u );
+      std::set<transaction_id_type> ids;
+      for( size_t i = 0; i < 3; ++i )
+      {
+         BOOST_CHECK( results[i].signed_ok );
+         BOOST_CHECK( results[i].broadcast_ok );
+         BOOST_CHECK( !results[i].error );
+         ids.insert( results[i].id );
+      }
+      BOOST_CHECK_EQUAL( ids.size(), 3u );
+      BOOST_CHECK( !results[3].signed_ok );
+      BOOST_CHECK( results[3].error );
+      BOOST_CHECK( results[4].signed_ok );
+      BOOST_CHECK( !results[4].broadcast_ok );
+      BOOST_CHECK( results[4].error );
+
+      BOOST_CHECK(generate_block(app1));
+      auto after = con.wallet_api_ptr->list_account_balances("jmjatlanta");
+      BOOST_REQUIRE_EQUAL( after.size(), 1u );
+      share_type gained = after[0].amount - ( before.empty() ? share_type(0) : before[0].amount );
+      BOOST_CHECK_EQUAL( gained.value, 3000 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 ///////////////////
 // Test blind transactions and mantissa length of range proofs.
 ///////////////////
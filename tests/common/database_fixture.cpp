@@ -28,6 +28,8 @@
 #include <graphene/market_history/market_history_plugin.hpp>
 #include <graphene/grouped_orders/grouped_orders_plugin.hpp>
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
+#include <graphene/history_export/history_export_plugin.hpp>
+#include <graphene/block_stream/block_stream_plugin.hpp>
 #include <graphene/es_objects/es_objects.hpp>
 
 #include <graphene/chain/balance_object.hpp>
@@ -119,6 +121,24 @@ database_fixture::database_fixture()
    {
       options.insert(std::make_pair("max-ops-per-account", boost::program_options::variable_value((uint64_t)75, false)));
    }
+   if (current_test_name == "get_account_history_operations_indexed")
+   {
+      options.insert(std::make_pair("index-history-by-operation-type", boost::program_options::variable_value(true, false)));
+   }
+   if (current_test_name == "get_trade_history_from_recent_trades")
+   {
+      options.insert(std::make_pair("recent-trades-per-market", boost::program_options::variable_value((uint32_t)4, false)));
+   }
+   if (current_test_name == "history_store_tiers")
+   {
+      options.insert(std::make_pair("history-store-dir", boost::program_options::variable_value(
+            (data_dir->path() / "history").generic_string(), false)));
+   }
+   if (current_test_name == "compact_history")
+   {
+      options.insert(std::make_pair("compact-history-file", boost::program_options::variable_value(
+            (data_dir->path() / "compact_history").generic_string(), false)));
+   }
    // add account tracking for ahplugin for special test case with track-account enabled
    if( !options.count("track-account") && current_test_name == "track_account") {
       std::vector<std::string> track_account;
@@ -180,6 +200,32 @@ database_fixture::database_fixture()
       esobjects_plugin->plugin_startup();
    }
 
+   if( current_test_name == "history_export" )
+   {
+      auto export_plugin = app.register_plugin<graphene::history_export::history_export_plugin>();
+      export_plugin->plugin_set_app(&app);
+      options.insert(std::make_pair("history-export-dir", boost::program_options::variable_value(
+            (data_dir->path() / "export").generic_string(), false)));
+      options.insert(std::make_pair("history-export-blocks-per-partition",
+                                    boost::program_options::variable_value(uint32_t(20), false)));
+      options.insert(std::make_pair("history-export-rows-per-group",
+                                    boost::program_options::variable_value(uint32_t(3), false)));
+      export_plugin->plugin_initialize(options);
+      export_plugin->plugin_startup();
+   }
+
+   if( current_test_name == "block_stream" )
+   {
+      auto stream_plugin = app.register_plugin<graphene::block_stream::block_stream_plugin>();
+      stream_plugin->plugin_set_app(&app);
+      options.insert(std::make_pair("block-stream-dir", boost::program_options::variable_value(
+            (data_dir->path() / "stream").generic_string(), false)));
+      options.insert(std::make_pair("block-stream-segment-blocks",
+                                    boost::program_options::variable_value(uint32_t(5), false)));
+      stream_plugin->plugin_initialize(options);
+      stream_plugin->plugin_startup();
+   }
+
    options.insert(std::make_pair("bucket-size", boost::program_options::variable_value(string("[15]"),false)));
    mhplugin->plugin_set_app(&app);
    mhplugin->plugin_initialize(options);
@@ -23,18 +23,25 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <random>
 
 #include <fc/io/fstream.hpp>
 #include <fc/io/json.hpp>
 #include <fc/io/stdio.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/chain/balance_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/egenesis/egenesis.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
 #ifndef WIN32
@@ -53,6 +60,302 @@ namespace graphene { namespace app { namespace detail {
 genesis_state_type create_example_genesis();
 } } } // graphene::app::detail
 
+enum synthetic_kind
+{
+   synthetic_transfer,
+   synthetic_limit_order_create,
+   synthetic_limit_order_cancel,
+   synthetic_kind_count
+};
+
+static const char* const synthetic_kind_names[synthetic_kind_count] = {
+   "transfer", "limit_order_create", "limit_order_cancel"
+};
+
+/**
+ * Fills the blocks with signed transactions of synthetic accounts.
+ *
+ * The first blocks claim the genesis balance of nathan, create an asset and the accounts and fund them with both
+ * assets. Afterwards every block gets as many transactions of the mix as the target rate asks for in the chain time
+ * since the previous block, so missed slots lead to fuller blocks. Everything derives from the seed, the same
+ * options produce the same chain.
+ */
+class transaction_generator
+{
+public:
+   transaction_generator( database& db, const fc::ecc::private_key& nathan_key, double tps,
+                          const array<uint32_t, synthetic_kind_count>& weights, uint32_t account_count, uint64_t seed )
+      : _db( db ), _nathan_key( nathan_key ), _tps( tps ), _weights( weights ), _account_count( account_count ),
+        _random( seed )
+   {
+      for( uint32_t weight : _weights )
+         _total_weight += weight;
+      FC_ASSERT( _total_weight > 0, "The transaction mix is empty" );
+      FC_ASSERT( _account_count >= 2, "At least 2 accounts are needed" );
+   }
+
+   /** pushes the transactions of the next block, @p seconds is the chain time the block covers */
+   void fill( uint32_t seconds )
+   {
+      if( !bootstrapped() )
+      {
+         bootstrap();
+         return;
+      }
+      _owed += _tps * seconds;
+      const uint64_t count = uint64_t( _owed );
+      _owed -= count;
+      for( uint64_t i = 0; i < count; ++i )
+         push_synthetic();
+   }
+
+   bool bootstrapped()const { return _accounts.size() == _account_count; }
+
+   uint64_t pushed()const
+   {
+      uint64_t total = 0;
+      for( uint64_t count : _pushed )
+         total += count;
+      return total;
+   }
+
+   void report( ostream& out )const
+   {
+      for( uint32_t kind = 0; kind < synthetic_kind_count; ++kind )
+         out << synthetic_kind_names[kind] << ": " << _pushed[kind] << " pushed, " << _rejected[kind] << " rejected\n";
+   }
+
+private:
+   /** transactions of the setup that fit into a block with the default parameters */
+   static const uint32_t bootstrap_batch = 100;
+
+   string account_name( uint32_t index )const { return "synthetic-" + fc::to_string( index ); }
+
+   void bootstrap()
+   {
+      const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+      if( _nathan == account_id_type() )
+      {
+         const auto nathan = accounts_by_name.find( "nathan" );
+         FC_ASSERT( nathan != accounts_by_name.end() && _db.find( balance_id_type() ) != nullptr,
+                    "Synthetic transactions need the nathan account and genesis balance of the example genesis" );
+         _nathan = nathan->id;
+         const balance_object& genesis_balance = balance_id_type()( _db );
+
+         balance_claim_operation claim;
+         claim.deposit_to_account = _nathan;
+         claim.balance_to_claim = genesis_balance.id;
+         claim.balance_owner_key = _nathan_key.get_public_key();
+         claim.total_claimed = genesis_balance.balance;
+         account_upgrade_operation upgrade;
+         upgrade.account_to_upgrade = _nathan;
+         upgrade.upgrade_to_lifetime_member = true;
+         asset_create_operation create;
+         create.issuer = _nathan;
+         create.symbol = "SYNTHETIC";
+         create.precision = GRAPHENE_BLOCKCHAIN_PRECISION_DIGITS;
+         create.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+         create.common_options.core_exchange_rate = price( asset( 1, asset_id_type(1) ), asset( 1 ) );
+         push( { claim, upgrade }, _nathan_key );
+         const processed_transaction created = push( { create }, _nathan_key );
+         _synthetic_asset = asset_id_type( created.operation_results[0].get<object_id_type>() );
+         return;
+      }
+
+      // the accounts created by the previous block get their funds
+      while( _accounts.size() < _created )
+      {
+         operation_vector funding;
+         for( uint32_t i = 0; i < bootstrap_batch && _accounts.size() < _created; ++i )
+         {
+            const uint32_t index = _accounts.size();
+            const auto account = accounts_by_name.find( account_name( index ) );
+            FC_ASSERT( account != accounts_by_name.end(), "Synthetic account ${n} was not created", ("n", account_name( index )) );
+            _accounts.push_back( account->id );
+
+            transfer_operation transfer;
+            transfer.from = _nathan;
+            transfer.to = account->id;
+            transfer.amount = asset( _db.get_balance( _nathan, asset_id_type() ).amount / ( 2 * ( _account_count - index ) ) );
+            asset_issue_operation issue;
+            issue.issuer = _nathan;
+            issue.issue_to_account = account->id;
+            issue.asset_to_issue = asset( GRAPHENE_MAX_SHARE_SUPPLY / ( 2 * _account_count ), _synthetic_asset );
+            funding.push_back( transfer );
+            funding.push_back( issue );
+         }
+         push( funding, _nathan_key );
+      }
+
+      for( uint32_t i = 0; i < bootstrap_batch && _created < _account_count; ++i, ++_created )
+      {
+         const public_key_type key = account_key( _created ).get_public_key();
+         account_create_operation create;
+         create.registrar = _nathan;
+         create.referrer = _nathan;
+         create.name = account_name( _created );
+         create.owner = authority( 1, key, 1 );
+         create.active = authority( 1, key, 1 );
+         create.options.memo_key = key;
+         create.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         push( { create }, _nathan_key );
+      }
+   }
+
+   fc::ecc::private_key account_key( uint32_t index )
+   {
+      while( _keys.size() <= index )
+         _keys.push_back( fc::ecc::private_key::regenerate( fc::sha256::hash( account_name( _keys.size() ) ) ) );
+      return _keys[index];
+   }
+
+   uint32_t random_account()
+   {
+      return std::uniform_int_distribution<uint32_t>( 0, _account_count - 1 )( _random );
+   }
+
+   synthetic_kind random_kind()
+   {
+      uint32_t choice = std::uniform_int_distribution<uint32_t>( 0, _total_weight - 1 )( _random );
+      for( uint32_t kind = 0; kind < synthetic_kind_count; ++kind )
+      {
+         if( choice < _weights[kind] )
+            return synthetic_kind( kind );
+         choice -= _weights[kind];
+      }
+      return synthetic_transfer;
+   }
+
+   void push_synthetic()
+   {
+      synthetic_kind kind = random_kind();
+      // orders that were filled or expired in the meantime cannot be cancelled
+      while( kind == synthetic_limit_order_cancel && !_orders.empty()
+             && _db.find( _orders.front().first ) == nullptr )
+         _orders.pop_front();
+      if( kind == synthetic_limit_order_cancel && _orders.empty() )
+         kind = synthetic_transfer;
+
+      uint32_t sender = random_account();
+      operation op;
+      switch( kind )
+      {
+      case synthetic_transfer:
+      {
+         uint32_t receiver = random_account();
+         if( receiver == sender )
+            receiver = ( receiver + 1 ) % _account_count;
+         transfer_operation transfer;
+         transfer.from = _accounts[sender];
+         transfer.to = _accounts[receiver];
+         transfer.amount = asset( std::uniform_int_distribution<int64_t>( 1, 100000 )( _random ),
+                                  std::bernoulli_distribution( 0.5 )( _random ) ? asset_id_type() : _synthetic_asset );
+         op = transfer;
+         break;
+      }
+      case synthetic_limit_order_create:
+      {
+         // prices scatter around 1:1 so that some orders fill and others rest on the book
+         const bool sell_core = std::bernoulli_distribution( 0.5 )( _random );
+         const int64_t amount = std::uniform_int_distribution<int64_t>( 1000, 1000000 )( _random );
+         const int64_t receive = amount * std::uniform_int_distribution<int64_t>( 95, 105 )( _random ) / 100;
+         limit_order_create_operation order;
+         order.seller = _accounts[sender];
+         order.amount_to_sell = asset( amount, sell_core ? asset_id_type() : _synthetic_asset );
+         order.min_to_receive = asset( receive, sell_core ? _synthetic_asset : asset_id_type() );
+         order.expiration = _db.head_block_time()
+                          + std::uniform_int_distribution<uint32_t>( 3600, 7 * 24 * 3600 )( _random );
+         op = order;
+         break;
+      }
+      case synthetic_limit_order_cancel:
+      default:
+      {
+         const size_t index = std::uniform_int_distribution<size_t>( 0, _orders.size() - 1 )( _random );
+         sender = _orders[index].second;
+         limit_order_cancel_operation cancel;
+         cancel.fee_paying_account = _accounts[sender];
+         cancel.order = _orders[index].first;
+         _orders.erase( _orders.begin() + index );
+         op = cancel;
+      }
+      }
+
+      try
+      {
+         const processed_transaction trx = push( { op }, account_key( sender ) );
+         ++_pushed[kind];
+         if( kind == synthetic_limit_order_create )
+         {
+            _orders.emplace_back( limit_order_id_type( trx.operation_results[0].get<object_id_type>() ), sender );
+            if( _orders.size() > max_tracked_orders )
+               _orders.pop_front();
+         }
+      }
+      catch( const fc::exception& e )
+      {
+         // e.g. an account ran out of funds, the chain stays valid without the transaction
+         ++_rejected[kind];
+         dlog( "synthetic ${k} rejected: ${e}", ("k", synthetic_kind_names[kind])("e", e.to_string()) );
+      }
+   }
+
+   processed_transaction push( const operation_vector& ops, const fc::ecc::private_key& key )
+   {
+      signed_transaction trx;
+      trx.operations = ops;
+      for( auto& op : trx.operations )
+         _db.current_fee_schedule().set_fee( op );
+      // transactions with equal operations differ by their expiration
+      const uint32_t max_expiration = _db.get_global_properties().parameters.maximum_time_until_expiration;
+      trx.set_expiration( _db.head_block_time() + std::min<uint32_t>( max_expiration, 60 + _sequence++ % 3000 ) );
+      trx.set_reference_block( _db.head_block_id() );
+      trx.sign( key, _db.get_chain_id() );
+      return _db.push_transaction( trx, database::skip_nothing );
+   }
+
+   /** bounds the memory of long runs, older orders are left to expire */
+   static const size_t max_tracked_orders = 100000;
+
+   database&                                  _db;
+   fc::ecc::private_key                       _nathan_key;
+   double                                     _tps;
+   array<uint32_t, synthetic_kind_count>      _weights;
+   uint32_t                                   _total_weight = 0;
+   uint32_t                                   _account_count;
+   std::mt19937_64                            _random;
+
+   account_id_type                            _nathan;
+   asset_id_type                              _synthetic_asset;
+   uint32_t                                   _created = 0;
+   vector<account_id_type>                    _accounts;
+   vector<fc::ecc::private_key>               _keys;
+   deque<pair<limit_order_id_type, uint32_t>> _orders;
+   double                                     _owed = 0;
+   uint64_t                                   _sequence = 0;
+   array<uint64_t, synthetic_kind_count>      _pushed{};
+   array<uint64_t, synthetic_kind_count>      _rejected{};
+};
+
+/** @return the weights of the kinds given as kind:weight,..., kinds not mentioned get 0 */
+static array<uint32_t, synthetic_kind_count> parse_mix( const string& mix )
+{
+   array<uint32_t, synthetic_kind_count> weights;
+   weights.fill( 0 );
+   vector<string> items;
+   boost::split( items, mix, boost::is_any_of( "," ) );
+   for( const string& item : items )
+   {
+      const size_t colon = item.find( ':' );
+      FC_ASSERT( colon != string::npos, "Expected <kind>:<weight> in ${i}", ("i", item) );
+      const auto kind = std::find( std::begin( synthetic_kind_names ), std::end( synthetic_kind_names ),
+                                   item.substr( 0, colon ) );
+      FC_ASSERT( kind != std::end( synthetic_kind_names ), "Unknown transaction kind ${k}", ("k", item.substr( 0, colon )) );
+      weights[kind - std::begin( synthetic_kind_names )] = std::stoul( item.substr( colon + 1 ) );
+   }
+   return weights;
+}
+
 int main( int argc, char** argv )
 {
    try
@@ -65,6 +368,10 @@ int main( int argc, char** argv )
             ("genesis-time,t", bpo::value<uint32_t>()->default_value(0), "Timestamp for genesis state (0=use value from file/example)")
             ("num-blocks,n", bpo::value<uint32_t>()->default_value(1000000), "Number of blocks to generate")
             ("miss-rate,r", bpo::value<uint32_t>()->default_value(3), "Percentage of blocks to miss")
+            ("tps", bpo::value<double>()->default_value(0), "Synthetic transactions per second of chain time to fill the blocks with (0=empty blocks)")
+            ("tx-mix", bpo::value<string>()->default_value("transfer:60,limit_order_create:30,limit_order_cancel:10"), "Relative weights of the synthetic transactions: transfer, limit_order_create and limit_order_cancel")
+            ("accounts", bpo::value<uint32_t>()->default_value(1000), "Number of synthetic accounts sending the transactions")
+            ("seed", bpo::value<uint64_t>()->default_value(0), "Seed of the synthetic transactions")
             ("verbose,v", "Enter verbose mode")
             ;
 
@@ -123,11 +430,19 @@ int main( int argc, char** argv )
       fc::path db_path = data_dir / "db";
       db.open(db_path, [&]() { return genesis; }, "TEST" );
 
+      double tps = options["tps"].as<double>();
+      std::unique_ptr<transaction_generator> generator;
+      if( tps > 0 )
+         generator.reset( new transaction_generator( db, nathan_priv_key, tps, parse_mix( options["tx-mix"].as<string>() ),
+                                                     options["accounts"].as<uint32_t>(), options["seed"].as<uint64_t>() ) );
+
       uint32_t slot = 1;
       uint32_t missed = 0;
 
       for( uint32_t i = 1; i < num_blocks; ++i )
       {
+         if( generator )
+            generator->fill( (db.get_slot_time(slot) - db.head_block_time()).to_seconds() );
          signed_block b = db.generate_block(db.get_slot_time(slot), db.get_scheduled_witness(slot), nathan_priv_key, database::skip_nothing);
          FC_ASSERT( db.head_block_id() == b.id() );
          fc::sha256 h = b.digest();
@@ -154,6 +469,8 @@ int main( int argc, char** argv )
          else if( (i%10000) == 0 )
          {
             std::cerr << "\rblock #" << i << "   missed " << missed;
+            if( generator )
+               std::cerr << "   transactions " << generator->pushed();
          }
          if( slot == 1 )  // can possibly get consecutive production if block missed
          {
@@ -161,6 +478,12 @@ int main( int argc, char** argv )
          }
       }
       std::cerr << "\n";
+      if( generator )
+      {
+         if( !generator->bootstrapped() )
+            std::cerr << "warning: num-blocks too small to create and fund all synthetic accounts\n";
+         generator->report( std::cerr );
+      }
       db.close();
    }
    catch ( const fc::exception& e )
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "allocation_profile.hpp"
+
+#include <graphene/chain/protocol/operations.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+/** what the allocations of the calling thread are added to, nullptr while it is not profiled */
+thread_local graphene::chain::test::allocation_profiler::counts* current_counts = nullptr;
+
+void* counted_malloc( std::size_t size )
+{
+   graphene::chain::test::allocation_profiler::counts* counts = current_counts;
+   if( counts != nullptr )
+   {
+      ++counts->allocations;
+      counts->bytes += size;
+   }
+   while( true )
+   {
+      void* p = std::malloc( size == 0 ? 1 : size );
+      if( p != nullptr )
+         return p;
+      std::new_handler handler = std::set_new_handler( nullptr );
+      std::set_new_handler( handler );
+      if( handler == nullptr )
+         return nullptr;
+      handler();
+   }
+}
+
+struct operation_name_visitor
+{
+   typedef std::string result_type;
+   template<typename T>
+   std::string operator()( const T& )const
+   {
+      std::string name = fc::get_typename<T>::name();
+      auto pos = name.rfind( "::" );
+      return pos == std::string::npos ? name : name.substr( pos + 2 );
+   }
+};
+
+} // anonymous namespace
+
+void* operator new( std::size_t size )
+{
+   void* p = counted_malloc( size );
+   if( p == nullptr )
+      throw std::bad_alloc();
+   return p;
+}
+
+void* operator new[]( std::size_t size )
+{
+   return ::operator new( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept
+{
+   return counted_malloc( size );
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept
+{
+   return counted_malloc( size );
+}
+
+void operator delete( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept
+{
+   std::free( p );
+}
+
+namespace graphene { namespace chain { namespace test {
+
+using graphene::db::apply_phase;
+
+allocation_profiler::allocation_profiler()
+{
+   reset();
+}
+
+allocation_profiler::~allocation_profiler()
+{
+   stop();
+}
+
+void allocation_profiler::start()
+{
+   _started = true;
+   install( this );
+}
+
+void allocation_profiler::stop()
+{
+   if( !_started )
+      return;
+   _started = false;
+   current_counts = nullptr;
+   install( nullptr );
+}
+
+void allocation_profiler::reset()
+{
+   // sized up front, a reallocation while profiling would count itself
+   _counts.assign( operation::count() + 1, phase_counts() );
+   _evaluations.assign( operation::count() + 1, 0 );
+}
+
+void allocation_profiler::on_phase( apply_phase phase, int64_t op_tag, bool resumed )
+{
+   const size_t index = op_tag < 0 || uint64_t( op_tag ) >= operation::count() ? 0 : size_t( op_tag ) + 1;
+   if( phase == apply_phase::evaluate && !resumed )
+      ++_evaluations[index];
+   current_counts = &_counts[index][uint8_t( phase )];
+}
+
+fc::variants allocation_profiler::report()const
+{
+   counts* const counting = current_counts;
+   current_counts = nullptr;
+
+   std::vector<std::pair<uint64_t, size_t>> order;
+   for( size_t index = 0; index < _counts.size(); ++index )
+   {
+      uint64_t allocations = 0;
+      for( const counts& c : _counts[index] )
+         allocations += c.allocations;
+      if( allocations > 0 )
+         order.emplace_back( allocations, index );
+   }
+   std::sort( order.rbegin(), order.rend() );
+
+   fc::variants result;
+   for( const auto& item : order )
+   {
+      const size_t index = item.second;
+      std::string name = "block";
+      if( index > 0 )
+      {
+         operation op;
+         op.set_which( index - 1 );
+         name = op.visit( operation_name_visitor() );
+      }
+      fc::mutable_variant_object phases;
+      for( uint32_t phase = 0; phase < graphene::db::apply_phase_count; ++phase )
+      {
+         const counts& c = _counts[index][phase];
+         if( c.allocations > 0 )
+            phases( graphene::db::apply_phase_name( apply_phase( phase ) ),
+                    fc::mutable_variant_object( "allocations", c.allocations )( "bytes", c.bytes ) );
+      }
+      result.emplace_back( fc::mutable_variant_object()
+            ( "operation", name )
+            ( "evaluations", _evaluations[index] )
+            ( "allocations", item.first )
+            ( "phases", phases ) );
+   }
+
+   current_counts = counting;
+   return result;
+}
+
+allocation_profiler::counts allocation_profiler::total()const
+{
+   counts result;
+   for( const phase_counts& phases : _counts )
+      for( const counts& c : phases )
+      {
+         result.allocations += c.allocations;
+         result.bytes += c.bytes;
+      }
+   return result;
+}
+
+} } } // graphene::chain::test
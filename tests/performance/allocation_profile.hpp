@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/db/apply_phase.hpp>
+
+#include <fc/variant.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace graphene { namespace chain { namespace test {
+
+/**
+ * Counts the heap allocations of the thread it is started on by phase of block application and operation type.
+ *
+ * allocation_profile.cpp replaces the global operator new, so only what is allocated through it is counted, malloc
+ * calls of C libraries are not. Allocations of worker threads, e.g. of parallel signature recovery, are not counted
+ * either. The checks of a transaction are attributed to the type of its first operation, the work done for the
+ * block as a whole is reported under "block".
+ */
+class allocation_profiler : public graphene::db::apply_phase_listener
+{
+   public:
+      struct counts
+      {
+         uint64_t allocations = 0;
+         uint64_t bytes = 0;
+      };
+
+      allocation_profiler();
+      ~allocation_profiler();
+
+      /** Starts counting on the calling thread */
+      void start();
+      /** Stops counting, the counts are kept */
+      void stop();
+      void reset();
+
+      virtual void on_phase( graphene::db::apply_phase phase, int64_t op_tag, bool resumed ) override;
+
+      /** @return one object per operation type with allocations, with the count and the allocations and bytes of
+       *  each phase, ordered by allocations */
+      fc::variants report()const;
+      /** @return the allocations and bytes of all phases and operation types together */
+      counts total()const;
+
+   private:
+      typedef std::array<counts, graphene::db::apply_phase_count> phase_counts;
+
+      /// index 0 is the block as a whole, the operation types follow
+      std::vector<phase_counts> _counts;
+      /// how often each operation type was evaluated
+      std::vector<uint64_t>     _evaluations;
+      bool                      _started = false;
+};
+
+} } } // graphene::chain::test
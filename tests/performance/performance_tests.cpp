@@ -27,10 +27,14 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
+#include <fc/bitutil.hpp>
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -55,6 +59,173 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    wlog( "Benchmark: verify ${sps} signatures/s", ("sps",(cycles*1000000)/elapsed.count()) );
 }
 
+// Simulates peers flooding us with inventory: every announced block and transaction id is checked once
+BOOST_AUTO_TEST_CASE( inventory_flood_benchmark )
+{ try {
+   generate_blocks( 2000 );
+   const uint32_t head = db.head_block_num();
+   vector<block_id_type> known;
+   vector<block_id_type> unknown;
+   for( uint32_t num = 1; num <= head; ++num )
+   {
+      known.push_back( db.get_block_id_for_num( num ) );
+      block_id_type other = known.back();
+      other._hash[4] ^= 1;
+      unknown.push_back( other );
+   }
+   vector<block_id_type> future;
+   for( uint32_t num = head + 1; num <= 2 * head; ++num )
+   {
+      block_id_type id;
+      id._hash[0] = fc::endian_reverse_u32( num );
+      future.push_back( id );
+   }
+
+   const uint32_t rounds = 100;
+   auto measure = [&]( const char* what, const vector<block_id_type>& ids, bool expected ) {
+      auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( const block_id_type& id : ids )
+            BOOST_REQUIRE( db.is_known_block( id ) == expected );
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: ${n} ${what} block lookups/s",
+            ("n",(uint64_t(rounds)*ids.size()*1000000)/std::max<int64_t>(elapsed.count(),1))("what",what) );
+   };
+   measure( "known", known, true );
+   measure( "unknown", unknown, false );
+   measure( "future", future, false );
+
+   vector<transaction_id_type> trx_ids;
+   for( uint32_t i = 0; i < 100000; ++i )
+      trx_ids.push_back( fc::ripemd160::hash( fc::to_string( i ) ) );
+   auto start = fc::time_point::now();
+   for( const transaction_id_type& id : trx_ids )
+      BOOST_REQUIRE( !db.is_known_transaction( id ) );
+   auto elapsed = fc::time_point::now() - start;
+   wlog( "Benchmark: ${n} transaction lookups/s",
+         ("n",(uint64_t(trx_ids.size())*1000000)/std::max<int64_t>(elapsed.count(),1)) );
+} FC_LOG_AND_RETHROW() }
+
+// Times the maintenance block with many voting accounts, with serial and with parallel vote tallying
+BOOST_AUTO_TEST_CASE( vote_tally_benchmark )
+{ try {
+   const fc::ecc::private_key voter_key = fc::ecc::private_key::generate();
+   const public_key_type voter_pub = voter_key.get_public_key();
+   const auto& committee_account = account_id_type()(db);
+
+#ifdef NDEBUG
+   const uint32_t voters = 100000;
+#else
+   const uint32_t voters = 10000;
+#endif
+
+   flat_set<vote_id_type> votes;
+   const auto& witnesses = db.get_index_type<witness_index>().indices();
+   const auto& committee_members = db.get_index_type<committee_member_index>().indices();
+   for( const witness_object& w : witnesses )
+      votes.insert( w.vote_id );
+   for( const committee_member_object& c : committee_members )
+      votes.insert( c.vote_id );
+
+   account_create_operation aco;
+   aco.registrar = committee_account.id;
+   aco.owner = authority( 1, voter_pub, 1 );
+   aco.active = authority( 1, voter_pub, 1 );
+   aco.options.memo_key = voter_pub;
+   aco.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+   aco.options.votes = votes;
+   transfer_operation top;
+   top.from = committee_account.id;
+   top.fee = asset( 10 );
+   trx.clear();
+   test::set_expiration( db, trx );
+   for( uint32_t i = 0; i < voters; ++i )
+   {
+      aco.name = "voter" + fc::to_string(i);
+      aco.options.num_witness = i % ( witnesses.size() + 1 );
+      aco.options.num_committee = i % ( committee_members.size() + 1 );
+      aco.fee = db.current_fee_schedule().calculate_fee( aco );
+      trx.operations.push_back( aco );
+      auto result = db.apply_transaction( trx, ~0 );
+      trx.operations.clear();
+      top.to = result.operation_results[0].get<object_id_type>();
+      top.amount = asset( 1000 + i );
+      trx.operations.push_back( top );
+      db.apply_transaction( trx, ~0 );
+      trx.operations.clear();
+   }
+   trx.clear();
+
+   auto maintenance = [this]( bool parallel ) {
+      db.enable_parallel_vote_tally( parallel );
+      auto start = fc::time_point::now();
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: maintenance block with ${n} voters and ${m} vote tally in ${t}ms",
+            ("n",db.get_index_type<account_index>().indices().size())("m",parallel ? "parallel" : "serial")
+            ("t",elapsed.count()/1000) );
+      vector<uint64_t> result;
+      for( const witness_object& w : db.get_index_type<witness_index>().indices() )
+         result.push_back( w.total_votes );
+      for( const committee_member_object& c : db.get_index_type<committee_member_index>().indices() )
+         result.push_back( c.total_votes );
+      return result;
+   };
+   // the first maintenance processes the fees of the setup
+   maintenance( false );
+   const vector<uint64_t> serial = maintenance( false );
+   const vector<uint64_t> parallel = maintenance( true );
+   BOOST_CHECK( serial == parallel );
+} FC_LOG_AND_RETHROW() }
+
+// Times the block in which many limit orders expire at the same second
+BOOST_AUTO_TEST_CASE( expired_orders_benchmark )
+{ try {
+   ACTORS( (alice) );
+   fund( alice, asset(100000000) );
+   const asset_object& usd = create_user_issued_asset( "USDBIT" );
+   const asset_id_type usd_id = usd.id;
+
+#ifdef NDEBUG
+   const uint32_t orders = 20000;
+#else
+   const uint32_t orders = 2000;
+#endif
+
+   limit_order_create_operation loco;
+   loco.seller = alice_id;
+   loco.amount_to_sell = asset( 100 );
+   loco.expiration = db.head_block_time() + 3600;
+   loco.fee = db.current_fee_schedule().calculate_fee( loco );
+   trx.clear();
+   for( uint32_t i = 0; i < orders; ++i )
+   {
+      // distinct prices, the orders do not match anything
+      loco.min_to_receive = asset( 1000 + i, usd_id );
+      trx.operations.push_back( loco );
+      test::set_expiration( db, trx );
+      PUSH_TX( db, trx, ~0 );
+      trx.operations.clear();
+      if( i % 500 == 499 )
+         generate_block();
+   }
+   generate_block();
+   const time_point_sec expiration = loco.expiration;
+
+   const auto& limit_index = db.get_index_type<limit_order_index>().indices();
+   BOOST_REQUIRE_EQUAL( limit_index.size(), orders );
+   generate_blocks( expiration - 60 );
+
+   int64_t slowest = 0;
+   while( !limit_index.empty() )
+   {
+      auto start = fc::time_point::now();
+      generate_block();
+      slowest = std::max( slowest, ( fc::time_point::now() - start ).count() );
+   }
+   wlog( "Benchmark: ${n} limit orders expired, slowest block took ${t}ms", ("n",orders)("t",slowest/1000) );
+} FC_LOG_AND_RETHROW() }
+
 // See https://bitshares.org/blog/2015/06/08/measuring-performance/
 // (note this is not the original test mentioned in the above post, but was
 //  recreated later according to the description)
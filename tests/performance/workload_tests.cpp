@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <fc/io/json.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "allocation_profile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+enum workload_kind
+{
+   wl_transfer,
+   wl_limit_order_create,
+   wl_limit_order_cancel,
+   wl_call_order_update,
+   wl_asset_publish_feed,
+   wl_proposal_create,
+   wl_proposal_update,
+   wl_vote,
+   wl_kind_count
+};
+
+const char* const workload_kind_names[wl_kind_count] = {
+   "transfer", "limit_order_create", "limit_order_cancel", "call_order_update",
+   "asset_publish_feed", "proposal_create", "proposal_update", "vote"
+};
+
+typedef std::chrono::steady_clock workload_clock;
+
+int64_t elapsed_ns( workload_clock::time_point start )
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>( workload_clock::now() - start ).count();
+}
+
+/// Latencies of one kind of work
+class latency_stats
+{
+   public:
+      void record( int64_t ns ) { _samples.push_back( ns ); _total += ns; }
+      void fail() { ++_failed; }
+
+      size_t  count()const { return _samples.size(); }
+      int64_t total_ns()const { return _total; }
+
+      void report( const string& name )
+      {
+         if( _samples.empty() && _failed == 0 )
+            return;
+         std::sort( _samples.begin(), _samples.end() );
+         wlog( "Benchmark: workload ${s}: ${n} in ${t} ms (${f} failed), ${r}/s, latency in us "
+               "p50 ${p50} p90 ${p90} p99 ${p99} max ${max}",
+               ("s",name)("n",_samples.size())("f",_failed)("t",_total/1000000)
+               ("r",_total > 0 ? uint64_t(_samples.size()) * 1000000000 / _total : 0)
+               ("p50",percentile(50)/1000)("p90",percentile(90)/1000)("p99",percentile(99)/1000)
+               ("max",_samples.empty() ? 0 : _samples.back()/1000) );
+      }
+
+   private:
+      int64_t percentile( uint32_t p )const
+      {
+         return _samples.empty() ? 0 : _samples[ ( _samples.size() - 1 ) * p / 100 ];
+      }
+
+      vector<int64_t> _samples;
+      int64_t         _total = 0;
+      uint64_t        _failed = 0;
+};
+
+/**
+ * Pushes a configurable mix of operations in blocks of a configurable size, so that a production mix can be modeled
+ * and the headroom under it measured.
+ *
+ * Options (after `--` on the command line):
+ *   --workload-accounts=<n>    accounts that trade, transfer, borrow, propose and vote
+ *   --workload-markets=<n>     market issued assets traded against CORE, each with a feed producer, at most 26
+ *   --workload-block-size=<n>  transactions of one operation each per block
+ *   --workload-blocks=<n>      blocks to produce
+ *   --workload-mix=<kind>:<weight>,...  relative frequency of the kinds, the others keep their default weight;
+ *                              kinds are transfer, limit_order_create, limit_order_cancel, call_order_update,
+ *                              asset_publish_feed, proposal_create, proposal_update and vote
+ *   --workload-seed=<n>        seed of the random choices, the same seed produces the same workload
+ *   --workload-allocations     count the heap allocations of pushing and producing the blocks by phase and
+ *                              operation type
+ */
+struct workload_fixture : database_fixture
+{
+   uint32_t account_count = 0;
+   uint32_t market_count = 4;
+   uint32_t block_size = 200;
+   uint32_t block_count = 0;
+   uint32_t seed = 1;
+   bool     profile_allocations = false;
+   std::array<uint32_t, wl_kind_count> weights = {{ 50, 20, 15, 5, 3, 3, 2, 2 }};
+
+   vector<account_id_type> accounts;
+   vector<asset_id_type>   markets;
+   vector<account_id_type> feed_producers;
+   vector<vote_id_type>    witness_votes;
+   vector<limit_order_id_type> open_orders;
+   /// proposals and the account whose transfer they propose
+   vector<std::pair<proposal_id_type, account_id_type>> open_proposals;
+
+   std::array<latency_stats, wl_kind_count> operation_stats;
+   latency_stats block_stats;
+   latency_stats setup_stats;
+   std::mt19937  rng;
+
+   workload_fixture()
+   {
+#ifdef NDEBUG
+      account_count = 1000;
+      block_count = 50;
+#else
+      account_count = 200;
+      block_count = 10;
+#endif
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i = 1; i < argc; ++i )
+      {
+         const std::string arg = argv[i];
+         const auto value = [&arg]() { return std::max( 1, std::stoi( arg.substr( arg.find( '=' ) + 1 ) ) ); };
+         if( arg == "--workload-allocations" )
+            profile_allocations = true;
+         else if( arg.find( "--workload-accounts=" ) == 0 )
+            account_count = std::max( 2, value() );
+         else if( arg.find( "--workload-markets=" ) == 0 )
+            market_count = std::min( 26, value() );
+         else if( arg.find( "--workload-block-size=" ) == 0 )
+            block_size = value();
+         else if( arg.find( "--workload-blocks=" ) == 0 )
+            block_count = value();
+         else if( arg.find( "--workload-seed=" ) == 0 )
+            seed = value();
+         else if( arg.find( "--workload-mix=" ) == 0 )
+            parse_mix( arg.substr( 15 ) );
+      }
+      rng.seed( seed );
+
+      generate_blocks( HARDFORK_CORE_1479_TIME );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      generate_block();
+      set_up();
+   }
+
+   void parse_mix( const string& mix )
+   {
+      size_t begin = 0;
+      while( begin < mix.size() )
+      {
+         size_t end = mix.find( ',', begin );
+         if( end == string::npos )
+            end = mix.size();
+         const string item = mix.substr( begin, end - begin );
+         const size_t colon = item.find( ':' );
+         FC_ASSERT( colon != string::npos, "Expected <kind>:<weight> in ${i}", ("i",item) );
+         const string name = item.substr( 0, colon );
+         const auto kind = std::find( std::begin( workload_kind_names ), std::end( workload_kind_names ), name );
+         FC_ASSERT( kind != std::end( workload_kind_names ), "Unknown workload kind ${n}", ("n",name) );
+         weights[ kind - std::begin( workload_kind_names ) ] = std::stoi( item.substr( colon + 1 ) );
+         begin = end + 1;
+      }
+   }
+
+   uint32_t random( uint32_t bound ) { return std::uniform_int_distribution<uint32_t>( 0, bound - 1 )( rng ); }
+   account_id_type random_account() { return accounts[ random( accounts.size() ) ]; }
+
+   /// accounts with CORE, a call order in every market and the assets borrowed, markets with a feed
+   void set_up()
+   {
+      const auto start = workload_clock::now();
+      price_feed feed;
+      feed.maintenance_collateral_ratio = 1750;
+      feed.maximum_short_squeeze_ratio = 1100;
+      for( uint32_t m = 0; m < market_count; ++m )
+      {
+         const account_id_type producer = create_account( "workload-feeder-" + fc::to_string( m ) ).id;
+         const asset_id_type mpa = create_bitasset( string( "WORKLOAD" ) + char( 'A' + m ), producer ).id;
+         update_feed_producers( mpa, { producer } );
+         feed.settlement_price = asset( 1, mpa ) / asset( 5 );
+         feed.core_exchange_rate = feed.settlement_price;
+         publish_feed( mpa, producer, feed );
+         feed_producers.push_back( producer );
+         markets.push_back( mpa );
+      }
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         const account_object& account = create_account( "workload-" + fc::to_string( i ) );
+         accounts.push_back( account.id );
+         fund( account, asset( 100000000 ) );
+         // four times the collateral the debt is worth at the feed
+         for( const asset_id_type mpa : markets )
+            borrow( account, asset( 1000, mpa ), asset( 20000 ) );
+         if( i % 500 == 499 )
+            generate_block();
+      }
+      for( const witness_object& w : db.get_index_type<witness_index>().indices() )
+         witness_votes.push_back( w.vote_id );
+      generate_block();
+      setup_stats.record( elapsed_ns( start ) );
+   }
+
+   workload_kind pick()
+   {
+      uint32_t total = 0;
+      for( uint32_t w : weights )
+         total += w;
+      FC_ASSERT( total > 0, "All workload weights are 0" );
+      uint32_t choice = random( total );
+      for( uint32_t k = 0; k < wl_kind_count; ++k )
+      {
+         if( choice < weights[k] )
+            return workload_kind( k );
+         choice -= weights[k];
+      }
+      return wl_transfer;
+   }
+
+   /// @return the operation to push for kind, or for the kind it falls back to if nothing is there to act on
+   operation make_operation( workload_kind& kind )
+   {
+      switch( kind )
+      {
+         case wl_limit_order_cancel:
+            while( !open_orders.empty() )
+            {
+               const size_t i = random( open_orders.size() );
+               const limit_order_id_type id = open_orders[i];
+               std::swap( open_orders[i], open_orders.back() );
+               open_orders.pop_back();
+               if( const limit_order_object* order = db.find( id ) )
+               {
+                  limit_order_cancel_operation op;
+                  op.fee_paying_account = order->seller;
+                  op.order = id;
+                  return op;
+               }
+            }
+            kind = wl_limit_order_create;
+            return make_operation( kind );
+         case wl_limit_order_create:
+         {
+            // prices within 5% of the feed on both sides, so that some orders fill and some rest
+            const asset_id_type mpa = markets[ random( markets.size() ) ];
+            const int64_t premium = 95 + random( 11 );
+            limit_order_create_operation op;
+            op.seller = random_account();
+            if( random( 2 ) )
+            {
+               op.amount_to_sell = asset( 500 );
+               op.min_to_receive = asset( premium, mpa );
+            }
+            else
+            {
+               op.amount_to_sell = asset( 20, mpa );
+               op.min_to_receive = asset( premium );
+            }
+            return op;
+         }
+         case wl_call_order_update:
+         {
+            call_order_update_operation op;
+            op.funding_account = random_account();
+            op.delta_debt = asset( 10, markets[ random( markets.size() ) ] );
+            op.delta_collateral = asset( 200 );
+            return op;
+         }
+         case wl_asset_publish_feed:
+         {
+            const uint32_t m = random( markets.size() );
+            asset_publish_feed_operation op;
+            op.publisher = feed_producers[m];
+            op.asset_id = markets[m];
+            op.feed.maintenance_collateral_ratio = 1750;
+            op.feed.maximum_short_squeeze_ratio = 1100;
+            op.feed.settlement_price = asset( 100, markets[m] ) / asset( 490 + random( 21 ) );
+            op.feed.core_exchange_rate = op.feed.settlement_price;
+            return op;
+         }
+         case wl_proposal_update:
+            while( !open_proposals.empty() )
+            {
+               const size_t i = random( open_proposals.size() );
+               const auto proposal = open_proposals[i];
+               std::swap( open_proposals[i], open_proposals.back() );
+               open_proposals.pop_back();
+               if( db.find( proposal.first ) != nullptr )
+               {
+                  // the approval of the sender executes the proposed transfer
+                  proposal_update_operation op;
+                  op.fee_paying_account = proposal.second;
+                  op.proposal = proposal.first;
+                  op.active_approvals_to_add.insert( proposal.second );
+                  return op;
+               }
+            }
+            kind = wl_proposal_create;
+            return make_operation( kind );
+         case wl_proposal_create:
+         {
+            transfer_operation transfer;
+            transfer.from = random_account();
+            transfer.to = random_account();
+            transfer.amount = asset( 1 + random( 100 ) );
+            proposal_create_operation op;
+            op.fee_paying_account = transfer.from;
+            op.proposed_ops.emplace_back( transfer );
+            op.expiration_time = db.head_block_time() + fc::hours(1);
+            return op;
+         }
+         case wl_vote:
+         {
+            account_update_operation op;
+            op.account = random_account();
+            account_options options = op.account(db).options;
+            options.votes.clear();
+            for( const vote_id_type& vote : witness_votes )
+               if( random( 2 ) )
+                  options.votes.insert( vote );
+            options.num_witness = 0;
+            options.num_committee = 0;
+            op.new_options = options;
+            return op;
+         }
+         case wl_transfer:
+         default:
+         {
+            kind = wl_transfer;
+            transfer_operation op;
+            op.from = random_account();
+            op.to = random_account();
+            op.amount = asset( 1 + random( 100 ) );
+            return op;
+         }
+      }
+   }
+
+   /// pushes one transaction of kind and remembers the orders and proposals it creates
+   void push( workload_kind kind )
+   {
+      trx.operations.push_back( make_operation( kind ) );
+      set_expiration( db, trx );
+      const auto start = workload_clock::now();
+      try
+      {
+         processed_transaction ptx = db.push_transaction( trx, ~0 );
+         operation_stats[kind].record( elapsed_ns( start ) );
+         if( kind == wl_limit_order_create )
+         {
+            const limit_order_id_type id = ptx.operation_results[0].get<object_id_type>();
+            if( db.find( id ) != nullptr )
+               open_orders.push_back( id );
+         }
+         else if( kind == wl_proposal_create )
+            open_proposals.emplace_back( ptx.operation_results[0].get<object_id_type>(),
+                                         trx.operations[0].get<proposal_create_operation>().fee_paying_account );
+      }
+      catch( const fc::exception& e )
+      {
+         operation_stats[kind].fail();
+         dlog( "Workload ${k} failed: ${e}", ("k",workload_kind_names[kind])("e",e.to_string()) );
+      }
+      trx.clear();
+   }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( performance_tests )
+
+// Runs the mix of operations given on the command line, see workload_fixture
+BOOST_FIXTURE_TEST_CASE( workload_benchmark, workload_fixture )
+{ try {
+   wlog( "Benchmark: workload of ${b} blocks of ${s} transactions over ${a} accounts and ${m} markets, seed ${r}",
+         ("b",block_count)("s",block_size)("a",account_count)("m",market_count)("r",seed) );
+   setup_stats.report( "setup" );
+
+   allocation_profiler allocations;
+   if( profile_allocations )
+      allocations.start();
+   for( uint32_t b = 0; b < block_count; ++b )
+   {
+      for( uint32_t t = 0; t < block_size; ++t )
+         push( pick() );
+      const auto start = workload_clock::now();
+      generate_block();
+      block_stats.record( elapsed_ns( start ) );
+   }
+   if( profile_allocations )
+   {
+      allocations.stop();
+      wlog( "Benchmark: allocations by operation type and phase: ${a}",
+            ("a",fc::json::to_pretty_string( allocations.report() )) );
+   }
+
+   size_t operations = 0;
+   int64_t total_ns = block_stats.total_ns();
+   for( uint32_t k = 0; k < wl_kind_count; ++k )
+   {
+      operation_stats[k].report( workload_kind_names[k] );
+      operations += operation_stats[k].count();
+      total_ns += operation_stats[k].total_ns();
+   }
+   block_stats.report( "block production" );
+
+   // every operation is applied when pushed and again when its block is produced
+   const uint32_t interval = db.get_global_properties().parameters.block_interval;
+   const uint64_t per_interval = total_ns > 0 ? uint64_t( operations ) * interval * 1000000000 / total_ns : 0;
+   wlog( "Benchmark: workload sustains ${n} operations per ${i} s block interval, ${h}x the block size of ${s}",
+         ("n",per_interval)("i",interval)("h",double( per_interval ) / block_size)("s",block_size) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <graphene/chain/block_database.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/genesis_state.hpp>
+#include <graphene/egenesis/egenesis.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "../performance/allocation_profile.hpp"
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace graphene::chain;
+using namespace std;
+namespace bpo = boost::program_options;
+
+struct operation_name_visitor
+{
+   typedef string result_type;
+   template<typename T>
+   string operator()( const T& )const
+   {
+      string name = fc::get_typename<T>::name();
+      auto pos = name.rfind( "::" );
+      return pos == string::npos ? name : name.substr( pos + 2 );
+   }
+};
+
+static uint64_t peak_rss_kb()
+{
+#ifndef WIN32
+   struct rusage usage;
+   if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+#ifdef __APPLE__
+      return usage.ru_maxrss / 1024;
+#else
+      return usage.ru_maxrss;
+#endif
+#endif
+   return 0;
+}
+
+static genesis_state_type load_genesis( const bpo::variables_map& options )
+{
+   if( options.count("genesis-json") )
+   {
+      std::string genesis_json;
+      fc::read_file_contents( options["genesis-json"].as<boost::filesystem::path>(), genesis_json );
+      genesis_state_type genesis = fc::json::from_string( genesis_json ).as<genesis_state_type>( 20 );
+      genesis.initial_chain_id = fc::sha256::hash( genesis_json );
+      return genesis;
+   }
+   std::string egenesis_json;
+   graphene::egenesis::compute_egenesis_json( egenesis_json );
+   FC_ASSERT( egenesis_json != "", "No genesis compiled in, use --genesis-json" );
+   genesis_state_type genesis = fc::json::from_string( egenesis_json ).as<genesis_state_type>( 20 );
+   genesis.initial_chain_id = fc::sha256::hash( egenesis_json );
+   return genesis;
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Replays real blocks and reports how fast they are applied");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("mode", bpo::value<string>()->default_value("push"),
+             "push: push the blocks from --blocks-dir one by one into a new database in --work-dir, like a node "
+             "that syncs. reindex: replay all blocks of the node data directory --work-dir, its object database "
+             "is deleted first, so use a copy")
+            ("blocks-dir", bpo::value<boost::filesystem::path>(),
+             "Block database to read from in push mode, the blockchain/database/block_num_to_block directory of a node")
+            ("work-dir", bpo::value<boost::filesystem::path>()->default_value("replay_benchmark_data_dir"),
+             "Directory of the database the blocks are applied to")
+            ("genesis-json", bpo::value<boost::filesystem::path>(), "Genesis of the chain, the built-in one if not given")
+            ("first-block", bpo::value<uint32_t>()->default_value(0),
+             "First block to push, 0 continues after the head block of --work-dir")
+            ("last-block", bpo::value<uint32_t>()->default_value(0), "Last block to push, 0 for the last available")
+            ("skip-signatures", bpo::value<bool>()->default_value(true),
+             "Skip signature checks in push mode, as a replay does")
+            ("time-undo", bpo::value<bool>()->default_value(true), "Measure the time spent saving undo state")
+            ("profile-allocations", bpo::value<bool>()->default_value(false),
+             "Count the heap allocations of applying the blocks by phase and operation type")
+            ("output,o", bpo::value<boost::filesystem::path>(), "Write the results as JSON to this file")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+         bpo::notify( options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "replay_benchmark:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 0;
+      }
+
+      const string mode = options["mode"].as<string>();
+      FC_ASSERT( mode == "push" || mode == "reindex", "Unknown mode ${m}", ("m",mode) );
+      const fc::path work_dir = options["work-dir"].as<boost::filesystem::path>();
+      const genesis_state_type genesis = load_genesis( options );
+
+      graphene::chain::test::allocation_profiler allocations;
+      const bool profile_allocations = options["profile-allocations"].as<bool>();
+      database db;
+      db.enable_operation_timing( true );
+      db.enable_undo_timing( options["time-undo"].as<bool>() );
+
+      uint64_t blocks = 0;
+      uint64_t transactions = 0;
+      uint64_t operations = 0;
+      uint32_t first_block = 0;
+      std::chrono::steady_clock::duration elapsed;
+      // time of pushing every block in push mode, in microseconds
+      vector<int64_t> block_us;
+
+      if( mode == "reindex" )
+      {
+         db.wipe( work_dir / "blockchain", false );
+         const auto start = std::chrono::steady_clock::now();
+         if( profile_allocations )
+            allocations.start();
+         db.open( work_dir / "blockchain", [&genesis]() { return genesis; }, GRAPHENE_CURRENT_DB_VERSION );
+         allocations.stop();
+         elapsed = std::chrono::steady_clock::now() - start;
+         first_block = 1;
+         blocks = db.head_block_num();
+         for( const operation_timing& t : db.get_operation_timing() )
+            operations += t.count;
+      }
+      else
+      {
+         FC_ASSERT( options.count("blocks-dir"), "push mode needs --blocks-dir" );
+         block_database source;
+         source.open( options["blocks-dir"].as<boost::filesystem::path>() );
+         db.open( work_dir / "blockchain", [&genesis]() { return genesis; }, GRAPHENE_CURRENT_DB_VERSION );
+
+         first_block = options["first-block"].as<uint32_t>();
+         if( first_block == 0 )
+            first_block = db.head_block_num() + 1;
+         FC_ASSERT( first_block == db.head_block_num() + 1,
+                    "The database in --work-dir is at block ${h}, it can only continue with block ${n}",
+                    ("h",db.head_block_num())("n",db.head_block_num() + 1) );
+         uint32_t last_block = options["last-block"].as<uint32_t>();
+         if( last_block == 0 )
+         {
+            auto last = source.last_id();
+            FC_ASSERT( last.valid(), "No blocks in --blocks-dir" );
+            last_block = block_header::num_from_id( *last );
+         }
+
+         uint32_t skip = database::skip_witness_schedule_check | database::skip_transaction_dupe_check
+                         | database::skip_tapos_check;
+         if( options["skip-signatures"].as<bool>() )
+            skip |= database::skip_witness_signature | database::skip_transaction_signatures;
+
+         const auto start = std::chrono::steady_clock::now();
+         if( profile_allocations )
+            allocations.start();
+         for( uint32_t num = first_block; num <= last_block; ++num )
+         {
+            optional<signed_block> block = source.fetch_by_number( num );
+            FC_ASSERT( block.valid(), "Block ${n} is missing in --blocks-dir", ("n",num) );
+            const auto block_start = std::chrono::steady_clock::now();
+            db.push_block( *block, skip );
+            block_us.push_back( std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - block_start ).count() );
+            ++blocks;
+            transactions += block->transactions.size();
+            for( const auto& trx : block->transactions )
+               operations += trx.operations.size();
+            if( blocks % 100000 == 0 )
+               std::cerr << "\rblock #" << num;
+         }
+         allocations.stop();
+         elapsed = std::chrono::steady_clock::now() - start;
+         std::cerr << "\n";
+      }
+
+      const double seconds = std::chrono::duration<double>( elapsed ).count();
+      fc::variants by_type;
+      const vector<operation_timing>& timing = db.get_operation_timing();
+      for( size_t tag = 0; tag < timing.size(); ++tag )
+      {
+         if( timing[tag].count == 0 ) continue;
+         operation op;
+         op.set_which( tag );
+         by_type.emplace_back( fc::mutable_variant_object()
+               ( "operation", op.visit( operation_name_visitor() ) )
+               ( "count", timing[tag].count )
+               ( "evaluate_seconds", timing[tag].evaluate_ns / 1e9 )
+               ( "max_evaluate_us", timing[tag].max_evaluate_ns / 1000 )
+               ( "apply_seconds", timing[tag].apply_ns / 1e9 )
+               ( "max_apply_us", timing[tag].max_apply_ns / 1000 )
+               ( "undo_records", timing[tag].undo_records ) );
+      }
+
+      fc::mutable_variant_object result;
+      result( "mode", mode )
+            ( "first_block", first_block )
+            ( "blocks", blocks )
+            ( "operations", operations )
+            ( "seconds", seconds )
+            ( "blocks_per_second", seconds > 0 ? blocks / seconds : 0 )
+            ( "operations_per_second", seconds > 0 ? operations / seconds : 0 )
+            ( "undo_seconds", db.undo_time_ns() / 1e9 )
+            ( "peak_rss_kb", peak_rss_kb() )
+            ( "operations_by_type", by_type );
+      if( mode == "push" )
+      {
+         std::sort( block_us.begin(), block_us.end() );
+         const auto percentile = [&block_us]( size_t p ) {
+            return block_us.empty() ? 0 : block_us[ ( block_us.size() - 1 ) * p / 100 ];
+         };
+         result( "transactions", transactions )
+               ( "block_apply_us", fc::mutable_variant_object()
+                     ( "p50", percentile( 50 ) )( "p99", percentile( 99 ) )( "max", percentile( 100 ) ) );
+      }
+      if( profile_allocations )
+         result( "allocations_by_type", allocations.report() );
+
+      const string json = fc::json::to_pretty_string( result );
+      if( options.count("output") )
+      {
+         fc::ofstream out( options["output"].as<boost::filesystem::path>() );
+         out << json << "\n";
+      }
+      std::cout << json << "\n";
+      db.close();
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+
+"""
+Runs the replay harness, the benchmarks and the API load generator under fixed configurations, appends their results
+to a JSON history with the commit they were measured at, and compares two entries of that history.
+
+  track_performance.py run --build-dir build --history perf_history.json --blocks-dir <dir> --last-block 500000
+  track_performance.py compare --history perf_history.json --threshold 5
+
+The configurations are the built-in ones below unless --config names a JSON file of the same form. Every result
+is a flat object of numbers: metrics whose names contain "per_second" or "per_s" are better when higher, all others
+(seconds, latencies, sizes) when lower. compare exits with status 1 if a metric got worse by more than the
+threshold, so it can gate a CI job.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HISTORY_VERSION = 1
+
+# kind "bench"  : a chain_bench or performance_test case printing JSON lines to the file named by output_option
+# kind "timed"  : any command, only its wall time and peak resident set are recorded
+# kind "replay" : replay_benchmark, only run when --blocks-dir is given
+# kind "api"    : api_load against a running node, only run when --api-server is given
+DEFAULT_CONFIG = {
+    "runs": [
+        {"name": "object_database", "kind": "bench", "binary": "tests/chain_bench", "case": "object_database_bench",
+         "args": ["--db-bench-reps=5"], "output_option": "--db-bench-output="},
+        {"name": "fork_switch", "kind": "bench", "binary": "tests/chain_bench", "case": "fork_switch_bench",
+         "args": ["--fork-bench-depth=4,16", "--fork-bench-txs=50", "--fork-bench-reps=5"],
+         "output_option": "--fork-bench-output="},
+        {"name": "workload", "kind": "timed", "binary": "tests/performance_test",
+         "case": "performance_tests/workload_benchmark",
+         "args": ["--workload-blocks=100", "--workload-block-size=500", "--workload-seed=1"]},
+        {"name": "replay", "kind": "replay", "binary": "tests/replay_benchmark/replay_benchmark", "args": []},
+        {"name": "api_load", "kind": "api", "binary": "programs/api_load/api_load",
+         "args": ["--sessions", "50", "--duration", "60", "--ramp-up", "10", "--calls-per-second", "2"]},
+    ]
+}
+
+def run_measured(command):
+    """ Runs command, returns its standard output, wall seconds and peak resident set in kilobytes """
+    print("+ " + " ".join(command), file=sys.stderr)
+    start = datetime.datetime.now()
+    process = subprocess.Popen(command, stdout=subprocess.PIPE)
+    out = process.stdout.read()
+    peak_rss_kb = 0
+    if hasattr(os, "wait4"):
+        # reaping the child here gives the resource usage of this one child
+        _, status, usage = os.wait4(process.pid, 0)
+        process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        peak_rss_kb = usage.ru_maxrss // 1024 if platform.system() == "Darwin" else usage.ru_maxrss
+    else:
+        process.wait()
+    seconds = (datetime.datetime.now() - start).total_seconds()
+    if process.returncode != 0:
+        raise RuntimeError("%s failed with status %d" % (command[0], process.returncode))
+    return out.decode("utf-8", "replace"), seconds, peak_rss_kb
+
+def numbers_of(obj, prefix=""):
+    """ Flattens the numbers of a JSON object into {"a.b.c": value} """
+    result = {}
+    for key, value in obj.items():
+        name = prefix + key
+        if isinstance(value, bool):
+            continue
+        if isinstance(value, (int, float)):
+            result[name] = value
+        elif isinstance(value, dict):
+            result.update(numbers_of(value, name + "."))
+    return result
+
+def bench_results(run, opts, work_dir):
+    output = os.path.join(work_dir, run["name"] + ".jsonl")
+    command = [os.path.join(opts.build_dir, run["binary"]), "-t", run["case"], "--"] + run["args"] \
+              + [run["output_option"] + output]
+    _, seconds, peak_rss_kb = run_measured(command)
+    results = {"seconds": seconds, "peak_rss_kb": peak_rss_kb}
+    with open(output, "r") as f:
+        for line in f:
+            if not line.strip():
+                continue
+            record = json.loads(line)
+            # the strings and the parameters that are not measurements identify the line
+            identity = [record.get("case", "")] + ["%s=%s" % (k, record[k]) for k in sorted(record)
+                                                    if k not in ("bench", "case") and not is_measurement(k)]
+            key = "/".join(x for x in identity if x)
+            for name, value in numbers_of(record).items():
+                if is_measurement(name):
+                    results[key + ":" + name] = value
+    return results
+
+def is_measurement(name):
+    return any(s in name for s in ("_ns", "_us", "_ms", "per_s", "_kb", "seconds"))
+
+def timed_results(run, opts, work_dir):
+    command = [os.path.join(opts.build_dir, run["binary"]), "-t", run["case"], "--"] + run["args"]
+    _, seconds, peak_rss_kb = run_measured(command)
+    return {"seconds": seconds, "peak_rss_kb": peak_rss_kb}
+
+def replay_results(run, opts, work_dir):
+    output = os.path.join(work_dir, "replay.json")
+    command = [os.path.join(opts.build_dir, run["binary"]), "--blocks-dir", opts.blocks_dir,
+               "--work-dir", os.path.join(work_dir, "replay_data"), "--last-block", str(opts.last_block),
+               "-o", output] + run["args"]
+    run_measured(command)
+    with open(output, "r") as f:
+        replay = json.load(f)
+    return {"blocks": replay["blocks"],
+            "blocks_per_second": replay["blocks_per_second"],
+            "operations_per_second": replay["operations_per_second"],
+            "undo_seconds": replay["undo_seconds"],
+            "peak_rss_kb": replay["peak_rss_kb"],
+            "block_apply_p50_us": replay["block_apply_us"]["p50"],
+            "block_apply_p99_us": replay["block_apply_us"]["p99"],
+            "block_apply_max_us": replay["block_apply_us"]["max"]}
+
+def api_results(run, opts, work_dir):
+    command = [os.path.join(opts.build_dir, run["binary"]), "--server", opts.api_server, "--json"] + run["args"]
+    out, _, _ = run_measured(command)
+    report = json.loads(out)
+    results = {}
+    for call, latencies in report["calls"].items():
+        for metric in ("per_second", "p50_ms", "p99_ms", "errors"):
+            results[call + ":" + metric] = latencies[metric]
+    results["sessions_failed"] = report["sessions_failed"]
+    return results
+
+RUNNERS = {"bench": bench_results, "timed": timed_results, "replay": replay_results, "api": api_results}
+
+def git(*args):
+    try:
+        return subprocess.check_output(["git"] + list(args), stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+def load_history(path):
+    if not os.path.exists(path):
+        return {"version": HISTORY_VERSION, "entries": []}
+    with open(path, "r") as f:
+        history = json.load(f)
+    if history.get("version") != HISTORY_VERSION:
+        raise RuntimeError("%s has history version %s, expected %d" % (path, history.get("version"), HISTORY_VERSION))
+    return history
+
+def run(opts):
+    config = DEFAULT_CONFIG
+    if opts.config:
+        with open(opts.config, "r") as f:
+            config = json.load(f)
+    entry = {"commit": git("rev-parse", "HEAD"),
+             "describe": git("describe", "--always", "--dirty"),
+             "date": datetime.datetime.utcnow().strftime("%Y-%m-%dT%H:%M:%SZ"),
+             "host": platform.node(),
+             "label": opts.label,
+             "results": {}}
+    work_dir = tempfile.mkdtemp(prefix="track_performance_")
+    try:
+        for r in config["runs"]:
+            if opts.only and r["name"] not in opts.only:
+                continue
+            if r["kind"] == "replay" and not opts.blocks_dir:
+                print("skipping %s, no --blocks-dir" % r["name"], file=sys.stderr)
+                continue
+            if r["kind"] == "api" and not opts.api_server:
+                print("skipping %s, no --api-server" % r["name"], file=sys.stderr)
+                continue
+            entry["results"][r["name"]] = RUNNERS[r["kind"]](r, opts, work_dir)
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    history = load_history(opts.history)
+    history["entries"].append(entry)
+    with open(opts.history, "w") as f:
+        json.dump(history, f, indent=2, sort_keys=True)
+        f.write("\n")
+    print("recorded %s as entry %d of %s" % (entry["describe"], len(history["entries"]), opts.history))
+    return 0
+
+def find_entry(entries, ref):
+    """ ref is a negative index into the history or a commit prefix, the last such commit wins """
+    try:
+        return entries[int(ref)]
+    except ValueError:
+        for entry in reversed(entries):
+            if entry["commit"].startswith(ref) or entry["describe"] == ref:
+                return entry
+    raise RuntimeError("no history entry for %s" % ref)
+
+def higher_is_better(metric):
+    return "per_second" in metric or "per_s" in metric
+
+def compare(opts):
+    entries = load_history(opts.history)["entries"]
+    if len(entries) < 2 and (opts.baseline == "-2" or opts.candidate == "-1"):
+        print("need two history entries to compare", file=sys.stderr)
+        return 2
+    baseline = find_entry(entries, opts.baseline)
+    candidate = find_entry(entries, opts.candidate)
+    print("baseline  %s %s" % (baseline["describe"], baseline["date"]))
+    print("candidate %s %s" % (candidate["describe"], candidate["date"]))
+    regressions = 0
+    for name in sorted(candidate["results"]):
+        if name not in baseline["results"]:
+            continue
+        before, after = baseline["results"][name], candidate["results"][name]
+        for metric in sorted(after):
+            if metric not in before or before[metric] == 0:
+                continue
+            change = (after[metric] - before[metric]) * 100.0 / abs(before[metric])
+            worse = -change if higher_is_better(metric) else change
+            flag = ""
+            if worse > opts.threshold:
+                flag = "  REGRESSION"
+                regressions += 1
+            elif worse < -opts.threshold:
+                flag = "  improved"
+            if flag or opts.verbose:
+                print("%-16s %-60s %14.3f -> %14.3f %+7.1f%%%s"
+                      % (name, metric, before[metric], after[metric], change, flag))
+    print("%d regressions beyond %.1f%%" % (regressions, opts.threshold))
+    return 1 if regressions else 0
+
+def main():
+    parser = argparse.ArgumentParser(description="Track replay and benchmark performance across commits")
+    commands = parser.add_subparsers(dest="command")
+
+    run_parser = commands.add_parser("run", help="run the benchmarks and append the results to the history")
+    run_parser.add_argument("--build-dir", default=".", help="CMake build directory (default: .)")
+    run_parser.add_argument("--history", default="perf_history.json", help="history file (default: perf_history.json)")
+    run_parser.add_argument("--config", help="JSON file of runs replacing the built-in configurations")
+    run_parser.add_argument("--label", default="", help="free text stored with the entry")
+    run_parser.add_argument("--only", nargs="*", help="names of the runs to run (default: all)")
+    run_parser.add_argument("--blocks-dir", help="block_num_to_block directory of a node, enables the replay run")
+    run_parser.add_argument("--last-block", type=int, default=0, help="last block to replay (default: all)")
+    run_parser.add_argument("--api-server", help="websocket endpoint of a running node, enables the API load run")
+
+    compare_parser = commands.add_parser("compare", help="compare two entries of the history")
+    compare_parser.add_argument("--history", default="perf_history.json", help="history file (default: perf_history.json)")
+    compare_parser.add_argument("--baseline", default="-2", help="commit prefix or index of the baseline (default: -2)")
+    compare_parser.add_argument("--candidate", default="-1", help="commit prefix or index of the candidate (default: -1)")
+    compare_parser.add_argument("--threshold", type=float, default=5.0, help="percent that counts as a regression")
+    compare_parser.add_argument("-v", "--verbose", action="store_true", help="print unchanged metrics as well")
+
+    opts = parser.parse_args()
+    if opts.command == "run":
+        return run(opts)
+    if opts.command == "compare":
+        return compare(opts)
+    parser.print_help()
+    return 2
+
+if __name__ == "__main__":
+    sys.exit(main())
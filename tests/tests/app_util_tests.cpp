@@ -24,7 +24,20 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api_metrics.hpp>
+#include <graphene/app/batch_api_connection.hpp>
+#include <graphene/app/block_production_telemetry.hpp>
+#include <graphene/app/prometheus_metrics.hpp>
+#include <graphene/app/startup_profile.hpp>
 #include <graphene/app/util.hpp>
+#include <graphene/utilities/allocator_stats.hpp>
+#include <graphene/utilities/task_monitor.hpp>
+#include <graphene/utilities/tempdir.hpp>
+#include <graphene/utilities/thread_affinity.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <thread>
 
 #include "../common/database_fixture.hpp"
 
@@ -277,4 +290,317 @@ BOOST_AUTO_TEST_CASE(price_to_string_verify)
    }
 }
 
+BOOST_AUTO_TEST_CASE(api_metrics_test)
+{
+   BOOST_CHECK_EQUAL( api_metrics::method_name( R"({"id":1,"method":"call","params":[0,"get_objects",[["1.2.0"]]]})" ),
+                      "0.get_objects" );
+   BOOST_CHECK_EQUAL( api_metrics::method_name( R"({"id":2,"method":"call","params":["database","get_ticker",[]]})" ),
+                      "database.get_ticker" );
+   BOOST_CHECK_EQUAL( api_metrics::method_name( R"({"id":3,"method":"get_info","params":[]})" ), "get_info" );
+   BOOST_CHECK_EQUAL( api_metrics::method_name( "not json" ), "unknown" );
+
+   api_metrics metrics;
+   metrics.record( "0.get_objects", fc::microseconds( 500 ), 60, 300, false );
+   metrics.record( "0.get_objects", fc::milliseconds( 50 ), 70, 40, true );
+   metrics.record( "0.get_ticker", fc::seconds( 20 ), 10, 10, false );
+
+   const auto result = metrics.get_metrics();
+   BOOST_REQUIRE_EQUAL( 2u, result.size() );
+   const api_method_metrics& objects = result.at( "0.get_objects" );
+   BOOST_CHECK_EQUAL( 2u, objects.calls );
+   BOOST_CHECK_EQUAL( 1u, objects.errors );
+   BOOST_CHECK_EQUAL( 130u, objects.request_bytes );
+   BOOST_CHECK_EQUAL( 340u, objects.response_bytes );
+   BOOST_CHECK_EQUAL( 50500u, objects.total_microseconds );
+   BOOST_CHECK_EQUAL( 50000u, objects.max_microseconds );
+   BOOST_CHECK_EQUAL( 1u, objects.latency_histogram[0] );
+   BOOST_CHECK_EQUAL( 1u, objects.latency_histogram[2] );
+   BOOST_CHECK_EQUAL( 1u, result.at( "0.get_ticker" ).latency_histogram[5] );
+
+   metrics.reset();
+   BOOST_CHECK( metrics.get_metrics().empty() );
+}
+
+BOOST_AUTO_TEST_CASE(block_production_telemetry_test)
+{
+   block_production_telemetry telemetry;
+   BOOST_CHECK( telemetry.get_recent( 10 ).empty() );
+   for( uint32_t num = 1; num <= block_production_telemetry::max_records + 5; ++num )
+   {
+      block_production_record r;
+      r.block_num = num;
+      r.generate_us = num * 10;
+      telemetry.record( r );
+   }
+   const uint32_t last = block_production_telemetry::max_records + 5;
+   telemetry.set_broadcast_time( last - 1, fc::microseconds( 700 ) );
+   // records that were dropped are not found
+   telemetry.set_broadcast_time( 3, fc::microseconds( 700 ) );
+
+   const auto recent = telemetry.get_recent( 3 );
+   BOOST_REQUIRE_EQUAL( 3u, recent.size() );
+   BOOST_CHECK_EQUAL( last, recent[0].block_num );
+   BOOST_CHECK_EQUAL( -1, recent[0].broadcast_us );
+   BOOST_CHECK_EQUAL( last - 1, recent[1].block_num );
+   BOOST_CHECK_EQUAL( 700, recent[1].broadcast_us );
+   BOOST_CHECK_EQUAL( ( last - 2 ) * 10, recent[2].generate_us );
+
+   const auto all = telemetry.get_recent( last );
+   BOOST_REQUIRE_EQUAL( block_production_telemetry::max_records, all.size() );
+   BOOST_CHECK_EQUAL( 6u, all.back().block_num );
+}
+
+BOOST_AUTO_TEST_CASE(startup_profile_test)
+{
+   startup_profile profile;
+   BOOST_CHECK( profile.get_phases().empty() );
+   const fc::time_point start = fc::time_point::now();
+   profile.record( "object_database", start, fc::microseconds( 200 ) );
+   profile.record( "database::open", start, fc::microseconds( 500 ) );
+   profile.record( "plugin witness startup", start + fc::milliseconds( 10 ), fc::microseconds( 50 ) );
+
+   // phases are returned in the order they were recorded
+   const auto phases = profile.get_phases();
+   BOOST_REQUIRE_EQUAL( 3u, phases.size() );
+   BOOST_CHECK_EQUAL( "object_database", phases[0].name );
+   BOOST_CHECK_EQUAL( 500, phases[1].duration_us );
+   BOOST_CHECK_EQUAL( phases[0].start_ms + 10, phases[2].start_ms );
+
+   // the report lists the slowest first
+   fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = dir.path() / "startup.json";
+   profile.write_report( file );
+   const auto report = fc::json::from_file( file ).as<std::vector<startup_phase>>( 5 );
+   BOOST_REQUIRE_EQUAL( 3u, report.size() );
+   BOOST_CHECK_EQUAL( "database::open", report[0].name );
+   BOOST_CHECK_EQUAL( "object_database", report[1].name );
+   BOOST_CHECK_EQUAL( "plugin witness startup", report[2].name );
+}
+
+BOOST_AUTO_TEST_CASE(prometheus_metrics_test)
+{
+   prometheus_writer out;
+   out.family( "graphene_objects", "gauge", "Objects in each index" );
+   out.sample( "graphene_objects", 3, prometheus_writer::label( "type", "a\"b" ) );
+   out.sample( "graphene_uptime", 1.5 );
+   BOOST_CHECK_EQUAL( out.str(), "# HELP graphene_objects Objects in each index\n"
+                                 "# TYPE graphene_objects gauge\n"
+                                 "graphene_objects{type=\"a\\\"b\"} 3\n"
+                                 "graphene_uptime 1.5\n" );
+
+   // the buckets are cumulative, the last one counts everything
+   block_apply_histogram histogram;
+   histogram.record( fc::microseconds( 500 ) );
+   histogram.record( fc::milliseconds( 20 ) );
+   histogram.record( fc::seconds( 10 ) );
+   prometheus_writer hist;
+   histogram.write( hist, "apply", "Apply time" );
+   const std::string text = hist.str();
+   BOOST_CHECK( text.find( "# TYPE apply histogram\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_bucket{le=\"0.001\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_bucket{le=\"0.025\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_bucket{le=\"2.5\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_bucket{le=\"+Inf\"} 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_sum 10.0205\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "apply_count 3\n" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE(task_monitor_test)
+{
+   using graphene::utilities::task_monitor;
+   task_monitor monitor;
+   {
+      // nothing is recorded until the monitor is enabled
+      task_monitor::scope run( monitor, "disabled" );
+   }
+   BOOST_CHECK( monitor.get_report().sources.empty() );
+
+   monitor.enable( true );
+   for( int i = 0; i < 2; ++i )
+   {
+      task_monitor::scope run( monitor, "slow" );
+      fc::usleep( fc::milliseconds( 5 ) );
+   }
+   {
+      task_monitor::scope run( monitor, "fast" );
+   }
+   {
+      task_monitor::pending_task queued( monitor );
+      BOOST_CHECK_EQUAL( 1u, monitor.get_report().queued );
+      monitor.sample( fc::time_point::now() - fc::milliseconds( 3 ) );
+      queued.start();
+      BOOST_CHECK_EQUAL( 0u, monitor.get_report().queued );
+   }
+   // destroying a task that started does not dequeue it twice
+   BOOST_CHECK_EQUAL( 0u, monitor.get_report().queued );
+
+   auto report = monitor.get_report();
+   BOOST_REQUIRE_EQUAL( 2u, report.sources.size() );
+   BOOST_CHECK_EQUAL( "slow", report.sources[0].description );
+   BOOST_CHECK_EQUAL( 2u, report.sources[0].runs );
+   BOOST_CHECK_GE( report.sources[0].total_us, 10000 );
+   BOOST_REQUIRE_EQUAL( 3u, report.longest_tasks.size() );
+   BOOST_CHECK_EQUAL( "fast", report.longest_tasks.back().description );
+   BOOST_REQUIRE_EQUAL( 1u, report.samples.size() );
+   BOOST_CHECK_EQUAL( 1u, report.samples[0].queued );
+   BOOST_CHECK_GE( report.samples[0].lag_us, 3000 );
+
+   monitor.reset();
+   BOOST_CHECK( monitor.get_report().sources.empty() );
+
+   // tasks posted through monitored_async() are seen by the chain thread monitor
+   task_monitor& chain = task_monitor::chain_thread();
+   chain.enable( true );
+   chain.reset();
+   BOOST_CHECK_EQUAL( 42, graphene::utilities::monitored_async( [](){ return 42; }, "answer" ).wait() );
+   report = chain.get_report();
+   chain.enable( false );
+   BOOST_REQUIRE_EQUAL( 1u, report.sources.size() );
+   BOOST_CHECK_EQUAL( "answer", report.sources[0].description );
+   BOOST_CHECK_EQUAL( 0u, report.queued );
+}
+
+BOOST_AUTO_TEST_CASE(batch_requests_test)
+{
+   std::vector<std::string> dispatched;
+   const auto dispatch = [&dispatched]( const std::string& request ) -> std::string {
+      dispatched.push_back( request );
+      const fc::variant_object call = fc::json::from_string( request ).get_object();
+      if( !call.contains( "id" ) )
+         return std::string();
+      return R"({"id":)" + fc::json::to_string( call["id"] ) + R"(,"result":null})";
+   };
+
+   // single requests are left to the connection
+   BOOST_CHECK( !batch_websocket_api_connection::dispatch_batch( R"({"id":1,"method":"get_info"})", dispatch ).valid() );
+   BOOST_CHECK( dispatched.empty() );
+
+   // responses keep the order of the requests, notifications have none
+   auto reply = batch_websocket_api_connection::dispatch_batch(
+         R"( [{"id":1,"method":"a"},{"method":"b"},{"id":2,"method":"c"}])", dispatch );
+   BOOST_REQUIRE( reply.valid() );
+   BOOST_CHECK_EQUAL( *reply, R"([{"id":1,"result":null},{"id":2,"result":null}])" );
+   BOOST_CHECK_EQUAL( 3u, dispatched.size() );
+
+   reply = batch_websocket_api_connection::dispatch_batch( R"([{"method":"b"}])", dispatch );
+   BOOST_REQUIRE( reply.valid() );
+   BOOST_CHECK( reply->empty() );
+
+   // malformed, empty and oversized batches are answered with one error
+   dispatched.clear();
+   fc::variants too_many( batch_websocket_api_connection::max_batch_size + 1,
+                          fc::mutable_variant_object( "id", 1 )( "method", "a" ) );
+   for( const std::string& batch : { std::string( "[{" ), std::string( "[]" ), fc::json::to_string( too_many ) } )
+   {
+      reply = batch_websocket_api_connection::dispatch_batch( batch, dispatch );
+      BOOST_REQUIRE( reply.valid() );
+      BOOST_CHECK( fc::json::from_string( *reply ).get_object().contains( "error" ) );
+   }
+   BOOST_CHECK( dispatched.empty() );
+}
+
+BOOST_AUTO_TEST_CASE(json_call_test)
+{
+   using graphene::app::json_call_route;
+   std::vector<fc::variants> called;
+   const std::vector<json_call_route> routes{
+      { 0, "database", "get_block", [&called]( const fc::variants& args, uint32_t ) -> std::string {
+         called.push_back( args );
+         FC_ASSERT( args.size() == 1 );
+         return R"({"witness":"1.6.1"})";
+      } } };
+   const auto dispatch = [&routes]( const std::string& message ) {
+      return batch_websocket_api_connection::dispatch_json_call( message, routes, 10 );
+   };
+
+   // the api is chosen by id or by name, the result is inserted as it is
+   auto reply = dispatch( R"({"id":3,"method":"call","params":[0,"get_block",[5]]})" );
+   BOOST_REQUIRE( reply.valid() );
+   BOOST_CHECK_EQUAL( R"({"id":3,"jsonrpc":"2.0","result":{"witness":"1.6.1"}})", *reply );
+   reply = dispatch( R"({"id":4,"method":"call","params":["database","get_block",[5]]})" );
+   BOOST_REQUIRE( reply.valid() );
+   BOOST_CHECK_EQUAL( 2u, called.size() );
+
+   // other methods and apis, notifications and failing calls are left to fc
+   BOOST_CHECK( !dispatch( R"({"id":5,"method":"call","params":[0,"get_objects",[["1.2.0"]]]})" ).valid() );
+   BOOST_CHECK( !dispatch( R"({"id":6,"method":"call","params":[1,"get_block",[5]]})" ).valid() );
+   BOOST_CHECK( !dispatch( R"({"method":"call","params":[0,"get_block",[5]]})" ).valid() );
+   BOOST_CHECK( !dispatch( R"({"id":7,"method":"call","params":[0,"get_block",[]]})" ).valid() );
+   BOOST_CHECK_EQUAL( 3u, called.size() );
+}
+
+BOOST_AUTO_TEST_CASE(notification_batch_test)
+{
+   using graphene::app::notification_batch;
+
+   // only the outermost batch of a thread collects notices
+   BOOST_CHECK( notification_batch::current() == nullptr );
+   {
+      notification_batch outer;
+      BOOST_CHECK( notification_batch::current() == &outer );
+      {
+         notification_batch inner;
+         BOOST_CHECK( notification_batch::current() == &outer );
+      }
+      BOOST_CHECK( notification_batch::current() == &outer );
+   }
+   BOOST_CHECK( notification_batch::current() == nullptr );
+
+   // one notice is sent as before, several as an array
+   const fc::variant first = fc::mutable_variant_object( "method", "notice" )( "params", fc::variants{ 1 } );
+   const fc::variant second = fc::mutable_variant_object( "method", "notice" )( "params", fc::variants{ 2 } );
+   BOOST_CHECK_EQUAL( batch_websocket_api_connection::encode_notices( { first }, 10 ), fc::json::to_string( first ) );
+   const fc::variants sent = fc::json::from_string(
+         batch_websocket_api_connection::encode_notices( { first, second }, 10 ) ).get_array();
+   BOOST_REQUIRE_EQUAL( 2u, sent.size() );
+   BOOST_CHECK_EQUAL( fc::json::to_string( sent[1] ), fc::json::to_string( second ) );
+}
+
+BOOST_AUTO_TEST_CASE(allocator_stats_test)
+{
+   using graphene::utilities::get_allocator_stats;
+
+   auto before = get_allocator_stats();
+   if( before.allocator == "unknown" )
+      return;
+   BOOST_CHECK_GT( before.allocated_bytes, 0u );
+   BOOST_CHECK_GE( before.mapped_bytes, before.allocated_bytes );
+
+   // a live allocation is counted, whichever allocator serves it
+   std::unique_ptr<char[]> block( new char[16 << 20] );
+   std::fill( block.get(), block.get() + ( 16 << 20 ), 1 );
+   auto during = get_allocator_stats();
+   BOOST_CHECK_EQUAL( during.allocator, before.allocator );
+   BOOST_CHECK_GE( during.allocated_bytes, before.allocated_bytes + ( 16 << 20 ) / 2 );
+}
+
+BOOST_AUTO_TEST_CASE(thread_affinity_test)
+{
+   using graphene::utilities::format_cpu_set;
+   using graphene::utilities::get_current_thread_cpus;
+   using graphene::utilities::parse_cpu_order;
+   using graphene::utilities::parse_cpu_set;
+   using graphene::utilities::set_current_thread_cpus;
+
+   BOOST_CHECK( parse_cpu_set( "3, 0-2,8,2" ) == std::vector<uint32_t>( { 0, 1, 2, 3, 8 } ) );
+   BOOST_CHECK( parse_cpu_order( "3, 0-2,8,2" ) == std::vector<uint32_t>( { 3, 0, 1, 2, 8, 2 } ) );
+   BOOST_CHECK_EQUAL( "0-3,8,10-11", format_cpu_set( { 11, 8, 0, 1, 2, 3, 10 } ) );
+   BOOST_CHECK_EQUAL( "", format_cpu_set( {} ) );
+   GRAPHENE_CHECK_THROW( parse_cpu_set( "4-2" ), fc::exception );
+   GRAPHENE_CHECK_THROW( parse_cpu_set( "node:100000" ), fc::exception );
+
+   // a thread restricted to one of its CPUs reports just that one
+   std::vector<uint32_t> allowed = get_current_thread_cpus();
+   if( allowed.empty() )
+      return;
+   std::vector<uint32_t> reported;
+   std::thread pinned( [&allowed,&reported] () {
+      set_current_thread_cpus( { allowed.back() } );
+      reported = get_current_thread_cpus();
+   } );
+   pinned.join();
+   BOOST_CHECK( reported == std::vector<uint32_t>( { allowed.back() } ) );
+   BOOST_CHECK( get_current_thread_cpus() == allowed );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
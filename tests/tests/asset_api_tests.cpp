@@ -61,4 +61,48 @@ BOOST_AUTO_TEST_CASE( asset_holders )
    BOOST_CHECK(holders[3].name == "dan");
 }
 
+BOOST_AUTO_TEST_CASE( asset_holders_ranked )
+{ try {
+   graphene::app::asset_api asset_api(app);
+   const string core = std::string( static_cast<object_id_type>(asset_id_type()) );
+   const int initial_count = asset_api.get_asset_holders_count( core );
+
+   // enough holders for several blocks of the index
+   const size_t count = asset_holder_rank_index::max_block_size * 3;
+   vector<account_id_type> accounts;
+   for( size_t i = 0; i < count; ++i )
+   {
+      const account_object& account = create_account( "holder" + std::to_string(i) );
+      accounts.push_back( account.id );
+      transfer( account_id_type(), account.id, asset( 1000 + i ) );
+   }
+   // an account without balance doesn't count
+   create_account( "noholder" );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core ), initial_count + int(count) );
+
+   // the largest balance first, the committee holds the most
+   const vector<account_asset_balance> all = asset_api.get_asset_holders( core, 0, 100 );
+   BOOST_REQUIRE_EQUAL( all.size(), 100u );
+   BOOST_CHECK( all[0].name == "committee-account" );
+   for( size_t i = 1; i < all.size(); ++i )
+      BOOST_CHECK( all[i].amount <= all[i-1].amount );
+
+   // pages continue each other across blocks
+   const uint32_t start = initial_count + asset_holder_rank_index::max_block_size + 7;
+   const vector<account_asset_balance> page = asset_api.get_asset_holders( core, start, 100 );
+   BOOST_REQUIRE_EQUAL( page.size(), 100u );
+   for( size_t i = 0; i < page.size(); ++i )
+      BOOST_CHECK( page[i].account_id == accounts[ count - 1 - ( start - initial_count ) - i ] );
+   BOOST_CHECK( asset_api.get_asset_holders( core, initial_count + count - 1, 100 ).back().account_id == accounts[0] );
+   BOOST_CHECK( asset_api.get_asset_holders( core, initial_count + count, 100 ).empty() );
+
+   // a changed balance moves the holder, an emptied one leaves
+   transfer( account_id_type(), accounts[0], asset( 100000 ) );
+   BOOST_CHECK( asset_api.get_asset_holders( core, 1, 1 ).front().account_id == accounts[0] );
+   const account_object& last = accounts[1](db);
+   transfer( last, account_id_type()(db), asset( get_balance( last, asset_id_type()(db) ) ) );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core ), initial_count + int(count) - 1 );
+   BOOST_CHECK( asset_api.get_asset_holders( core, initial_count + count - 2, 100 ).back().account_id == accounts[2] );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
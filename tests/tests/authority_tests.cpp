@@ -1751,6 +1751,97 @@ BOOST_AUTO_TEST_CASE( irrelevant_signatures )
    PUSH_TX( db, trx );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( shared_authority_branches )
+{ try {
+   const fc::ecc::private_key dave_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "dave" ) ) );
+   const fc::ecc::private_key eve_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "eve" ) ) );
+   const fc::ecc::private_key owner_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "owner" ) ) );
+   const account_id_type alice( 10 ), bob( 11 ), carol( 12 ), dave( 13 ), eve( 14 );
+
+   // bob and carol both delegate to eve
+   map<account_id_type, authority> active;
+   active[alice] = authority( 2, bob, 1, carol, 1, dave, 1 );
+   active[bob] = authority( 1, eve, 1 );
+   active[carol] = authority( 1, eve, 1 );
+   active[dave] = authority( 1, public_key_type( dave_key.get_public_key() ), 1 );
+   active[eve] = authority( 1, public_key_type( eve_key.get_public_key() ), 1 );
+   const authority owner( 1, public_key_type( owner_key.get_public_key() ), 1 );
+   auto get_active = [&active]( account_id_type id ) -> const authority* { return &active.at( id ); };
+   auto get_owner = [&owner]( account_id_type id ) -> const authority* { return &owner; };
+
+   transfer_operation op;
+   op.from = alice;
+   op.to = dave;
+   const vector<operation> ops{ op };
+
+   flat_set<public_key_type> sigs;
+   sigs.insert( dave_key.get_public_key() );
+   // eve is not approved in the branch of bob, which does not approve carol either
+   GRAPHENE_REQUIRE_THROW( verify_authority( ops, sigs, get_active, get_owner ), tx_missing_active_auth );
+
+   sigs.clear();
+   sigs.insert( eve_key.get_public_key() );
+   verify_authority( ops, sigs, get_active, get_owner );
+
+   // dave is not needed once bob and carol approved
+   sigs.insert( dave_key.get_public_key() );
+   GRAPHENE_REQUIRE_THROW( verify_authority( ops, sigs, get_active, get_owner ), tx_irrelevant_sig );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( address_authority_signatures )
+{ try {
+   const fc::ecc::private_key key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "key" ) ) );
+   const fc::ecc::private_key other = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "other" ) ) );
+   const public_key_type key_pub( key.get_public_key() );
+   const public_key_type other_pub( other.get_public_key() );
+
+   authority active;
+   active.weight_threshold = 1;
+   active.address_auths[ address( pts_address( key_pub, true, 56 ) ) ] = 1;
+   auto get_authority = [&active]( account_id_type id ) -> const authority* { return &active; };
+
+   signed_transaction tx;
+   transfer_operation op;
+   op.from = account_id_type( 10 );
+   op.to = account_id_type( 11 );
+   tx.operations.push_back( op );
+
+   flat_set<public_key_type> available_keys{ key_pub, other_pub };
+   set<public_key_type> required = tx.get_required_signatures( db.get_chain_id(), available_keys,
+                                                               get_authority, get_authority );
+   BOOST_CHECK( required == set<public_key_type>{ key_pub } );
+
+   GRAPHENE_REQUIRE_THROW( verify_authority( tx.operations, { other_pub }, get_authority, get_authority ),
+                           tx_missing_active_auth );
+   verify_authority( tx.operations, { key_pub }, get_authority, get_authority );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( shared_authority_approved_after_failed_walk )
+{ try {
+   const fc::ecc::private_key y_key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "y" ) ) );
+   const account_id_type x( 10 ), y( 11 ), z( 12 );
+
+   // z fails at the recursion limit before y is approved, the owner of x then passes through y
+   map<account_id_type, authority> active;
+   active[x] = authority( 2, z, 1, y, 1 );
+   active[z] = authority( 1, y, 1 );
+   active[y] = authority( 1, public_key_type( y_key.get_public_key() ), 1 );
+   const authority owner = active[x];
+   auto get_active = [&active]( account_id_type id ) -> const authority* { return &active.at( id ); };
+   auto get_owner = [&owner,&active]( account_id_type id ) -> const authority* {
+      return id == account_id_type( 10 ) ? &owner : &active.at( id );
+   };
+
+   transfer_operation op;
+   op.from = x;
+   op.to = y;
+   const vector<operation> ops{ op };
+
+   flat_set<public_key_type> sigs;
+   sigs.insert( y_key.get_public_key() );
+   verify_authority( ops, sigs, get_active, get_owner, 1 );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( self_approving_proposal )
 { try {
    ACTORS( (alice) );
@@ -1782,6 +1873,51 @@ BOOST_AUTO_TEST_CASE( self_approving_proposal )
    db.get<proposal_object>(pid1);
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( proposal_authorized_after_authority_change )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   const fc::ecc::private_key new_key = generate_private_key( "new key" );
+   const public_key_type new_pub( new_key.get_public_key() );
+
+   transfer_operation top;
+   top.from = alice_id;
+   top.to = bob_id;
+   top.amount = asset( 100 );
+   proposal_create_operation pop;
+   pop.proposed_ops.emplace_back( top );
+   pop.fee_paying_account = bob_id;
+   pop.expiration_time = db.head_block_time() + fc::hours(1);
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( pop );
+   const proposal_id_type pid = PUSH_TX( db, trx, ~0 ).operation_results[0].get<object_id_type>();
+   trx.clear();
+
+   // the key is not in the authority of alice yet
+   proposal_update_operation pup;
+   pup.fee_paying_account = bob_id;
+   pup.proposal = pid;
+   pup.key_approvals_to_add.insert( new_pub );
+   trx.operations.push_back( pup );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+   BOOST_CHECK( !pid(db).is_authorized_to_execute( db ) );
+
+   account_update_operation auo;
+   auo.account = alice_id;
+   auo.active = authority( 1, new_pub, 1 );
+   trx.operations.push_back( auo );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+
+   // the approvals did not change, the authority did
+   BOOST_CHECK( pid(db).is_authorized_to_execute( db ) );
+   generate_blocks( pop.expiration_time + fc::minutes(1) );
+   BOOST_CHECK( db.find( pid ) == nullptr );
+   BOOST_CHECK_EQUAL( 100, get_balance( bob_id, asset_id_type() ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( self_deleting_proposal )
 { try {
    ACTORS( (alice) );
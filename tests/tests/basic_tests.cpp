@@ -29,9 +29,13 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/protocol/base58.hpp>
+#include <graphene/chain/protocol/key_string_cache.hpp>
+#include <graphene/chain/protocol/signature_cache.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
+#include <fc/crypto/base58.hpp>
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
 #include "../common/database_fixture.hpp"
@@ -368,6 +372,15 @@ BOOST_AUTO_TEST_CASE( memo_test )
       BOOST_FAIL("Memo format has changed. Notify the web guys and update this test.");
    }
    BOOST_CHECK_EQUAL(m.get_message(receiver, sender.get_public_key()), "Hello, world!");
+
+   // with the shared secret derived by either side
+   BOOST_CHECK_EQUAL(m.get_message(receiver.get_shared_secret(sender.get_public_key())), "Hello, world!");
+   BOOST_CHECK_EQUAL(m.get_message(sender.get_shared_secret(receiver.get_public_key())), "Hello, world!");
+   GRAPHENE_REQUIRE_THROW(m.get_message(fc::sha512()), fc::exception);
+
+   memo_data plain;
+   plain.set_message(fc::ecc::private_key(), receiver.get_public_key(), "Public");
+   BOOST_CHECK_EQUAL(plain.get_message(fc::sha512()), "Public");
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_CASE( exceptions )
@@ -592,6 +605,37 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( merkle_branch )
+{
+   vector<processed_transaction> tx;
+   for( uint32_t i = 0; i < 11; i++ )
+   {
+      tx.emplace_back();
+      tx.back().ref_block_prefix = i;
+   }
+
+   for( uint32_t count = 1; count <= tx.size(); ++count )
+   {
+      signed_block block;
+      block.transactions.assign( tx.begin(), tx.begin() + count );
+      const checksum_type root = block.calculate_merkle_root();
+      const merkle_tree_levels tree = block.calculate_merkle_tree();
+      BOOST_CHECK( checksum_type::hash( tree.back().front() ) == root );
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         const vector<digest_type> branch = graphene::chain::merkle_branch( tree, i );
+         BOOST_CHECK( merkle_root_from_branch( tx[i].merkle_digest(), i, count, branch ) == root );
+         // the branch does not prove another transaction or position
+         if( count > 1 )
+         {
+            BOOST_CHECK( merkle_root_from_branch( tx[(i + 1) % count].merkle_digest(), i, count, branch ) != root );
+            GRAPHENE_CHECK_THROW( graphene::chain::merkle_branch( tree, count ), fc::exception );
+         }
+      }
+   }
+   GRAPHENE_CHECK_THROW( graphene::chain::merkle_branch( signed_block().calculate_merkle_tree(), 0 ), fc::exception );
+}
+
 /**
  * Reproduces https://github.com/bitshares/bitshares-core/issues/888 and tests fix for it.
  */
@@ -607,4 +651,135 @@ BOOST_AUTO_TEST_CASE( bitasset_feed_expiration_test )
    BOOST_CHECK( !o.feed_is_expired( now ) );
 }
 
+BOOST_AUTO_TEST_CASE( signature_cache_test )
+{ try {
+   const fc::ecc::private_key key1 = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "key1" ) ) );
+   const fc::ecc::private_key key2 = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "key2" ) ) );
+   const digest_type d1 = fc::sha256::hash( string( "digest1" ) );
+   const digest_type d2 = fc::sha256::hash( string( "digest2" ) );
+   const signature_type s1 = key1.sign_compact( d1 );
+   const signature_type s2 = key2.sign_compact( d2 );
+
+   signature_cache cache( 1 );
+   BOOST_CHECK( cache.recover( d1, s1 ) == public_key_type( key1.get_public_key() ) );
+   BOOST_CHECK( cache.recover( d1, s1 ) == public_key_type( key1.get_public_key() ) );
+   // evicts the first signature
+   BOOST_CHECK( cache.recover( d2, s2 ) == public_key_type( key2.get_public_key() ) );
+   BOOST_CHECK( cache.recover( d1, s1 ) == public_key_type( key1.get_public_key() ) );
+
+   signature_cache_stats stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( 1u, stats.hits );
+   BOOST_CHECK_EQUAL( 3u, stats.misses );
+   BOOST_CHECK_EQUAL( 1u, stats.size );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( 0u, cache.get_stats().size );
+   BOOST_CHECK( cache.recover( d1, s1 ) == public_key_type( key1.get_public_key() ) );
+   BOOST_CHECK_EQUAL( 0u, cache.get_stats().size );
+
+   // a copy of a transaction finds the keys recovered for the original
+   signed_transaction tx;
+   transfer_operation op;
+   op.from = account_id_type(1);
+   op.to = account_id_type(2);
+   op.amount = asset(1);
+   tx.operations.push_back( op );
+   tx.set_expiration( db.head_block_time() + fc::minutes(1) );
+   tx.sign( key1, db.get_chain_id() );
+   tx.sign( key2, db.get_chain_id() );
+   BOOST_CHECK_EQUAL( 2u, tx.get_signature_keys( db.get_chain_id() ).size() );
+   const uint64_t hits = signature_cache::instance().get_stats().hits;
+   precomputable_transaction copy( tx );
+   BOOST_CHECK( copy.get_signature_keys( db.get_chain_id() ) == tx.get_signature_keys( db.get_chain_id() ) );
+   BOOST_CHECK_EQUAL( hits + 4, signature_cache::instance().get_stats().hits );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( base58_matches_fc )
+{ try {
+   std::mt19937 rng( 7 );
+   for( size_t size : { 0, 1, 4, 5, 24, 37, 64, 100 } )
+      for( int zeros = 0; zeros < 3; ++zeros )
+      {
+         std::vector<char> data( size );
+         for( char& c : data )
+            c = char( rng() );
+         for( int i = 0; i < zeros && i < int(size); ++i )
+            data[i] = 0;
+         const std::string encoded = to_base58( data.data(), data.size() );
+         BOOST_CHECK_EQUAL( fc::to_base58( data.data(), data.size() ), encoded );
+         BOOST_CHECK( from_base58( encoded ) == data );
+         BOOST_CHECK( fc::from_base58( encoded ) == data );
+      }
+
+   // whitespace around the digits is skipped, anything else is rejected
+   BOOST_CHECK( from_base58( "  2NEpo7TZRRrLZSi2U \n" ) == fc::from_base58( "2NEpo7TZRRrLZSi2U" ) );
+   GRAPHENE_CHECK_THROW( from_base58( "2NEpo7TZ RRrLZSi2U" ), fc::parse_error_exception );
+   GRAPHENE_CHECK_THROW( from_base58( "0OIl" ), fc::parse_error_exception );
+   BOOST_CHECK( from_base58( "" ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( key_string_cache_test )
+{ try {
+   const public_key_type key( fc::ecc::private_key::regenerate( fc::sha256::hash( string( "key1" ) ) ).get_public_key() );
+   const std::string str( key );
+   BOOST_CHECK( public_key_type( str ) == key );
+   BOOST_CHECK_EQUAL( std::string( address( key ) ), std::string( address( std::string( address( key ) ) ) ) );
+
+   key_string_cache cache( 1 );
+   int conversions = 0;
+   const auto encode = [&conversions]() -> std::string { ++conversions; return "string"; };
+   BOOST_CHECK_EQUAL( "string", cache.key_to_string( key.key_data, encode ) );
+   BOOST_CHECK_EQUAL( "string", cache.key_to_string( key.key_data, encode ) );
+   BOOST_CHECK_EQUAL( 1, conversions );
+
+   // a failed conversion is not cached
+   const auto fail = []() -> fc::ecc::public_key_data { FC_THROW( "invalid" ); };
+   GRAPHENE_CHECK_THROW( cache.key_from_string( "invalid", fail ), fc::exception );
+   GRAPHENE_CHECK_THROW( cache.key_from_string( "invalid", fail ), fc::exception );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( "string", cache.key_to_string( key.key_data, encode ) );
+   BOOST_CHECK_EQUAL( 2, conversions );
+
+   // a damaged checksum still throws through the global cache
+   std::string damaged = str;
+   damaged.back() = damaged.back() == 'a' ? 'b' : 'a';
+   GRAPHENE_CHECK_THROW( public_key_type( damaged ), fc::exception );
+   BOOST_CHECK( public_key_type( str ) == key );
+} FC_LOG_AND_RETHROW() }
+
+namespace {
+   struct operation_tag_visitor
+   {
+      typedef int64_t result_type;
+      template<typename Op>
+      int64_t operator()( const Op& )const { return operation::tag<Op>::value; }
+   };
+   struct fee_setter
+   {
+      typedef void result_type;
+      asset fee;
+      template<typename Op>
+      void operator()( Op& op )const { op.fee = fee; }
+   };
+}
+
+BOOST_AUTO_TEST_CASE( table_visit_test )
+{ try {
+   operation op;
+   for( int64_t i = 0; i < operation::count(); ++i )
+   {
+      op.set_which( i );
+      BOOST_CHECK_EQUAL( i, table_visit( op, operation_tag_visitor() ) );
+      BOOST_CHECK_EQUAL( op.visit( operation_tag_visitor() ), table_visit( op, operation_tag_visitor() ) );
+      const operation& const_op = op;
+      BOOST_CHECK_EQUAL( i, table_visit( const_op, operation_tag_visitor() ) );
+   }
+
+   // visitors can modify the value
+   op = transfer_operation();
+   table_visit( op, fee_setter{ asset( 7 ) } );
+   BOOST_CHECK( op.get<transfer_operation>().fee == asset( 7 ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef WIN32
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/block_stream/block_stream_plugin.hpp>
+#include <graphene/block_stream/messages.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using namespace graphene::block_stream;
+
+namespace {
+
+/** A consumer of the block stream */
+class stream_test_client
+{
+   public:
+      explicit stream_test_client( const fc::path& socket_path )
+      {
+         _fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+         FC_ASSERT( _fd >= 0 );
+         sockaddr_un addr = {};
+         addr.sun_family = AF_UNIX;
+         std::strncpy( addr.sun_path, socket_path.generic_string().c_str(), sizeof(addr.sun_path) - 1 );
+         FC_ASSERT( ::connect( _fd, (const sockaddr*)&addr, sizeof(addr) ) == 0, "Unable to connect" );
+      }
+      ~stream_test_client() { ::close( _fd ); }
+
+      void send( const stream_message& msg )
+      {
+         const vector<char> frame = pack_stream_frame( msg );
+         FC_ASSERT( ::send( _fd, frame.data(), frame.size(), MSG_NOSIGNAL ) == ssize_t( frame.size() ) );
+      }
+
+      stream_message next()
+      {
+         for( ;; )
+         {
+            stream_message msg;
+            const size_t size = unpack_stream_frame( _in.data(), _in.size(), msg );
+            if( size > 0 )
+            {
+               _in.erase( _in.begin(), _in.begin() + size );
+               if( msg.which() == stream_message::tag<undo_blocks_message>::value )
+                  undone.push_back( msg.get<undo_blocks_message>().block_num );
+               if( msg.which() == stream_message::tag<irreversible_message>::value )
+                  irreversible = msg.get<irreversible_message>().block_num;
+               return msg;
+            }
+            pollfd fd = { _fd, POLLIN, 0 };
+            FC_ASSERT( ::poll( &fd, 1, 5000 ) == 1, "No message from the block stream" );
+            char buffer[4096];
+            const ssize_t n = ::read( _fd, buffer, sizeof(buffer) );
+            FC_ASSERT( n > 0, "The block stream was closed" );
+            _in.insert( _in.end(), buffer, buffer + n );
+         }
+      }
+
+      /** @return the next applied block, skipping the undo and irreversible messages before it */
+      applied_block_message next_block()
+      {
+         for( ;; )
+         {
+            const stream_message msg = next();
+            if( msg.which() == stream_message::tag<applied_block_message>::value )
+               return msg.get<applied_block_message>();
+         }
+      }
+
+      /// the blocks undone and the last irreversible block, from the messages read so far
+      vector<uint32_t> undone;
+      uint32_t         irreversible = 0;
+
+   private:
+      int          _fd = -1;
+      vector<char> _in;
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( block_stream_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( block_stream )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset(1000) );
+   generate_block();
+   const uint32_t transfer_block = db.head_block_num();
+   const fc::path socket = app.get_plugin<block_stream_plugin>("block_stream")->socket_path();
+
+   {
+      // the blocks streamed before the consumer connected are replayed from the log
+      stream_test_client client( socket );
+      client.send( subscribe_message{ "indexer", 1 } );
+      for( uint32_t block_num = 1; block_num < transfer_block; ++block_num )
+         BOOST_REQUIRE_EQUAL( client.next_block().block_num, block_num );
+
+      const applied_block_message block = client.next_block();
+      BOOST_REQUIRE_EQUAL( block.block_num, transfer_block );
+      BOOST_CHECK( block.block_id == db.head_block_id() );
+      BOOST_REQUIRE_EQUAL( block.operations.size(), block.impacted_accounts.size() );
+      bool found = false;
+      for( size_t i = 0; i < block.operations.size(); ++i )
+         if( block.operations[i].op.which() == operation::tag<transfer_operation>::value )
+         {
+            found = true;
+            BOOST_CHECK( block.operations[i].op.get<transfer_operation>().amount == asset(1000) );
+            BOOST_CHECK( block.impacted_accounts[i].count( alice_id ) );
+         }
+      BOOST_CHECK( found );
+      found = false;
+      for( const object_delta& delta : block.deltas )
+         if( delta.id == dynamic_global_property_id_type() )
+         {
+            found = true;
+            const auto dgpo = fc::raw::unpack<dynamic_global_property_object>( delta.value );
+            BOOST_CHECK_EQUAL( dgpo.head_block_number, transfer_block );
+         }
+      BOOST_CHECK( found );
+      BOOST_CHECK( client.undone.empty() );
+      client.send( ack_message{ transfer_block } );
+   }
+
+   // a fork replaces the next block
+   generate_block();
+   const uint32_t forked_block = db.head_block_num();
+   const block_id_type forked_id = db.head_block_id();
+   db.pop_block();
+   transfer( committee_account, alice_id, asset(5) );
+   generate_block();
+   BOOST_REQUIRE( db.head_block_id() != forked_id );
+   fc::usleep( fc::milliseconds(500) );
+
+   {
+      // the consumer resumes after the block it acknowledged
+      stream_test_client client( socket );
+      client.send( subscribe_message{ "indexer", 0 } );
+      applied_block_message block = client.next_block();
+      BOOST_CHECK_EQUAL( block.block_num, transfer_block + 1 );
+      BOOST_CHECK( block.block_id == forked_id );
+      BOOST_CHECK( client.undone.empty() );
+      block = client.next_block();
+      BOOST_REQUIRE_EQUAL( client.undone.size(), 1u );
+      BOOST_CHECK_EQUAL( client.undone[0], forked_block );
+      BOOST_CHECK_EQUAL( block.block_num, forked_block );
+      BOOST_CHECK( block.block_id == db.head_block_id() );
+
+      // new blocks are streamed as they are applied, with the blocks becoming irreversible
+      while( db.get_dynamic_global_properties().last_irreversible_block_num < forked_block )
+         generate_block();
+      while( client.irreversible < forked_block )
+         client.next();
+      BOOST_CHECK_LE( client.irreversible, db.get_dynamic_global_properties().last_irreversible_block_num );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
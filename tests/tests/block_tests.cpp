@@ -39,6 +39,11 @@
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/fstream.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
 
 #include "../common/database_fixture.hpp"
 
@@ -129,6 +134,522 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_concurrent_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      const uint32_t block_count = 200;
+      vector<block_id_type> ids;
+      clearable_block b;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+
+      std::atomic<uint32_t> failures( 0 );
+      vector<std::thread> readers;
+      for( uint32_t t = 0; t < 4; ++t )
+         readers.emplace_back( [&bdb,&ids,&failures,t,block_count]() {
+            for( uint32_t round = 0; round < 5; ++round )
+               for( uint32_t i = 1 + t; i <= block_count; i += 4 )
+               {
+                  auto blk = bdb.fetch_by_number( i );
+                  if( !blk.valid() || blk->witness != witness_id_type(i) ) ++failures;
+                  if( !bdb.contains( ids[i-1] ) || !bdb.fetch_optional( ids[i-1] ).valid() ) ++failures;
+               }
+         });
+      // writes keep going while the readers run, and become visible to new lookups
+      for( uint32_t i = 0; i < 20; ++i )
+      {
+         b.previous = b.id();
+         b.witness = witness_id_type(block_count+i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         FC_ASSERT( bdb.fetch_by_number( b.block_num() ).valid() );
+      }
+      for( auto& reader : readers )
+         reader.join();
+      BOOST_CHECK_EQUAL( 0u, failures.load() );
+
+      bdb.remove( b.id() );
+      FC_ASSERT( !bdb.contains( b.id() ) );
+      FC_ASSERT( !bdb.fetch_optional( b.id() ).valid() );
+      FC_ASSERT( !bdb.fetch_by_number( block_count + 20 ).valid() );
+      FC_ASSERT( bdb.fetch_by_number( block_count + 19 ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( segmented_block_database_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      {
+         block_database bdb;
+         bdb.open( data_dir.path() );
+         BOOST_CHECK( !bdb.is_segmented() );
+         clearable_block b;
+         for( uint32_t i = 0; i < 50; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         bdb.remove( ids.back() );
+         ids.pop_back();
+         bdb.close();
+      }
+      BOOST_CHECK( block_database::has_legacy_format( data_dir.path() ) );
+
+      block_database::convert_to_segmented( data_dir.path() );
+      BOOST_CHECK( !block_database::has_legacy_format( data_dir.path() ) );
+      BOOST_CHECK( fc::exists( data_dir.path() / "blocks.000000" ) );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      BOOST_REQUIRE( bdb.is_segmented() );
+      for( uint32_t i = 0; i < ids.size(); ++i )
+      {
+         auto blk = bdb.fetch_by_number( i+1 );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->id() == ids[i] );
+         BOOST_CHECK( bdb.contains( ids[i] ) );
+      }
+      BOOST_CHECK( !bdb.fetch_by_number( ids.size() + 1 ).valid() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids.back() );
+
+      // appending continues in the segmented format
+      clearable_block b;
+      b.previous = ids.back();
+      b.witness = witness_id_type(100);
+      b.clear();
+      bdb.store( b.id(), b );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.is_segmented() );
+      BOOST_REQUIRE( bdb.fetch_optional( b.id() ).valid() );
+      BOOST_CHECK( bdb.fetch_optional( b.id() )->witness == witness_id_type(100) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( read_only_block_database_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database writer;
+      writer.open( data_dir.path(), true, 1024 );
+      vector<block_id_type> ids;
+      clearable_block b;
+      uint64_t produced = 0;
+      auto append = [&]( uint32_t count ) {
+         for( uint32_t i = 0; i < count; ++i )
+         {
+            if( !ids.empty() ) b.previous = ids.back();
+            b.witness = witness_id_type( ++produced );
+            b.clear();
+            writer.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+      };
+      append( 10 );
+
+      block_database reader;
+      reader.open_read_only( data_dir.path() );
+      BOOST_CHECK( reader.is_open() );
+      BOOST_CHECK( reader.is_read_only() );
+      BOOST_REQUIRE( reader.last_id().valid() );
+      BOOST_CHECK( *reader.last_id() == ids.back() );
+      BOOST_CHECK( !reader.refresh() );
+
+      // blocks the writer appends, across new segments, show up after a refresh
+      append( 40 );
+      BOOST_CHECK( !reader.fetch_by_number( 11 ).valid() );
+      BOOST_CHECK( reader.refresh() );
+      for( uint32_t i = 0; i < ids.size(); ++i )
+      {
+         auto blk = reader.fetch_by_number( i + 1 );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->id() == ids[i] );
+      }
+      BOOST_CHECK( *reader.last_id() == ids.back() );
+
+      // a fork replaces the last block
+      writer.remove( ids.back() );
+      ids.pop_back();
+      append( 1 );
+      reader.refresh();
+      BOOST_CHECK( reader.fetch_block_id( ids.size() ) == ids.back() );
+
+      GRAPHENE_REQUIRE_THROW( reader.store( b.id(), b ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( reader.remove( ids.back() ), fc::exception );
+      reader.close();
+      BOOST_CHECK( !reader.is_open() );
+      writer.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( import_block_database_test )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory local_dir( graphene::utilities::temp_directory_path() );
+
+      block_database source;
+      source.open( source_dir.path(), true, 1024 );
+      block_database local;
+      local.open( local_dir.path() );
+      vector<block_id_type> ids;
+      clearable_block b;
+      for( uint32_t i = 0; i < 30; ++i )
+      {
+         if( !ids.empty() ) b.previous = ids.back();
+         b.witness = witness_id_type( i + 1 );
+         // block 26 claims transactions it does not have
+         if( i == 25 ) b.transaction_merkle_root = checksum_type::hash( std::string( "missing" ) );
+         b.clear();
+         source.store( b.id(), b );
+         if( i < 5 )
+            local.store( b.id(), b );
+         ids.push_back( b.id() );
+         b.transaction_merkle_root = checksum_type();
+      }
+      source.flush();
+
+      // the blocks after the local ones are appended up to the first one failing a check
+      BOOST_CHECK_EQUAL( local.import_from( source, 4 ), 25u );
+      for( uint32_t i = 0; i < 25; ++i )
+         BOOST_CHECK( local.fetch_block_id( i + 1 ) == ids[i] );
+      BOOST_CHECK( !local.fetch_by_number( 26 ).valid() );
+      BOOST_CHECK( *local.last_id() == ids[24] );
+
+      // nothing new to import
+      BOOST_CHECK_EQUAL( local.import_from( source ), 25u );
+      local.close();
+      source.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pruned_block_database_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      block_database bdb;
+      bdb.open( data_dir.path(), true, 1024 );
+      clearable_block b;
+      for( uint32_t i = 0; i < 200; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_REQUIRE( fc::exists( data_dir.path() / "blocks.000002" ) );
+      BOOST_CHECK_EQUAL( 1u, bdb.first_block_num() );
+      BOOST_CHECK( !block_database::is_pruned( data_dir.path() ) );
+
+      BOOST_CHECK( bdb.prune( 150, true ) );
+      BOOST_CHECK( bdb.fetch_by_number( 1 ).valid() );
+      BOOST_CHECK( bdb.prune( 150 ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "blocks.000000" ) );
+      BOOST_CHECK_EQUAL( 150u, bdb.first_block_num() );
+      BOOST_CHECK( !bdb.prune( 150 ) );
+
+      BOOST_CHECK( !bdb.fetch_by_number( 1 ).valid() );
+      BOOST_CHECK( !bdb.contains( ids[0] ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 149 ).valid() );
+      for( uint32_t num = 150; num <= 200; ++num )
+         BOOST_CHECK( bdb.fetch_by_number( num ).valid() );
+
+      // pruning survives a restart and appending continues
+      bdb.close();
+      BOOST_CHECK( block_database::is_pruned( data_dir.path() ) );
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 150u, bdb.first_block_num() );
+      BOOST_CHECK( !bdb.fetch_optional( ids[10] ).valid() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids.back() );
+      b.previous = b.id();
+      b.witness = witness_id_type(201);
+      b.clear();
+      bdb.store( b.id(), b );
+      BOOST_CHECK( bdb.fetch_by_number( 201 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 150 ).valid() );
+
+      GRAPHENE_REQUIRE_THROW( []() {
+         fc::temp_directory legacy_dir( graphene::utilities::temp_directory_path() );
+         block_database legacy;
+         legacy.open( legacy_dir.path() );
+         legacy.prune( 10 );
+      }(), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_write_behind_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      block_database bdb;
+      bdb.open( data_dir.path(), true );
+      bdb.enable_write_behind();
+      BOOST_CHECK( bdb.write_behind_enabled() );
+      clearable_block b;
+      for( uint32_t i = 0; i < 500; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         // queued or written, a stored block is always visible
+         BOOST_REQUIRE( bdb.contains( b.id() ) );
+         BOOST_REQUIRE( bdb.fetch_by_number( i+1 ).valid() );
+      }
+      bdb.wait_for_writes( 250 );
+      BOOST_CHECK( bdb.total_block_size() > 0 );
+
+      bdb.remove( ids.back() );
+      BOOST_CHECK( !bdb.contains( ids.back() ) );
+      BOOST_CHECK( !bdb.fetch_optional( ids.back() ).valid() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids[498] );
+
+      // close drains the queue, everything is on disk afterwards
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( !bdb.write_behind_enabled() );
+      for( uint32_t num = 1; num < 500; ++num )
+         BOOST_CHECK( bdb.fetch_block_id( num ) == ids[num-1] );
+      BOOST_CHECK( !bdb.contains( ids.back() ) );
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_raw_range_test )
+{
+   try {
+      for( bool segmented : { false, true } )
+      {
+         fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+         vector<signed_block> blocks;
+         block_database bdb;
+         bdb.open( data_dir.path(), segmented );
+         clearable_block b;
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            bdb.store( b.id(), b );
+            blocks.push_back( b );
+         }
+
+         auto raw = bdb.fetch_raw_range( 3, 5 );
+         BOOST_REQUIRE_EQUAL( 5u, raw.size() );
+         for( uint32_t i = 0; i < raw.size(); ++i )
+            BOOST_CHECK( raw[i] == fc::raw::pack( blocks[i+2] ) );
+         // the range ends at the last stored block
+         BOOST_CHECK_EQUAL( 2u, bdb.fetch_raw_range( 9, 100 ).size() );
+         BOOST_CHECK( bdb.fetch_raw_range( 11, 10 ).empty() );
+
+         BOOST_REQUIRE( bdb.fetch_raw( blocks[4].id() ).valid() );
+         BOOST_CHECK( *bdb.fetch_raw( blocks[4].id() ) == fc::raw::pack( blocks[4] ) );
+         BOOST_CHECK( bdb.fetch_raw( blocks[4].previous ).valid() );
+         block_id_type other = blocks[4].id();
+         other._hash[4] ^= 1;
+         BOOST_CHECK( !bdb.fetch_raw( other ).valid() );
+         bdb.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( packed_block_test )
+{
+   try {
+      for( bool segmented : { false, true } )
+      {
+         fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+         block_database bdb;
+         bdb.open( data_dir.path(), segmented );
+         clearable_block b;
+         b.witness = witness_id_type(3);
+         processed_transaction trx;
+         transfer_operation op;
+         op.from = account_id_type(1);
+         op.to = account_id_type(2);
+         op.amount = asset(100);
+         trx.operations.push_back( op );
+         trx.operation_results.push_back( void_result() );
+         b.transactions.push_back( trx );
+         b.clear();
+         bdb.store( b.id(), b );
+
+         auto packed = bdb.fetch_packed_by_number( 1 );
+         BOOST_REQUIRE( packed.valid() );
+         BOOST_CHECK( packed->id() == b.id() );
+         BOOST_CHECK( packed->header().witness == witness_id_type(3) );
+         BOOST_CHECK_EQUAL( fc::raw::pack_size( signed_block_header( b ) ), packed->transactions_offset() );
+         BOOST_REQUIRE_EQUAL( 1u, packed->transactions().size() );
+         BOOST_CHECK( packed->transactions()[0].id() == trx.id() );
+         BOOST_CHECK( fc::raw::pack( packed->unpack() ) == fc::raw::pack( b ) );
+         BOOST_CHECK( !bdb.fetch_packed_by_number( 2 ).valid() );
+
+         // a packed block built in memory looks the same
+         packed_block from_block( b );
+         BOOST_CHECK( from_block.data() == packed->data() );
+         BOOST_CHECK_EQUAL( packed->transactions_offset(), from_block.transactions_offset() );
+         bdb.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_verify_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      uint64_t damaged_pos = 0;
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      clearable_block b;
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         if( i < 69 )
+            damaged_pos += fc::raw::pack_size( signed_block( b ) );
+      }
+      BOOST_CHECK_EQUAL( 100u, bdb.verify_and_repair( 1, 4 ) );
+
+      // an empty entry in the middle
+      bdb.remove( ids[79] );
+      BOOST_CHECK_EQUAL( 79u, bdb.verify_and_repair( 1, 4 ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 81 ).valid() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids[78] );
+      bdb.close();
+
+      // a block that does not match its id
+      {
+         std::fstream blocks( ( data_dir.path() / "blocks" ).generic_string().c_str(),
+                              std::fstream::binary | std::fstream::in | std::fstream::out );
+         blocks.seekp( damaged_pos );
+         blocks.put( 'x' );
+      }
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 69u, bdb.verify_and_repair( 1, 3 ) );
+      BOOST_CHECK( bdb.fetch_by_number( 69 ).valid() );
+      BOOST_CHECK( !bdb.fetch_by_number( 70 ).valid() );
+      BOOST_CHECK( *bdb.last_id() == ids[68] );
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_cache_test )
+{
+   try {
+      block_cache cache( 3 );
+      vector<block_id_type> ids;
+      clearable_block b;
+      for( uint32_t i = 0; i < 4; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         cache.insert( b );
+         ids.push_back( b.id() );
+      }
+      // the oldest block was evicted
+      BOOST_CHECK( !cache.find( 1 ) );
+      BOOST_REQUIRE( cache.find( 2 ) );
+      BOOST_CHECK( cache.find( 2 )->witness == witness_id_type(2) );
+      BOOST_CHECK( cache.find( ids[3] ) );
+
+      // block 2 is now the most recently used, so block 3 goes next
+      cache.find( 2 );
+      b.previous = b.id();
+      b.witness = witness_id_type(5);
+      b.clear();
+      cache.insert( b );
+      BOOST_CHECK( cache.find( 2 ) );
+      BOOST_CHECK( !cache.find( 3 ) );
+
+      // a different block at a cached number is not returned by id
+      clearable_block other;
+      other.previous = ids[2];
+      other.witness = witness_id_type(42);
+      other.clear();
+      BOOST_CHECK( !cache.find( other.id() ) );
+
+      cache.remove( 4 );
+      BOOST_CHECK( !cache.find( ids[3] ) );
+
+      const block_cache_stats stats = cache.get_stats();
+      BOOST_CHECK_EQUAL( 2u, stats.size );
+      BOOST_CHECK_EQUAL( 3u, stats.capacity );
+      BOOST_CHECK_EQUAL( 5u, stats.hits );
+      BOOST_CHECK_EQUAL( 4u, stats.misses );
+
+      cache.set_capacity( 0 );
+      BOOST_CHECK_EQUAL( 0u, cache.get_stats().size );
+      cache.insert( b );
+      BOOST_CHECK( !cache.find( b.block_num() ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -493,11 +1014,11 @@ BOOST_AUTO_TEST_CASE( fork_db_tests )
         prev = b;
      }
      auto head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 1799 );
+     FC_ASSERT( head && head->data->block_num() == 1799 );
 
      fdb.push_block(skipped_block);
      head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 2001, "", ("head",head->data.block_num()) );
+     FC_ASSERT( head && head->data->block_num() == 2001, "", ("head",head->data->block_num()) );
   } FC_LOG_AND_RETHROW() 
 }
 BOOST_AUTO_TEST_CASE( out_of_order_blocks )
@@ -554,6 +1075,360 @@ BOOST_AUTO_TEST_CASE( out_of_order_blocks )
 }
  */
 
+BOOST_AUTO_TEST_CASE( fork_db_survives_restart )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      block_id_type head_id;
+      signed_block fork_block;
+      {
+         database db1;
+         db1.open(data_dir1.path(), make_genesis, "TEST");
+         database db2;
+         db2.open(data_dir2.path(), make_genesis, "TEST");
+
+         for( uint32_t i = 1; i <= 5; ++i )
+         {
+            auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+            PUSH_BLOCK( db2, b );
+         }
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         // a competing block at the same height, db1 keeps its head
+         fork_block = db2.generate_block(db2.get_slot_time(2), db2.get_scheduled_witness(2), init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, fork_block );
+         head_id = db1.head_block_id();
+         BOOST_CHECK( head_id != fork_block.id() );
+         BOOST_CHECK( db1.fetch_block_by_id( fork_block.id() ).valid() );
+         db1.close();
+      }
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis, "TEST");
+      BOOST_CHECK( db1.head_block_id() == head_id );
+      BOOST_CHECK( db1.is_known_block( fork_block.id() ) );
+      BOOST_REQUIRE( db1.fetch_block_by_id( fork_block.id() ).valid() );
+
+      // production continues on the chain that was head before the restart
+      auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      BOOST_CHECK( b.previous == head_id );
+      BOOST_CHECK( !fc::exists( data_dir1.path() / "database" / "fork_db" ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( replay_from_genesis )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      block_id_type head_id;
+      uint64_t aslot;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST");
+         // many replay batches
+         for( uint32_t i = 0; i < 1000; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         head_id = db.head_block_id();
+         aslot = db.get_dynamic_global_properties().current_aslot;
+         db.close(false);
+      }
+
+      // a different version wipes the object database, the whole chain is replayed
+      database db;
+      db.open(data_dir.path(), make_genesis, "TEST2");
+      BOOST_CHECK( db.head_block_id() == head_id );
+      BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().current_aslot, aslot );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( replay_resumes_from_checkpoint )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST");
+         for( uint32_t i = 0; i < 1000; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         head_id = db.head_block_id();
+         db.close(false);
+      }
+      {
+         database db;
+         db.set_replay_checkpoint_interval( 300 );
+         db.open(data_dir.path(), make_genesis, "TEST2");
+         BOOST_CHECK( db.head_block_id() == head_id );
+         // no close(), as if the node was killed right after the replay
+      }
+      {
+         // the last checkpoint before the undo history starts holds the state after block 899
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( db.get( dynamic_global_property_id_type() ).head_block_number, 899u );
+      }
+
+      database db;
+      db.open(data_dir.path(), make_genesis, "TEST2");
+      BOOST_CHECK( db.head_block_id() == head_id );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+namespace {
+   /** records the blocks it is given, and which of them were indexed on another thread than the chain's */
+   class recording_history_consumer : public history_consumer
+   {
+      public:
+         virtual std::string name()const override { return "recording"; }
+         virtual void index( const applied_block_operations& block ) override
+         {
+            if( &fc::thread::current() != chain_thread )
+               ++on_own_thread;
+            events.push_back( block.block_num );
+         }
+         virtual void begin_replay() override { ++begun; }
+         virtual void end_replay() override { events.push_back( 0 ); }
+         virtual size_t max_queued_blocks()const override { return 8; }
+
+         fc::thread*      chain_thread = &fc::thread::current();
+         vector<uint32_t> events; ///< block numbers, 0 when the replay ended
+         uint32_t         on_own_thread = 0;
+         uint32_t         begun = 0;
+   };
+}
+
+BOOST_AUTO_TEST_CASE( replay_streams_history_to_consumers )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      uint32_t head_num;
+      {
+         database db;
+         auto consumer = std::make_shared<recording_history_consumer>();
+         db.add_history_consumer( consumer );
+         db.open(data_dir.path(), make_genesis, "TEST");
+         for( uint32_t i = 0; i < 200; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         head_num = db.head_block_num();
+         BOOST_CHECK_EQUAL( consumer->events.size(), head_num );
+         BOOST_CHECK_EQUAL( consumer->on_own_thread, 0u );
+         db.close(false);
+      }
+
+      database db;
+      auto consumer = std::make_shared<recording_history_consumer>();
+      db.add_history_consumer( consumer );
+      db.open(data_dir.path(), make_genesis, "TEST2");
+      BOOST_CHECK_EQUAL( db.head_block_num(), head_num );
+
+      // in order, the replay ends before the blocks that are pushed with undo history again
+      const uint32_t undo_point = head_num - 50;
+      BOOST_CHECK_EQUAL( consumer->begun, 1u );
+      BOOST_CHECK_EQUAL( consumer->on_own_thread, undo_point - 1 );
+      BOOST_REQUIRE_EQUAL( consumer->events.size(), head_num + 1 );
+      for( uint32_t i = 1; i < undo_point; ++i )
+         BOOST_CHECK_EQUAL( consumer->events[i-1], i );
+      BOOST_CHECK_EQUAL( consumer->events[undo_point-1], 0u );
+      for( uint32_t i = undo_point; i <= head_num; ++i )
+         BOOST_CHECK_EQUAL( consumer->events[i], i );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+namespace {
+   /** creates an operation history object per block in an index of its own */
+   class operation_writing_consumer : public history_consumer
+   {
+      public:
+         explicit operation_writing_consumer( database& db ) : _db( db ) {}
+
+         virtual std::string name()const override { return "operation writer"; }
+         virtual void index( const applied_block_operations& block ) override
+         {
+            _db.create<operation_history_object>( [&block]( operation_history_object& h ) {
+               h.block_num = block.block_num;
+            });
+         }
+
+      private:
+         database& _db;
+   };
+
+   /** keeps one account history entry in an index of its own, which it modifies and replaces per block */
+   class entry_writing_consumer : public history_consumer
+   {
+      public:
+         explicit entry_writing_consumer( database& db ) : _db( db ) {}
+
+         virtual std::string name()const override { return "entry writer"; }
+         virtual void index( const applied_block_operations& block ) override
+         {
+            const auto& entry = _db.create<account_transaction_history_object>(
+                  [&block]( account_transaction_history_object& obj ) {
+               obj.sequence = block.block_num;
+            });
+            if( last.valid() )
+            {
+               const auto& previous = (*last)(_db);
+               _db.modify( previous, [&entry]( account_transaction_history_object& obj ) { obj.next = entry.id; } );
+               _db.remove( previous );
+            }
+            last = entry.id;
+         }
+
+         optional<account_transaction_history_id_type> last;
+
+      private:
+         database& _db;
+   };
+}
+
+BOOST_AUTO_TEST_CASE( replay_with_writing_history_consumers )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      uint32_t head_num;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST");
+         for( uint32_t i = 0; i < 200; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         head_num = db.head_block_num();
+         db.close(false);
+      }
+
+      // the consumers write on their threads while the chain thread writes, all of them under the version lock
+      database db;
+      const auto operations = db.add_index< primary_index< operation_history_index > >();
+      db.add_index< primary_index< account_transaction_history_index > >();
+      db.enable_read_snapshots();
+      auto recorder = std::make_shared<recording_history_consumer>();
+      auto entries = std::make_shared<entry_writing_consumer>( db );
+      db.add_history_consumer( recorder );
+      db.add_history_consumer( std::make_shared<operation_writing_consumer>( db ) );
+      db.add_history_consumer( entries );
+      db.open(data_dir.path(), make_genesis, "TEST2");
+      BOOST_CHECK_EQUAL( db.head_block_num(), head_num );
+      BOOST_CHECK_GT( recorder->on_own_thread, 0u );
+
+      BOOST_CHECK_EQUAL( operations->object_count(), head_num );
+      uint32_t block_num = 0;
+      for( auto itr = operations->begin(); itr != operations->end(); ++itr )
+         BOOST_CHECK_EQUAL( itr->block_num, ++block_num );
+
+      const auto& entry_idx = db.get_index_type<account_transaction_history_index>().indices();
+      BOOST_REQUIRE_EQUAL( entry_idx.size(), 1u );
+      BOOST_REQUIRE( entries->last.valid() );
+      BOOST_CHECK_EQUAL( (*entries->last)(db).sequence, head_num );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( bootstrap_from_state_snapshot )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis, "TEST");
+      for( uint32_t i = 0; i < 50; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      const fc::path snapshot = data_dir1.path() / "state.snapshot";
+      db1.save_state_snapshot( snapshot, "TEST" );
+
+      GRAPHENE_REQUIRE_THROW( database::install_state_snapshot( snapshot, data_dir2.path(), "TEST2", db1.get_chain_id() ),
+                              fc::exception );
+      GRAPHENE_REQUIRE_THROW( database::install_state_snapshot( snapshot, data_dir2.path(), "TEST", chain_id_type() ),
+                              fc::exception );
+      BOOST_CHECK_EQUAL( database::install_state_snapshot( snapshot, data_dir2.path(), "TEST", db1.get_chain_id() ), 50u );
+
+      database db2;
+      db2.open(data_dir2.path(), make_genesis, "TEST");
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK_EQUAL( db2.first_available_block_num(), 50u );
+      BOOST_CHECK( !db2.fetch_block_by_number( 49 ).valid() );
+
+      // the bootstrapped node follows the chain
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db2, b );
+      }
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( captured_state_snapshot_checksum )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis, "TEST");
+      for( uint32_t i = 0; i < 10; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      const auto captured = db1.capture_state_snapshot( "TEST" );
+      // the capture is not affected by later blocks
+      for( uint32_t i = 0; i < 5; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      const fc::path snapshot = data_dir1.path() / "state.snapshot";
+      database::write_state_snapshot( captured, snapshot );
+      BOOST_CHECK( fc::exists( snapshot.generic_string() + ".manifest" ) );
+
+      // a damaged snapshot is refused
+      std::string data;
+      fc::read_file_contents( snapshot, data );
+      data[data.size() / 2] ^= 1;
+      const fc::path damaged = data_dir1.path() / "damaged.snapshot";
+      {
+         std::ofstream out( damaged.generic_string(), std::ios::binary );
+         out.write( data.data(), data.size() );
+      }
+      fc::copy( snapshot.generic_string() + ".manifest", damaged.generic_string() + ".manifest" );
+      GRAPHENE_REQUIRE_THROW( database::install_state_snapshot( damaged, data_dir2.path(), "TEST", db1.get_chain_id() ),
+                              fc::exception );
+
+      BOOST_CHECK_EQUAL( database::install_state_snapshot( snapshot, data_dir2.path(), "TEST", db1.get_chain_id() ), 10u );
+      database db2;
+      db2.open(data_dir2.path(), make_genesis, "TEST");
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 10u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_pending )
 {
    try {
@@ -1796,6 +2671,30 @@ BOOST_FIXTURE_TEST_CASE( tapos_rollover, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( block_summary_undo, database_fixture )
+{ try {
+   generate_block();
+   const block_summary_id_type sid( ( db.head_block_num() + 1 ) & 0xffff );
+   const block_id_type before = sid( db ).block_id;
+   generate_block();
+   const block_id_type popped = db.head_block_id();
+   BOOST_CHECK( sid( db ).block_id == popped );
+   BOOST_CHECK( db.is_known_block( popped ) );
+
+   // popping the block restores its summary, so transactions referring to it fail the TaPoS check
+   db.pop_block();
+   BOOST_CHECK( sid( db ).block_id == before );
+   transfer_operation op;
+   op.from = committee_account;
+   op.to = account_id_type( 1 );
+   op.amount = asset( 1 );
+   trx.operations.push_back( op );
+   set_expiration( db, trx );
+   trx.ref_block_num = sid.instance.value;
+   trx.ref_block_prefix = popped._hash[1];
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, trx, ~0 & ~database::skip_tapos_check ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE( temp_account_balance, database_fixture )
 { try {
    ACTORS( (alice) );
@@ -1923,4 +2822,169 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( transaction_conflict_analysis, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol)(dan) );
+   transfer( committee_account, alice_id, asset(10000) );
+   transfer( committee_account, bob_id, asset(10000) );
+   transfer( committee_account, carol_id, asset(10000) );
+   generate_block();
+
+   db.enable_transaction_conflict_analysis( true );
+
+   // disjoint accounts, both transfers could be applied at the same time
+   transfer( alice_id, bob_id, asset(100) );
+   transfer( carol_id, dan_id, asset(100) );
+   generate_block();
+   transaction_conflict_stats stats = db.get_transaction_conflict_stats();
+   BOOST_CHECK_EQUAL( stats.blocks, 1u );
+   BOOST_CHECK_EQUAL( stats.transactions, 2u );
+   BOOST_CHECK_EQUAL( stats.conflicting, 0u );
+   BOOST_CHECK_EQUAL( stats.rounds, 1u );
+
+   // the second transfer spends the balance the first one credited
+   transfer( alice_id, bob_id, asset(100) );
+   transfer( bob_id, carol_id, asset(100) );
+   generate_block();
+   stats = db.get_transaction_conflict_stats();
+   BOOST_CHECK_EQUAL( stats.blocks, 2u );
+   BOOST_CHECK_EQUAL( stats.transactions, 4u );
+   BOOST_CHECK_EQUAL( stats.conflicting, 1u );
+   BOOST_CHECK_EQUAL( stats.rounds, 3u );
+
+   db.enable_transaction_conflict_analysis( false );
+   transfer( alice_id, bob_id, asset(100) );
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_transaction_conflict_stats().transactions, 4u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( verification_pool_precompute, database_fixture )
+{ try {
+   auto pool = std::make_shared<verification_pool>( 2 );
+   std::vector<std::atomic<uint32_t>> seen( 7 );
+   for( auto& f : pool->post_batches( seen.size(), 2, [&seen] ( size_t begin, size_t end ) {
+           for( size_t i = begin; i < end; ++i ) ++seen[i];
+        } ) )
+      f.wait();
+   for( const auto& s : seen )
+      BOOST_CHECK_EQUAL( 1u, s.load() );
+
+   db.set_verification_pool( pool );
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(10000) );
+   transfer( alice_id, bob_id, asset(100) );
+   signed_block b = generate_block();
+
+   // blocks received from peers are verified on the pool
+   signed_block copy = b;
+   db.precompute_parallel( copy ).wait();
+   BOOST_CHECK( copy.signee() == b.signee() );
+   for( const auto& trx : copy.transactions )
+      BOOST_CHECK_EQUAL( 1u, trx.get_signature_keys( db.get_chain_id() ).size() );
+
+   db.set_verification_pool( nullptr );
+   generate_block();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( pending_transaction_limits, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(10000) );
+   generate_block();
+
+   db.set_pending_transaction_limits( 0, 1, true );
+   transfer( alice_id, bob_id, asset(100) );
+   GRAPHENE_REQUIRE_THROW( transfer( alice_id, bob_id, asset(200) ), fc::exception );
+   trx.clear();
+   // other fee payers are not affected
+   transfer( bob_id, alice_id, asset(10) );
+   generate_block();
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 90 );
+   // the block made room again
+   transfer( alice_id, bob_id, asset(200) );
+
+   // a full pool only takes transactions that pay more than pending ones
+   db.set_pending_transaction_limits( 1, 0, false );
+   GRAPHENE_REQUIRE_THROW( transfer( alice_id, bob_id, asset(300) ), fc::exception );
+   trx.clear();
+   generate_block();
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 290 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( pre_assembled_blocks, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(10000) );
+   generate_block();
+
+   db.enable_block_pre_assembly( true );
+   for( int64_t i = 1; i <= 5; ++i )
+      transfer( alice_id, bob_id, asset(i) );
+   signed_block b = generate_block();
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), 5u );
+   const signed_block unpacked = fc::raw::unpack<signed_block>( fc::raw::pack( b ) );
+   BOOST_CHECK( unpacked.calculate_merkle_root() == b.transaction_merkle_root );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 15 );
+   const size_t empty_block_size = fc::raw::pack_size( signed_block_header( b ) ) + 1;
+   const size_t transfer_size = ( fc::raw::pack_size( b ) - empty_block_size ) / 5;
+
+   // after pop_block() the pending state no longer contains the pending transactions, they are applied again
+   transfer( alice_id, bob_id, asset(100) );
+   db.pop_block();
+   transfer( alice_id, bob_id, asset(1000) );
+   b = generate_block();
+   BOOST_CHECK_EQUAL( b.transactions.size(), 2u );
+   // the transactions of the popped block are pending again
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1115 );
+   generate_block();
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1115 );
+
+   // only the transactions up to the first one that does not fit are taken, the others stay pending
+   db._undo_db.disable();
+   db.modify( db.get_global_properties(), [empty_block_size,transfer_size]( global_property_object& p ) {
+      p.parameters.maximum_block_size = empty_block_size + 2 + 2 * transfer_size + transfer_size / 2;
+   });
+   db._undo_db.enable();
+   for( int64_t i = 11; i <= 15; ++i )
+      transfer( alice_id, bob_id, asset(i) );
+   BOOST_CHECK_EQUAL( generate_block().transactions.size(), 2u );
+   BOOST_CHECK_EQUAL( generate_block().transactions.size(), 2u );
+   BOOST_CHECK_EQUAL( generate_block().transactions.size(), 1u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1180 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( last_irreversible_block_from_sorted_confirmations, database_fixture )
+{ try {
+   // what update_last_irreversible_block() found by selecting among the active witnesses
+   const auto selected_last_irreversible = [this]() -> uint32_t {
+      vector<uint32_t> confirmed;
+      for( const witness_id_type& wid : db.get_global_properties().active_witnesses )
+         confirmed.push_back( wid(db).last_confirmed_block_num );
+      const size_t offset = ( GRAPHENE_100_PERCENT - GRAPHENE_IRREVERSIBLE_THRESHOLD ) * confirmed.size()
+                            / GRAPHENE_100_PERCENT;
+      std::nth_element( confirmed.begin(), confirmed.begin() + offset, confirmed.end() );
+      return confirmed[offset];
+   };
+
+   for( int i = 0; i < 30; ++i )
+   {
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().last_irreversible_block_num,
+                         selected_last_irreversible() );
+   }
+
+   // popped blocks restore the confirmations of their signers
+   db.pop_block();
+   db.pop_block();
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().last_irreversible_block_num,
+                      selected_last_irreversible() );
+
+   // a new active set is tracked from the maintenance block on
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().last_irreversible_block_num,
+                      selected_last_irreversible() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
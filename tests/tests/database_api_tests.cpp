@@ -24,11 +24,21 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
+#include <graphene/app/api_metrics.hpp>
+#include <graphene/app/application.hpp>
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/json_writer.hpp>
+
+#include <graphene/chain/transaction_object.hpp>
 
 #include <fc/crypto/digest.hpp>
 
 #include <fc/crypto/hex.hpp>
+
+#include <atomic>
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -71,6 +81,144 @@ BOOST_AUTO_TEST_CASE(is_registered) {
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( account_member_index_follows_authorities ) {
+   try {
+      fc::ecc::private_key key1 = fc::ecc::private_key::regenerate(fc::digest("key1"));
+      fc::ecc::private_key key2 = fc::ecc::private_key::regenerate(fc::digest("key2"));
+      public_key_type pub_key1( key1.get_public_key() );
+      public_key_type pub_key2( key2.get_public_key() );
+      const account_id_type dan_id = create_account( "dan" ).id;
+      const account_id_type nathan_id = create_account( "nathan", pub_key1 ).id;
+      generate_block();
+      graphene::app::database_api db_api(db);
+
+      // the memo key is found as key and as address
+      const auto references = [&db_api]( const public_key_type& key ) -> flat_set<account_id_type> {
+         const vector<account_id_type> found = db_api.get_key_references( { key } ).front();
+         return flat_set<account_id_type>( found.begin(), found.end() );
+      };
+      BOOST_CHECK( references( pub_key1 ) == flat_set<account_id_type>{ nathan_id } );
+      BOOST_CHECK( references( pub_key2 ).empty() );
+      BOOST_CHECK( db_api.get_account_references( "dan" ).empty() );
+
+      // only the memo key is left of key1
+      account_update_operation op;
+      op.account = nathan_id;
+      authority active( 1, pub_key2, 1 );
+      active.account_auths[dan_id] = 1;
+      op.active = active;
+      op.owner = authority( 1, pub_key2, 1 );
+      trx.operations.push_back( op );
+      sign( trx, key1 );
+      PUSH_TX( db, trx );
+      trx.clear();
+      BOOST_CHECK( references( pub_key1 ) == flat_set<account_id_type>{ nathan_id } );
+      BOOST_CHECK( references( pub_key2 ) == flat_set<account_id_type>{ nathan_id } );
+      BOOST_CHECK( db_api.get_account_references( "dan" ) == vector<account_id_type>{ nathan_id } );
+
+      // key1 is not used anymore
+      op = account_update_operation();
+      op.account = nathan_id;
+      op.active = authority( 1, pub_key2, 1 );
+      op.new_options = nathan_id( db ).options;
+      op.new_options->memo_key = pub_key2;
+      trx.operations.push_back( op );
+      sign( trx, key2 );
+      PUSH_TX( db, trx );
+      trx.clear();
+      BOOST_CHECK( references( pub_key1 ).empty() );
+      BOOST_CHECK( !db_api.is_public_key_registered( (string) pub_key1 ) );
+      BOOST_CHECK( references( pub_key2 ) == flat_set<account_id_type>{ nathan_id } );
+      BOOST_CHECK( db_api.get_account_references( "dan" ).empty() );
+
+      // undoing the block restores the memberships
+      generate_block();
+      db.pop_block();
+      BOOST_CHECK( references( pub_key1 ) == flat_set<account_id_type>{ nathan_id } );
+      BOOST_CHECK( db_api.get_account_references( "dan" ).empty() );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( lookup_accounts_by_prefix ) {
+   try {
+      generate_block();
+      // enough accounts to split the blocks of the name index, with names sharing their first eight characters
+      const size_t count = 3 * account_name_index::max_block_size / 2;
+      for( size_t i = 0; i < count; ++i )
+      {
+         const size_t n = ( i * 7919 ) % count;
+         create_account( ( n % 2 ? "prefixname-" : "other-" ) + fc::to_string( uint64_t( n ) ) );
+      }
+      graphene::app::database_api db_api(db);
+
+      const auto& by_name_idx = db.get_index_type<account_index>().indices().get<by_name>();
+      const auto expected = [&by_name_idx]( const string& lower_bound, uint32_t limit )
+                            -> map<string,account_id_type> {
+         map<string,account_id_type> result;
+         for( auto itr = by_name_idx.lower_bound( lower_bound ); limit-- && itr != by_name_idx.end(); ++itr )
+            result.emplace( itr->name, itr->id );
+         return result;
+      };
+      for( const string& lower_bound : { string(), string( "a" ), string( "other-5" ), string( "prefixname-" ),
+                                         string( "prefixname-1001" ), string( "prefixname-999" ), string( "zzz" ) } )
+      {
+         BOOST_CHECK( db_api.lookup_accounts( lower_bound, 1000 ) == expected( lower_bound, 1000 ) );
+         BOOST_CHECK( db_api.lookup_accounts( lower_bound, 3 ) == expected( lower_bound, 3 ) );
+      }
+      BOOST_CHECK( db_api.lookup_accounts( "zzz", 10 ).empty() );
+
+      const auto found = db_api.lookup_account_names( { "prefixname-1", "other-2", "prefixname-2", "nathan" } );
+      BOOST_REQUIRE_EQUAL( found.size(), 4u );
+      BOOST_REQUIRE( found[0].valid() );
+      BOOST_CHECK( found[0]->id == by_name_idx.find( "prefixname-1" )->id );
+      BOOST_REQUIRE( found[1].valid() );
+      BOOST_CHECK_EQUAL( found[1]->name, "other-2" );
+      BOOST_CHECK( !found[2].valid() );
+      BOOST_CHECK( !found[3].valid() );
+
+      // undoing the block removes the names again
+      generate_block();
+      db.pop_block();
+      BOOST_CHECK( db_api.lookup_accounts( "other-", 10 ) == expected( "other-", 10 ) );
+      BOOST_CHECK( !db_api.lookup_account_names( { "prefixname-1" } ).front().valid() );
+      BOOST_CHECK_EQUAL( dynamic_cast<const base_primary_index&>( db.get_index_type<account_index>() )
+                            .get_secondary_index<account_name_index>().size(), by_name_idx.size() );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( resolve_names_symbols_and_ids ) {
+   try {
+      const account_id_type dan_id = create_account( "dan" ).id;
+      const asset_id_type usd_id = create_user_issued_asset( "USDBIT" ).id;
+      generate_block();
+      graphene::app::database_api db_api(db);
+
+      const auto accounts = db_api.get_accounts( { "dan", std::string( object_id_type( dan_id ) ), "1.2.0" } );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 3u );
+      BOOST_CHECK( accounts[0]->id == dan_id );
+      BOOST_CHECK( accounts[1]->id == dan_id );
+      BOOST_CHECK( accounts[2]->id == GRAPHENE_COMMITTEE_ACCOUNT );
+      BOOST_CHECK( db_api.get_account_by_name( "dan" )->id == dan_id );
+      BOOST_CHECK( !db_api.get_account_by_name( "nobody" ).valid() );
+
+      const auto assets = db_api.get_assets( { "USDBIT", std::string( object_id_type( usd_id ) ), "1.3.0" } );
+      BOOST_REQUIRE_EQUAL( assets.size(), 3u );
+      BOOST_CHECK( assets[0]->id == usd_id );
+      BOOST_CHECK( assets[1]->id == usd_id );
+      BOOST_CHECK( assets[2]->id == asset_id_type() );
+      const auto symbols = db_api.lookup_asset_symbols( { "USDBIT", "1.3.0", "1.3.9999", "NOPE" } );
+      BOOST_CHECK( symbols[0]->id == usd_id );
+      BOOST_CHECK( symbols[1]->id == asset_id_type() );
+      BOOST_CHECK( !symbols[2].valid() );
+      BOOST_CHECK( !symbols[3].valid() );
+
+      // malformed ids and ids of other types are still rejected
+      GRAPHENE_REQUIRE_THROW( db_api.get_accounts( { "1.2.x" } ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( db_api.get_accounts( { "1.3.0" } ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( db_api.get_assets( { "NOPE" } ), fc::exception );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( get_potential_signatures_owner_and_active ) {
    try {
       fc::ecc::private_key nathan_key1 = fc::ecc::private_key::regenerate(fc::digest("key1"));
@@ -665,6 +813,240 @@ BOOST_AUTO_TEST_CASE( set_subscribe_callback_disable_notify_all_test ) {
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( object_notifications_once_per_block )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset(10000000) );
+   const auto& xyz = create_user_issued_asset( "XYZ" );
+   generate_block();
+
+   vector<variant> notifications;
+   auto callback = [&]( const variant& v )
+   {
+      notifications.push_back( v );
+   };
+
+   graphene::app::application_options opt;
+   opt.enable_subscribe_to_all = true;
+   graphene::app::database_api db_api( db, &opt );
+   db_api.set_subscribe_callback( callback, true );
+
+   // a new order and changed balances are sent in one notification
+   BOOST_CHECK( create_sell_order( alice_id, asset(100), xyz.amount(250) ) );
+   BOOST_CHECK( create_sell_order( alice_id, asset(100), xyz.amount(300) ) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_REQUIRE_EQUAL( 1u, notifications.size() );
+
+   set<object_id_type> ids;
+   for( const variant& update : notifications[0].get_array() )
+   {
+      const object_id_type id = update.is_object() ? update["id"].as<object_id_type>( 1 )
+                                                   : update.as<object_id_type>( 1 );
+      BOOST_CHECK( ids.insert( id ).second );
+   }
+
+   // two blocks give two notifications even if they are sent together
+   notifications.clear();
+   generate_block();
+   transfer( committee_account, alice_id, asset(1) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 2u, notifications.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( notification_overflow_policies )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+
+   const auto run = [this,&alice_id]( graphene::app::notification_overflow_policy policy,
+                                      graphene::app::notification_overflow_stats& stats ) -> uint32_t {
+      uint32_t notifications = 0;
+      graphene::app::application_options opt;
+      opt.enable_subscribe_to_all = true;
+      opt.max_pending_notifications = 1;
+      opt.overflow_policy = policy;
+      opt.notification_overflows = std::make_shared<graphene::app::notification_overflow_stats>();
+      graphene::app::database_api db_api( db, &opt );
+      db_api.set_subscribe_callback( [&notifications]( const variant& ) { ++notifications; }, true );
+
+      // three blocks changing the same objects, queued without yielding
+      for( int i = 0; i < 3; ++i )
+      {
+         transfer( committee_account, alice_id, asset(1) );
+         generate_block();
+      }
+      fc::usleep(fc::milliseconds(200));
+      stats = *opt.notification_overflows;
+      return notifications;
+   };
+
+   graphene::app::notification_overflow_stats stats;
+   // the first two blocks are merged when the third one starts
+   BOOST_CHECK_EQUAL( 2u, run( graphene::app::notification_overflow_policy::coalesce, stats ) );
+   BOOST_CHECK_GT( stats.coalesced, 0u );
+   BOOST_CHECK_EQUAL( 0u, stats.dropped );
+
+   // the second block starts with the first one over the limit, the third one with the second one
+   BOOST_CHECK_EQUAL( 1u, run( graphene::app::notification_overflow_policy::drop_oldest, stats ) );
+   BOOST_CHECK_GT( stats.dropped, 0u );
+
+   BOOST_CHECK_EQUAL( 0u, run( graphene::app::notification_overflow_policy::unsubscribe, stats ) );
+   BOOST_CHECK_EQUAL( 1u, stats.unsubscribed );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( notifications_reach_only_subscribers )
+{ try {
+   ACTORS( (alice)(bob) );
+   generate_block();
+
+   uint32_t alice_notifications = 0;
+   uint32_t bob_notifications = 0;
+   graphene::app::database_api alice_api( db );
+   graphene::app::database_api bob_api( db );
+   alice_api.set_subscribe_callback( [&]( const variant& ) { ++alice_notifications; }, false );
+   bob_api.set_subscribe_callback( [&]( const variant& ) { ++bob_notifications; }, false );
+   alice_api.get_full_accounts( { "alice" }, true );
+   bob_api.get_full_accounts( { "bob" }, true );
+
+   transfer( committee_account, alice_id, asset(1) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 1u, alice_notifications );
+   BOOST_CHECK_EQUAL( 0u, bob_notifications );
+
+   transfer( committee_account, bob_id, asset(1) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 1u, alice_notifications );
+   BOOST_CHECK_EQUAL( 1u, bob_notifications );
+
+   // cancelling removes the subscriptions of the session from the registry
+   bob_api.cancel_all_subscriptions();
+   transfer( committee_account, bob_id, asset(1) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 1u, bob_notifications );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_cached_variants )
+{ try {
+   ACTORS( (alice) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).id;
+   const asset_dynamic_data_id_type usd_data_id = usd_id(db).dynamic_asset_data_id;
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const auto supply_of = [&db_api,&usd_data_id]() {
+      return db_api.get_objects( { usd_data_id } )[0]
+                   .as<asset_dynamic_data_object>( GRAPHENE_MAX_NESTED_OBJECTS ).current_supply;
+   };
+   BOOST_CHECK_EQUAL( 0, supply_of().value );
+   BOOST_CHECK_EQUAL( 0, supply_of().value );
+
+   // modifications, also by pending transactions, replace the cached variant
+   issue_uia( alice_id, asset( 1000, usd_id ) );
+   BOOST_CHECK_EQUAL( 1000, supply_of().value );
+   const uint32_t head = db.head_block_num();
+   generate_block();
+   BOOST_CHECK_EQUAL( head + 1, db_api.get_objects( { dynamic_global_property_id_type() } )[0]
+                                   .as<dynamic_global_property_object>( GRAPHENE_MAX_NESTED_OBJECTS ).head_block_number );
+
+   // undo restores the variant of the earlier state
+   db.pop_block();
+   db.clear_pending();
+   BOOST_CHECK_EQUAL( 0, supply_of().value );
+   BOOST_CHECK_EQUAL( head, db_api.get_objects( { dynamic_global_property_id_type() } )[0]
+                               .as<dynamic_global_property_object>( GRAPHENE_MAX_NESTED_OBJECTS ).head_block_number );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_of_mixed_types )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).id;
+   generate_block();
+
+   // runs of one type, types interleaved, cached and uncached types and missing objects
+   const vector<object_id_type> ids = { alice_id, bob_id, account_id_type(9999), usd_id, asset_id_type(9999),
+                                        alice_id(db).statistics, asset_id_type(), bob_id,
+                                        dynamic_global_property_id_type() };
+   graphene::app::database_api db_api( db );
+   const auto objects = db_api.get_objects( ids );
+   BOOST_REQUIRE_EQUAL( ids.size(), objects.size() );
+   for( size_t i = 0; i < ids.size(); ++i )
+   {
+      const object* obj = db.find_object( ids[i] );
+      if( obj == nullptr )
+         BOOST_CHECK( objects[i].is_null() );
+      else
+         BOOST_CHECK_EQUAL( fc::json::to_string( obj->to_variant() ), fc::json::to_string( objects[i] ) );
+   }
+
+   const auto found = db.find_objects( ids );
+   BOOST_REQUIRE_EQUAL( ids.size(), found.size() );
+   for( size_t i = 0; i < ids.size(); ++i )
+      BOOST_CHECK( found[i] == db.find_object( ids[i] ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_full_accounts_since )
+{ try {
+   graphene::app::database_api db_api( db );
+   ACTORS( (alice)(bob) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).id;
+   fund( alice, asset(1000000) );
+   generate_block();
+
+   // without a token everything is returned, unknown accounts are ignored
+   auto update = db_api.get_full_accounts_since( { "alice", "bob", "nobody" }, 0 );
+   BOOST_REQUIRE_EQUAL( 2u, update.accounts.size() );
+   BOOST_CHECK_EQUAL( 9u, update.accounts.at( "alice" ).sections.size() );
+   BOOST_CHECK_EQUAL( "alice", update.accounts.at( "alice" ).content.account.name );
+
+   // nothing changed
+   uint64_t token = update.change_token;
+   update = db_api.get_full_accounts_since( { "alice", "bob" }, token );
+   BOOST_CHECK( update.accounts.empty() );
+   BOOST_CHECK_EQUAL( token, update.change_token );
+
+   // an order changes the orders, balances and statistics of alice only
+   create_sell_order( alice_id, asset(100), asset(100, usd_id) );
+   update = db_api.get_full_accounts_since( { "alice", "bob" }, token );
+   BOOST_REQUIRE_EQUAL( 1u, update.accounts.size() );
+   const auto& changes = update.accounts.at( "alice" );
+   BOOST_CHECK( changes.sections == vector<string>( { "account", "balances", "limit_orders" } ) );
+   BOOST_CHECK_EQUAL( 1u, changes.content.limit_orders.size() );
+   BOOST_CHECK( changes.content.vesting_balances.empty() );
+   BOOST_CHECK_EQUAL( "alice", changes.content.account.name );
+
+   // undoing the pending order is a change too
+   token = update.change_token;
+   db.clear_pending();
+   update = db_api.get_full_accounts_since( { "alice", "bob" }, token );
+   BOOST_REQUIRE_EQUAL( 1u, update.accounts.size() );
+   BOOST_CHECK( update.accounts.at( "alice" ).content.limit_orders.empty() );
+
+   // tokens this node did not issue mean a full refresh
+   update = db_api.get_full_accounts_since( { "bob" }, update.change_token + 1 );
+   BOOST_CHECK_EQUAL( 9u, update.accounts.at( "bob" ).sections.size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_objects_packed )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const auto packed = db_api.get_objects_packed( { alice_id, account_id_type(9999) } );
+   BOOST_REQUIRE_EQUAL( 2u, packed.size() );
+   BOOST_CHECK( packed[1].empty() );
+
+   const auto unpacked = fc::raw::unpack<account_object>( packed[0] );
+   BOOST_CHECK( unpacked.id == alice_id );
+   BOOST_CHECK_EQUAL( "alice", unpacked.name );
+   BOOST_CHECK( packed[0] == fc::raw::pack( alice_id(db) ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( lookup_vote_ids )
 { try {
    ACTORS( (connie)(whitney)(wolverine) );
@@ -691,6 +1073,53 @@ BOOST_AUTO_TEST_CASE( lookup_vote_ids )
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( lookup_vote_ids_dense_index )
+{ try {
+   ACTORS( (connie)(whitney)(wolverine) );
+
+   fund(connie);
+   upgrade_to_lifetime_member(connie);
+   fund(whitney);
+   upgrade_to_lifetime_member(whitney);
+   fund(wolverine);
+   upgrade_to_lifetime_member(wolverine);
+
+   const auto& committee = create_committee_member( connie );
+   const auto& witness = create_witness( whitney );
+   const auto& worker = create_worker( wolverine_id );
+
+   graphene::app::database_api db_api(db);
+
+   std::vector<vote_id_type> votes;
+   votes.push_back( committee.vote_id );
+   votes.push_back( witness.vote_id );
+   votes.push_back( worker.vote_for );
+   votes.push_back( worker.vote_against );
+   // an instance that is taken, but by a vote id of another type
+   votes.push_back( vote_id_type( vote_id_type::witness, committee.vote_id.instance() ) );
+   // an instance that is not taken yet
+   votes.push_back( vote_id_type( vote_id_type::committee, worker.vote_against.instance() + 1 ) );
+
+   const auto results = db_api.lookup_vote_ids( votes );
+   BOOST_REQUIRE_EQUAL( 6u, results.size() );
+   BOOST_CHECK( results[0]["id"].as<object_id_type>( 1 ) == object_id_type( committee.id ) );
+   BOOST_CHECK( results[1]["id"].as<object_id_type>( 1 ) == object_id_type( witness.id ) );
+   BOOST_CHECK( results[2]["id"].as<object_id_type>( 1 ) == object_id_type( worker.id ) );
+   BOOST_CHECK( results[3]["id"].as<object_id_type>( 1 ) == object_id_type( worker.id ) );
+   BOOST_CHECK( results[4].is_null() );
+   BOOST_CHECK( results[5].is_null() );
+
+   // the vote ids of a removed object can no longer be found
+   const auto& worker_idx = dynamic_cast<const base_primary_index&>( db.get_index_type<worker_index>() )
+                               .get_secondary_index<worker_vote_id_index>();
+   BOOST_CHECK( worker_idx.find( worker.vote_for ) == &worker );
+   const vote_id_type vote_for = worker.vote_for;
+   db.remove( worker );
+   BOOST_CHECK( worker_idx.find( vote_for ) == nullptr );
+   BOOST_CHECK( db_api.lookup_vote_ids( { vote_for } )[0].is_null() );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(get_account_limit_orders)
 { try {
 
@@ -806,6 +1235,331 @@ BOOST_AUTO_TEST_CASE(get_account_limit_orders)
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( get_ticker_cached_per_block )
+{ try {
+   ACTORS( (seller)(buyer) );
+
+   const auto& xyz  = create_user_issued_asset( "XYZ" );
+   const auto& core = asset_id_type()(db);
+   transfer( committee_account, seller_id, asset(10000000) );
+   issue_uia( buyer, xyz.amount(10000000) );
+
+   BOOST_CHECK( create_sell_order( seller, core.amount(100), xyz.amount(250) ) );
+   BOOST_CHECK( !create_sell_order( buyer, xyz.amount(250), core.amount(100) ) );
+   generate_block();
+
+   graphene::app::application_options opt;
+   opt.has_market_history_plugin = true;
+   graphene::app::database_api db_api( db, &opt );
+
+   const graphene::app::market_ticker first = db_api.get_ticker( "BTS", "XYZ" );
+   const vector<graphene::app::market_ticker> top = db_api.get_top_markets( 10 );
+   BOOST_REQUIRE_EQUAL( 1u, top.size() );
+   BOOST_CHECK_EQUAL( first.latest, top[0].latest );
+   BOOST_CHECK_EQUAL( first.highest_bid, top[0].highest_bid );
+
+   // the results are kept until the next block, also in another session
+   BOOST_CHECK( create_sell_order( seller, core.amount(200), xyz.amount(250) ) );
+   graphene::app::database_api other_api( db, &opt );
+   BOOST_CHECK_EQUAL( first.highest_bid, db_api.get_ticker( "BTS", "XYZ" ).highest_bid );
+   BOOST_CHECK_EQUAL( first.highest_bid, other_api.get_top_markets( 10 )[0].highest_bid );
+
+   generate_block();
+   const graphene::app::market_ticker second = db_api.get_ticker( "BTS", "XYZ" );
+   BOOST_CHECK( first.highest_bid != second.highest_bid );
+   BOOST_CHECK_EQUAL( second.highest_bid, db_api.get_top_markets( 10 )[0].highest_bid );
+   BOOST_CHECK_EQUAL( first.base_volume, second.base_volume );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( market_depth_deltas )
+{ try {
+   ACTORS( (seller)(buyer) );
+
+   const auto& xyz  = create_user_issued_asset( "XYZ" );
+   const auto& core = asset_id_type()(db);
+   transfer( committee_account, seller_id, asset(10000000) );
+   issue_uia( buyer, xyz.amount(10000000) );
+
+   const limit_order_id_type first_id = create_sell_order( seller, core.amount(100), xyz.amount(250) )->id;
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   vector<graphene::app::market_depth> deltas;
+   db_api.subscribe_to_market_depth( [&deltas]( const variant& v ) {
+      deltas.push_back( v.as<graphene::app::market_depth>( GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+   }, "BTS", "XYZ" );
+
+   graphene::app::market_depth book = db_api.get_market_depth( "BTS", "XYZ" );
+   BOOST_CHECK_EQUAL( 0u, book.sequence );
+   BOOST_REQUIRE_EQUAL( 1u, book.bids.size() );
+   BOOST_CHECK_EQUAL( 100, book.bids[0].for_sale.value );
+   BOOST_CHECK_EQUAL( 1u, book.bids[0].order_count );
+   BOOST_CHECK( book.asks.empty() );
+
+   // another bid at the same price and an ask that does not match
+   const limit_order_id_type second_id = create_sell_order( seller, core.amount(100), xyz.amount(250) )->id;
+   BOOST_CHECK( create_sell_order( buyer, xyz.amount(200), core.amount(100) ) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+
+   BOOST_REQUIRE_EQUAL( 1u, deltas.size() );
+   BOOST_CHECK_EQUAL( 1u, deltas[0].sequence );
+   BOOST_REQUIRE_EQUAL( 1u, deltas[0].bids.size() );
+   BOOST_CHECK_EQUAL( 200, deltas[0].bids[0].for_sale.value );
+   BOOST_CHECK_EQUAL( 500, deltas[0].bids[0].to_receive.value );
+   BOOST_CHECK_EQUAL( 2u, deltas[0].bids[0].order_count );
+   BOOST_REQUIRE_EQUAL( 1u, deltas[0].asks.size() );
+   BOOST_CHECK_EQUAL( 200, deltas[0].asks[0].for_sale.value );
+
+   // removed levels are sent without amount
+   cancel_limit_order( first_id(db) );
+   cancel_limit_order( second_id(db) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+
+   BOOST_REQUIRE_EQUAL( 2u, deltas.size() );
+   BOOST_CHECK_EQUAL( 2u, deltas[1].sequence );
+   BOOST_REQUIRE_EQUAL( 1u, deltas[1].bids.size() );
+   BOOST_CHECK_EQUAL( 0, deltas[1].bids[0].for_sale.value );
+   BOOST_CHECK_EQUAL( 0u, deltas[1].bids[0].order_count );
+   BOOST_CHECK( deltas[1].asks.empty() );
+
+   book = db_api.get_market_depth( "BTS", "XYZ" );
+   BOOST_CHECK_EQUAL( 2u, book.sequence );
+   BOOST_CHECK( book.bids.empty() );
+   BOOST_CHECK_EQUAL( 1u, book.asks.size() );
+
+   // blocks without changes are not sent
+   generate_block();
+   fc::usleep(fc::milliseconds(200));
+   BOOST_CHECK_EQUAL( 2u, deltas.size() );
+
+   db_api.unsubscribe_from_market_depth( "BTS", "XYZ" );
+   BOOST_CHECK_EQUAL( 0u, db_api.get_market_depth( "BTS", "XYZ" ).sequence );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_order_book_price_levels )
+{ try {
+   ACTORS( (seller)(buyer) );
+
+   const auto& xyz  = create_user_issued_asset( "XYZ" );
+   const auto& core = asset_id_type()(db);
+   transfer( committee_account, seller_id, asset(10000000) );
+   issue_uia( buyer, xyz.amount(10000000) );
+
+   const limit_order_object* first = create_sell_order( seller, core.amount(100), xyz.amount(250) );
+   BOOST_REQUIRE( first );
+   const limit_order_id_type first_id = first->id;
+   BOOST_CHECK( create_sell_order( seller, core.amount(100), xyz.amount(250) ) );
+   BOOST_CHECK( create_sell_order( seller, core.amount(300), xyz.amount(900) ) );
+   BOOST_CHECK( create_sell_order( buyer, xyz.amount(200), core.amount(100) ) );
+
+   graphene::app::database_api db_api( db );
+   graphene::app::order_book book = db_api.get_order_book( "BTS", "XYZ", 50 );
+   BOOST_REQUIRE_EQUAL( 2u, book.bids.size() );
+   BOOST_CHECK_EQUAL( core.amount_to_string( 200 ), book.bids[0].base );
+   BOOST_CHECK_EQUAL( xyz.amount_to_string( 500 ), book.bids[0].quote );
+   BOOST_CHECK_EQUAL( core.amount_to_string( 300 ), book.bids[1].base );
+   BOOST_CHECK_EQUAL( xyz.amount_to_string( 900 ), book.bids[1].quote );
+   BOOST_REQUIRE_EQUAL( 1u, book.asks.size() );
+   BOOST_CHECK_EQUAL( core.amount_to_string( 100 ), book.asks[0].base );
+   BOOST_CHECK_EQUAL( xyz.amount_to_string( 200 ), book.asks[0].quote );
+
+   book = db_api.get_order_book( "BTS", "XYZ", 1 );
+   BOOST_CHECK_EQUAL( 1u, book.bids.size() );
+   BOOST_CHECK_EQUAL( 1u, book.asks.size() );
+
+   cancel_limit_order( first_id(db) );
+   book = db_api.get_order_book( "BTS", "XYZ", 50 );
+   BOOST_REQUIRE_EQUAL( 2u, book.bids.size() );
+   BOOST_CHECK_EQUAL( core.amount_to_string( 100 ), book.bids[0].base );
+
+   // the ask is filled completely by a new bid
+   BOOST_CHECK( !create_sell_order( seller, core.amount(100), xyz.amount(200) ) );
+   book = db_api.get_order_book( "BTS", "XYZ", 50 );
+   BOOST_CHECK_EQUAL( 2u, book.bids.size() );
+   BOOST_CHECK( book.asks.empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( read_only_calls_on_api_threads )
+{ try {
+   ACTORS( (seller)(buyer) );
+
+   const auto& xyz  = create_user_issued_asset( "XYZ" );
+   const auto& core = asset_id_type()(db);
+   transfer( committee_account, seller_id, asset(10000000) );
+   issue_uia( buyer, xyz.amount(10000000) );
+   BOOST_CHECK( create_sell_order( seller, core.amount(100), xyz.amount(250) ) );
+   BOOST_CHECK( create_sell_order( buyer, xyz.amount(200), core.amount(100) ) );
+
+   graphene::app::application_options options;
+   options.api_read_pool = std::make_shared<graphene::chain::verification_pool>( 2 );
+   db.enable_concurrent_reads( true );
+
+   graphene::app::database_api plain_api( db );
+   graphene::app::database_api pooled_api( db, &options );
+
+   BOOST_CHECK_EQUAL( plain_api.get_limit_orders( "BTS", "XYZ", 10 ).size(),
+                      pooled_api.get_limit_orders( "BTS", "XYZ", 10 ).size() );
+   BOOST_CHECK( plain_api.get_account_balances( "seller", flat_set<asset_id_type>() )
+                == pooled_api.get_account_balances( "seller", flat_set<asset_id_type>() ) );
+   BOOST_CHECK_EQUAL( 1u, pooled_api.get_full_accounts( { "buyer" }, false ).size() );
+
+   // blocks are applied between calls, exclusively locked
+   BOOST_CHECK_EQUAL( 1u, pooled_api.get_order_book( "BTS", "XYZ", 50 ).bids.size() );
+   generate_block();
+   BOOST_CHECK( create_sell_order( seller, core.amount(300), xyz.amount(900) ) );
+   BOOST_CHECK_EQUAL( 2u, pooled_api.get_order_book( "BTS", "XYZ", 50 ).bids.size() );
+
+   // errors of calls run on the pool reach the caller
+   GRAPHENE_CHECK_THROW( pooled_api.get_call_orders( "NOSUCHASSET", 10 ), fc::exception );
+
+   db.enable_concurrent_reads( false );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( published_order_book_and_call_orders )
+{ try {
+   ACTORS( (seller)(borrower)(borrower2)(feedproducer) );
+   const auto& bitusd = create_bitasset( "USDBIT", feedproducer_id );
+   const auto& core = asset_id_type()(db);
+   transfer( committee_account, seller_id, asset(1000000) );
+   transfer( committee_account, borrower_id, asset(1000000) );
+   transfer( committee_account, borrower2_id, asset(1000000) );
+   update_feed_producers( bitusd, {feedproducer.id} );
+   price_feed current_feed;
+   current_feed.maintenance_collateral_ratio = 1750;
+   current_feed.maximum_short_squeeze_ratio = 1100;
+   current_feed.settlement_price = bitusd.amount( 1 ) / core.amount(5);
+   publish_feed( bitusd, feedproducer, current_feed );
+   borrow( borrower, bitusd.amount(1000), asset(16000) );
+   borrow( borrower2, bitusd.amount(1000), asset(15000) );
+   transfer( borrower_id, seller_id, bitusd.amount(1000) );
+   // two orders at one price are one level
+   BOOST_CHECK( create_sell_order( seller, core.amount(100), bitusd.amount(50) ) );
+   BOOST_CHECK( create_sell_order( seller, core.amount(200), bitusd.amount(100) ) );
+   BOOST_CHECK( create_sell_order( seller, core.amount(300), bitusd.amount(100) ) );
+   BOOST_CHECK( create_sell_order( seller, bitusd.amount(100), core.amount(700) ) );
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   const auto to_json = []( const fc::variant& v ) { return fc::json::to_string( v ); };
+   const std::string locked_book = to_json( fc::variant( db_api.get_order_book( "BTS", "USDBIT", 50 ), 3 ) );
+   const std::string locked_calls = to_json( fc::variant( db_api.get_call_orders( "USDBIT", 10 ), 3 ) );
+
+   db.enable_concurrent_reads( true );
+   BOOST_REQUIRE( db.published_call_orders() != nullptr );
+   const auto book = db_api.get_order_book( "BTS", "USDBIT", 50 );
+   BOOST_CHECK_EQUAL( 2u, book.bids.size() );
+   BOOST_CHECK_EQUAL( 1u, book.asks.size() );
+   BOOST_CHECK_EQUAL( locked_book, to_json( fc::variant( book, 3 ) ) );
+   const auto calls = db_api.get_call_orders( "USDBIT", 10 );
+   BOOST_REQUIRE_EQUAL( 2u, calls.size() );
+   BOOST_CHECK( calls[0].call_price < calls[1].call_price );
+   BOOST_CHECK_EQUAL( locked_calls, to_json( fc::variant( calls, 3 ) ) );
+   BOOST_CHECK_EQUAL( 1u, db_api.get_order_book( "BTS", "USDBIT", 1 ).bids.size() );
+   GRAPHENE_CHECK_THROW( db_api.get_call_orders( "BTS", 10 ), fc::exception );
+
+   // changes are published with the next flush
+   BOOST_CHECK( create_sell_order( seller, core.amount(100), bitusd.amount(100) ) );
+   BOOST_CHECK_EQUAL( 3u, db_api.get_order_book( "BTS", "USDBIT", 50 ).bids.size() );
+   db.enable_concurrent_reads( false );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( published_limit_orders_under_concurrent_blocks )
+{ try {
+   ACTORS( (seller) );
+   const auto& xyz = create_user_issued_asset( "XYZ" );
+   const asset_id_type xyz_id = xyz.id;
+   transfer( committee_account, seller_id, asset(100000000) );
+   BOOST_CHECK( create_sell_order( seller, asset(100), xyz.amount(1000) ) );
+   BOOST_CHECK( create_sell_order( seller, asset(100), xyz.amount(2000) ) );
+
+   db.enable_concurrent_reads( true );
+   graphene::app::database_api db_api( db );
+
+   // the published orders match the live ones
+   const auto published = db_api.get_limit_orders( "BTS", std::string( object_id_type( xyz_id ) ), 100 );
+   BOOST_REQUIRE_EQUAL( 2u, published.size() );
+   BOOST_CHECK( published[0].id == db.get_index_type<limit_order_index>().indices().get<by_price>().begin()->id );
+   GRAPHENE_CHECK_THROW( db_api.get_limit_orders( "BTS", "NOSUCHASSET", 10 ), fc::exception );
+   GRAPHENE_CHECK_THROW( db_api.get_limit_orders( "BTS", "1.3.999", 10 ), fc::exception );
+
+   // every transaction below creates or cancels two orders, so readers must always see an even number of them
+   std::atomic<bool> done( false );
+   std::atomic<uint32_t> failures( 0 );
+   std::atomic<uint32_t> reads( 0 );
+   vector<std::thread> readers;
+   for( uint32_t t = 0; t < 2; ++t )
+      readers.emplace_back( [&db_api,&done,&failures,&reads]() {
+         while( !done.load() )
+         {
+            const auto orders = db_api.get_limit_orders( "BTS", "XYZ", 300 );
+            if( orders.size() % 2 != 0 )
+               ++failures;
+            for( size_t i = 1; i < orders.size(); ++i )
+               if( !limit_order_price_order()( orders[i-1], orders[i] ) )
+                  ++failures;
+            ++reads;
+         }
+      });
+
+   vector<limit_order_id_type> open_orders;
+   for( uint32_t i = 0; i < 200; ++i )
+   {
+      set_expiration( db, trx );
+      if( i % 3 == 2 )
+      {
+         for( uint32_t n = 0; n < 2; ++n )
+         {
+            limit_order_cancel_operation cancel;
+            cancel.fee_paying_account = seller_id;
+            cancel.order = open_orders.back();
+            open_orders.pop_back();
+            trx.operations.push_back( cancel );
+         }
+      }
+      else
+      {
+         for( uint32_t n = 0; n < 2; ++n )
+         {
+            limit_order_create_operation create;
+            create.seller = seller_id;
+            create.amount_to_sell = asset(100);
+            create.min_to_receive = asset( 1000 + 10 * i + n, xyz_id );
+            create.expiration = time_point_sec::maximum();
+            trx.operations.push_back( create );
+         }
+      }
+      for( auto& op : trx.operations )
+         db.current_fee_schedule().set_fee( op );
+      const auto processed = PUSH_TX( db, trx, ~0 );
+      if( i % 3 != 2 )
+         for( const auto& result : processed.operation_results )
+            open_orders.push_back( result.get<object_id_type>() );
+      trx.clear();
+      if( i % 20 == 19 )
+         generate_block();
+   }
+   done = true;
+   for( auto& reader : readers )
+      reader.join();
+   BOOST_CHECK_EQUAL( 0u, failures.load() );
+   BOOST_CHECK( reads.load() > 0 );
+
+   const auto& by_price = db.get_index_type<limit_order_index>().indices().get<by_price>();
+   const auto orders = db_api.get_limit_orders( "BTS", "XYZ", 300 );
+   BOOST_REQUIRE_EQUAL( db.get_index_type<limit_order_index>().indices().size(), orders.size() );
+   auto itr = by_price.begin();
+   for( const auto& order : orders )
+   {
+      BOOST_CHECK( order.id == itr->id );
+      BOOST_CHECK( order.for_sale == itr->for_sale );
+      ++itr;
+   }
+
+   db.enable_concurrent_reads( false );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( get_transaction_hex )
 { try {
    graphene::app::database_api db_api(db);
@@ -941,4 +1695,231 @@ BOOST_AUTO_TEST_CASE( verify_authority_multiple_accounts )
    }
 }
 
+BOOST_AUTO_TEST_CASE( json_writer_matches_variant_json )
+{ try {
+   graphene::app::database_api db_api( db );
+   ACTORS( (alice)(bob) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).id;
+   fund( alice, asset(10000000000ll) );
+   transfer( alice_id, bob_id, asset(5000000000ll) );
+   create_sell_order( alice_id, asset(100), asset(100, usd_id) );
+   const signed_block block = generate_block();
+   BOOST_REQUIRE( !block.transactions.empty() );
+   generate_block();
+
+   const auto expected = []( const fc::variant& v ) { return fc::json::to_string( v ); };
+   BOOST_CHECK_EQUAL( expected( fc::variant( block, GRAPHENE_MAX_NESTED_OBJECTS ) ), graphene::app::to_json( block ) );
+
+   const auto accounts = db_api.get_full_accounts( { "alice", "bob" }, false );
+   BOOST_REQUIRE_EQUAL( 2u, accounts.size() );
+   for( const auto& account : accounts )
+      BOOST_CHECK_EQUAL( expected( fc::variant( account.second, GRAPHENE_MAX_NESTED_OBJECTS ) ),
+                         graphene::app::to_json( account.second ) );
+
+   // the whole result of the call, maps are written as arrays of pairs
+   BOOST_CHECK_EQUAL( expected( fc::variant( accounts, GRAPHENE_MAX_NESTED_OBJECTS ) ),
+                      graphene::app::to_json( accounts ) );
+   const fc::optional<signed_block> fetched = db_api.get_block( block.block_num() );
+   BOOST_CHECK_EQUAL( expected( fc::variant( fetched, GRAPHENE_MAX_NESTED_OBJECTS ) ), graphene::app::to_json( fetched ) );
+
+   // optional members that are not set are left out, like the reflected to_variant() does
+   const graphene::app::full_account& bob_account = accounts.at( "bob" );
+   BOOST_CHECK( !bob_account.cashback_balance.valid() );
+   BOOST_CHECK_EQUAL( expected( fc::variant( bob_account, GRAPHENE_MAX_NESTED_OBJECTS ) ),
+                      graphene::app::to_json( bob_account ) );
+
+   // piece by piece assembly in the legacy format never quotes numbers
+   std::string legacy;
+   graphene::app::json_writer( legacy, fc::json::legacy_generator ).begin_object()
+      .key( "amount" ).value( int64_t(10000000000ll) )
+      .key( "id" ).value( alice_id )
+   .end_object();
+   BOOST_CHECK_EQUAL( R"({"amount":10000000000,"id":"1.2.)" + std::to_string( alice_id.instance.value ) + R"("})", legacy );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_transaction_merkle_proof )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+   for( int i = 1; i <= 3; ++i )
+      transfer( committee_account, alice_id, asset(i) );
+   generate_block();
+   const uint32_t block_num = db.head_block_num();
+   const signed_block block = *db.fetch_block_by_number( block_num );
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+
+   graphene::app::block_api api( db );
+   for( uint32_t i = 0; i < 3; ++i )
+   {
+      // the second round gets the tree from the cache
+      for( int round = 0; round < 2; ++round )
+      {
+         const graphene::app::transaction_merkle_proof proof = api.get_transaction_merkle_proof( block_num, i );
+         BOOST_CHECK( proof.block_header.id() == block.id() );
+         BOOST_CHECK( proof.transaction.id() == block.transactions[i].id() );
+         BOOST_CHECK_EQUAL( proof.trx_count, 3u );
+         BOOST_CHECK( merkle_root_from_branch( proof.transaction.merkle_digest(), proof.trx_in_block,
+                                               proof.trx_count, proof.merkle_branch )
+                      == proof.block_header.transaction_merkle_root );
+      }
+   }
+
+   // also for blocks that are not cached
+   db.get_block_cache().clear();
+   const auto proof = api.get_transaction_merkle_proof( block_num, 2 );
+   BOOST_CHECK( merkle_root_from_branch( proof.transaction.merkle_digest(), 2, 3, proof.merkle_branch )
+                == block.transaction_merkle_root );
+   GRAPHENE_CHECK_THROW( api.get_transaction_merkle_proof( block_num, 3 ), fc::exception );
+   GRAPHENE_CHECK_THROW( api.get_transaction_merkle_proof( block_num + 10, 0 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( dry_run_transaction )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(100000) );
+   generate_block();
+
+   graphene::app::database_api db_api( db );
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset(1000);
+   trx.clear();
+   trx.operations.push_back( op );
+   for( auto& o : trx.operations ) db.current_fee_schedule().set_fee( o );
+   set_expiration( db, trx );
+   sign( trx, alice_private_key );
+
+   const uint64_t undo_records = db.undo_record_count();
+   const size_t trx_count = db.get_index_type<transaction_index>().indices().size();
+   const vector<dry_run_operation> result = db_api.dry_run_transaction( trx );
+   BOOST_REQUIRE_EQUAL( result.size(), 1u );
+   BOOST_CHECK( result[0].fee == trx.operations[0].get<transfer_operation>().fee );
+   BOOST_CHECK( result[0].required_fee == db.current_fee_schedule().calculate_fee( op ) );
+   // nothing was written
+   BOOST_CHECK_EQUAL( db.undo_record_count(), undo_records );
+   BOOST_CHECK_EQUAL( db.get_index_type<transaction_index>().indices().size(), trx_count );
+   BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), 100000 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 0 );
+
+   // the transaction is still new to the chain
+   PUSH_TX( db, trx );
+
+   // the evaluate step and the checks of the transaction reject as pushing would
+   trx.clear();
+   op.amount = asset(1000000);
+   trx.operations.push_back( op );
+   for( auto& o : trx.operations ) db.current_fee_schedule().set_fee( o );
+   set_expiration( db, trx );
+   sign( trx, alice_private_key );
+   GRAPHENE_CHECK_THROW( db_api.dry_run_transaction( trx ), fc::exception );
+   trx.signatures.clear();
+   op.amount = asset(1);
+   trx.operations.back() = op;
+   GRAPHENE_CHECK_THROW( db_api.dry_run_transaction( trx ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_trade_history_from_recent_trades )
+{ try {
+   ACTORS( (seller)(buyer) );
+   const auto& xyz = create_user_issued_asset( "XYZ" );
+   const asset_id_type xyz_id = xyz.id;
+   issue_uia( seller, xyz.amount(1000) );
+   transfer( committee_account, buyer_id, asset(100000) );
+   generate_block();
+
+   // 5 trades in separate blocks, the ring of the market keeps 4 entries, both directions of 2 trades
+   for( int i = 1; i <= 5; ++i )
+   {
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, xyz_id), asset(10 * i) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(10 * i), asset(10, xyz_id) ) );
+      generate_block();
+   }
+   const auto& rings = db.get_index_type< primary_index< graphene::market_history::history_index > >()
+                          .get_secondary_index< graphene::market_history::recent_trades_index >();
+   const auto* ring = rings.find_market( asset_id_type(), xyz_id );
+   BOOST_REQUIRE( ring != nullptr );
+   BOOST_CHECK_EQUAL( ring->trades.size(), 4u );
+
+   graphene::app::application_options opt;
+   opt.has_market_history_plugin = true;
+   graphene::app::database_api db_api( db, &opt );
+
+   auto check_trades = [&]( const vector<graphene::app::market_trade>& trades, int newest ) {
+      for( size_t i = 0; i < trades.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( trades[i].value, xyz.amount_to_string( 10 ) );
+         BOOST_CHECK_EQUAL( trades[i].amount, asset_id_type()(db).amount_to_string( 10 * ( newest - int(i) ) ) );
+         BOOST_CHECK( trades[i].side1_account_id == seller_id );
+         BOOST_CHECK( trades[i].side2_account_id == buyer_id );
+         if( i > 0 )
+            BOOST_CHECK_LT( trades[i].sequence, trades[i-1].sequence );
+      }
+   };
+
+   // the latest two come from the ring, more continue in history_index
+   const fc::time_point_sec now = db.head_block_time();
+   vector<graphene::app::market_trade> trades = db_api.get_trade_history( "XYZ", "BTS", now, fc::time_point_sec(), 2 );
+   BOOST_REQUIRE_EQUAL( trades.size(), 2u );
+   check_trades( trades, 5 );
+   trades = db_api.get_trade_history( "XYZ", "BTS", now, fc::time_point_sec(), 100 );
+   BOOST_REQUIRE_EQUAL( trades.size(), 5u );
+   check_trades( trades, 5 );
+
+   // paging by sequence leaves out the trade of the start
+   const int64_t third = trades[2].sequence;
+   vector<graphene::app::market_trade> page = db_api.get_trade_history_by_sequence( "XYZ", "BTS", trades[0].sequence,
+                                                                                   fc::time_point_sec(), 1 );
+   BOOST_REQUIRE_EQUAL( page.size(), 1u );
+   check_trades( page, 4 );
+   page = db_api.get_trade_history_by_sequence( "XYZ", "BTS", trades[1].sequence, fc::time_point_sec(), 100 );
+   BOOST_REQUIRE_EQUAL( page.size(), 3u );
+   BOOST_CHECK_EQUAL( page[0].sequence, third );
+   check_trades( page, 3 );
+
+   // popped trades leave the ring
+   db.pop_block();
+   trades = db_api.get_trade_history( "XYZ", "BTS", now, fc::time_point_sec(), 100 );
+   BOOST_REQUIRE_EQUAL( trades.size(), 4u );
+   check_trades( trades, 4 );
+   BOOST_CHECK_EQUAL( ring->trades.size(), 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( get_balance_objects_by_keys )
+{ try {
+   const public_key_type key1 = generate_private_key( "claim1" ).get_public_key();
+   const public_key_type key2 = generate_private_key( "claim2" ).get_public_key();
+   const public_key_type other = generate_private_key( "other" ).get_public_key();
+   auto create_balance = [this]( const address& owner, int64_t amount ) -> balance_id_type {
+      return db.create<balance_object>( [&owner,amount]( balance_object& b ) {
+         b.owner = owner;
+         b.balance = asset( amount );
+      }).id;
+   };
+   const balance_id_type plain = create_balance( address( key1 ), 1 );
+   const balance_id_type pts = create_balance( address( pts_address( key1, true, 0 ) ), 2 );
+   const balance_id_type second = create_balance( address( pts_address( key2, false, 56 ) ), 3 );
+   create_balance( address( other ), 4 );
+
+   graphene::app::database_api db_api( db );
+   // duplicate keys return their balances once, like all address forms sent to get_balance_objects
+   const vector<balance_object> found = db_api.get_balance_objects_by_keys( { key1, key2, key1 } );
+   flat_set<balance_id_type> ids;
+   for( const balance_object& b : found )
+      ids.insert( b.id );
+   BOOST_CHECK_EQUAL( found.size(), 3u );
+   BOOST_CHECK( ids == flat_set<balance_id_type>( { plain, pts, second } ) );
+
+   vector<address> addrs;
+   for( const public_key_type& key : { key1, key2 } )
+      for( const address& addr : balance_claim_addresses( key ) )
+         addrs.push_back( addr );
+   BOOST_CHECK_EQUAL( db_api.get_balance_objects( addrs ).size(), 3u );
+   BOOST_CHECK( db_api.get_balance_objects_by_keys( {} ).empty() );
+
+   // the keys of one call are capped
+   BOOST_CHECK_EQUAL( db_api.get_balance_objects_by_keys( vector<public_key_type>( 100, key1 ) ).size(), 2u );
+   GRAPHENE_CHECK_THROW( db_api.get_balance_objects_by_keys( vector<public_key_type>( 101, key1 ) ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
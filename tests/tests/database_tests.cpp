@@ -27,8 +27,17 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/transaction_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <graphene/db/task_scheduler.hpp>
+#include <graphene/db/trace.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/thread/thread.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -222,4 +231,996 @@ BOOST_AUTO_TEST_CASE( direct_index_test )
    // but the secondary has not updated its representation
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( index_snapshot_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path snapshot = data_dir.path() / "snapshot";
+   const fc::path legacy = data_dir.path() / "legacy";
+
+   graphene::db::primary_index< account_balance_index > original( db );
+   for( uint32_t i = 0; i < 100; ++i )
+      original.create( [i] ( object& o ) {
+         account_balance_object& bal = dynamic_cast< account_balance_object& >( o );
+         bal.owner = account_id_type( i );
+         bal.balance = i * 10;
+      });
+   original.save( snapshot );
+
+   // objects start at the first page boundary
+   BOOST_CHECK_GT( fc::file_size( snapshot ), graphene::db::index_snapshot_header::page_size );
+
+   graphene::db::primary_index< account_balance_index > restored( db );
+   restored.open( snapshot );
+   BOOST_CHECK( restored.get_next_id() == original.get_next_id() );
+   BOOST_REQUIRE_EQUAL( original.indices().size(), restored.indices().size() );
+   for( const auto& bal : original.indices() )
+   {
+      const auto& other = dynamic_cast< const account_balance_object& >( restored.get( bal.id ) );
+      BOOST_CHECK( other.owner == bal.owner );
+      BOOST_CHECK_EQUAL( other.balance.value, bal.balance.value );
+   }
+   const auto& by_balance = restored.indices().get<by_asset_balance>();
+   BOOST_CHECK( by_balance.find( boost::make_tuple( asset_id_type(), share_type(420), account_id_type(42) ) )
+                != by_balance.end() );
+
+   // files in the old format can still be read
+   {
+      std::ofstream out( legacy.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      fc::raw::pack( out, original.get_next_id() );
+      fc::raw::pack( out, original.get_object_version() );
+      original.inspect_all_objects( [&out]( const object& o ) {
+         auto packed_vec = fc::raw::pack( o.pack() );
+         out.write( packed_vec.data(), packed_vec.size() );
+      });
+   }
+   graphene::db::primary_index< account_balance_index > from_legacy( db );
+   from_legacy.open( legacy );
+   BOOST_CHECK( from_legacy.get_next_id() == original.get_next_id() );
+   BOOST_CHECK_EQUAL( original.indices().size(), from_legacy.indices().size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( deferred_secondary_index_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "balances";
+
+   graphene::db::primary_index< account_balance_index > original( db );
+   for( uint32_t i = 0; i < 10; ++i )
+      original.create( [i] ( object& o ) {
+         account_balance_object& bal = dynamic_cast< account_balance_object& >( o );
+         bal.owner = account_id_type( i );
+         bal.balance = i;
+      });
+   original.save( file );
+
+   // open_deferred() leaves the self-contained index to the returned task
+   graphene::db::primary_index< account_balance_index > deferred( db );
+   const auto& by_account = *deferred.add_secondary_index< balances_by_account_index >();
+   const auto fills = deferred.open_deferred( file );
+   BOOST_CHECK_EQUAL( 10u, deferred.indices().size() );
+   BOOST_REQUIRE_EQUAL( 1u, fills.size() );
+   BOOST_CHECK( by_account.get_account_balance( account_id_type(7), asset_id_type() ) == nullptr );
+   fills[0]();
+   const account_balance_object* bal = by_account.get_account_balance( account_id_type(7), asset_id_type() );
+   BOOST_REQUIRE( bal != nullptr );
+   BOOST_CHECK_EQUAL( 7, bal->balance.value );
+
+   // open() fills it right away
+   graphene::db::primary_index< account_balance_index > opened( db );
+   const auto& opened_by_account = *opened.add_secondary_index< balances_by_account_index >();
+   opened.open( file );
+   BOOST_CHECK( opened_by_account.get_account_balance( account_id_type(7), asset_id_type() ) != nullptr );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( index_dirty_tracking_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "balances";
+
+   graphene::db::primary_index< account_balance_index > balances( db );
+   BOOST_CHECK( !balances.is_dirty() );
+
+   const auto& bal = dynamic_cast< const account_balance_object& >( balances.create( [] ( object& o ) {
+      dynamic_cast< account_balance_object& >( o ).balance = 1;
+   }));
+   BOOST_CHECK( balances.is_dirty() );
+   balances.save( file );
+   balances.clear_dirty();
+   BOOST_CHECK( !balances.is_dirty() );
+
+   balances.modify( bal, [] ( object& o ) {
+      dynamic_cast< account_balance_object& >( o ).balance = 2;
+   });
+   BOOST_CHECK( balances.is_dirty() );
+   balances.clear_dirty();
+
+   balances.remove( bal );
+   BOOST_CHECK( balances.is_dirty() );
+
+   // loading from disk does not make an index dirty
+   graphene::db::primary_index< account_balance_index > reloaded( db );
+   reloaded.open( file );
+   BOOST_CHECK_EQUAL( 1u, reloaded.indices().size() );
+   BOOST_CHECK( !reloaded.is_dirty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( interned_string_test )
+{ try {
+   using graphene::db::interned_string;
+
+   const interned_string alice( std::string( "alice" ) );
+   interned_string other;
+   BOOST_CHECK( other.empty() );
+   other = std::string( "ali" ) + "ce";
+   // equal values share one entry
+   BOOST_CHECK( alice == other );
+   BOOST_CHECK( alice.c_str() == other.c_str() );
+   BOOST_CHECK_EQUAL( std::hash<std::string>()( "alice" ), std::hash<interned_string>()( other ) );
+
+   // entries are counted and leave the pool with their last holder
+   const size_t alice_holders = alice.use_count();
+   {
+      const interned_string copy( alice );
+      BOOST_CHECK_EQUAL( alice_holders + 1, alice.use_count() );
+   }
+   BOOST_CHECK_EQUAL( alice_holders, alice.use_count() );
+   {
+      const interned_string unique( std::string( "interned-string-test" ) );
+      BOOST_CHECK_EQUAL( 1u, unique.use_count() );
+   }
+   const interned_string unique( std::string( "interned-string-test" ) );
+   BOOST_CHECK_EQUAL( 1u, unique.use_count() );
+   BOOST_CHECK( unique == "interned-string-test" );
+
+   // ordered and compared like std::string
+   const interned_string bob( std::string( "bob" ) );
+   BOOST_CHECK( alice < bob );
+   BOOST_CHECK( !( bob < alice ) );
+   BOOST_CHECK( !( alice < other ) );
+   BOOST_CHECK( alice == "alice" );
+   BOOST_CHECK( "bob" > alice );
+   BOOST_CHECK_EQUAL( "@alice", "@" + alice );
+
+   // serialized like std::string
+   BOOST_CHECK( fc::raw::pack( alice ) == fc::raw::pack( std::string( "alice" ) ) );
+   const auto unpacked = fc::raw::unpack< interned_string >( fc::raw::pack( std::string( "bob" ) ) );
+   BOOST_CHECK( unpacked == bob );
+   BOOST_CHECK_EQUAL( "alice", fc::variant( alice, 1 ).as_string() );
+   BOOST_CHECK( fc::variant( "bob" ).as< interned_string >( 1 ) == bob );
+
+   // the indexes are searched with plain strings
+   ACTOR( nathan );
+   const auto& by_name = db.get_index_type< account_index >().indices().get< by_name >();
+   BOOST_REQUIRE( by_name.find( std::string( "nathan" ) ) != by_name.end() );
+   BOOST_CHECK( by_name.find( "nathan" )->name == nathan_id( db ).name );
+   BOOST_CHECK( nathan_id( db ).name.c_str() == db.get_account_stats_by_owner( nathan_id ).name.c_str() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( undo_arena_test )
+{ try {
+   graphene::db::undo_arena arena;
+   BOOST_CHECK_EQUAL( 0u, arena.capacity() );
+
+   void* small1 = arena.allocate( 24, 8 );
+   void* small2 = arena.allocate( 24, 8 );
+   BOOST_CHECK_EQUAL( 0u, reinterpret_cast<uintptr_t>( small2 ) % 8 );
+   BOOST_CHECK_EQUAL( 24, static_cast<char*>( small2 ) - static_cast<char*>( small1 ) );
+   const size_t one_chunk = arena.capacity();
+
+   // larger than a chunk, gets its own
+   arena.allocate( 2 * one_chunk, 16 );
+   BOOST_CHECK_GE( arena.capacity(), 3 * one_chunk );
+   // the regular chunk is still being filled
+   void* small3 = arena.allocate( 8, 8 );
+   BOOST_CHECK_EQUAL( 24, static_cast<char*>( small3 ) - static_cast<char*>( small2 ) );
+
+   graphene::db::undo_arena other;
+   other.allocate( 100, 8 );
+   const size_t total = arena.capacity() + other.capacity();
+   arena.merge( std::move( other ) );
+   BOOST_CHECK_EQUAL( total, arena.capacity() );
+   BOOST_CHECK_EQUAL( 0u, other.capacity() );
+
+   // undo copies in merged sessions remain valid
+   database db;
+   const auto& bal = db.create<account_balance_object>( [] ( account_balance_object& obj ) {
+      obj.balance = 1;
+   });
+   auto outer = db._undo_db.start_undo_session();
+   {
+      auto inner = db._undo_db.start_undo_session();
+      db.modify( bal, [] ( account_balance_object& obj ) { obj.balance = 2; } );
+      inner.merge();
+   }
+   db.modify( bal, [] ( account_balance_object& obj ) { obj.balance = 3; } );
+   outer.undo();
+   BOOST_CHECK_EQUAL( 1, bal.balance.value );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( packed_undo_test )
+{ try {
+   BOOST_CHECK( graphene::db::is_packed_undo_type< account_object >::value );
+   BOOST_CHECK( !graphene::db::is_packed_undo_type< account_balance_object >::value );
+
+   database db;
+   const auto& acct = db.create<account_object>( [] ( account_object& obj ) {
+      obj.name = "original";
+   });
+   const account_id_type acct_id = acct.id;
+
+   {
+      auto ses = db._undo_db.start_undo_session();
+      db.modify( acct, [] ( account_object& obj ) { obj.name = "modified"; } );
+      BOOST_CHECK_EQUAL( 1u, db._undo_db.head().packed_old_values.size() );
+      BOOST_CHECK_EQUAL( 0u, db._undo_db.head().old_values.size() );
+      db.modify( acct, [] ( account_object& obj ) { obj.name = "modified again"; } );
+      ses.undo();
+   }
+   BOOST_CHECK_EQUAL( "original", acct_id(db).name );
+
+   // modified in one session and removed in a later one, then both merged and undone
+   {
+      auto outer = db._undo_db.start_undo_session();
+      {
+         auto inner = db._undo_db.start_undo_session();
+         db.modify( acct, [] ( account_object& obj ) { obj.name = "modified"; } );
+         inner.merge();
+      }
+      {
+         auto inner = db._undo_db.start_undo_session();
+         db.remove( acct_id(db) );
+         inner.merge();
+      }
+      BOOST_CHECK( nullptr == db.find( acct_id ) );
+      outer.undo();
+   }
+   BOOST_REQUIRE( nullptr != db.find( acct_id ) );
+   BOOST_CHECK_EQUAL( "original", acct_id(db).name );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( incremental_hash_test )
+{ try {
+   ACTOR( alice );
+   db.enable_incremental_hash();
+   BOOST_CHECK( db.get_state_hash() == db.compute_state_hash( false ) );
+
+   ACTOR( bob );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+   transfer( alice_id, bob_id, asset( 500 ) );
+   generate_block();
+   BOOST_CHECK( db.get_state_hash() == db.compute_state_hash( false ) );
+   BOOST_CHECK( db.get_state_hash() == db.compute_state_hash( true ) );
+
+   const fc::uint128 before = db.get_state_hash();
+   {
+      auto ses = db._undo_db.start_undo_session();
+      transfer( bob_id, alice_id, asset( 100 ) );
+      BOOST_CHECK( db.get_state_hash() != before );
+      ses.undo();
+   }
+   BOOST_CHECK( db.get_state_hash() == before );
+   BOOST_CHECK( db.get_state_hash() == db.compute_state_hash() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( read_snapshot_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+   generate_block();
+
+   db.enable_read_snapshots();
+   auto snapshot = db.pin_snapshot( db.head_block_num() );
+   BOOST_CHECK_EQUAL( db.head_block_num(), snapshot->revision() );
+   const account_balance_object& alice_balance = *db.get_index_type< primary_index< account_balance_index > >()
+         .get_secondary_index< balances_by_account_index >().get_account_balance( alice_id, asset_id_type() );
+   const account_balance_id_type alice_balance_id = alice_balance.id;
+
+   transfer( alice_id, bob_id, asset( 500 ) );
+   ACTOR( carol );
+   generate_block();
+
+   // live state moved on
+   BOOST_CHECK_EQUAL( 9500, alice_balance_id(db).balance.value );
+   BOOST_CHECK( db.find( carol_id ) != nullptr );
+
+   // snapshot did not
+   auto pinned_balance = snapshot->find( alice_balance_id );
+   BOOST_REQUIRE( pinned_balance );
+   BOOST_CHECK_EQUAL( 10000, pinned_balance->balance.value );
+   BOOST_CHECK( !snapshot->find( carol_id ) );
+   BOOST_CHECK( snapshot->find( bob_id ) );
+   BOOST_CHECK_GT( snapshot->version_count(), 0u );
+
+   // copies handed out stay valid after the snapshot is released
+   snapshot.reset();
+   BOOST_CHECK_EQUAL( 10000, pinned_balance->balance.value );
+
+   // a new snapshot sees the current state
+   auto current = db.pin_snapshot( db.head_block_num() );
+   BOOST_CHECK( current->find( carol_id ) );
+   BOOST_CHECK_EQUAL( 9500, current->find( alice_balance_id )->balance.value );
+   BOOST_CHECK_EQUAL( 0u, current->version_count() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( dense_index_test )
+{ try {
+   graphene::db::primary_index< graphene::db::dense_index< operation_history_object, 4 > > history( db );
+   BOOST_CHECK_EQUAL( 0u, history.size() );
+   BOOST_CHECK( history.begin() == history.end() );
+
+   vector< const object* > created;
+   for( uint32_t i = 0; i < 40; ++i )
+      created.push_back( &history.create( [i] ( object& o ) {
+         dynamic_cast< operation_history_object& >( o ).block_num = i;
+      }));
+   BOOST_CHECK_EQUAL( 40u, history.size() );
+   for( uint32_t i = 0; i < 40; ++i )
+   {
+      const object* found = history.find( operation_history_id_type( i ) );
+      BOOST_REQUIRE( found == created[i] );
+      BOOST_CHECK_EQUAL( i, dynamic_cast< const operation_history_object* >( found )->block_num );
+   }
+   BOOST_CHECK( nullptr == history.find( operation_history_id_type( 40 ) ) );
+
+   // empty an entire chunk and a few more from the next one
+   for( uint32_t i = 16; i < 35; ++i )
+      history.remove( history.get( operation_history_id_type( i ) ) );
+   BOOST_CHECK_EQUAL( 21u, history.size() );
+   BOOST_CHECK( nullptr == history.find( operation_history_id_type( 20 ) ) );
+   BOOST_CHECK( nullptr == history.find( operation_history_id_type( 34 ) ) );
+   BOOST_CHECK( created[35] == history.find( operation_history_id_type( 35 ) ) );
+
+   uint32_t count = 0;
+   uint64_t last = 0;
+   for( const auto& op : history )
+   {
+      BOOST_CHECK( count == 0 || op.id.instance() > last );
+      BOOST_CHECK( op.id.instance() < 16 || op.id.instance() >= 35 );
+      last = op.id.instance();
+      ++count;
+   }
+   BOOST_CHECK_EQUAL( 21u, count );
+
+   // removed slots can be filled again, e.g. by undo
+   operation_history_object restored;
+   restored.id = operation_history_id_type( 20 );
+   restored.block_num = 1234;
+   history.insert( std::move( restored ) );
+   BOOST_CHECK_EQUAL( 1234u, dynamic_cast< const operation_history_object& >(
+                                history.get( operation_history_id_type( 20 ) ) ).block_num );
+   operation_history_object duplicate;
+   duplicate.id = operation_history_id_type( 20 );
+   GRAPHENE_REQUIRE_THROW( history.insert( std::move( duplicate ) ), fc::assert_exception );
+
+   history.modify( history.get( operation_history_id_type( 3 ) ), [] ( object& o ) {
+      dynamic_cast< operation_history_object& >( o ).block_num = 99;
+   });
+   BOOST_CHECK( created[3] == history.find( operation_history_id_type( 3 ) ) );
+   BOOST_CHECK_EQUAL( 99u, dynamic_cast< const operation_history_object& >( *created[3] ).block_num );
+} FC_LOG_AND_RETHROW() }
+
+namespace {
+struct balance_change_recorder : public graphene::db::batched_secondary_index
+{
+   vector< std::pair< optional<share_type>, optional<share_type> > > changes;
+
+   virtual void object_changed( const object* before, const object* after ) override
+   {
+      auto value = [] ( const object* o ) -> optional<share_type> {
+         if( o == nullptr ) return optional<share_type>();
+         return static_cast< const account_balance_object* >( o )->balance;
+      };
+      changes.emplace_back( value( before ), value( after ) );
+   }
+};
+}
+
+BOOST_AUTO_TEST_CASE( batched_secondary_index_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+   generate_block();
+
+   auto recorder = db.add_secondary_index< primary_index< account_balance_index >, balance_change_recorder >();
+   const account_balance_object& alice_balance = *db.get_index_type< primary_index< account_balance_index > >()
+         .get_secondary_index< balances_by_account_index >().get_account_balance( alice_id, asset_id_type() );
+
+   for( int i = 0; i < 5; ++i )
+      db.modify( alice_balance, [] ( account_balance_object& b ) { b.balance -= 10; } );
+   const account_balance_object& temp = db.create< account_balance_object >( [&] ( account_balance_object& b ) {
+      b.owner = bob_id;
+      b.asset_type = asset_id_type( 1 );
+   });
+   db.remove( temp );
+   BOOST_CHECK( recorder->changes.empty() );
+
+   // five modifications arrive as one change, the temporary balance not at all
+   db.flush_batched_indexes();
+   BOOST_REQUIRE_EQUAL( 1u, recorder->changes.size() );
+   BOOST_CHECK( *recorder->changes[0].first == 10000 );
+   BOOST_CHECK( *recorder->changes[0].second == 9950 );
+
+   // the chain flushes after each pushed transaction
+   recorder->changes.clear();
+   transfer( alice_id, bob_id, asset( 500 ) );
+   BOOST_REQUIRE_EQUAL( 2u, recorder->changes.size() );
+   BOOST_CHECK( *recorder->changes[0].first == 9950 );
+   BOOST_CHECK( *recorder->changes[0].second <= 9450 ); // less the fee
+   BOOST_CHECK( !recorder->changes[1].first ); // bob's new balance
+   BOOST_CHECK( *recorder->changes[1].second == 500 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( task_scheduler_test )
+{ try {
+   using graphene::db::task_group;
+   using graphene::db::task_priority;
+   using graphene::db::task_scheduler;
+
+   task_scheduler scheduler( 1 );
+   BOOST_CHECK_EQUAL( 1u, scheduler.size() );
+   BOOST_CHECK( !scheduler.on_worker_thread() );
+   BOOST_CHECK_EQUAL( 42, scheduler.async( [] () { return 42; } ).wait() );
+   BOOST_CHECK( scheduler.async( [&scheduler] () { return scheduler.on_worker_thread(); } ).wait() );
+   GRAPHENE_CHECK_THROW( scheduler.async( [] () { FC_ASSERT( false ); } ).wait(), fc::assert_exception );
+
+   // the single thread is busy while the queue fills, it picks up the high priority task first
+   std::atomic<bool> release( false );
+   fc::future<void> blocker = scheduler.async( [&release] () {
+      while( !release.load() )
+         std::this_thread::yield();
+   } );
+   std::mutex order_mutex;
+   std::vector<int> order;
+   auto record = [&order_mutex,&order] ( int i ) {
+      std::lock_guard<std::mutex> lock( order_mutex );
+      order.push_back( i );
+   };
+   fc::future<void> background = scheduler.async( [&record] () { record( 2 ); }, task_priority::background );
+   fc::future<void> normal = scheduler.async( [&record] () { record( 1 ); } );
+   fc::future<void> high = scheduler.async( [&record] () { record( 0 ); }, task_priority::high );
+   release.store( true );
+   blocker.wait();
+   background.wait();
+   normal.wait();
+   high.wait();
+   BOOST_CHECK( order == std::vector<int>( { 0, 1, 2 } ) );
+
+   // groups nest on a single thread, the waiting task runs the inner tasks itself
+   std::atomic<uint32_t> sum( 0 );
+   {
+      task_group outer( task_priority::normal, scheduler );
+      for( uint32_t i = 0; i < 4; ++i )
+         outer.run( [&scheduler,&sum,i] () {
+            task_group inner( task_priority::normal, scheduler );
+            for( uint32_t k = 0; k < 4; ++k )
+               inner.run( [&sum,i,k] () { sum += i * 4 + k; } );
+            inner.wait();
+         } );
+      outer.wait();
+   }
+   BOOST_CHECK_EQUAL( 120u, sum.load() );
+
+   // every task of a failing group finishes before the first exception leaves it
+   task_scheduler pool( 4 );
+   std::atomic<uint32_t> finished( 0 );
+   task_group failing( task_priority::normal, pool );
+   for( uint32_t i = 0; i < 64; ++i )
+      failing.run( [&finished,i] () {
+         ++finished;
+         FC_ASSERT( i != 7 );
+      } );
+   GRAPHENE_CHECK_THROW( failing.wait(), fc::assert_exception );
+   BOOST_CHECK_LE( finished.load(), 64u );
+   BOOST_CHECK_GE( finished.load(), 8u );
+   failing.run( [&finished] () { ++finished; } );
+   failing.wait();
+
+   // the waiting thread does not yield, another fiber of it cannot run in the middle of the group
+   std::atomic<bool> fiber_ran( false );
+   fc::future<void> fiber = fc::async( [&fiber_ran] () { fiber_ran.store( true ); } );
+   std::atomic<bool> fiber_ran_during_group( true );
+   {
+      task_group slow( task_priority::normal, pool );
+      slow.run( [&fiber_ran,&fiber_ran_during_group] () {
+         std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+         fiber_ran_during_group.store( fiber_ran.load() );
+      } );
+      slow.wait();
+   }
+   BOOST_CHECK( !fiber_ran_during_group.load() );
+   fiber.wait();
+   BOOST_CHECK( fiber_ran.load() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( state_journal_test )
+{ try {
+   fc::temp_directory journal_dir( graphene::utilities::temp_directory_path() );
+   GRAPHENE_CHECK_THROW( db.get_objects_at_block( { dynamic_global_property_id_type() }, db.head_block_num() ),
+                         fc::exception );
+   db.open_state_journal( journal_dir.path() );
+
+   generate_block();
+   const uint32_t first = db.head_block_num();
+   const account_id_type bob_id = create_account( "bob" ).id;
+   generate_block();
+   const uint32_t bob_created = db.head_block_num();
+   generate_blocks( 20 );
+   const uint32_t head = db.head_block_num();
+   // some of the blocks are flushed to the file, the others are still reversible
+   BOOST_REQUIRE_GT( db.get_dynamic_global_properties().last_irreversible_block_num, bob_created );
+   BOOST_REQUIRE_LT( db.get_dynamic_global_properties().last_irreversible_block_num, head );
+
+   const vector<object_id_type> ids = { dynamic_global_property_id_type(), bob_id };
+   for( uint32_t n = first; n <= head; ++n )
+   {
+      const auto objects = db.get_objects_at_block( ids, n );
+      BOOST_REQUIRE_EQUAL( 2u, objects.size() );
+      BOOST_CHECK_EQUAL( n, objects[0]["head_block_number"].as_uint64() );
+      if( n < bob_created )
+         BOOST_CHECK( objects[1].is_null() );
+      else
+         BOOST_CHECK_EQUAL( "bob", objects[1]["name"].as_string() );
+   }
+   // the state at the end of the block before the first recorded one is known, earlier ones are not
+   BOOST_CHECK_EQUAL( first - 1, db.get_objects_at_block( ids, first - 1 )[0]["head_block_number"].as_uint64() );
+   GRAPHENE_CHECK_THROW( db.get_objects_at_block( ids, first - 2 ), fc::exception );
+   GRAPHENE_CHECK_THROW( db.get_objects_at_block( ids, head + 1 ), fc::exception );
+
+   // the changes of pending transactions are not part of any block
+   transfer( account_id_type(), bob_id, asset( 1000 ) );
+   object_id_type bob_balance_id;
+   for( const account_balance_object& balance : db.get_index_type<account_balance_index>().indices() )
+      if( balance.owner == bob_id )
+         bob_balance_id = balance.id;
+   BOOST_REQUIRE( db.find_object( bob_balance_id ) != nullptr );
+   BOOST_CHECK( db.get_objects_at_block( { bob_balance_id }, head )[0].is_null() );
+
+   // popped blocks are forgotten
+   db.pop_block();
+   BOOST_CHECK_EQUAL( head - 1, db.get_state_journal()->last_block() );
+   BOOST_CHECK_EQUAL( head - 1, db.get_objects_at_block( ids, head - 1 )[0]["head_block_number"].as_uint64() );
+   generate_block();
+
+   // only the flushed blocks are read back from the file
+   const uint32_t irreversible = db.get_dynamic_global_properties().last_irreversible_block_num;
+   {
+      graphene::db::state_journal reopened( journal_dir.path() );
+      BOOST_CHECK_EQUAL( first, reopened.first_block() );
+      BOOST_CHECK_EQUAL( irreversible, reopened.last_block() );
+   }
+   // again from the index saved when it was closed
+   BOOST_CHECK( fc::exists( journal_dir.path() / "index" ) );
+   graphene::db::state_journal reopened( journal_dir.path() );
+   BOOST_CHECK_EQUAL( first, reopened.first_block() );
+   BOOST_CHECK_EQUAL( irreversible, reopened.last_block() );
+   const auto bob_then = reopened.get_objects( db, { bob_id }, bob_created - 1, nullptr );
+   BOOST_CHECK( bob_then[0].is_null() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( simulate_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 1000000 ) );
+   generate_block();
+   const uint32_t head = db.head_block_num();
+   const block_id_type head_id = db.head_block_id();
+
+   signed_transaction to_bob;
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset( 1000 );
+   to_bob.operations.push_back( op );
+   for( auto& o : to_bob.operations ) db.current_fee_schedule().set_fee( o );
+   set_expiration( db, to_bob );
+   sign( to_bob, alice_private_key );
+
+   simulation_request request;
+   request.object_updates.push_back( fc::mutable_variant_object( "id", bob_id )( "_action", "update" )( "name", "robert" ) );
+   request.transactions.push_back( to_bob );
+   request.blocks.resize( 3 );
+   const simulation_result result = db.simulate( request );
+
+   BOOST_REQUIRE_EQUAL( 1u, result.transactions.size() );
+   BOOST_CHECK_EQUAL( 1u, result.transactions[0].operation_results.size() );
+   BOOST_REQUIRE_EQUAL( 3u, result.blocks.size() );
+   BOOST_CHECK_EQUAL( head + 3, result.blocks.back().block_num() );
+   BOOST_REQUIRE( !result.operations.empty() );
+   BOOST_CHECK( result.operations.front().op.is_type<transfer_operation>() );
+   BOOST_CHECK_EQUAL( head + 1, result.operations.front().block_num );
+
+   bool renamed = false;
+   bool funded = false;
+   for( const simulated_object_change& change : result.changes )
+   {
+      if( change.id == object_id_type( bob_id ) )
+      {
+         BOOST_CHECK_EQUAL( "bob", change.before["name"].as_string() );
+         BOOST_CHECK_EQUAL( "robert", change.after["name"].as_string() );
+         renamed = true;
+      }
+      // bob had no balance object before
+      else if( change.id.space() == implementation_ids && change.id.type() == impl_account_balance_object_type &&
+               change.after.is_object() && change.after["owner"].as<account_id_type>( 1 ) == bob_id )
+      {
+         BOOST_CHECK( change.before.is_null() );
+         BOOST_CHECK_EQUAL( 1000, change.after["balance"].as<int64_t>( 1 ) );
+         funded = true;
+      }
+   }
+   BOOST_CHECK( renamed );
+   BOOST_CHECK( funded );
+   BOOST_CHECK( std::is_sorted( result.changes.begin(), result.changes.end(),
+                                []( const simulated_object_change& a, const simulated_object_change& b ) {
+                                   return a.id < b.id;
+                                } ) );
+
+   // the live chain didn't move
+   BOOST_CHECK_EQUAL( head, db.head_block_num() );
+   BOOST_CHECK( head_id == db.head_block_id() );
+   BOOST_CHECK_EQUAL( "bob", bob_id( db ).name );
+   BOOST_CHECK_EQUAL( 0, get_balance( bob_id, asset_id_type() ) );
+
+   // and the simulated transaction still applies to it
+   PUSH_TX( db, to_bob );
+   generate_block();
+   BOOST_CHECK_EQUAL( head + 1, db.head_block_num() );
+   BOOST_CHECK_EQUAL( 1000, get_balance( bob_id, asset_id_type() ) );
+
+   // a failing simulation leaves nothing behind either
+   request.object_updates.clear();
+   GRAPHENE_CHECK_THROW( db.simulate( request ), fc::exception );
+   BOOST_CHECK_EQUAL( 1000, get_balance( bob_id, asset_id_type() ) );
+   generate_block();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( expiration_wheel_test )
+{ try {
+   using graphene::db::expiration_wheel;
+   typedef std::pair< uint32_t, object_id_type > expiring;
+
+   // random insertions, removals and advances, small steps, jumps and steps back, against an ordered set
+   expiration_wheel wheel;
+   std::set< expiring > expected;
+   uint64_t state = 88172645463325252ull;
+   const auto next_random = [&state]() -> uint64_t {
+      state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+      return state;
+   };
+   const uint32_t start = 1500000000;
+   uint32_t now = start;
+   uint64_t next_id = 0;
+   for( uint32_t round = 0; round < 3000; ++round )
+   {
+      for( uint32_t i = next_random() % 8; i > 0; --i )
+      {
+         static const uint32_t horizons[] = { 10, 100, 5000, 300000, 30000000 };
+         const uint32_t time = now - 5 + next_random() % horizons[ next_random() % 5 ];
+         const object_id_type id( 1, 7, next_id++ );
+         wheel.insert( time, id );
+         expected.emplace( time, id );
+      }
+      if( !expected.empty() && next_random() % 2 )
+      {
+         auto itr = expected.begin();
+         std::advance( itr, next_random() % expected.size() );
+         wheel.remove( itr->first, itr->second );
+         expected.erase( itr );
+      }
+
+      const uint64_t move = next_random() % 100;
+      if( move == 0 )
+         now = std::max( start, now - 20 );
+      else if( move == 1 )
+         now += 100000;
+      else
+         now += move % 7;
+      while( const fc::optional<object_id_type> expired = wheel.next_expired( now ) )
+      {
+         BOOST_REQUIRE( !expected.empty() );
+         BOOST_REQUIRE( expected.begin()->first <= now );
+         BOOST_REQUIRE( *expired == expected.begin()->second );
+         wheel.remove( expected.begin()->first, *expired );
+         expected.erase( expected.begin() );
+      }
+      BOOST_REQUIRE( expected.empty() || expected.begin()->first > now );
+      BOOST_REQUIRE_EQUAL( wheel.size(), expected.size() );
+   }
+
+   // transactions of the chain leave the duplicate check once they expired, and come back with an undo
+   generate_block();
+   const auto& transactions = db.get_index_type< transaction_index >().indices();
+   transfer( committee_account, account_id_type( 1 ), asset( 1 ) );
+   generate_block();
+   const size_t recent = transactions.size();
+   BOOST_CHECK_GT( recent, 0u );
+   const fc::time_point_sec all_expired = db.head_block_time()
+                                        + db.get_global_properties().parameters.maximum_time_until_expiration + 10;
+   generate_blocks( all_expired );
+   BOOST_CHECK_EQUAL( transactions.size(), 0u );
+   db.pop_block();
+   BOOST_CHECK_EQUAL( transactions.size(), recent );
+   generate_blocks( all_expired );
+   BOOST_CHECK_EQUAL( transactions.size(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( account_maintenance_index_test )
+{ try {
+   const auto& maintenance = dynamic_cast<const base_primary_index&>( db.get_index_type<account_stats_index>() )
+                                .get_secondary_index<account_maintenance_index>();
+   // the index holds exactly the statistics that need maintenance, by name
+   const auto check_index = [this,&maintenance]() {
+      vector<string> expected;
+      for( const account_statistics_object& stats : db.get_index_type<account_stats_index>().indices() )
+         if( stats.need_maintenance() )
+            expected.push_back( stats.name );
+      std::sort( expected.begin(), expected.end() );
+      vector<string> actual;
+      for( const auto& item : maintenance.accounts() )
+      {
+         BOOST_CHECK( item.second->name == item.first );
+         actual.push_back( item.first );
+      }
+      BOOST_CHECK( expected == actual );
+   };
+
+   ACTORS( (alice)(bob) );
+   check_index();
+   fund( alice );
+   transfer( alice_id, bob_id, asset(1000) );
+   upgrade_to_lifetime_member( alice_id );
+   check_index();
+
+   account_update_operation op;
+   op.account = bob_id;
+   op.new_options = bob_id(db).options;
+   op.new_options->votes.insert( (*db.get_index_type<witness_index>().indices().begin()).vote_id );
+   op.new_options->num_witness = 1;
+   trx.operations.push_back( op );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+   check_index();
+
+   generate_block();
+   check_index();
+   db.pop_block();
+   check_index();
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   check_index();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( index_memory_usage_test )
+{ try {
+   const index& accounts = db.get_index( account_object::space_id, account_object::type_id );
+   const auto before = accounts.get_memory_usage();
+
+   create_account( "a-rather-long-account-name-that-does-not-fit-inline" );
+   const auto after = accounts.get_memory_usage();
+   BOOST_CHECK_EQUAL( "graphene::chain::account_object", after.object_type );
+   BOOST_CHECK_EQUAL( before.object_count + 1, after.object_count );
+   BOOST_CHECK_EQUAL( before.object_bytes + sizeof( account_object ), after.object_bytes );
+   BOOST_CHECK_GT( after.dynamic_bytes, before.dynamic_bytes + 50 );
+   BOOST_CHECK_GT( after.container_bytes, before.container_bytes );
+   BOOST_CHECK_GT( after.secondary_index_bytes, 0u );
+
+   vector<char> long_buffer( 1000 );
+   BOOST_CHECK_EQUAL( 1000u, graphene::db::dynamic_memory_size( long_buffer ) );
+   BOOST_CHECK_EQUAL( 0u, graphene::db::dynamic_memory_size( string( "short" ) ) );
+
+   bool found = false;
+   uint64_t total = 0;
+   for( const auto& usage : db.get_memory_usage() )
+   {
+      found = found || ( usage.space_id == account_object::space_id && usage.type_id == account_object::type_id );
+      total += usage.total_bytes();
+   }
+   BOOST_CHECK( found );
+   BOOST_CHECK_GT( total, after.total_bytes() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( operation_timing_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   const int64_t transfer_tag = operation::tag< transfer_operation >::value;
+   BOOST_CHECK( db.get_operation_timing().empty() );
+
+   db.enable_operation_timing( true );
+   transfer( committee_account, alice_id, asset(1000) );
+   transfer( alice_id, bob_id, asset(100) );
+   const operation_timing timing = db.get_operation_timing()[ transfer_tag ];
+   BOOST_CHECK_EQUAL( 2u, timing.count );
+   BOOST_CHECK_GE( timing.evaluate_ns, timing.max_evaluate_ns );
+   BOOST_CHECK_GE( timing.apply_ns, timing.max_apply_ns );
+   BOOST_CHECK_GT( timing.apply_ns, 0u );
+   // balances and the fee payer's statistics are modified
+   BOOST_CHECK_GE( timing.undo_records, 6u );
+   BOOST_CHECK_EQUAL( 0u, db.get_operation_timing()[ operation::tag< account_create_operation >::value ].count );
+
+   db.reset_operation_timing();
+   BOOST_CHECK_EQUAL( 0u, db.get_operation_timing()[ transfer_tag ].count );
+
+   db.enable_operation_timing( false );
+   transfer( alice_id, bob_id, asset(100) );
+   BOOST_CHECK( db.get_operation_timing().empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( state_writes_of_other_fibers_wait )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(1000) );
+   generate_block();
+   db.enable_concurrent_reads( true );
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset(100);
+   trx.operations.push_back( op );
+   set_expiration( db, trx );
+   sign( trx, alice_private_key );
+
+   // the handler yields while the block holds the state, a transaction pushed by another fiber waits for it
+   fc::future<void> pushed;
+   bool pushed_during_block = true;
+   auto connection = db.applied_block.connect( [&]( const signed_block& ) {
+      if( pushed.valid() )
+         return;
+      pushed = fc::async( [&]() { PUSH_TX( db, trx ); } );
+      for( int i = 0; i < 10; ++i )
+         fc::yield();
+      pushed_during_block = pushed.ready();
+   });
+   generate_block();
+   connection.disconnect();
+   pushed.wait();
+
+   BOOST_CHECK( !pushed_during_block );
+   BOOST_CHECK_EQUAL( 100, get_balance( bob_id, asset_id_type() ) );
+   db.enable_concurrent_reads( false );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( applied_operation_impacted_accounts_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(1000) );
+   generate_block();
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset(100);
+   trx.operations.push_back( op );
+   set_expiration( db, trx );
+   sign( trx, alice_private_key );
+   PUSH_TX( db, trx );
+   trx.clear();
+
+   vector< flat_set<account_id_type> > impacted;
+   auto connection = db.applied_block.connect( [&]( const signed_block& ) {
+      const auto& ops = db.get_applied_operations();
+      for( uint32_t i = 0; i < ops.size(); ++i )
+      {
+         if( !ops[i].valid() || ops[i]->op.which() != operation::tag< transfer_operation >::value )
+            continue;
+         impacted.push_back( db.get_applied_operation_impacted_accounts( i ) );
+         // the set is computed once and shared
+         BOOST_CHECK( &db.get_applied_operation_impacted_accounts( i ) == &db.get_applied_operation_impacted_accounts( i ) );
+      }
+   } );
+   generate_block();
+   connection.disconnect();
+
+   BOOST_REQUIRE_EQUAL( 1u, impacted.size() );
+   BOOST_CHECK( impacted[0] == flat_set<account_id_type>( { alice_id, bob_id } ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_tracing_test )
+{ try {
+   ACTORS( (alice) );
+   auto& tracer = graphene::db::tracer::instance();
+   tracer.clear();
+
+   tracer.enable( true );
+   transfer( committee_account, alice_id, asset(1000) );
+   generate_block();
+   tracer.enable( false );
+   const uint32_t block_num = db.head_block_num();
+
+   const auto spans = tracer.spans();
+   std::map<uint64_t, graphene::db::trace_span> by_id;
+   for( const auto& span : spans )
+      by_id[span.id] = span;
+   auto parent_name = [&by_id]( const graphene::db::trace_span& span ) -> std::string {
+      auto itr = by_id.find( span.parent_id );
+      return itr == by_id.end() ? std::string() : std::string( itr->second.name );
+   };
+
+   uint32_t applied_blocks = 0;
+   uint32_t block_transactions = 0;
+   uint32_t notifications = 0;
+   for( const auto& span : spans )
+   {
+      const std::string name = span.name;
+      BOOST_CHECK_GE( span.duration_us, 0 );
+      if( span.parent_id != 0 && by_id.count( span.parent_id ) )
+      {
+         const auto& parent = by_id[span.parent_id];
+         BOOST_CHECK_EQUAL( parent.trace_id, span.trace_id );
+         BOOST_CHECK_EQUAL( parent.thread, span.thread );
+         BOOST_CHECK_LE( parent.start_us, span.start_us );
+      }
+      if( name == "apply_block" )
+      {
+         ++applied_blocks;
+         BOOST_CHECK_EQUAL( "push_block", parent_name( span ) );
+         BOOST_CHECK_EQUAL( int64_t( block_num ), span.arg );
+      }
+      else if( name == "apply_transaction" && parent_name( span ) == "apply_block" )
+         ++block_transactions;
+      else if( name == "notify_applied_block" || name == "notify_changed_objects" )
+      {
+         ++notifications;
+         BOOST_CHECK_EQUAL( "apply_block", parent_name( span ) );
+      }
+   }
+   BOOST_CHECK_EQUAL( 1u, applied_blocks );
+   BOOST_CHECK_EQUAL( 1u, block_transactions );
+   BOOST_CHECK_EQUAL( 2u, notifications );
+
+   const fc::variant chrome = tracer.to_chrome_trace();
+   BOOST_CHECK_EQUAL( spans.size(), chrome.get_object()["traceEvents"].get_array().size() );
+   const fc::variant otlp = tracer.to_otlp_json();
+   const auto& otlp_spans = otlp.get_object()["resourceSpans"].get_array()[0].get_object()["scopeSpans"]
+                                .get_array()[0].get_object()["spans"].get_array();
+   BOOST_CHECK_EQUAL( spans.size(), otlp_spans.size() );
+   BOOST_CHECK_EQUAL( 32u, otlp_spans[0].get_object()["traceId"].as_string().size() );
+   BOOST_CHECK_EQUAL( 16u, otlp_spans[0].get_object()["spanId"].as_string().size() );
+
+   // nothing is recorded while disabled
+   generate_block();
+   BOOST_CHECK_EQUAL( spans.size(), tracer.spans().size() );
+
+   // the ring keeps the most recent spans
+   tracer.set_capacity( 3 );
+   tracer.enable( true );
+   generate_block();
+   tracer.enable( false );
+   const auto recent = tracer.spans();
+   BOOST_REQUIRE_EQUAL( 3u, recent.size() );
+   BOOST_CHECK_EQUAL( "push_block", std::string( recent.back().name ) );
+
+   tracer.set_capacity( graphene::db::tracer::default_capacity );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( trace_spans_nest_per_task )
+{ try {
+   auto& tracer = graphene::db::tracer::instance();
+   tracer.clear();
+
+   // both tasks run on this thread and yield while their outer span is open
+   auto traced_task = []( const char* outer, const char* inner ) {
+      graphene::db::trace_scope outer_scope( outer );
+      fc::yield();
+      graphene::db::trace_scope inner_scope( inner );
+      fc::yield();
+   };
+   tracer.enable( true );
+   fc::future<void> a = fc::async( [&traced_task]() { traced_task( "outer_a", "inner_a" ); } );
+   fc::future<void> b = fc::async( [&traced_task]() { traced_task( "outer_b", "inner_b" ); } );
+   a.wait();
+   b.wait();
+   tracer.enable( false );
+
+   std::map<std::string, graphene::db::trace_span> by_name;
+   for( const auto& span : tracer.spans() )
+      by_name[span.name] = span;
+   BOOST_REQUIRE_EQUAL( 4u, by_name.size() );
+   BOOST_CHECK_EQUAL( 0u, by_name["outer_a"].parent_id );
+   BOOST_CHECK_EQUAL( 0u, by_name["outer_b"].parent_id );
+   BOOST_CHECK_EQUAL( by_name["outer_a"].id, by_name["inner_a"].parent_id );
+   BOOST_CHECK_EQUAL( by_name["outer_b"].id, by_name["inner_b"].parent_id );
+   BOOST_CHECK_EQUAL( by_name["outer_a"].thread, by_name["outer_b"].thread );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3675,6 +3675,17 @@ BOOST_AUTO_TEST_CASE( defaults_test )
     schedule.parameters.insert( new_bid_fee );
     fee = schedule.calculate_fee( bid_collateral_operation() );
     BOOST_CHECK_EQUAL( (int64_t)new_bid_fee.fee, fee.amount.value );
+
+    // a schedule with all parameters finds them by the tag of the operation
+    schedule = fee_schedule::get_default();
+    schedule.parameters.erase( limit_order_create_operation::fee_parameters_type() );
+    BOOST_CHECK( !schedule.exists<limit_order_create_operation>() );
+    fee = schedule.calculate_fee( limit_order_create_operation() );
+    BOOST_CHECK_EQUAL( (int64_t)default_order_fee.fee, fee.amount.value );
+    schedule.parameters.insert( new_order_fee );
+    BOOST_CHECK( schedule.exists<limit_order_create_operation>() );
+    fee = schedule.calculate_fee( limit_order_create_operation() );
+    BOOST_CHECK_EQUAL( (int64_t)new_order_fee.fee, fee.amount.value );
   }
   catch( const fc::exception& e )
   {
@@ -25,6 +25,10 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/account_history/history_store.hpp>
+#include <graphene/history_export/export_file.hpp>
+#include <graphene/history_export/history_export_plugin.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
@@ -604,4 +608,453 @@ BOOST_AUTO_TEST_CASE(get_account_history_operations) {
    }
 }
 
+
+BOOST_AUTO_TEST_CASE(get_account_history_operations_indexed) {
+   try {
+      graphene::app::history_api hist_api(app);
+      auto plugin = app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+      BOOST_REQUIRE( plugin->get_operation_type_index() != nullptr );
+
+      ACTORS( (alice)(bob) );
+      fund( alice );
+      generate_block();
+      for( int i = 1; i <= 5; ++i )
+         transfer( alice_id, bob_id, asset(i) );
+      generate_block();
+
+      const int transfer_op_id = operation::tag<transfer_operation>::value;
+      vector<operation_history_object> transfers = hist_api.get_account_history_operations(
+            "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 );
+      // the funding transfer and the 5 to bob, the most recent first
+      BOOST_REQUIRE_EQUAL( transfers.size(), 6u );
+      for( size_t i = 0; i < transfers.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( transfers[i].op.which(), transfer_op_id );
+         if( i > 0 )
+            BOOST_CHECK( transfers[i].id < transfers[i-1].id );
+      }
+      BOOST_CHECK_EQUAL( transfers[0].op.get<transfer_operation>().amount.amount.value, 5 );
+
+      // start and stop bound the range, stop is not included
+      vector<operation_history_object> page = hist_api.get_account_history_operations(
+            "alice", transfer_op_id, transfers[1].id, transfers[4].id, 100 );
+      BOOST_REQUIRE_EQUAL( page.size(), 3u );
+      BOOST_CHECK( page[0].id == transfers[1].id );
+      BOOST_CHECK( page[2].id == transfers[3].id );
+      page = hist_api.get_account_history_operations(
+            "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 2 );
+      BOOST_REQUIRE_EQUAL( page.size(), 2u );
+      BOOST_CHECK( page[1].id == transfers[1].id );
+
+      const int account_create_op_id = operation::tag<account_create_operation>::value;
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "bob", account_create_op_id,
+            operation_history_id_type(), operation_history_id_type(), 100 ).size(), 1u );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "bob", transfer_op_id,
+            operation_history_id_type(), operation_history_id_type(), 100 ).size(), 5u );
+
+      // popped transfers leave the index along with their entries
+      db.pop_block();
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "bob", transfer_op_id,
+            operation_history_id_type(), operation_history_id_type(), 100 ).size(), 0u );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(get_account_history_page) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      // committee-account does 5 ops
+      for(int i = 0; i < 5; ++i)
+         create_account("pageacct" + std::to_string(i));
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      const vector<operation_history_object> all = hist_api.get_account_history("committee-account",
+            operation_history_id_type(), 100, operation_history_id_type());
+      BOOST_REQUIRE_EQUAL(all.size(), 5u);
+
+      // pages of 2 resume where the previous one stopped, most recent first
+      vector<operation_history_id_type> paged;
+      account_history_page page = hist_api.get_account_history_page("committee-account", "", 2);
+      for(int pages = 1; ; ++pages)
+      {
+         BOOST_REQUIRE_LE(page.operations.size(), 2u);
+         BOOST_CHECK(page.entries.empty());
+         for(const auto& op : page.operations)
+            paged.push_back(op.id);
+         if(page.cursor.empty())
+         {
+            BOOST_CHECK_EQUAL(pages, 3);
+            break;
+         }
+         // operations added meanwhile do not shift the pages
+         if(pages == 1)
+         {
+            create_account("latecomer");
+            generate_block();
+         }
+         page = hist_api.get_account_history_page("committee-account", page.cursor, 2);
+      }
+      BOOST_REQUIRE_EQUAL(paged.size(), all.size());
+      for(size_t i = 0; i < all.size(); ++i)
+         BOOST_CHECK(paged[i] == all[i].id);
+
+      // only ids
+      page = hist_api.get_account_history_page("committee-account", "", 100, true);
+      BOOST_CHECK(page.operations.empty());
+      BOOST_REQUIRE_EQUAL(page.entries.size(), 6u);
+      BOOST_CHECK(page.entries[1].id == all[0].id);
+      BOOST_CHECK(!page.entries[1].is_virtual);
+      BOOST_CHECK(page.cursor.empty());
+
+      // limits, and cursors of other accounts
+      GRAPHENE_REQUIRE_THROW(hist_api.get_account_history_page("committee-account", "", 1001), fc::exception);
+      BOOST_CHECK_EQUAL(hist_api.get_account_history_page("committee-account", "", 1000).operations.size(), 6u);
+      const string cursor = hist_api.get_account_history_page("committee-account", "", 1).cursor;
+      BOOST_CHECK(!cursor.empty());
+      GRAPHENE_REQUIRE_THROW(hist_api.get_account_history_page("pageacct0", cursor, 1), fc::exception);
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+BOOST_AUTO_TEST_CASE(history_store_tiers) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      // committee-account does 5 ops, which become irreversible
+      for(int i = 0; i < 5; ++i)
+         create_account("tieracct" + std::to_string(i));
+      generate_block();
+      const uint32_t created_in = db.head_block_num();
+      while(db.get_dynamic_global_properties().last_irreversible_block_num < created_in)
+         generate_block();
+
+      // the irreversible history left the object database
+      BOOST_CHECK(db.find(operation_history_id_type()) == nullptr);
+      BOOST_CHECK(db.find(account_transaction_history_id_type()) == nullptr);
+
+      // and 2 more that are still reversible
+      create_account("tieracct5");
+      create_account("tieracct6");
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      const vector<operation_history_object> all = hist_api.get_account_history("committee-account",
+            operation_history_id_type(), 100, operation_history_id_type());
+      BOOST_REQUIRE_EQUAL(all.size(), 7u);
+      for(size_t i = 1; i < all.size(); ++i)
+         BOOST_CHECK(all[i].id.instance() < all[i-1].id.instance());
+      BOOST_CHECK(db.find(all.front().id) != nullptr);
+      BOOST_CHECK(db.find(all.back().id) == nullptr);
+
+      // paging and relative history cross from the object database into the store
+      vector<operation_history_id_type> paged;
+      account_history_page page = hist_api.get_account_history_page("committee-account", "", 3);
+      while(true)
+      {
+         for(const auto& op : page.operations)
+            paged.push_back(op.id);
+         if(page.cursor.empty())
+            break;
+         page = hist_api.get_account_history_page("committee-account", page.cursor, 3);
+      }
+      BOOST_REQUIRE_EQUAL(paged.size(), all.size());
+      for(size_t i = 0; i < all.size(); ++i)
+         BOOST_CHECK(paged[i] == all[i].id);
+
+      const vector<operation_history_object> relative = hist_api.get_relative_account_history("committee-account", 2, 4, 5);
+      BOOST_REQUIRE_EQUAL(relative.size(), 4u);
+      BOOST_CHECK(relative[0].id == all[2].id);
+      BOOST_CHECK(relative[3].id == all[5].id);
+
+      const vector<operation_history_object> older = hist_api.get_account_history("committee-account",
+            all[5].id, 100, all[2].id);
+      BOOST_REQUIRE_EQUAL(older.size(), 3u);
+      BOOST_CHECK(older[0].id == all[2].id);
+
+      const int account_create_op_id = operation::tag<account_create_operation>::value;
+      BOOST_CHECK_EQUAL(hist_api.get_account_history_operations("committee-account", account_create_op_id,
+            operation_history_id_type(), operation_history_id_type(), 100).size(), 7u);
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+BOOST_AUTO_TEST_CASE(history_store_seeks_sequences) {
+   try {
+      graphene::account_history::history_store store;
+      store.open_in_memory(fc::path());
+      // every sequence but the multiples of 7, the operations of account 5 are twice its sequence
+      for(uint64_t sequence = 1; sequence <= 1000; ++sequence)
+      {
+         if(sequence % 7 == 0)
+            continue;
+         store.append_account_entry(account_id_type(5), sequence, operation_history_id_type(2 * sequence));
+         store.append_account_entry(account_id_type(6), sequence, operation_history_id_type(2 * sequence + 1));
+      }
+
+      const auto first_visited = [&store](uint64_t max_sequence) -> uint64_t {
+         uint64_t result = 0;
+         store.for_each_account_entry(account_id_type(5), max_sequence,
+               [&result](const graphene::account_history::archived_account_history_entry& entry) -> bool {
+                  result = entry.sequence;
+                  return false;
+               });
+         return result;
+      };
+      BOOST_CHECK_EQUAL(first_visited(1000), 1000u);
+      BOOST_CHECK_EQUAL(first_visited(513), 513u);
+      BOOST_CHECK_EQUAL(first_visited(512), 512u);
+      BOOST_CHECK_EQUAL(first_visited(511), 510u);
+      BOOST_CHECK_EQUAL(first_visited(7), 6u);
+      BOOST_CHECK_EQUAL(first_visited(1), 1u);
+      BOOST_CHECK_EQUAL(first_visited(0), 0u);
+
+      BOOST_CHECK_EQUAL(store.find_sequence(account_id_type(5), operation_history_id_type(2000)), 1000u);
+      BOOST_CHECK_EQUAL(store.find_sequence(account_id_type(5), operation_history_id_type(1025)), 512u);
+      BOOST_CHECK_EQUAL(store.find_sequence(account_id_type(5), operation_history_id_type(1023)), 510u);
+      BOOST_CHECK_EQUAL(store.find_sequence(account_id_type(5), operation_history_id_type(1)), 0u);
+      BOOST_CHECK_EQUAL(store.find_sequence(account_id_type(7), operation_history_id_type(1000)), 0u);
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(compact_history) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      for(int i = 0; i < 5; ++i)
+         create_account("compactacct" + std::to_string(i));
+      generate_block();
+      const uint32_t created_in = db.head_block_num();
+      while(db.get_dynamic_global_properties().last_irreversible_block_num < created_in)
+         generate_block();
+      create_account("compactacct5");
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      // the irreversible history is packed in memory, and still found by the api
+      BOOST_CHECK(db.find(operation_history_id_type()) == nullptr);
+      const vector<operation_history_object> all = hist_api.get_account_history("committee-account",
+            operation_history_id_type(), 100, operation_history_id_type());
+      BOOST_REQUIRE_EQUAL(all.size(), 6u);
+      BOOST_CHECK(db.find(all.front().id) != nullptr);
+      BOOST_CHECK(db.find(all.back().id) == nullptr);
+      BOOST_CHECK_EQUAL(hist_api.get_account_history_page("committee-account", "", 100).operations.size(), 6u);
+
+      // the store survives a restart through its snapshot
+      fc::temp_directory tmp( graphene::utilities::temp_directory_path() );
+      const fc::path snapshot = tmp.path() / "snapshot";
+      graphene::account_history::history_store store;
+      store.open_in_memory(snapshot);
+      for(size_t i = all.size(); i > 0; --i)
+      {
+         store.append_operation(all[i-1]);
+         store.append_account_entry(account_id_type(), all.size() - i + 1, all[i-1].id);
+      }
+      BOOST_CHECK(store.memory_usage() > 0);
+      store.close();
+      store.open_in_memory(snapshot);
+      BOOST_CHECK_EQUAL(store.newest_sequence(account_id_type()), all.size());
+      BOOST_CHECK(store.next_operation_instance() == all.front().id.instance() + 1);
+      const optional<operation_history_object> op = store.get_operation(all[2].id);
+      BOOST_REQUIRE(op.valid());
+      BOOST_CHECK(op->block_num == all[2].block_num);
+      BOOST_CHECK(op->op.which() == all[2].op.which());
+      size_t visited = 0;
+      store.for_each_account_entry(account_id_type(), uint64_t(-1), [&](const graphene::account_history::archived_account_history_entry& e) -> bool {
+         BOOST_CHECK_EQUAL(e.operation, all[visited].id.instance());
+         return ++visited < all.size();
+      });
+      BOOST_CHECK_EQUAL(visited, all.size());
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+BOOST_AUTO_TEST_CASE(history_export) {
+   try {
+      using namespace graphene::history_export;
+      ACTORS( (alice)(bob) );
+      generate_block();
+      for(int i = 1; i <= 4; ++i)
+      {
+         transfer( committee_account, alice_id, asset(1000 * i) );
+         generate_block();
+      }
+      transfer( alice_id, bob_id, asset(5) );
+      const uint32_t last_transfer = db.head_block_num() + 1;
+      // runs into the second partition of 20 blocks
+      while( db.get_dynamic_global_properties().last_irreversible_block_num <= std::max( last_transfer, 21u ) )
+         generate_block();
+      app.get_plugin<history_export_plugin>("history_export")->flush();
+
+      const fc::path dir = data_dir->path() / "export";
+      BOOST_REQUIRE( fc::exists( dir / "state" ) );
+      BOOST_REQUIRE( fc::exists( dir / "blocks-0000000001-0000000020" / "account_create_operation.arrows" ) );
+      {
+         // an Arrow stream starts with the continuation marker of its schema message
+         std::ifstream in( ( dir / "blocks-0000000001-0000000020" / "account_create_operation.arrows" )
+                           .generic_string().c_str(), std::ios::in | std::ios::binary );
+         uint32_t marker = 0;
+         in.read( reinterpret_cast<char*>( &marker ), sizeof(marker) );
+         BOOST_CHECK_EQUAL( marker, 0xFFFFFFFFu );
+      }
+      vector<export_row> transfers;
+      for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+      {
+         if( !fc::is_directory( *itr ) || !fc::exists( *itr / "transfer_operation.arrows" ) )
+            continue;
+         const export_file file = read_export_file( *itr / "transfer_operation.arrows" );
+         BOOST_CHECK_EQUAL( file.op_type, operation(transfer_operation()).which() );
+         BOOST_CHECK_EQUAL( ( file.first_block - 1 ) % 20, 0u );
+         BOOST_CHECK_EQUAL( file.last_block, file.first_block + 19 );
+         for( const export_row& row : file.rows )
+         {
+            BOOST_CHECK( row.block_num >= file.first_block && row.block_num <= file.last_block );
+            transfers.push_back( row );
+         }
+      }
+      std::sort( transfers.begin(), transfers.end(), []( const export_row& a, const export_row& b ) {
+         return a.block_num < b.block_num;
+      });
+
+      BOOST_REQUIRE_EQUAL( transfers.size(), 5u );
+      for( size_t i = 0; i < 4; ++i )
+      {
+         BOOST_CHECK( transfers[i].fee == asset() );
+         BOOST_REQUIRE_EQUAL( transfers[i].amounts.size(), 1u );
+         BOOST_CHECK( transfers[i].amounts[0] == asset(1000 * (i + 1)) );
+         BOOST_CHECK( std::find( transfers[i].accounts.begin(), transfers[i].accounts.end(), alice_id )
+                      != transfers[i].accounts.end() );
+         BOOST_CHECK( db.fetch_block_by_number( transfers[i].block_num )->timestamp == transfers[i].block_time );
+      }
+      const export_row& last = transfers.back();
+      BOOST_CHECK_EQUAL( last.block_num, last_transfer );
+      BOOST_CHECK_EQUAL( last.trx_in_block, 0u );
+      BOOST_CHECK( last.amounts[0] == asset(5) );
+      const transfer_operation& op = last.op.get<transfer_operation>();
+      BOOST_CHECK( op.from == alice_id );
+      BOOST_CHECK( op.to == bob_id );
+      BOOST_CHECK( std::find( last.accounts.begin(), last.accounts.end(), bob_id ) != last.accounts.end() );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+BOOST_AUTO_TEST_CASE(market_history_merges_fills_of_a_block) {
+   try {
+      ACTORS( (seller)(buyer) );
+      const auto& usd = create_user_issued_asset( "USDBIT" );
+      const asset_id_type usd_id = usd.id;
+      issue_uia( seller, usd.amount(1000) );
+      transfer( committee_account, buyer_id, asset(10000) );
+      generate_block();
+
+      // three fills of asks by the seller in one block, at 2, 3 and 1.5 CORE per USD
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, usd_id), asset(20) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(20), asset(10, usd_id) ) );
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, usd_id), asset(30) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(30), asset(10, usd_id) ) );
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, usd_id), asset(15) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(15), asset(10, usd_id) ) );
+      generate_block();
+
+      using namespace graphene::market_history;
+      const auto& buckets = db.get_index_type<bucket_index>().indices().get<by_key>();
+      auto itr = buckets.lower_bound( bucket_key( asset_id_type(), usd_id, 0, fc::time_point_sec() ) );
+      BOOST_REQUIRE( itr != buckets.end() );
+      const bucket_object& bucket = *itr;
+      BOOST_CHECK( bucket.key.base == asset_id_type() );
+      BOOST_CHECK( bucket.key.quote == usd_id );
+      BOOST_CHECK( ++itr == buckets.end() || itr->key.base != asset_id_type() || itr->key.quote != usd_id );
+
+      BOOST_CHECK_EQUAL( bucket.base_volume.value, 65 );
+      BOOST_CHECK_EQUAL( bucket.quote_volume.value, 30 );
+      BOOST_CHECK_EQUAL( bucket.open_base.value, 20 );
+      BOOST_CHECK_EQUAL( bucket.open_quote.value, 10 );
+      BOOST_CHECK_EQUAL( bucket.close_base.value, 15 );
+      BOOST_CHECK_EQUAL( bucket.close_quote.value, 10 );
+      BOOST_CHECK_EQUAL( bucket.high_base.value, 30 );
+      BOOST_CHECK_EQUAL( bucket.high_quote.value, 10 );
+      BOOST_CHECK_EQUAL( bucket.low_base.value, 15 );
+      BOOST_CHECK_EQUAL( bucket.low_quote.value, 10 );
+
+      const auto& tickers = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+      auto ticker = tickers.find( std::make_tuple( asset_id_type(), usd_id ) );
+      BOOST_REQUIRE( ticker != tickers.end() );
+      BOOST_CHECK_EQUAL( ticker->latest_base.value, 15 );
+      BOOST_CHECK_EQUAL( ticker->latest_quote.value, 10 );
+      BOOST_CHECK( ticker->base_volume == fc::uint128( 65 ) );
+      BOOST_CHECK( ticker->quote_volume == fc::uint128( 30 ) );
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(market_ticker_rolls_out_slots) {
+   try {
+      ACTORS( (seller)(buyer) );
+      const auto& usd = create_user_issued_asset( "USDBIT" );
+      const asset_id_type usd_id = usd.id;
+      issue_uia( seller, usd.amount(1000) );
+      transfer( committee_account, buyer_id, asset(10000) );
+      generate_block();
+
+      using namespace graphene::market_history;
+      const auto& tickers = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+      const auto& slots = db.get_index_type<market_ticker_slot_index>().indices().get<by_slot_open>();
+      const size_t slots_before = slots.size();
+
+      // a fill at 2 CORE per USD, then one at 3 CORE per USD in a later slot
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, usd_id), asset(20) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(20), asset(10, usd_id) ) );
+      generate_block();
+      const fc::time_point_sec first_fill = db.head_block_time();
+      generate_blocks( first_fill + 2 * market_ticker_slot_object::slot_seconds );
+      BOOST_REQUIRE( create_sell_order( seller_id, asset(10, usd_id), asset(30) ) );
+      BOOST_CHECK( !create_sell_order( buyer_id, asset(30), asset(10, usd_id) ) );
+      generate_block();
+      BOOST_CHECK_EQUAL( slots.size(), slots_before + 2 );
+
+      auto ticker = tickers.find( std::make_tuple( asset_id_type(), usd_id ) );
+      BOOST_REQUIRE( ticker != tickers.end() );
+      BOOST_CHECK( ticker->base_volume == fc::uint128( 50 ) );
+      BOOST_CHECK( ticker->quote_volume == fc::uint128( 20 ) );
+      BOOST_CHECK_EQUAL( ticker->last_day_base.value, 0 );
+
+      // a day later the first fill left the ticker, its price is the one of a day ago
+      generate_blocks( first_fill + 86400 + market_ticker_slot_object::slot_seconds );
+      generate_block();
+      ticker = tickers.find( std::make_tuple( asset_id_type(), usd_id ) );
+      BOOST_CHECK( ticker->base_volume == fc::uint128( 30 ) );
+      BOOST_CHECK( ticker->quote_volume == fc::uint128( 10 ) );
+      BOOST_CHECK_EQUAL( ticker->last_day_base.value, 20 );
+      BOOST_CHECK_EQUAL( ticker->last_day_quote.value, 10 );
+      BOOST_CHECK_EQUAL( ticker->latest_base.value, 30 );
+
+      // and then the second one
+      generate_blocks( db.head_block_time() + 3 * market_ticker_slot_object::slot_seconds );
+      generate_block();
+      ticker = tickers.find( std::make_tuple( asset_id_type(), usd_id ) );
+      BOOST_CHECK( ticker->base_volume == fc::uint128( 0 ) );
+      BOOST_CHECK_EQUAL( ticker->last_day_base.value, 30 );
+      BOOST_CHECK_EQUAL( slots.size(), slots_before );
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
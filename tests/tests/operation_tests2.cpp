@@ -2036,6 +2036,12 @@ BOOST_AUTO_TEST_CASE(transfer_with_memo) {
       auto memo = db.get_recent_transaction(trx.id()).operations.front().get<transfer_operation>().memo;
       BOOST_CHECK(memo);
       BOOST_CHECK_EQUAL(memo->get_message(bob_private_key, alice_public_key), "Dear Bob,\n\nMoney!\n\nLove, Alice");
+
+      // once included, the body is served from the block
+      generate_block(database::skip_nothing);
+      memo = db.get_recent_transaction(trx.id()).operations.front().get<transfer_operation>().memo;
+      BOOST_CHECK(memo);
+      BOOST_CHECK_EQUAL(memo->get_message(bob_private_key, alice_public_key), "Dear Bob,\n\nMoney!\n\nLove, Alice");
    } FC_LOG_AND_RETHROW()
 }
 
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Bitshares Foundation, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/peer_database.hpp>
+#include <graphene/net/config.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+
+#include <fstream>
+
+using namespace graphene::net;
+
+BOOST_AUTO_TEST_SUITE(peer_database_tests)
+
+BOOST_AUTO_TEST_CASE( journal_survives_crash )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::path db_file = data_dir.path() / "peers.json";
+      fc::ip::endpoint first( fc::ip::address("10.0.0.1"), 1776 );
+      fc::ip::endpoint second( fc::ip::address("10.0.0.2"), 1776 );
+      fc::ip::endpoint third( fc::ip::address("10.0.0.3"), 1776 );
+
+      {
+         // updates are journaled as they happen; the database is never closed
+         peer_database db;
+         db.open( db_file );
+         db.update_entry( potential_peer_record( first, fc::time_point_sec(100) ) );
+         db.update_entry( potential_peer_record( second, fc::time_point_sec(200) ) );
+         potential_peer_record updated( first, fc::time_point_sec(300), last_connection_succeeded );
+         updated.number_of_successful_connection_attempts = 3;
+         db.update_entry( updated );
+         db.update_entry( potential_peer_record( third, fc::time_point_sec(400) ) );
+         db.erase( second );
+
+         peer_database reopened;
+         reopened.open( db_file );
+         BOOST_CHECK_EQUAL( reopened.size(), 2u );
+         BOOST_REQUIRE( reopened.lookup_entry_for_endpoint( first ) );
+         BOOST_CHECK_EQUAL( reopened.lookup_entry_for_endpoint( first )->number_of_successful_connection_attempts, 3u );
+         BOOST_CHECK( !reopened.lookup_entry_for_endpoint( second ) );
+         BOOST_CHECK( reopened.lookup_entry_for_endpoint( third ) );
+      }
+
+      // a torn record at the end of the journal is dropped, entries before it are kept
+      {
+         std::ofstream journal( (data_dir.path() / "peers.dat").generic_string().c_str(), std::ios::binary | std::ios::app );
+         const char garbage[] = { 0, 42, 0 };
+         journal.write( garbage, sizeof(garbage) );
+      }
+      peer_database db;
+      db.open( db_file );
+      BOOST_CHECK_EQUAL( db.size(), 2u );
+      db.update_entry( potential_peer_record( second, fc::time_point_sec(500) ) );
+      db.close();
+
+      db.open( db_file );
+      BOOST_CHECK_EQUAL( db.size(), 3u );
+      BOOST_CHECK( db.lookup_entry_for_endpoint( second ) );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( migrates_legacy_json )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::path db_file = data_dir.path() / "peers.json";
+      std::vector<potential_peer_record> records;
+      records.push_back( potential_peer_record( fc::ip::endpoint( fc::ip::address("10.0.0.1"), 1776 ), fc::time_point_sec(100) ) );
+      records.push_back( potential_peer_record( fc::ip::endpoint( fc::ip::address("10.0.0.2"), 1776 ), fc::time_point_sec(200) ) );
+      fc::json::save_to_file( records, db_file, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+
+      peer_database db;
+      db.open( db_file );
+      BOOST_CHECK_EQUAL( db.size(), 2u );
+      db.close();
+      BOOST_CHECK( fc::exists( data_dir.path() / "peers.dat" ) );
+
+      // the binary store takes precedence once it exists
+      fc::remove( db_file );
+      db.open( db_file );
+      BOOST_CHECK_EQUAL( db.size(), 2u );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
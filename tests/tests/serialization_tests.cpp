@@ -31,10 +31,29 @@
 #include <fc/crypto/elliptic.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <sstream>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
 
+namespace {
+/** laid out like asset and price, but serialized by the reflected member visitors */
+struct reflected_asset
+{
+   share_type    amount;
+   asset_id_type asset_id;
+};
+struct reflected_price
+{
+   reflected_asset base;
+   reflected_asset quote;
+};
+}
+
+FC_REFLECT( reflected_asset, (amount)(asset_id) )
+FC_REFLECT( reflected_price, (base)(quote) )
+
 BOOST_FIXTURE_TEST_SUITE( operation_unit_tests, database_fixture )
 
 BOOST_AUTO_TEST_CASE( serialization_raw_test )
@@ -148,4 +167,85 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( asset_serialization_matches_reflection )
+{
+   try
+   {
+      const int64_t amounts[] = { 0, -1, 100, GRAPHENE_MAX_SHARE_SUPPLY };
+      // instances around the varint byte boundaries
+      const uint64_t instances[] = { 0, 127, 128, 16383, 16384, GRAPHENE_DB_MAX_INSTANCE_ID };
+      for( int64_t amount : amounts )
+         for( uint64_t instance : instances )
+         {
+            const asset a( amount, asset_id_type( instance ) );
+            const reflected_asset r{ amount, asset_id_type( instance ) };
+            const auto packed = fc::raw::pack( a );
+            BOOST_CHECK( packed == fc::raw::pack( r ) );
+            BOOST_CHECK_EQUAL( packed.size(), fc::raw::pack_size( a ) );
+            BOOST_CHECK( fc::raw::unpack<asset>( packed ) == a );
+
+            const price p( a, asset( amount / 2, asset_id_type( instance / 3 ) ) );
+            const reflected_price rp{ r, reflected_asset{ amount / 2, asset_id_type( instance / 3 ) } };
+            const auto packed_price = fc::raw::pack( p );
+            BOOST_CHECK( packed_price == fc::raw::pack( rp ) );
+            const price unpacked = fc::raw::unpack<price>( packed_price );
+            BOOST_CHECK( unpacked.base == p.base && unpacked.quote == p.quote );
+         }
+
+      // the assets inside operations use the same encoding
+      transfer_operation op;
+      op.amount = asset( 12345, asset_id_type( 300 ) );
+      const auto packed = fc::raw::pack( op );
+      BOOST_CHECK( fc::raw::unpack<transfer_operation>( packed ).amount == op.amount );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( genesis_packed_matches_json )
+{
+   try
+   {
+      // the packed egenesis must give the state the JSON gives, so that it keeps the chain id
+      const std::string json = fc::json::to_string( genesis_state );
+      const genesis_state_type from_json = read_genesis_state( json );
+      const auto packed = fc::raw::pack( from_json );
+      const genesis_state_type unpacked = fc::raw::unpack<genesis_state_type>( packed );
+      BOOST_CHECK_EQUAL( fc::json::to_string( unpacked ), fc::json::to_string( from_json ) );
+      BOOST_CHECK( fc::raw::pack( unpacked ) == packed );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( genesis_written_in_parts_reads_back )
+{
+   try
+   {
+      // more accounts than one batch, so that they are converted on several workers
+      genesis_state_type genesis = genesis_state;
+      const auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "genesis" ) ) ).get_public_key();
+      for( uint32_t i = 0; i < 3000; ++i )
+         genesis.initial_accounts.emplace_back( "account" + std::to_string( i ), key, key, i % 2 == 0 );
+
+      std::stringstream out;
+      write_genesis_state( genesis, out );
+      const genesis_state_type read_back = read_genesis_state( out.str() );
+      BOOST_CHECK_EQUAL( fc::json::to_string( read_back ), fc::json::to_string( genesis ) );
+      BOOST_CHECK( fc::json::from_string( out.str() ).as<genesis_state_type>( 20 ).initial_accounts.size()
+                   == genesis.initial_accounts.size() );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
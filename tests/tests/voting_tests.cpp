@@ -26,6 +26,11 @@
 
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <iostream>
 
@@ -539,4 +544,166 @@ BOOST_AUTO_TEST_CASE(last_voting_date_proxy)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(incremental_vote_tally)
+{
+   try
+   {
+      db.enable_incremental_vote_tally();
+      generate_blocks( HARDFORK_613_TIME );
+      generate_block();
+
+      ACTORS( (alice)(bob)(carol)(proxy) );
+      transfer( committee_account, alice_id, asset(100000) );
+      transfer( committee_account, bob_id, asset(200000) );
+      transfer( committee_account, carol_id, asset(300000) );
+      transfer( committee_account, proxy_id, asset(400000) );
+      upgrade_to_lifetime_member( alice_id );
+      upgrade_to_lifetime_member( proxy_id );
+
+      // a node that always does the full tally
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db2;
+      db2.open( data_dir.path(), [this]{ return genesis_state; }, "TEST" );
+
+      auto update_options = [this]( const account_object& acc, const fc::ecc::private_key& key,
+                                    const std::function<void(account_options&)>& change ) {
+         account_update_operation op;
+         op.account = acc.id;
+         op.new_options = acc.options;
+         change( *op.new_options );
+         trx.operations.push_back( op );
+         set_expiration( db, trx );
+         sign( trx, key );
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+      };
+      auto check_same_totals = [&]() {
+         for( uint32_t num = db2.head_block_num() + 1; num <= db.head_block_num(); ++num )
+            db2.push_block( *db.fetch_block_by_number( num ), ~0 );
+         for( const witness_object& wit : db.get_index_type<witness_index>().indices() )
+            BOOST_CHECK_EQUAL( wit.total_votes, wit.id(db2).total_votes );
+         for( const committee_member_object& cm : db.get_index_type<committee_member_index>().indices() )
+            BOOST_CHECK_EQUAL( cm.total_votes, cm.id(db2).total_votes );
+         BOOST_CHECK( db.get_global_properties().active_witnesses == db2.get_global_properties().active_witnesses );
+      };
+
+      const vote_id_type witness1 = witness_id_type(1)(db).vote_id;
+      const vote_id_type witness2 = witness_id_type(2)(db).vote_id;
+      const vote_id_type committee1 = committee_member_id_type(1)(db).vote_id;
+
+      update_options( alice_id(db), alice_private_key, [&]( account_options& o ) { o.votes.insert( witness1 ); } );
+      update_options( proxy_id(db), proxy_private_key, [&]( account_options& o ) {
+         o.votes.insert( witness2 );
+         o.votes.insert( committee1 );
+      } );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // a proxy, a changed opinion, moving stake and fees paid back as cashback
+      update_options( bob_id(db), bob_private_key, [&]( account_options& o ) { o.voting_account = proxy_id; } );
+      update_options( proxy_id(db), proxy_private_key, [&]( account_options& o ) { o.votes.erase( witness2 ); } );
+      transfer( carol_id, alice_id, asset(50000), asset(1000) );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // nothing changed at all
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // the stake leaves a voter and the proxy stops voting
+      update_options( alice_id(db), alice_private_key, [&]( account_options& o ) { o.votes.erase( witness1 ); } );
+      update_options( bob_id(db), bob_private_key, [&]( account_options& o ) {
+         o.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         o.votes.insert( witness1 );
+      } );
+      transfer( proxy_id, carol_id, asset(300000) );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(prepared_vote_tally)
+{
+   try
+   {
+      db.enable_incremental_vote_tally();
+      generate_blocks( HARDFORK_613_TIME );
+      generate_block();
+
+      ACTORS( (alice)(bob)(proxy) );
+      transfer( committee_account, alice_id, asset(100000) );
+      transfer( committee_account, bob_id, asset(200000) );
+      transfer( committee_account, proxy_id, asset(400000) );
+      upgrade_to_lifetime_member( alice_id );
+      upgrade_to_lifetime_member( proxy_id );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db2;
+      db2.open( data_dir.path(), [this]{ return genesis_state; }, "TEST" );
+
+      auto update_options = [this]( const account_object& acc, const fc::ecc::private_key& key,
+                                    const std::function<void(account_options&)>& change ) {
+         account_update_operation op;
+         op.account = acc.id;
+         op.new_options = acc.options;
+         change( *op.new_options );
+         trx.operations.push_back( op );
+         set_expiration( db, trx );
+         sign( trx, key );
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+      };
+      auto check_same_totals = [&]() {
+         for( uint32_t num = db2.head_block_num() + 1; num <= db.head_block_num(); ++num )
+            db2.push_block( *db.fetch_block_by_number( num ), ~0 );
+         for( const witness_object& wit : db.get_index_type<witness_index>().indices() )
+            BOOST_CHECK_EQUAL( wit.total_votes, wit.id(db2).total_votes );
+         for( const committee_member_object& cm : db.get_index_type<committee_member_index>().indices() )
+            BOOST_CHECK_EQUAL( cm.total_votes, cm.id(db2).total_votes );
+      };
+      auto generate_until_maintenance = [this]() {
+         const time_point_sec maint = db.get_dynamic_global_properties().next_maintenance_time;
+         generate_blocks( maint - db.get_global_properties().parameters.block_interval * 2 );
+      };
+
+      const vote_id_type witness1 = witness_id_type(1)(db).vote_id;
+      const vote_id_type witness2 = witness_id_type(2)(db).vote_id;
+      update_options( proxy_id(db), proxy_private_key, [&]( account_options& o ) { o.votes.insert( witness1 ); } );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // counted in a block before the maintenance, then changed again in a later one
+      update_options( alice_id(db), alice_private_key, [&]( account_options& o ) { o.votes.insert( witness2 ); } );
+      update_options( bob_id(db), bob_private_key, [&]( account_options& o ) { o.voting_account = proxy_id; } );
+      generate_block();
+      update_options( proxy_id(db), proxy_private_key, [&]( account_options& o ) { o.votes.insert( witness2 ); } );
+      transfer( bob_id, alice_id, asset(50000) );
+      generate_block();
+      update_options( alice_id(db), alice_private_key, [&]( account_options& o ) { o.votes.erase( witness2 ); } );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // fees of members are still pending when they are counted
+      generate_until_maintenance();
+      transfer( alice_id, proxy_id, asset(10000), asset(1000) );
+      transfer( proxy_id, bob_id, asset(10000), asset(1000) );
+      generate_block();
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+      // a prepared block is undone, the maintenance falls back to a full tally
+      generate_until_maintenance();
+      update_options( bob_id(db), bob_private_key, [&]( account_options& o ) {
+         o.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         o.votes.insert( witness1 );
+      } );
+      generate_block();
+      db.pop_block();
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      check_same_totals();
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()